@@ -4,55 +4,125 @@
  * This module uses Windows NetAPI32 to enumerate computers on the network.
  * Works with both domain-joined and workgroup computers.
  * 
+ * Large domains do not fit in one reply, so the list is read in pages:
+ * each NetServerEnumEx call asks for about SCAN_PAGE_BYTES and returns
+ * ERROR_MORE_DATA while there is more. The next call starts from the last
+ * name received (FirstNameToReturn). Every page is handed to a callback
+ * right away, so the caller can show results while the scan continues.
+ * 
  * Educational concepts demonstrated:
- * - NetAPI32 functions (NetServerEnum)
+ * - NetAPI32 functions (NetServerEnumEx)
  * - Network enumeration
+ * - Paging through large result sets and detecting truncation
  * - Buffer management with NetApiBufferFree
  * - Working with Server Info structures
+ * - Callbacks for streaming results
  */
 
 #include <windows.h>
-#include <lm.h>  // For NetServerEnum and SERVER_INFO_101
+#include <lm.h>  // For NetServerEnumEx and SERVER_INFO_101
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "adscan.h"
 
 /*
- * ScanForComputers - Enumerate computers on the network
+ * IsComputerIncluded - Check a computer's type against the scan filter
+ */
+static BOOL IsComputerIncluded(DWORD type, BOOL includeWorkstations,
+                               BOOL includeServers, BOOL includeDomainControllers)
+{
+    if ((type & SV_TYPE_DOMAIN_CTRL) && includeDomainControllers)
+        return TRUE;
+    if ((type & SV_TYPE_SERVER) && includeServers)
+        return TRUE;
+    if ((type & SV_TYPE_WORKSTATION) && includeWorkstations)
+        return TRUE;
+    return FALSE;
+}
+
+/*
+ * CopyComputerInfo - Copy one SERVER_INFO_101 entry into a ComputerInfo
  * 
- * Uses NetServerEnum to discover computers in the domain/workgroup.
- * This works even if not joined to a domain.
+ * Computers without a comment get their type as the description.
+ */
+static void CopyComputerInfo(ComputerInfo* computer, const SERVER_INFO_101* info)
+{
+    DWORD type = info->sv101_type;
+    
+    // Copy computer name
+    if (info->sv101_name != NULL)
+    {
+        wcsncpy_s(computer->name, 256, info->sv101_name, _TRUNCATE);
+    }
+    else
+    {
+        computer->name[0] = L'\0';
+    }
+    
+    // Copy comment/description
+    if (info->sv101_comment != NULL && wcslen(info->sv101_comment) > 0)
+    {
+        wcsncpy_s(computer->comment, 256, info->sv101_comment, _TRUNCATE);
+    }
+    else
+    {
+        // If no comment, use computer type as description
+        if (type & SV_TYPE_DOMAIN_CTRL)
+            wcscpy_s(computer->comment, 256, L"Domain Controller");
+        else if (type & SV_TYPE_SERVER)
+            wcscpy_s(computer->comment, 256, L"Server");
+        else if (type & SV_TYPE_WORKSTATION)
+            wcscpy_s(computer->comment, 256, L"Workstation");
+        else
+            wcscpy_s(computer->comment, 256, L"Computer");
+    }
+    
+    // The browse list has neither (the LDAP scan fills them in)
+    computer->operatingSystem[0] = L'\0';
+    computer->lastLogon = 0;
+}
+
+/*
+ * EnumerateComputers - Enumerate computers on the network, one page at a time
  * 
  * Parameters:
  *   domain    - Domain/workgroup name (NULL or empty for current)
  *   includeWorkstations - Include workstation computers
  *   includeServers - Include server computers (excluding DCs)
  *   includeDomainControllers - Include domain controllers
- *   computers - Pointer to receive allocated array of ComputerInfo
- *   count     - Pointer to receive number of computers found
- * 
- * Note: NetServerEnum uses the caller's security context. 
- * The scan runs with the current logged-in user's permissions.
+ *   callback  - Called once per page with the computers that passed the filter
+ *   context   - Passed to callback
+ *   summary   - Receives page count, entry counts and completeness (may be NULL)
  * 
  * Returns:
- *   TRUE on success (even if no computers found)
- *   FALSE on failure
+ *   TRUE if the enumeration ran (also when nothing was found, when the
+ *        callback stopped it, or when a later page failed - check
+ *        summary->complete)
+ *   FALSE if the first page failed (summary->status has the error) or
+ *        memory ran out
  * 
- * The caller MUST call FreeComputerList() when done with the array!
+ * Why not NetServerEnum's resume handle? It is documented as reserved and
+ * is ignored, so a reply that does not fit just ends with ERROR_MORE_DATA.
+ * NetServerEnumEx continues from a name instead. The page starts with that
+ * name again, so the repeated first entry is skipped.
+ * 
+ * Note: NetServerEnumEx uses the caller's security context.
  */
-BOOL ScanForComputers(const wchar_t* domain, BOOL includeWorkstations,
-                      BOOL includeServers, BOOL includeDomainControllers,
-                      ComputerInfo** computers, int* count)
+BOOL EnumerateComputers(const wchar_t* domain, BOOL includeWorkstations,
+                        BOOL includeServers, BOOL includeDomainControllers,
+                        ComputerBatchCallback callback, void* context,
+                        ScanSummary* summary)
 {
-    SERVER_INFO_101* buffer = NULL;
-    DWORD entriesRead = 0;
-    DWORD totalEntries = 0;
-    DWORD resumeHandle = 0;
-    NET_API_STATUS status;
+    ScanSummary localSummary;
+    ComputerInfo* batch = NULL;
+    DWORD batchCapacity = 0;
+    wchar_t resumeName[256] = {0};   // Last name received (where the next page starts)
+    BOOL result = TRUE;
     
-    // Initialize output parameters
-    *computers = NULL;
-    *count = 0;
+    if (summary == NULL)
+        summary = &localSummary;
+    memset(summary, 0, sizeof(ScanSummary));
     
     // Prepare domain parameter (use NULL if empty string)
     const wchar_t* domainToScan = NULL;
@@ -61,124 +131,203 @@ BOOL ScanForComputers(const wchar_t* domain, BOOL includeWorkstations,
         domainToScan = domain;
     }
     
-    /*
-     * NetServerEnum - Enumerate servers on the network
-     * 
-     * Parameters:
-     *   NULL           - Local computer (NULL = enumerate from local)
-     *   101            - Information level (SERVER_INFO_101 has name and comment)
-     *   (LPBYTE*)&buffer - Receives pointer to buffer with results
-     *   MAX_PREFERRED_LENGTH - Let API allocate optimal buffer size
-     *   &entriesRead   - Number of entries actually read
-     *   &totalEntries  - Total entries available
-     *   SV_TYPE_WORKSTATION | SV_TYPE_SERVER - Type filter (all computers)
-     *   domainToScan   - Domain (NULL = current domain/workgroup)
-     *   &resumeHandle  - For paging through results
-     * 
-     * Returns:
-     *   NERR_Success (0) on success
-     *   Other codes indicate errors
-     */
-    status = NetServerEnum(
-        NULL,                                    // servername
-        101,                                     // level (SERVER_INFO_101)
-        (LPBYTE*)&buffer,                       // bufptr
-        MAX_PREFERRED_LENGTH,                    // prefmaxlen
-        &entriesRead,                           // entriesread
-        &totalEntries,                          // totalentries
-        SV_TYPE_WORKSTATION | SV_TYPE_SERVER,   // servertype (all computers)
-        domainToScan,                            // domain (NULL = current, or specified domain)
-        &resumeHandle                            // resume_handle
-    );
-    
-    // Check for errors
-    if (status != NERR_Success)
-    {
-        // Not necessarily fatal - might just be no computers found
-        // or not on a network
-        return TRUE;  // Return success with 0 count
-    }
-    
-    if (entriesRead == 0)
+    for (;;)
     {
-        // No computers found, but not an error
-        if (buffer != NULL)
-            NetApiBufferFree(buffer);
-        return TRUE;
-    }
-    
-    // Allocate array for results (may be larger than needed due to filtering)
-    *computers = (ComputerInfo*)malloc(sizeof(ComputerInfo) * entriesRead);
-    if (*computers == NULL)
-    {
-        NetApiBufferFree(buffer);
-        return FALSE;
-    }
-    
-    // Copy computer information to our structure, filtering by type
-    int addedCount = 0;
-    for (DWORD i = 0; i < entriesRead; i++)
-    {
-        DWORD type = buffer[i].sv101_type;
+        SERVER_INFO_101* buffer = NULL;
+        DWORD entriesRead = 0;
+        DWORD totalEntries = 0;
         
-        // Determine computer type and check if we should include it
-        BOOL includeThisComputer = FALSE;
-        if ((type & SV_TYPE_DOMAIN_CTRL) && includeDomainControllers)
-        {
-            includeThisComputer = TRUE;
-        }
-        else if ((type & SV_TYPE_SERVER) && includeServers)
-        {
-            includeThisComputer = TRUE;
-        }
-        else if ((type & SV_TYPE_WORKSTATION) && includeWorkstations)
+        /*
+         * NetServerEnumEx - Enumerate servers on the network
+         * 
+         * Parameters:
+         *   NULL           - Local computer (NULL = enumerate from local)
+         *   101            - Information level (SERVER_INFO_101 has name and comment)
+         *   (LPBYTE*)&buffer - Receives pointer to buffer with results
+         *   SCAN_PAGE_BYTES - Preferred page size (ERROR_MORE_DATA if there is more)
+         *   &entriesRead   - Number of entries in this page
+         *   &totalEntries  - Total entries the browser knows about
+         *   SV_TYPE_WORKSTATION | SV_TYPE_SERVER - Type filter (all computers)
+         *   domainToScan   - Domain (NULL = current domain/workgroup)
+         *   resumeName     - First name to return (NULL = from the start)
+         */
+        NET_API_STATUS status = NetServerEnumEx(
+            NULL,                                    // servername
+            101,                                     // level (SERVER_INFO_101)
+            (LPBYTE*)&buffer,                        // bufptr
+            SCAN_PAGE_BYTES,                         // prefmaxlen
+            &entriesRead,                            // entriesread
+            &totalEntries,                           // totalentries
+            SV_TYPE_WORKSTATION | SV_TYPE_SERVER,    // servertype (all computers)
+            domainToScan,                            // domain (NULL = current, or specified domain)
+            resumeName[0] != L'\0' ? resumeName : NULL  // FirstNameToReturn
+        );
+        
+        summary->pages++;
+        summary->status = status;
+        
+        if (status != NERR_Success && status != ERROR_MORE_DATA)
         {
-            includeThisComputer = TRUE;
+            if (buffer != NULL)
+                NetApiBufferFree(buffer);
+            
+            // No browser at all just means nothing to find (not on a network)
+            if (summary->pages == 1 && status != ERROR_NO_BROWSER_SERVERS_FOUND)
+                result = FALSE;
+            break;
         }
         
-        // Skip if this computer type is not included in the filter
-        if (!includeThisComputer)
-            continue;
+        if (summary->pages == 1)
+            summary->totalEntries = totalEntries;
         
-        // Copy computer name
-        wchar_t* name = buffer[i].sv101_name;
-        if (name != NULL)
+        // A resumed page repeats the name it was resumed from
+        DWORD first = 0;
+        if (resumeName[0] != L'\0' && entriesRead > 0 && buffer[0].sv101_name != NULL &&
+            _wcsicmp(buffer[0].sv101_name, resumeName) == 0)
         {
-            wcsncpy_s((*computers)[addedCount].name, 256, name, _TRUNCATE);
+            first = 1;
         }
-        else
+        
+        // Grow the batch array to the page size
+        if (entriesRead > batchCapacity)
         {
-            (*computers)[addedCount].name[0] = L'\0';
+            ComputerInfo* newBatch = (ComputerInfo*)realloc(batch, sizeof(ComputerInfo) * entriesRead);
+            if (newBatch == NULL)
+            {
+                NetApiBufferFree(buffer);
+                result = FALSE;
+                break;
+            }
+            batch = newBatch;
+            batchCapacity = entriesRead;
         }
         
-        // Copy comment/description
-        wchar_t* comment = buffer[i].sv101_comment;
-        if (comment != NULL && wcslen(comment) > 0)
+        // Copy computer information to our structure, filtering by type
+        int batchCount = 0;
+        for (DWORD i = first; i < entriesRead; i++)
         {
-            wcsncpy_s((*computers)[addedCount].comment, 256, comment, _TRUNCATE);
+            if (IsComputerIncluded(buffer[i].sv101_type, includeWorkstations,
+                                   includeServers, includeDomainControllers))
+            {
+                CopyComputerInfo(&batch[batchCount], &buffer[i]);
+                batchCount++;
+            }
         }
-        else
+        
+        summary->entriesReceived += entriesRead - first;
+        summary->computersReported += batchCount;
+        
+        // Remember where the next page starts before the buffer goes away
+        BOOL madeProgress = (entriesRead > first);
+        if (entriesRead > 0 && buffer[entriesRead - 1].sv101_name != NULL)
         {
-            // If no comment, use computer type as description
-            if (type & SV_TYPE_DOMAIN_CTRL)
-                wcscpy_s((*computers)[addedCount].comment, 256, L"Domain Controller");
-            else if (type & SV_TYPE_SERVER)
-                wcscpy_s((*computers)[addedCount].comment, 256, L"Server");
-            else if (type & SV_TYPE_WORKSTATION)
-                wcscpy_s((*computers)[addedCount].comment, 256, L"Workstation");
-            else
-                wcscpy_s((*computers)[addedCount].comment, 256, L"Computer");
+            wcsncpy_s(resumeName, 256, buffer[entriesRead - 1].sv101_name, _TRUNCATE);
         }
         
-        addedCount++;
+        // Free the buffer allocated by NetServerEnumEx
+        // CRITICAL: Always free NetAPI buffers!
+        NetApiBufferFree(buffer);
+        
+        if (!callback(batch, batchCount, context))
+            break;
+        
+        // Done, or a page with nothing new (would loop forever)
+        if (status == NERR_Success || !madeProgress)
+            break;
+    }
+    
+    free(batch);
+    
+    summary->complete = (summary->status == NERR_Success &&
+                         summary->entriesReceived >= summary->totalEntries);
+    return result;
+}
+
+// Collects the pages of EnumerateComputers into one array
+typedef struct {
+    ComputerInfo* computers;
+    int count;
+    int capacity;
+    BOOL outOfMemory;
+} ComputerCollector;
+
+/*
+ * CollectComputerBatch - ComputerBatchCallback that appends to a ComputerCollector
+ */
+static BOOL CollectComputerBatch(const ComputerInfo* batch, int count, void* context)
+{
+    ComputerCollector* collector = (ComputerCollector*)context;
+    
+    if (collector->count + count > collector->capacity)
+    {
+        int newCapacity = (collector->capacity > 0) ? collector->capacity * 2 : 256;
+        while (newCapacity < collector->count + count)
+            newCapacity *= 2;
+        
+        ComputerInfo* newComputers = (ComputerInfo*)realloc(collector->computers,
+                                                            sizeof(ComputerInfo) * newCapacity);
+        if (newComputers == NULL)
+        {
+            collector->outOfMemory = TRUE;
+            return FALSE;
+        }
+        collector->computers = newComputers;
+        collector->capacity = newCapacity;
     }
     
-    *count = addedCount;
+    memcpy(&collector->computers[collector->count], batch, sizeof(ComputerInfo) * count);
+    collector->count += count;
+    return TRUE;
+}
+
+/*
+ * ScanForComputers - Enumerate computers on the network
+ * 
+ * Uses EnumerateComputers to discover computers in the domain/workgroup
+ * and gathers all pages into one array. This works even if not joined to
+ * a domain.
+ * 
+ * Parameters:
+ *   domain    - Domain/workgroup name (NULL or empty for current)
+ *   includeWorkstations - Include workstation computers
+ *   includeServers - Include server computers (excluding DCs)
+ *   includeDomainControllers - Include domain controllers
+ *   computers - Pointer to receive allocated array of ComputerInfo
+ *   count     - Pointer to receive number of computers found
+ *   summary   - Receives completeness information (may be NULL)
+ * 
+ * Note: NetServerEnumEx uses the caller's security context. 
+ * The scan runs with the current logged-in user's permissions.
+ * 
+ * Returns:
+ *   TRUE on success (even if no computers found, or the list is
+ *        incomplete - check summary->complete)
+ *   FALSE on failure
+ * 
+ * The caller MUST call FreeComputerList() when done with the array!
+ */
+BOOL ScanForComputers(const wchar_t* domain, BOOL includeWorkstations,
+                      BOOL includeServers, BOOL includeDomainControllers,
+                      ComputerInfo** computers, int* count, ScanSummary* summary)
+{
+    ComputerCollector collector = {0};
+    
+    // Initialize output parameters
+    *computers = NULL;
+    *count = 0;
+    
+    BOOL result = EnumerateComputers(domain, includeWorkstations, includeServers,
+                                     includeDomainControllers, CollectComputerBatch,
+                                     &collector, summary);
     
-    // Free the buffer allocated by NetServerEnum
-    // CRITICAL: Always free NetAPI buffers!
-    NetApiBufferFree(buffer);
+    if (!result || collector.outOfMemory)
+    {
+        free(collector.computers);
+        return FALSE;
+    }
     
+    *computers = collector.computers;
+    *count = collector.count;
     return TRUE;
 }
 
@@ -10,12 +10,50 @@
 
 #include <windows.h>
 
+// Bytes requested per NetServerEnumEx page (the API may return a little more)
+#define SCAN_PAGE_BYTES     (64 * 1024)
+
 // Structure to hold discovered computer information
 typedef struct {
     wchar_t name[256];
     wchar_t comment[256];
+    wchar_t operatingSystem[64];    // Empty when unknown (the network browser does not report it)
+    ULONGLONG lastLogon;            // FILETIME of the last logon (0 = unknown)
 } ComputerInfo;
 
+// How complete an enumeration was
+typedef struct {
+    DWORD totalEntries;         // Entries the browser said it has (first page's totalentries)
+    DWORD entriesReceived;      // Entries actually received (before the type filter)
+    int computersReported;      // Entries that passed the type filter
+    int pages;                  // NetServerEnumEx calls made
+    DWORD status;               // Last NetAPI status (NERR_Success when the list ended normally)
+    BOOL complete;              // Ended normally and received at least totalEntries
+} ScanSummary;
+
+// Receives each page of computers as soon as it arrives
+// Parameters:
+//   batch - Computers in this page that passed the type filter
+//   count - Number of computers in batch (may be 0)
+//   context - Caller's pointer passed to EnumerateComputers
+// Return FALSE to stop the enumeration early
+typedef BOOL (*ComputerBatchCallback)(const ComputerInfo* batch, int count, void* context);
+
+// Enumerate computers page by page, calling callback once per page
+// Parameters:
+//   domain - Domain/workgroup name (NULL for current)
+//   includeWorkstations/includeServers/includeDomainControllers - Type filter
+//   callback - Receives each page (names may repeat across pages of a
+//              changing browse list; deduplicate if that matters)
+//   context - Passed to callback
+//   summary - Receives completeness information (may be NULL)
+// Returns TRUE if the enumeration ran (even if it found nothing or was
+// stopped by the callback), FALSE if the first page failed
+BOOL EnumerateComputers(const wchar_t* domain, BOOL includeWorkstations,
+                        BOOL includeServers, BOOL includeDomainControllers,
+                        ComputerBatchCallback callback, void* context,
+                        ScanSummary* summary);
+
 // Scan for computers in the domain/workgroup
 // Parameters:
 //   domain - Domain/workgroup name (NULL for current)
@@ -24,15 +62,15 @@ typedef struct {
 //   includeDomainControllers - Include domain controllers
 //   computers - Receives array of ComputerInfo
 //   count - Receives number of computers found
+//   summary - Receives completeness information (may be NULL)
 // Returns array of ComputerInfo and count
 // Caller must free the array with FreeComputerList()
 // Note: Uses caller's security context (runs as current logged-in user)
 BOOL ScanForComputers(const wchar_t* domain, BOOL includeWorkstations,
                       BOOL includeServers, BOOL includeDomainControllers,
-                      ComputerInfo** computers, int* count);
+                      ComputerInfo** computers, int* count, ScanSummary* summary);
 
 // Free the computer list returned by ScanForComputers
 void FreeComputerList(ComputerInfo* computers);
 
 #endif // ADSCAN_H
-
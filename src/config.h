@@ -19,6 +19,10 @@
 
 // File paths
 #define HOSTS_FILE_NAME         L"hosts.csv"
+#define PERF_STATS_FILE_NAME    L"perfstats.json"   // Diagnostics dump (next to the executable)
+#define SCAN_CACHE_FILE_NAME    L"scancache.bin"    // Last enumeration of each scan source (next to the executable)
+#define LATENCY_FILE_NAME       L"latency.bin"      // Connect time histogram of each host (next to hosts.csv)
+#define PROFILES_FILE_NAME      L"profiles.ini"     // Connection profiles for the .rdp files (next to hosts.csv)
 
 // Encryption settings
 #define ENCRYPTED_FILE_MAGIC    0x57524450  // "WRDP" in hex - identifies encrypted files
@@ -28,6 +32,53 @@
 #define REG_RUN_KEY             L"Software\\Microsoft\\Windows\\CurrentVersion\\Run"
 #define REG_APP_NAME            L"WinRDP"
 
+// Registry key for optional user settings (HKEY_CURRENT_USER)
+#define REG_SETTINGS_KEY        L"Software\\WinRDP"
+
+// Search box settings
+#define SEARCH_DEBOUNCE_MS      150         // Default delay after a keystroke before searching
+#define REG_SEARCH_DEBOUNCE     L"SearchDebounceMs"  // Registry override (DWORD, milliseconds)
+
+// Network scan settings
+#define SCAN_WORKERS            4           // Default number of domains scanned at the same time
+#define REG_SCAN_WORKERS        L"ScanWorkers"          // Registry override (DWORD, 1-16)
+#define SCAN_SOURCE_TIMEOUT_MS  60000       // Default time one domain may take
+#define REG_SCAN_SOURCE_TIMEOUT L"ScanSourceTimeoutMs"  // Registry override (DWORD, milliseconds)
+#define SCAN_CACHE              1           // Default: show the last results at once and refresh them
+#define REG_SCAN_CACHE          L"ScanCache"            // Registry override (DWORD, 0 = always scan from scratch)
+
+// Reachability probe settings
+#define RDP_DEFAULT_PORT        3389        // Port probed for hosts without :port
+#define PROBE_CONCURRENCY       256         // Default connects in flight at once
+#define REG_PROBE_CONCURRENCY   L"ProbeConcurrency"     // Registry override (DWORD, 1-1024)
+#define PROBE_TIMEOUT_MS        3000        // Default time one connect may take
+#define REG_PROBE_TIMEOUT       L"ProbeTimeoutMs"       // Registry override (DWORD, milliseconds)
+#define PROBE_NEGOTIATE         1           // Default: start the RDP handshake to read the security protocol
+#define REG_PROBE_NEGOTIATE     L"ProbeNegotiate"       // Registry override (DWORD, 0 = TCP connect only)
+
+// Host monitor settings
+#define HOST_MONITOR            1           // Default: keep the Status column up to date in the background
+#define REG_HOST_MONITOR        L"HostMonitor"          // Registry override (DWORD, 0 = off)
+#define MONITOR_PACKETS_PER_SECOND 40       // Default packet budget of the monitor
+#define REG_MONITOR_PACKETS_PER_SECOND L"MonitorPacketsPerSecond" // Registry override (DWORD, at least 4)
+
+// Subnet sweep settings
+#define SWEEP_CONCURRENCY       512         // Default largest connect window of one range
+#define REG_SWEEP_CONCURRENCY   L"SweepConcurrency"     // Registry override (DWORD, 8-1024)
+#define SWEEP_TIMEOUT_MS        1000        // Default time one address may take to answer
+#define REG_SWEEP_TIMEOUT       L"SweepTimeoutMs"       // Registry override (DWORD, milliseconds)
+
+// Name resolution settings
+#define RESOLVER_CONCURRENCY    16          // Default lookups in flight at once
+#define REG_RESOLVER_CONCURRENCY L"ResolverConcurrency" // Registry override (DWORD, 1-64)
+#define RESOLVER_NEGATIVE_TTL   60          // Seconds a "no such name" answer is remembered
+#define REG_RESOLVER_NEGATIVE_TTL L"ResolverNegativeTtl" // Registry override (DWORD, seconds)
+#define RESOLVER_DEFAULT_TTL    300         // Seconds for answers that carry no TTL (hosts file, NetBIOS, LLMNR)
+#define RESOLVER_MAX_TTL        3600        // Longest any answer is remembered (seconds)
+#define RESOLVER_PREFETCH_COUNT 10          // Recent hosts resolved ahead of time
+#define REG_DNS_SERVER          L"DnsServer"            // Optional IPv4 DNS server ("ip" or "ip:port") to ask instead of the system's (REG_SZ)
+#define RESOLVER_QUERY_TIMEOUT_MS 2000      // How long DnsServer has to answer one query
+
 // Buffer sizes
 #define MAX_HOSTNAME_LEN        256
 #define MAX_DESCRIPTION_LEN     512
@@ -39,5 +90,8 @@ void CenterWindow(HWND hwnd);
 void ShowErrorMessage(HWND hwnd, const wchar_t* message);
 void ShowInfoMessage(HWND hwnd, const wchar_t* message);
 
+// 64-bit hash table key of a hostname: FNV-1a of the lowercase name, never 0
+ULONGLONG HashHostKey(const wchar_t* hostname);
+
 #endif // CONFIG_H
 
@@ -40,6 +40,34 @@
  */
 BOOL SaveCredentials(const wchar_t* targetName, const wchar_t* username, 
                      const wchar_t* password)
+{
+    if (!WriteCredentials(targetName, username, password))
+    {
+        // GetLastError() returns the error code
+        // Common errors:
+        //   ERROR_BAD_USERNAME - Invalid username format
+        //   ERROR_ACCESS_DENIED - No permission to write credentials
+        DWORD error = GetLastError();
+        wchar_t errorMsg[256];
+        swprintf(errorMsg, 256, L"Failed to save credentials. Error code: %lu", error);
+        MessageBoxW(NULL, errorMsg, L"Error", MB_OK | MB_ICONERROR);
+        return FALSE;
+    }
+    
+    return TRUE;
+}
+
+/*
+ * WriteCredentials - SaveCredentials without the error message
+ * 
+ * For worker threads, which must not show UI. On failure GetLastError()
+ * has the reason.
+ * 
+ * Returns:
+ *   TRUE on success, FALSE on failure
+ */
+BOOL WriteCredentials(const wchar_t* targetName, const wchar_t* username, 
+                      const wchar_t* password)
 {
     CREDENTIALW cred = {0};
     
@@ -57,20 +85,7 @@ BOOL SaveCredentials(const wchar_t* targetName, const wchar_t* username,
     
     // Write the credential to the store
     // CredWriteW returns TRUE on success, FALSE on failure
-    if (!CredWriteW(&cred, 0))
-    {
-        // GetLastError() returns the error code
-        // Common errors:
-        //   ERROR_BAD_USERNAME - Invalid username format
-        //   ERROR_ACCESS_DENIED - No permission to write credentials
-        DWORD error = GetLastError();
-        wchar_t errorMsg[256];
-        swprintf(errorMsg, 256, L"Failed to save credentials. Error code: %lu", error);
-        MessageBoxW(NULL, errorMsg, L"Error", MB_OK | MB_ICONERROR);
-        return FALSE;
-    }
-    
-    return TRUE;
+    return CredWriteW(&cred, 0);
 }
 
 /*
@@ -191,6 +206,20 @@ BOOL SaveRDPCredentials(const wchar_t* hostname, const wchar_t* username,
     return SaveCredentials(targetName, username, password);
 }
 
+/*
+ * WriteRDPCredentials - SaveRDPCredentials without the error message
+ * 
+ * For worker threads; on failure GetLastError() has the reason.
+ */
+BOOL WriteRDPCredentials(const wchar_t* hostname, const wchar_t* username, 
+                         const wchar_t* password)
+{
+    wchar_t targetName[512];
+    swprintf_s(targetName, 512, L"%s%s", CRED_TARGET_PREFIX, hostname);
+    
+    return WriteCredentials(targetName, username, password);
+}
+
 /*
  * LoadRDPCredentials - Load credentials for a specific RDP host
  * 
@@ -140,6 +140,21 @@ void ApplyDarkModeToListView(HWND hListView)
     }
 }
 
+/*
+ * ApplyDarkModeToTreeView - Apply dark mode to a TreeView control
+ * 
+ * Sets colors for the TreeView to match dark theme.
+ */
+void ApplyDarkModeToTreeView(HWND hTreeView)
+{
+    if (!g_bDarkModeEnabled)
+        return;
+    
+    TreeView_SetTextColor(hTreeView, DARK_TEXT_COLOR);
+    TreeView_SetBkColor(hTreeView, DARK_CONTROL_BG);
+    TreeView_SetLineColor(hTreeView, DARK_BORDER_COLOR);
+}
+
 /*
  * HandleDarkModeMessages - Process WM_CTLCOLOR* messages for dark mode
  * 
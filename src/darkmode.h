@@ -26,6 +26,7 @@ BOOL IsDarkModeEnabled(void);
 void InitDarkMode(void);
 void ApplyDarkModeToDialog(HWND hwnd);
 void ApplyDarkModeToListView(HWND hListView);
+void ApplyDarkModeToTreeView(HWND hTreeView);
 INT_PTR HandleDarkModeMessages(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
 #endif // DARKMODE_H
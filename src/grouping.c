@@ -0,0 +1,323 @@
+/*
+ * Host Grouping Module
+ *
+ * Groups hosts for the main window's tree view.
+ *
+ * Building the groups is two linear passes over the hosts:
+ *   1. Work out each host's group name and look it up in a hash table,
+ *      creating the group the first time the name is seen and counting
+ *      its members.
+ *   2. Lay the members of every group out back to back in one array
+ *      (a counting sort), keeping the order the hosts were passed in.
+ *
+ * Only the group names are sorted, so building is O(hosts + groups log
+ * groups) and the members of a group are a ready-made slice the tree can
+ * insert when the group is expanded.
+ *
+ * Learning points:
+ *   - Open addressing hash tables
+ *   - Counting sort to bucket items without moving them one by one
+ *   - Sorting with a remap table when other arrays refer to positions
+ */
+
+#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wctype.h>
+#include "grouping.h"
+
+typedef struct {
+    const wchar_t* name;    // Points into the name pool once building is done
+    int nameOffset;
+    int first;              // Offset of the first member in HostGroups.members
+    int count;
+    int buildId;            // Position before sorting
+} HostGroup;
+
+struct HostGroups {
+    HostGroup* groups;
+    int groupCount;
+    int* members;           // Host indices, grouped
+    wchar_t* names;         // Group names, NUL separated
+};
+
+/*
+ * IsIPv4Address - TRUE if a hostname is made of digits and dots only
+ */
+static BOOL IsIPv4Address(const wchar_t* hostname)
+{
+    if (hostname[0] == L'\0')
+        return FALSE;
+
+    for (const wchar_t* p = hostname; *p != L'\0'; p++)
+    {
+        if (!(*p >= L'0' && *p <= L'9') && *p != L'.')
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * GetHostGroupKey - Name of the group a host belongs to
+ *
+ * Parameters:
+ *   host   - Host to classify
+ *   mode   - GROUP_BY_DOMAIN or GROUP_BY_NAME_PREFIX
+ *   key    - Receives the group name (lowercase)
+ *   keyLen - Size of key in characters
+ *
+ * Domain: everything after the first dot ("(no domain)" for short names,
+ * "(IP addresses)" for IPv4 addresses).
+ * Name prefix: the first label up to its first digit, without trailing
+ * '-' or '_' ("sql-prod-01" -> "sql-prod"; "(other)" if nothing is left).
+ */
+void GetHostGroupKey(const Host* host, GroupMode mode, wchar_t* key, int keyLen)
+{
+    const wchar_t* hostname = host->hostname;
+    int length = 0;
+
+    if (IsIPv4Address(hostname))
+    {
+        wcsncpy_s(key, keyLen, L"(IP addresses)", _TRUNCATE);
+        return;
+    }
+
+    if (mode == GROUP_BY_DOMAIN)
+    {
+        const wchar_t* dot = wcschr(hostname, L'.');
+        if (dot == NULL || dot[1] == L'\0')
+        {
+            wcsncpy_s(key, keyLen, L"(no domain)", _TRUNCATE);
+            return;
+        }
+
+        for (const wchar_t* p = dot + 1; *p != L'\0' && length < keyLen - 1; p++)
+            key[length++] = (wchar_t)towlower(*p);
+    }
+    else
+    {
+        for (const wchar_t* p = hostname; *p != L'\0' && *p != L'.' && length < keyLen - 1; p++)
+        {
+            if (*p >= L'0' && *p <= L'9')
+                break;
+            key[length++] = (wchar_t)towlower(*p);
+        }
+        while (length > 0 && (key[length - 1] == L'-' || key[length - 1] == L'_'))
+            length--;
+
+        if (length == 0)
+        {
+            wcsncpy_s(key, keyLen, L"(other)", _TRUNCATE);
+            return;
+        }
+    }
+
+    key[length] = L'\0';
+}
+
+/*
+ * HashName - FNV-1a hash of a group name
+ */
+static unsigned int HashName(const wchar_t* name)
+{
+    unsigned int hash = 2166136261u;
+    for (; *name != L'\0'; name++)
+    {
+        hash ^= (unsigned int)*name;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * CompareGroupNames - qsort callback ordering groups by name
+ */
+static int CompareGroupNames(const void* a, const void* b)
+{
+    return wcscmp(((const HostGroup*)a)->name, ((const HostGroup*)b)->name);
+}
+
+/*
+ * BuildHostGroups - Group a list of hosts
+ *
+ * Parameters:
+ *   hosts   - Host array
+ *   indices - Hosts to group (indices into hosts), in display order
+ *   count   - Number of entries in indices
+ *   mode    - GROUP_BY_DOMAIN or GROUP_BY_NAME_PREFIX
+ *
+ * Returns the groups (free with FreeHostGroups), or NULL on failure.
+ */
+HostGroups* BuildHostGroups(const Host* hosts, const int* indices, int count, GroupMode mode)
+{
+    HostGroups* result = (HostGroups*)calloc(1, sizeof(HostGroups));
+    int* hostGroup = (int*)malloc((count > 0 ? count : 1) * sizeof(int));
+    int tableSize = 16;
+    while (tableSize < count * 2)
+        tableSize *= 2;
+    int* table = (int*)malloc(tableSize * sizeof(int));
+    int groupCapacity = 16;
+    int namesLength = 0;
+    int namesCapacity = 1024;
+
+    if (result != NULL)
+    {
+        result->groups = (HostGroup*)malloc(groupCapacity * sizeof(HostGroup));
+        result->names = (wchar_t*)malloc(namesCapacity * sizeof(wchar_t));
+        result->members = (int*)malloc((count > 0 ? count : 1) * sizeof(int));
+    }
+    if (result == NULL || hostGroup == NULL || table == NULL || result->groups == NULL ||
+        result->names == NULL || result->members == NULL)
+    {
+        free(hostGroup);
+        free(table);
+        FreeHostGroups(result);
+        return NULL;
+    }
+    memset(table, 0xFF, tableSize * sizeof(int));
+
+    // Pass 1: find (or create) each host's group and count members
+    BOOL failed = FALSE;
+    for (int i = 0; i < count && !failed; i++)
+    {
+        wchar_t key[MAX_HOSTNAME_LEN];
+        GetHostGroupKey(&hosts[indices[i]], mode, key, MAX_HOSTNAME_LEN);
+
+        unsigned int slot = HashName(key) & (tableSize - 1);
+        int group;
+        for (;;)
+        {
+            group = table[slot];
+            if (group < 0 || wcscmp(result->names + result->groups[group].nameOffset, key) == 0)
+                break;
+            slot = (slot + 1) & (tableSize - 1);
+        }
+
+        if (group < 0)
+        {
+            // First host in this group
+            int keyLength = (int)wcslen(key) + 1;
+            if (namesLength + keyLength > namesCapacity)
+            {
+                int newCapacity = namesCapacity * 2 + keyLength;
+                wchar_t* newNames = (wchar_t*)realloc(result->names, newCapacity * sizeof(wchar_t));
+                if (newNames == NULL)
+                {
+                    failed = TRUE;
+                    break;
+                }
+                result->names = newNames;
+                namesCapacity = newCapacity;
+            }
+            if (result->groupCount == groupCapacity)
+            {
+                HostGroup* newGroups = (HostGroup*)realloc(result->groups, groupCapacity * 2 * sizeof(HostGroup));
+                if (newGroups == NULL)
+                {
+                    failed = TRUE;
+                    break;
+                }
+                result->groups = newGroups;
+                groupCapacity *= 2;
+            }
+
+            group = result->groupCount++;
+            memcpy(result->names + namesLength, key, keyLength * sizeof(wchar_t));
+            result->groups[group].nameOffset = namesLength;
+            result->groups[group].count = 0;
+            result->groups[group].buildId = group;
+            namesLength += keyLength;
+            table[slot] = group;
+        }
+
+        hostGroup[i] = group;
+        result->groups[group].count++;
+    }
+    free(table);
+
+    if (failed)
+    {
+        free(hostGroup);
+        FreeHostGroups(result);
+        return NULL;
+    }
+
+    // Sort the groups by name, remembering where each one moved
+    for (int g = 0; g < result->groupCount; g++)
+        result->groups[g].name = result->names + result->groups[g].nameOffset;
+    qsort(result->groups, result->groupCount, sizeof(HostGroup), CompareGroupNames);
+
+    int* remap = (int*)malloc((result->groupCount > 0 ? result->groupCount : 1) * sizeof(int));
+    if (remap == NULL)
+    {
+        free(hostGroup);
+        FreeHostGroups(result);
+        return NULL;
+    }
+
+    int offset = 0;
+    for (int g = 0; g < result->groupCount; g++)
+    {
+        remap[result->groups[g].buildId] = g;
+        result->groups[g].first = offset;
+        offset += result->groups[g].count;
+        result->groups[g].count = 0;
+    }
+
+    // Pass 2: drop every host into its group's slice, keeping list order
+    for (int i = 0; i < count; i++)
+    {
+        HostGroup* group = &result->groups[remap[hostGroup[i]]];
+        result->members[group->first + group->count++] = indices[i];
+    }
+
+    free(remap);
+    free(hostGroup);
+    return result;
+}
+
+/*
+ * FreeHostGroups - Free groups built by BuildHostGroups
+ */
+void FreeHostGroups(HostGroups* groups)
+{
+    if (groups == NULL)
+        return;
+
+    free(groups->groups);
+    free(groups->members);
+    free(groups->names);
+    free(groups);
+}
+
+/*
+ * GetHostGroupCount - Number of groups
+ */
+int GetHostGroupCount(const HostGroups* groups)
+{
+    return (groups != NULL) ? groups->groupCount : 0;
+}
+
+/*
+ * GetHostGroupName - Name of a group
+ */
+const wchar_t* GetHostGroupName(const HostGroups* groups, int group)
+{
+    return groups->groups[group].name;
+}
+
+/*
+ * GetHostGroupMembers - Host indices in a group
+ *
+ * Parameters:
+ *   groups  - Groups from BuildHostGroups
+ *   group   - Group number (0 .. GetHostGroupCount - 1)
+ *   members - Receives a pointer to the host indices (valid until FreeHostGroups)
+ *
+ * Returns the number of hosts in the group.
+ */
+int GetHostGroupMembers(const HostGroups* groups, int group, const int** members)
+{
+    *members = groups->members + groups->groups[group].first;
+    return groups->groups[group].count;
+}
@@ -0,0 +1,38 @@
+/*
+ * Host Grouping Header
+ *
+ * Splits a list of hosts into named groups (by DNS domain or by hostname
+ * prefix) for the main window's tree view. Grouping is done once per list
+ * change in a single pass; the tree only asks for a group's members when
+ * that group is expanded.
+ */
+
+#ifndef GROUPING_H
+#define GROUPING_H
+
+#include <windows.h>
+#include "hosts.h"
+
+// How the main window groups hosts
+typedef enum {
+    GROUP_BY_NONE = 0,          // Flat list
+    GROUP_BY_DOMAIN,            // "web01.corp.example.com" -> "corp.example.com"
+    GROUP_BY_NAME_PREFIX,       // "web01-eu" -> "web"
+    GROUP_BY_COUNT
+} GroupMode;
+
+typedef struct HostGroups HostGroups;
+
+// Group the hosts listed in indices (kept in that order inside each group)
+HostGroups* BuildHostGroups(const Host* hosts, const int* indices, int count, GroupMode mode);
+void FreeHostGroups(HostGroups* groups);
+
+// Groups are sorted by name
+int GetHostGroupCount(const HostGroups* groups);
+const wchar_t* GetHostGroupName(const HostGroups* groups, int group);
+int GetHostGroupMembers(const HostGroups* groups, int group, const int** members);
+
+// Name of the group a single host belongs to
+void GetHostGroupKey(const Host* host, GroupMode mode, wchar_t* key, int keyLen);
+
+#endif // GROUPING_H
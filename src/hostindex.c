@@ -0,0 +1,648 @@
+/*
+ * Host Index Module
+ *
+ * Keeps the host list ordered by each sortable column (hostname,
+ * description, last connected) so that the ListViews can show a sorted
+ * list without sorting it again after every refresh.
+ *
+ * Each column has a skip list: a sorted linked list with extra "express
+ * lane" pointers on randomly chosen nodes, which makes search, insert and
+ * delete O(log n) on average without the rebalancing a tree needs. Every
+ * host has one entry that is linked into all three lists.
+ *
+ * The rest of the application still loads the whole host file after each
+ * change, so SyncHostIndex compares the new array with the entries it
+ * already has (found by hostname through a hash table):
+ *
+ *   - new hostname           -> insert into every list
+ *   - description changed    -> move within the description list
+ *   - last connected changed -> move within the last connected list
+ *   - hostname gone          -> remove from every list
+ *
+ * Unchanged hosts only have their array position updated, so an edit or
+ * a connection costs O(log n) list work instead of a full sort.
+ *
+ * Learning points:
+ *   - Skip lists (randomised balanced ordering)
+ *   - Chained hash tables
+ *   - Producing a sorted, filtered view by walking an ordered index
+ */
+
+#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "hostindex.h"
+
+// Skip list tuning: up to 2^24 entries stay O(log n); each level is 1/4 as full
+#define SKIP_MAX_LEVEL 24
+#define SKIP_LEVEL_PROBABILITY_MASK 3
+
+// Number of indexed columns (SORT_COLUMN_HOSTNAME .. SORT_COLUMN_LAST_CONNECTED)
+#define INDEX_COLUMNS 3
+
+// Initial hash table size (must be a power of two)
+#define INDEX_INITIAL_BUCKETS 256
+
+typedef struct HostIndexEntry HostIndexEntry;
+
+struct HostIndexEntry {
+    wchar_t hostname[MAX_HOSTNAME_LEN];
+    ULONGLONG descriptionHash;          // Detects description edits without keeping a copy
+    ULONGLONG lastConnectedKey;         // Numeric timestamp key ("Never" = largest)
+    BYTE* hostnameKey;                  // Collation keys from hostsort.c
+    BYTE* descriptionKey;
+    ULONG serial;                       // Insertion number - final tie-breaker
+    int hostIndex;                      // Position in the current host array
+    BOOL seen;                          // Scratch flag used by SyncHostIndex
+    HostIndexEntry* hashNext;           // Next entry in the same hash bucket
+    int levels[INDEX_COLUMNS];          // Height of this node in each skip list
+    HostIndexEntry** next[INDEX_COLUMNS]; // Forward pointers, one per level
+    HostIndexEntry* prev[INDEX_COLUMNS];  // Backward pointer on level 0 (for descending walks)
+};
+
+struct HostIndex {
+    HostIndexEntry* head[INDEX_COLUMNS][SKIP_MAX_LEVEL];   // First node on each level
+    HostIndexEntry* tail[INDEX_COLUMNS];                   // Last node on level 0
+    int level[INDEX_COLUMNS];                              // Levels currently in use
+    HostIndexEntry** buckets;
+    int bucketCount;
+    int entryCount;
+    ULONG nextSerial;
+    ULONG randomState;
+    BOOL valid;                         // FALSE after a failed sync
+};
+
+/*
+ * HashDescription - 64-bit FNV-1a of a description (case matters)
+ */
+static ULONGLONG HashDescription(const wchar_t* text)
+{
+    ULONGLONG hash = 14695981039346656037ULL;
+    for (const wchar_t* p = text; *p != L'\0'; p++)
+    {
+        hash ^= (ULONGLONG)*p;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/*
+ * RandomLevel - Pick the height of a new skip list node
+ */
+static int RandomLevel(HostIndex* index)
+{
+    int level = 1;
+    for (;;)
+    {
+        // xorshift32 - fast and good enough for balancing
+        ULONG x = index->randomState;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        index->randomState = x;
+
+        if ((x & SKIP_LEVEL_PROBABILITY_MASK) != 0 || level >= SKIP_MAX_LEVEL)
+            return level;
+        level++;
+    }
+}
+
+/*
+ * CompareEntryColumn - Compare two entries on one column only
+ */
+static int CompareEntryColumn(int column, const HostIndexEntry* a, const HostIndexEntry* b)
+{
+    switch (column)
+    {
+        case SORT_COLUMN_HOSTNAME:
+            return strcmp((const char*)a->hostnameKey, (const char*)b->hostnameKey);
+
+        case SORT_COLUMN_DESCRIPTION:
+            return strcmp((const char*)a->descriptionKey, (const char*)b->descriptionKey);
+
+        case SORT_COLUMN_LAST_CONNECTED:
+            return (a->lastConnectedKey < b->lastConnectedKey) ? -1 :
+                   (a->lastConnectedKey > b->lastConnectedKey) ? 1 : 0;
+    }
+    return 0;
+}
+
+/*
+ * CompareEntries - Total order used inside a column's skip list
+ *
+ * Ties are broken by hostname and then insertion number, so every entry
+ * has exactly one position and can always be found again for removal.
+ */
+static int CompareEntries(int column, const HostIndexEntry* a, const HostIndexEntry* b)
+{
+    int result = CompareEntryColumn(column, a, b);
+    if (result == 0 && column != SORT_COLUMN_HOSTNAME)
+        result = CompareEntryColumn(SORT_COLUMN_HOSTNAME, a, b);
+    if (result == 0)
+        result = (a->serial < b->serial) ? -1 : (a->serial > b->serial) ? 1 : 0;
+    return result;
+}
+
+/*
+ * NextOf - Forward pointer of node (or of the list head when node is NULL)
+ */
+static HostIndexEntry** NextOf(HostIndex* index, int list, HostIndexEntry* node)
+{
+    return (node == NULL) ? index->head[list] : node->next[list];
+}
+
+/*
+ * FindPredecessors - Find, on every level, the last node before entry
+ *
+ * update[level] receives that node, or NULL for the list head.
+ */
+static void FindPredecessors(HostIndex* index, int list, const HostIndexEntry* entry,
+                             HostIndexEntry* update[SKIP_MAX_LEVEL])
+{
+    int column = list + 1;
+    HostIndexEntry* node = NULL;
+
+    for (int level = index->level[list] - 1; level >= 0; level--)
+    {
+        HostIndexEntry* next;
+        while ((next = NextOf(index, list, node)[level]) != NULL &&
+               CompareEntries(column, next, entry) < 0)
+        {
+            node = next;
+        }
+        update[level] = node;
+    }
+}
+
+/*
+ * SkipListInsert - Link an entry into one column's skip list
+ */
+static void SkipListInsert(HostIndex* index, int list, HostIndexEntry* entry)
+{
+    HostIndexEntry* update[SKIP_MAX_LEVEL];
+    FindPredecessors(index, list, entry, update);
+
+    int levels = entry->levels[list];
+    for (int level = index->level[list]; level < levels; level++)
+    {
+        update[level] = NULL;   // New levels start at the head
+    }
+    if (levels > index->level[list])
+        index->level[list] = levels;
+
+    for (int level = 0; level < levels; level++)
+    {
+        HostIndexEntry** link = NextOf(index, list, update[level]);
+        entry->next[list][level] = link[level];
+        link[level] = entry;
+    }
+
+    // Maintain the level 0 back pointers
+    HostIndexEntry* after = entry->next[list][0];
+    entry->prev[list] = update[0];
+    if (after != NULL)
+        after->prev[list] = entry;
+    else
+        index->tail[list] = entry;
+}
+
+/*
+ * SkipListRemove - Unlink an entry from one column's skip list
+ */
+static void SkipListRemove(HostIndex* index, int list, HostIndexEntry* entry)
+{
+    HostIndexEntry* update[SKIP_MAX_LEVEL];
+    FindPredecessors(index, list, entry, update);
+
+    for (int level = 0; level < entry->levels[list]; level++)
+    {
+        HostIndexEntry** link = NextOf(index, list, update[level]);
+        if (link[level] == entry)
+            link[level] = entry->next[list][level];
+    }
+
+    HostIndexEntry* after = entry->next[list][0];
+    if (after != NULL)
+        after->prev[list] = entry->prev[list];
+    else
+        index->tail[list] = entry->prev[list];
+
+    // Drop levels that became empty
+    while (index->level[list] > 1 && index->head[list][index->level[list] - 1] == NULL)
+        index->level[list]--;
+}
+
+/*
+ * FreeEntry - Release an entry's memory (it must already be unlinked)
+ */
+static void FreeEntry(HostIndexEntry* entry)
+{
+    free(entry->hostnameKey);
+    free(entry->descriptionKey);
+    for (int list = 0; list < INDEX_COLUMNS; list++)
+        free(entry->next[list]);
+    free(entry);
+}
+
+/*
+ * CreateEntry - Build an entry (keys and skip list nodes) for a host
+ */
+static HostIndexEntry* CreateEntry(HostIndex* index, const Host* host, int hostIndex)
+{
+    HostIndexEntry* entry = (HostIndexEntry*)calloc(1, sizeof(HostIndexEntry));
+    if (entry == NULL)
+        return NULL;
+
+    wcsncpy_s(entry->hostname, MAX_HOSTNAME_LEN, host->hostname, _TRUNCATE);
+    entry->descriptionHash = HashDescription(host->description);
+    entry->lastConnectedKey = TimestampSortKey(host->lastConnected);
+    entry->hostnameKey = CreateSortKey(host->hostname);
+    entry->descriptionKey = CreateSortKey(host->description);
+    entry->serial = index->nextSerial++;
+    entry->hostIndex = hostIndex;
+
+    BOOL ok = (entry->hostnameKey != NULL && entry->descriptionKey != NULL);
+    for (int list = 0; ok && list < INDEX_COLUMNS; list++)
+    {
+        entry->levels[list] = RandomLevel(index);
+        entry->next[list] = (HostIndexEntry**)calloc(entry->levels[list], sizeof(HostIndexEntry*));
+        ok = (entry->next[list] != NULL);
+    }
+
+    if (!ok)
+    {
+        FreeEntry(entry);
+        return NULL;
+    }
+    return entry;
+}
+
+/*
+ * HashBucket - Bucket number for a hostname (case-insensitive)
+ */
+static int HashBucket(const HostIndex* index, const wchar_t* hostname)
+{
+    return (int)(HashHostKey(hostname) & (ULONGLONG)(index->bucketCount - 1));
+}
+
+/*
+ * GrowBuckets - Double the hash table once it is more than 3/4 full
+ */
+static void GrowBuckets(HostIndex* index)
+{
+    if (index->entryCount * 4 < index->bucketCount * 3)
+        return;
+
+    int newCount = index->bucketCount * 2;
+    HostIndexEntry** newBuckets = (HostIndexEntry**)calloc(newCount, sizeof(HostIndexEntry*));
+    if (newBuckets == NULL)
+        return;  // Keep the old table - chains just get longer
+
+    HostIndexEntry** oldBuckets = index->buckets;
+    int oldCount = index->bucketCount;
+    index->buckets = newBuckets;
+    index->bucketCount = newCount;
+
+    for (int b = 0; b < oldCount; b++)
+    {
+        HostIndexEntry* entry = oldBuckets[b];
+        while (entry != NULL)
+        {
+            HostIndexEntry* next = entry->hashNext;
+            int bucket = HashBucket(index, entry->hostname);
+            entry->hashNext = newBuckets[bucket];
+            newBuckets[bucket] = entry;
+            entry = next;
+        }
+    }
+    free(oldBuckets);
+}
+
+/*
+ * FindUnseenEntry - Look up an entry by hostname that this sync has not matched yet
+ *
+ * Skipping entries already matched keeps duplicate hostnames in a hand-edited
+ * hosts file as separate entries.
+ */
+static HostIndexEntry* FindUnseenEntry(const HostIndex* index, const wchar_t* hostname)
+{
+    for (HostIndexEntry* entry = index->buckets[HashBucket(index, hostname)];
+         entry != NULL; entry = entry->hashNext)
+    {
+        if (!entry->seen && _wcsicmp(entry->hostname, hostname) == 0)
+            return entry;
+    }
+    return NULL;
+}
+
+/*
+ * AddEntry - Insert a new entry into the hash table and every skip list
+ */
+static void AddEntry(HostIndex* index, HostIndexEntry* entry)
+{
+    int bucket = HashBucket(index, entry->hostname);
+    entry->hashNext = index->buckets[bucket];
+    index->buckets[bucket] = entry;
+    index->entryCount++;
+
+    for (int list = 0; list < INDEX_COLUMNS; list++)
+        SkipListInsert(index, list, entry);
+
+    GrowBuckets(index);
+}
+
+/*
+ * RemoveEntry - Take an entry out of the hash table and every skip list
+ */
+static void RemoveEntry(HostIndex* index, HostIndexEntry* entry)
+{
+    HostIndexEntry** link = &index->buckets[HashBucket(index, entry->hostname)];
+    while (*link != NULL && *link != entry)
+        link = &(*link)->hashNext;
+    if (*link == entry)
+        *link = entry->hashNext;
+    index->entryCount--;
+
+    for (int list = 0; list < INDEX_COLUMNS; list++)
+        SkipListRemove(index, list, entry);
+}
+
+/*
+ * ClearIndex - Remove and free every entry
+ */
+static void ClearIndex(HostIndex* index)
+{
+    for (int b = 0; b < index->bucketCount; b++)
+    {
+        HostIndexEntry* entry = index->buckets[b];
+        while (entry != NULL)
+        {
+            HostIndexEntry* next = entry->hashNext;
+            FreeEntry(entry);
+            entry = next;
+        }
+        index->buckets[b] = NULL;
+    }
+
+    memset(index->head, 0, sizeof(index->head));
+    memset(index->tail, 0, sizeof(index->tail));
+    for (int list = 0; list < INDEX_COLUMNS; list++)
+        index->level[list] = 1;
+    index->entryCount = 0;
+}
+
+/*
+ * CreateHostIndex - Create an empty index
+ *
+ * Returns NULL if memory could not be allocated.
+ */
+HostIndex* CreateHostIndex(void)
+{
+    HostIndex* index = (HostIndex*)calloc(1, sizeof(HostIndex));
+    if (index == NULL)
+        return NULL;
+
+    index->bucketCount = INDEX_INITIAL_BUCKETS;
+    index->buckets = (HostIndexEntry**)calloc(index->bucketCount, sizeof(HostIndexEntry*));
+    if (index->buckets == NULL)
+    {
+        free(index);
+        return NULL;
+    }
+
+    for (int list = 0; list < INDEX_COLUMNS; list++)
+        index->level[list] = 1;
+    index->randomState = GetTickCount() | 1;
+    index->valid = TRUE;
+    return index;
+}
+
+/*
+ * FreeHostIndex - Free an index and all its entries
+ */
+void FreeHostIndex(HostIndex* index)
+{
+    if (index == NULL)
+        return;
+
+    ClearIndex(index);
+    free(index->buckets);
+    free(index);
+}
+
+/*
+ * SyncHostIndex - Update the index to match a freshly loaded host array
+ *
+ * Parameters:
+ *   index     - Index to update
+ *   hosts     - Current host array
+ *   hostCount - Number of hosts
+ *
+ * Only hosts that were added, removed or changed touch the skip lists.
+ * Returns FALSE if memory ran out; the index is then emptied and
+ * GetSortedHostView reports it as unavailable until the next sync succeeds.
+ */
+BOOL SyncHostIndex(HostIndex* index, const Host* hosts, int hostCount)
+{
+    if (index == NULL)
+        return FALSE;
+
+    // Start from scratch after a failure so no half-updated state survives
+    if (!index->valid)
+        ClearIndex(index);
+
+    for (int b = 0; b < index->bucketCount; b++)
+    {
+        for (HostIndexEntry* entry = index->buckets[b]; entry != NULL; entry = entry->hashNext)
+            entry->seen = FALSE;
+    }
+
+    HostIndexEntry* added = NULL;  // New entries, linked in after matching finishes
+
+    for (int i = 0; i < hostCount; i++)
+    {
+        HostIndexEntry* entry = FindUnseenEntry(index, hosts[i].hostname);
+
+        if (entry == NULL)
+        {
+            entry = CreateEntry(index, &hosts[i], i);
+            if (entry == NULL)
+            {
+                while (added != NULL)
+                {
+                    HostIndexEntry* next = added->hashNext;
+                    FreeEntry(added);
+                    added = next;
+                }
+                ClearIndex(index);
+                index->valid = FALSE;
+                return FALSE;
+            }
+            entry->seen = TRUE;
+            entry->hashNext = added;
+            added = entry;
+            continue;
+        }
+
+        entry->seen = TRUE;
+        entry->hostIndex = i;
+
+        // Description edited - move it within the description list
+        ULONGLONG descriptionHash = HashDescription(hosts[i].description);
+        if (descriptionHash != entry->descriptionHash)
+        {
+            BYTE* newKey = CreateSortKey(hosts[i].description);
+            if (newKey != NULL)
+            {
+                SkipListRemove(index, SORT_COLUMN_DESCRIPTION - 1, entry);
+                free(entry->descriptionKey);
+                entry->descriptionKey = newKey;
+                entry->descriptionHash = descriptionHash;
+                SkipListInsert(index, SORT_COLUMN_DESCRIPTION - 1, entry);
+            }
+        }
+
+        // Connected since the last sync - move it within the last connected list
+        ULONGLONG lastConnectedKey = TimestampSortKey(hosts[i].lastConnected);
+        if (lastConnectedKey != entry->lastConnectedKey)
+        {
+            SkipListRemove(index, SORT_COLUMN_LAST_CONNECTED - 1, entry);
+            entry->lastConnectedKey = lastConnectedKey;
+            SkipListInsert(index, SORT_COLUMN_LAST_CONNECTED - 1, entry);
+        }
+    }
+
+    // Remove hosts that are no longer in the array
+    for (int b = 0; b < index->bucketCount; b++)
+    {
+        HostIndexEntry* entry = index->buckets[b];
+        while (entry != NULL)
+        {
+            HostIndexEntry* next = entry->hashNext;
+            if (!entry->seen)
+            {
+                RemoveEntry(index, entry);
+                FreeEntry(entry);
+            }
+            entry = next;
+        }
+    }
+
+    // Link in the new hosts
+    while (added != NULL)
+    {
+        HostIndexEntry* next = added->hashNext;
+        AddEntry(index, added);
+        added = next;
+    }
+
+    index->valid = TRUE;
+    return TRUE;
+}
+
+/*
+ * SortRunBySecondary - Order a run of primary-column ties by the secondary column
+ *
+ * A stable merge sort, using temp (count pointers) as scratch space. Runs can
+ * be large (e.g. every host that was "Never" connected), so no insertion sort.
+ */
+static void SortRunBySecondary(HostIndexEntry** run, HostIndexEntry** temp, int count,
+                               int column, BOOL ascending)
+{
+    if (count < 2)
+        return;
+
+    int half = count / 2;
+    SortRunBySecondary(run, temp, half, column, ascending);
+    SortRunBySecondary(run + half, temp + half, count - half, column, ascending);
+
+    int i = 0, j = half, k = 0;
+    while (i < half && j < count)
+    {
+        int result = CompareEntryColumn(column, run[i], run[j]);
+        if ((ascending ? result : -result) <= 0)
+            temp[k++] = run[i++];
+        else
+            temp[k++] = run[j++];
+    }
+    while (i < half)
+        temp[k++] = run[i++];
+    while (j < count)
+        temp[k++] = run[j++];
+    memcpy(run, temp, count * sizeof(HostIndexEntry*));
+}
+
+/*
+ * GetSortedHostView - Produce host indices in sorted order
+ *
+ * Parameters:
+ *   index     - Index synced with the current host array
+ *   spec      - Columns and directions to sort by
+ *   include   - Per-host flags (hostCount bytes), non-zero = show; NULL = all
+ *   hostCount - Number of hosts in the array the index was synced with
+ *   out       - Receives the sorted host indices (room for hostCount ints)
+ *
+ * The primary column's skip list is walked forwards or backwards and hosts
+ * not in the filter are skipped - no sorting happens. Only groups of hosts
+ * that tie on the primary column are ordered by the secondary column.
+ *
+ * Returns the number of indices written, or -1 if the index is unusable
+ * (or a column is not indexed: latencies change without the hosts changing).
+ */
+int GetSortedHostView(const HostIndex* index, const HostSortSpec* spec,
+                      const BYTE* include, int hostCount, int* out)
+{
+    if (index == NULL || !index->valid || index->entryCount != hostCount ||
+        spec->primaryColumn < SORT_COLUMN_HOSTNAME || spec->primaryColumn > SORT_COLUMN_LAST_CONNECTED ||
+        spec->secondaryColumn > SORT_COLUMN_LAST_CONNECTED)
+    {
+        return -1;
+    }
+
+    int list = spec->primaryColumn - 1;
+    BOOL useSecondary = (spec->secondaryColumn != SORT_COLUMN_NONE &&
+                         spec->secondaryColumn != spec->primaryColumn);
+
+    HostIndexEntry** run = NULL;
+    if (useSecondary)
+    {
+        // One allocation: the run itself followed by merge scratch space
+        run = (HostIndexEntry**)malloc((hostCount > 0 ? hostCount : 1) * 2 * sizeof(HostIndexEntry*));
+        if (run == NULL)
+            useSecondary = FALSE;
+    }
+
+    int written = 0;
+    int runCount = 0;
+    HostIndexEntry* entry = spec->primaryAscending ? index->head[list][0] : index->tail[list];
+
+    while (entry != NULL)
+    {
+        HostIndexEntry* following = spec->primaryAscending ? entry->next[list][0] : entry->prev[list];
+
+        if (entry->hostIndex >= 0 && entry->hostIndex < hostCount &&
+            (include == NULL || include[entry->hostIndex]))
+        {
+            if (useSecondary)
+                run[runCount++] = entry;
+            else
+                out[written++] = entry->hostIndex;
+        }
+
+        // End of a group of primary-column ties - order it by the secondary column
+        if (useSecondary && runCount > 0 &&
+            (following == NULL || CompareEntryColumn(spec->primaryColumn, entry, following) != 0))
+        {
+            SortRunBySecondary(run, run + hostCount, runCount, spec->secondaryColumn, spec->secondaryAscending);
+            for (int i = 0; i < runCount; i++)
+                out[written++] = run[i]->hostIndex;
+            runCount = 0;
+        }
+
+        entry = following;
+    }
+
+    free(run);
+    return written;
+}
@@ -0,0 +1,31 @@
+/*
+ * Host Index Header
+ *
+ * Ordered indexes over the host list, one per sortable column, kept up to
+ * date as hosts are added, edited and deleted. A sorted view of the list
+ * (optionally filtered) is produced by walking an index in order, so the
+ * list never has to be re-sorted from scratch.
+ */
+
+#ifndef HOSTINDEX_H
+#define HOSTINDEX_H
+
+#include <windows.h>
+#include "hosts.h"
+#include "hostsort.h"
+
+typedef struct HostIndex HostIndex;
+
+// Create and destroy an index
+HostIndex* CreateHostIndex(void);
+void FreeHostIndex(HostIndex* index);
+
+// Bring the index in line with a (re)loaded host array
+BOOL SyncHostIndex(HostIndex* index, const Host* hosts, int hostCount);
+
+// Write the host indices in sorted order; include (may be NULL) flags which
+// host indices to keep. Returns the number written, or -1 if unavailable.
+int GetSortedHostView(const HostIndex* index, const HostSortSpec* spec,
+                      const BYTE* include, int hostCount, int* out);
+
+#endif // HOSTINDEX_H
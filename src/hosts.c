@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <wctype.h>
 #include "config.h"
 #include "hosts.h"
 #include "encryption.h"
@@ -31,6 +32,10 @@ static wchar_t* trim_whitespace(wchar_t* str);
 static BOOL parse_csv_line(wchar_t* line, Host* host);
 static BOOL get_hosts_file_path(wchar_t* path, size_t pathLen);
 
+// Window told about saves (see SetHostsChangedNotify)
+static HWND g_hwndHostsChanged = NULL;
+static UINT g_hostsChangedMessage = 0;
+
 /*
  * LoadHosts - Load all hosts from the CSV file
  * 
@@ -359,16 +364,17 @@ BOOL SaveHosts(const Host* hosts, int count)
      * This is more efficient than encrypting line-by-line.
      */
     
-    // Allocate a large buffer for CSV content (128KB should be plenty)
-    const DWORD BUFFER_SIZE = 128 * 1024;
-    csvBuffer = (BYTE*)malloc(BUFFER_SIZE);
+    // Start at 128KB and double whenever a line does not fit (a big scan
+    // import can save 100k hosts at once)
+    DWORD bufferSize = 128 * 1024;
+    csvBuffer = (BYTE*)malloc(bufferSize);
     if (csvBuffer == NULL)
     {
         return FALSE;
     }
     
     char* csvPtr = (char*)csvBuffer;
-    DWORD remainingSize = BUFFER_SIZE;
+    DWORD remainingSize = bufferSize;
     
     // Write UTF-8 BOM
     unsigned char bom[3] = {0xEF, 0xBB, 0xBF};
@@ -433,20 +439,27 @@ BOOL SaveHosts(const Host* hosts, int count)
         // Add newline
         lineLen += sprintf_s(line + lineLen, sizeof(line) - lineLen, "\r\n");
         
-        // Copy to buffer
-        if ((DWORD)lineLen < remainingSize)
+        // Grow the buffer if the line does not fit
+        if ((DWORD)lineLen >= remainingSize)
         {
-            memcpy(csvPtr, line, lineLen);
-            csvPtr += lineLen;
-            remainingSize -= lineLen;
-        }
-        else
-        {
-            // Buffer too small
-            free(csvBuffer);
-            MessageBoxW(NULL, L"CSV data too large to save.", L"Error", MB_OK | MB_ICONERROR);
-            return FALSE;
+            DWORD used = (DWORD)(csvPtr - (char*)csvBuffer);
+            BYTE* grown = (bufferSize <= MAXDWORD / 2) ? (BYTE*)realloc(csvBuffer, bufferSize * 2) : NULL;
+            if (grown == NULL)
+            {
+                free(csvBuffer);
+                MessageBoxW(NULL, L"CSV data too large to save.", L"Error", MB_OK | MB_ICONERROR);
+                return FALSE;
+            }
+            csvBuffer = grown;
+            csvPtr = (char*)csvBuffer + used;
+            remainingSize += bufferSize;
+            bufferSize *= 2;
         }
+        
+        // Copy to buffer
+        memcpy(csvPtr, line, lineLen);
+        csvPtr += lineLen;
+        remainingSize -= lineLen;
     }
     
     // Calculate actual CSV size
@@ -515,9 +528,32 @@ BOOL SaveHosts(const Host* hosts, int count)
     // Success!
     fclose(file);
     LocalFree(encryptedData);
+    
+    // Let long-lived views (the quick connect palette) pick up the change
+    if (g_hwndHostsChanged != NULL)
+        PostMessage(g_hwndHostsChanged, g_hostsChangedMessage, 0, 0);
+    
     return TRUE;
 }
 
+/*
+ * SetHostsChangedNotify - Ask for a message whenever SaveHosts succeeds
+ * 
+ * Parameters:
+ *   hwnd    - Window to post to (NULL to stop)
+ *   message - Message to post (wParam and lParam are 0)
+ * 
+ * Every add, edit, delete and "last connected" update goes through
+ * SaveHosts, so this is the one place that sees all changes. The message
+ * is posted rather than sent, so the receiver reloads after the caller
+ * has finished with its own copy of the list.
+ */
+void SetHostsChangedNotify(HWND hwnd, UINT message)
+{
+    g_hwndHostsChanged = hwnd;
+    g_hostsChangedMessage = message;
+}
+
 /*
  * AddHost - Add a new host to the list
  * 
@@ -607,6 +643,234 @@ BOOL AddHost(const wchar_t* hostname, const wchar_t* description)
     return result;
 }
 
+/*
+ * DiffHosts - Compare scan results with the saved hosts
+ * 
+ * Parameters:
+ *   hosts        - Saved hosts (as loaded by LoadHosts)
+ *   hostCount    - Number of saved hosts
+ *   hostnames    - Hostnames from the scan
+ *   descriptions - Matching descriptions
+ *   count        - Number of scan entries
+ *   diff         - Receives the added, updated and missing indices
+ *                  (free with FreeHostDiff)
+ * 
+ * Returns:
+ *   TRUE on success, FALSE if out of memory (diff is left empty)
+ * 
+ * Names compare case-insensitively. One hash table holds both the saved
+ * hosts and the new names seen so far, so each scan entry costs one
+ * lookup and a name listed twice in the scan is added once.
+ */
+BOOL DiffHosts(const Host* hosts, int hostCount, const wchar_t* const* hostnames,
+               const wchar_t* const* descriptions, int count, HostDiff* diff)
+{
+    memset(diff, 0, sizeof(HostDiff));
+    
+    // Open addressing table, at most half full:
+    // -1 = empty, >= 0 = saved host, <= -2 = scan entry -(value + 2)
+    int tableSize = 16;
+    while (tableSize < (hostCount + count) * 2)
+        tableSize *= 2;
+    int* table = (int*)malloc(tableSize * sizeof(int));
+    BYTE* seen = (BYTE*)calloc(hostCount + 1, 1);
+    diff->added = (int*)malloc((count + 1) * sizeof(int));
+    diff->updated = (int*)malloc((count + 1) * sizeof(int));
+    diff->updatedHosts = (int*)malloc((count + 1) * sizeof(int));
+    diff->missing = (int*)malloc((hostCount + 1) * sizeof(int));
+    if (table == NULL || seen == NULL || diff->added == NULL || diff->updated == NULL ||
+        diff->updatedHosts == NULL || diff->missing == NULL)
+    {
+        free(table);
+        free(seen);
+        FreeHostDiff(diff);
+        return FALSE;
+    }
+    memset(table, 0xFF, tableSize * sizeof(int));
+    
+    for (int i = 0; i < hostCount; i++)
+    {
+        unsigned int slot = (unsigned int)(HashHostKey(hosts[i].hostname) & (ULONGLONG)(tableSize - 1));
+        while (table[slot] != -1)
+            slot = (slot + 1) & (tableSize - 1);
+        table[slot] = i;
+    }
+    
+    for (int n = 0; n < count; n++)
+    {
+        unsigned int slot = (unsigned int)(HashHostKey(hostnames[n]) & (ULONGLONG)(tableSize - 1));
+        while (table[slot] != -1)
+        {
+            const wchar_t* name = (table[slot] >= 0) ? hosts[table[slot]].hostname : hostnames[-(table[slot] + 2)];
+            if (_wcsicmp(name, hostnames[n]) == 0)
+                break;
+            slot = (slot + 1) & (tableSize - 1);
+        }
+        
+        if (table[slot] == -1)
+        {
+            // New - remember it so a repeat later in the scan is not added twice
+            table[slot] = -(n + 2);
+            diff->added[diff->addedCount++] = n;
+        }
+        else if (table[slot] >= 0 && !seen[table[slot]])
+        {
+            int host = table[slot];
+            seen[host] = 1;
+            if (wcsncmp(hosts[host].description, descriptions[n], MAX_DESCRIPTION_LEN - 1) != 0)
+            {
+                diff->updated[diff->updatedCount] = n;
+                diff->updatedHosts[diff->updatedCount++] = host;
+            }
+            else
+            {
+                diff->unchangedCount++;
+            }
+        }
+        // else: listed earlier in this scan - the first entry counts
+    }
+    
+    for (int i = 0; i < hostCount; i++)
+    {
+        if (!seen[i])
+            diff->missing[diff->missingCount++] = i;
+    }
+    
+    free(seen);
+    free(table);
+    return TRUE;
+}
+
+/*
+ * FreeHostDiff - Free the index arrays of a HostDiff
+ */
+void FreeHostDiff(HostDiff* diff)
+{
+    free(diff->added);
+    free(diff->updated);
+    free(diff->updatedHosts);
+    free(diff->missing);
+    memset(diff, 0, sizeof(HostDiff));
+}
+
+/*
+ * ApplyHostDiff - Save the saved hosts plus a diff's additions and updates
+ * 
+ * Parameters:
+ *   hosts, hostCount   - The saved hosts the diff was made against
+ *   hostnames, descriptions - The scan entries the diff was made from
+ *   diff               - Result of DiffHosts
+ *   include            - One byte per scan entry, non-zero = apply it (NULL = all)
+ *   updateDescriptions - Also replace the descriptions that changed
+ *   addedCount, updatedCount - Receive how many were applied (may be NULL)
+ * 
+ * Returns:
+ *   TRUE on success (also when there was nothing to apply - then the file
+ *   is not written), FALSE if out of memory or the save failed
+ * 
+ * Missing hosts are kept: a scan of one domain says nothing about hosts
+ * added by hand or found elsewhere.
+ */
+BOOL ApplyHostDiff(const Host* hosts, int hostCount, const wchar_t* const* hostnames,
+                   const wchar_t* const* descriptions, const HostDiff* diff, const BYTE* include,
+                   BOOL updateDescriptions, int* addedCount, int* updatedCount)
+{
+    int adding = 0;
+    int updating = 0;
+    
+    for (int i = 0; i < diff->addedCount; i++)
+    {
+        if (include == NULL || include[diff->added[i]])
+            adding++;
+    }
+    for (int i = 0; updateDescriptions && i < diff->updatedCount; i++)
+    {
+        if (include == NULL || include[diff->updated[i]])
+            updating++;
+    }
+    
+    if (addedCount != NULL)
+        *addedCount = 0;
+    if (updatedCount != NULL)
+        *updatedCount = 0;
+    
+    // Only the delta is new, but the file is one encrypted blob - one write
+    if (adding == 0 && updating == 0)
+        return TRUE;
+    
+    Host* newHosts = (Host*)malloc((hostCount + adding) * sizeof(Host));
+    if (newHosts == NULL)
+        return FALSE;
+    if (hostCount > 0)
+        memcpy(newHosts, hosts, hostCount * sizeof(Host));
+    
+    for (int i = 0; updateDescriptions && i < diff->updatedCount; i++)
+    {
+        int n = diff->updated[i];
+        if (include == NULL || include[n])
+            wcsncpy_s(newHosts[diff->updatedHosts[i]].description, MAX_DESCRIPTION_LEN, descriptions[n], _TRUNCATE);
+    }
+    
+    int newCount = hostCount;
+    for (int i = 0; i < diff->addedCount; i++)
+    {
+        int n = diff->added[i];
+        if (include != NULL && !include[n])
+            continue;
+        
+        Host* host = &newHosts[newCount++];
+        wcsncpy_s(host->hostname, MAX_HOSTNAME_LEN, hostnames[n], _TRUNCATE);
+        wcsncpy_s(host->description, MAX_DESCRIPTION_LEN, descriptions[n], _TRUNCATE);
+        wcscpy_s(host->lastConnected, 64, L"Never");
+    }
+    
+    BOOL result = SaveHosts(newHosts, newCount);
+    free(newHosts);
+    
+    if (result && addedCount != NULL)
+        *addedCount = adding;
+    if (result && updatedCount != NULL)
+        *updatedCount = updating;
+    return result;
+}
+
+/*
+ * AddHosts - Add or update many hosts with a single load and save
+ * 
+ * Parameters:
+ *   hostnames    - Hostnames to add
+ *   descriptions - Matching descriptions
+ *   count        - Number of entries
+ * 
+ * Returns:
+ *   TRUE on success, FALSE on failure (nothing is saved)
+ * 
+ * Same rules as AddHost (an existing hostname just gets the new
+ * description), but calling AddHost in a loop loads, encrypts and writes
+ * the whole file once per host - quadratic for a big scan. Here the file
+ * is read once, compared through DiffHosts' hash table, and written once
+ * (or not at all when nothing changed).
+ */
+BOOL AddHosts(const wchar_t* const* hostnames, const wchar_t* const* descriptions, int count)
+{
+    Host* hosts = NULL;
+    int hostCount = 0;
+    HostDiff diff;
+    
+    if (count <= 0)
+        return TRUE;
+    
+    if (!LoadHosts(&hosts, &hostCount))
+        return FALSE;
+    
+    BOOL result = DiffHosts(hosts, hostCount, hostnames, descriptions, count, &diff) &&
+                  ApplyHostDiff(hosts, hostCount, hostnames, descriptions, &diff, NULL, TRUE, NULL, NULL);
+    
+    FreeHostDiff(&diff);
+    FreeHosts(hosts, hostCount);
+    return result;
+}
+
 /*
  * DeleteHost - Remove a host from the list
  */
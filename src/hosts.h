@@ -15,15 +15,37 @@ typedef struct {
     wchar_t lastConnected[64];  // ISO 8601 format: YYYY-MM-DD HH:MM:SS or "Never"
 } Host;
 
+// Difference between scan results and the saved hosts (see DiffHosts)
+typedef struct {
+    int* added;                 // Scan entries (indices) not in the hosts list
+    int addedCount;
+    int* updated;               // Scan entries whose saved host has another description
+    int* updatedHosts;          // ... and the index of that host
+    int updatedCount;
+    int* missing;               // Hosts (indices) the scan did not list
+    int missingCount;
+    int unchangedCount;         // Scan entries saved already, description and all
+} HostDiff;
+
 // Host management functions
 BOOL LoadHosts(Host** hosts, int* count);
 BOOL SaveHosts(const Host* hosts, int count);
 BOOL AddHost(const wchar_t* hostname, const wchar_t* description);
+BOOL AddHosts(const wchar_t* const* hostnames, const wchar_t* const* descriptions, int count);
+BOOL DiffHosts(const Host* hosts, int hostCount, const wchar_t* const* hostnames,
+               const wchar_t* const* descriptions, int count, HostDiff* diff);
+BOOL ApplyHostDiff(const Host* hosts, int hostCount, const wchar_t* const* hostnames,
+                   const wchar_t* const* descriptions, const HostDiff* diff, const BYTE* include,
+                   BOOL updateDescriptions, int* addedCount, int* updatedCount);
+void FreeHostDiff(HostDiff* diff);
 BOOL DeleteHost(const wchar_t* hostname);
 BOOL DeleteAllHosts(void);
 BOOL UpdateLastConnected(const wchar_t* hostname);
 BOOL GetRecentHosts(Host** hosts, int* count, int maxCount);
 void FreeHosts(Host* hosts, int count);
 
+// Post a message to a window whenever the hosts file has been saved
+void SetHostsChangedNotify(HWND hwnd, UINT message);
+
 #endif // HOSTS_H
 
@@ -0,0 +1,473 @@
+/*
+ * Host Sorting Module
+ *
+ * Sorts hosts by hostname, description, last connection time or connect
+ * latency, with a second column to break ties (e.g. "by last connected, then by name").
+ *
+ * Two ideas make this fast:
+ *
+ *   1. Sort keys are computed once per host, not once per comparison.
+ *      LCMapStringW with LCMAP_SORTKEY turns a string into a byte string
+ *      whose plain byte order matches the user's locale collation, so a
+ *      comparison becomes a strcmp on bytes. The "Last Connected" text is
+ *      turned into a single number, with "Never" as the largest value, and
+ *      the latency percentiles are read from the history once per host.
+ *
+ *   2. We sort an array of host indices with a stable merge sort. Hosts
+ *      that compare equal keep their previous order, which is what users
+ *      expect from clicking column headers one after another. Large lists
+ *      are split into chunks that are sorted on separate threads and then
+ *      merged.
+ *
+ * Learning points:
+ *   - LCMapStringW and collation (sort) keys
+ *   - Merge sort and why it is stable
+ *   - Splitting work across threads with CreateThread/WaitForMultipleObjects
+ */
+
+#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include "hostsort.h"
+#include "latency.h"
+
+// Runs this short are sorted with insertion sort (also stable)
+#define INSERTION_SORT_THRESHOLD 16
+
+// Upper limit on sort threads
+#define HOST_SORT_MAX_THREADS 8
+
+// Flags for the collation keys: case-insensitive, like the old _wcsicmp sort
+#define SORT_KEY_FLAGS (LCMAP_SORTKEY | NORM_IGNORECASE)
+
+// Everything a sort pass needs to compare two indices
+typedef struct {
+    const HostSortKeys* keys;
+    const HostSortSpec* spec;
+} SortContext;
+
+// One chunk of a parallel sort
+typedef struct {
+    const SortContext* ctx;
+    int* data;
+    int* temp;
+    int count;
+} SortChunk;
+
+/*
+ * TimestampSortKey - Turn "YYYY-MM-DD HH:MM:SS" into YYYYMMDDhhmmss
+ *
+ * The result orders the same way as the date. Anything else (including
+ * "Never") becomes TIMESTAMP_NEVER so it sorts last.
+ */
+ULONGLONG TimestampSortKey(const wchar_t* text)
+{
+    // The format is fixed, so read the digits directly (much faster than swscanf,
+    // which matters when a query evaluates this for every host)
+    static const wchar_t pattern[] = L"0000-00-00 00:00:00";
+    ULONGLONG key = 0;
+
+    for (int i = 0; pattern[i] != L'\0'; i++)
+    {
+        wchar_t c = text[i];
+        if (pattern[i] == L'0')
+        {
+            if (c < L'0' || c > L'9')
+                return TIMESTAMP_NEVER;
+            key = key * 10 + (ULONGLONG)(c - L'0');
+        }
+        else if (c != pattern[i])
+        {
+            return TIMESTAMP_NEVER;
+        }
+    }
+    return key;
+}
+
+/*
+ * SortKeySize - Number of bytes LCMapStringW needs for a string's sort key
+ */
+static int SortKeySize(const wchar_t* text)
+{
+    int size = LCMapStringW(LOCALE_USER_DEFAULT, SORT_KEY_FLAGS, text, -1, NULL, 0);
+    return (size > 0) ? size : 1;  // Room for at least the terminating zero byte
+}
+
+/*
+ * WriteSortKey - Store a string's sort key in dest (size bytes)
+ */
+static void WriteSortKey(const wchar_t* text, BYTE* dest, int size)
+{
+    // For LCMAP_SORTKEY the destination is a byte buffer and its size is in bytes
+    if (LCMapStringW(LOCALE_USER_DEFAULT, SORT_KEY_FLAGS, text, -1, (LPWSTR)dest, size) == 0)
+        dest[0] = 0;
+}
+
+/*
+ * CreateSortKey - Allocate the collation key for a single string
+ *
+ * Returns a zero-terminated byte string (free with free()), or NULL.
+ */
+BYTE* CreateSortKey(const wchar_t* text)
+{
+    int size = SortKeySize(text);
+    BYTE* key = (BYTE*)malloc(size);
+    if (key != NULL)
+        WriteSortKey(text, key, size);
+    return key;
+}
+
+/*
+ * BuildHostSortKeys - Compute the sort keys for every host
+ *
+ * Parameters:
+ *   hosts     - Host array
+ *   hostCount - Number of hosts
+ *
+ * Returns a key table (free with FreeHostSortKeys), or NULL on failure.
+ */
+HostSortKeys* BuildHostSortKeys(const Host* hosts, int hostCount)
+{
+    if (hosts == NULL || hostCount <= 0)
+        return NULL;
+
+    HostSortKeys* keys = (HostSortKeys*)calloc(1, sizeof(HostSortKeys));
+    if (keys == NULL)
+        return NULL;
+
+    keys->hostCount = hostCount;
+    keys->hostnameKey = (int*)malloc(hostCount * sizeof(int));
+    keys->descriptionKey = (int*)malloc(hostCount * sizeof(int));
+    keys->lastConnectedKey = (ULONGLONG*)malloc(hostCount * sizeof(ULONGLONG));
+    keys->latencyP50Key = (float*)malloc(hostCount * sizeof(float));
+    keys->latencyP99Key = (float*)malloc(hostCount * sizeof(float));
+    if (keys->hostnameKey == NULL || keys->descriptionKey == NULL || keys->lastConnectedKey == NULL ||
+        keys->latencyP50Key == NULL || keys->latencyP99Key == NULL)
+    {
+        FreeHostSortKeys(keys);
+        return NULL;
+    }
+
+    // First pass: work out where each key goes, so all keys share one allocation
+    size_t total = 0;
+    for (int i = 0; i < hostCount; i++)
+    {
+        keys->hostnameKey[i] = (int)total;
+        total += SortKeySize(hosts[i].hostname);
+        keys->descriptionKey[i] = (int)total;
+        total += SortKeySize(hosts[i].description);
+    }
+
+    keys->keyData = (BYTE*)malloc(total);
+    if (keys->keyData == NULL)
+    {
+        FreeHostSortKeys(keys);
+        return NULL;
+    }
+
+    // Second pass: generate the keys
+    for (int i = 0; i < hostCount; i++)
+    {
+        int hostnameSize = keys->descriptionKey[i] - keys->hostnameKey[i];
+        int descriptionEnd = (i + 1 < hostCount) ? keys->hostnameKey[i + 1] : (int)total;
+        int descriptionSize = descriptionEnd - keys->descriptionKey[i];
+
+        WriteSortKey(hosts[i].hostname, keys->keyData + keys->hostnameKey[i], hostnameSize);
+        WriteSortKey(hosts[i].description, keys->keyData + keys->descriptionKey[i], descriptionSize);
+        keys->lastConnectedKey[i] = TimestampSortKey(hosts[i].lastConnected);
+
+        LatencySummary latency;
+        BOOL measured = GetHostLatency(hosts[i].hostname, &latency);
+        keys->latencyP50Key[i] = measured ? (float)latency.p50Ms : LATENCY_NONE;
+        keys->latencyP99Key[i] = measured ? (float)latency.p99Ms : LATENCY_NONE;
+    }
+
+    return keys;
+}
+
+/*
+ * FreeHostSortKeys - Free a key table from BuildHostSortKeys
+ */
+void FreeHostSortKeys(HostSortKeys* keys)
+{
+    if (keys == NULL)
+        return;
+
+    free(keys->keyData);
+    free(keys->hostnameKey);
+    free(keys->descriptionKey);
+    free(keys->lastConnectedKey);
+    free(keys->latencyP50Key);
+    free(keys->latencyP99Key);
+    free(keys);
+}
+
+/*
+ * CompareColumn - Compare two hosts on a single column, in the given direction
+ *
+ * Hosts that were never probed sort after the measured ones whichever way
+ * the latency columns are sorted.
+ */
+static int CompareColumn(const HostSortKeys* keys, int column, BOOL ascending, int index1, int index2)
+{
+    int result = 0;
+
+    switch (column)
+    {
+        case SORT_COLUMN_HOSTNAME:
+            // Sort keys are zero-terminated byte strings; strcmp compares them as unsigned bytes
+            result = strcmp((const char*)keys->keyData + keys->hostnameKey[index1],
+                            (const char*)keys->keyData + keys->hostnameKey[index2]);
+            break;
+
+        case SORT_COLUMN_DESCRIPTION:
+            result = strcmp((const char*)keys->keyData + keys->descriptionKey[index1],
+                            (const char*)keys->keyData + keys->descriptionKey[index2]);
+            break;
+
+        case SORT_COLUMN_LAST_CONNECTED:
+        {
+            ULONGLONG a = keys->lastConnectedKey[index1];
+            ULONGLONG b = keys->lastConnectedKey[index2];
+            result = (a < b) ? -1 : (a > b) ? 1 : 0;
+            break;
+        }
+
+        case SORT_COLUMN_LATENCY_P50:
+        case SORT_COLUMN_LATENCY_P99:
+        {
+            const float* key = (column == SORT_COLUMN_LATENCY_P50) ? keys->latencyP50Key : keys->latencyP99Key;
+            BOOL none1 = (key[index1] == LATENCY_NONE);
+            BOOL none2 = (key[index2] == LATENCY_NONE);
+            if (none1 || none2)
+                return none1 - none2;   // Not affected by the direction
+            result = (key[index1] < key[index2]) ? -1 : (key[index1] > key[index2]) ? 1 : 0;
+            break;
+        }
+    }
+    return ascending ? result : -result;
+}
+
+/*
+ * CompareHostsByKeys - Compare two hosts by the primary, then secondary column
+ *
+ * Returns:
+ *   Negative if host index1 sorts first
+ *   Zero if they are equal on both columns
+ *   Positive if host index2 sorts first
+ */
+int CompareHostsByKeys(const HostSortKeys* keys, const HostSortSpec* spec, int index1, int index2)
+{
+    int result = CompareColumn(keys, spec->primaryColumn, spec->primaryAscending, index1, index2);
+    if (result != 0)
+        return result;
+
+    return CompareColumn(keys, spec->secondaryColumn, spec->secondaryAscending, index1, index2);
+}
+
+/*
+ * InsertionSort - Stable sort for short runs
+ */
+static void InsertionSort(const SortContext* ctx, int* data, int count)
+{
+    for (int i = 1; i < count; i++)
+    {
+        int value = data[i];
+        int j = i - 1;
+
+        // Strictly greater only, so equal items keep their order
+        while (j >= 0 && CompareHostsByKeys(ctx->keys, ctx->spec, data[j], value) > 0)
+        {
+            data[j + 1] = data[j];
+            j--;
+        }
+        data[j + 1] = value;
+    }
+}
+
+/*
+ * MergeRuns - Merge two sorted runs into out
+ *
+ * Takes from the left run on ties, which is what keeps the sort stable.
+ */
+static void MergeRuns(const SortContext* ctx, const int* left, int leftCount,
+                      const int* right, int rightCount, int* out)
+{
+    int i = 0, j = 0, k = 0;
+
+    while (i < leftCount && j < rightCount)
+    {
+        if (CompareHostsByKeys(ctx->keys, ctx->spec, left[i], right[j]) <= 0)
+            out[k++] = left[i++];
+        else
+            out[k++] = right[j++];
+    }
+    while (i < leftCount)
+        out[k++] = left[i++];
+    while (j < rightCount)
+        out[k++] = right[j++];
+}
+
+/*
+ * MergeSort - Top-down merge sort of data, using temp as scratch space
+ */
+static void MergeSort(const SortContext* ctx, int* data, int* temp, int count)
+{
+    if (count <= INSERTION_SORT_THRESHOLD)
+    {
+        InsertionSort(ctx, data, count);
+        return;
+    }
+
+    int half = count / 2;
+    MergeSort(ctx, data, temp, half);
+    MergeSort(ctx, data + half, temp + half, count - half);
+
+    // Already in order - nothing to merge (common when re-sorting sorted data)
+    if (CompareHostsByKeys(ctx->keys, ctx->spec, data[half - 1], data[half]) <= 0)
+        return;
+
+    MergeRuns(ctx, data, half, data + half, count - half, temp);
+    memcpy(data, temp, count * sizeof(int));
+}
+
+/*
+ * SortChunkThread - Thread entry point that sorts one chunk
+ */
+static DWORD WINAPI SortChunkThread(LPVOID param)
+{
+    SortChunk* chunk = (SortChunk*)param;
+    MergeSort(chunk->ctx, chunk->data, chunk->temp, chunk->count);
+    return 0;
+}
+
+/*
+ * GetSortThreadCount - Number of threads to use (a power of two)
+ */
+static int GetSortThreadCount(void)
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+
+    int threads = 1;
+    while (threads * 2 <= (int)info.dwNumberOfProcessors && threads * 2 <= HOST_SORT_MAX_THREADS)
+        threads *= 2;
+    return threads;
+}
+
+/*
+ * ParallelMergeSort - Sort chunks on separate threads, then merge them
+ *
+ * Chunks are merged pairwise, doubling the run length each round, so the
+ * result is the same as a single-threaded stable merge sort.
+ */
+static void ParallelMergeSort(const SortContext* ctx, int* data, int* temp, int count, int threadCount)
+{
+    SortChunk chunks[HOST_SORT_MAX_THREADS];
+    HANDLE threads[HOST_SORT_MAX_THREADS];
+    int started = 0;
+    int chunkSize = (count + threadCount - 1) / threadCount;
+
+    for (int t = 0; t < threadCount; t++)
+    {
+        int start = t * chunkSize;
+        int end = (start + chunkSize < count) ? start + chunkSize : count;
+
+        chunks[t].ctx = ctx;
+        chunks[t].data = data + start;
+        chunks[t].temp = temp + start;
+        chunks[t].count = (end > start) ? end - start : 0;
+
+        // The calling thread takes the first chunk itself
+        if (t == 0)
+            continue;
+
+        threads[started] = CreateThread(NULL, 0, SortChunkThread, &chunks[t], 0, NULL);
+        if (threads[started] != NULL)
+            started++;
+        else
+            SortChunkThread(&chunks[t]);  // Could not start a thread - sort it here
+    }
+
+    SortChunkThread(&chunks[0]);
+
+    if (started > 0)
+    {
+        WaitForMultipleObjects(started, threads, TRUE, INFINITE);
+        for (int t = 0; t < started; t++)
+            CloseHandle(threads[t]);
+    }
+
+    // Merge neighbouring runs until one run covers everything
+    for (int run = chunkSize; run < count; run *= 2)
+    {
+        for (int start = 0; start < count; start += run * 2)
+        {
+            int mid = (start + run < count) ? start + run : count;
+            int end = (start + run * 2 < count) ? start + run * 2 : count;
+
+            MergeRuns(ctx, data + start, mid - start, data + mid, end - mid, temp + start);
+        }
+        memcpy(data, temp, count * sizeof(int));
+    }
+}
+
+/*
+ * SortHostIndices - Stable sort of host indices
+ *
+ * Parameters:
+ *   keys    - Key table for the host array the indices refer to
+ *   spec    - Columns and directions to sort by
+ *   indices - Host indices to sort (sorted in place)
+ *   count   - Number of indices
+ *
+ * Returns FALSE if scratch memory could not be allocated (indices unchanged).
+ */
+BOOL SortHostIndices(const HostSortKeys* keys, const HostSortSpec* spec, int* indices, int count)
+{
+    if (keys == NULL || count < 2)
+        return TRUE;
+
+    SortContext ctx = { keys, spec };
+
+    if (count <= INSERTION_SORT_THRESHOLD)
+    {
+        InsertionSort(&ctx, indices, count);
+        return TRUE;
+    }
+
+    int* temp = (int*)malloc(count * sizeof(int));
+    if (temp == NULL)
+        return FALSE;
+
+    int threadCount = (count >= HOST_SORT_PARALLEL_THRESHOLD) ? GetSortThreadCount() : 1;
+    if (threadCount > 1)
+        ParallelMergeSort(&ctx, indices, temp, count, threadCount);
+    else
+        MergeSort(&ctx, indices, temp, count);
+
+    free(temp);
+    return TRUE;
+}
+
+/*
+ * SetSortColumn - Update the sort spec after a column header click
+ *
+ * Clicking the current column flips its direction. Clicking another column
+ * makes it the primary column (ascending) and demotes the old primary
+ * column to secondary, so ties keep the previous ordering.
+ */
+void SetSortColumn(HostSortSpec* spec, int column)
+{
+    if (spec->primaryColumn == column)
+    {
+        spec->primaryAscending = !spec->primaryAscending;
+        return;
+    }
+
+    spec->secondaryColumn = spec->primaryColumn;
+    spec->secondaryAscending = spec->primaryAscending;
+    spec->primaryColumn = column;
+    spec->primaryAscending = TRUE;
+}
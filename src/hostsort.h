@@ -0,0 +1,71 @@
+/*
+ * Host Sorting Header
+ *
+ * Sorting of the host list by one or two columns.
+ *
+ * Instead of comparing strings with _wcsicmp on every comparison, a binary
+ * collation key is built once per host (LCMapString with LCMAP_SORTKEY) and
+ * the timestamp is turned into a number. The sort then rearranges an array
+ * of host indices, leaving the host array itself untouched.
+ */
+
+#ifndef HOSTSORT_H
+#define HOSTSORT_H
+
+#include <windows.h>
+#include "hosts.h"
+
+// Sortable columns (match the ListView column numbers)
+#define SORT_COLUMN_NONE            0
+#define SORT_COLUMN_HOSTNAME        1
+#define SORT_COLUMN_DESCRIPTION     2
+#define SORT_COLUMN_LAST_CONNECTED  3
+#define SORT_COLUMN_LATENCY_P50     5   // Main list only (column 4 is the status)
+#define SORT_COLUMN_LATENCY_P99     6
+
+// Lists at least this long are sorted on several threads
+#define HOST_SORT_PARALLEL_THRESHOLD 20000
+
+// Which columns to sort by
+typedef struct {
+    int primaryColumn;          // SORT_COLUMN_xxx
+    BOOL primaryAscending;
+    int secondaryColumn;        // Breaks ties in the primary column (SORT_COLUMN_NONE for none)
+    BOOL secondaryAscending;
+} HostSortSpec;
+
+// Precomputed sort keys for a host array
+typedef struct {
+    int hostCount;
+    BYTE* keyData;              // All collation keys, back to back
+    int* hostnameKey;           // Offset of each host's hostname key in keyData
+    int* descriptionKey;        // Offset of each host's description key in keyData
+    ULONGLONG* lastConnectedKey; // YYYYMMDDhhmmss as a number, "Never" = largest value
+    float* latencyP50Key;       // Median connect time, never probed = LATENCY_NONE
+    float* latencyP99Key;
+} HostSortKeys;
+
+// "Never" (and anything that is not a timestamp) as a timestamp key
+#define TIMESTAMP_NEVER 0xFFFFFFFFFFFFFFFFULL
+
+// No latency history as a latency key (sorts after every measured host)
+#define LATENCY_NONE 3.0e38f
+
+// Keys for a single value (used by the ordered indexes and queries)
+BYTE* CreateSortKey(const wchar_t* text);
+ULONGLONG TimestampSortKey(const wchar_t* text);
+
+// Build and free the key table for a host array
+HostSortKeys* BuildHostSortKeys(const Host* hosts, int hostCount);
+void FreeHostSortKeys(HostSortKeys* keys);
+
+// Compare two hosts (by index) using the keys; negative, zero or positive
+int CompareHostsByKeys(const HostSortKeys* keys, const HostSortSpec* spec, int index1, int index2);
+
+// Stable sort of an array of host indices
+BOOL SortHostIndices(const HostSortKeys* keys, const HostSortSpec* spec, int* indices, int count);
+
+// Click-to-sort helper: make column the primary sort column
+void SetSortColumn(HostSortSpec* spec, int column);
+
+#endif // HOSTSORT_H
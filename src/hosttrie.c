@@ -0,0 +1,334 @@
+/*
+ * Hostname Trie Module
+ *
+ * A radix tree is a prefix tree where chains of single-child nodes are
+ * merged into one edge, so the tree has at most two nodes per key no
+ * matter how long the keys are:
+ *
+ *   keys: sql-prod-01, sql-prod-02, sql-test-01
+ *
+ *   (root) "sql-"
+ *            +-- "prod-0" +-- "1"
+ *            |            +-- "2"
+ *            +-- "test-01"
+ *
+ * The tree is built in one go from the sorted keys: the longest common
+ * prefix of a run of sorted keys is the edge of the node that covers them,
+ * and the run splits into children on the next character.
+ *
+ * Each node also keeps the HOST_TRIE_TOP_MATCHES most recently connected
+ * hosts below it, merged bottom-up while building. A lookup walks the
+ * prefix (a few string compares) and copies that list - the cost does not
+ * depend on how many hosts match.
+ *
+ * Learning points:
+ *   - Radix trees (compressed tries)
+ *   - Building a tree from sorted input instead of inserting keys one by one
+ *   - Precomputing per-node answers (top-k) to make queries constant time
+ */
+
+#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wctype.h>
+#include "hosttrie.h"
+#include "hostsort.h"
+
+typedef struct {
+    const wchar_t* key;         // Lowercase hostname or hostname suffix (in the name pool)
+    int host;
+} TrieKey;
+
+typedef struct {
+    const wchar_t* label;       // Edge text leading to this node (not NUL terminated)
+    int labelLength;
+    int firstChild;             // Children are consecutive nodes, ordered by first character
+    int childCount;
+    int topCount;
+    int top[HOST_TRIE_TOP_MATCHES];  // Most recent hosts in this subtree
+} TrieNode;
+
+struct HostTrie {
+    TrieNode* nodes;
+    int nodeCount;
+    wchar_t* names;             // Lowercase hostnames, NUL separated
+    ULONGLONG* recency;         // Per host: last connected as a number, 0 for never
+    TrieKey* keys;              // Only needed while building
+};
+
+/*
+ * IsNameSeparator - Characters that start a new searchable part of a hostname
+ */
+static BOOL IsNameSeparator(wchar_t c)
+{
+    return c == L'.' || c == L'-' || c == L'_';
+}
+
+/*
+ * CompareTrieKeys - qsort callback ordering keys by text, then host
+ */
+static int CompareTrieKeys(const void* a, const void* b)
+{
+    const TrieKey* key1 = (const TrieKey*)a;
+    const TrieKey* key2 = (const TrieKey*)b;
+    int result = wcscmp(key1->key, key2->key);
+    if (result != 0)
+        return result;
+    return key1->host - key2->host;
+}
+
+/*
+ * IsMoreRecent - TRUE if host1 should be listed before host2
+ */
+static BOOL IsMoreRecent(const HostTrie* trie, int host1, int host2)
+{
+    if (trie->recency[host1] != trie->recency[host2])
+        return trie->recency[host1] > trie->recency[host2];
+    return host1 < host2;
+}
+
+/*
+ * AddTopMatch - Insert a host into a node's top list (kept sorted, no duplicates)
+ */
+static void AddTopMatch(const HostTrie* trie, TrieNode* node, int host)
+{
+    int position = node->topCount;
+
+    for (int i = 0; i < node->topCount; i++)
+    {
+        if (node->top[i] == host)
+            return;
+    }
+
+    while (position > 0 && IsMoreRecent(trie, host, node->top[position - 1]))
+        position--;
+
+    if (position >= HOST_TRIE_TOP_MATCHES)
+        return;
+
+    int last = (node->topCount < HOST_TRIE_TOP_MATCHES) ? node->topCount : HOST_TRIE_TOP_MATCHES - 1;
+    memmove(&node->top[position + 1], &node->top[position], (last - position) * sizeof(int));
+    node->top[position] = host;
+    if (node->topCount < HOST_TRIE_TOP_MATCHES)
+        node->topCount++;
+}
+
+/*
+ * BuildNode - Build the node covering sorted keys [first, last)
+ *
+ * Parameters:
+ *   trie  - Trie being built (nodes array is preallocated)
+ *   node  - Index of the node to fill
+ *   first - First key covered by the node
+ *   last  - One past the last key
+ *   depth - Characters already matched by the node's ancestors
+ */
+static void BuildNode(HostTrie* trie, int node, int first, int last, int depth)
+{
+    const wchar_t* firstKey = trie->keys[first].key;
+    const wchar_t* lastKey = trie->keys[last - 1].key;
+
+    // Keys are sorted, so the first and last share the prefix of the whole run
+    int end = depth;
+    while (firstKey[end] != L'\0' && firstKey[end] == lastKey[end])
+        end++;
+
+    trie->nodes[node].label = firstKey + depth;
+    trie->nodes[node].labelLength = end - depth;
+    trie->nodes[node].topCount = 0;
+
+    // Keys that end exactly here sort first
+    int i = first;
+    while (i < last && trie->keys[i].key[end] == L'\0')
+    {
+        AddTopMatch(trie, &trie->nodes[node], trie->keys[i].host);
+        i++;
+    }
+
+    // Reserve one consecutive node per distinct next character
+    int childCount = 0;
+    for (int j = i; j < last; j++)
+    {
+        if (j == i || trie->keys[j].key[end] != trie->keys[j - 1].key[end])
+            childCount++;
+    }
+    int firstChild = trie->nodeCount;
+    trie->nodeCount += childCount;
+    trie->nodes[node].firstChild = firstChild;
+    trie->nodes[node].childCount = childCount;
+
+    int child = firstChild;
+    while (i < last)
+    {
+        int runEnd = i + 1;
+        while (runEnd < last && trie->keys[runEnd].key[end] == trie->keys[i].key[end])
+            runEnd++;
+
+        BuildNode(trie, child, i, runEnd, end);
+
+        const TrieNode* built = &trie->nodes[child];
+        for (int t = 0; t < built->topCount; t++)
+            AddTopMatch(trie, &trie->nodes[node], built->top[t]);
+
+        child++;
+        i = runEnd;
+    }
+}
+
+/*
+ * BuildHostTrie - Build a trie over a host array
+ *
+ * Parameters:
+ *   hosts - Host array
+ *   count - Number of hosts
+ *
+ * Returns the trie (free with FreeHostTrie), or NULL if out of memory.
+ */
+HostTrie* BuildHostTrie(const Host* hosts, int count)
+{
+    HostTrie* trie = (HostTrie*)calloc(1, sizeof(HostTrie));
+    if (trie == NULL)
+        return NULL;
+
+    // Lowercase copies of the hostnames and the number of keys each one adds
+    size_t namesLength = 0;
+    int keyCount = 0;
+    for (int i = 0; i < count; i++)
+    {
+        namesLength += wcslen(hosts[i].hostname) + 1;
+        keyCount++;
+        for (const wchar_t* p = hosts[i].hostname; *p != L'\0'; p++)
+        {
+            if (IsNameSeparator(*p) && p[1] != L'\0' && !IsNameSeparator(p[1]))
+                keyCount++;
+        }
+    }
+
+    trie->names = (wchar_t*)malloc((namesLength + 1) * sizeof(wchar_t));
+    trie->recency = (ULONGLONG*)malloc((count > 0 ? count : 1) * sizeof(ULONGLONG));
+    trie->keys = (TrieKey*)malloc((keyCount > 0 ? keyCount : 1) * sizeof(TrieKey));
+    trie->nodes = (TrieNode*)malloc((2 * keyCount + 1) * sizeof(TrieNode));
+    if (trie->names == NULL || trie->recency == NULL || trie->keys == NULL || trie->nodes == NULL)
+    {
+        FreeHostTrie(trie);
+        return NULL;
+    }
+
+    wchar_t* name = trie->names;
+    int k = 0;
+    for (int i = 0; i < count; i++)
+    {
+        ULONGLONG timestamp = TimestampSortKey(hosts[i].lastConnected);
+        trie->recency[i] = (timestamp == TIMESTAMP_NEVER) ? 0 : timestamp;
+
+        int length = 0;
+        for (const wchar_t* p = hosts[i].hostname; *p != L'\0'; p++)
+            name[length++] = (wchar_t)towlower(*p);
+        name[length] = L'\0';
+
+        trie->keys[k].key = name;
+        trie->keys[k].host = i;
+        k++;
+        for (int c = 0; c < length; c++)
+        {
+            if (IsNameSeparator(name[c]) && name[c + 1] != L'\0' && !IsNameSeparator(name[c + 1]))
+            {
+                trie->keys[k].key = name + c + 1;
+                trie->keys[k].host = i;
+                k++;
+            }
+        }
+
+        name += length + 1;
+    }
+
+    // Root node (an empty tree is a root without children)
+    trie->nodeCount = 1;
+    memset(&trie->nodes[0], 0, sizeof(TrieNode));
+    if (keyCount > 0)
+    {
+        qsort(trie->keys, keyCount, sizeof(TrieKey), CompareTrieKeys);
+        BuildNode(trie, 0, 0, keyCount, 0);
+    }
+
+    // Labels point into the name pool; the key table is not needed any more
+    free(trie->keys);
+    trie->keys = NULL;
+    return trie;
+}
+
+/*
+ * FreeHostTrie - Free a trie built by BuildHostTrie
+ */
+void FreeHostTrie(HostTrie* trie)
+{
+    if (trie == NULL)
+        return;
+
+    free(trie->nodes);
+    free(trie->names);
+    free(trie->recency);
+    free(trie->keys);
+    free(trie);
+}
+
+/*
+ * FindHostTrieMatches - Most recent hosts matching a prefix
+ *
+ * Parameters:
+ *   trie       - Trie from BuildHostTrie
+ *   prefix     - Typed text (case-insensitive)
+ *   matches    - Receives host indices, most recently connected first
+ *   maxMatches - Size of matches (at most HOST_TRIE_TOP_MATCHES are returned)
+ *
+ * Returns the number of matches.
+ */
+int FindHostTrieMatches(const HostTrie* trie, const wchar_t* prefix, int* matches, int maxMatches)
+{
+    if (trie == NULL)
+        return 0;
+
+    const TrieNode* node = &trie->nodes[0];
+    const wchar_t* p = prefix;
+
+    for (;;)
+    {
+        // Follow the node's edge as far as the prefix goes
+        for (int i = 0; i < node->labelLength; i++, p++)
+        {
+            if (*p == L'\0')
+                break;
+            if ((wchar_t)towlower(*p) != node->label[i])
+                return 0;
+        }
+        if (*p == L'\0')
+            break;
+
+        // Pick the child starting with the next character (children are sorted)
+        wchar_t next = (wchar_t)towlower(*p);
+        int low = node->firstChild;
+        int high = node->firstChild + node->childCount - 1;
+        const TrieNode* child = NULL;
+        while (low <= high)
+        {
+            int middle = (low + high) / 2;
+            wchar_t first = trie->nodes[middle].label[0];
+            if (first == next)
+            {
+                child = &trie->nodes[middle];
+                break;
+            }
+            if (first < next)
+                low = middle + 1;
+            else
+                high = middle - 1;
+        }
+        if (child == NULL)
+            return 0;
+        node = child;
+    }
+
+    int count = (node->topCount < maxMatches) ? node->topCount : maxMatches;
+    memcpy(matches, node->top, count * sizeof(int));
+    return count;
+}
@@ -0,0 +1,32 @@
+/*
+ * Hostname Trie Header
+ *
+ * Compressed prefix tree (radix tree) over hostnames for the quick connect
+ * palette. Every node stores the most recently connected hosts below it,
+ * so a lookup only walks the typed prefix and never visits the matches
+ * one by one.
+ *
+ * Besides the full hostname, the part after each '.', '-' or '_' is also
+ * indexed, so "prod" finds "sql-prod-01".
+ */
+
+#ifndef HOSTTRIE_H
+#define HOSTTRIE_H
+
+#include <windows.h>
+#include "hosts.h"
+
+// Matches kept per node (the most the palette can show)
+#define HOST_TRIE_TOP_MATCHES   8
+
+typedef struct HostTrie HostTrie;
+
+// Build a trie over a host array (matches are indices into that array)
+HostTrie* BuildHostTrie(const Host* hosts, int count);
+void FreeHostTrie(HostTrie* trie);
+
+// Hosts (indices) whose name or name part starts with prefix, most recent first.
+// An empty prefix returns the most recently connected hosts overall.
+int FindHostTrieMatches(const HostTrie* trie, const wchar_t* prefix, int* matches, int maxMatches);
+
+#endif // HOSTTRIE_H
@@ -0,0 +1,379 @@
+/*
+ * Latency History Module
+ *
+ * One histogram per host, like the diagnostics histograms in perfstats.c
+ * but much smaller: 64 one-byte counters on a log scale, 4 per doubling.
+ * A percentile is the upper edge of the bucket where the running count
+ * reaches its rank, so p50 and p99 are within one bucket (19%) of the
+ * truth whether a host answers in 0.3 ms or 3 s.
+ *
+ * A one-byte counter fills up after 255 samples. When one would overflow,
+ * every counter of the host is halved first: the shape of the histogram
+ * stays, and old samples count half as much as new ones each time. That
+ * keeps the memory fixed and lets a server that got slow show it in its
+ * percentiles within a few hundred probes, instead of being outvoted by
+ * months of good history.
+ *
+ * Hosts are found by a 64-bit hash of the lowercase hostname (open
+ * addressing, at most half full) behind a slim reader/writer lock, since
+ * probes record from worker threads while the list reads. The name itself
+ * is not kept; with 64 bits two hosts of one list never share a hash in
+ * practice.
+ *
+ * latency.bin is a header followed by the entries exactly as they are in
+ * memory, so loading is a bounds check and a copy per entry.
+ *
+ * Learning points:
+ *   - Log-scale histograms in a fixed number of bytes
+ *   - Exponential decay by halving counters
+ *   - Fixed-size binary records for quick loading
+ */
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "config.h"
+#include "latency.h"
+
+// History of one host (LATENCY_ENTRY_SIZE bytes; written to the file as is)
+typedef struct {
+    ULONGLONG nameHash;         // 0 = empty slot
+    DWORD samples;              // Probes ever recorded
+    float lastMs;               // Newest sample
+    BYTE buckets[LATENCY_BUCKETS];
+} LatencyEntry;
+
+typedef struct {
+    DWORD magic;                // LATENCY_FILE_MAGIC
+    DWORD version;              // LATENCY_FILE_VERSION
+    DWORD entrySize;            // LATENCY_ENTRY_SIZE
+    DWORD count;                // Entries that follow
+} LatencyFileHeader;
+
+static SRWLOCK g_latencyLock = SRWLOCK_INIT;
+static LatencyEntry* g_entries = NULL;
+static int g_entryCount = 0;
+static int g_entryCapacity = 0;     // Power of two
+static BOOL g_loaded = FALSE;
+static DWORD g_recordSerial = 0;    // Samples recorded ...
+static DWORD g_savedSerial = 0;     // ... and how many of them are in the file
+
+/*
+ * BucketForMs - Histogram bucket of a connect time
+ *
+ * Bucket 0 is everything under LATENCY_MIN_MS; bucket b covers
+ * [MIN * 2^((b-1)/4), MIN * 2^(b/4)) milliseconds.
+ */
+static int BucketForMs(double ms)
+{
+    if (ms < LATENCY_MIN_MS)
+        return 0;
+
+    int bucket = (int)(log2(ms / LATENCY_MIN_MS) * LATENCY_BUCKETS_PER_DOUBLING) + 1;
+    return (bucket < LATENCY_BUCKETS) ? bucket : LATENCY_BUCKETS - 1;
+}
+
+/*
+ * BucketUpperMs - Upper edge of a bucket in milliseconds
+ */
+static double BucketUpperMs(int bucket)
+{
+    return LATENCY_MIN_MS * pow(2.0, (double)bucket / LATENCY_BUCKETS_PER_DOUBLING);
+}
+
+/*
+ * FindEntrySlot - Slot holding nameHash, or the empty slot where it would go
+ *
+ * Must be called with the lock held and a non-empty table.
+ */
+static int FindEntrySlot(ULONGLONG nameHash)
+{
+    int slot = (int)(nameHash & (g_entryCapacity - 1));
+    while (g_entries[slot].nameHash != 0 && g_entries[slot].nameHash != nameHash)
+        slot = (slot + 1) & (g_entryCapacity - 1);
+    return slot;
+}
+
+/*
+ * GetEntry - Entry of a host, added if it is new
+ *
+ * Must be called with the lock held exclusively.
+ * Returns NULL if out of memory.
+ */
+static LatencyEntry* GetEntry(ULONGLONG nameHash)
+{
+    // Keep the table at most half full
+    if ((g_entryCount + 1) * 2 > g_entryCapacity)
+    {
+        int newCapacity = (g_entryCapacity > 0) ? g_entryCapacity * 2 : 256;
+        LatencyEntry* newEntries = (LatencyEntry*)calloc(newCapacity, sizeof(LatencyEntry));
+        if (newEntries == NULL)
+            return NULL;
+
+        LatencyEntry* oldEntries = g_entries;
+        int oldCapacity = g_entryCapacity;
+        g_entries = newEntries;
+        g_entryCapacity = newCapacity;
+        for (int i = 0; i < oldCapacity; i++)
+        {
+            if (oldEntries[i].nameHash != 0)
+                g_entries[FindEntrySlot(oldEntries[i].nameHash)] = oldEntries[i];
+        }
+        free(oldEntries);
+    }
+
+    int slot = FindEntrySlot(nameHash);
+    if (g_entries[slot].nameHash == 0)
+    {
+        g_entries[slot].nameHash = nameHash;
+        g_entryCount++;
+    }
+    return &g_entries[slot];
+}
+
+/*
+ * GetLatencyFilePath - Full path of latency.bin (next to hosts.csv)
+ */
+static BOOL GetLatencyFilePath(wchar_t* path, size_t pathLen)
+{
+    wchar_t exePath[MAX_PATH];
+
+    if (GetModuleFileNameW(NULL, exePath, MAX_PATH) == 0)
+        return FALSE;
+
+    wchar_t* lastSlash = wcsrchr(exePath, L'\\');
+    if (lastSlash == NULL)
+        return FALSE;
+    *(lastSlash + 1) = L'\0';
+
+    return swprintf_s(path, pathLen, L"%s%s", exePath, LATENCY_FILE_NAME) >= 0;
+}
+
+/*
+ * RecordHostLatency - Add one connect time to a host's history
+ *
+ * Parameters:
+ *   hostname - Host as written in the host list
+ *   rttMs    - Time the TCP handshake took
+ */
+void RecordHostLatency(const wchar_t* hostname, double rttMs)
+{
+    if (hostname == NULL || hostname[0] == L'\0' || rttMs < 0.0)
+        return;
+
+    ULONGLONG nameHash = HashHostKey(hostname);
+    int bucket = BucketForMs(rttMs);
+
+    AcquireSRWLockExclusive(&g_latencyLock);
+
+    LatencyEntry* entry = GetEntry(nameHash);
+    if (entry != NULL)
+    {
+        // Counter full - halve them all, so older samples weigh half as much
+        if (entry->buckets[bucket] == 0xFF)
+        {
+            for (int b = 0; b < LATENCY_BUCKETS; b++)
+                entry->buckets[b] >>= 1;
+        }
+
+        entry->buckets[bucket]++;
+        entry->samples++;
+        entry->lastMs = (float)rttMs;
+        g_recordSerial++;
+    }
+
+    ReleaseSRWLockExclusive(&g_latencyLock);
+}
+
+/*
+ * GetHostLatency - Percentiles of a host's connect times
+ *
+ * Returns:
+ *   TRUE if the host has samples (summary filled), FALSE otherwise
+ */
+BOOL GetHostLatency(const wchar_t* hostname, LatencySummary* summary)
+{
+    memset(summary, 0, sizeof(LatencySummary));
+    if (hostname == NULL)
+        return FALSE;
+
+    ULONGLONG nameHash = HashHostKey(hostname);
+    BYTE buckets[LATENCY_BUCKETS];
+    BOOL found = FALSE;
+
+    AcquireSRWLockShared(&g_latencyLock);
+    if (g_entryCapacity > 0)
+    {
+        const LatencyEntry* entry = &g_entries[FindEntrySlot(nameHash)];
+        if (entry->nameHash != 0 && entry->samples > 0)
+        {
+            memcpy(buckets, entry->buckets, LATENCY_BUCKETS);
+            summary->samples = entry->samples;
+            summary->lastMs = entry->lastMs;
+            found = TRUE;
+        }
+    }
+    ReleaseSRWLockShared(&g_latencyLock);
+
+    if (!found)
+        return FALSE;
+
+    int total = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++)
+        total += buckets[b];
+
+    // Walk the counts up to the rank of each percentile
+    int rank50 = (total + 1) / 2;
+    int rank99 = (int)ceil(0.99 * total);
+    int seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++)
+    {
+        seen += buckets[b];
+        if (summary->p50Ms == 0.0 && seen >= rank50)
+            summary->p50Ms = BucketUpperMs(b);
+        if (seen >= rank99)
+        {
+            summary->p99Ms = BucketUpperMs(b);
+            break;
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * LoadLatencyHistory - Read latency.bin into memory
+ *
+ * Only the first call reads the file. Samples recorded before it are kept
+ * (an entry from the file does not replace one that already exists).
+ *
+ * Returns:
+ *   TRUE if the history is loaded (or there was no file), FALSE if the
+ *   file is damaged or from another version (what could be read is kept,
+ *   and the next save replaces the file)
+ */
+BOOL LoadLatencyHistory(void)
+{
+    wchar_t path[MAX_PATH];
+    FILE* file = NULL;
+    BOOL ok = TRUE;
+
+    AcquireSRWLockExclusive(&g_latencyLock);
+    if (g_loaded)
+    {
+        ReleaseSRWLockExclusive(&g_latencyLock);
+        return TRUE;
+    }
+    g_loaded = TRUE;
+
+    if (GetLatencyFilePath(path, MAX_PATH) && _wfopen_s(&file, path, L"rb") == 0 && file != NULL)
+    {
+        LatencyFileHeader header;
+        if (fread(&header, sizeof(header), 1, file) != 1 ||
+            header.magic != LATENCY_FILE_MAGIC || header.version != LATENCY_FILE_VERSION ||
+            header.entrySize != sizeof(LatencyEntry))
+        {
+            ok = FALSE;
+        }
+
+        for (DWORD i = 0; ok && i < header.count; i++)
+        {
+            LatencyEntry stored;
+            if (fread(&stored, sizeof(stored), 1, file) != 1)
+            {
+                // Truncated - keep what was read
+                ok = FALSE;
+                break;
+            }
+            if (stored.nameHash == 0)
+                continue;
+
+            LatencyEntry* entry = GetEntry(stored.nameHash);
+            if (entry == NULL)
+                break;
+            if (entry->samples == 0)
+                *entry = stored;
+        }
+        fclose(file);
+    }
+
+    ReleaseSRWLockExclusive(&g_latencyLock);
+    return ok;
+}
+
+/*
+ * SaveLatencyHistory - Write the histories of the listed hosts to latency.bin
+ *
+ * Parameters:
+ *   hosts     - Current host list (hosts not in it are left out of the file)
+ *   hostCount - Number of hosts
+ *
+ * Does nothing if no sample was recorded since the last save. The file is
+ * written next to the old one and then moved over it.
+ *
+ * Returns:
+ *   TRUE if the file is up to date, FALSE if it could not be written
+ */
+BOOL SaveLatencyHistory(const Host* hosts, int hostCount)
+{
+    wchar_t path[MAX_PATH];
+    wchar_t tempPath[MAX_PATH];
+
+    if (!GetLatencyFilePath(path, MAX_PATH) || swprintf_s(tempPath, MAX_PATH, L"%s.tmp", path) < 0)
+        return FALSE;
+
+    // Hash the names before taking the lock
+    ULONGLONG* hashes = (ULONGLONG*)malloc(sizeof(ULONGLONG) * ((hostCount > 0) ? hostCount : 1));
+    if (hashes == NULL)
+        return FALSE;
+    for (int i = 0; i < hostCount; i++)
+        hashes[i] = HashHostKey(hosts[i].hostname);
+
+    // Copy the entries out, so the lock is not held while writing
+    AcquireSRWLockShared(&g_latencyLock);
+    DWORD serial = g_recordSerial;
+    if (serial == g_savedSerial)
+    {
+        ReleaseSRWLockShared(&g_latencyLock);
+        free(hashes);
+        return TRUE;
+    }
+
+    LatencyEntry* entries = (LatencyEntry*)malloc(sizeof(LatencyEntry) * ((hostCount > 0) ? hostCount : 1));
+    int count = 0;
+    for (int i = 0; entries != NULL && g_entryCapacity > 0 && i < hostCount; i++)
+    {
+        const LatencyEntry* entry = &g_entries[FindEntrySlot(hashes[i])];
+        if (entry->nameHash != 0)
+            entries[count++] = *entry;
+    }
+    ReleaseSRWLockShared(&g_latencyLock);
+    free(hashes);
+
+    if (entries == NULL)
+        return FALSE;
+
+    LatencyFileHeader header = {LATENCY_FILE_MAGIC, LATENCY_FILE_VERSION, sizeof(LatencyEntry), (DWORD)count};
+    BOOL ok = FALSE;
+    FILE* file = NULL;
+    if (_wfopen_s(&file, tempPath, L"wb") == 0 && file != NULL)
+    {
+        ok = (fwrite(&header, sizeof(header), 1, file) == 1) &&
+             (count == 0 || fwrite(entries, sizeof(LatencyEntry), count, file) == (size_t)count);
+        ok = (fclose(file) == 0) && ok;
+        ok = ok && MoveFileExW(tempPath, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+        if (!ok)
+            DeleteFileW(tempPath);
+    }
+    free(entries);
+
+    if (ok)
+    {
+        // Samples recorded while writing are saved next time
+        AcquireSRWLockExclusive(&g_latencyLock);
+        g_savedSerial = serial;
+        ReleaseSRWLockExclusive(&g_latencyLock);
+    }
+    return ok;
+}
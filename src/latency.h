@@ -0,0 +1,53 @@
+/*
+ * Latency History Header
+ *
+ * Remembers how fast each host has answered: every probe that completes
+ * (Check Reachability and the host monitor) adds its connect time to a
+ * small per-host histogram, from which the p50 and p99 columns of the main
+ * list are read. The histograms are kept in latency.bin next to hosts.csv.
+ *
+ * A host costs LATENCY_ENTRY_SIZE bytes whatever its history, so even
+ * 100,000 hosts stay under 10 MB; hosts that were never probed cost nothing.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <windows.h>
+#include "hosts.h"
+
+// File identification ("WRLH") and layout version
+#define LATENCY_FILE_MAGIC      0x57524C48
+#define LATENCY_FILE_VERSION    1
+
+// Log-scale buckets: 4 per doubling (about 19% wide), from 1/8 ms to about 7 s
+#define LATENCY_BUCKETS_PER_DOUBLING 4
+#define LATENCY_BUCKETS         64
+#define LATENCY_MIN_MS          0.125
+
+// Bytes one host takes in memory and in the file
+#define LATENCY_ENTRY_SIZE      80
+
+// What the history of one host says
+typedef struct {
+    DWORD samples;              // Probes ever recorded
+    double p50Ms;               // Median connect time (upper edge of its bucket)
+    double p99Ms;
+    double lastMs;              // Newest sample
+} LatencySummary;
+
+// Add one connect time (milliseconds); safe from any thread
+void RecordHostLatency(const wchar_t* hostname, double rttMs);
+
+// Percentiles of a host; FALSE if it has no samples
+BOOL GetHostLatency(const wchar_t* hostname, LatencySummary* summary);
+
+// Read latency.bin (once; later calls do nothing); FALSE if it is damaged
+BOOL LoadLatencyHistory(void);
+
+// Write latency.bin if anything was recorded since the last save;
+// only hosts in the list are kept, so deleted hosts drop out.
+// FALSE if it could not be written
+BOOL SaveLatencyHistory(const Host* hosts, int hostCount);
+
+#endif // LATENCY_H
@@ -0,0 +1,401 @@
+/*
+ * Connection Launcher Module
+ *
+ * One background thread takes two kinds of work from the UI:
+ *
+ *   - Connects: StartRDPSession (credentials, .rdp file, mstsc), which
+ *     shows no UI - an error comes back as text, and the window that asked
+ *     shows it with itself as the owner. Connects run first,
+ *     in the order they were asked for, and each is reported back to its
+ *     window when mstsc has started. The host's Last Connected time is
+ *     saved there, on the UI thread, like every other hosts.csv change.
+ *   - Preparations ("prewarm"): render and write the .rdp file of a host
+ *     that is likely to be connected to next, with the username it would
+ *     get. CreateRDPFile leaves an unchanged file alone, so connecting to
+ *     a prepared host only reads its file back before starting mstsc.
+ *     The newest request is prepared first, since that is the row the
+ *     user is on now; a selection only counts once it has stayed on a row
+ *     for LAUNCH_PREWARM_DELAY_MS, so arrowing through the list writes
+ *     nothing.
+ *
+ * Preparing does not store credentials for mstsc: they are written to the
+ * credential store only for a host that is actually connected to, and the
+ * password read along with the username is wiped right away.
+ *
+ * Timing: a connect carries the time it was asked for, and the result
+ * carries when the thread picked it up and when mstsc had started. The UI
+ * thread records the whole span as the "connect" stage of Diagnostics.
+ *
+ * Learning points:
+ *   - Moving blocking work off the UI thread and posting the result back
+ *   - Doing likely work ahead of time while idle
+ *   - ShellExecuteW from a worker thread (it needs COM)
+ */
+
+#include <windows.h>
+#include <objbase.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "resource.h"
+#include "credentials.h"
+#include "hosts.h"
+#include "rdp.h"
+#include "search.h"
+#include "perfstats.h"
+#include "launcher.h"
+
+// A host waiting to be prepared
+typedef struct {
+    wchar_t hostname[MAX_HOSTNAME_LEN];
+    BOOL selection;             // The selected row (replaced by the next selection)
+    ULONGLONG due;              // GetTickCount64 when it may be prepared
+} PrewarmRequest;
+
+// A connect waiting for the thread
+typedef struct {
+    wchar_t hostname[MAX_HOSTNAME_LEN];
+    HWND hwndNotify;
+    LONGLONG submitTicks;
+} ConnectRequest;
+
+// A host that was prepared (launcher thread only)
+typedef struct {
+    ULONGLONG nameHash;
+    ULONGLONG preparedAt;       // GetTickCount64
+} PreparedHost;
+
+static HANDLE g_hLauncherThread = NULL;
+static HANDLE g_hWakeEvent = NULL;          // Work queued or stop requested
+static HWND g_hwndNotify = NULL;
+static volatile LONG g_stopRequested = 0;
+
+// Queues shared with the UI thread
+static CRITICAL_SECTION g_queueLock;
+static ConnectRequest g_connects[LAUNCH_MAX_PENDING];
+static int g_connectCount = 0;
+static PrewarmRequest g_prewarms[LAUNCH_PREWARM_QUEUE];
+static int g_prewarmCount = 0;
+
+// Recently prepared hosts, oldest overwritten first (launcher thread only)
+static PreparedHost g_prepared[LAUNCH_PREWARM_MEMORY];
+static int g_preparedNext = 0;
+
+/*
+ * WasPrepared - TRUE if the host was prepared within LAUNCH_PREWARM_TTL_MS
+ */
+static BOOL WasPrepared(ULONGLONG nameHash, ULONGLONG now)
+{
+    for (int i = 0; i < LAUNCH_PREWARM_MEMORY; i++)
+    {
+        if (g_prepared[i].nameHash == nameHash && now - g_prepared[i].preparedAt < LAUNCH_PREWARM_TTL_MS)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/*
+ * RemovePrewarm - Take a request out of the queue (lock held)
+ */
+static void RemovePrewarm(int index)
+{
+    memmove(&g_prewarms[index], &g_prewarms[index + 1],
+            (g_prewarmCount - index - 1) * sizeof(PrewarmRequest));
+    g_prewarmCount--;
+}
+
+/*
+ * AddPrewarm - Queue a host to be prepared (lock held)
+ *
+ * A host already waiting moves to the end, and so does the selected row,
+ * which replaces the previous one.
+ */
+static void AddPrewarm(const wchar_t* hostname, BOOL selection, ULONGLONG due)
+{
+    for (int i = g_prewarmCount - 1; i >= 0; i--)
+    {
+        if (_wcsicmp(g_prewarms[i].hostname, hostname) == 0 || (selection && g_prewarms[i].selection))
+            RemovePrewarm(i);
+    }
+    if (g_prewarmCount == LAUNCH_PREWARM_QUEUE)
+        RemovePrewarm(0);
+
+    PrewarmRequest* request = &g_prewarms[g_prewarmCount++];
+    wcscpy_s(request->hostname, MAX_HOSTNAME_LEN, hostname);
+    request->selection = selection;
+    request->due = due;
+}
+
+/*
+ * PrepareHost - Write the .rdp file a connect to this host would use
+ *
+ * Uses the username LaunchRDP would pick (per-host, else global). Hosts
+ * without any credentials are left alone - connecting to them fails anyway.
+ */
+static void PrepareHost(const wchar_t* hostname, ULONGLONG now)
+{
+    ULONGLONG nameHash = HashHostKey(hostname);
+    if (WasPrepared(nameHash, now))
+        return;
+
+    wchar_t username[MAX_USERNAME_LEN];
+    wchar_t password[MAX_PASSWORD_LEN];
+    wchar_t rdpPath[MAX_PATH];
+
+    BOOL found = LoadRDPCredentials(hostname, username, password) ||
+                 LoadCredentials(NULL, username, password);
+    SecureZeroMemory(password, sizeof(password));
+    if (!found || !CreateRDPFile(hostname, username, rdpPath, MAX_PATH))
+        return;
+
+    g_prepared[g_preparedNext].nameHash = nameHash;
+    g_prepared[g_preparedNext].preparedAt = now;
+    g_preparedNext = (g_preparedNext + 1) % LAUNCH_PREWARM_MEMORY;
+}
+
+/*
+ * RunConnect - Connect to a host and report it to its window
+ */
+static void RunConnect(const ConnectRequest* request)
+{
+    LaunchResult* result = (LaunchResult*)calloc(1, sizeof(LaunchResult));
+    if (result == NULL)
+        return;
+
+    wcscpy_s(result->hostname, MAX_HOSTNAME_LEN, request->hostname);
+    result->submitTicks = request->submitTicks;
+
+    // No message boxes from this thread - FinishLaunch shows the error
+    result->success = StartRDPSession(request->hostname, NULL, NULL,
+                                      result->error, ARRAYSIZE(result->error));
+    result->launchedTicks = GetSearchTicks();
+
+    HWND hwnd = (request->hwndNotify != NULL) ? request->hwndNotify : g_hwndNotify;
+    if (hwnd == NULL || !PostMessageW(hwnd, WM_LAUNCH_COMPLETE, 0, (LPARAM)result))
+        free(result);
+}
+
+/*
+ * LauncherThread - Run connects, and prepare hosts while there are none
+ */
+static DWORD WINAPI LauncherThread(LPVOID param)
+{
+    UNREFERENCED_PARAMETER(param);
+
+    // ShellExecuteW may hand the launch to a shell extension, which needs COM
+    HRESULT hrCom = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+
+    for (;;)
+    {
+        ConnectRequest connect;
+        wchar_t prewarm[MAX_HOSTNAME_LEN];
+        BOOL haveConnect = FALSE;
+        BOOL havePrewarm = FALSE;
+        DWORD waitMs = INFINITE;
+        ULONGLONG now = GetTickCount64();
+
+        EnterCriticalSection(&g_queueLock);
+        if (g_connectCount > 0)
+        {
+            connect = g_connects[0];
+            memmove(&g_connects[0], &g_connects[1], (g_connectCount - 1) * sizeof(ConnectRequest));
+            g_connectCount--;
+            haveConnect = TRUE;
+        }
+        else if (g_stopRequested)
+        {
+            LeaveCriticalSection(&g_queueLock);
+            break;
+        }
+        else
+        {
+            // Newest due request first; otherwise sleep until the next one is due
+            for (int i = g_prewarmCount - 1; i >= 0; i--)
+            {
+                if (g_prewarms[i].due <= now)
+                {
+                    wcscpy_s(prewarm, MAX_HOSTNAME_LEN, g_prewarms[i].hostname);
+                    RemovePrewarm(i);
+                    havePrewarm = TRUE;
+                    break;
+                }
+                if (g_prewarms[i].due - now < waitMs)
+                    waitMs = (DWORD)(g_prewarms[i].due - now);
+            }
+        }
+        LeaveCriticalSection(&g_queueLock);
+
+        if (haveConnect)
+            RunConnect(&connect);
+        else if (havePrewarm)
+            PrepareHost(prewarm, now);
+        else
+            WaitForSingleObject(g_hWakeEvent, waitMs);
+    }
+
+    if (SUCCEEDED(hrCom))
+        CoUninitialize();
+    return 0;
+}
+
+/*
+ * StartLauncher - Start the launcher thread
+ *
+ * Parameters:
+ *   hwndNotify - Window that receives WM_LAUNCH_COMPLETE for connects
+ *                queued without a window of their own
+ *
+ * Returns TRUE if the launcher is running.
+ */
+BOOL StartLauncher(HWND hwndNotify)
+{
+    if (g_hLauncherThread != NULL)
+        return TRUE;
+
+    g_hWakeEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+    if (g_hWakeEvent == NULL)
+        return FALSE;
+
+    InitializeCriticalSection(&g_queueLock);
+    g_hwndNotify = hwndNotify;
+    g_stopRequested = 0;
+    g_connectCount = 0;
+    g_prewarmCount = 0;
+
+    g_hLauncherThread = CreateThread(NULL, 0, LauncherThread, NULL, 0, NULL);
+    if (g_hLauncherThread == NULL)
+    {
+        DeleteCriticalSection(&g_queueLock);
+        CloseHandle(g_hWakeEvent);
+        g_hWakeEvent = NULL;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * StopLauncher - Stop the thread once the queued connects have run
+ *
+ * Hosts still waiting to be prepared are dropped.
+ */
+void StopLauncher(void)
+{
+    if (g_hLauncherThread == NULL)
+        return;
+
+    EnterCriticalSection(&g_queueLock);
+    g_prewarmCount = 0;
+    InterlockedExchange(&g_stopRequested, 1);
+    LeaveCriticalSection(&g_queueLock);
+
+    SetEvent(g_hWakeEvent);
+    WaitForSingleObject(g_hLauncherThread, INFINITE);
+    CloseHandle(g_hLauncherThread);
+    CloseHandle(g_hWakeEvent);
+    g_hLauncherThread = NULL;
+    g_hWakeEvent = NULL;
+
+    DeleteCriticalSection(&g_queueLock);
+    g_hwndNotify = NULL;
+}
+
+/*
+ * QueueConnect - Connect to a host on the launcher thread
+ *
+ * Parameters:
+ *   hostname    - The RDP server to connect to
+ *   hwndNotify  - Window that receives WM_LAUNCH_COMPLETE (NULL = the
+ *                 launcher's window)
+ *   submitTicks - GetSearchTicks when the user asked to connect
+ *
+ * Returns FALSE if the connect was not queued.
+ */
+BOOL QueueConnect(const wchar_t* hostname, HWND hwndNotify, LONGLONG submitTicks)
+{
+    if (g_hLauncherThread == NULL)
+        return FALSE;
+
+    BOOL queued = FALSE;
+    EnterCriticalSection(&g_queueLock);
+    if (g_connectCount < LAUNCH_MAX_PENDING && !g_stopRequested)
+    {
+        ConnectRequest* request = &g_connects[g_connectCount++];
+        wcscpy_s(request->hostname, MAX_HOSTNAME_LEN, hostname);
+        request->hwndNotify = hwndNotify;
+        request->submitTicks = submitTicks;
+        queued = TRUE;
+    }
+    LeaveCriticalSection(&g_queueLock);
+
+    if (queued)
+        SetEvent(g_hWakeEvent);
+    return queued;
+}
+
+/*
+ * PrewarmHosts - Prepare hosts, the first one first
+ *
+ * For the most recently connected hosts; copies the names.
+ */
+void PrewarmHosts(const wchar_t* const* hostnames, int count)
+{
+    if (g_hLauncherThread == NULL)
+        return;
+
+    ULONGLONG now = GetTickCount64();
+    EnterCriticalSection(&g_queueLock);
+    for (int i = count - 1; i >= 0; i--)
+        AddPrewarm(hostnames[i], FALSE, now);
+    LeaveCriticalSection(&g_queueLock);
+
+    SetEvent(g_hWakeEvent);
+}
+
+/*
+ * PrewarmSelectedHost - Prepare the host of the selected row
+ *
+ * Only once the selection has stayed for LAUNCH_PREWARM_DELAY_MS; a newer
+ * selection replaces this one.
+ */
+void PrewarmSelectedHost(const wchar_t* hostname)
+{
+    if (g_hLauncherThread == NULL)
+        return;
+
+    EnterCriticalSection(&g_queueLock);
+    AddPrewarm(hostname, TRUE, GetTickCount64() + LAUNCH_PREWARM_DELAY_MS);
+    LeaveCriticalSection(&g_queueLock);
+
+    SetEvent(g_hWakeEvent);
+}
+
+/*
+ * FinishLaunch - Take a connect result on the UI thread
+ *
+ * Saves the host's Last Connected time - on the UI thread, so it cannot
+ * race the other hosts.csv saves - and records the time from asking to
+ * connect until mstsc had started.
+ *
+ * If it failed, the error is shown in a message box owned by hwndOwner,
+ * so the window cannot start another connect while it is up.
+ *
+ * Returns TRUE if mstsc was started. Frees the result.
+ */
+BOOL FinishLaunch(LaunchResult* result, HWND hwndOwner)
+{
+    BOOL success = result->success;
+
+    if (success)
+    {
+        UpdateLastConnected(result->hostname);
+        RecordPerfSample(PERF_CONNECT,
+                         SearchTicksToMs(result->launchedTicks - result->submitTicks));
+    }
+    else
+    {
+        MessageBoxW(hwndOwner, result->error, L"Error", MB_OK | MB_ICONERROR);
+    }
+
+    free(result);
+    return success;
+}
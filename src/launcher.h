@@ -0,0 +1,62 @@
+/*
+ * Connection Launcher Header
+ *
+ * Connecting loads the credentials, stores them for mstsc, writes the
+ * host's .rdp file and starts mstsc - all of which touch the credential
+ * store, the disk or the shell. The launcher does this on its own thread,
+ * so the window that asked keeps painting, and reports back with
+ * WM_LAUNCH_COMPLETE once mstsc has started.
+ *
+ * While idle it prepares the .rdp files of the hosts most likely to be
+ * connected to next (the most recent ones and the selected row), so that
+ * connecting finds the file current and goes straight to starting mstsc.
+ */
+
+#ifndef LAUNCHER_H
+#define LAUNCHER_H
+
+#include <windows.h>
+#include "config.h"
+
+// Connects waiting for the launcher thread (more are refused)
+#define LAUNCH_MAX_PENDING      4
+
+// Hosts waiting to be prepared (the oldest is dropped when full)
+#define LAUNCH_PREWARM_QUEUE    16
+
+// How long the selection has to stay on a row before its host is prepared
+#define LAUNCH_PREWARM_DELAY_MS 300
+
+// A host prepared this recently is not prepared again
+#define LAUNCH_PREWARM_TTL_MS   60000
+#define LAUNCH_PREWARM_MEMORY   32
+
+// Outcome of one connect (posted in LPARAM of WM_LAUNCH_COMPLETE; pass to FinishLaunch)
+typedef struct {
+    wchar_t hostname[MAX_HOSTNAME_LEN];
+    BOOL success;               // mstsc was started
+    wchar_t error[256];         // Why not (shown by FinishLaunch)
+    LONGLONG submitTicks;       // When the connect was asked for (GetSearchTicks)
+    LONGLONG launchedTicks;     // When mstsc had been started
+} LaunchResult;
+
+// Start and stop the launcher thread (one per process). Stopping still
+// runs the connects that were asked for; preparations are dropped.
+BOOL StartLauncher(HWND hwndNotify);
+void StopLauncher(void);
+
+// Connect in the background. WM_LAUNCH_COMPLETE goes to hwndNotify, or to
+// the window given to StartLauncher if NULL. FALSE if the launcher is not
+// running or too many connects are waiting - connect directly then.
+BOOL QueueConnect(const wchar_t* hostname, HWND hwndNotify, LONGLONG submitTicks);
+
+// Prepare hosts that are likely to be connected to next
+void PrewarmHosts(const wchar_t* const* hostnames, int count);
+void PrewarmSelectedHost(const wchar_t* hostname);
+
+// Handle WM_LAUNCH_COMPLETE on the UI thread: saves Last Connected and
+// records the timing, or shows the error owned by hwndOwner; frees the
+// result and returns whether mstsc was started
+BOOL FinishLaunch(LaunchResult* result, HWND hwndOwner);
+
+#endif // LAUNCHER_H
@@ -0,0 +1,41 @@
+/*
+ * LDAP Directory Scanning Header
+ *
+ * Enumerates computer objects from Active Directory over LDAP instead of
+ * asking the browser service. The directory knows every joined computer
+ * (browse lists are capped and often empty on modern networks) and also
+ * has its DNS name, operating system and last logon time.
+ *
+ * EnumerateDirectoryComputers has the signature of EnumerateComputers, so
+ * it plugs into ScanJob as a ComputerSource.
+ */
+
+#ifndef LDAPSCAN_H
+#define LDAPSCAN_H
+
+#include <windows.h>
+#include "adscan.h"
+
+// Objects requested per page (Active Directory's MaxPageSize is 1000 by default)
+#define LDAP_SCAN_PAGE_SIZE     500
+
+// Seconds to wait for one page before giving up
+#define LDAP_SCAN_PAGE_TIMEOUT  60
+
+// Enumerate computer objects page by page, calling callback once per page
+// Parameters:
+//   domain - DNS domain name (e.g. corp.example.com; NULL for the computer's own domain)
+//   includeWorkstations/includeServers/includeDomainControllers - Type filter
+//            (evaluated by the directory server)
+//   callback - Receives each page
+//   context - Passed to callback
+//   summary - Receives completeness information (may be NULL); status is a
+//             Win32 error code
+// Returns TRUE if the search ran (even if it found nothing or was stopped
+// by the callback), FALSE if connecting, binding or the first page failed
+BOOL EnumerateDirectoryComputers(const wchar_t* domain, BOOL includeWorkstations,
+                                 BOOL includeServers, BOOL includeDomainControllers,
+                                 ComputerBatchCallback callback, void* context,
+                                 ScanSummary* summary);
+
+#endif // LDAPSCAN_H
@@ -21,6 +21,7 @@
 #include <shellapi.h>
 #include <wincred.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <strsafe.h>
 
 // Include our header files
@@ -32,6 +33,21 @@
 #include "registry.h"
 #include "darkmode.h"
 #include "adscan.h"
+#include "scanjob.h"
+#include "ldapscan.h"
+#include "search.h"
+#include "hostsort.h"
+#include "hostindex.h"
+#include "grouping.h"
+#include "hosttrie.h"
+#include "query.h"
+#include "perfstats.h"
+#include "probe.h"
+#include "sweep.h"
+#include "resolver.h"
+#include "monitor.h"
+#include "latency.h"
+#include "launcher.h"
 
 // Forward declarations of our functions
 LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
@@ -42,11 +58,18 @@ INT_PTR CALLBACK AddHostDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lP
 INT_PTR CALLBACK ScanDomainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
 INT_PTR CALLBACK ScanResultsDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
 INT_PTR CALLBACK AboutDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+INT_PTR CALLBACK PaletteDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+INT_PTR CALLBACK DiagnosticsDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
 BOOL InitSystemTray(HWND hwnd);
 BOOL ShowSystemTrayIcon(HWND hwnd);
 BOOL HideSystemTrayIcon(HWND hwnd);
 void ShowContextMenu(HWND hwnd);
+void ReloadPaletteHosts(void);
+void PrefetchRecentHosts(void);
+void UpdatePaletteMatches(HWND hwndPalette);
+void TogglePalette(void);
+void FillDiagnosticsList(HWND hList);
 
 // Global variables
 HINSTANCE g_hInstance = NULL;
@@ -58,20 +81,51 @@ static HWND g_hwndLoginDialog = NULL;
 static HWND g_hwndMainDialog = NULL;
 static HWND g_hwndHostDialog = NULL;
 static HWND g_hwndAddHostDialog = NULL;
+static BOOL g_launchPending = FALSE;        // Main dialog is waiting for WM_LAUNCH_COMPLETE
 
-// Scan results tracking
-static int g_scanComputerCount = 0;
+
+// Quick connect palette (created once, hidden between uses)
+static HWND g_hwndPalette = NULL;
+static Host* g_paletteHosts = NULL;         // Host snapshot the trie indexes
+static int g_paletteHostCount = 0;
+static HostTrie* g_paletteTrie = NULL;
+static WNDPROC g_paletteEditProc = NULL;    // Edit box procedure before subclassing
 
 // Timer ID for auto-close countdown
 #define TIMER_AUTO_CLOSE_LOGIN 1
 
-// Scan domain parameters
+// Timer ID for search box debounce (main dialog)
+#define TIMER_SEARCH_DEBOUNCE 2
+
+// Timer ID for refreshing the diagnostics dialog
+#define TIMER_DIAGNOSTICS_REFRESH 3
+
+// Host list column widths; the description column takes what is left
+#define COLUMN_WIDTH_DUMMY 1
+#define COLUMN_WIDTH_HOSTNAME 170
+#define COLUMN_WIDTH_LAST_CONNECTED 160
+#define COLUMN_WIDTH_STATUS 110
+#define COLUMN_WIDTH_LATENCY 55
+#define COLUMN_WIDTH_PADDING 5
+#define COLUMN_WIDTH_MIN_DESCRIPTION 100
+
+// Scan results dialog state
 typedef struct {
-    wchar_t domain[256];
-    BOOL includeWorkstations;
-    BOOL includeServers;
-    BOOL includeDomainControllers;
-} ScanParams;
+    ComputerInfo* computers;
+    int count;
+    int capacity;           // Allocated size of computers, visible and checked (in computers)
+    BYTE* checked;          // Bitset: bit i set = computer i will be added
+    int checkedCount;
+    int* visible;           // Computers passing the filter, in scan order
+    int visibleCount;       // = ListView row count
+    Query* query;           // Last filter that compiled
+    ScanJob* job;           // Scan in progress (NULL once it has ended)
+    BOOL stopRequested;     // Stop Scan was pressed
+    ScanProgress progress;  // Latest progress of the scan
+    BOOL sweep;             // Sweeping IP ranges (progress is in addresses)
+    int* index;             // Hash table of HashHostKey -> computer (-1 = empty slot)
+    int indexCapacity;      // Power of two, at least twice capacity
+} ScanResultsState;
 
 // Edit host data (for pre-filling edit dialog)
 typedef struct {
@@ -81,22 +135,28 @@ typedef struct {
     BOOL isEdit;  // TRUE if editing, FALSE if adding new
 } EditHostData;
 
-// ListView sorting state
-typedef struct {
-    int sortColumn;      // Column being sorted (1=Hostname, 2=Description)
-    BOOL sortAscending;  // TRUE for ascending, FALSE for descending
-    Host* hosts;         // Pointer to host array for sorting
-    int hostCount;       // Number of hosts
-} SortParams;
-
 // Search text tracking for highlighting
 typedef struct {
     wchar_t searchText[256];
     BOOL hasSearchText;
+    SearchSpan* spans;      // Match spans from the filter, indexed by host index
+    int spanHostCount;      // Hosts covered by spans
+    HFONT measuredFont;     // Font the cached widths in spans were measured with
+    wchar_t queryError[128];    // Syntax error in the search text (empty if valid)
 } SearchContext;
 
-// Forward declaration for sort comparison function
-int CALLBACK CompareListViewItems(LPARAM lParam1, LPARAM lParam2, LPARAM lParamSort);
+// Sort state of a host ListView
+typedef struct {
+    HostSortSpec spec;      // Columns and directions to sort by
+    BOOL active;            // FALSE until a column header is clicked (rows stay in file order)
+    HostIndex* index;       // Ordered indexes kept in sync with the host array
+} ListSortState;
+
+// Grouped (tree) view of the main dialog's host list
+typedef struct {
+    GroupMode mode;         // GROUP_BY_NONE shows the plain ListView
+    HostGroups* groups;     // Groups of the rows currently in the ListView
+} GroupTreeState;
 
 /*
  * WinMain - Entry point for Windows GUI applications
@@ -141,7 +201,7 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
     // This must be called before using any common controls
     INITCOMMONCONTROLSEX icex;
     icex.dwSize = sizeof(INITCOMMONCONTROLSEX);
-    icex.dwICC = ICC_LISTVIEW_CLASSES | ICC_STANDARD_CLASSES;
+    icex.dwICC = ICC_LISTVIEW_CLASSES | ICC_TREEVIEW_CLASSES | ICC_STANDARD_CLASSES;
     InitCommonControlsEx(&icex);
     
     // Initialize dark mode support
@@ -193,6 +253,14 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
 
     // Initialize system tray icon
     InitSystemTray(g_hwndMain);
+    
+    // Create the quick connect palette hidden and give it the hosts up front,
+    // then keep it current whenever the hosts file is saved
+    g_hwndPalette = CreateDialog(hInstance, MAKEINTRESOURCE(IDD_PALETTE), g_hwndMain, PaletteDialogProc);
+    ReloadPaletteHosts();
+    StartLauncher(g_hwndMain);
+    PrefetchRecentHosts();
+    SetHostsChangedNotify(g_hwndMain, WM_HOSTS_CHANGED);
 
     // Don't show the main window, just keep it for message processing
     // ShowWindow(g_hwndMain, SW_HIDE);
@@ -224,6 +292,9 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
         DispatchMessage(&msg);
     }
 
+    // Let a connect in flight finish starting mstsc
+    StopLauncher();
+
     // Clean up system tray icon before exiting
     HideSystemTrayIcon(g_hwndMain);
 
@@ -259,6 +330,26 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
                 // Hotkey registration failed - could be in use by another app
                 // Silently fail - the app will still work without the hotkey
             }
+            
+            // Quick connect palette (Ctrl+Shift+Space) - also optional
+            RegisterHotKey(hwnd, IDM_PALETTE_HOTKEY, MOD_CONTROL | MOD_SHIFT | MOD_NOREPEAT, VK_SPACE);
+            return 0;
+
+        case WM_HOSTS_CHANGED:
+        {
+            // A burst of saves (e.g. adding scan results) only needs one reload
+            MSG pending;
+            while (PeekMessage(&pending, hwnd, WM_HOSTS_CHANGED, WM_HOSTS_CHANGED, PM_REMOVE))
+            {
+            }
+            ReloadPaletteHosts();
+            PrefetchRecentHosts();
+            return 0;
+        }
+        
+        case WM_LAUNCH_COMPLETE:
+            // Tray menu or palette connect - only its timing is left to record
+            FinishLaunch((LaunchResult*)lParam, hwnd);
             return 0;
 
         case WM_TRAYICON:
@@ -304,6 +395,12 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
                     }
                     break;
 
+                case IDM_DIAGNOSTICS:
+                    // Show search/list latency statistics
+                    DialogBox(g_hInstance, MAKEINTRESOURCE(IDD_DIAGNOSTICS),
+                             hwnd, DiagnosticsDialogProc);
+                    break;
+
                 case IDM_ABOUT_DIALOG:
                     // Show About dialog
                     DialogBox(g_hInstance, MAKEINTRESOURCE(IDD_ABOUT), 
@@ -336,8 +433,9 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
                             // Verify the index is valid
                             if (recentIndex >= 0 && recentIndex < recentCount)
                             {
-                                // Launch RDP connection to the selected host
-                                LaunchRDPWithDefaults(recentHosts[recentIndex].hostname);
+                                // Launch RDP connection to the selected host (in the background if possible)
+                                if (!QueueConnect(recentHosts[recentIndex].hostname, NULL, GetSearchTicks()))
+                                    LaunchRDPWithDefaults(recentHosts[recentIndex].hostname);
                             }
                             
                             // Free the hosts array
@@ -349,6 +447,12 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
             return 0;
 
         case WM_HOTKEY:
+            if (wParam == IDM_PALETTE_HOTKEY)
+            {
+                TogglePalette();
+                return 0;
+            }
+            
             // Handle global hotkey for toggling connect dialog
             if (wParam == IDM_GLOBAL_HOTKEY)
             {
@@ -413,6 +517,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
         case WM_DESTROY:
             // Unregister global hotkey
             UnregisterHotKey(hwnd, IDM_GLOBAL_HOTKEY);
+            UnregisterHotKey(hwnd, IDM_PALETTE_HOTKEY);
             // Window is being destroyed - quit the application
             PostQuitMessage(0);
             return 0;
@@ -523,6 +628,7 @@ void ShowContextMenu(HWND hwnd)
         AppendMenuW(hMenu, autostartFlags, IDM_ABOUT, L"Start with Windows");
         
         AppendMenuW(hMenu, MF_SEPARATOR, 0, NULL);
+        AppendMenuW(hMenu, MF_STRING, IDM_DIAGNOSTICS, L"Diagnostics");
         AppendMenuW(hMenu, MF_STRING, IDM_ABOUT_DIALOG, L"About");
         AppendMenuW(hMenu, MF_STRING, IDM_EXIT, L"Exit");
 
@@ -739,89 +845,6 @@ INT_PTR CALLBACK LoginDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPar
     return FALSE;
 }
 
-/*
- * CompareListViewItems - Comparison function for ListView sorting
- * 
- * This is a callback function used by ListView_SortItems to compare two items.
- * It compares items based on the current sort column and direction.
- * 
- * Parameters:
- *   lParam1 - lParam of first item (host index in our case)
- *   lParam2 - lParam of second item (host index in our case)
- *   lParamSort - Pointer to SortParams structure
- * 
- * Returns:
- *   Negative if item1 < item2
- *   Zero if item1 == item2
- *   Positive if item1 > item2
- */
-int CALLBACK CompareListViewItems(LPARAM lParam1, LPARAM lParam2, LPARAM lParamSort)
-{
-    SortParams* params = (SortParams*)lParamSort;
-    
-    // Get the host indices
-    int index1 = (int)lParam1;
-    int index2 = (int)lParam2;
-    
-    // Bounds check
-    if (index1 < 0 || index1 >= params->hostCount || 
-        index2 < 0 || index2 >= params->hostCount)
-    {
-        return 0;
-    }
-    
-    // Get the hosts to compare
-    Host* host1 = &params->hosts[index1];
-    Host* host2 = &params->hosts[index2];
-    
-    int result = 0;
-    
-    // Compare based on sort column
-    if (params->sortColumn == 1)
-    {
-        // Sort by hostname
-        result = _wcsicmp(host1->hostname, host2->hostname);
-    }
-    else if (params->sortColumn == 2)
-    {
-        // Sort by description
-        result = _wcsicmp(host1->description, host2->description);
-    }
-    else if (params->sortColumn == 3)
-    {
-        // Sort by last connected timestamp
-        // "Never" should sort to the end, so treat specially
-        BOOL host1Never = (_wcsicmp(host1->lastConnected, L"Never") == 0);
-        BOOL host2Never = (_wcsicmp(host2->lastConnected, L"Never") == 0);
-        
-        if (host1Never && host2Never)
-        {
-            result = 0;  // Both "Never" - equal
-        }
-        else if (host1Never)
-        {
-            result = 1;  // host1 is "Never", host2 has a date - host1 is "greater" (sorts later)
-        }
-        else if (host2Never)
-        {
-            result = -1;  // host2 is "Never", host1 has a date - host1 is "less" (sorts earlier)
-        }
-        else
-        {
-            // Both have dates - normal string compare works for ISO format
-            result = wcscmp(host1->lastConnected, host2->lastConnected);
-        }
-    }
-    
-    // Reverse for descending sort
-    if (!params->sortAscending)
-    {
-        result = -result;
-    }
-    
-    return result;
-}
-
 /*
  * UpdateHostCountLabel - Update the host count status label
  * 
@@ -830,22 +853,29 @@ int CALLBACK CompareListViewItems(LPARAM lParam1, LPARAM lParam2, LPARAM lParamS
  *   labelId - Control ID of the status label
  *   displayedCount - Number of hosts currently displayed
  *   totalCount - Total number of hosts
+ *   queryError - Search query syntax error to show instead (NULL or empty if none)
  * 
  * Updates the label to show "X hosts" or "Showing X of Y hosts" when filtered
  */
-void UpdateHostCountLabel(HWND hwndDialog, int labelId, int displayedCount, int totalCount)
+void UpdateHostCountLabel(HWND hwndDialog, int labelId, int displayedCount, int totalCount,
+                          const wchar_t* queryError)
 {
-    wchar_t statusText[128];
+    wchar_t statusText[192];
     
-    if (displayedCount == totalCount)
+    if (queryError != NULL && queryError[0] != L'\0')
+    {
+        // The search text is not a valid query yet - say why
+        swprintf_s(statusText, 192, L"Query error: %s", queryError);
+    }
+    else if (displayedCount == totalCount)
     {
         // No filtering - show simple count
-        swprintf_s(statusText, 128, L"%d host%s", totalCount, (totalCount == 1 ? L"" : L"s"));
+        swprintf_s(statusText, 192, L"%d host%s", totalCount, (totalCount == 1 ? L"" : L"s"));
     }
     else
     {
         // Filtering active - show "X of Y hosts"
-        swprintf_s(statusText, 128, L"Showing %d of %d host%s", 
+        swprintf_s(statusText, 192, L"Showing %d of %d host%s", 
                   displayedCount, totalCount, (totalCount == 1 ? L"" : L"s"));
     }
     
@@ -856,43 +886,77 @@ void UpdateHostCountLabel(HWND hwndDialog, int labelId, int displayedCount, int
  * LaunchRDPWithVisualFeedback - Connect with visual feedback
  * 
  * Feature 2: Visual Feedback on Connection
- * Shows wait cursor and brief status message while launching RDP connection.
+ * Shows a status message in the title bar while the launcher thread
+ * connects. The dialog keeps painting meanwhile; WM_LAUNCH_COMPLETE
+ * restores the title and closes the dialog once mstsc has started.
  * 
  * Parameters:
- *   hwnd - Parent window handle
+ *   hwnd - Main dialog handle
  *   hostname - The RDP server to connect to
  * 
  * Returns:
- *   TRUE on success, FALSE on failure
+ *   TRUE if the connection was started, FALSE if one is already under
+ *   way or it failed
  */
 BOOL LaunchRDPWithVisualFeedback(HWND hwnd, const wchar_t* hostname)
 {
-    // Change cursor to wait cursor for visual feedback
-    HCURSOR hOldCursor = SetCursor(LoadCursor(NULL, IDC_WAIT));
+    // One connect at a time - a second Enter or double-click is ignored
+    if (g_launchPending)
+        return FALSE;
+    
+    LONGLONG submitTicks = GetSearchTicks();
     
     // Brief message to show we're connecting
     wchar_t statusMsg[512];
     swprintf_s(statusMsg, 512, L"Launching connection to %s...", hostname);
     SetWindowTextW(hwnd, statusMsg);
     
-    // Force window update to show the message
-    UpdateWindow(hwnd);
+    if (QueueConnect(hostname, hwnd, submitTicks))
+    {
+        // Background-work cursor until WM_LAUNCH_COMPLETE (see WM_SETCURSOR)
+        g_launchPending = TRUE;
+        SetCursor(LoadCursor(NULL, IDC_APPSTARTING));
+        return TRUE;
+    }
     
-    // Small delay so user can see the feedback (100ms)
-    Sleep(100);
+    // No launcher thread - connect right here with a wait cursor
+    HCURSOR hOldCursor = SetCursor(LoadCursor(NULL, IDC_WAIT));
+    UpdateWindow(hwnd);
     
-    // Actually launch the RDP connection
     BOOL result = LaunchRDPWithDefaults(hostname);
     
-    // Restore cursor
     SetCursor(hOldCursor);
-    
-    // Restore original window title
     SetWindowTextW(hwnd, APP_WINDOW_TITLE);
+    if (result)
+    {
+        EndDialog(hwnd, IDOK);
+    }
     
     return result;
 }
 
+/*
+ * GetDescriptionColumnWidth - Width left for the description column
+ * 
+ * Parameters:
+ *   listWidth - ListView client width
+ *   hasStatus - TRUE for the main list (Status and latency columns)
+ * 
+ * Returns:
+ *   The list width minus every other column and the padding, but at
+ *   least COLUMN_WIDTH_MIN_DESCRIPTION
+ */
+static int GetDescriptionColumnWidth(int listWidth, BOOL hasStatus)
+{
+    int width = listWidth - COLUMN_WIDTH_DUMMY - COLUMN_WIDTH_HOSTNAME -
+                COLUMN_WIDTH_LAST_CONNECTED - COLUMN_WIDTH_PADDING;
+    
+    if (hasStatus)
+        width -= COLUMN_WIDTH_STATUS + 2 * COLUMN_WIDTH_LATENCY;
+    
+    return (width < COLUMN_WIDTH_MIN_DESCRIPTION) ? COLUMN_WIDTH_MIN_DESCRIPTION : width;
+}
+
 /*
  * ResizeDescriptionColumn - Resize description column to fill available space
  * 
@@ -909,73 +973,333 @@ void ResizeDescriptionColumn(HWND hList)
     GetClientRect(hList, &rcList);
     int listWidth = rcList.right - rcList.left;
     
-    // Calculate new description column width
-    // Total width minus hostname (170) minus last connected (160) minus dummy (1) minus padding (5)
-    int descWidth = listWidth - 170 - 160 - 1 - 5;
-    
-    // Ensure minimum width
-    if (descWidth < 100)
-        descWidth = 100;
+    // Lists with a Status column (the main list) also have the latency columns
+    BOOL hasStatus = (Header_GetItemCount(ListView_GetHeader(hList)) > 4);
     
     // Set the new width for description column (column 2)
-    ListView_SetColumnWidth(hList, 2, descWidth);
+    ListView_SetColumnWidth(hList, 2, GetDescriptionColumnWidth(listWidth, hasStatus));
 }
 
 /*
- * RefreshHostListView - Refresh the main ListView with optional filtering
+ * SetSearchContext - Replace the search text and match spans used for highlighting
  * 
  * Parameters:
- *   hList - Handle to the ListView control
- *   hosts - Array of hosts to display
- *   hostCount - Number of hosts in array
- *   searchText - Filter text (NULL or empty for no filtering)
+ *   ctx - Search context to update
+ *   searchText - Text the list is currently filtered by (NULL for none)
+ *   spans - Match spans from the filter (ownership passes to ctx, may be NULL)
+ *   spanHostCount - Number of hosts covered by spans
+ */
+void SetSearchContext(SearchContext* ctx, const wchar_t* searchText, SearchSpan* spans, int spanHostCount)
+{
+    free(ctx->spans);
+    ctx->spans = spans;
+    ctx->spanHostCount = (spans != NULL) ? spanHostCount : 0;
+    ctx->measuredFont = NULL;
+    
+    wcsncpy_s(ctx->searchText, 256, (searchText != NULL) ? searchText : L"", _TRUNCATE);
+    ctx->hasSearchText = (wcslen(ctx->searchText) > 0);
+}
+
+/*
+ * ClearSearchContext - Forget the search text, query error and match spans
+ */
+void ClearSearchContext(SearchContext* ctx)
+{
+    SetSearchContext(ctx, NULL, NULL, 0);
+    ctx->queryError[0] = L'\0';
+}
+
+/*
+ * DrawSearchHighlight - NM_CUSTOMDRAW handler that highlights search matches
  * 
- * This function refreshes the ListView with all hosts, optionally filtered
- * by the search text (searches both hostname and description).
- * Returns the number of displayed items.
+ * Parameters:
+ *   lpcd - Custom draw notification from a host ListView
+ *   ctx - Search context holding the match spans of the current filter
+ *   hosts - Host array the ListView items point into (item lParam)
+ * 
+ * The match offsets were recorded by the filter pass, so drawing a cell is
+ * a table lookup - no text is fetched from the control or searched again.
+ * Text widths are measured the first time a cell is drawn and reused until
+ * the list font changes.
+ * 
+ * Returns the value to store in DWLP_MSGRESULT.
  */
-int RefreshHostListView(HWND hList, Host* hosts, int hostCount, const wchar_t* searchText)
+LRESULT DrawSearchHighlight(LPNMLVCUSTOMDRAW lpcd, SearchContext* ctx, const Host* hosts)
 {
-    // Clear existing items
-    ListView_DeleteAllItems(hList);
+    if (!ctx->hasSearchText || ctx->spans == NULL || hosts == NULL)
+    {
+        // No search text - use default drawing
+        return CDRF_DODEFAULT;
+    }
     
-    if (hosts == NULL || hostCount == 0)
-        return 0;
+    switch (lpcd->nmcd.dwDrawStage)
+    {
+        case CDDS_PREPAINT:
+            // Request item-level notifications
+            return CDRF_NOTIFYITEMDRAW;
+            
+        case CDDS_ITEMPREPAINT:
+            // Request subitem-level notifications
+            return CDRF_NOTIFYSUBITEMDRAW;
+            
+        case CDDS_SUBITEM | CDDS_ITEMPREPAINT:
+            break;
+            
+        default:
+            return CDRF_DODEFAULT;
+    }
+    
+    // Only highlight columns 1 (hostname) and 2 (description)
+    int iSubItem = lpcd->iSubItem;
+    int hostIndex = (int)lpcd->nmcd.lItemlParam;
+    if ((iSubItem != 1 && iSubItem != 2) || hostIndex < 0 || hostIndex >= ctx->spanHostCount)
+    {
+        return CDRF_DODEFAULT;
+    }
+    
+    int column = (iSubItem == 1) ? SEARCH_SPAN_HOSTNAME : SEARCH_SPAN_DESCRIPTION;
+    SearchSpan* span = &ctx->spans[hostIndex * SEARCH_SPAN_COLUMNS + column];
+    const wchar_t* text = (iSubItem == 1) ? hosts[hostIndex].hostname : hosts[hostIndex].description;
+    int textLen = (int)wcslen(text);
+    
+    if (span->start < 0 || span->start + span->length > textLen)
+    {
+        return CDRF_DODEFAULT;
+    }
+    
+    HWND hList = lpcd->nmcd.hdr.hwndFrom;
+    HDC hdc = lpcd->nmcd.hdc;
+    RECT rcItem = lpcd->nmcd.rc;
     
-    // Check if we have a search filter
-    BOOL hasFilter = (searchText != NULL && wcslen(searchText) > 0);
+    // Adjust rectangle for text padding (ListView has 6px left margin)
+    rcItem.left += 6;
     
-    // Convert search text to lowercase for case-insensitive search
-    wchar_t searchLower[256] = {0};
-    if (hasFilter)
+    // Set up colors (check if item is selected)
+    COLORREF bgColor, textColor;
+    COLORREF highlightBg = RGB(255, 255, 150);
+    COLORREF highlightText = RGB(0, 0, 0);
+    if (lpcd->nmcd.uItemState & CDIS_SELECTED)
+    {
+        // Selected item - use selection colors
+        bgColor = GetSysColor(COLOR_HIGHLIGHT);
+        textColor = GetSysColor(COLOR_HIGHLIGHTTEXT);
+    }
+    else
     {
-        wcsncpy_s(searchLower, 256, searchText, _TRUNCATE);
-        _wcslwr_s(searchLower, 256);
+        // Normal item - use standard ListView colors
+        bgColor = ListView_GetBkColor(hList);
+        textColor = ListView_GetTextColor(hList);
     }
     
-    // Add hosts to list, filtering if necessary
-    int displayIndex = 0;
-    for (int i = 0; i < hostCount; i++)
+    // Fill background
+    HBRUSH hBrush = CreateSolidBrush(bgColor);
+    FillRect(hdc, &rcItem, hBrush);
+    DeleteObject(hBrush);
+    
+    // Set up text drawing
+    SetBkMode(hdc, TRANSPARENT);
+    HFONT hFont = (HFONT)SendMessageW(hList, WM_GETFONT, 0, 0);
+    HFONT hOldFont = (HFONT)SelectObject(hdc, hFont);
+    
+    // Widths measured with a different font are no use - forget them all
+    if (hFont != ctx->measuredFont)
     {
-        // If filtering, check if hostname or description matches
-        if (hasFilter)
+        for (int i = 0; i < ctx->spanHostCount * SEARCH_SPAN_COLUMNS; i++)
         {
-            wchar_t hostnameLower[256] = {0};
-            wchar_t descriptionLower[256] = {0};
-            
-            wcsncpy_s(hostnameLower, 256, hosts[i].hostname, _TRUNCATE);
-            _wcslwr_s(hostnameLower, 256);
-            
-            wcsncpy_s(descriptionLower, 256, hosts[i].description, _TRUNCATE);
-            _wcslwr_s(descriptionLower, 256);
-            
-            // Skip if neither hostname nor description contains the search text
-            if (wcsstr(hostnameLower, searchLower) == NULL && 
-                wcsstr(descriptionLower, searchLower) == NULL)
-            {
-                continue;
-            }
+            ctx->spans[i].totalCx = -1;
         }
+        ctx->measuredFont = hFont;
+    }
+    
+    // Measure this cell once; later paints reuse the cached widths
+    if (span->totalCx < 0)
+    {
+        SIZE size;
+        GetTextExtentPoint32W(hdc, text, span->start, &size);
+        span->beforeCx = size.cx;
+        GetTextExtentPoint32W(hdc, text + span->start, span->length, &size);
+        span->matchCx = size.cx;
+        GetTextExtentPoint32W(hdc, text, textLen, &size);
+        span->totalCx = size.cx;
+    }
+    
+    // Center the text horizontally in the column
+    int columnWidth = rcItem.right - rcItem.left;
+    int x = rcItem.left + (columnWidth - span->totalCx) / 2;
+    int y = rcItem.top + 2;  // 2px top padding
+    
+    // Draw text before the match
+    SetTextColor(hdc, textColor);
+    if (span->start > 0)
+    {
+        TextOutW(hdc, x, y, text, span->start);
+        x += span->beforeCx;
+    }
+    
+    // Draw highlight background and match text
+    RECT highlightRect = {x, rcItem.top, x + span->matchCx, rcItem.bottom};
+    HBRUSH hHighlight = CreateSolidBrush(highlightBg);
+    FillRect(hdc, &highlightRect, hHighlight);
+    DeleteObject(hHighlight);
+    
+    SetTextColor(hdc, highlightText);
+    TextOutW(hdc, x, y, text + span->start, span->length);
+    x += span->matchCx;
+    
+    // Draw text after the match
+    int afterIndex = span->start + span->length;
+    if (afterIndex < textLen)
+    {
+        SetTextColor(hdc, textColor);
+        TextOutW(hdc, x, y, text + afterIndex, textLen - afterIndex);
+    }
+    
+    SelectObject(hdc, hOldFont);
+    
+    // Tell Windows we handled the drawing
+    return CDRF_SKIPDEFAULT;
+}
+
+/*
+ * OrderHostIndices - Put a set of displayed host indices into sort order
+ * 
+ * Parameters:
+ *   sort - Sort state (does nothing until a column has been clicked)
+ *   hosts - Host array the indices refer to
+ *   hostCount - Number of hosts in array
+ *   indices - Host indices to reorder (in place)
+ *   count - Number of indices
+ * 
+ * The sorted view comes from walking the column's ordered index and keeping
+ * only the hosts in indices (see hostindex.c), so nothing is re-sorted.
+ * If the index is unavailable the indices are sorted directly instead.
+ */
+void OrderHostIndices(ListSortState* sort, Host* hosts, int hostCount, int* indices, int count)
+{
+    if (sort == NULL || !sort->active || hosts == NULL || count < 2)
+        return;
+    
+    BYTE* include = (BYTE*)calloc(hostCount, sizeof(BYTE));
+    if (include != NULL)
+    {
+        for (int i = 0; i < count; i++)
+            include[indices[i]] = 1;
+        
+        int written = GetSortedHostView(sort->index, &sort->spec, include, hostCount, indices);
+        free(include);
+        if (written == count)
+            return;
+    }
+    
+    // Fallback: sort the indices with freshly built sort keys
+    HostSortKeys* keys = BuildHostSortKeys(hosts, hostCount);
+    SortHostIndices(keys, &sort->spec, indices, count);
+    FreeHostSortKeys(keys);
+}
+
+/*
+ * SyncListSort - Update the ordered indexes after the host array changed
+ * 
+ * Only needed once sorting is active; until then rows are shown in file order.
+ */
+void SyncListSort(ListSortState* sort, Host* hosts, int hostCount)
+{
+    if (sort == NULL || !sort->active)
+        return;
+    
+    if (sort->index == NULL)
+        sort->index = CreateHostIndex();
+    SyncHostIndex(sort->index, hosts, hostCount);
+}
+
+/*
+ * FreeListSort - Release the ordered indexes when a dialog closes
+ */
+void FreeListSort(ListSortState* sort)
+{
+    FreeHostIndex(sort->index);
+    sort->index = NULL;
+    sort->active = FALSE;
+}
+
+/*
+ * GetSelectedHostIndex - Host array index of the selected ListView row
+ * 
+ * Rows are filtered and sorted, so the row number is not the host index -
+ * the host index is stored in the item's lParam.
+ * Returns -1 if nothing is selected.
+ */
+int GetSelectedHostIndex(HWND hList)
+{
+    int selected = ListView_GetNextItem(hList, -1, LVNI_SELECTED);
+    if (selected < 0)
+        return -1;
+    
+    LVITEMW item = {0};
+    item.mask = LVIF_PARAM;
+    item.iItem = selected;
+    if (!ListView_GetItem(hList, &item))
+        return -1;
+    
+    return (int)item.lParam;
+}
+
+/*
+ * UpdateMonitorVisibleRows - Tell the host monitor which hosts are on screen
+ * 
+ * Parameters:
+ *   hList - Handle to the main ListView
+ *   hosts - Array of hosts the rows refer to (item lParam)
+ * 
+ * The monitor checks these as often as the recently connected ones.
+ */
+static void UpdateMonitorVisibleRows(HWND hList, const Host* hosts)
+{
+    const wchar_t* names[MONITOR_MAX_VISIBLE];
+    int count = 0;
+    int top = ListView_GetTopIndex(hList);
+    int last = top + ListView_GetCountPerPage(hList);  // Include the partly visible row
+    int itemCount = (hosts != NULL) ? ListView_GetItemCount(hList) : 0;
+    
+    for (int row = top; row <= last && row < itemCount && count < MONITOR_MAX_VISIBLE; row++)
+    {
+        LVITEMW item = {0};
+        item.mask = LVIF_PARAM;
+        item.iItem = row;
+        if (ListView_GetItem(hList, &item) && item.lParam >= 0)
+            names[count++] = hosts[item.lParam].hostname;
+    }
+    
+    SetMonitorVisible(names, count);
+}
+
+/*
+ * PopulateHostListView - Fill the ListView with a set of hosts
+ * 
+ * Parameters:
+ *   hList - Handle to the ListView control
+ *   hosts - Array of hosts
+ *   indices - Indices into hosts of the rows to show, in display order
+ *   count - Number of indices
+ * 
+ * Redrawing is suspended while the items are inserted so the control
+ * repaints once at the end instead of once per row.
+ * Lists with a Status column (the main list) get that text on demand
+ * from the host monitor, and the latency columns from the history.
+ */
+void PopulateHostListView(HWND hList, Host* hosts, const int* indices, int count)
+{
+    BOOL hasStatus = (Header_GetItemCount(ListView_GetHeader(hList)) > 4);
+    
+    SendMessage(hList, WM_SETREDRAW, FALSE, 0);
+    
+    // Clear existing items and reserve space for the new ones
+    ListView_DeleteAllItems(hList);
+    ListView_SetItemCount(hList, count);
+    
+    for (int displayIndex = 0; displayIndex < count; displayIndex++)
+    {
+        int i = indices[displayIndex];
         
         // Add this host to the list
         LVITEMW item = {0};
@@ -989,33 +1313,533 @@ int RefreshHostListView(HWND hList, Host* hosts, int hostCount, const wchar_t* s
         ListView_SetItemText(hList, displayIndex, 1, hosts[i].hostname);  // Hostname in column 1
         ListView_SetItemText(hList, displayIndex, 2, hosts[i].description);  // Description in column 2
         ListView_SetItemText(hList, displayIndex, 3, hosts[i].lastConnected);  // Last Connected in column 3
-        
-        displayIndex++;
+        if (hasStatus)
+        {
+            ListView_SetItemText(hList, displayIndex, 4, LPSTR_TEXTCALLBACKW);  // Status in column 4
+            ListView_SetItemText(hList, displayIndex, 5, LPSTR_TEXTCALLBACKW);  // p50 in column 5
+            ListView_SetItemText(hList, displayIndex, 6, LPSTR_TEXTCALLBACKW);  // p99 in column 6
+        }
     }
     
-    return displayIndex;  // Return number of displayed items
+    SendMessage(hList, WM_SETREDRAW, TRUE, 0);
+    
+    if (hasStatus)
+        UpdateMonitorVisibleRows(hList, hosts);
 }
 
 /*
- * MainDialogProc - Main server list dialog
+ * RefreshHostListView - Refresh the main ListView with optional filtering
+ * 
+ * Parameters:
+ *   hList - Handle to the ListView control
+ *   hosts - Array of hosts to display
+ *   hostCount - Number of hosts in array
+ *   searchText - Filter text (NULL or empty for no filtering)
+ *   ctx - Search context that receives the text and match spans for
+ *         highlighting (may be NULL)
+ *   sort - Sort state; once a column has been clicked the rows keep that
+ *          order (may be NULL)
+ * 
+ * This function refreshes the ListView with all hosts, optionally filtered
+ * by the search text (searches both hostname and description).
+ * The filter runs synchronously - the main dialog's search box uses the
+ * background search worker instead (see search.c).
+ * Returns the number of displayed items.
  */
-INT_PTR CALLBACK MainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+int RefreshHostListView(HWND hList, Host* hosts, int hostCount, const wchar_t* searchText,
+                        SearchContext* ctx, ListSortState* sort)
 {
-    static Host* hosts = NULL;
-    static int hostCount = 0;
-    static SortParams sortParams = {1, TRUE, NULL, 0};  // Default: sort by hostname, ascending
-    static SearchContext searchContext = {{0}, FALSE};  // Feature 3: Track search text for highlighting
+    // The host array may have been reloaded - update the ordered indexes
+    SyncListSort(sort, hosts, hostCount);
     
-    switch (msg)
+    if (ctx != NULL)
     {
-        case WM_INITDIALOG:
+        SetSearchContext(ctx, searchText, NULL, 0);
+        ctx->queryError[0] = L'\0';
+    }
+    
+    if (hosts == NULL || hostCount == 0)
+    {
+        ListView_DeleteAllItems(hList);
+        return 0;
+    }
+    
+    int* indices = (int*)malloc(hostCount * sizeof(int));
+    if (indices == NULL)
+    {
+        ListView_DeleteAllItems(hList);
+        return 0;
+    }
+    
+    // Record match spans only when there is something to highlight
+    SearchSpan* spans = NULL;
+    if (ctx != NULL && ctx->hasSearchText)
+        spans = AllocSearchSpans(hostCount);
+    
+    wchar_t queryError[128] = {0};
+    int displayedCount = FilterHosts(hosts, hostCount, searchText, indices, spans, queryError, 128);
+    if (displayedCount < 0)
+    {
+        // Invalid query (usually half-typed) - list every host and keep the
+        // error for the count label. The old rows cannot be kept because the
+        // host array may have just been reloaded.
+        free(spans);
+        spans = NULL;
+        displayedCount = FilterHosts(hosts, hostCount, NULL, indices, NULL, NULL, 0);
+        if (ctx != NULL)
         {
-            // Track this dialog instance
-            g_hwndMainDialog = hwnd;
-            
-            CenterWindow(hwnd);
-            
-            // Apply dark mode if enabled
+            SetSearchContext(ctx, NULL, NULL, 0);
+            wcscpy_s(ctx->queryError, 128, queryError);
+        }
+    }
+    if (spans != NULL)
+        SetSearchContext(ctx, searchText, spans, hostCount);
+    OrderHostIndices(sort, hosts, hostCount, indices, displayedCount);
+    PopulateHostListView(hList, hosts, indices, displayedCount);
+    
+    free(indices);
+    return displayedCount;  // Return number of displayed items
+}
+
+/*
+ * SortHostListView - Sort the rows currently shown in a host ListView
+ * 
+ * Parameters:
+ *   hList - Handle to the ListView control
+ *   hosts - Host array the items point into (item lParam = host index)
+ *   hostCount - Number of hosts in array
+ *   sort - Sort state (spec already updated for the clicked column)
+ * 
+ * Called when a column header is clicked. From then on the list keeps this
+ * order through refreshes, searches and edits (see RefreshHostListView).
+ * The selected host stays selected.
+ */
+void SortHostListView(HWND hList, Host* hosts, int hostCount, ListSortState* sort)
+{
+    int count = ListView_GetItemCount(hList);
+    
+    // Turn sorting on and bring the ordered indexes up to date
+    if (!sort->active)
+    {
+        sort->active = TRUE;
+        SyncListSort(sort, hosts, hostCount);
+    }
+    
+    if (hosts == NULL || count < 2)
+        return;
+    
+    int* indices = (int*)malloc(count * sizeof(int));
+    if (indices == NULL)
+        return;
+    
+    // Collect the host index of every row
+    int selectedHost = -1;
+    for (int i = 0; i < count; i++)
+    {
+        LVITEMW item = {0};
+        item.mask = LVIF_PARAM | LVIF_STATE;
+        item.iItem = i;
+        item.stateMask = LVIS_SELECTED;
+        ListView_GetItem(hList, &item);
+        
+        indices[i] = (int)item.lParam;
+        if (item.state & LVIS_SELECTED)
+            selectedHost = indices[i];
+    }
+    
+    OrderHostIndices(sort, hosts, hostCount, indices, count);
+    PopulateHostListView(hList, hosts, indices, count);
+    
+    // Restore the selection
+    for (int i = 0; selectedHost >= 0 && i < count; i++)
+    {
+        if (indices[i] == selectedHost)
+        {
+            ListView_SetItemState(hList, i, LVIS_SELECTED | LVIS_FOCUSED, LVIS_SELECTED | LVIS_FOCUSED);
+            ListView_EnsureVisible(hList, i, FALSE);
+            break;
+        }
+    }
+    
+    free(indices);
+}
+
+/*
+ * ApplySearchResult - Show a result produced by the background search worker
+ * 
+ * Parameters:
+ *   hwnd - Main dialog handle
+ *   hosts - Host array the result indexes into
+ *   hostCount - Number of hosts in array
+ *   result - Result received with WM_SEARCH_COMPLETE
+ *   sort - Sort state of the list (matches are shown in that order)
+ * 
+ * Also records the per-keystroke timings in the diagnostics histograms
+ * (see perfstats.h).
+ */
+void ApplySearchResult(HWND hwnd, Host* hosts, int hostCount, SearchResult* result, ListSortState* sort)
+{
+    HWND hList = GetDlgItem(hwnd, IDC_LIST_SERVERS);
+    
+    LONGLONG populateTicks = GetSearchTicks();
+    OrderHostIndices(sort, hosts, hostCount, result->indices, result->count);
+    PopulateHostListView(hList, hosts, result->indices, result->count);
+    
+    LONGLONG labelTicks = GetSearchTicks();
+    UpdateHostCountLabel(hwnd, IDC_STATIC_HOST_COUNT, result->count, hostCount, NULL);
+    LONGLONG labelDoneTicks = GetSearchTicks();
+    
+    // Repaint now so the measured time includes the actual paint
+    InvalidateRect(hList, NULL, FALSE);
+    UpdateWindow(hList);
+    LONGLONG paintedTicks = GetSearchTicks();
+    
+    RecordPerfSample(PERF_SEARCH_QUEUE, SearchTicksToMs(result->startTicks - result->submitTicks));
+    RecordPerfSample(PERF_SEARCH_FILTER, SearchTicksToMs(result->endTicks - result->startTicks));
+    RecordPerfSample(PERF_LIST_POPULATE, SearchTicksToMs(labelTicks - populateTicks));
+    RecordPerfSample(PERF_COUNT_LABEL, SearchTicksToMs(labelDoneTicks - labelTicks));
+    RecordPerfSample(PERF_KEY_TO_PAINT, SearchTicksToMs(paintedTicks - result->submitTicks));
+}
+
+/*
+ * ExpandHostGroup - Create the host items of a group node about to be expanded
+ * 
+ * Parameters:
+ *   hTree - Handle to the TreeView control
+ *   hosts - Host array
+ *   tree - Group state the tree was built from
+ *   hGroup - Group node (host items and nodes that already have children are ignored)
+ */
+void ExpandHostGroup(HWND hTree, const Host* hosts, const GroupTreeState* tree, HTREEITEM hGroup)
+{
+    TVITEMW node = {0};
+    node.mask = TVIF_PARAM;
+    node.hItem = hGroup;
+    if (!TreeView_GetItem(hTree, &node))
+        return;
+    
+    int group = -1 - (int)node.lParam;
+    if (tree->groups == NULL || group < 0 || group >= GetHostGroupCount(tree->groups) ||
+        TreeView_GetChild(hTree, hGroup) != NULL)
+    {
+        return;
+    }
+    
+    const int* members;
+    int memberCount = GetHostGroupMembers(tree->groups, group, &members);
+    
+    SendMessage(hTree, WM_SETREDRAW, FALSE, 0);
+    for (int i = 0; i < memberCount; i++)
+    {
+        const Host* host = &hosts[members[i]];
+        wchar_t text[MAX_HOSTNAME_LEN + MAX_DESCRIPTION_LEN + 4];
+        if (host->description[0] != L'\0')
+            swprintf_s(text, ARRAYSIZE(text), L"%s - %s", host->hostname, host->description);
+        else
+            wcscpy_s(text, ARRAYSIZE(text), host->hostname);
+        
+        TVINSERTSTRUCTW insert = {0};
+        insert.hParent = hGroup;
+        insert.hInsertAfter = TVI_LAST;
+        insert.item.mask = TVIF_TEXT | TVIF_PARAM;
+        insert.item.pszText = text;
+        insert.item.lParam = members[i];
+        TreeView_InsertItem(hTree, &insert);
+    }
+    SendMessage(hTree, WM_SETREDRAW, TRUE, 0);
+}
+
+/*
+ * RebuildGroupTree - Show the main dialog's hosts as a tree of groups
+ * 
+ * Parameters:
+ *   hwndDialog - Main dialog handle
+ *   hosts - Host array the ListView items point into
+ *   tree - Group state (mode chosen in the "Group by" box)
+ * 
+ * The ListView stays the single source of truth: it is filtered and sorted
+ * as usual (hidden while grouping), and the tree is rebuilt from its rows.
+ * Only the group nodes are created here; a group's hosts are inserted when
+ * it is expanded (see ExpandHostGroup), so a huge list costs one tree item
+ * per group rather than one per host.
+ */
+void RebuildGroupTree(HWND hwndDialog, const Host* hosts, GroupTreeState* tree)
+{
+    HWND hList = GetDlgItem(hwndDialog, IDC_LIST_SERVERS);
+    HWND hTree = GetDlgItem(hwndDialog, IDC_TREE_SERVERS);
+    
+    SendMessage(hTree, WM_SETREDRAW, FALSE, 0);
+    TreeView_DeleteAllItems(hTree);
+    FreeHostGroups(tree->groups);
+    tree->groups = NULL;
+    
+    if (tree->mode == GROUP_BY_NONE || hosts == NULL)
+    {
+        SendMessage(hTree, WM_SETREDRAW, TRUE, 0);
+        ShowWindow(hTree, SW_HIDE);
+        ShowWindow(hList, SW_SHOW);
+        return;
+    }
+    
+    // Group the rows in their current (filtered, sorted) order
+    int count = ListView_GetItemCount(hList);
+    int* indices = (int*)malloc((count > 0 ? count : 1) * sizeof(int));
+    if (indices != NULL)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            LVITEMW item = {0};
+            item.mask = LVIF_PARAM;
+            item.iItem = i;
+            ListView_GetItem(hList, &item);
+            indices[i] = (int)item.lParam;
+        }
+        tree->groups = BuildHostGroups(hosts, indices, count, tree->mode);
+        free(indices);
+    }
+    
+    // One collapsed node per group; lParam = -1 - group number
+    HTREEITEM hOnlyGroup = NULL;
+    int groupCount = GetHostGroupCount(tree->groups);
+    for (int g = 0; g < groupCount; g++)
+    {
+        const int* members;
+        int memberCount = GetHostGroupMembers(tree->groups, g, &members);
+        
+        wchar_t text[MAX_HOSTNAME_LEN + 32];
+        swprintf_s(text, ARRAYSIZE(text), L"%s (%d)", GetHostGroupName(tree->groups, g), memberCount);
+        
+        TVINSERTSTRUCTW insert = {0};
+        insert.hParent = TVI_ROOT;
+        insert.hInsertAfter = TVI_LAST;
+        insert.item.mask = TVIF_TEXT | TVIF_PARAM | TVIF_CHILDREN;
+        insert.item.pszText = text;
+        insert.item.lParam = -1 - g;
+        insert.item.cChildren = 1;     // Show the expand button before children exist
+        hOnlyGroup = TreeView_InsertItem(hTree, &insert);
+    }
+    
+    // A single group (e.g. after a narrow search) is opened straight away.
+    // TVM_EXPAND sends no TVN_ITEMEXPANDING, so fill the group first.
+    if (groupCount == 1 && hOnlyGroup != NULL)
+    {
+        ExpandHostGroup(hTree, hosts, tree, hOnlyGroup);
+        TreeView_Expand(hTree, hOnlyGroup, TVE_EXPAND);
+    }
+    
+    SendMessage(hTree, WM_SETREDRAW, TRUE, 0);
+    ShowWindow(hList, SW_HIDE);
+    ShowWindow(hTree, SW_SHOW);
+}
+
+/*
+ * FreeGroupTree - Free the groups (the chosen mode is kept)
+ */
+void FreeGroupTree(GroupTreeState* tree)
+{
+    FreeHostGroups(tree->groups);
+    tree->groups = NULL;
+}
+
+/*
+ * GetSelectedMainHost - Host index selected in the main dialog's list or tree
+ * 
+ * Returns -1 if nothing (or a group node) is selected.
+ */
+int GetSelectedMainHost(HWND hwndDialog, const GroupTreeState* tree)
+{
+    if (tree->mode == GROUP_BY_NONE)
+        return GetSelectedHostIndex(GetDlgItem(hwndDialog, IDC_LIST_SERVERS));
+    
+    HWND hTree = GetDlgItem(hwndDialog, IDC_TREE_SERVERS);
+    HTREEITEM hItem = TreeView_GetSelection(hTree);
+    if (hItem == NULL)
+        return -1;
+    
+    TVITEMW item = {0};
+    item.mask = TVIF_PARAM;
+    item.hItem = hItem;
+    if (!TreeView_GetItem(hTree, &item))
+        return -1;
+    
+    return (int)item.lParam;    // Group nodes are negative
+}
+
+/*
+ * StartListedHostsProbe - Probe hosts of the main list in the background
+ * 
+ * Parameters:
+ *   hwnd      - Main dialog (receives WM_PROBE_COMPLETE)
+ *   hList     - Host list
+ *   hosts     - Host array the list's lParams index
+ *   hostCount - Number of hosts
+ *   onlyRow   - Row to probe, or -1 for every row the list shows
+ * 
+ * Returns:
+ *   The probe job, or NULL if nothing could be started
+ */
+ProbeJob* StartListedHostsProbe(HWND hwnd, HWND hList, const Host* hosts, int hostCount, int onlyRow)
+{
+    int rowCount = ListView_GetItemCount(hList);
+    const wchar_t** names = (const wchar_t**)malloc(sizeof(wchar_t*) * (rowCount > 0 ? rowCount : 1));
+    int count = 0;
+    
+    if (names == NULL)
+        return NULL;
+    
+    for (int row = 0; row < rowCount; row++)
+    {
+        if (onlyRow >= 0 && row != onlyRow)
+            continue;
+        
+        LVITEMW item = {0};
+        item.mask = LVIF_PARAM;
+        item.iItem = row;
+        ListView_GetItem(hList, &item);
+        int hostIndex = (int)item.lParam;
+        if (hostIndex >= 0 && hostIndex < hostCount)
+            names[count++] = hosts[hostIndex].hostname;
+    }
+    
+    ProbeOptions options = {0};
+    options.concurrency = (int)GetSettingDWORD(REG_PROBE_CONCURRENCY, PROBE_CONCURRENCY);
+    options.timeoutMs = GetSettingDWORD(REG_PROBE_TIMEOUT, PROBE_TIMEOUT_MS);
+    options.negotiate = (GetSettingDWORD(REG_PROBE_NEGOTIATE, PROBE_NEGOTIATE) != 0);
+    
+    // The job copies the names
+    ProbeJob* job = StartProbeJob(names, count, &options, hwnd);
+    free(names);
+    return job;
+}
+
+/*
+ * ShowProbeResults - Report a finished probe job
+ * 
+ * A single host gets its round-trip time and RDP security, or the reason
+ * it failed; a list gets the count that answered, how many of those speak
+ * RDP with which security, and the first hosts that did not.
+ */
+void ShowProbeResults(HWND hwnd, ProbeJob* job, int reachable)
+{
+    const ProbeResult* results = NULL;
+    int count = GetProbeJobResults(job, &results);
+    wchar_t message[2048];
+    
+    if (count == 1)
+    {
+        if (results[0].reachable && results[0].rdp.answered && !results[0].rdp.refused)
+            swprintf_s(message, ARRAYSIZE(message), L"%s answered on port %u in %.0f ms.\n\n"
+                       L"RDP security: %s (negotiated in %.0f ms).",
+                       results[0].hostname, results[0].port, results[0].rttMs,
+                       DescribeRdpNegotiation(&results[0].rdp), results[0].rdp.handshakeMs);
+        else if (results[0].reachable && results[0].rdp.attempted)
+            swprintf_s(message, ARRAYSIZE(message), L"%s answered on port %u in %.0f ms, but: %s.",
+                       results[0].hostname, results[0].port, results[0].rttMs,
+                       DescribeRdpNegotiation(&results[0].rdp));
+        else if (results[0].reachable)
+            swprintf_s(message, ARRAYSIZE(message), L"%s answered on port %u in %.0f ms.",
+                       results[0].hostname, results[0].port, results[0].rttMs);
+        else
+            swprintf_s(message, ARRAYSIZE(message), L"%s did not accept a connection on port %u (%s, error %lu).",
+                       results[0].hostname, results[0].port, DescribeProbeError(results[0].error), results[0].error);
+        ShowInfoMessage(hwnd, message);
+        return;
+    }
+    
+    swprintf_s(message, ARRAYSIZE(message), L"%d of %d hosts accept RDP connections.", reachable, count);
+    
+    // What the RDP servers among them asked for
+    int nla = 0, tls = 0, standard = 0, notRdp = 0;
+    for (int i = 0; i < count; i++)
+    {
+        const RdpNegotiation* rdp = &results[i].rdp;
+        if (!results[i].reachable || !rdp->attempted)
+            continue;
+        if (!rdp->answered || rdp->refused)
+            notRdp++;
+        else if (rdp->protocol & (RDP_PROTOCOL_HYBRID | RDP_PROTOCOL_HYBRID_EX))
+            nla++;
+        else if (rdp->protocol & (RDP_PROTOCOL_SSL | RDP_PROTOCOL_RDSTLS))
+            tls++;
+        else
+            standard++;
+    }
+    if (nla + tls + standard + notRdp > 0)
+    {
+        wchar_t security[160];
+        swprintf_s(security, ARRAYSIZE(security), L"\nRDP security: %d NLA, %d TLS, %d standard; %d without an RDP reply.",
+                   nla, tls, standard, notRdp);
+        wcscat_s(message, ARRAYSIZE(message), security);
+    }
+    
+    // Hosts that failed the connect, then those that connected but did not speak RDP
+    int listed = 0;
+    for (int i = 0; i < count && listed < 15; i++)
+    {
+        if (results[i].reachable)
+            continue;
+        if (listed++ == 0)
+            wcscat_s(message, ARRAYSIZE(message), L"\n\nNot reachable:");
+        
+        wchar_t line[MAX_HOSTNAME_LEN + 64];
+        swprintf_s(line, ARRAYSIZE(line), L"\n• %s (%s)", results[i].hostname, DescribeProbeError(results[i].error));
+        wcscat_s(message, ARRAYSIZE(message), line);
+    }
+    int listedNotRdp = 0;
+    for (int i = 0; i < count && listed + listedNotRdp < 15; i++)
+    {
+        const RdpNegotiation* rdp = &results[i].rdp;
+        if (!results[i].reachable || !rdp->attempted || (rdp->answered && !rdp->refused))
+            continue;
+        if (listedNotRdp++ == 0)
+            wcscat_s(message, ARRAYSIZE(message), L"\n\nConnected, but no RDP session offered:");
+        
+        wchar_t line[MAX_HOSTNAME_LEN + 80];
+        swprintf_s(line, ARRAYSIZE(line), L"\n• %s (%s)", results[i].hostname, DescribeRdpNegotiation(rdp));
+        wcscat_s(message, ARRAYSIZE(message), line);
+    }
+    if (count - reachable + notRdp > listed + listedNotRdp)
+    {
+        wchar_t more[64];
+        swprintf_s(more, ARRAYSIZE(more), L"\n... and %d more", count - reachable + notRdp - listed - listedNotRdp);
+        wcscat_s(message, ARRAYSIZE(message), more);
+    }
+    ShowInfoMessage(hwnd, message);
+}
+
+/*
+ * MainDialogProc - Main server list dialog
+ */
+INT_PTR CALLBACK MainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    static Host* hosts = NULL;
+    static int hostCount = 0;
+    static ListSortState listSort = {{SORT_COLUMN_HOSTNAME, TRUE, SORT_COLUMN_NONE, TRUE}, FALSE, NULL};  // Default: sort by hostname, ascending
+    static SearchContext searchContext = {{0}, FALSE, NULL, 0, NULL, {0}};  // Feature 3: Track search text for highlighting
+    static wchar_t pendingSearch[256] = {0};  // Search box text waiting for the debounce timer
+    static LONGLONG pendingSearchTicks = 0;    // When the pending keystroke arrived
+    static UINT searchDebounceMs = SEARCH_DEBOUNCE_MS;
+    static GroupTreeState groupTree = {GROUP_BY_NONE, NULL};  // Mode survives reopening the dialog
+    static ProbeJob* probeJob = NULL;         // Reachability check in progress
+    
+    switch (msg)
+    {
+        case WM_INITDIALOG:
+        {
+            // Track this dialog instance
+            g_hwndMainDialog = hwnd;
+            
+            // Start the background search worker and read the debounce delay
+            StartSearchWorker(hwnd);
+            StartHostMonitor(hwnd);
+            LoadLatencyHistory();
+            g_launchPending = FALSE;
+            searchDebounceMs = GetSettingDWORD(REG_SEARCH_DEBOUNCE, SEARCH_DEBOUNCE_MS);
+            ClearSearchContext(&searchContext);
+            
+            CenterWindow(hwnd);
+            
+            // Apply dark mode if enabled
             ApplyDarkModeToDialog(hwnd);
             
             // Set dialog icon
@@ -1045,7 +1869,7 @@ INT_PTR CALLBACK MainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
             // Add invisible dummy column at position 0
             col.mask = LVCF_TEXT | LVCF_WIDTH;
             col.pszText = L"";
-            col.cx = 1;  // Almost invisible
+            col.cx = COLUMN_WIDTH_DUMMY;  // Almost invisible
             ListView_InsertColumn(hList, 0, &col);
             
             // Now add the real columns which CAN be centered
@@ -1053,24 +1877,132 @@ INT_PTR CALLBACK MainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
             col.fmt = LVCFMT_CENTER;
             
             col.pszText = L"Hostname";
-            col.cx = 170;
+            col.cx = COLUMN_WIDTH_HOSTNAME;
             ListView_InsertColumn(hList, 1, &col);
             
             col.pszText = L"Description";
-            col.cx = listWidth - 170 - 160 - 5;  // Takes most of the remaining space
+            col.cx = GetDescriptionColumnWidth(listWidth, TRUE);  // Takes most of the remaining space
             ListView_InsertColumn(hList, 2, &col);
             
             col.pszText = L"Last Connected";
-            col.cx = 160;  // Fixed width for timestamp
+            col.cx = COLUMN_WIDTH_LAST_CONNECTED;  // Fixed width for timestamp
             ListView_InsertColumn(hList, 3, &col);
             
+            col.pszText = L"Status";
+            col.cx = COLUMN_WIDTH_STATUS;  // Filled in by the host monitor
+            ListView_InsertColumn(hList, 4, &col);
+            
+            col.pszText = L"p50";
+            col.cx = COLUMN_WIDTH_LATENCY;  // Connect time percentiles from the latency history
+            ListView_InsertColumn(hList, 5, &col);
+            
+            col.pszText = L"p99";
+            ListView_InsertColumn(hList, 6, &col);
+            
             // Load and display hosts
             if (LoadHosts(&hosts, &hostCount))
             {
-                int displayedCount = RefreshHostListView(hList, hosts, hostCount, NULL);
-                UpdateHostCountLabel(hwnd, IDC_STATIC_HOST_COUNT, displayedCount, hostCount);
+                SetSearchHosts(hosts, hostCount);
+                SetMonitorHosts(hosts, hostCount);
+                int displayedCount = RefreshHostListView(hList, hosts, hostCount, NULL, &searchContext, &listSort);
+                UpdateHostCountLabel(hwnd, IDC_STATIC_HOST_COUNT, displayedCount, hostCount, searchContext.queryError);
+            }
+            
+            // Group-by choices (order matches GroupMode)
+            HWND hGroupBy = GetDlgItem(hwnd, IDC_COMBO_GROUP_BY);
+            SendMessageW(hGroupBy, CB_ADDSTRING, 0, (LPARAM)L"No grouping");
+            SendMessageW(hGroupBy, CB_ADDSTRING, 0, (LPARAM)L"Domain");
+            SendMessageW(hGroupBy, CB_ADDSTRING, 0, (LPARAM)L"Name prefix");
+            SendMessageW(hGroupBy, CB_SETCURSEL, groupTree.mode, 0);
+            
+            ApplyDarkModeToTreeView(GetDlgItem(hwnd, IDC_TREE_SERVERS));
+            RebuildGroupTree(hwnd, hosts, &groupTree);
+            
+            return TRUE;
+        }
+
+        case WM_TIMER:
+        {
+            // Debounce interval elapsed - hand the newest search text to the worker
+            if (wParam == TIMER_SEARCH_DEBOUNCE)
+            {
+                KillTimer(hwnd, TIMER_SEARCH_DEBOUNCE);
+                SubmitSearch(pendingSearch, pendingSearchTicks);
+            }
+            return TRUE;
+        }
+
+        case WM_MONITOR_UPDATE:
+        {
+            // Host monitor has new statuses - repaint the rows on screen
+            AcknowledgeMonitorUpdate();
+            HWND hList = GetDlgItem(hwnd, IDC_LIST_SERVERS);
+            int top = ListView_GetTopIndex(hList);
+            ListView_RedrawItems(hList, top, top + ListView_GetCountPerPage(hList));
+            return TRUE;
+        }
+        
+        case WM_LAUNCH_COMPLETE:
+            // Connect finished - close the dialog if mstsc started, otherwise stay
+            g_launchPending = FALSE;
+            SetWindowTextW(hwnd, APP_WINDOW_TITLE);
+            if (FinishLaunch((LaunchResult*)lParam, hwnd))
+            {
+                EndDialog(hwnd, IDOK);
+            }
+            return TRUE;
+        
+        case WM_SETCURSOR:
+            // Connect in progress - the dialog still works, so show the background-work cursor
+            if (g_launchPending)
+            {
+                SetCursor(LoadCursor(NULL, IDC_APPSTARTING));
+                SetWindowLongPtr(hwnd, DWLP_MSGRESULT, TRUE);
+                return TRUE;
+            }
+            break;
+        
+        case WM_PROBE_COMPLETE:
+            // Reachability check finished - report it and release the job
+            if (probeJob != NULL)
+            {
+                ShowProbeResults(hwnd, probeJob, (int)wParam);
+                FreeProbeJob(probeJob);
+                probeJob = NULL;
+                
+                // New connect times - repaint the latency columns on screen
+                HWND hList = GetDlgItem(hwnd, IDC_LIST_SERVERS);
+                int top = ListView_GetTopIndex(hList);
+                ListView_RedrawItems(hList, top, top + ListView_GetCountPerPage(hList));
+            }
+            return TRUE;
+        
+        case WM_SEARCH_COMPLETE:
+        {
+            // Background search finished - show it only if it is still the newest query
+            SearchResult* result = (SearchResult*)lParam;
+            
+            if (IsCurrentSearch(result) && hosts != NULL && result->error[0] != L'\0')
+            {
+                // Query does not parse yet - leave the list as it is and report why
+                wcscpy_s(searchContext.queryError, 128, result->error);
+                UpdateHostCountLabel(hwnd, IDC_STATIC_HOST_COUNT,
+                                     ListView_GetItemCount(GetDlgItem(hwnd, IDC_LIST_SERVERS)),
+                                     hostCount, searchContext.queryError);
+            }
+            else if (IsCurrentSearch(result) && hosts != NULL)
+            {
+                searchContext.queryError[0] = L'\0';
+                
+                // Feature 3: Keep the match spans for highlighting (context takes ownership)
+                SetSearchContext(&searchContext, result->searchText, result->spans, result->spanHostCount);
+                result->spans = NULL;
+                
+                ApplySearchResult(hwnd, hosts, hostCount, result, &listSort);
+                RebuildGroupTree(hwnd, hosts, &groupTree);
             }
             
+            FreeSearchResult(result);
             return TRUE;
         }
 
@@ -1078,9 +2010,82 @@ INT_PTR CALLBACK MainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
         {
             LPNMHDR pnmhdr = (LPNMHDR)lParam;
             
-            if (pnmhdr->idFrom == IDC_LIST_SERVERS)
+            if (pnmhdr->idFrom == IDC_TREE_SERVERS)
+            {
+                if (pnmhdr->code == TVN_ITEMEXPANDINGW)
+                {
+                    // Group opened - create its host items now
+                    LPNMTREEVIEWW pnmtv = (LPNMTREEVIEWW)lParam;
+                    if (pnmtv->action == TVE_EXPAND)
+                        ExpandHostGroup(pnmhdr->hwndFrom, hosts, &groupTree, pnmtv->itemNew.hItem);
+                    return TRUE;
+                }
+                else if (pnmhdr->code == TVN_ITEMEXPANDEDW)
+                {
+                    // Group closed - drop its host items again (cChildren keeps the button)
+                    LPNMTREEVIEWW pnmtv = (LPNMTREEVIEWW)lParam;
+                    if (pnmtv->action == TVE_COLLAPSE)
+                        TreeView_Expand(pnmhdr->hwndFrom, pnmtv->itemNew.hItem, TVE_COLLAPSE | TVE_COLLAPSERESET);
+                    return TRUE;
+                }
+                else if (pnmhdr->code == TVN_SELCHANGEDW)
+                {
+                    // Selected host is the likeliest next connect - prepare its .rdp file
+                    int hostIndex = GetSelectedMainHost(hwnd, &groupTree);
+                    if (hostIndex >= 0 && hostIndex < hostCount)
+                        PrewarmSelectedHost(hosts[hostIndex].hostname);
+                    return TRUE;
+                }
+                else if (pnmhdr->code == NM_DBLCLK)
+                {
+                    // Double-click on a host (group nodes just expand)
+                    int hostIndex = GetSelectedMainHost(hwnd, &groupTree);
+                    if (hostIndex >= 0 && hostIndex < hostCount)
+                    {
+                        LaunchRDPWithVisualFeedback(hwnd, hosts[hostIndex].hostname);
+                        SetWindowLongPtr(hwnd, DWLP_MSGRESULT, TRUE);
+                    }
+                    return TRUE;
+                }
+            }
+            else if (pnmhdr->idFrom == IDC_LIST_SERVERS)
             {
-                if (pnmhdr->code == NM_DBLCLK)
+                if (pnmhdr->code == LVN_GETDISPINFOW)
+                {
+                    // Status column - newest answer of the host monitor (never blocks);
+                    // p50/p99 columns - connect time percentiles of the host
+                    NMLVDISPINFOW* pdi = (NMLVDISPINFOW*)lParam;
+                    int hostIndex = (int)pdi->item.lParam;
+                    
+                    if ((pdi->item.mask & LVIF_TEXT) && pdi->item.cchTextMax > 0)
+                    {
+                        HostStatus status;
+                        LatencySummary latency;
+                        pdi->item.pszText[0] = L'\0';
+                        if (hostIndex < 0 || hostIndex >= hostCount)
+                            return TRUE;
+                        
+                        if (pdi->item.iSubItem == 4 && GetHostStatus(hosts[hostIndex].hostname, &status))
+                        {
+                            FormatHostStatus(&status, pdi->item.pszText, pdi->item.cchTextMax);
+                        }
+                        else if ((pdi->item.iSubItem == 5 || pdi->item.iSubItem == 6) &&
+                                 GetHostLatency(hosts[hostIndex].hostname, &latency))
+                        {
+                            double ms = (pdi->item.iSubItem == 5) ? latency.p50Ms : latency.p99Ms;
+                            swprintf_s(pdi->item.pszText, pdi->item.cchTextMax,
+                                       (ms < 10.0) ? L"%.1f ms" : L"%.0f ms", ms);
+                        }
+                    }
+                    return TRUE;
+                }
+                else if (pnmhdr->code == LVN_ENDSCROLL)
+                {
+                    // Other rows on screen - the monitor checks those first now
+                    UpdateMonitorVisibleRows(pnmhdr->hwndFrom, hosts);
+                    return TRUE;
+                }
+                else if (pnmhdr->code == NM_DBLCLK)
                 {
                     // Double-click on a server - connect to it
                     HWND hList = GetDlgItem(hwnd, IDC_LIST_SERVERS);
@@ -1098,10 +2103,7 @@ INT_PTR CALLBACK MainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                         if (hostIndex >= 0 && hostIndex < hostCount)
                         {
                             // Feature 2: Visual feedback on connection
-                            if (LaunchRDPWithVisualFeedback(hwnd, hosts[hostIndex].hostname))
-                            {
-                                EndDialog(hwnd, IDOK);
-                            }
+                            LaunchRDPWithVisualFeedback(hwnd, hosts[hostIndex].hostname);
                         }
                     }
                     return TRUE;
@@ -1129,10 +2131,7 @@ INT_PTR CALLBACK MainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                             if (hostIndex >= 0 && hostIndex < hostCount)
                             {
                                 // Feature 2: Visual feedback on connection
-                                if (LaunchRDPWithVisualFeedback(hwnd, hosts[hostIndex].hostname))
-                                {
-                                    EndDialog(hwnd, IDOK);
-                                }
+                                LaunchRDPWithVisualFeedback(hwnd, hosts[hostIndex].hostname);
                             }
                         }
                         return TRUE;
@@ -1163,21 +2162,26 @@ INT_PTR CALLBACK MainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                                 {
                                     if (DeleteHost(hosts[hostIndex].hostname))
                                     {
-                                        // Reload the list
+                                        // Reload the list (detach the search worker first)
+                                        SetSearchHosts(NULL, 0);
                                         FreeHosts(hosts, hostCount);
                                         hosts = NULL;
                                         hostCount = 0;
                                         
                                         if (LoadHosts(&hosts, &hostCount))
                                         {
+                                            SetSearchHosts(hosts, hostCount);
+                                            SetMonitorHosts(hosts, hostCount);
+                                            
                                             // Get search text if any
                                             HWND hSearch = GetDlgItem(hwnd, IDC_EDIT_SEARCH);
                                             wchar_t searchText[256] = {0};
                                             GetWindowTextW(hSearch, searchText, 256);
                                             
-                                            int displayedCount = RefreshHostListView(hList, hosts, hostCount, searchText);
-                                            UpdateHostCountLabel(hwnd, IDC_STATIC_HOST_COUNT, displayedCount, hostCount);
+                                            int displayedCount = RefreshHostListView(hList, hosts, hostCount, searchText, &searchContext, &listSort);
+                                            UpdateHostCountLabel(hwnd, IDC_STATIC_HOST_COUNT, displayedCount, hostCount, searchContext.queryError);
                                         }
+                                        RebuildGroupTree(hwnd, hosts, &groupTree);
                                     }
                                     else
                                     {
@@ -1189,36 +2193,37 @@ INT_PTR CALLBACK MainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                         return TRUE;
                     }
                 }
+                else if (pnmhdr->code == LVN_ITEMCHANGED)
+                {
+                    // Row selected - its host is the likeliest next connect, prepare its .rdp file
+                    LPNMLISTVIEW pnmlv = (LPNMLISTVIEW)lParam;
+                    if ((pnmlv->uChanged & LVIF_STATE) && (pnmlv->uNewState & LVIS_SELECTED) &&
+                        !(pnmlv->uOldState & LVIS_SELECTED))
+                    {
+                        int hostIndex = (int)pnmlv->lParam;
+                        if (hostIndex >= 0 && hostIndex < hostCount)
+                            PrewarmSelectedHost(hosts[hostIndex].hostname);
+                    }
+                    return TRUE;
+                }
                 else if (pnmhdr->code == LVN_COLUMNCLICK)
                 {
                     // Column header clicked - sort by that column
                     LPNMLISTVIEW pnmlv = (LPNMLISTVIEW)lParam;
                     HWND hList = GetDlgItem(hwnd, IDC_LIST_SERVERS);
                     
-                    // Note: Column 0 is dummy, so actual columns are 1, 2, 3
+                    // Note: Column 0 is dummy, so actual columns are 1, 2, 3 (and 5, 6 for latency)
                     int clickedColumn = pnmlv->iSubItem;
                     
-                    // Only sort if clicking on actual columns (not dummy column 0)
-                    if (clickedColumn == 1 || clickedColumn == 2 || clickedColumn == 3)
+                    // Only sort if clicking on actual columns (not dummy column 0 or the status)
+                    if (clickedColumn == 1 || clickedColumn == 2 || clickedColumn == 3 ||
+                        clickedColumn == SORT_COLUMN_LATENCY_P50 || clickedColumn == SORT_COLUMN_LATENCY_P99)
                     {
-                        // If clicking the same column, toggle sort direction
-                        if (sortParams.sortColumn == clickedColumn)
-                        {
-                            sortParams.sortAscending = !sortParams.sortAscending;
-                        }
-                        else
-                        {
-                            // New column - default to ascending
-                            sortParams.sortColumn = clickedColumn;
-                            sortParams.sortAscending = TRUE;
-                        }
-                        
-                        // Update sort params with current host data
-                        sortParams.hosts = hosts;
-                        sortParams.hostCount = hostCount;
+                        // Same column toggles direction; a new column keeps the old one as tie-breaker
+                        SetSortColumn(&listSort.spec, clickedColumn);
                         
                         // Perform the sort
-                        ListView_SortItems(hList, CompareListViewItems, (LPARAM)&sortParams);
+                        SortHostListView(hList, hosts, hostCount, &listSort);
                     }
                     return TRUE;
                 }
@@ -1240,6 +2245,9 @@ INT_PTR CALLBACK MainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                         {
                             AppendMenuW(hMenu, MF_STRING, IDM_CONTEXT_CONNECT, L"Connect");
                             AppendMenuW(hMenu, MF_SEPARATOR, 0, NULL);
+                            AppendMenuW(hMenu, MF_STRING | (probeJob != NULL ? MF_GRAYED : 0), IDM_CONTEXT_PROBE, L"Check Reachability");
+                            AppendMenuW(hMenu, MF_STRING | (probeJob != NULL ? MF_GRAYED : 0), IDM_CONTEXT_PROBE_ALL, L"Check All Listed Hosts");
+                            AppendMenuW(hMenu, MF_SEPARATOR, 0, NULL);
                             AppendMenuW(hMenu, MF_STRING, IDM_CONTEXT_DELETE, L"Delete");
                             
                             // Required to make menu disappear when clicking outside
@@ -1252,7 +2260,15 @@ INT_PTR CALLBACK MainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                             DestroyMenu(hMenu);
                             
                             // Handle menu selection
-                            if (cmd == IDM_CONTEXT_CONNECT)
+                            if (cmd == IDM_CONTEXT_PROBE || cmd == IDM_CONTEXT_PROBE_ALL)
+                            {
+                                // Runs in the background; WM_PROBE_COMPLETE reports it
+                                probeJob = StartListedHostsProbe(hwnd, hList, hosts, hostCount,
+                                                                 (cmd == IDM_CONTEXT_PROBE) ? selected : -1);
+                                if (probeJob == NULL)
+                                    ShowErrorMessage(hwnd, L"Failed to start the reachability check.");
+                            }
+                            else if (cmd == IDM_CONTEXT_CONNECT)
                             {
                                 // Connect to selected host
                                 LVITEMW item = {0};
@@ -1264,10 +2280,7 @@ INT_PTR CALLBACK MainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                                 if (hostIndex >= 0 && hostIndex < hostCount)
                                 {
                                     // Feature 2: Visual feedback on connection
-                                    if (LaunchRDPWithVisualFeedback(hwnd, hosts[hostIndex].hostname))
-                                    {
-                                        EndDialog(hwnd, IDOK);
-                                    }
+                                    LaunchRDPWithVisualFeedback(hwnd, hosts[hostIndex].hostname);
                                 }
                             }
                             else if (cmd == IDM_CONTEXT_DELETE)
@@ -1289,21 +2302,26 @@ INT_PTR CALLBACK MainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                                     {
                                         if (DeleteHost(hosts[hostIndex].hostname))
                                         {
-                                            // Reload the list
+                                            // Reload the list (detach the search worker first)
+                                            SetSearchHosts(NULL, 0);
                                             FreeHosts(hosts, hostCount);
                                             hosts = NULL;
                                             hostCount = 0;
                                             
                                             if (LoadHosts(&hosts, &hostCount))
                                             {
+                                                SetSearchHosts(hosts, hostCount);
+                                                SetMonitorHosts(hosts, hostCount);
+                                                
                                                 // Get search text if any
                                                 HWND hSearch = GetDlgItem(hwnd, IDC_EDIT_SEARCH);
                                                 wchar_t searchText[256] = {0};
                                                 GetWindowTextW(hSearch, searchText, 256);
                                                 
-                                                int displayedCount = RefreshHostListView(hList, hosts, hostCount, searchText);
-                                                UpdateHostCountLabel(hwnd, IDC_STATIC_HOST_COUNT, displayedCount, hostCount);
+                                                int displayedCount = RefreshHostListView(hList, hosts, hostCount, searchText, &searchContext, &listSort);
+                                                UpdateHostCountLabel(hwnd, IDC_STATIC_HOST_COUNT, displayedCount, hostCount, searchContext.queryError);
                                             }
+                                            RebuildGroupTree(hwnd, hosts, &groupTree);
                                         }
                                     }
                                 }
@@ -1315,154 +2333,23 @@ INT_PTR CALLBACK MainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                 else if (pnmhdr->code == NM_CUSTOMDRAW)
                 {
                     // Feature 3: Custom draw for search result highlighting
-                    LPNMLVCUSTOMDRAW lpcd = (LPNMLVCUSTOMDRAW)lParam;
+                    static LONGLONG paintStartTicks = 0;
+                    LPNMLVCUSTOMDRAW lvcd = (LPNMLVCUSTOMDRAW)lParam;
+                    LRESULT drawResult = DrawSearchHighlight(lvcd, &searchContext, hosts);
                     
-                    if (!searchContext.hasSearchText)
+                    // Time each paint pass of the list for the diagnostics dialog
+                    if (lvcd->nmcd.dwDrawStage == CDDS_PREPAINT)
                     {
-                        // No search text - use default drawing
-                        SetWindowLongPtr(hwnd, DWLP_MSGRESULT, CDRF_DODEFAULT);
-                        return TRUE;
+                        paintStartTicks = GetSearchTicks();
+                        drawResult |= CDRF_NOTIFYPOSTPAINT;
                     }
-                    
-                    switch (lpcd->nmcd.dwDrawStage)
+                    else if (lvcd->nmcd.dwDrawStage == CDDS_POSTPAINT && paintStartTicks != 0)
                     {
-                        case CDDS_PREPAINT:
-                            // Request item-level notifications
-                            SetWindowLongPtr(hwnd, DWLP_MSGRESULT, CDRF_NOTIFYITEMDRAW);
-                            return TRUE;
-                            
-                        case CDDS_ITEMPREPAINT:
-                            // Request subitem-level notifications
-                            SetWindowLongPtr(hwnd, DWLP_MSGRESULT, CDRF_NOTIFYSUBITEMDRAW);
-                            return TRUE;
-                            
-                        case CDDS_SUBITEM | CDDS_ITEMPREPAINT:
-                        {
-                            // Get the subitem being drawn
-                            int iSubItem = lpcd->iSubItem;
-                            int iItem = (int)lpcd->nmcd.dwItemSpec;
-                            
-                            // Only highlight columns 1 (hostname) and 2 (description)
-                            if (iSubItem == 1 || iSubItem == 2)
-                            {
-                                // Get the text for this subitem
-                                wchar_t text[512] = {0};
-                                ListView_GetItemText(lpcd->nmcd.hdr.hwndFrom, iItem, iSubItem, text, 512);
-                                
-                                // Convert both to lowercase for case-insensitive comparison
-                                wchar_t textLower[512] = {0};
-                                wchar_t searchLower[256] = {0};
-                                wcsncpy_s(textLower, 512, text, _TRUNCATE);
-                                wcsncpy_s(searchLower, 256, searchContext.searchText, _TRUNCATE);
-                                _wcslwr_s(textLower, 512);
-                                _wcslwr_s(searchLower, 256);
-                                
-                                // Find the matching substring position
-                                wchar_t* matchPos = wcsstr(textLower, searchLower);
-                                if (matchPos != NULL)
-                                {
-                                    // Calculate the match position in the original text
-                                    int matchIndex = (int)(matchPos - textLower);
-                                    int matchLen = (int)wcslen(searchContext.searchText);
-                                    
-                                    // Get the device context and rectangle
-                                    HDC hdc = lpcd->nmcd.hdc;
-                                    RECT rcItem = lpcd->nmcd.rc;
-                                    
-                                    // Adjust rectangle for text padding (ListView has 6px left margin)
-                                    rcItem.left += 6;
-                                    
-                                    // Set up colors (check if item is selected)
-                                    COLORREF bgColor, textColor, highlightBg, highlightText;
-                                    if (lpcd->nmcd.uItemState & CDIS_SELECTED)
-                                    {
-                                        // Selected item - use selection colors
-                                        bgColor = GetSysColor(COLOR_HIGHLIGHT);
-                                        textColor = GetSysColor(COLOR_HIGHLIGHTTEXT);
-                                        highlightBg = RGB(255, 255, 150);
-                                        highlightText = RGB(0, 0, 0);
-                                    }
-                                    else
-                                    {
-                                        // Normal item - use standard ListView colors
-                                        bgColor = ListView_GetBkColor(lpcd->nmcd.hdr.hwndFrom);
-                                        textColor = ListView_GetTextColor(lpcd->nmcd.hdr.hwndFrom);
-                                        highlightBg = RGB(255, 255, 150);
-                                        highlightText = RGB(0, 0, 0);
-                                    }
-                                    
-                                    // Fill background
-                                    HBRUSH hBrush = CreateSolidBrush(bgColor);
-                                    FillRect(hdc, &rcItem, hBrush);
-                                    DeleteObject(hBrush);
-                                    
-                                    // Set up text drawing
-                                    SetBkMode(hdc, TRANSPARENT);
-                                    HFONT hFont = (HFONT)SendMessageW(lpcd->nmcd.hdr.hwndFrom, WM_GETFONT, 0, 0);
-                                    HFONT hOldFont = (HFONT)SelectObject(hdc, hFont);
-                                    
-                                    // Calculate total text width for centering
-                                    SIZE totalSize;
-                                    GetTextExtentPoint32W(hdc, text, (int)wcslen(text), &totalSize);
-                                    
-                                    // Center the text horizontally in the column
-                                    int columnWidth = rcItem.right - rcItem.left;
-                                    int startX = rcItem.left + (columnWidth - totalSize.cx) / 2;
-                                    
-                                    int x = startX;
-                                    int y = rcItem.top + 2;  // 2px top padding
-                                    
-                                    // Draw text before the match
-                                    if (matchIndex > 0)
-                                    {
-                                        wchar_t beforeMatch[512] = {0};
-                                        wcsncpy_s(beforeMatch, 512, text, matchIndex);
-                                        SetTextColor(hdc, textColor);
-                                        SIZE size;
-                                        GetTextExtentPoint32W(hdc, beforeMatch, (int)wcslen(beforeMatch), &size);
-                                        TextOutW(hdc, x, y, beforeMatch, (int)wcslen(beforeMatch));
-                                        x += size.cx;
-                                    }
-                                    
-                                    // Draw the highlighted match
-                                    wchar_t matchText[512] = {0};
-                                    wcsncpy_s(matchText, 512, text + matchIndex, matchLen);
-                                    
-                                    // Draw highlight background
-                                    SIZE matchSize;
-                                    GetTextExtentPoint32W(hdc, matchText, (int)wcslen(matchText), &matchSize);
-                                    RECT highlightRect = {x, rcItem.top, x + matchSize.cx, rcItem.bottom};
-                                    HBRUSH hHighlight = CreateSolidBrush(highlightBg);
-                                    FillRect(hdc, &highlightRect, hHighlight);
-                                    DeleteObject(hHighlight);
-                                    
-                                    // Draw match text
-                                    SetTextColor(hdc, highlightText);
-                                    TextOutW(hdc, x, y, matchText, (int)wcslen(matchText));
-                                    x += matchSize.cx;
-                                    
-                                    // Draw text after the match
-                                    int afterIndex = matchIndex + matchLen;
-                                    if (afterIndex < (int)wcslen(text))
-                                    {
-                                        wchar_t afterMatch[512] = {0};
-                                        wcscpy_s(afterMatch, 512, text + afterIndex);
-                                        SetTextColor(hdc, textColor);
-                                        TextOutW(hdc, x, y, afterMatch, (int)wcslen(afterMatch));
-                                    }
-                                    
-                                    SelectObject(hdc, hOldFont);
-                                    
-                                    // Tell Windows we handled the drawing
-                                    SetWindowLongPtr(hwnd, DWLP_MSGRESULT, CDRF_SKIPDEFAULT);
-                                    return TRUE;
-                                }
-                            }
-                            SetWindowLongPtr(hwnd, DWLP_MSGRESULT, CDRF_DODEFAULT);
-                            return TRUE;
-                        }
+                        RecordPerfSample(PERF_LIST_PAINT, SearchTicksToMs(GetSearchTicks() - paintStartTicks));
+                        paintStartTicks = 0;
                     }
-                    SetWindowLongPtr(hwnd, DWLP_MSGRESULT, CDRF_DODEFAULT);
+                    
+                    SetWindowLongPtr(hwnd, DWLP_MSGRESULT, drawResult);
                     return TRUE;
                 }
             }
@@ -1485,26 +2372,28 @@ INT_PTR CALLBACK MainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
             {
                 case IDC_BTN_CONNECT:
                 {
-                    // Connect to selected server
-                    HWND hList = GetDlgItem(hwnd, IDC_LIST_SERVERS);
-                    int selected = ListView_GetNextItem(hList, -1, LVNI_SELECTED);
+                    // Connect to selected server (list row or tree host item)
+                    int hostIndex = GetSelectedMainHost(hwnd, &groupTree);
                     
-                    if (selected >= 0)
+                    if (hostIndex >= 0 && hostIndex < hostCount)
                     {
-                        // Get the original host index from lParam
-                        LVITEMW item = {0};
-                        item.mask = LVIF_PARAM;
-                        item.iItem = selected;
-                        ListView_GetItem(hList, &item);
-                        int hostIndex = (int)item.lParam;
-                        
-                        if (hostIndex >= 0 && hostIndex < hostCount)
+                        // Feature 2: Visual feedback on connection
+                        LaunchRDPWithVisualFeedback(hwnd, hosts[hostIndex].hostname);
+                    }
+                    else if (groupTree.mode != GROUP_BY_NONE && hostIndex < 0 &&
+                             TreeView_GetSelection(GetDlgItem(hwnd, IDC_TREE_SERVERS)) != NULL)
+                    {
+                        // Enter on a group node opens or closes it (TVM_EXPAND sends no notifications)
+                        HWND hTree = GetDlgItem(hwnd, IDC_TREE_SERVERS);
+                        HTREEITEM hGroup = TreeView_GetSelection(hTree);
+                        if (TreeView_GetItemState(hTree, hGroup, TVIS_EXPANDED) & TVIS_EXPANDED)
                         {
-                            // Feature 2: Visual feedback on connection
-                            if (LaunchRDPWithVisualFeedback(hwnd, hosts[hostIndex].hostname))
-                            {
-                                EndDialog(hwnd, IDOK);
-                            }
+                            TreeView_Expand(hTree, hGroup, TVE_COLLAPSE | TVE_COLLAPSERESET);
+                        }
+                        else
+                        {
+                            ExpandHostGroup(hTree, hosts, &groupTree, hGroup);
+                            TreeView_Expand(hTree, hGroup, TVE_EXPAND);
                         }
                     }
                     else
@@ -1519,19 +2408,24 @@ INT_PTR CALLBACK MainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                     // Handle search text changes
                     if (HIWORD(wParam) == EN_CHANGE)
                     {
-                        HWND hList = GetDlgItem(hwnd, IDC_LIST_SERVERS);
                         HWND hSearch = GetDlgItem(hwnd, IDC_EDIT_SEARCH);
                         
-                        // Get search text
-                        GetWindowTextW(hSearch, searchContext.searchText, 256);
-                        searchContext.hasSearchText = (wcslen(searchContext.searchText) > 0);
+                        // Get search text and note when the keystroke arrived
+                        GetWindowTextW(hSearch, pendingSearch, 256);
+                        pendingSearchTicks = GetSearchTicks();
                         
-                        // Refresh list with filter
-                        int displayedCount = RefreshHostListView(hList, hosts, hostCount, searchContext.searchText);
-                        UpdateHostCountLabel(hwnd, IDC_STATIC_HOST_COUNT, displayedCount, hostCount);
+                        // Abandon any search still running for the previous text
+                        CancelSearch();
                         
-                        // Feature 3: Redraw list to show highlighting
-                        InvalidateRect(hList, NULL, FALSE);
+                        // Filtering happens on the search worker once typing pauses
+                        if (searchDebounceMs == 0)
+                        {
+                            SubmitSearch(pendingSearch, pendingSearchTicks);
+                        }
+                        else
+                        {
+                            SetTimer(hwnd, TIMER_SEARCH_DEBOUNCE, searchDebounceMs, NULL);
+                        }
                     }
                     return TRUE;
                 }
@@ -1555,6 +2449,7 @@ INT_PTR CALLBACK MainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                     
                     if (hosts != NULL)
                     {
+                        SetSearchHosts(NULL, 0);
                         FreeHosts(hosts, hostCount);
                         hosts = NULL;
                         hostCount = 0;
@@ -1562,13 +2457,32 @@ INT_PTR CALLBACK MainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                     
                     if (LoadHosts(&hosts, &hostCount))
                     {
+                        SetSearchHosts(hosts, hostCount);
+                        SetMonitorHosts(hosts, hostCount);
+                        
                         // Get search text if any
                         HWND hSearch = GetDlgItem(hwnd, IDC_EDIT_SEARCH);
                         wchar_t searchText[256] = {0};
                         GetWindowTextW(hSearch, searchText, 256);
                         
-                        int displayedCount = RefreshHostListView(hList, hosts, hostCount, searchText);
-                        UpdateHostCountLabel(hwnd, IDC_STATIC_HOST_COUNT, displayedCount, hostCount);
+                        int displayedCount = RefreshHostListView(hList, hosts, hostCount, searchText, &searchContext, &listSort);
+                        UpdateHostCountLabel(hwnd, IDC_STATIC_HOST_COUNT, displayedCount, hostCount, searchContext.queryError);
+                    }
+                    RebuildGroupTree(hwnd, hosts, &groupTree);
+                    return TRUE;
+                }
+
+                case IDC_COMBO_GROUP_BY:
+                {
+                    // Switch between the flat list and a grouped tree
+                    if (HIWORD(wParam) == CBN_SELCHANGE)
+                    {
+                        int selection = (int)SendMessageW((HWND)lParam, CB_GETCURSEL, 0, 0);
+                        if (selection >= GROUP_BY_NONE && selection < GROUP_BY_COUNT)
+                        {
+                            groupTree.mode = (GroupMode)selection;
+                            RebuildGroupTree(hwnd, hosts, &groupTree);
+                        }
                     }
                     return TRUE;
                 }
@@ -1599,8 +2513,12 @@ INT_PTR CALLBACK MainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                 }
 
                 case IDCANCEL:
+                    KillTimer(hwnd, TIMER_SEARCH_DEBOUNCE);
+                    StopSearchWorker();
+                    StopHostMonitor();
                     if (hosts != NULL)
                     {
+                        SaveLatencyHistory(hosts, hostCount);
                         FreeHosts(hosts, hostCount);
                         hosts = NULL;
                     }
@@ -1611,8 +2529,12 @@ INT_PTR CALLBACK MainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
             break;
 
         case WM_CLOSE:
+            KillTimer(hwnd, TIMER_SEARCH_DEBOUNCE);
+            StopSearchWorker();
+            StopHostMonitor();
             if (hosts != NULL)
             {
+                SaveLatencyHistory(hosts, hostCount);
                 FreeHosts(hosts, hostCount);
                 hosts = NULL;
             }
@@ -1621,6 +2543,17 @@ INT_PTR CALLBACK MainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
             return TRUE;
             
         case WM_DESTROY:
+            // Connecting ends the dialog with IDOK - make sure the worker is gone too
+            KillTimer(hwnd, TIMER_SEARCH_DEBOUNCE);
+            StopSearchWorker();
+            StopHostMonitor();
+            FreeProbeJob(probeJob);
+            if (hosts != NULL)
+                SaveLatencyHistory(hosts, hostCount);
+            probeJob = NULL;
+            ClearSearchContext(&searchContext);
+            FreeListSort(&listSort);
+            FreeGroupTree(&groupTree);
             g_hwndMainDialog = NULL;
             return TRUE;
     }
@@ -1645,8 +2578,8 @@ INT_PTR CALLBACK HostDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
 {
     static Host* hosts = NULL;
     static int hostCount = 0;
-    static SortParams sortParams = {1, TRUE, NULL, 0};  // Default: sort by hostname, ascending
-    static SearchContext searchContext = {{0}, FALSE};  // Feature 3: Track search text for highlighting
+    static ListSortState listSort = {{SORT_COLUMN_HOSTNAME, TRUE, SORT_COLUMN_NONE, TRUE}, FALSE, NULL};  // Default: sort by hostname, ascending
+    static SearchContext searchContext = {{0}, FALSE, NULL, 0, NULL, {0}};  // Feature 3: Track search text for highlighting
     
     switch (msg)
     {
@@ -1691,7 +2624,7 @@ INT_PTR CALLBACK HostDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
             // Add invisible dummy column at position 0
             col.mask = LVCF_TEXT | LVCF_WIDTH;
             col.pszText = L"";
-            col.cx = 1;  // Almost invisible
+            col.cx = COLUMN_WIDTH_DUMMY;  // Almost invisible
             ListView_InsertColumn(hList, 0, &col);
             
             // Now add the real columns which CAN be centered
@@ -1699,22 +2632,22 @@ INT_PTR CALLBACK HostDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
             col.fmt = LVCFMT_CENTER;
             
             col.pszText = L"Hostname";
-            col.cx = 170;
+            col.cx = COLUMN_WIDTH_HOSTNAME;
             ListView_InsertColumn(hList, 1, &col);
             
             col.pszText = L"Description";
-            col.cx = listWidth - 170 - 160 - 5;  // Takes most of the remaining space
+            col.cx = GetDescriptionColumnWidth(listWidth, FALSE);  // Takes most of the remaining space
             ListView_InsertColumn(hList, 2, &col);
             
             col.pszText = L"Last Connected";
-            col.cx = 160;  // Fixed width for timestamp
+            col.cx = COLUMN_WIDTH_LAST_CONNECTED;  // Fixed width for timestamp
             ListView_InsertColumn(hList, 3, &col);
             
             // Load and display hosts
             if (LoadHosts(&hosts, &hostCount))
             {
-                int displayedCount = RefreshHostListView(hList, hosts, hostCount, NULL);
-                UpdateHostCountLabel(hwnd, IDC_STATIC_HOSTS_COUNT, displayedCount, hostCount);
+                int displayedCount = RefreshHostListView(hList, hosts, hostCount, NULL, &searchContext, &listSort);
+                UpdateHostCountLabel(hwnd, IDC_STATIC_HOSTS_COUNT, displayedCount, hostCount, searchContext.queryError);
             }
             
             return TRUE;
@@ -1772,8 +2705,8 @@ INT_PTR CALLBACK HostDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                             
                             if (LoadHosts(&hosts, &hostCount))
                             {
-                                int displayedCount = RefreshHostListView(hList, hosts, hostCount, NULL);
-                                UpdateHostCountLabel(hwnd, IDC_STATIC_HOSTS_COUNT, displayedCount, hostCount);
+                                int displayedCount = RefreshHostListView(hList, hosts, hostCount, NULL, &searchContext, &listSort);
+                                UpdateHostCountLabel(hwnd, IDC_STATIC_HOSTS_COUNT, displayedCount, hostCount, searchContext.queryError);
                             }
                         }
                         else
@@ -1810,24 +2743,11 @@ INT_PTR CALLBACK HostDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                     // Only sort if clicking on actual columns (not dummy column 0)
                     if (clickedColumn == 1 || clickedColumn == 2 || clickedColumn == 3)
                     {
-                        // If clicking the same column, toggle sort direction
-                        if (sortParams.sortColumn == clickedColumn)
-                        {
-                            sortParams.sortAscending = !sortParams.sortAscending;
-                        }
-                        else
-                        {
-                            // New column - default to ascending
-                            sortParams.sortColumn = clickedColumn;
-                            sortParams.sortAscending = TRUE;
-                        }
-                        
-                        // Update sort params with current host data
-                        sortParams.hosts = hosts;
-                        sortParams.hostCount = hostCount;
+                        // Same column toggles direction; a new column keeps the old one as tie-breaker
+                        SetSortColumn(&listSort.spec, clickedColumn);
                         
                         // Perform the sort
-                        ListView_SortItems(hList, CompareListViewItems, (LPARAM)&sortParams);
+                        SortHostListView(hList, hosts, hostCount, &listSort);
                     }
                     return TRUE;
                 }
@@ -1879,8 +2799,8 @@ INT_PTR CALLBACK HostDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                                             wchar_t searchText[256] = {0};
                                             GetWindowTextW(hSearch, searchText, 256);
                                             
-                                            int displayedCount = RefreshHostListView(hList, hosts, hostCount, searchText);
-                                            UpdateHostCountLabel(hwnd, IDC_STATIC_HOSTS_COUNT, displayedCount, hostCount);
+                                            int displayedCount = RefreshHostListView(hList, hosts, hostCount, searchText, &searchContext, &listSort);
+                                            UpdateHostCountLabel(hwnd, IDC_STATIC_HOSTS_COUNT, displayedCount, hostCount, searchContext.queryError);
                                         }
                                     }
                                     else
@@ -1959,8 +2879,8 @@ INT_PTR CALLBACK HostDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                                                 wchar_t searchText[256] = {0};
                                                 GetWindowTextW(hSearch, searchText, 256);
                                                 
-                                                int displayedCount = RefreshHostListView(hList, hosts, hostCount, searchText);
-                                                UpdateHostCountLabel(hwnd, IDC_STATIC_HOSTS_COUNT, displayedCount, hostCount);
+                                                int displayedCount = RefreshHostListView(hList, hosts, hostCount, searchText, &searchContext, &listSort);
+                                                UpdateHostCountLabel(hwnd, IDC_STATIC_HOSTS_COUNT, displayedCount, hostCount, searchContext.queryError);
                                             }
                                         }
                                     }
@@ -1973,154 +2893,8 @@ INT_PTR CALLBACK HostDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                 else if (pnmhdr->code == NM_CUSTOMDRAW)
                 {
                     // Feature 3: Custom draw for search result highlighting
-                    LPNMLVCUSTOMDRAW lpcd = (LPNMLVCUSTOMDRAW)lParam;
-                    
-                    if (!searchContext.hasSearchText)
-                    {
-                        // No search text - use default drawing
-                        SetWindowLongPtr(hwnd, DWLP_MSGRESULT, CDRF_DODEFAULT);
-                        return TRUE;
-                    }
-                    
-                    switch (lpcd->nmcd.dwDrawStage)
-                    {
-                        case CDDS_PREPAINT:
-                            // Request item-level notifications
-                            SetWindowLongPtr(hwnd, DWLP_MSGRESULT, CDRF_NOTIFYITEMDRAW);
-                            return TRUE;
-                            
-                        case CDDS_ITEMPREPAINT:
-                            // Request subitem-level notifications
-                            SetWindowLongPtr(hwnd, DWLP_MSGRESULT, CDRF_NOTIFYSUBITEMDRAW);
-                            return TRUE;
-                            
-                        case CDDS_SUBITEM | CDDS_ITEMPREPAINT:
-                        {
-                            // Get the subitem being drawn
-                            int iSubItem = lpcd->iSubItem;
-                            int iItem = (int)lpcd->nmcd.dwItemSpec;
-                            
-                            // Only highlight columns 1 (hostname) and 2 (description)
-                            if (iSubItem == 1 || iSubItem == 2)
-                            {
-                                // Get the text for this subitem
-                                wchar_t text[512] = {0};
-                                ListView_GetItemText(lpcd->nmcd.hdr.hwndFrom, iItem, iSubItem, text, 512);
-                                
-                                // Convert both to lowercase for case-insensitive comparison
-                                wchar_t textLower[512] = {0};
-                                wchar_t searchLower[256] = {0};
-                                wcsncpy_s(textLower, 512, text, _TRUNCATE);
-                                wcsncpy_s(searchLower, 256, searchContext.searchText, _TRUNCATE);
-                                _wcslwr_s(textLower, 512);
-                                _wcslwr_s(searchLower, 256);
-                                
-                                // Find the matching substring position
-                                wchar_t* matchPos = wcsstr(textLower, searchLower);
-                                if (matchPos != NULL)
-                                {
-                                    // Calculate the match position in the original text
-                                    int matchIndex = (int)(matchPos - textLower);
-                                    int matchLen = (int)wcslen(searchContext.searchText);
-                                    
-                                    // Get the device context and rectangle
-                                    HDC hdc = lpcd->nmcd.hdc;
-                                    RECT rcItem = lpcd->nmcd.rc;
-                                    
-                                    // Adjust rectangle for text padding (ListView has 6px left margin)
-                                    rcItem.left += 6;
-                                    
-                                    // Set up colors (check if item is selected)
-                                    COLORREF bgColor, textColor, highlightBg, highlightText;
-                                    if (lpcd->nmcd.uItemState & CDIS_SELECTED)
-                                    {
-                                        // Selected item - use selection colors
-                                        bgColor = GetSysColor(COLOR_HIGHLIGHT);
-                                        textColor = GetSysColor(COLOR_HIGHLIGHTTEXT);
-                                        highlightBg = RGB(255, 255, 150);
-                                        highlightText = RGB(0, 0, 0);
-                                    }
-                                    else
-                                    {
-                                        // Normal item - use standard ListView colors
-                                        bgColor = ListView_GetBkColor(lpcd->nmcd.hdr.hwndFrom);
-                                        textColor = ListView_GetTextColor(lpcd->nmcd.hdr.hwndFrom);
-                                        highlightBg = RGB(255, 255, 150);
-                                        highlightText = RGB(0, 0, 0);
-                                    }
-                                    
-                                    // Fill background
-                                    HBRUSH hBrush = CreateSolidBrush(bgColor);
-                                    FillRect(hdc, &rcItem, hBrush);
-                                    DeleteObject(hBrush);
-                                    
-                                    // Set up text drawing
-                                    SetBkMode(hdc, TRANSPARENT);
-                                    HFONT hFont = (HFONT)SendMessageW(lpcd->nmcd.hdr.hwndFrom, WM_GETFONT, 0, 0);
-                                    HFONT hOldFont = (HFONT)SelectObject(hdc, hFont);
-                                    
-                                    // Calculate total text width for centering
-                                    SIZE totalSize;
-                                    GetTextExtentPoint32W(hdc, text, (int)wcslen(text), &totalSize);
-                                    
-                                    // Center the text horizontally in the column
-                                    int columnWidth = rcItem.right - rcItem.left;
-                                    int startX = rcItem.left + (columnWidth - totalSize.cx) / 2;
-                                    
-                                    int x = startX;
-                                    int y = rcItem.top + 2;  // 2px top padding
-                                    
-                                    // Draw text before the match
-                                    if (matchIndex > 0)
-                                    {
-                                        wchar_t beforeMatch[512] = {0};
-                                        wcsncpy_s(beforeMatch, 512, text, matchIndex);
-                                        SetTextColor(hdc, textColor);
-                                        SIZE size;
-                                        GetTextExtentPoint32W(hdc, beforeMatch, (int)wcslen(beforeMatch), &size);
-                                        TextOutW(hdc, x, y, beforeMatch, (int)wcslen(beforeMatch));
-                                        x += size.cx;
-                                    }
-                                    
-                                    // Draw the highlighted match
-                                    wchar_t matchText[512] = {0};
-                                    wcsncpy_s(matchText, 512, text + matchIndex, matchLen);
-                                    
-                                    // Draw highlight background
-                                    SIZE matchSize;
-                                    GetTextExtentPoint32W(hdc, matchText, (int)wcslen(matchText), &matchSize);
-                                    RECT highlightRect = {x, rcItem.top, x + matchSize.cx, rcItem.bottom};
-                                    HBRUSH hHighlight = CreateSolidBrush(highlightBg);
-                                    FillRect(hdc, &highlightRect, hHighlight);
-                                    DeleteObject(hHighlight);
-                                    
-                                    // Draw match text
-                                    SetTextColor(hdc, highlightText);
-                                    TextOutW(hdc, x, y, matchText, (int)wcslen(matchText));
-                                    x += matchSize.cx;
-                                    
-                                    // Draw text after the match
-                                    int afterIndex = matchIndex + matchLen;
-                                    if (afterIndex < (int)wcslen(text))
-                                    {
-                                        wchar_t afterMatch[512] = {0};
-                                        wcscpy_s(afterMatch, 512, text + afterIndex);
-                                        SetTextColor(hdc, textColor);
-                                        TextOutW(hdc, x, y, afterMatch, (int)wcslen(afterMatch));
-                                    }
-                                    
-                                    SelectObject(hdc, hOldFont);
-                                    
-                                    // Tell Windows we handled the drawing
-                                    SetWindowLongPtr(hwnd, DWLP_MSGRESULT, CDRF_SKIPDEFAULT);
-                                    return TRUE;
-                                }
-                            }
-                            SetWindowLongPtr(hwnd, DWLP_MSGRESULT, CDRF_DODEFAULT);
-                            return TRUE;
-                        }
-                    }
-                    SetWindowLongPtr(hwnd, DWLP_MSGRESULT, CDRF_DODEFAULT);
+                    SetWindowLongPtr(hwnd, DWLP_MSGRESULT,
+                                     DrawSearchHighlight((LPNMLVCUSTOMDRAW)lParam, &searchContext, hosts));
                     return TRUE;
                 }
             }
@@ -2150,12 +2924,12 @@ INT_PTR CALLBACK HostDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                         HWND hSearch = GetDlgItem(hwnd, IDC_EDIT_SEARCH_HOSTS);
                         
                         // Get search text
-                        GetWindowTextW(hSearch, searchContext.searchText, 256);
-                        searchContext.hasSearchText = (wcslen(searchContext.searchText) > 0);
+                        wchar_t searchText[256] = {0};
+                        GetWindowTextW(hSearch, searchText, 256);
                         
-                        // Refresh list with filter
-                        int displayedCount = RefreshHostListView(hList, hosts, hostCount, searchContext.searchText);
-                        UpdateHostCountLabel(hwnd, IDC_STATIC_HOSTS_COUNT, displayedCount, hostCount);
+                        // Refresh list with filter (also records match spans for highlighting)
+                        int displayedCount = RefreshHostListView(hList, hosts, hostCount, searchText, &searchContext, &listSort);
+                        UpdateHostCountLabel(hwnd, IDC_STATIC_HOSTS_COUNT, displayedCount, hostCount, searchContext.queryError);
                         
                         // Feature 3: Redraw list to show highlighting
                         InvalidateRect(hList, NULL, FALSE);
@@ -2193,8 +2967,8 @@ INT_PTR CALLBACK HostDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                             wchar_t searchText[256] = {0};
                             GetWindowTextW(hSearch, searchText, 256);
                             
-                            int displayedCount = RefreshHostListView(hList, hosts, hostCount, searchText);
-                            UpdateHostCountLabel(hwnd, IDC_STATIC_HOSTS_COUNT, displayedCount, hostCount);
+                            int displayedCount = RefreshHostListView(hList, hosts, hostCount, searchText, &searchContext, &listSort);
+                            UpdateHostCountLabel(hwnd, IDC_STATIC_HOSTS_COUNT, displayedCount, hostCount, searchContext.queryError);
                         }
                     }
                     return TRUE;
@@ -2204,7 +2978,7 @@ INT_PTR CALLBACK HostDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                 {
                     // Edit selected host
                     HWND hList = GetDlgItem(hwnd, IDC_LIST_HOSTS);
-                    int selected = ListView_GetNextItem(hList, -1, LVNI_SELECTED);
+                    int selected = GetSelectedHostIndex(hList);
                     
                     if (selected >= 0 && selected < hostCount)
                     {
@@ -2238,8 +3012,8 @@ INT_PTR CALLBACK HostDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                                 wchar_t searchText[256] = {0};
                                 GetWindowTextW(hSearch, searchText, 256);
                                 
-                                int displayedCount = RefreshHostListView(hList, hosts, hostCount, searchText);
-                                UpdateHostCountLabel(hwnd, IDC_STATIC_HOSTS_COUNT, displayedCount, hostCount);
+                                int displayedCount = RefreshHostListView(hList, hosts, hostCount, searchText, &searchContext, &listSort);
+                                UpdateHostCountLabel(hwnd, IDC_STATIC_HOSTS_COUNT, displayedCount, hostCount, searchContext.queryError);
                             }
                         }
                     }
@@ -2254,7 +3028,7 @@ INT_PTR CALLBACK HostDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                 {
                     // Delete selected host
                     HWND hList = GetDlgItem(hwnd, IDC_LIST_HOSTS);
-                    int selected = ListView_GetNextItem(hList, -1, LVNI_SELECTED);
+                    int selected = GetSelectedHostIndex(hList);
                     
                     if (selected >= 0 && selected < hostCount)
                     {
@@ -2278,8 +3052,8 @@ INT_PTR CALLBACK HostDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                                     wchar_t searchText[256] = {0};
                                     GetWindowTextW(hSearch, searchText, 256);
                                     
-                                    int displayedCount = RefreshHostListView(hList, hosts, hostCount, searchText);
-                                    UpdateHostCountLabel(hwnd, IDC_STATIC_HOSTS_COUNT, displayedCount, hostCount);
+                                    int displayedCount = RefreshHostListView(hList, hosts, hostCount, searchText, &searchContext, &listSort);
+                                    UpdateHostCountLabel(hwnd, IDC_STATIC_HOSTS_COUNT, displayedCount, hostCount, searchContext.queryError);
                                 }
                             }
                         }
@@ -2300,64 +3074,40 @@ INT_PTR CALLBACK HostDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
                     
                     if (result == IDOK)
                     {
-                        // Scan Active Directory/network for computers
-                        ComputerInfo* computers = NULL;
-                        int computerCount = 0;
+                        // Several domains are scanned at once, each with a time limit
+                        params.workerCount = (int)GetSettingDWORD(REG_SCAN_WORKERS, SCAN_WORKERS);
+                        params.sourceTimeoutMs = GetSettingDWORD(REG_SCAN_SOURCE_TIMEOUT, SCAN_SOURCE_TIMEOUT_MS);
+                        params.useCache = (GetSettingDWORD(REG_SCAN_CACHE, SCAN_CACHE) != 0);
                         
-                        // Show scanning message
-                        SetCursor(LoadCursor(NULL, IDC_WAIT));
+                        // A sweep's length follows from the range size, so it is not cut short
+                        if (params.mode == SCAN_MODE_SWEEP)
+                            params.sourceTimeoutMs = 0;
                         
-                        // Prepare domain parameter
-                        const wchar_t* domain = wcslen(params.domain) > 0 ? params.domain : NULL;
+                        // The results dialog runs the scan and shows computers as they are found
+                        INT_PTR added = DialogBoxParam(g_hInstance, MAKEINTRESOURCE(IDD_SCAN_RESULTS),
+                                                       hwnd, ScanResultsDialogProc, (LPARAM)&params);
                         
-                        if (ScanForComputers(domain, 
-                                           params.includeWorkstations, params.includeServers, params.includeDomainControllers,
-                                           &computers, &computerCount))
+                        if (added == IDOK)
                         {
-                            SetCursor(LoadCursor(NULL, IDC_ARROW));
+                            // Reload the list to show the new hosts
+                            HWND hList = GetDlgItem(hwnd, IDC_LIST_HOSTS);
                             
-                            if (computerCount == 0)
+                            if (hosts != NULL)
                             {
-                                ShowInfoMessage(hwnd, 
-                                    L"No computers found on the network.\n\n"
-                                    L"This could mean:\n"
-                                    L"• You're not connected to a network\n"
-                                    L"• Network discovery is disabled\n"
-                                    L"• Firewall is blocking discovery\n"
-                                    L"• The specified domain/workgroup doesn't exist\n\n"
-                                    L"You can still manually add hosts using 'Add Host'.");
+                                FreeHosts(hosts, hostCount);
+                                hosts = NULL;
+                                hostCount = 0;
                             }
-                            else
+                            
+                            if (LoadHosts(&hosts, &hostCount))
                             {
-                                // Auto-add all discovered computers
-                                int addedCount = 0;
-                                for (int i = 0; i < computerCount; i++)
-                                {
-                                    if (AddHost(computers[i].name, computers[i].comment))
-                                    {
-                                        addedCount++;
-                                    }
-                                }
-                                
-                                // Free the computer list
-                                FreeComputerList(computers);
+                                wchar_t searchText[256] = {0};
+                                GetDlgItemTextW(hwnd, IDC_EDIT_SEARCH_HOSTS, searchText, 256);
                                 
-                                // Show success message
-                                wchar_t msg[512];
-                                swprintf_s(msg, 512, 
-                                    L"Network scan complete!\n\n"
-                                    L"Found: %d computer(s)\n"
-                                    L"Added: %d computer(s) to your hosts list\n\n"
-                                    L"Computers have been automatically added with their AD descriptions.",
-                                    computerCount, addedCount);
-                                ShowInfoMessage(hwnd, msg);
+                                int displayedCount = RefreshHostListView(hList, hosts, hostCount, searchText, &searchContext, &listSort);
+                                UpdateHostCountLabel(hwnd, IDC_STATIC_HOSTS_COUNT, displayedCount, hostCount, searchContext.queryError);
                             }
                         }
-                        else
-                        {
-                            SetCursor(LoadCursor(NULL, IDC_ARROW));
-                            ShowErrorMessage(hwnd, L"Failed to scan for computers.\n\nPlease check network connectivity and permissions.");
-                        }
                     }
                     
                     return TRUE;
@@ -2390,6 +3140,8 @@ INT_PTR CALLBACK HostDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
         case WM_DESTROY:
             // Unregister hotkey when destroying
             UnregisterHotKey(hwnd, IDM_DELETE_ALL);
+            ClearSearchContext(&searchContext);
+            FreeListSort(&listSort);
             g_hwndHostDialog = NULL;
             return TRUE;
     }
@@ -2634,7 +3386,9 @@ INT_PTR CALLBACK AddHostDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lP
 /*
  * ScanDomainDialogProc - Get domain and computer type filters for scanning
  * 
- * Prompts user for domain name and computer types to scan for.
+ * Prompts user for one or more domain names or IP ranges (separated by ';'),
+ * how to find the computers (browse, directory or subnet sweep) and the
+ * computer types to scan for.
  * The ScanParams structure is passed via lParam and filled on IDOK.
  */
 INT_PTR CALLBACK ScanDomainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
@@ -2661,6 +3415,9 @@ INT_PTR CALLBACK ScanDomainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM
             CheckDlgButton(hwnd, IDC_CHECK_SERVERS, BST_CHECKED);
             CheckDlgButton(hwnd, IDC_CHECK_DOMAIN_CTRL, BST_CHECKED);
             
+            // Browse the network unless told otherwise
+            CheckRadioButton(hwnd, IDC_RADIO_SCAN_BROWSE, IDC_RADIO_SCAN_SWEEP, IDC_RADIO_SCAN_BROWSE);
+            
             // Focus on domain field
             SetFocus(GetDlgItem(hwnd, IDC_EDIT_DOMAIN));
             
@@ -2671,24 +3428,79 @@ INT_PTR CALLBACK ScanDomainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM
         {
             switch (LOWORD(wParam))
             {
+                case IDC_RADIO_SCAN_BROWSE:
+                case IDC_RADIO_SCAN_LDAP:
+                case IDC_RADIO_SCAN_SWEEP:
+                {
+                    // An open port says nothing about the computer type
+                    BOOL byType = (IsDlgButtonChecked(hwnd, IDC_RADIO_SCAN_SWEEP) != BST_CHECKED);
+                    EnableWindow(GetDlgItem(hwnd, IDC_CHECK_WORKSTATIONS), byType);
+                    EnableWindow(GetDlgItem(hwnd, IDC_CHECK_SERVERS), byType);
+                    EnableWindow(GetDlgItem(hwnd, IDC_CHECK_DOMAIN_CTRL), byType);
+                    return TRUE;
+                }
+                
                 case IDOK:
                 {
                     if (s_params != NULL)
                     {
+                        // Browse list, directory or subnet sweep
+                        if (IsDlgButtonChecked(hwnd, IDC_RADIO_SCAN_SWEEP) == BST_CHECKED)
+                            s_params->mode = SCAN_MODE_SWEEP;
+                        else if (IsDlgButtonChecked(hwnd, IDC_RADIO_SCAN_LDAP) == BST_CHECKED)
+                            s_params->mode = SCAN_MODE_DIRECTORY;
+                        else
+                            s_params->mode = SCAN_MODE_BROWSE;
+                        
                         // Get computer type filters
                         s_params->includeWorkstations = (IsDlgButtonChecked(hwnd, IDC_CHECK_WORKSTATIONS) == BST_CHECKED);
                         s_params->includeServers = (IsDlgButtonChecked(hwnd, IDC_CHECK_SERVERS) == BST_CHECKED);
                         s_params->includeDomainControllers = (IsDlgButtonChecked(hwnd, IDC_CHECK_DOMAIN_CTRL) == BST_CHECKED);
                         
                         // Validate that at least one type is selected
-                        if (!s_params->includeWorkstations && !s_params->includeServers && !s_params->includeDomainControllers)
+                        if (s_params->mode != SCAN_MODE_SWEEP &&
+                            !s_params->includeWorkstations && !s_params->includeServers && !s_params->includeDomainControllers)
                         {
                             ShowErrorMessage(hwnd, L"Please select at least one computer type to scan for.");
                             return TRUE;
                         }
                         
-                        // Get domain name
-                        GetDlgItemTextW(hwnd, IDC_EDIT_DOMAIN, s_params->domain, 256);
+                        // Get domain name(s) or IP ranges
+                        GetDlgItemTextW(hwnd, IDC_EDIT_DOMAIN, s_params->domains, ARRAYSIZE(s_params->domains));
+                        
+                        // A sweep needs ranges, and each must parse
+                        if (s_params->mode == SCAN_MODE_SWEEP)
+                        {
+                            wchar_t ranges[ARRAYSIZE(s_params->domains)];
+                            wchar_t* next = NULL;
+                            int rangeCount = 0;
+                            
+                            wcscpy_s(ranges, ARRAYSIZE(ranges), s_params->domains);
+                            for (wchar_t* token = wcstok_s(ranges, L";, \t", &next);
+                                 token != NULL;
+                                 token = wcstok_s(NULL, L";, \t", &next))
+                            {
+                                SweepRange range;
+                                if (!ParseSweepRange(token, RDP_DEFAULT_PORT, &range))
+                                {
+                                    wchar_t message[256];
+                                    swprintf_s(message, 256,
+                                               L"\"%s\" is not an IP range.\n\n"
+                                               L"Use an address or a CIDR block of up to %u addresses, "
+                                               L"e.g. 10.0.0.0/24 or 10.0.0.5:3390.",
+                                               token, SWEEP_MAX_ADDRESSES);
+                                    ShowErrorMessage(hwnd, message);
+                                    return TRUE;
+                                }
+                                rangeCount++;
+                            }
+                            
+                            if (rangeCount == 0)
+                            {
+                                ShowErrorMessage(hwnd, L"Please enter the IP ranges to sweep (e.g. 10.0.0.0/24).");
+                                return TRUE;
+                            }
+                        }
                     }
                     
                     EndDialog(hwnd, IDOK);
@@ -2716,39 +3528,592 @@ INT_PTR CALLBACK ScanDomainDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM
 }
 
 /*
- * ScanResultsDialogProc - Display network scan results
+ * Scan results dialog helpers
  * 
- * Shows discovered computers and allows user to select which to add.
- * The computer list is passed via lParam in DialogBoxParam.
+ * The results list is owner-data: the ListView only knows how many rows
+ * there are and asks (LVN_GETDISPINFO) for the text of the rows it is
+ * about to paint. Check marks live in a bitset, one bit per computer, and
+ * the filter produces an array of visible computer indices - so opening,
+ * filtering and checking are independent of how many computers were found.
+ * 
+ * The scan itself runs on a ScanJob worker (see scanjob.h). Each
+ * WM_SCAN_PROGRESS appends the new computers to the end of the arrays and
+ * grows the row count, so rows appear while the scan is still going.
+ * 
+ * The first WM_SCAN_PROGRESS usually carries the cached results of the
+ * last scan. Computers the refresh then reports again are looked up by
+ * name in a hash table and replace their row instead of adding one, and
+ * cached computers that turn out to be gone are removed at the end.
  */
-INT_PTR CALLBACK ScanResultsDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+#define IsScanChecked(state, i)     (((state)->checked[(i) >> 3] >> ((i) & 7)) & 1)
+
+void SetScanChecked(ScanResultsState* state, int computer, BOOL checked)
 {
-    static ComputerInfo* s_computers = NULL;
-    static int s_computerCount = 0;
+    BYTE mask = (BYTE)(1 << (computer & 7));
+    BOOL wasChecked = IsScanChecked(state, computer);
     
-    switch (msg)
+    if (checked && !wasChecked)
     {
-        case WM_INITDIALOG:
+        state->checked[computer >> 3] |= mask;
+        state->checkedCount++;
+    }
+    else if (!checked && wasChecked)
+    {
+        state->checked[computer >> 3] &= (BYTE)~mask;
+        state->checkedCount--;
+    }
+}
+
+/*
+ * FindScanComputer - Index of the computer with this name hash, or -1
+ */
+int FindScanComputer(const ScanResultsState* state, ULONGLONG nameHash)
+{
+    if (state->index == NULL)
+        return -1;
+    
+    int slot = (int)(nameHash & (state->indexCapacity - 1));
+    while (state->index[slot] >= 0)
+    {
+        if (HashHostKey(state->computers[state->index[slot]].name) == nameHash)
+            return state->index[slot];
+        slot = (slot + 1) & (state->indexCapacity - 1);
+    }
+    return -1;
+}
+
+/*
+ * AddScanIndex - Enter a computer into the name index (the table must have room)
+ */
+void AddScanIndex(ScanResultsState* state, int computer)
+{
+    int slot = (int)(HashHostKey(state->computers[computer].name) & (state->indexCapacity - 1));
+    while (state->index[slot] >= 0)
+        slot = (slot + 1) & (state->indexCapacity - 1);
+    state->index[slot] = computer;
+}
+
+/*
+ * RebuildScanIndex - Size the name index for the capacity and enter every computer
+ * 
+ * Returns FALSE if out of memory (the old index is kept).
+ */
+BOOL RebuildScanIndex(ScanResultsState* state)
+{
+    int newCapacity = 1024;
+    while (newCapacity < state->capacity * 2)
+        newCapacity *= 2;
+    
+    if (newCapacity != state->indexCapacity)
+    {
+        int* newIndex = (int*)malloc(sizeof(int) * newCapacity);
+        if (newIndex == NULL)
+            return FALSE;
+        free(state->index);
+        state->index = newIndex;
+        state->indexCapacity = newCapacity;
+    }
+    
+    memset(state->index, 0xFF, sizeof(int) * state->indexCapacity);
+    for (int i = 0; i < state->count; i++)
+        AddScanIndex(state, i);
+    return TRUE;
+}
+
+/*
+ * UpdateScanResultsStatus - Show found/shown/checked counts (or a filter error)
+ */
+void UpdateScanResultsStatus(HWND hwnd, const ScanResultsState* state, const wchar_t* filterError)
+{
+    const ScanProgress* progress = &state->progress;
+    wchar_t counts[128];
+    wchar_t status[384];
+    wchar_t cachedAt[32] = L"";
+    
+    // Local time of the oldest cached source
+    if (progress->cached > 0)
+    {
+        FILETIME local;
+        SYSTEMTIME st;
+        if (FileTimeToLocalFileTime(&progress->cachedAt, &local) && FileTimeToSystemTime(&local, &st))
+            swprintf_s(cachedAt, ARRAYSIZE(cachedAt), L"%04d-%02d-%02d %02d:%02d",
+                       st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute);
+    }
+    
+    if (state->visibleCount == state->count)
+        swprintf_s(counts, 128, L"%d computer(s), %d checked", state->count, state->checkedCount);
+    else
+        swprintf_s(counts, 128, L"%d computer(s), showing %d, %d checked",
+                   state->count, state->visibleCount, state->checkedCount);
+    
+    if (filterError != NULL && filterError[0] != L'\0')
+        swprintf_s(status, 384, L"Filter error: %s", filterError);
+    else if (state->job != NULL && state->sweep && progress->toExamine > 0)
+    {
+        // Progress in addresses, with the share that answered and time left
+        double hitRate = (progress->examined > 0) ? 100.0 * state->count / progress->examined : 0.0;
+        double secondsLeft = (progress->examinedPerSecond > 0.0)
+            ? (progress->toExamine - progress->examined) / progress->examinedPerSecond : 0.0;
+        
+        swprintf_s(status, 384, L"%s %lu of %lu addresses (%.0f per second), found %s (%.1f%%), about %.0f s left",
+                   state->stopRequested ? L"Stopping sweep..." : L"Sweeping...",
+                   progress->examined, progress->toExamine, progress->examinedPerSecond,
+                   counts, hitRate, secondsLeft);
+    }
+    else if (state->job != NULL && progress->cached > 0)
+        swprintf_s(status, 384, L"%s results cached %s: %d unchanged and %d changed so far; %s",
+                   state->stopRequested ? L"Stopping refresh of" : L"Refreshing",
+                   cachedAt, progress->unchanged, progress->changed, counts);
+    else if (state->job != NULL && progress->sourceCount > 1)
+        swprintf_s(status, 384, L"%s %d of %d domains done, found %s (%.0f per second)",
+                   state->stopRequested ? L"Stopping scan..." : L"Scanning...",
+                   progress->sourcesDone, progress->sourceCount, counts, progress->perSecond);
+    else if (state->job != NULL)
+        swprintf_s(status, 384, L"%s found %s (%.0f per second)",
+                   state->stopRequested ? L"Stopping scan..." : L"Scanning...", counts, progress->perSecond);
+    else if (progress->sourcesFailed > 0 && progress->sourcesFailed < progress->sourceCount)
+        swprintf_s(status, 384, L"Found %s. %d of %d domains failed or were incomplete.",
+                   counts, progress->sourcesFailed, progress->sourceCount);
+    else if (progress->cancelled)
+        swprintf_s(status, 384, L"Scan stopped: found %s.", counts);
+    else if (!progress->succeeded && progress->cached > 0)
+        swprintf_s(status, 384, L"Refresh failed (error %lu): showing %s cached %s.",
+                   progress->summary.status, counts, cachedAt);
+    else if (!progress->succeeded)
+        swprintf_s(status, 384, L"Scan failed (error %lu).", progress->summary.status);
+    else if (!progress->summary.complete && progress->summary.status != ERROR_NO_BROWSER_SERVERS_FOUND)
+        swprintf_s(status, 384, L"Scan incomplete (error %lu, %lu of %lu received): found %s.",
+                   progress->summary.status, progress->summary.entriesReceived,
+                   progress->summary.totalEntries, counts);
+    else if (progress->cached > 0)
+        swprintf_s(status, 384, L"Refreshed the results cached %s: %d new, %d changed, %d gone. %s.",
+                   cachedAt, progress->found - progress->unchanged - progress->changed,
+                   progress->changed, progress->gone, counts);
+    else
+        swprintf_s(status, 384, L"Found %s. Check the ones you want to add:", counts);
+    
+    SetDlgItemTextW(hwnd, IDC_STATIC_SCAN_STATUS, status);
+}
+
+/*
+ * ScanComputerMatches - TRUE if a computer passes the compiled filter
+ * 
+ * The computer is evaluated as if it were a host (name = hostname,
+ * comment = description); host is scratch space for that.
+ */
+BOOL ScanComputerMatches(const ScanResultsState* state, int computer, Host* host)
+{
+    if (state->query == NULL)
+        return TRUE;
+    
+    wcsncpy_s(host->hostname, MAX_HOSTNAME_LEN, state->computers[computer].name, _TRUNCATE);
+    wcsncpy_s(host->description, MAX_DESCRIPTION_LEN, state->computers[computer].comment, _TRUNCATE);
+    wcscpy_s(host->lastConnected, 64, L"Never");
+    return EvaluateQuery(state->query, host);
+}
+
+/*
+ * AppendScanResults - Add newly found computers to the dialog
+ * 
+ * New computers start checked and become rows if they pass the filter.
+ * A computer that is already listed (from the cache) is updated in place
+ * and keeps its check mark. The computers are copied; the array stays
+ * the scan job's (see TakeScanJobResults).
+ * 
+ * Returns FALSE if out of memory (the computers are dropped).
+ */
+BOOL AppendScanResults(HWND hwnd, ScanResultsState* state, ComputerInfo* computers, int newCount)
+{
+    if (newCount <= 0)
+        return TRUE;
+    
+    // Grow the three arrays together (doubling keeps appends cheap)
+    if (state->count + newCount > state->capacity)
+    {
+        int newCapacity = (state->capacity > 0) ? state->capacity : 256;
+        while (newCapacity < state->count + newCount)
+            newCapacity *= 2;
+        
+        ComputerInfo* newComputers = (ComputerInfo*)realloc(state->computers, sizeof(ComputerInfo) * newCapacity);
+        if (newComputers != NULL)
+            state->computers = newComputers;
+        int* newVisible = (int*)realloc(state->visible, sizeof(int) * newCapacity);
+        if (newVisible != NULL)
+            state->visible = newVisible;
+        int oldBytes = (state->capacity > 0) ? state->capacity / 8 + 1 : 0;
+        BYTE* newChecked = (BYTE*)realloc(state->checked, newCapacity / 8 + 1);
+        if (newChecked != NULL)
         {
-            CenterWindow(hwnd);
-            ApplyDarkModeToDialog(hwnd);
-            
-            // Set dialog icon
-            HICON hIcon = LoadIcon(g_hInstance, MAKEINTRESOURCE(IDI_MAINICON));
-            SendMessage(hwnd, WM_SETICON, ICON_BIG, (LPARAM)hIcon);
-            SendMessage(hwnd, WM_SETICON, ICON_SMALL, (LPARAM)hIcon);
+            memset(newChecked + oldBytes, 0, newCapacity / 8 + 1 - oldBytes);
+            state->checked = newChecked;
+        }
+        
+        if (newComputers == NULL || newVisible == NULL || newChecked == NULL)
+            return FALSE;
+        state->capacity = newCapacity;
+    }
+    if (state->indexCapacity < state->capacity * 2 && !RebuildScanIndex(state))
+        return FALSE;
+    
+    Host host = {0};
+    BOOL updated = FALSE;
+    for (int k = 0; k < newCount; k++)
+    {
+        int existing = FindScanComputer(state, HashHostKey(computers[k].name));
+        if (existing >= 0)
+        {
+            state->computers[existing] = computers[k];
+            updated = TRUE;
+            continue;
+        }
+        
+        int i = state->count++;
+        state->computers[i] = computers[k];
+        AddScanIndex(state, i);
+        SetScanChecked(state, i, TRUE);
+        if (ScanComputerMatches(state, i, &host))
+            state->visible[state->visibleCount++] = i;
+    }
+    
+    HWND hList = GetDlgItem(hwnd, IDC_LIST_SCAN_RESULTS);
+    if (updated)
+    {
+        // A changed description can move a row in or out of the filter
+        state->visibleCount = 0;
+        for (int i = 0; i < state->count; i++)
+        {
+            if (ScanComputerMatches(state, i, &host))
+                state->visible[state->visibleCount++] = i;
+        }
+        ListView_SetItemCountEx(hList, state->visibleCount, LVSICF_NOSCROLL);
+        InvalidateRect(hList, NULL, FALSE);
+    }
+    else
+    {
+        // Keep the scroll position; only the new rows need painting
+        ListView_SetItemCountEx(hList, state->visibleCount, LVSICF_NOINVALIDATEALL | LVSICF_NOSCROLL);
+    }
+    return TRUE;
+}
+
+/*
+ * RemoveGoneScanResults - Drop the cached computers the refresh no longer found
+ * 
+ * Parameters:
+ *   nameHashes - HashHostKey of each computer to drop (from TakeScanJobGone)
+ *   goneCount  - Number of hashes
+ * 
+ * The remaining computers keep their order and check marks.
+ */
+void RemoveGoneScanResults(HWND hwnd, ScanResultsState* state, const ULONGLONG* nameHashes, int goneCount)
+{
+    int removed = 0;
+    
+    // Mark them by clearing the name, then close the gaps
+    for (int i = 0; i < goneCount; i++)
+    {
+        int computer = FindScanComputer(state, nameHashes[i]);
+        if (computer >= 0 && state->computers[computer].name[0] != L'\0')
+        {
+            SetScanChecked(state, computer, FALSE);
+            state->computers[computer].name[0] = L'\0';
+            removed++;
+        }
+    }
+    if (removed == 0)
+        return;
+    
+    int kept = 0;
+    for (int i = 0; i < state->count; i++)
+    {
+        if (state->computers[i].name[0] == L'\0')
+            continue;
+        
+        BOOL checked = IsScanChecked(state, i);
+        SetScanChecked(state, i, FALSE);
+        state->computers[kept] = state->computers[i];
+        SetScanChecked(state, kept, checked);
+        kept++;
+    }
+    state->count = kept;
+    
+    // The indices have moved; the index cannot fail here, its size is unchanged
+    RebuildScanIndex(state);
+    Host host = {0};
+    state->visibleCount = 0;
+    for (int i = 0; i < state->count; i++)
+    {
+        if (ScanComputerMatches(state, i, &host))
+            state->visible[state->visibleCount++] = i;
+    }
+    
+    HWND hList = GetDlgItem(hwnd, IDC_LIST_SCAN_RESULTS);
+    ListView_SetItemCountEx(hList, state->visibleCount, LVSICF_NOSCROLL);
+    InvalidateRect(hList, NULL, FALSE);
+}
+
+/*
+ * ApplyScanFilter - Recompute the visible rows from the filter box
+ * 
+ * Uses the main search's query compiler, evaluated against each computer
+ * as if it were a host (name = hostname, comment = description).
+ */
+void ApplyScanFilter(HWND hwnd, ScanResultsState* state)
+{
+    HWND hList = GetDlgItem(hwnd, IDC_LIST_SCAN_RESULTS);
+    wchar_t filterText[256] = {0};
+    wchar_t error[128] = {0};
+    
+    GetDlgItemTextW(hwnd, IDC_EDIT_SCAN_FILTER, filterText, 256);
+    
+    Query* query = CompileQuery(filterText, state->query, error, ARRAYSIZE(error));
+    if (query == NULL)
+    {
+        // Keep showing the previous rows until the filter parses again
+        UpdateScanResultsStatus(hwnd, state, error);
+        return;
+    }
+    FreeQuery(state->query);
+    state->query = query;
+    
+    Host host = {0};
+    
+    state->visibleCount = 0;
+    for (int i = 0; i < state->count; i++)
+    {
+        if (ScanComputerMatches(state, i, &host))
+            state->visible[state->visibleCount++] = i;
+    }
+    
+    // Owner-data: only the row count changes, rows are fetched on paint
+    ListView_SetItemCountEx(hList, state->visibleCount, 0);
+    InvalidateRect(hList, NULL, FALSE);
+    UpdateScanResultsStatus(hwnd, state, NULL);
+}
+
+/*
+ * ToggleScanRows - Flip the check mark of every selected row
+ */
+void ToggleScanRows(HWND hwnd, ScanResultsState* state)
+{
+    HWND hList = GetDlgItem(hwnd, IDC_LIST_SCAN_RESULTS);
+    int row = -1;
+    
+    while ((row = ListView_GetNextItem(hList, row, LVNI_SELECTED)) >= 0)
+    {
+        if (row < state->visibleCount)
+        {
+            int computer = state->visible[row];
+            SetScanChecked(state, computer, !IsScanChecked(state, computer));
+            ListView_RedrawItems(hList, row, row);
+        }
+    }
+    UpdateScanResultsStatus(hwnd, state, NULL);
+}
+
+/*
+ * ReportScanSources - Show the domains that could not be scanned
+ * 
+ * When a multi-domain scan had failures, they are listed in a message box;
+ * a single domain's failure is already in the status line.
+ */
+void ReportScanSources(HWND hwnd, ScanJob* job, const ScanProgress* progress)
+{
+    ScanSourceResult sources[SCAN_MAX_SOURCES];
+    int sourceCount = GetScanJobSources(job, sources, SCAN_MAX_SOURCES);
+    wchar_t report[2048] = L"Some domains could not be scanned completely:\n";
+    
+    for (int i = 0; i < sourceCount; i++)
+    {
+        const ScanSourceResult* source = &sources[i];
+        const wchar_t* name = (source->name[0] != L'\0') ? source->name : L"(current domain)";
+        wchar_t line[384];
+        
+        if (!source->finished)
+            continue;
+        if (source->timedOut)
+            swprintf_s(line, 384, L"\n%s: timed out after %.0f s (%d found)", name, source->elapsedMs / 1000.0, source->found);
+        else if (!source->succeeded)
+            swprintf_s(line, 384, L"\n%s: failed (error %lu)", name, source->summary.status);
+        else if (!source->summary.complete && source->summary.status != ERROR_NO_BROWSER_SERVERS_FOUND)
+            swprintf_s(line, 384, L"\n%s: incomplete (error %lu, %lu of %lu received)", name,
+                       source->summary.status, source->summary.entriesReceived, source->summary.totalEntries);
+        else
+            continue;
+        wcsncat_s(report, ARRAYSIZE(report), line, _TRUNCATE);
+    }
+    
+    if (progress->sourceCount > 1 && progress->sourcesFailed > 0 && !progress->cancelled)
+        ShowInfoMessage(hwnd, report);
+}
+
+/*
+ * ImportScanResults - Add the checked computers as a diff against the saved hosts
+ * 
+ * Every computer found is compared with the hosts list (DiffHosts), so the
+ * user learns what is new, which known hosts now have another description
+ * and - after a complete scan - which saved hosts were not seen. Only the
+ * checked new computers (and, if the user agrees, the checked changed
+ * descriptions) are written, in one save; nothing is written if nothing
+ * changes.
+ * 
+ * Returns:
+ *   TRUE if the dialog can close, FALSE to stay open (error or cancelled)
+ */
+BOOL ImportScanResults(HWND hwnd, const ScanResultsState* state)
+{
+    Host* hosts = NULL;
+    int hostCount = 0;
+    HostDiff diff;
+    int addedCount = 0;
+    int updatedCount = 0;
+    
+    const wchar_t** hostnames = (const wchar_t**)malloc((state->count + 1) * sizeof(wchar_t*));
+    const wchar_t** descriptions = (const wchar_t**)malloc((state->count + 1) * sizeof(wchar_t*));
+    BYTE* include = (BYTE*)malloc(state->count + 1);
+    BOOL ok = (hostnames != NULL && descriptions != NULL && include != NULL && LoadHosts(&hosts, &hostCount));
+    
+    if (ok)
+    {
+        for (int i = 0; i < state->count; i++)
+        {
+            hostnames[i] = state->computers[i].name;
+            descriptions[i] = state->computers[i].comment;
+            include[i] = (BYTE)IsScanChecked(state, i);
+        }
+        
+        LONGLONG diffStart = GetSearchTicks();
+        ok = DiffHosts(hosts, hostCount, hostnames, descriptions, state->count, &diff);
+        RecordPerfSample(PERF_IMPORT_DIFF, SearchTicksToMs(GetSearchTicks() - diffStart));
+    }
+    
+    if (ok)
+    {
+        int checkedAdded = 0, checkedUpdated = 0;
+        for (int i = 0; i < diff.addedCount; i++)
+            checkedAdded += include[diff.added[i]];
+        for (int i = 0; i < diff.updatedCount; i++)
+            checkedUpdated += include[diff.updated[i]];
+        
+        // Descriptions are only replaced when the user says so
+        BOOL updateDescriptions = FALSE;
+        int answer = IDNO;
+        if (checkedUpdated > 0)
+        {
+            wchar_t question[512];
+            swprintf_s(question, ARRAYSIZE(question),
+                       L"%d checked computer(s) are new and %d are already in your hosts list "
+                       L"with a different description.\n\n"
+                       L"Yes - add the new computers and replace those descriptions\n"
+                       L"No - add the new computers and keep your descriptions\n"
+                       L"Cancel - change nothing",
+                       checkedAdded, checkedUpdated);
+            answer = MessageBoxW(hwnd, question, L"Update Descriptions?", MB_YESNOCANCEL | MB_ICONQUESTION);
+            updateDescriptions = (answer == IDYES);
+        }
+        
+        if (answer == IDCANCEL)
+            ok = FALSE;
+        else if (!ApplyHostDiff(hosts, hostCount, hostnames, descriptions, &diff, include,
+                                updateDescriptions, &addedCount, &updatedCount))
+        {
+            ShowErrorMessage(hwnd, L"Failed to add the computers to your hosts list.");
+            ok = FALSE;
+        }
+        
+        if (ok)
+        {
+            wchar_t msg[1024];
+            if (addedCount == 0 && updatedCount == 0)
+                swprintf_s(msg, ARRAYSIZE(msg), L"Nothing to change - the checked computers are already in your hosts list.");
+            else
+                swprintf_s(msg, ARRAYSIZE(msg), L"Added %d computer(s) and updated %d description(s).",
+                           addedCount, updatedCount);
+            
+            // Only a scan that ran to the end can say a host is gone
+            BOOL scanComplete = state->progress.finished && !state->progress.cancelled &&
+                                state->progress.succeeded && state->progress.sourcesFailed == 0;
+            if (scanComplete && diff.missingCount > 0)
+            {
+                wchar_t line[MAX_HOSTNAME_LEN + 16];
+                swprintf_s(line, ARRAYSIZE(line), L"\n\n%d host(s) in your list were not found by this scan:",
+                           diff.missingCount);
+                wcscat_s(msg, ARRAYSIZE(msg), line);
+                for (int i = 0; i < diff.missingCount && i < 5; i++)
+                {
+                    swprintf_s(line, ARRAYSIZE(line), L"\n• %s", hosts[diff.missing[i]].hostname);
+                    wcscat_s(msg, ARRAYSIZE(msg), line);
+                }
+                if (diff.missingCount > 5)
+                {
+                    swprintf_s(line, ARRAYSIZE(line), L"\n... and %d more", diff.missingCount - 5);
+                    wcscat_s(msg, ARRAYSIZE(msg), line);
+                }
+            }
+            ShowInfoMessage(hwnd, msg);
+        }
+        FreeHostDiff(&diff);
+    }
+    else
+    {
+        ShowErrorMessage(hwnd, L"Failed to compare the scan results with your hosts list.");
+    }
+    
+    FreeHosts(hosts, hostCount);
+    free(include);
+    free((void*)hostnames);
+    free((void*)descriptions);
+    return ok;
+}
+
+/*
+ * FreeScanResultsState - Stop the scan and free the dialog state and results
+ */
+void FreeScanResultsState(ScanResultsState* state)
+{
+    FreeScanJob(state->job);
+    FreeComputerList(state->computers);
+    free(state->checked);
+    free(state->visible);
+    free(state->index);
+    FreeQuery(state->query);
+    memset(state, 0, sizeof(ScanResultsState));
+}
+
+/*
+ * ScanResultsDialogProc - Display network scan results
+ * 
+ * Runs the scan described by the ScanParams* passed via lParam in
+ * DialogBoxParam, shows computers as they are discovered and allows the
+ * user to select which to add. Returns IDOK if hosts were added.
+ */
+INT_PTR CALLBACK ScanResultsDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    static ScanResultsState state = {0};
+    
+    switch (msg)
+    {
+        case WM_INITDIALOG:
+        {
+            CenterWindow(hwnd);
+            ApplyDarkModeToDialog(hwnd);
             
-            // Get computer list - need to extract both pointer and count
-            // Since we can only pass one parameter, we'll pass the pointer
-            // and the count needs to be embedded or passed differently
-            s_computers = (ComputerInfo*)lParam;
+            // Set dialog icon
+            HICON hIcon = LoadIcon(g_hInstance, MAKEINTRESOURCE(IDI_MAINICON));
+            SendMessage(hwnd, WM_SETICON, ICON_BIG, (LPARAM)hIcon);
+            SendMessage(hwnd, WM_SETICON, ICON_SMALL, (LPARAM)hIcon);
+            
+            // Rows are added as the cache is read and the scan finds computers
+            memset(&state, 0, sizeof(state));
             
             // Get ListView handle
             HWND hList = GetDlgItem(hwnd, IDC_LIST_SCAN_RESULTS);
             
-            // Set extended styles with checkboxes
+            // Checkboxes are drawn from the bitset (state image 1 = unchecked, 2 = checked);
+            // the callback mask makes the ListView ask for the state image
             ListView_SetExtendedListViewStyle(hList,
                 LVS_EX_FULLROWSELECT | LVS_EX_GRIDLINES | LVS_EX_DOUBLEBUFFER | LVS_EX_CHECKBOXES);
+            ListView_SetCallbackMask(hList, LVIS_STATEIMAGEMASK);
             
             ApplyDarkModeToListView(hList);
             
@@ -2757,13 +4122,12 @@ INT_PTR CALLBACK ScanResultsDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARA
             GetClientRect(hList, &rcList);
             int listWidth = rcList.right - rcList.left;
             
-            // Create columns with dummy column for centering
+            // Column 0 holds the checkbox, the others the computer details
             LVCOLUMNW col = {0};
             
-            // Dummy column
             col.mask = LVCF_TEXT | LVCF_WIDTH;
             col.pszText = L"";
-            col.cx = 1;
+            col.cx = 24;
             ListView_InsertColumn(hList, 0, &col);
             
             // Real columns (centered)
@@ -2775,98 +4139,249 @@ INT_PTR CALLBACK ScanResultsDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARA
             ListView_InsertColumn(hList, 1, &col);
             
             col.pszText = L"Description";
-            col.cx = listWidth - 200 - 5;
+            col.cx = listWidth - 200 - 150 - 110 - 24 - 5;
             ListView_InsertColumn(hList, 2, &col);
             
-            // Get count from global variable
-            s_computerCount = g_scanComputerCount;
+            // Only the directory (LDAP) scan fills these in
+            col.pszText = L"Operating System";
+            col.cx = 150;
+            ListView_InsertColumn(hList, 3, &col);
+            
+            col.pszText = L"Last Logon";
+            col.cx = 110;
+            ListView_InsertColumn(hList, 4, &col);
             
-            for (int i = 0; i < s_computerCount && s_computers != NULL; i++)
+            // Start scanning; progress arrives as WM_SCAN_PROGRESS
+            const ScanParams* params = (const ScanParams*)lParam;
+            ComputerSource source = NULL;
+            if (params->mode == SCAN_MODE_DIRECTORY)
+                source = EnumerateDirectoryComputers;
+            else if (params->mode == SCAN_MODE_SWEEP)
+                source = EnumerateSubnetComputers;
+            state.sweep = (params->mode == SCAN_MODE_SWEEP);
+            state.job = StartScanJob(params, source, hwnd);
+            if (state.job == NULL)
             {
-                LVITEMW item = {0};
-                item.mask = LVIF_TEXT;
-                item.iItem = i;
-                item.iSubItem = 0;
-                item.pszText = L"";  // Dummy column
-                ListView_InsertItem(hList, &item);
-                
-                ListView_SetItemText(hList, i, 1, s_computers[i].name);
-                ListView_SetItemText(hList, i, 2, s_computers[i].comment);
-                
-                // Check item by default
-                ListView_SetCheckState(hList, i, TRUE);
+                ShowErrorMessage(hwnd, L"Failed to start the scan.");
+                FreeScanResultsState(&state);
+                EndDialog(hwnd, IDCANCEL);
+                return TRUE;
             }
+            UpdateScanResultsStatus(hwnd, &state, NULL);
             
-            // Update status
-            wchar_t status[256];
-            swprintf_s(status, 256, L"Found %d computer(s). Check the ones you want to add:", s_computerCount);
-            SetDlgItemTextW(hwnd, IDC_STATIC_SCAN_STATUS, status);
+            return TRUE;
+        }
+        
+        case WM_SCAN_PROGRESS:
+        {
+            // Ignore nudges queued before the scan ended
+            if (state.job == NULL)
+                return TRUE;
+            
+            ComputerInfo* computers = NULL;
+            int newCount = TakeScanJobResults(state.job, &computers);
+            if (!AppendScanResults(hwnd, &state, computers, newCount))
+                CancelScanJob(state.job);
             
+            GetScanJobProgress(state.job, &state.progress);
+            UpdateScanResultsStatus(hwnd, &state, NULL);
+            return TRUE;
+        }
+        
+        case WM_SCAN_COMPLETE:
+        {
+            if (state.job == NULL)
+                return TRUE;
+            
+            // Pick up the last pages (and any cache not shown yet), then release the worker
+            ComputerInfo* computers = NULL;
+            int newCount;
+            while ((newCount = TakeScanJobResults(state.job, &computers)) > 0)
+                AppendScanResults(hwnd, &state, computers, newCount);
+            
+            GetScanJobProgress(state.job, &state.progress);
+            ULONGLONG* gone = NULL;
+            int goneCount = TakeScanJobGone(state.job, &gone);
+            RemoveGoneScanResults(hwnd, &state, gone, goneCount);
+            free(gone);
+            
+            ReportScanSources(hwnd, state.job, &state.progress);
+            FreeScanJob(state.job);
+            state.job = NULL;
+            
+            EnableWindow(GetDlgItem(hwnd, IDC_BTN_SCAN_STOP), FALSE);
+            UpdateScanResultsStatus(hwnd, &state, NULL);
+            
+            // (ReportScanSources has listed the failures of a multi-domain scan)
+            if (!state.progress.succeeded && state.progress.sourceCount == 1)
+            {
+                wchar_t error[256];
+                swprintf_s(error, 256,
+                    L"Failed to scan for computers (error %lu).\n\nPlease check network connectivity and permissions.",
+                    state.progress.summary.status);
+                ShowErrorMessage(hwnd, error);
+            }
+            else if (state.count == 0 && !state.progress.cancelled)
+            {
+                ShowInfoMessage(hwnd, 
+                    L"No computers found on the network.\n\n"
+                    L"This could mean:\n"
+                    L"• You're not connected to a network\n"
+                    L"• Network discovery is disabled\n"
+                    L"• Firewall is blocking discovery\n"
+                    L"• The specified domain/workgroup doesn't exist\n\n"
+                    L"You can still manually add hosts using 'Add Host'.");
+            }
             return TRUE;
         }
         
+        case WM_NOTIFY:
+        {
+            LPNMHDR pnmhdr = (LPNMHDR)lParam;
+            if (pnmhdr->idFrom != IDC_LIST_SCAN_RESULTS)
+                break;
+            
+            if (pnmhdr->code == LVN_GETDISPINFOW)
+            {
+                // Supply text and check mark for a row about to be painted
+                NMLVDISPINFOW* pdi = (NMLVDISPINFOW*)lParam;
+                int row = pdi->item.iItem;
+                if (row < 0 || row >= state.visibleCount)
+                    return TRUE;
+                
+                const ComputerInfo* computer = &state.computers[state.visible[row]];
+                
+                if (pdi->item.mask & LVIF_TEXT)
+                {
+                    if (pdi->item.iSubItem == 1)
+                        pdi->item.pszText = (LPWSTR)computer->name;
+                    else if (pdi->item.iSubItem == 2)
+                        pdi->item.pszText = (LPWSTR)computer->comment;
+                    else if (pdi->item.iSubItem == 3)
+                        pdi->item.pszText = (LPWSTR)computer->operatingSystem;
+                    else if (pdi->item.iSubItem == 4 && computer->lastLogon != 0 && pdi->item.cchTextMax > 0)
+                    {
+                        // Formatted into the ListView's own buffer (local date)
+                        FILETIME utc, local;
+                        SYSTEMTIME st;
+                        utc.dwLowDateTime = (DWORD)(computer->lastLogon & 0xFFFFFFFF);
+                        utc.dwHighDateTime = (DWORD)(computer->lastLogon >> 32);
+                        if (FileTimeToLocalFileTime(&utc, &local) && FileTimeToSystemTime(&local, &st))
+                            swprintf_s(pdi->item.pszText, pdi->item.cchTextMax, L"%04d-%02d-%02d",
+                                       st.wYear, st.wMonth, st.wDay);
+                        else
+                            pdi->item.pszText[0] = L'\0';
+                    }
+                    else
+                        pdi->item.pszText = L"";
+                }
+                if ((pdi->item.mask & LVIF_STATE) && pdi->item.iSubItem == 0)
+                {
+                    pdi->item.stateMask = LVIS_STATEIMAGEMASK;
+                    pdi->item.state = INDEXTOSTATEIMAGEMASK(IsScanChecked(&state, state.visible[row]) ? 2 : 1);
+                }
+                return TRUE;
+            }
+            else if (pnmhdr->code == NM_CLICK)
+            {
+                // Owner-data lists do not toggle check boxes themselves
+                LPNMITEMACTIVATE pnmia = (LPNMITEMACTIVATE)lParam;
+                LVHITTESTINFO hit = {0};
+                hit.pt = pnmia->ptAction;
+                int row = ListView_SubItemHitTest(pnmhdr->hwndFrom, &hit);
+                
+                if (row >= 0 && row < state.visibleCount && (hit.flags & LVHT_ONITEMSTATEICON))
+                {
+                    int computer = state.visible[row];
+                    SetScanChecked(&state, computer, !IsScanChecked(&state, computer));
+                    ListView_RedrawItems(pnmhdr->hwndFrom, row, row);
+                    UpdateScanResultsStatus(hwnd, &state, NULL);
+                }
+                return TRUE;
+            }
+            else if (pnmhdr->code == LVN_KEYDOWN)
+            {
+                // Space toggles every selected row
+                if (((LPNMLVKEYDOWN)lParam)->wVKey == VK_SPACE)
+                    ToggleScanRows(hwnd, &state);
+                return TRUE;
+            }
+            break;
+        }
+        
+        case WM_TIMER:
+            // Filter typing paused - apply it
+            if (wParam == TIMER_SEARCH_DEBOUNCE)
+            {
+                KillTimer(hwnd, TIMER_SEARCH_DEBOUNCE);
+                ApplyScanFilter(hwnd, &state);
+            }
+            return TRUE;
+        
         case WM_COMMAND:
             switch (LOWORD(wParam))
             {
-                case IDC_BTN_ADD_SELECTED:
-                {
-                    // Add selected (checked) computers to hosts
-                    HWND hList = GetDlgItem(hwnd, IDC_LIST_SCAN_RESULTS);
-                    int itemCount = ListView_GetItemCount(hList);
-                    int addedCount = 0;
-                    
-                    for (int i = 0; i < itemCount; i++)
+                case IDC_EDIT_SCAN_FILTER:
+                    if (HIWORD(wParam) == EN_CHANGE)
+                        SetTimer(hwnd, TIMER_SEARCH_DEBOUNCE, SEARCH_DEBOUNCE_MS, NULL);
+                    return TRUE;
+                
+                case IDC_BTN_SCAN_STOP:
+                    // Stops after the page being read; WM_SCAN_COMPLETE follows
+                    if (state.job != NULL)
                     {
-                        // Check if item is checked
-                        if (ListView_GetCheckState(hList, i))
-                        {
-                            wchar_t hostname[256];
-                            wchar_t description[256];
-                            
-                            ListView_GetItemText(hList, i, 1, hostname, 256);
-                            ListView_GetItemText(hList, i, 2, description, 256);
-                            
-                            if (AddHost(hostname, description))
-                            {
-                                addedCount++;
-                            }
-                        }
+                        CancelScanJob(state.job);
+                        state.stopRequested = TRUE;
+                        EnableWindow(GetDlgItem(hwnd, IDC_BTN_SCAN_STOP), FALSE);
+                        UpdateScanResultsStatus(hwnd, &state, NULL);
                     }
+                    return TRUE;
+                
+                case IDC_BTN_CHECK_ALL:
+                case IDC_BTN_CHECK_NONE:
+                {
+                    // Applies to the rows the filter shows
+                    BOOL check = (LOWORD(wParam) == IDC_BTN_CHECK_ALL);
+                    for (int row = 0; row < state.visibleCount; row++)
+                        SetScanChecked(&state, state.visible[row], check);
                     
-                    wchar_t msg[256];
-                    swprintf_s(msg, 256, L"Added %d computer(s) to your hosts list.", addedCount);
-                    ShowInfoMessage(hwnd, msg);
-                    
-                    // Free computers and close
-                    if (s_computers != NULL)
+                    InvalidateRect(GetDlgItem(hwnd, IDC_LIST_SCAN_RESULTS), NULL, FALSE);
+                    UpdateScanResultsStatus(hwnd, &state, NULL);
+                    return TRUE;
+                }
+                
+                case IDC_BTN_ADD_SELECTED:
+                {
+                    // Adding ends the scan - only computers the user has seen are added
+                    if (state.job != NULL)
                     {
-                        FreeComputerList(s_computers);
-                        s_computers = NULL;
+                        FreeScanJob(state.job);
+                        state.job = NULL;
+                        state.progress.cancelled = TRUE;
+                        EnableWindow(GetDlgItem(hwnd, IDC_BTN_SCAN_STOP), FALSE);
                     }
                     
+                    // Compare everything found with the saved hosts, then apply the checked part
+                    if (!ImportScanResults(hwnd, &state))
+                        return TRUE;
+                    
+                    KillTimer(hwnd, TIMER_SEARCH_DEBOUNCE);
+                    FreeScanResultsState(&state);
                     EndDialog(hwnd, IDOK);
                     return TRUE;
                 }
                 
                 case IDCANCEL:
-                    // Free computers and close
-                    if (s_computers != NULL)
-                    {
-                        FreeComputerList(s_computers);
-                        s_computers = NULL;
-                    }
+                    KillTimer(hwnd, TIMER_SEARCH_DEBOUNCE);
+                    FreeScanResultsState(&state);
                     EndDialog(hwnd, IDCANCEL);
                     return TRUE;
             }
             break;
         
         case WM_CLOSE:
-            // Free computers and close
-            if (s_computers != NULL)
-            {
-                FreeComputerList(s_computers);
-                s_computers = NULL;
-            }
+            KillTimer(hwnd, TIMER_SEARCH_DEBOUNCE);
+            FreeScanResultsState(&state);
             EndDialog(hwnd, IDCANCEL);
             return TRUE;
     }
@@ -2927,3 +4442,414 @@ INT_PTR CALLBACK AboutDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPar
     return FALSE;
 }
 
+
+/*
+ * ReloadPaletteHosts - Reload the quick connect palette's hosts and trie
+ * 
+ * Runs at startup and whenever the hosts file is saved (WM_HOSTS_CHANGED),
+ * so showing the palette never has to read the file.
+ */
+void ReloadPaletteHosts(void)
+{
+    Host* hosts = NULL;
+    int hostCount = 0;
+    
+    if (!LoadHosts(&hosts, &hostCount))
+        return;     // Keep the previous snapshot
+    
+    HostTrie* trie = BuildHostTrie(hosts, hostCount);
+    if (trie == NULL)
+    {
+        FreeHosts(hosts, hostCount);
+        return;
+    }
+    
+    FreeHostTrie(g_paletteTrie);
+    FreeHosts(g_paletteHosts, g_paletteHostCount);
+    g_paletteHosts = hosts;
+    g_paletteHostCount = hostCount;
+    g_paletteTrie = trie;
+    
+    // Refresh the matches if the palette is open
+    if (g_hwndPalette != NULL && IsWindowVisible(g_hwndPalette))
+        UpdatePaletteMatches(g_hwndPalette);
+}
+
+/*
+ * PrefetchRecentHosts - Resolve the most recently used hosts in the background
+ * 
+ * Runs with ReloadPaletteHosts. Connecting to one of these hosts then skips
+ * the DNS wait: the answer is already in the Windows DNS client cache that
+ * mstsc resolves from (and in ours, for reachability checks). The launcher
+ * also writes their .rdp files ahead of time.
+ */
+void PrefetchRecentHosts(void)
+{
+    Host* recentHosts = NULL;
+    int recentCount = 0;
+    const wchar_t* names[RESOLVER_PREFETCH_COUNT];
+    
+    if (!GetRecentHosts(&recentHosts, &recentCount, RESOLVER_PREFETCH_COUNT))
+        return;
+    
+    for (int i = 0; i < recentCount; i++)
+        names[i] = recentHosts[i].hostname;
+    
+    // The prefetch copies the names; one already running is left alone
+    StartResolverPrefetch(names, recentCount);
+    PrewarmHosts(names, recentCount);
+    FreeHosts(recentHosts, recentCount);
+}
+
+/*
+ * UpdatePaletteMatches - Fill the palette list with the matches for its text
+ * 
+ * A trie lookup is a walk down the typed prefix, so this is done on every
+ * keystroke without a debounce.
+ */
+void UpdatePaletteMatches(HWND hwndPalette)
+{
+    HWND hList = GetDlgItem(hwndPalette, IDC_LIST_PALETTE);
+    wchar_t text[MAX_HOSTNAME_LEN];
+    int matches[HOST_TRIE_TOP_MATCHES];
+    
+    GetDlgItemTextW(hwndPalette, IDC_EDIT_PALETTE, text, MAX_HOSTNAME_LEN);
+    int matchCount = FindHostTrieMatches(g_paletteTrie, text, matches, HOST_TRIE_TOP_MATCHES);
+    
+    SendMessage(hList, WM_SETREDRAW, FALSE, 0);
+    SendMessageW(hList, LB_RESETCONTENT, 0, 0);
+    for (int i = 0; i < matchCount; i++)
+    {
+        const Host* host = &g_paletteHosts[matches[i]];
+        wchar_t line[MAX_HOSTNAME_LEN + 64];
+        
+        if (host->description[0] != L'\0')
+            swprintf_s(line, ARRAYSIZE(line), L"%s  -  %.60s", host->hostname, host->description);
+        else
+            wcscpy_s(line, ARRAYSIZE(line), host->hostname);
+        
+        int item = (int)SendMessageW(hList, LB_ADDSTRING, 0, (LPARAM)line);
+        SendMessageW(hList, LB_SETITEMDATA, item, matches[i]);
+    }
+    SendMessageW(hList, LB_SETCURSEL, 0, 0);
+    SendMessage(hList, WM_SETREDRAW, TRUE, 0);
+    InvalidateRect(hList, NULL, TRUE);
+}
+
+/*
+ * TogglePalette - Show the quick connect palette, or hide it if it is showing
+ */
+void TogglePalette(void)
+{
+    if (g_hwndPalette == NULL)
+        return;
+    
+    if (IsWindowVisible(g_hwndPalette))
+    {
+        ShowWindow(g_hwndPalette, SW_HIDE);
+        return;
+    }
+    
+    // Top centre of the work area, where launchers usually appear
+    RECT workArea, rcPalette;
+    SystemParametersInfoW(SPI_GETWORKAREA, 0, &workArea, 0);
+    GetWindowRect(g_hwndPalette, &rcPalette);
+    int width = rcPalette.right - rcPalette.left;
+    SetWindowPos(g_hwndPalette, HWND_TOPMOST,
+                 workArea.left + (workArea.right - workArea.left - width) / 2,
+                 workArea.top + (workArea.bottom - workArea.top) / 5,
+                 0, 0, SWP_NOSIZE);
+    
+    // Clearing the text lists the most recent hosts (EN_CHANGE)
+    SetDlgItemTextW(g_hwndPalette, IDC_EDIT_PALETTE, L"");
+    ShowWindow(g_hwndPalette, SW_SHOW);
+    SetForegroundWindow(g_hwndPalette);
+    SetFocus(GetDlgItem(g_hwndPalette, IDC_EDIT_PALETTE));
+}
+
+/*
+ * PaletteEditProc - Subclassed palette edit box
+ * 
+ * The palette is a modeless dialog outside any IsDialogMessage loop, so
+ * the edit box handles the keys itself: Up/Down move through the matches,
+ * Enter connects and Escape hides the palette.
+ */
+LRESULT CALLBACK PaletteEditProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    HWND hwndPalette = GetParent(hwnd);
+    
+    if (msg == WM_KEYDOWN)
+    {
+        HWND hList = GetDlgItem(hwndPalette, IDC_LIST_PALETTE);
+        int selected = (int)SendMessageW(hList, LB_GETCURSEL, 0, 0);
+        int count = (int)SendMessageW(hList, LB_GETCOUNT, 0, 0);
+        
+        switch (wParam)
+        {
+            case VK_UP:
+                if (selected > 0)
+                    SendMessageW(hList, LB_SETCURSEL, selected - 1, 0);
+                return 0;
+            
+            case VK_DOWN:
+                if (selected + 1 < count)
+                    SendMessageW(hList, LB_SETCURSEL, selected + 1, 0);
+                return 0;
+            
+            case VK_RETURN:
+                PostMessage(hwndPalette, WM_COMMAND, IDOK, 0);
+                return 0;
+            
+            case VK_ESCAPE:
+                PostMessage(hwndPalette, WM_COMMAND, IDCANCEL, 0);
+                return 0;
+        }
+    }
+    else if (msg == WM_CHAR && (wParam == L'\r' || wParam == 0x1B))
+    {
+        return 0;   // Already handled in WM_KEYDOWN (avoids the edit box beep)
+    }
+    
+    return CallWindowProcW(g_paletteEditProc, hwnd, msg, wParam, lParam);
+}
+
+/*
+ * PaletteDialogProc - Quick connect palette
+ * 
+ * Modeless dialog created once at startup and then only shown and hidden.
+ * It searches a trie of the hosts kept in memory (g_paletteTrie), so
+ * opening it does not load the hosts file or build a ListView.
+ */
+INT_PTR CALLBACK PaletteDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    switch (msg)
+    {
+        case WM_INITDIALOG:
+        {
+            ApplyDarkModeToDialog(hwnd);
+            
+            // Take over the edit box's navigation keys
+            HWND hEdit = GetDlgItem(hwnd, IDC_EDIT_PALETTE);
+            g_paletteEditProc = (WNDPROC)SetWindowLongPtrW(hEdit, GWLP_WNDPROC, (LONG_PTR)PaletteEditProc);
+            SendMessageW(hEdit, EM_SETCUEBANNER, TRUE, (LPARAM)L"Connect to...");
+            return TRUE;
+        }
+        
+        case WM_ACTIVATE:
+            // Clicking anywhere else dismisses the palette
+            if (LOWORD(wParam) == WA_INACTIVE)
+                ShowWindow(hwnd, SW_HIDE);
+            return TRUE;
+        
+        case WM_COMMAND:
+            switch (LOWORD(wParam))
+            {
+                case IDC_EDIT_PALETTE:
+                    if (HIWORD(wParam) == EN_CHANGE)
+                        UpdatePaletteMatches(hwnd);
+                    return TRUE;
+                
+                case IDC_LIST_PALETTE:
+                    if (HIWORD(wParam) != LBN_DBLCLK)
+                        return TRUE;
+                    // Double-click connects, like Enter
+                    // fall through
+                
+                case IDOK:
+                {
+                    HWND hList = GetDlgItem(hwnd, IDC_LIST_PALETTE);
+                    int selected = (int)SendMessageW(hList, LB_GETCURSEL, 0, 0);
+                    if (selected < 0)
+                        return TRUE;
+                    
+                    int hostIndex = (int)SendMessageW(hList, LB_GETITEMDATA, selected, 0);
+                    if (hostIndex < 0 || hostIndex >= g_paletteHostCount)
+                        return TRUE;
+                    
+                    // Copy the name - connecting saves the hosts file, which reloads the snapshot
+                    wchar_t hostname[MAX_HOSTNAME_LEN];
+                    wcscpy_s(hostname, MAX_HOSTNAME_LEN, g_paletteHosts[hostIndex].hostname);
+                    ShowWindow(hwnd, SW_HIDE);
+                    if (!QueueConnect(hostname, NULL, GetSearchTicks()))
+                        LaunchRDPWithDefaults(hostname);
+                    return TRUE;
+                }
+                
+                case IDCANCEL:
+                    ShowWindow(hwnd, SW_HIDE);
+                    return TRUE;
+            }
+            break;
+        
+        case WM_CLOSE:
+            ShowWindow(hwnd, SW_HIDE);
+            return TRUE;
+        
+        case WM_DESTROY:
+            FreeHostTrie(g_paletteTrie);
+            FreeHosts(g_paletteHosts, g_paletteHostCount);
+            g_paletteTrie = NULL;
+            g_paletteHosts = NULL;
+            g_paletteHostCount = 0;
+            g_hwndPalette = NULL;
+            return TRUE;
+    }
+    
+    // Handle dark mode
+    INT_PTR result = HandleDarkModeMessages(hwnd, msg, wParam, lParam);
+    if (result != 0)
+        return result;
+    
+    UNREFERENCED_PARAMETER(lParam);
+    return FALSE;
+}
+
+/*
+ * FillDiagnosticsList - Show the current latency percentiles of every stage
+ * 
+ * Items are created once and only their text is updated afterwards, so the
+ * refresh timer does not make the list flicker or lose its selection.
+ */
+void FillDiagnosticsList(HWND hList)
+{
+    for (int stage = 0; stage < PERF_STAGE_COUNT; stage++)
+    {
+        PerfSummary summary;
+        wchar_t text[64];
+        
+        GetPerfSummary((PerfStage)stage, &summary);
+        
+        if (stage >= ListView_GetItemCount(hList))
+        {
+            LVITEMW item = {0};
+            item.mask = LVIF_TEXT;
+            item.iItem = stage;
+            item.pszText = (LPWSTR)GetPerfStageName((PerfStage)stage);
+            ListView_InsertItem(hList, &item);
+        }
+        
+        swprintf_s(text, 64, L"%d", summary.samples);
+        ListView_SetItemText(hList, stage, 1, text);
+        
+        double values[5] = { summary.meanMs, summary.p50Ms, summary.p90Ms, summary.p99Ms, summary.maxMs };
+        for (int column = 0; column < 5; column++)
+        {
+            if (summary.samples == 0)
+                wcscpy_s(text, 64, L"-");
+            else
+                swprintf_s(text, 64, L"%.2f", values[column]);
+            ListView_SetItemText(hList, stage, column + 2, text);
+        }
+    }
+}
+
+/*
+ * DiagnosticsDialogProc - Dialog procedure for the Diagnostics dialog
+ * 
+ * Shows the search and list latency percentiles (milliseconds) over the last
+ * PERF_WINDOW_SAMPLES samples of each stage, refreshed once a second. The
+ * numbers can be reset or saved as JSON next to the executable.
+ */
+INT_PTR CALLBACK DiagnosticsDialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    switch (msg)
+    {
+        case WM_INITDIALOG:
+        {
+            // Center the dialog on the screen
+            CenterWindow(hwnd);
+            
+            // Apply dark mode if enabled
+            ApplyDarkModeToDialog(hwnd);
+            
+            // Set dialog icon
+            HICON hIcon = LoadIcon(g_hInstance, MAKEINTRESOURCE(IDI_MAINICON));
+            SendMessage(hwnd, WM_SETICON, ICON_BIG, (LPARAM)hIcon);
+            SendMessage(hwnd, WM_SETICON, ICON_SMALL, (LPARAM)hIcon);
+            
+            HWND hList = GetDlgItem(hwnd, IDC_LIST_DIAGNOSTICS);
+            ListView_SetExtendedListViewStyle(hList,
+                LVS_EX_FULLROWSELECT | LVS_EX_GRIDLINES | LVS_EX_DOUBLEBUFFER);
+            ApplyDarkModeToListView(hList);
+            
+            // Stage name, sample count, then the timings (right aligned)
+            static const wchar_t* columnNames[] = { L"Stage", L"Samples", L"Mean", L"p50", L"p90", L"p99", L"Max" };
+            LVCOLUMNW col = {0};
+            col.mask = LVCF_TEXT | LVCF_WIDTH | LVCF_FMT;
+            for (int i = 0; i < 7; i++)
+            {
+                col.fmt = (i == 0) ? LVCFMT_LEFT : LVCFMT_RIGHT;
+                col.cx = (i == 0) ? 150 : 70;
+                col.pszText = (LPWSTR)columnNames[i];
+                ListView_InsertColumn(hList, i, &col);
+            }
+            
+            FillDiagnosticsList(hList);
+            SetTimer(hwnd, TIMER_DIAGNOSTICS_REFRESH, 1000, NULL);
+            return TRUE;
+        }
+        
+        case WM_TIMER:
+            if (wParam == TIMER_DIAGNOSTICS_REFRESH)
+            {
+                FillDiagnosticsList(GetDlgItem(hwnd, IDC_LIST_DIAGNOSTICS));
+                return TRUE;
+            }
+            break;
+        
+        case WM_COMMAND:
+            switch (LOWORD(wParam))
+            {
+                case IDC_BTN_DIAG_RESET:
+                    ResetPerfStats();
+                    FillDiagnosticsList(GetDlgItem(hwnd, IDC_LIST_DIAGNOSTICS));
+                    return TRUE;
+                
+                case IDC_BTN_DIAG_SAVE:
+                {
+                    // Save next to the executable, like hosts.csv
+                    wchar_t path[MAX_PATH];
+                    wchar_t message[MAX_PATH + 64];
+                    wchar_t* lastSlash = NULL;
+                    
+                    if (GetModuleFileNameW(NULL, path, MAX_PATH) != 0)
+                        lastSlash = wcsrchr(path, L'\\');
+                    if (lastSlash == NULL)
+                    {
+                        ShowErrorMessage(hwnd, L"Failed to determine the application folder.");
+                        return TRUE;
+                    }
+                    *(lastSlash + 1) = L'\0';
+                    
+                    if (wcscat_s(path, MAX_PATH, PERF_STATS_FILE_NAME) != 0 || !SavePerfStatsJson(path))
+                    {
+                        ShowErrorMessage(hwnd, L"Failed to save the diagnostics file.");
+                        return TRUE;
+                    }
+                    
+                    swprintf_s(message, MAX_PATH + 64, L"Diagnostics saved to:\n%s", path);
+                    ShowInfoMessage(hwnd, message);
+                    return TRUE;
+                }
+                
+                case IDOK:
+                case IDCANCEL:
+                    KillTimer(hwnd, TIMER_DIAGNOSTICS_REFRESH);
+                    EndDialog(hwnd, IDOK);
+                    return TRUE;
+            }
+            break;
+        
+        case WM_CLOSE:
+            KillTimer(hwnd, TIMER_DIAGNOSTICS_REFRESH);
+            EndDialog(hwnd, IDCANCEL);
+            return TRUE;
+    }
+    
+    // Handle dark mode
+    INT_PTR result = HandleDarkModeMessages(hwnd, msg, wParam, lParam);
+    if (result != 0)
+        return result;
+    
+    return FALSE;
+}
@@ -0,0 +1,642 @@
+/*
+ * Host Monitor Module
+ *
+ * "Check Reachability" answers the question once, when asked. The monitor
+ * keeps answering it: one background thread probes the hosts of the list
+ * in small rounds, and the list shows the newest answer in its Status
+ * column.
+ *
+ * Scheduling
+ *   Every host has a due time. Hosts on screen and the most recently
+ *   connected ones ("hot") are due every MONITOR_HOT_INTERVAL_MS, all
+ *   others every MONITOR_COLD_INTERVAL_MS. Each failure in a row doubles
+ *   the interval, up to MONITOR_MAX_BACKOFF_MS, so a retired server is
+ *   soon only tried twice an hour. Once a second the thread takes the due
+ *   hosts, hot ones and the longest overdue first, as many as the budget
+ *   allows, and probes them together with ProbeHosts.
+ *
+ * Budget
+ *   A token bucket: tokens flow in at MonitorPacketsPerSecond and a probe
+ *   costs MONITOR_PACKETS_PER_PROBE of them (a TCP handshake and its close,
+ *   both ways). The bucket holds one second's worth, so a quiet minute
+ *   does not turn into a burst. Lookups go through the resolver cache and
+ *   the RDP negotiation is left out, so a probe really is that small.
+ *
+ * Snapshot
+ *   After a round the thread builds a new hash table of every known status
+ *   and swaps it in with InterlockedExchangePointer. Readers (the list,
+ *   painting) count themselves in and out around the lookup; the thread
+ *   frees the old table once that count has dropped to zero. Any reader
+ *   that could still see the old table counted itself in before the swap,
+ *   so waiting for zero is enough, and readers never wait at all.
+ *
+ * Learning points:
+ *   - Token buckets for rate limiting
+ *   - Priority scheduling with exponential backoff
+ *   - Publishing immutable snapshots with an atomic pointer swap
+ *   - A reader count as a grace period before freeing
+ */
+
+#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "resource.h"
+#include "registry.h"
+#include "probe.h"
+#include "monitor.h"
+
+// One host on the schedule (owned by the monitor thread)
+typedef struct {
+    wchar_t hostname[MAX_HOSTNAME_LEN];
+    ULONGLONG nameHash;
+    BOOL recent;                // Among the MONITOR_RECENT_COUNT most recently connected
+    BOOL visible;               // On screen
+    ULONGLONG nextDue;          // GetTickCount64 when the next probe is due
+    HostStatus status;
+} MonitoredHost;
+
+// A host as SetMonitorHosts hands it over
+typedef struct {
+    wchar_t hostname[MAX_HOSTNAME_LEN];
+    wchar_t lastConnected[20];  // "YYYY-MM-DD HH:MM:SS" (empty = never)
+} MonitorInput;
+
+// Published statuses (nameHash 0 = empty slot); never changed once published
+typedef struct {
+    ULONGLONG nameHash;
+    HostStatus status;
+} SnapshotSlot;
+
+typedef struct {
+    int capacity;               // Power of two
+    SnapshotSlot slots[1];
+} MonitorSnapshot;
+
+// A due host while picking a round
+typedef struct {
+    int host;
+    BOOL hot;
+    ULONGLONG nextDue;
+} DueHost;
+
+static HANDLE g_hMonitorThread = NULL;
+static HANDLE g_hWakeEvent = NULL;          // Input changed or stop requested
+static HWND g_hwndNotify = NULL;
+static volatile LONG g_stopRequested = 0;
+static volatile LONG g_notifyPending = 0;
+static DWORD g_packetsPerSecond = MONITOR_PACKETS_PER_SECOND;
+static DWORD g_timeoutMs = PROBE_TIMEOUT_MS;
+
+// Input from the UI thread, taken over by the monitor thread
+static CRITICAL_SECTION g_inputLock;
+static MonitorInput* g_inputHosts = NULL;
+static int g_inputHostCount = 0;
+static BOOL g_inputHostsChanged = FALSE;
+static ULONGLONG g_inputVisible[MONITOR_MAX_VISIBLE];
+static int g_inputVisibleCount = 0;
+static BOOL g_inputVisibleChanged = FALSE;
+
+// Schedule (monitor thread only)
+static MonitoredHost* g_hosts = NULL;
+static int g_hostCount = 0;
+
+// Snapshot shared with every reader
+static MonitorSnapshot* volatile g_snapshot = NULL;
+static volatile LONG g_snapshotReaders = 0;
+
+/*
+ * FindSnapshotSlot - Look a host up in a snapshot (NULL if not there)
+ */
+static const SnapshotSlot* FindSnapshotSlot(const MonitorSnapshot* snapshot, ULONGLONG nameHash)
+{
+    if (snapshot == NULL)
+        return NULL;
+
+    int slot = (int)(nameHash & (snapshot->capacity - 1));
+    while (snapshot->slots[slot].nameHash != 0)
+    {
+        if (snapshot->slots[slot].nameHash == nameHash)
+            return &snapshot->slots[slot];
+        slot = (slot + 1) & (snapshot->capacity - 1);
+    }
+    return NULL;
+}
+
+/*
+ * GetProbeInterval - Time until a host's next probe
+ *
+ * Each failure in a row doubles the interval, up to MONITOR_MAX_BACKOFF_MS.
+ */
+static ULONGLONG GetProbeInterval(const MonitoredHost* host)
+{
+    ULONGLONG interval = (host->recent || host->visible) ? MONITOR_HOT_INTERVAL_MS : MONITOR_COLD_INTERVAL_MS;
+
+    for (int i = 0; i < host->status.failures && interval < MONITOR_MAX_BACKOFF_MS; i++)
+        interval *= 2;
+    return (interval < MONITOR_MAX_BACKOFF_MS) ? interval : MONITOR_MAX_BACKOFF_MS;
+}
+
+/*
+ * ScheduleHost - Set the due time from the last probe
+ *
+ * A host that was never probed is due at once.
+ */
+static void ScheduleHost(MonitoredHost* host, ULONGLONG now)
+{
+    host->nextDue = (host->status.state == HOST_STATUS_UNKNOWN)
+        ? now
+        : host->status.checkedAt + GetProbeInterval(host);
+}
+
+/*
+ * IsVisibleHash - TRUE if a name hash is in the visible set (sorted)
+ */
+static BOOL IsVisibleHash(const ULONGLONG* visible, int count, ULONGLONG nameHash)
+{
+    int low = 0, high = count - 1;
+    while (low <= high)
+    {
+        int middle = (low + high) / 2;
+        if (visible[middle] == nameHash)
+            return TRUE;
+        if (visible[middle] < nameHash)
+            low = middle + 1;
+        else
+            high = middle - 1;
+    }
+    return FALSE;
+}
+
+static int CompareHashes(const void* a, const void* b)
+{
+    ULONGLONG x = *(const ULONGLONG*)a, y = *(const ULONGLONG*)b;
+    return (x < y) ? -1 : (x > y);
+}
+
+/*
+ * TakeMonitorInput - Apply the hosts and visible rows the UI has set
+ *
+ * A new host list replaces the schedule; hosts that were already known
+ * keep their status (from the snapshot) and with it their backoff.
+ */
+static void TakeMonitorInput(ULONGLONG now)
+{
+    MonitorInput* input = NULL;
+    int inputCount = 0;
+    BOOL hostsChanged, visibleChanged;
+    ULONGLONG visible[MONITOR_MAX_VISIBLE];
+    int visibleCount;
+
+    EnterCriticalSection(&g_inputLock);
+    hostsChanged = g_inputHostsChanged;
+    visibleChanged = g_inputVisibleChanged;
+    if (hostsChanged)
+    {
+        input = g_inputHosts;
+        inputCount = g_inputHostCount;
+        g_inputHosts = NULL;
+        g_inputHostCount = 0;
+    }
+    visibleCount = g_inputVisibleCount;
+    memcpy(visible, g_inputVisible, sizeof(ULONGLONG) * visibleCount);
+    g_inputHostsChanged = FALSE;
+    g_inputVisibleChanged = FALSE;
+    LeaveCriticalSection(&g_inputLock);
+
+    if (!hostsChanged && !visibleChanged)
+        return;
+
+    if (hostsChanged)
+    {
+        MonitoredHost* hosts = (MonitoredHost*)calloc((inputCount > 0) ? inputCount : 1, sizeof(MonitoredHost));
+        if (hosts == NULL)
+        {
+            // Keep monitoring the old list
+            free(input);
+            return;
+        }
+
+        // The most recently connected ones, newest first (timestamps sort as text)
+        int recent[MONITOR_RECENT_COUNT];
+        int recentCount = 0;
+        for (int i = 0; i < inputCount; i++)
+        {
+            if (input[i].lastConnected[0] == L'\0')
+                continue;
+
+            int position = recentCount;
+            while (position > 0 && wcscmp(input[recent[position - 1]].lastConnected, input[i].lastConnected) < 0)
+                position--;
+            if (position >= MONITOR_RECENT_COUNT)
+                continue;
+            if (recentCount < MONITOR_RECENT_COUNT)
+                recentCount++;
+            memmove(&recent[position + 1], &recent[position], sizeof(int) * (recentCount - 1 - position));
+            recent[position] = i;
+        }
+
+        for (int i = 0; i < inputCount; i++)
+        {
+            MonitoredHost* host = &hosts[i];
+            wcscpy_s(host->hostname, MAX_HOSTNAME_LEN, input[i].hostname);
+            host->nameHash = HashHostKey(host->hostname);
+
+            // The monitor thread is the only writer, so it can read its own snapshot freely
+            const SnapshotSlot* known = FindSnapshotSlot(g_snapshot, host->nameHash);
+            if (known != NULL)
+                host->status = known->status;
+        }
+        for (int i = 0; i < recentCount; i++)
+            hosts[recent[i]].recent = TRUE;
+
+        free(input);
+        free(g_hosts);
+        g_hosts = hosts;
+        g_hostCount = inputCount;
+    }
+
+    qsort(visible, visibleCount, sizeof(ULONGLONG), CompareHashes);
+    for (int i = 0; i < g_hostCount; i++)
+    {
+        g_hosts[i].visible = IsVisibleHash(visible, visibleCount, g_hosts[i].nameHash);
+        ScheduleHost(&g_hosts[i], now);
+    }
+}
+
+static int CompareDueHosts(const void* a, const void* b)
+{
+    const DueHost* x = (const DueHost*)a;
+    const DueHost* y = (const DueHost*)b;
+
+    if (x->hot != y->hot)
+        return x->hot ? -1 : 1;
+    if (x->nextDue != y->nextDue)
+        return (x->nextDue < y->nextDue) ? -1 : 1;
+    return x->host - y->host;
+}
+
+/*
+ * PickDueHosts - Choose the hosts for this round
+ *
+ * Parameters:
+ *   now     - GetTickCount64
+ *   maximum - Probes the budget allows
+ *   picked  - Receives host indices (room for maximum)
+ *
+ * Returns the number picked: hot hosts first, then the longest overdue.
+ */
+static int PickDueHosts(ULONGLONG now, int maximum, int* picked)
+{
+    if (maximum <= 0 || g_hostCount == 0)
+        return 0;
+
+    DueHost* due = (DueHost*)malloc(sizeof(DueHost) * g_hostCount);
+    if (due == NULL)
+        return 0;
+
+    int dueCount = 0;
+    for (int i = 0; i < g_hostCount; i++)
+    {
+        if (g_hosts[i].nextDue > now)
+            continue;
+        due[dueCount].host = i;
+        due[dueCount].hot = g_hosts[i].recent || g_hosts[i].visible;
+        due[dueCount].nextDue = g_hosts[i].nextDue;
+        dueCount++;
+    }
+
+    // Usually everything due fits and nothing needs ordering
+    if (dueCount > maximum)
+        qsort(due, dueCount, sizeof(DueHost), CompareDueHosts);
+
+    int count = (dueCount < maximum) ? dueCount : maximum;
+    for (int i = 0; i < count; i++)
+        picked[i] = due[i].host;
+    free(due);
+    return count;
+}
+
+/*
+ * PublishSnapshot - Swap in a table of every known status and free the old one
+ *
+ * Returns FALSE if out of memory (readers keep the old table).
+ */
+static BOOL PublishSnapshot(void)
+{
+    int capacity = 64;
+    while (capacity < g_hostCount * 2)
+        capacity *= 2;
+
+    MonitorSnapshot* snapshot = (MonitorSnapshot*)calloc(1, sizeof(MonitorSnapshot) + sizeof(SnapshotSlot) * (capacity - 1));
+    if (snapshot == NULL)
+        return FALSE;
+
+    snapshot->capacity = capacity;
+    for (int i = 0; i < g_hostCount; i++)
+    {
+        if (g_hosts[i].status.state == HOST_STATUS_UNKNOWN)
+            continue;
+
+        int slot = (int)(g_hosts[i].nameHash & (capacity - 1));
+        while (snapshot->slots[slot].nameHash != 0 && snapshot->slots[slot].nameHash != g_hosts[i].nameHash)
+            slot = (slot + 1) & (capacity - 1);
+        snapshot->slots[slot].nameHash = g_hosts[i].nameHash;
+        snapshot->slots[slot].status = g_hosts[i].status;
+    }
+
+    MonitorSnapshot* old = (MonitorSnapshot*)InterlockedExchangePointer((PVOID volatile*)&g_snapshot, snapshot);
+
+    // Readers that may hold the old table counted themselves in before the swap
+    while (InterlockedCompareExchange(&g_snapshotReaders, 0, 0) != 0)
+        Sleep(0);
+    free(old);
+    return TRUE;
+}
+
+/*
+ * RunMonitorRound - Probe the hosts that are due, within the budget
+ *
+ * Parameters:
+ *   now        - GetTickCount64
+ *   affordable - Probes the budget allows
+ *   probed     - Receives the number of probes made
+ *
+ * Returns TRUE if a status changed (so the list should repaint).
+ */
+static BOOL RunMonitorRound(ULONGLONG now, int affordable, int* probed)
+{
+    *probed = 0;
+
+    int* picked = (int*)malloc(sizeof(int) * ((affordable > 0) ? affordable : 1));
+    if (picked == NULL)
+        return FALSE;
+
+    int count = PickDueHosts(now, affordable, picked);
+    const wchar_t** names = (const wchar_t**)malloc(sizeof(wchar_t*) * ((count > 0) ? count : 1));
+    ProbeResult* results = (ProbeResult*)malloc(sizeof(ProbeResult) * ((count > 0) ? count : 1));
+    BOOL changed = FALSE;
+
+    if (count > 0 && names != NULL && results != NULL)
+    {
+        for (int i = 0; i < count; i++)
+            names[i] = g_hosts[picked[i]].hostname;
+
+        // TCP only: the handshake alone is what the budget counts
+        ProbeOptions options = {0};
+        options.concurrency = count;
+        options.timeoutMs = g_timeoutMs;
+        options.negotiate = FALSE;
+
+        if (ProbeHosts(names, count, &options, results, &g_stopRequested) && !g_stopRequested)
+        {
+            *probed = count;
+            ULONGLONG checkedAt = GetTickCount64();
+            for (int i = 0; i < count; i++)
+            {
+                MonitoredHost* host = &g_hosts[picked[i]];
+                HostState state = results[i].reachable ? HOST_STATUS_UP : HOST_STATUS_DOWN;
+
+                if (state != host->status.state ||
+                    (state == HOST_STATUS_UP && (int)host->status.rttMs != (int)results[i].rttMs) ||
+                    (state == HOST_STATUS_DOWN && host->status.error != results[i].error))
+                {
+                    changed = TRUE;
+                }
+
+                host->status.state = state;
+                host->status.error = results[i].reachable ? 0 : results[i].error;
+                host->status.rttMs = (float)results[i].rttMs;
+                host->status.failures = results[i].reachable ? 0 : host->status.failures + 1;
+                host->status.checkedAt = checkedAt;
+                ScheduleHost(host, checkedAt);
+            }
+        }
+        else
+        {
+            // Winsock is not available - try these again after a cold interval
+            for (int i = 0; i < count; i++)
+                g_hosts[picked[i]].nextDue = now + MONITOR_COLD_INTERVAL_MS;
+        }
+    }
+
+    free(results);
+    free((void*)names);
+    free(picked);
+    return changed;
+}
+
+/*
+ * MonitorThread - Probe due hosts about once a second until stopped
+ */
+static DWORD WINAPI MonitorThread(LPVOID param)
+{
+    UNREFERENCED_PARAMETER(param);
+
+    double tokens = 0.0;
+    ULONGLONG lastRefill = GetTickCount64();
+
+    while (!g_stopRequested)
+    {
+        ULONGLONG now = GetTickCount64();
+        TakeMonitorInput(now);
+
+        // Refill the bucket; it holds at most one second's worth
+        tokens += g_packetsPerSecond * (double)(now - lastRefill) / 1000.0;
+        if (tokens > g_packetsPerSecond)
+            tokens = g_packetsPerSecond;
+        lastRefill = now;
+
+        int affordable = (int)(tokens / MONITOR_PACKETS_PER_PROBE);
+        if (affordable > PROBE_MAX_CONCURRENCY)
+            affordable = PROBE_MAX_CONCURRENCY;
+
+        // Only probes that were made are paid for
+        int probed;
+        BOOL changed = RunMonitorRound(now, affordable, &probed);
+        tokens -= (double)probed * MONITOR_PACKETS_PER_PROBE;
+
+        // Publish failures too (they carry the backoff); repaint only for changes
+        if (probed > 0 && PublishSnapshot() && changed && g_hwndNotify != NULL &&
+            InterlockedExchange(&g_notifyPending, 1) == 0)
+        {
+            if (!PostMessageW(g_hwndNotify, WM_MONITOR_UPDATE, 0, 0))
+                InterlockedExchange(&g_notifyPending, 0);
+        }
+
+        WaitForSingleObject(g_hWakeEvent, MONITOR_TICK_MS);
+    }
+    return 0;
+}
+
+/*
+ * StartHostMonitor - Start the monitor thread
+ *
+ * Parameters:
+ *   hwndNotify - Window that receives WM_MONITOR_UPDATE
+ *
+ * Returns TRUE if the monitor is running. Call SetMonitorHosts to give it work.
+ */
+BOOL StartHostMonitor(HWND hwndNotify)
+{
+    if (g_hMonitorThread != NULL)
+        return TRUE;
+    if (GetSettingDWORD(REG_HOST_MONITOR, HOST_MONITOR) == 0)
+        return FALSE;
+
+    g_packetsPerSecond = GetSettingDWORD(REG_MONITOR_PACKETS_PER_SECOND, MONITOR_PACKETS_PER_SECOND);
+    if (g_packetsPerSecond < MONITOR_PACKETS_PER_PROBE)
+        g_packetsPerSecond = MONITOR_PACKETS_PER_PROBE;
+    g_timeoutMs = GetSettingDWORD(REG_PROBE_TIMEOUT, PROBE_TIMEOUT_MS);
+
+    g_hWakeEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+    if (g_hWakeEvent == NULL)
+        return FALSE;
+
+    InitializeCriticalSection(&g_inputLock);
+    g_hwndNotify = hwndNotify;
+    g_stopRequested = 0;
+    g_notifyPending = 0;
+
+    g_hMonitorThread = CreateThread(NULL, 0, MonitorThread, NULL, 0, NULL);
+    if (g_hMonitorThread == NULL)
+    {
+        DeleteCriticalSection(&g_inputLock);
+        CloseHandle(g_hWakeEvent);
+        g_hWakeEvent = NULL;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * StopHostMonitor - Stop the thread after the round in flight
+ *
+ * Probes in flight are abandoned. The snapshot is kept, so the statuses
+ * (and their backoff) are there again when the monitor restarts.
+ */
+void StopHostMonitor(void)
+{
+    if (g_hMonitorThread == NULL)
+        return;
+
+    InterlockedExchange(&g_stopRequested, 1);
+    SetEvent(g_hWakeEvent);
+    WaitForSingleObject(g_hMonitorThread, INFINITE);
+    CloseHandle(g_hMonitorThread);
+    CloseHandle(g_hWakeEvent);
+    g_hMonitorThread = NULL;
+    g_hWakeEvent = NULL;
+
+    DeleteCriticalSection(&g_inputLock);
+    free(g_inputHosts);
+    g_inputHosts = NULL;
+    g_inputHostCount = 0;
+    g_inputHostsChanged = FALSE;
+    g_inputVisibleCount = 0;
+    g_inputVisibleChanged = FALSE;
+    free(g_hosts);
+    g_hosts = NULL;
+    g_hostCount = 0;
+    g_hwndNotify = NULL;
+}
+
+/*
+ * SetMonitorHosts - Give the monitor a (new) host list
+ *
+ * Copies the names and connection times; the caller may free the array.
+ */
+void SetMonitorHosts(const Host* hosts, int hostCount)
+{
+    if (g_hMonitorThread == NULL)
+        return;
+
+    MonitorInput* input = (MonitorInput*)calloc((hostCount > 0) ? hostCount : 1, sizeof(MonitorInput));
+    if (input == NULL)
+        return;
+
+    for (int i = 0; i < hostCount; i++)
+    {
+        wcscpy_s(input[i].hostname, MAX_HOSTNAME_LEN, hosts[i].hostname);
+        if (_wcsicmp(hosts[i].lastConnected, L"Never") != 0)
+            wcsncpy_s(input[i].lastConnected, ARRAYSIZE(input[i].lastConnected), hosts[i].lastConnected, _TRUNCATE);
+    }
+
+    EnterCriticalSection(&g_inputLock);
+    free(g_inputHosts);
+    g_inputHosts = input;
+    g_inputHostCount = (hosts != NULL) ? hostCount : 0;
+    g_inputHostsChanged = TRUE;
+    LeaveCriticalSection(&g_inputLock);
+
+    SetEvent(g_hWakeEvent);
+}
+
+/*
+ * SetMonitorVisible - Tell the monitor which hosts are on screen
+ *
+ * Only the first MONITOR_MAX_VISIBLE are taken.
+ */
+void SetMonitorVisible(const wchar_t* const* hostnames, int count)
+{
+    if (g_hMonitorThread == NULL)
+        return;
+
+    if (count > MONITOR_MAX_VISIBLE)
+        count = MONITOR_MAX_VISIBLE;
+
+    EnterCriticalSection(&g_inputLock);
+    for (int i = 0; i < count; i++)
+        g_inputVisible[i] = HashHostKey(hostnames[i]);
+    g_inputVisibleCount = count;
+    g_inputVisibleChanged = TRUE;
+    LeaveCriticalSection(&g_inputLock);
+
+    SetEvent(g_hWakeEvent);
+}
+
+/*
+ * GetHostStatus - Newest status of a host
+ *
+ * Lock-free: counts itself as a reader so the monitor does not free the
+ * table underneath it, and never waits.
+ *
+ * Returns FALSE if the host has not been probed (status is cleared).
+ */
+BOOL GetHostStatus(const wchar_t* hostname, HostStatus* status)
+{
+    ULONGLONG nameHash = HashHostKey(hostname);
+
+    InterlockedIncrement(&g_snapshotReaders);
+    const MonitorSnapshot* snapshot = (const MonitorSnapshot*)InterlockedCompareExchangePointer(
+        (PVOID volatile*)&g_snapshot, NULL, NULL);
+    const SnapshotSlot* slot = FindSnapshotSlot(snapshot, nameHash);
+    if (slot != NULL)
+        *status = slot->status;
+    InterlockedDecrement(&g_snapshotReaders);
+
+    if (slot == NULL)
+        memset(status, 0, sizeof(HostStatus));
+    return slot != NULL;
+}
+
+/*
+ * FormatHostStatus - Text for the Status column
+ */
+void FormatHostStatus(const HostStatus* status, wchar_t* text, size_t textLen)
+{
+    if (status->state == HOST_STATUS_UP)
+        swprintf_s(text, textLen, L"Up (%.0f ms)", status->rttMs);
+    else if (status->state == HOST_STATUS_DOWN)
+        swprintf_s(text, textLen, L"Down (%s)", DescribeProbeError(status->error));
+    else if (textLen > 0)
+        text[0] = L'\0';
+}
+
+/*
+ * AcknowledgeMonitorUpdate - Allow the next WM_MONITOR_UPDATE
+ */
+void AcknowledgeMonitorUpdate(void)
+{
+    InterlockedExchange(&g_notifyPending, 0);
+}
@@ -0,0 +1,72 @@
+/*
+ * Host Monitor Header
+ *
+ * Keeps the Status column of the main list up to date without anyone
+ * asking: while the main dialog is open, a background thread probes the
+ * hosts on a schedule (see probe.h) and publishes the newest status of
+ * each in a snapshot that the list reads as it paints, without a lock.
+ *
+ * Hosts on screen and the most recently connected ones are checked most
+ * often, the rest rarely, and a host that stays down is checked less and
+ * less often. All of it stays within a packets-per-second budget.
+ */
+
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include <windows.h>
+#include "hosts.h"
+
+// Most rows SetMonitorVisible takes
+#define MONITOR_MAX_VISIBLE     128
+
+// Most recently connected hosts that are checked as often as visible ones
+#define MONITOR_RECENT_COUNT    10
+
+// Schedule (milliseconds)
+#define MONITOR_TICK_MS         1000        // How often the thread looks for due hosts
+#define MONITOR_HOT_INTERVAL_MS 15000       // Visible and recent hosts
+#define MONITOR_COLD_INTERVAL_MS 300000     // All others
+#define MONITOR_MAX_BACKOFF_MS  1800000     // Longest interval for a host that stays down
+
+// Packets one probe is counted as (SYN, SYN-ACK, ACK and the close)
+#define MONITOR_PACKETS_PER_PROBE 4
+
+typedef enum {
+    HOST_STATUS_UNKNOWN,        // Not probed yet
+    HOST_STATUS_UP,             // Accepted a connection on its RDP port
+    HOST_STATUS_DOWN            // Did not (see error)
+} HostState;
+
+// Newest status of one host
+typedef struct {
+    HostState state;
+    DWORD error;                // Winsock error when down
+    float rttMs;                // Connect time when up
+    int failures;               // Probes in a row that failed
+    ULONGLONG checkedAt;        // GetTickCount64 of the last probe
+} HostStatus;
+
+// Start monitoring; hwndNotify gets WM_MONITOR_UPDATE after rounds that changed a status
+// Returns FALSE if the thread could not start (or the HostMonitor setting is 0)
+BOOL StartHostMonitor(HWND hwndNotify);
+
+// Stop the thread (the last statuses stay readable)
+void StopHostMonitor(void);
+
+// Hosts to monitor (names copied; the most recent ones are checked often)
+void SetMonitorHosts(const Host* hosts, int hostCount);
+
+// Hosts on screen (checked as often as the recent ones)
+void SetMonitorVisible(const wchar_t* const* hostnames, int count);
+
+// Newest status of a host without blocking; FALSE if it has not been probed
+BOOL GetHostStatus(const wchar_t* hostname, HostStatus* status);
+
+// Short text for the Status column ("Up (12 ms)", "Down (no answer)", "" if unknown)
+void FormatHostStatus(const HostStatus* status, wchar_t* text, size_t textLen);
+
+// Call when WM_MONITOR_UPDATE has been handled, so the next one can be posted
+void AcknowledgeMonitorUpdate(void);
+
+#endif // MONITOR_H
@@ -0,0 +1,120 @@
+/*
+ * RDP Negotiation Module
+ *
+ * What mstsc sends first is an X.224 Connection Request (in a TPKT
+ * header) with an RDP Negotiation Request offering TLS and CredSSP. An
+ * RDP server answers with a Connection Confirm holding either the
+ * protocol it selected or a Negotiation Failure; a server older than TLS
+ * support sends the confirm without either. Anything else is not an RDP
+ * server.
+ *
+ * The reply can arrive in pieces, so the parser is given everything
+ * received so far and says whether it needs more. It looks no further
+ * than the lengths and codes it checks, and never past `length`.
+ *
+ * Learning points:
+ *   - Parsing a binary protocol header (TPKT, X.224, RDP negotiation)
+ *   - Big-endian and little-endian fields in one message
+ *   - Keeping protocol parsing apart from the I/O, so it can be tested alone
+ */
+
+#include <windows.h>
+#include "negotiation.h"
+
+// X.224 Connection Request with an RDP Negotiation Request ([MS-RDPBCGR] 2.2.1.1)
+static const BYTE g_negotiationRequest[] = {
+    0x03, 0x00, 0x00, 0x13,                     // TPKT: version 3, 19 bytes in all
+    0x0E, 0xE0, 0x00, 0x00, 0x00, 0x00, 0x00,   // X.224 CR: 14 more bytes, no references, class 0
+    0x01, 0x00, 0x08, 0x00,                     // RDP_NEG_REQ: no flags, 8 bytes
+    0x0B, 0x00, 0x00, 0x00                      // Offer TLS, CredSSP and CredSSP with early auth
+};
+
+/*
+ * GetRdpNegotiationRequest - The Connection Request the probe sends
+ */
+const BYTE* GetRdpNegotiationRequest(int* length)
+{
+    *length = (int)sizeof(g_negotiationRequest);
+    return g_negotiationRequest;
+}
+
+/*
+ * ParseRdpNegotiationReply - Read an X.224 Connection Confirm
+ *
+ * Parameters:
+ *   reply  - Bytes received so far
+ *   length - Number of bytes
+ *   value  - Receives the selected protocol (RDP_REPLY_SELECTED) or the
+ *            failure code (RDP_REPLY_FAILED); 0 otherwise
+ *
+ * Returns:
+ *   RDP_REPLY_INCOMPLETE until the whole packet is there, then what it says.
+ *   A header that cannot start a Connection Confirm is RDP_REPLY_NOT_RDP
+ *   as soon as its first four bytes are in.
+ */
+RdpReplyStatus ParseRdpNegotiationReply(const BYTE* reply, int length, DWORD* value)
+{
+    *value = 0;
+    if (length < 4)
+        return RDP_REPLY_INCOMPLETE;
+
+    // TPKT: version 3, reserved, 16-bit big-endian length of the whole packet
+    int packetLength = (reply[2] << 8) | reply[3];
+    if (reply[0] != 0x03 || packetLength < 11 || packetLength > RDP_REPLY_MAX)
+        return RDP_REPLY_NOT_RDP;
+    if (length < packetLength)
+        return RDP_REPLY_INCOMPLETE;
+
+    // X.224: length indicator (bytes after itself), then the Connection Confirm code
+    if (reply[4] != packetLength - 5 || (reply[5] & 0xF0) != 0xD0)
+        return RDP_REPLY_NOT_RDP;
+
+    // A confirm without negotiation data selects standard RDP security
+    if (packetLength < 19)
+        return RDP_REPLY_SELECTED;
+
+    // RDP_NEG_RSP (2) or RDP_NEG_FAILURE (3): type, flags, 16-bit length, 32-bit value (little-endian)
+    const BYTE* negotiation = reply + 11;
+    DWORD field = negotiation[4] | (negotiation[5] << 8) | (negotiation[6] << 16) | ((DWORD)negotiation[7] << 24);
+
+    if (negotiation[0] == 0x02)
+    {
+        *value = field;
+        return RDP_REPLY_SELECTED;
+    }
+    if (negotiation[0] == 0x03)
+    {
+        *value = field;
+        return RDP_REPLY_FAILED;
+    }
+    return RDP_REPLY_SELECTED;
+}
+
+/*
+ * ReadRdpNegotiationReply - Record what the reply received so far says
+ *
+ * Returns FALSE if more bytes are needed, TRUE once rdp is filled in: a
+ * confirm sets answered (and refused for a Negotiation Failure), anything
+ * else sets error to ERROR_INVALID_DATA.
+ */
+BOOL ReadRdpNegotiationReply(const BYTE* reply, int length, RdpNegotiation* rdp)
+{
+    DWORD value;
+
+    switch (ParseRdpNegotiationReply(reply, length, &value))
+    {
+        case RDP_REPLY_INCOMPLETE:
+            return FALSE;
+        case RDP_REPLY_NOT_RDP:
+            rdp->error = ERROR_INVALID_DATA;
+            return TRUE;
+        case RDP_REPLY_FAILED:
+            rdp->refused = TRUE;
+            break;
+        default:
+            break;
+    }
+    rdp->answered = TRUE;
+    rdp->protocol = value;
+    return TRUE;
+}
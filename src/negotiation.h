@@ -0,0 +1,55 @@
+/*
+ * RDP Negotiation Header
+ *
+ * The first two messages of an RDP connection ([MS-RDPBCGR] 2.2.1.1 and
+ * 2.2.1.2): the X.224 Connection Request with an RDP Negotiation Request
+ * that the probe sends, and the server's Connection Confirm that comes
+ * back, and what the probe makes of it. Only bytes in and out - no
+ * sockets - so the probe engines share it and the tests can feed it
+ * canned replies.
+ */
+
+#ifndef NEGOTIATION_H
+#define NEGOTIATION_H
+
+#include <windows.h>
+
+// Largest negotiation reply accepted (a Connection Confirm is 11 or 19 bytes)
+#define RDP_REPLY_MAX           32
+
+// Security protocols in an RDP Negotiation Response ([MS-RDPBCGR] 2.2.1.2.1)
+#define RDP_PROTOCOL_RDP        0x00000000  // Standard RDP security (no TLS)
+#define RDP_PROTOCOL_SSL        0x00000001  // TLS
+#define RDP_PROTOCOL_HYBRID     0x00000002  // CredSSP (NLA)
+#define RDP_PROTOCOL_RDSTLS     0x00000004  // RDSTLS
+#define RDP_PROTOCOL_HYBRID_EX  0x00000008  // CredSSP with early user authorization
+
+// What the bytes received so far say
+typedef enum {
+    RDP_REPLY_INCOMPLETE,       // Nothing yet: more bytes are needed
+    RDP_REPLY_SELECTED,         // A Connection Confirm; the value is the selected RDP_PROTOCOL_*
+    RDP_REPLY_FAILED,           // A Connection Confirm with a Negotiation Failure; the value is its code
+    RDP_REPLY_NOT_RDP           // Not an X.224 Connection Confirm
+} RdpReplyStatus;
+
+// Outcome of the RDP negotiation that follows a successful connect
+typedef struct {
+    BOOL attempted;             // The request was sent (negotiation on and the connect succeeded)
+    BOOL answered;              // An X.224 Connection Confirm came back: an RDP server listens
+    BOOL refused;               // ... carrying an RDP Negotiation Failure instead of a response
+    DWORD protocol;             // Selected RDP_PROTOCOL_* (the failure code when refused)
+    DWORD error;                // Why nothing was confirmed: WSAETIMEDOUT, WSAECONNRESET,
+                                //   ERROR_INVALID_DATA (the reply was not RDP), ...
+    double handshakeMs;         // From sending the request to the complete confirm
+} RdpNegotiation;
+
+// The Connection Request to send (offering TLS and CredSSP); *length receives its size
+const BYTE* GetRdpNegotiationRequest(int* length);
+
+// Read a reply; value receives the protocol or failure code (0 otherwise)
+RdpReplyStatus ParseRdpNegotiationReply(const BYTE* reply, int length, DWORD* value);
+
+// Record what a reply says in rdp; FALSE while more bytes are needed
+BOOL ReadRdpNegotiationReply(const BYTE* reply, int length, RdpNegotiation* rdp);
+
+#endif // NEGOTIATION_H
@@ -0,0 +1,253 @@
+/*
+ * Performance Statistics Module
+ *
+ * Each stage keeps the last PERF_WINDOW_SAMPLES durations in a ring
+ * buffer plus a histogram of the same samples. Adding a sample bumps one
+ * bucket and, once the ring is full, takes the oldest sample's bucket
+ * back down - so the histogram always describes exactly the current
+ * window and recording costs the same no matter how long the app runs.
+ *
+ * Buckets grow geometrically (8 per doubling, about 9% wide), which keeps
+ * the relative error of a percentile the same for 50 microsecond paints
+ * and 2 second searches. A percentile is read by walking the counts until
+ * the wanted rank is reached and reporting that bucket's upper edge.
+ *
+ * Learning points:
+ *   - Ring buffers for sliding windows
+ *   - Log-scale histograms (the idea behind HdrHistogram)
+ *   - Writing JSON by hand and converting to UTF-8 for the file
+ */
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "perfstats.h"
+
+typedef struct {
+    float samples[PERF_WINDOW_SAMPLES];     // Milliseconds, ring buffer
+    BYTE sampleBucket[PERF_WINDOW_SAMPLES]; // Bucket of each sample (to remove it later)
+    int next;                               // Ring position of the next sample
+    int count;                              // Samples in the window
+    int buckets[PERF_BUCKETS];
+    ULONGLONG totalSamples;
+} PerfSeries;
+
+static PerfSeries g_perfSeries[PERF_STAGE_COUNT];
+
+static const wchar_t* g_perfStageNames[PERF_STAGE_COUNT] = {
+    L"search_queue",
+    L"search_filter",
+    L"list_populate",
+    L"count_label",
+    L"list_paint",
+    L"key_to_paint",
+    L"import_diff",
+    L"connect"
+};
+
+/*
+ * BucketForMs - Histogram bucket of a duration
+ *
+ * Bucket 0 is everything under 1 microsecond; bucket b covers
+ * [2^((b-1)/8), 2^(b/8)) microseconds.
+ */
+static int BucketForMs(double ms)
+{
+    double us = ms * 1000.0;
+    if (us < 1.0)
+        return 0;
+
+    int bucket = (int)(log2(us) * PERF_BUCKETS_PER_DOUBLING) + 1;
+    return (bucket < PERF_BUCKETS) ? bucket : PERF_BUCKETS - 1;
+}
+
+/*
+ * BucketUpperMs - Upper edge of a bucket in milliseconds
+ */
+static double BucketUpperMs(int bucket)
+{
+    return pow(2.0, (double)bucket / PERF_BUCKETS_PER_DOUBLING) / 1000.0;
+}
+
+/*
+ * RecordPerfSample - Add one measured duration to a stage
+ *
+ * Parameters:
+ *   stage - Stage measured
+ *   ms    - Duration in milliseconds
+ */
+void RecordPerfSample(PerfStage stage, double ms)
+{
+    if (stage < 0 || stage >= PERF_STAGE_COUNT || ms < 0.0)
+        return;
+
+    PerfSeries* series = &g_perfSeries[stage];
+
+    // Window full - the oldest sample leaves the histogram
+    if (series->count == PERF_WINDOW_SAMPLES)
+        series->buckets[series->sampleBucket[series->next]]--;
+    else
+        series->count++;
+
+    int bucket = BucketForMs(ms);
+    series->samples[series->next] = (float)ms;
+    series->sampleBucket[series->next] = (BYTE)bucket;
+    series->buckets[bucket]++;
+    series->totalSamples++;
+    series->next = (series->next + 1) % PERF_WINDOW_SAMPLES;
+}
+
+/*
+ * PercentileMs - Upper edge of the bucket holding the given fraction of samples
+ */
+static double PercentileMs(const PerfSeries* series, double fraction)
+{
+    int rank = (int)ceil(fraction * series->count);
+    int seen = 0;
+
+    if (rank < 1)
+        rank = 1;
+
+    for (int b = 0; b < PERF_BUCKETS; b++)
+    {
+        seen += series->buckets[b];
+        if (seen >= rank)
+            return BucketUpperMs(b);
+    }
+    return BucketUpperMs(PERF_BUCKETS - 1);
+}
+
+/*
+ * GetPerfSummary - Percentiles of a stage over the current window
+ */
+void GetPerfSummary(PerfStage stage, PerfSummary* summary)
+{
+    memset(summary, 0, sizeof(PerfSummary));
+    if (stage < 0 || stage >= PERF_STAGE_COUNT)
+        return;
+
+    const PerfSeries* series = &g_perfSeries[stage];
+    summary->samples = series->count;
+    summary->totalSamples = series->totalSamples;
+    if (series->count == 0)
+        return;
+
+    // Mean and max are exact (computed from the ring, not the buckets)
+    double sum = 0.0;
+    for (int i = 0; i < series->count; i++)
+    {
+        sum += series->samples[i];
+        if (series->samples[i] > summary->maxMs)
+            summary->maxMs = series->samples[i];
+    }
+    summary->meanMs = sum / series->count;
+    summary->p50Ms = PercentileMs(series, 0.50);
+    summary->p90Ms = PercentileMs(series, 0.90);
+    summary->p99Ms = PercentileMs(series, 0.99);
+
+    // A bucket edge can overshoot the largest sample
+    if (summary->p50Ms > summary->maxMs) summary->p50Ms = summary->maxMs;
+    if (summary->p90Ms > summary->maxMs) summary->p90Ms = summary->maxMs;
+    if (summary->p99Ms > summary->maxMs) summary->p99Ms = summary->maxMs;
+}
+
+/*
+ * GetPerfStageName - Short name of a stage (also used as the JSON key)
+ */
+const wchar_t* GetPerfStageName(PerfStage stage)
+{
+    if (stage < 0 || stage >= PERF_STAGE_COUNT)
+        return L"unknown";
+    return g_perfStageNames[stage];
+}
+
+/*
+ * ResetPerfStats - Forget every sample
+ */
+void ResetPerfStats(void)
+{
+    memset(g_perfSeries, 0, sizeof(g_perfSeries));
+}
+
+/*
+ * SavePerfStatsJson - Dump every stage as JSON
+ *
+ * Parameters:
+ *   path - File to write (replaced if it exists)
+ *
+ * Returns:
+ *   TRUE on success, FALSE on failure
+ *
+ * Format:
+ *   { "window": 1024, "stages": { "list_paint": { "samples": ..., "p99_ms": ...,
+ *     "buckets": [ { "le_ms": 0.0841, "count": 12 }, ... ] }, ... } }
+ */
+BOOL SavePerfStatsJson(const wchar_t* path)
+{
+    // Worst case: every bucket of every stage is non-empty
+    size_t capacity = 1024 + (size_t)PERF_STAGE_COUNT * (512 + PERF_BUCKETS * 48);
+    wchar_t* json = (wchar_t*)malloc(capacity * sizeof(wchar_t));
+    if (json == NULL)
+        return FALSE;
+
+    size_t length = 0;
+    length += swprintf_s(json + length, capacity - length,
+                         L"{\n  \"window\": %d,\n  \"stages\": {\n", PERF_WINDOW_SAMPLES);
+
+    for (int stage = 0; stage < PERF_STAGE_COUNT; stage++)
+    {
+        PerfSummary summary;
+        GetPerfSummary((PerfStage)stage, &summary);
+
+        length += swprintf_s(json + length, capacity - length,
+                             L"    \"%s\": {\n"
+                             L"      \"samples\": %d,\n"
+                             L"      \"total_samples\": %llu,\n"
+                             L"      \"mean_ms\": %.4f,\n"
+                             L"      \"p50_ms\": %.4f,\n"
+                             L"      \"p90_ms\": %.4f,\n"
+                             L"      \"p99_ms\": %.4f,\n"
+                             L"      \"max_ms\": %.4f,\n"
+                             L"      \"buckets\": [",
+                             GetPerfStageName((PerfStage)stage), summary.samples, summary.totalSamples,
+                             summary.meanMs, summary.p50Ms, summary.p90Ms, summary.p99Ms, summary.maxMs);
+
+        BOOL first = TRUE;
+        for (int b = 0; b < PERF_BUCKETS; b++)
+        {
+            int count = g_perfSeries[stage].buckets[b];
+            if (count == 0)
+                continue;
+            length += swprintf_s(json + length, capacity - length, L"%s{ \"le_ms\": %.4f, \"count\": %d }",
+                                 first ? L"" : L", ", BucketUpperMs(b), count);
+            first = FALSE;
+        }
+
+        length += swprintf_s(json + length, capacity - length, L"]\n    }%s\n",
+                             (stage + 1 < PERF_STAGE_COUNT) ? L"," : L"");
+    }
+    length += swprintf_s(json + length, capacity - length, L"  }\n}\n");
+
+    // Files are written as UTF-8
+    int utf8Length = WideCharToMultiByte(CP_UTF8, 0, json, (int)length, NULL, 0, NULL, NULL);
+    char* utf8 = (char*)malloc(utf8Length > 0 ? utf8Length : 1);
+    BOOL result = FALSE;
+
+    if (utf8 != NULL)
+    {
+        WideCharToMultiByte(CP_UTF8, 0, json, (int)length, utf8, utf8Length, NULL, NULL);
+
+        FILE* file = NULL;
+        if (_wfopen_s(&file, path, L"wb") == 0 && file != NULL)
+        {
+            result = (fwrite(utf8, 1, utf8Length, file) == (size_t)utf8Length);
+            fclose(file);
+        }
+        free(utf8);
+    }
+
+    free(json);
+    return result;
+}
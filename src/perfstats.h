@@ -0,0 +1,57 @@
+/*
+ * Performance Statistics Header
+ *
+ * Rolling latency histograms for the interactive paths of the UI. Code
+ * measures a span with GetSearchTicks()/SearchTicksToMs() and records the
+ * duration here; the diagnostics dialog shows percentiles per stage and
+ * can dump everything as JSON.
+ *
+ * Recording is meant for the UI thread only (workers hand their timings
+ * back in their results, as SearchResult does).
+ */
+
+#ifndef PERFSTATS_H
+#define PERFSTATS_H
+
+#include <windows.h>
+
+// Samples each histogram covers (older samples roll out)
+#define PERF_WINDOW_SAMPLES     1024
+
+// Log-scale buckets: 8 per doubling, from 1 microsecond to about a minute
+#define PERF_BUCKETS_PER_DOUBLING 8
+#define PERF_BUCKETS            128
+
+// Measured stages
+typedef enum {
+    PERF_SEARCH_QUEUE = 0,      // Keystroke to worker pick-up (includes the debounce delay)
+    PERF_SEARCH_FILTER,         // Query evaluation on the worker
+    PERF_LIST_POPULATE,         // Ordering the matches and filling the ListView
+    PERF_COUNT_LABEL,           // UpdateHostCountLabel
+    PERF_LIST_PAINT,            // One custom-draw pass of the main list (prepaint to postpaint)
+    PERF_KEY_TO_PAINT,          // Keystroke to the repainted list
+    PERF_IMPORT_DIFF,           // Comparing scan results with the saved hosts (DiffHosts)
+    PERF_CONNECT,               // Asking to connect until mstsc has started (launcher thread)
+    PERF_STAGE_COUNT
+} PerfStage;
+
+// Percentiles of one stage over the current window
+typedef struct {
+    int samples;                // Samples in the window
+    ULONGLONG totalSamples;     // Samples ever recorded
+    double meanMs;
+    double p50Ms;
+    double p90Ms;
+    double p99Ms;
+    double maxMs;
+} PerfSummary;
+
+void RecordPerfSample(PerfStage stage, double ms);
+void GetPerfSummary(PerfStage stage, PerfSummary* summary);
+const wchar_t* GetPerfStageName(PerfStage stage);
+void ResetPerfStats(void);
+
+// Write all stages (summary and non-empty buckets) as JSON (UTF-8)
+BOOL SavePerfStatsJson(const wchar_t* path);
+
+#endif // PERFSTATS_H
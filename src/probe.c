@@ -0,0 +1,518 @@
+/*
+ * Reachability Probe Module
+ *
+ * A host is "reachable" when a TCP connection to its RDP port completes.
+ * The TCP handshake alone shows that something listens, and its time is a
+ * fair round-trip estimate.
+ *
+ * With negotiation on, the probe then sends what mstsc sends first: an
+ * X.224 Connection Request with an RDP Negotiation Request, and reads the
+ * Connection Confirm (see negotiation.c). The probe stops there, before
+ * TLS, so no credentials are involved and the server logs at most a
+ * dropped connection.
+ *
+ * Probing thousands of hosts one blocking connect() at a time would take
+ * hours when many are down (each waits for its timeout), and a thread per
+ * host would not scale. Instead ProbeHosts resolves every name first
+ * (concurrently and through the cache, see resolver.c), then hands the
+ * addresses to RunProbeEngine (probeengine.c), which keeps up to
+ * `concurrency` overlapped connects in flight on one thread. Lookups
+ * block, and a slow one in the middle of the connect loop would delay
+ * reading other probes' completions - adding its time to their
+ * round-trip times.
+ *
+ * Results go into a table keyed by hostname (case-insensitive, newest
+ * result wins) behind a slim reader/writer lock, so the UI can read
+ * results while a background probe writes them. Connect times are also
+ * added to the host's latency history (see latency.c).
+ *
+ * Learning points:
+ *   - Resolving up front so lookups do not skew connect times
+ *   - Driving a callback-based engine from a table of targets
+ *   - SRW locks for read-mostly shared data
+ */
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "resource.h"
+#include "probe.h"
+#include "resolver.h"
+#include "latency.h"
+
+// What ProbeHosts passes to the engine callbacks
+typedef struct {
+    const wchar_t* const* hostnames;
+    ProbeTarget* targets;       // Resolved before the first connect
+    int resolved;               // Targets ready for the engine
+    int next;                   // Next target to hand to the engine
+    ProbeResult* results;
+} HostProbeContext;
+
+struct ProbeJob {
+    wchar_t (*names)[MAX_HOSTNAME_LEN];
+    const wchar_t** hostnames;
+    ProbeResult* results;
+    int count;
+    ProbeOptions options;
+    HWND hwndNotify;
+    HANDLE thread;
+    volatile LONG cancel;
+};
+
+// Newest result per host (open addressing, empty slot = empty hostname)
+static SRWLOCK g_resultsLock = SRWLOCK_INIT;
+static ProbeResult* g_results = NULL;
+static int g_resultCount = 0;
+static int g_resultCapacity = 0;    // Power of two
+
+/*
+ * FindResultSlot - Slot holding hostname, or the empty slot where it would go
+ *
+ * Must be called with the results lock held and a non-empty table.
+ */
+static int FindResultSlot(const wchar_t* hostname)
+{
+    int slot = (int)(HashHostKey(hostname) & (ULONGLONG)(g_resultCapacity - 1));
+    while (g_results[slot].hostname[0] != L'\0' && _wcsicmp(g_results[slot].hostname, hostname) != 0)
+        slot = (slot + 1) & (g_resultCapacity - 1);
+    return slot;
+}
+
+/*
+ * StoreProbeResult - Add or replace a host's stored result
+ */
+static void StoreProbeResult(const ProbeResult* result)
+{
+    if (result->hostname[0] == L'\0')
+        return;
+
+    AcquireSRWLockExclusive(&g_resultsLock);
+
+    // Keep the table at most half full
+    if ((g_resultCount + 1) * 2 > g_resultCapacity)
+    {
+        int newCapacity = (g_resultCapacity > 0) ? g_resultCapacity * 2 : 256;
+        ProbeResult* newResults = (ProbeResult*)calloc(newCapacity, sizeof(ProbeResult));
+        if (newResults == NULL)
+        {
+            ReleaseSRWLockExclusive(&g_resultsLock);
+            return;
+        }
+
+        ProbeResult* oldResults = g_results;
+        int oldCapacity = g_resultCapacity;
+        g_results = newResults;
+        g_resultCapacity = newCapacity;
+        for (int i = 0; i < oldCapacity; i++)
+        {
+            if (oldResults[i].hostname[0] != L'\0')
+                g_results[FindResultSlot(oldResults[i].hostname)] = oldResults[i];
+        }
+        free(oldResults);
+    }
+
+    int slot = FindResultSlot(result->hostname);
+    if (g_results[slot].hostname[0] == L'\0')
+        g_resultCount++;
+    g_results[slot] = *result;
+
+    ReleaseSRWLockExclusive(&g_resultsLock);
+}
+
+/*
+ * GetProbeResult - Newest stored result for a host
+ *
+ * Returns:
+ *   TRUE if the host has been probed (result filled), FALSE otherwise
+ */
+BOOL GetProbeResult(const wchar_t* hostname, ProbeResult* result)
+{
+    BOOL found = FALSE;
+
+    AcquireSRWLockShared(&g_resultsLock);
+    if (g_resultCount > 0 && hostname != NULL && hostname[0] != L'\0')
+    {
+        int slot = FindResultSlot(hostname);
+        if (g_results[slot].hostname[0] != L'\0')
+        {
+            *result = g_results[slot];
+            found = TRUE;
+        }
+    }
+    ReleaseSRWLockShared(&g_resultsLock);
+
+    return found;
+}
+
+/*
+ * ClearProbeResults - Forget every stored result
+ */
+void ClearProbeResults(void)
+{
+    AcquireSRWLockExclusive(&g_resultsLock);
+    free(g_results);
+    g_results = NULL;
+    g_resultCount = 0;
+    g_resultCapacity = 0;
+    ReleaseSRWLockExclusive(&g_resultsLock);
+}
+
+/*
+ * DescribeProbeError - Short text for a probe error
+ */
+const wchar_t* DescribeProbeError(DWORD error)
+{
+    switch (error)
+    {
+        case 0:                     return L"reachable";
+        case WSAETIMEDOUT:          return L"no answer";
+        case WSAECONNREFUSED:       return L"refused";
+        case WSAENETUNREACH:
+        case WSAEHOSTUNREACH:       return L"unreachable";
+        case WSAHOST_NOT_FOUND:
+        case WSANO_DATA:            return L"name not found";
+        case WSATRY_AGAIN:          return L"name lookup failed";
+        case WSA_OPERATION_ABORTED: return L"cancelled";
+        default:                    return L"error";
+    }
+}
+
+/*
+ * DescribeRdpNegotiation - Short text for a negotiation outcome
+ */
+const wchar_t* DescribeRdpNegotiation(const RdpNegotiation* rdp)
+{
+    if (!rdp->attempted)
+        return L"not checked";
+
+    if (!rdp->answered)
+    {
+        switch (rdp->error)
+        {
+            case ERROR_INVALID_DATA:    return L"not an RDP server";
+            case WSAETIMEDOUT:          return L"no RDP reply";
+            case WSA_OPERATION_ABORTED: return L"cancelled";
+            default:                    return L"closed without an RDP reply";
+        }
+    }
+
+    // Failure codes ([MS-RDPBCGR] 2.2.1.2.2)
+    if (rdp->refused)
+    {
+        switch (rdp->protocol)
+        {
+            case 1:  return L"refused: server requires TLS";
+            case 2:  return L"refused: server does not allow TLS";
+            case 3:  return L"refused: no certificate on the server";
+            case 5:  return L"refused: server requires NLA";
+            case 6:  return L"refused: server requires TLS with user authentication";
+            default: return L"refused the negotiation";
+        }
+    }
+
+    if (rdp->protocol & RDP_PROTOCOL_HYBRID_EX)
+        return L"NLA (CredSSP, early user authorization)";
+    if (rdp->protocol & RDP_PROTOCOL_HYBRID)
+        return L"NLA (CredSSP)";
+    if (rdp->protocol & RDP_PROTOCOL_RDSTLS)
+        return L"RDSTLS";
+    if (rdp->protocol & RDP_PROTOCOL_SSL)
+        return L"TLS";
+    return L"standard RDP security (no TLS)";
+}
+
+/*
+ * FillProbeTarget - Connect target for a resolved name
+ *
+ * The first address is tried (IPv4 before IPv6, see resolver.c).
+ */
+static void FillProbeTarget(const ResolvedName* answer, USHORT port, ProbeTarget* target)
+{
+    memset(target, 0, sizeof(ProbeTarget));
+    target->port = port;
+    if (answer->error != 0 || answer->addressCount == 0)
+    {
+        target->error = (answer->error != 0) ? answer->error : WSAHOST_NOT_FOUND;
+        return;
+    }
+
+    const ResolvedAddress* address = &answer->addresses[0];
+    if (((const SOCKADDR*)address->address)->sa_family == AF_INET6)
+    {
+        SOCKADDR_IN6 address6;
+        memcpy(&address6, address->address, sizeof(address6));
+        address6.sin6_port = htons(port);
+        memcpy(target->address, &address6, sizeof(address6));
+        target->addressLength = sizeof(address6);
+    }
+    else
+    {
+        SOCKADDR_IN address4;
+        memcpy(&address4, address->address, sizeof(address4));
+        address4.sin_port = htons(port);
+        memcpy(target->address, &address4, sizeof(address4));
+        target->addressLength = sizeof(address4);
+    }
+}
+
+/*
+ * FillProbeResult - Set the fields every result has
+ */
+static void FillProbeResult(ProbeResult* result, const wchar_t* hostname, USHORT port,
+                            BOOL reachable, DWORD error, double rttMs, const RdpNegotiation* rdp)
+{
+    wcsncpy_s(result->hostname, MAX_HOSTNAME_LEN, hostname, _TRUNCATE);
+    result->port = port;
+    result->reachable = reachable;
+    result->error = reachable ? 0 : error;
+    result->rttMs = reachable ? rttMs : 0.0;
+    GetSystemTimeAsFileTime(&result->checkedAt);
+    if (rdp != NULL)
+        result->rdp = *rdp;
+    else
+        memset(&result->rdp, 0, sizeof(RdpNegotiation));
+}
+
+/*
+ * NextHostTarget - Engine callback: hand out the resolved hosts in order
+ */
+static BOOL NextHostTarget(void* context, ProbeTarget* target)
+{
+    HostProbeContext* hostContext = (HostProbeContext*)context;
+    if (hostContext->next >= hostContext->resolved)
+        return FALSE;
+
+    *target = hostContext->targets[hostContext->next++];
+    return TRUE;
+}
+
+/*
+ * HostProbeDone - Engine callback: record a host's result
+ */
+static void HostProbeDone(void* context, const ProbeTarget* target, BOOL reachable, DWORD error, double rttMs,
+                          const RdpNegotiation* rdp)
+{
+    HostProbeContext* hostContext = (HostProbeContext*)context;
+    ProbeResult* result = &hostContext->results[target->index];
+
+    FillProbeResult(result, hostContext->hostnames[target->index], target->port, reachable, error, rttMs, rdp);
+
+    // A cancelled probe measured nothing
+    if (error != WSA_OPERATION_ABORTED)
+        StoreProbeResult(result);
+    if (reachable)
+        RecordHostLatency(result->hostname, rttMs);
+}
+
+/*
+ * ProbeHosts - Check which hosts accept connections on their RDP port
+ *
+ * Parameters:
+ *   hostnames - Hosts as written in the host list (":port" overrides the port)
+ *   count     - Number of hosts
+ *   options   - Port, concurrency, timeout and negotiation (NULL = defaults)
+ *   results   - Array of count results, filled in the order of hostnames
+ *   cancel    - Optional; when it becomes non-zero, probes in flight are
+ *               abandoned and the rest are not started
+ *
+ * Returns:
+ *   TRUE when every host has a result (cancelled hosts get
+ *        WSA_OPERATION_ABORTED and are not stored)
+ *   FALSE if Winsock or the completion port could not be set up, or out
+ *         of memory
+ *
+ * Each finished probe is also stored for GetProbeResult.
+ */
+BOOL ProbeHosts(const wchar_t* const* hostnames, int count, const ProbeOptions* options,
+                ProbeResult* results, volatile LONG* cancel)
+{
+    WSADATA wsaData;
+    USHORT defaultPort = (options != NULL && options->defaultPort != 0) ? options->defaultPort : RDP_DEFAULT_PORT;
+    int concurrency = (options != NULL && options->concurrency > 0) ? options->concurrency : PROBE_CONCURRENCY;
+    DWORD timeoutMs = (options != NULL && options->timeoutMs > 0) ? options->timeoutMs : PROBE_TIMEOUT_MS;
+
+    if (count <= 0)
+        return TRUE;
+
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+        return FALSE;
+
+    HostProbeContext context = {0};
+    context.hostnames = hostnames;
+    context.results = results;
+    context.targets = (ProbeTarget*)malloc(sizeof(ProbeTarget) * count);
+    if (context.targets == NULL)
+    {
+        WSACleanup();
+        return FALSE;
+    }
+
+    // Unprobed hosts read as cancelled until their probe finishes
+    for (int i = 0; i < count; i++)
+        FillProbeResult(&results[i], hostnames[i], defaultPort, FALSE, WSA_OPERATION_ABORTED, 0.0, NULL);
+
+    // Resolve everything before the first connect, many names at once
+    wchar_t (*hosts)[MAX_HOSTNAME_LEN] = calloc(count, sizeof(*hosts));
+    const wchar_t** hostPointers = (const wchar_t**)malloc(sizeof(wchar_t*) * count);
+    USHORT* ports = (USHORT*)malloc(sizeof(USHORT) * count);
+    ResolvedName* answers = (ResolvedName*)malloc(sizeof(ResolvedName) * count);
+    BOOL resolved = (hosts != NULL && hostPointers != NULL && ports != NULL && answers != NULL);
+    if (resolved)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            ports[i] = SplitHostPort(hostnames[i], defaultPort, hosts[i], MAX_HOSTNAME_LEN);
+            hostPointers[i] = hosts[i];
+        }
+        resolved = ResolveNames(hostPointers, count, 0, answers, cancel);
+    }
+    if (resolved)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            FillProbeTarget(&answers[i], ports[i], &context.targets[i]);
+            if (ports[i] == 0)
+                context.targets[i].error = WSAHOST_NOT_FOUND;
+            context.targets[i].index = i;
+        }
+        context.resolved = count;
+    }
+    free(answers);
+    free(ports);
+    free(hostPointers);
+    free(hosts);
+    if (!resolved)
+    {
+        free(context.targets);
+        WSACleanup();
+        return FALSE;
+    }
+
+    ProbeEngine engine = {0};
+    engine.next = NextHostTarget;
+    engine.done = HostProbeDone;
+    engine.context = &context;
+    engine.maxWindow = (concurrency < count) ? concurrency : count;
+    engine.window = engine.maxWindow;
+    engine.timeoutMs = timeoutMs;
+    engine.negotiate = (options != NULL && options->negotiate);
+    engine.cancel = cancel;
+
+    BOOL result = RunProbeEngine(&engine);
+
+    free(context.targets);
+    WSACleanup();
+    return result;
+}
+
+/*
+ * ProbeJobThread - Run a probe job and tell the window how it went
+ */
+static DWORD WINAPI ProbeJobThread(LPVOID param)
+{
+    ProbeJob* job = (ProbeJob*)param;
+    int reachable = 0;
+
+    if (ProbeHosts(job->hostnames, job->count, &job->options, job->results, &job->cancel))
+    {
+        for (int i = 0; i < job->count; i++)
+        {
+            if (job->results[i].reachable)
+                reachable++;
+        }
+    }
+
+    if (job->cancel == 0 && job->hwndNotify != NULL)
+        PostMessage(job->hwndNotify, WM_PROBE_COMPLETE, (WPARAM)reachable, (LPARAM)job->count);
+    return 0;
+}
+
+/*
+ * StartProbeJob - Probe hosts on a background thread
+ *
+ * Parameters:
+ *   hostnames  - Hosts to probe (copied)
+ *   count      - Number of hosts
+ *   options    - Port, concurrency and timeout (NULL = defaults)
+ *   hwndNotify - Receives WM_PROBE_COMPLETE (wParam = reachable, lParam = probed)
+ *
+ * Returns:
+ *   The job (free with FreeProbeJob), or NULL if it could not start
+ *
+ * Read the outcome with GetProbeResult.
+ */
+ProbeJob* StartProbeJob(const wchar_t* const* hostnames, int count, const ProbeOptions* options,
+                        HWND hwndNotify)
+{
+    if (count <= 0)
+        return NULL;
+
+    ProbeJob* job = (ProbeJob*)calloc(1, sizeof(ProbeJob));
+    if (job == NULL)
+        return NULL;
+
+    job->names = calloc(count, sizeof(*job->names));
+    job->hostnames = (const wchar_t**)malloc(sizeof(wchar_t*) * count);
+    job->results = (ProbeResult*)malloc(sizeof(ProbeResult) * count);
+    if (job->names == NULL || job->hostnames == NULL || job->results == NULL)
+    {
+        FreeProbeJob(job);
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        wcsncpy_s(job->names[i], MAX_HOSTNAME_LEN, hostnames[i], _TRUNCATE);
+        job->hostnames[i] = job->names[i];
+    }
+    job->count = count;
+    job->hwndNotify = hwndNotify;
+    if (options != NULL)
+        job->options = *options;
+
+    job->thread = CreateThread(NULL, 0, ProbeJobThread, job, 0, NULL);
+    if (job->thread == NULL)
+    {
+        FreeProbeJob(job);
+        return NULL;
+    }
+    return job;
+}
+
+/*
+ * GetProbeJobResults - Results of a finished probe job
+ *
+ * Returns the number of results (one per host given to StartProbeJob).
+ * Only read them once WM_PROBE_COMPLETE has arrived.
+ */
+int GetProbeJobResults(ProbeJob* job, const ProbeResult** results)
+{
+    *results = (job != NULL) ? job->results : NULL;
+    return (job != NULL) ? job->count : 0;
+}
+
+/*
+ * FreeProbeJob - Cancel a probe job, wait for it and free it
+ */
+void FreeProbeJob(ProbeJob* job)
+{
+    if (job == NULL)
+        return;
+
+    if (job->thread != NULL)
+    {
+        InterlockedExchange(&job->cancel, 1);
+        WaitForSingleObject(job->thread, INFINITE);
+        CloseHandle(job->thread);
+    }
+
+    free(job->results);
+    free(job->hostnames);
+    free(job->names);
+    free(job);
+}
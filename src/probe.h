@@ -0,0 +1,115 @@
+/*
+ * Reachability Probe Header
+ *
+ * Checks whether hosts accept TCP connections on their RDP port, many at
+ * once, without launching mstsc and waiting for it to time out. Probes are
+ * overlapped ConnectEx calls completed through one I/O completion port,
+ * so a single thread can have hundreds of connects in flight.
+ *
+ * Optionally the probe goes one step further and starts the RDP
+ * handshake (an X.224 Connection Request with an RDP Negotiation Request),
+ * which shows that an RDP server - not just anything - listens, and which
+ * security it wants: NLA (CredSSP), TLS or standard RDP security.
+ *
+ * The newest result for every host is kept in a shared table that any
+ * thread can read with GetProbeResult.
+ *
+ * The connect engine underneath (RunProbeEngine) is also used by the
+ * subnet sweep, which feeds it addresses instead of hostnames and resizes
+ * its window as it goes.
+ */
+
+#ifndef PROBE_H
+#define PROBE_H
+
+#include <windows.h>
+#include "config.h"
+#include "negotiation.h"
+
+// Most connects one engine keeps in flight
+#define PROBE_MAX_CONCURRENCY   1024
+
+// How often the engine calls its tick callback (milliseconds)
+#define PROBE_TICK_MS           250
+
+// Outcome of probing one host
+typedef struct {
+    wchar_t hostname[MAX_HOSTNAME_LEN];     // As in the host list (may end in :port)
+    USHORT port;                // Port that was probed
+    BOOL reachable;             // The TCP handshake completed
+    DWORD error;                // Winsock error when not reachable (WSAETIMEDOUT, WSAECONNREFUSED, ...)
+    double rttMs;               // Connect time (valid when reachable)
+    FILETIME checkedAt;         // When the probe finished (UTC)
+    RdpNegotiation rdp;         // RDP negotiation (when ProbeOptions.negotiate was set)
+} ProbeResult;
+
+// How to probe
+typedef struct {
+    USHORT defaultPort;         // Port for hostnames without :port (0 = RDP_DEFAULT_PORT)
+    int concurrency;            // Connects in flight at once (0 = PROBE_CONCURRENCY)
+    DWORD timeoutMs;            // Time one connect may take (0 = PROBE_TIMEOUT_MS)
+    BOOL negotiate;             // Also start the RDP handshake (same timeout for the reply)
+} ProbeOptions;
+
+// Probe hosts (blocking); results[i] is filled for hostnames[i]
+// cancel - Optional flag; set it to non-zero to abandon the probes in flight
+// Returns FALSE if Winsock could not be set up (nothing was probed)
+BOOL ProbeHosts(const wchar_t* const* hostnames, int count, const ProbeOptions* options,
+                ProbeResult* results, volatile LONG* cancel);
+
+// Newest stored result for a host; FALSE if it has never been probed
+BOOL GetProbeResult(const wchar_t* hostname, ProbeResult* result);
+
+// Forget every stored result
+void ClearProbeResults(void);
+
+// Short text for a result's error ("no answer", "refused", ...)
+const wchar_t* DescribeProbeError(DWORD error);
+
+// Short text for a negotiation outcome ("NLA (CredSSP)", "TLS", "not an RDP server", ...)
+const wchar_t* DescribeRdpNegotiation(const RdpNegotiation* rdp);
+
+// One address for the connect engine
+typedef struct {
+    BYTE address[28];           // A SOCKADDR_IN or SOCKADDR_IN6 (bytes, so this header needs no Winsock)
+    int addressLength;
+    USHORT port;                // Port in the address (for reporting)
+    DWORD error;                // Non-zero: report this error without connecting (e.g. lookup failed)
+    int index;                  // Caller's own number for the target, passed back to done
+} ProbeTarget;
+
+// Connect engine: callbacks all run on the thread that called RunProbeEngine
+typedef struct {
+    // Fill in the next target; FALSE when there are no more
+    BOOL (*next)(void* context, ProbeTarget* target);
+    // A target is finished (error is a Winsock error, WSAETIMEDOUT past the deadline);
+    // rdp is never NULL but only filled in when negotiate is set and the connect succeeded
+    void (*done)(void* context, const ProbeTarget* target, BOOL reachable, DWORD error, double rttMs,
+                 const RdpNegotiation* rdp);
+    // Optional: called every PROBE_TICK_MS; may change *window; return FALSE to stop
+    BOOL (*tick)(void* context, int* window);
+    void* context;
+    int maxWindow;              // Slots allocated (up to PROBE_MAX_CONCURRENCY)
+    int window;                 // Connects allowed in flight at the start (0 = maxWindow)
+    DWORD timeoutMs;            // Time one connect (and the negotiation reply) may take
+    BOOL negotiate;             // Send an RDP Negotiation Request after connecting
+    volatile LONG* cancel;      // Optional; non-zero abandons the probes in flight
+} ProbeEngine;
+
+// Run the engine until next() has no more targets and every probe is done
+// Returns FALSE if Winsock or the completion port could not be set up
+BOOL RunProbeEngine(const ProbeEngine* engine);
+
+// Background probe of a list of hosts; posts WM_PROBE_COMPLETE to hwndNotify
+// (wParam = hosts reachable, lParam = hosts probed) when done
+typedef struct ProbeJob ProbeJob;
+ProbeJob* StartProbeJob(const wchar_t* const* hostnames, int count, const ProbeOptions* options,
+                        HWND hwndNotify);
+
+// Results in the order the hosts were given (valid until FreeProbeJob; read after WM_PROBE_COMPLETE)
+int GetProbeJobResults(ProbeJob* job, const ProbeResult** results);
+
+// Cancel, wait for the job and free it
+void FreeProbeJob(ProbeJob* job);
+
+#endif // PROBE_H
@@ -0,0 +1,422 @@
+/*
+ * Probe Engine Module (I/O completion ports)
+ *
+ * RunProbeEngine keeps up to `window` overlapped connects in flight on
+ * the calling thread:
+ *
+ *   1. A slot is taken for each probe: an overlapped socket bound to the
+ *      completion port, and ConnectEx started with the slot's OVERLAPPED.
+ *   2. GetQueuedCompletionStatusEx returns finished connects in batches.
+ *      It waits no longer than the nearest probe deadline.
+ *   3. Probes past their deadline are abandoned by closing their socket;
+ *      the aborted connect still completes through the port, and only
+ *      then is its slot reused (the OVERLAPPED belongs to Windows until
+ *      the completion arrives).
+ *
+ * A negotiating probe keeps its slot after the connect: the request is
+ * sent and an overlapped WSARecv on the same OVERLAPPED waits for the
+ * reply, with a fresh deadline, through the same completion port.
+ *
+ * Targets come from a callback and each outcome goes to another (see
+ * ProbeEngine in probe.h), so the probe (probe.c) and the subnet sweep
+ * (sweep.c) drive the same loop. The tests link a poll() engine with the
+ * same contract in its place on other systems (tests/compat).
+ *
+ * Probe sockets are closed with a zero linger timeout (a reset instead of
+ * a FIN), so probing thousands of hosts does not leave thousands of
+ * sockets in TIME_WAIT.
+ *
+ * Learning points:
+ *   - I/O completion ports and overlapped sockets
+ *   - Loading Winsock extension functions (ConnectEx) with WSAIoctl
+ *   - Bounding concurrency with a fixed pool of slots
+ *   - Timing out overlapped I/O by closing the handle
+ */
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <mswsock.h>
+#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
+#include "probe.h"
+#include "negotiation.h"
+
+// Completions read per GetQueuedCompletionStatusEx call
+#define PROBE_COMPLETION_BATCH  64
+
+// One connect in flight (the OVERLAPPED must stay first)
+typedef struct {
+    OVERLAPPED overlapped;
+    SOCKET socket;
+    BOOL busy;                  // A connect is in flight (the slot is not free)
+    ProbeTarget target;
+    LARGE_INTEGER startTicks;   // QueryPerformanceCounter when the connect started
+    ULONGLONG deadline;         // GetTickCount64 after which the probe is abandoned
+    DWORD abandonError;         // Socket closed early: WSAETIMEDOUT or WSA_OPERATION_ABORTED (0 = not)
+    BOOL connected;             // Connect done; waiting for the negotiation reply
+    double connectMs;           // Connect time (valid once connected)
+    LARGE_INTEGER sentTicks;    // When the negotiation request was sent
+    RdpNegotiation rdp;
+    BYTE reply[RDP_REPLY_MAX];
+    int replyLength;            // Reply bytes received so far
+} ProbeSlot;
+
+/*
+ * CloseProbeSocket - Close without lingering (sends a reset, no TIME_WAIT)
+ */
+static void CloseProbeSocket(SOCKET s)
+{
+    struct linger noLinger = { 1, 0 };
+    setsockopt(s, SOL_SOCKET, SO_LINGER, (const char*)&noLinger, sizeof(noLinger));
+    closesocket(s);
+}
+
+/*
+ * StartProbe - Open a socket for a slot and start its ConnectEx
+ *
+ * Returns 0 if the connect is in flight, otherwise the Winsock error
+ * (the slot is left free).
+ */
+static DWORD StartProbe(ProbeSlot* slot, const ProbeTarget* target, HANDLE port, DWORD timeoutMs)
+{
+    GUID connectExGuid = WSAID_CONNECTEX;
+    LPFN_CONNECTEX connectEx = NULL;
+    DWORD bytes = 0;
+    SOCKADDR_STORAGE local = {0};
+    int family = ((const SOCKADDR*)target->address)->sa_family;
+
+    SOCKET s = WSASocketW(family, SOCK_STREAM, IPPROTO_TCP, NULL, 0, WSA_FLAG_OVERLAPPED);
+    if (s == INVALID_SOCKET)
+        return WSAGetLastError();
+
+    // ConnectEx needs a bound socket and is looked up per provider
+    local.ss_family = (ADDRESS_FAMILY)family;
+    if (bind(s, (const SOCKADDR*)&local, (family == AF_INET6) ? sizeof(SOCKADDR_IN6) : sizeof(SOCKADDR_IN)) != 0 ||
+        WSAIoctl(s, SIO_GET_EXTENSION_FUNCTION_POINTER, &connectExGuid, sizeof(connectExGuid),
+                 &connectEx, sizeof(connectEx), &bytes, NULL, NULL) != 0 ||
+        CreateIoCompletionPort((HANDLE)s, port, 0, 0) == NULL)
+    {
+        DWORD error = WSAGetLastError();
+        closesocket(s);
+        return (error != 0) ? error : WSAEINVAL;
+    }
+
+    memset(&slot->overlapped, 0, sizeof(OVERLAPPED));
+    memset(&slot->rdp, 0, sizeof(RdpNegotiation));
+    slot->socket = s;
+    slot->target = *target;
+    slot->abandonError = 0;
+    slot->connected = FALSE;
+    slot->replyLength = 0;
+    slot->deadline = GetTickCount64() + timeoutMs;
+    QueryPerformanceCounter(&slot->startTicks);
+
+    // A connect that finishes at once still queues its completion
+    if (!connectEx(s, (const SOCKADDR*)target->address, target->addressLength,
+                   NULL, 0, NULL, &slot->overlapped))
+    {
+        DWORD error = WSAGetLastError();
+        if (error != ERROR_IO_PENDING)
+        {
+            closesocket(s);
+            slot->socket = INVALID_SOCKET;
+            return error;
+        }
+    }
+    return 0;
+}
+
+/*
+ * ReceiveNegotiationReply - Start an overlapped read of the rest of the reply
+ *
+ * Returns 0 if the read is in flight, otherwise the Winsock error.
+ */
+static DWORD ReceiveNegotiationReply(ProbeSlot* slot)
+{
+    WSABUF buffer;
+    DWORD flags = 0;
+
+    buffer.buf = (char*)slot->reply + slot->replyLength;
+    buffer.len = (ULONG)(sizeof(slot->reply) - slot->replyLength);
+    memset(&slot->overlapped, 0, sizeof(OVERLAPPED));
+
+    // Like ConnectEx, a read that finishes at once still queues its completion
+    if (WSARecv(slot->socket, &buffer, 1, NULL, &flags, &slot->overlapped, NULL) != 0)
+    {
+        DWORD error = WSAGetLastError();
+        if (error != WSA_IO_PENDING)
+            return error;
+    }
+    return 0;
+}
+
+/*
+ * StartNegotiation - Send the negotiation request on a connected slot
+ *
+ * Returns 0 if the reply is awaited, otherwise the Winsock error.
+ */
+static DWORD StartNegotiation(ProbeSlot* slot, DWORD timeoutMs)
+{
+    // A socket connected by ConnectEx needs this before send() works normally
+    if (setsockopt(slot->socket, SOL_SOCKET, SO_UPDATE_CONNECT_CONTEXT, NULL, 0) != 0)
+        return WSAGetLastError();
+
+    // 19 bytes into a new connection's empty send buffer do not block
+    int requestLength;
+    const BYTE* request = GetRdpNegotiationRequest(&requestLength);
+    if (send(slot->socket, (const char*)request, requestLength, 0) != requestLength)
+        return WSAGetLastError();
+
+    QueryPerformanceCounter(&slot->sentTicks);
+    slot->connected = TRUE;
+    slot->rdp.attempted = TRUE;
+    slot->deadline = GetTickCount64() + timeoutMs;
+    return ReceiveNegotiationReply(slot);
+}
+
+/*
+ * CompleteProbe - Handle a completion for a slot
+ *
+ * Parameters:
+ *   engine    - The running engine
+ *   slot      - Slot whose connect or read completed (or was abandoned)
+ *   doneTicks - When the completion was dequeued
+ *   frequency - QueryPerformanceFrequency
+ *   reachable, error, rttMs - Receive the outcome when the probe is finished
+ *
+ * Returns:
+ *   TRUE when the probe is finished (its socket still needs closing if it
+ *        was not abandoned), FALSE while the negotiation continues
+ */
+static BOOL CompleteProbe(const ProbeEngine* engine, ProbeSlot* slot, LARGE_INTEGER doneTicks,
+                          LARGE_INTEGER frequency, BOOL* reachable, DWORD* error, double* rttMs)
+{
+    DWORD status = slot->abandonError;
+    DWORD bytes = 0, flags = 0;
+    BOOL ok = FALSE;
+
+    if (status == 0)
+    {
+        ok = WSAGetOverlappedResult(slot->socket, &slot->overlapped, &bytes, FALSE, &flags);
+        status = ok ? 0 : WSAGetLastError();
+    }
+
+    // The connect finished
+    if (!slot->connected)
+    {
+        *reachable = ok;
+        *error = status;
+        *rttMs = (double)(doneTicks.QuadPart - slot->startTicks.QuadPart) * 1000.0 / frequency.QuadPart;
+
+        if (ok && engine->negotiate)
+        {
+            slot->connectMs = *rttMs;
+            DWORD sendError = StartNegotiation(slot, engine->timeoutMs);
+            if (sendError == 0)
+                return FALSE;
+            slot->rdp.attempted = TRUE;
+            slot->rdp.error = sendError;
+        }
+        return TRUE;
+    }
+
+    // Part of the negotiation reply arrived, or the wait for it ended
+    *reachable = TRUE;
+    *error = 0;
+    *rttMs = slot->connectMs;
+
+    if (ok && bytes > 0)
+    {
+        slot->replyLength += (int)bytes;
+        if (ReadRdpNegotiationReply(slot->reply, slot->replyLength, &slot->rdp))
+        {
+            if (slot->rdp.answered)
+                slot->rdp.handshakeMs = (double)(doneTicks.QuadPart - slot->sentTicks.QuadPart) * 1000.0 / frequency.QuadPart;
+            return TRUE;
+        }
+
+        // Incomplete: read the rest (a full buffer without a confirm is not RDP)
+        status = (slot->replyLength < RDP_REPLY_MAX) ? ReceiveNegotiationReply(slot) : ERROR_INVALID_DATA;
+        if (status == 0)
+            return FALSE;
+    }
+    else if (ok)
+    {
+        status = WSAECONNRESET;     // Closed without a word
+    }
+
+    slot->rdp.error = status;
+    return TRUE;
+}
+
+/*
+ * RunProbeEngine - Connect to targets until there are none left
+ *
+ * Parameters:
+ *   engine - Callbacks, window, timeout and cancel flag (see probe.h)
+ *
+ * Returns:
+ *   TRUE when every target taken from next() has been passed to done()
+ *   FALSE if Winsock or the completion port could not be set up (no
+ *         target was taken)
+ *
+ * Targets with an error set are passed straight to done(). Probes still
+ * in flight when the run is cancelled, or when tick() returns FALSE, are
+ * reported with WSA_OPERATION_ABORTED - except those already connected
+ * and negotiating, which are reachable with rdp.error set instead.
+ */
+BOOL RunProbeEngine(const ProbeEngine* engine)
+{
+    WSADATA wsaData;
+    int maxWindow = engine->maxWindow;
+    int window = engine->window;
+
+    if (maxWindow > PROBE_MAX_CONCURRENCY)
+        maxWindow = PROBE_MAX_CONCURRENCY;
+    if (maxWindow < 1)
+        maxWindow = 1;
+    if (window < 1 || window > maxWindow)
+        window = maxWindow;
+
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+        return FALSE;
+
+    ProbeSlot* slots = (ProbeSlot*)calloc(maxWindow, sizeof(ProbeSlot));
+    HANDLE port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+    if (slots == NULL || port == NULL)
+    {
+        free(slots);
+        if (port != NULL)
+            CloseHandle(port);
+        WSACleanup();
+        return FALSE;
+    }
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+
+    ULONGLONG nextTick = GetTickCount64() + PROBE_TICK_MS;
+    int inFlight = 0;
+    BOOL moreTargets = TRUE;
+    BOOL stopping = FALSE;          // Cancelled, or tick() asked to stop
+
+    for (;;)
+    {
+        BOOL startFailed = FALSE;
+
+        if (engine->cancel != NULL && *engine->cancel != 0)
+            stopping = TRUE;
+
+        // 1. Start probes while the window has room
+        for (int i = 0; i < maxWindow && inFlight < window && moreTargets && !stopping; i++)
+        {
+            if (slots[i].busy)
+                continue;
+
+            ProbeTarget target;
+            if (!engine->next(engine->context, &target))
+            {
+                moreTargets = FALSE;
+                break;
+            }
+
+            DWORD error = target.error;
+            if (error == 0)
+                error = StartProbe(&slots[i], &target, port, engine->timeoutMs);
+
+            if (error == 0)
+            {
+                slots[i].busy = TRUE;
+                inFlight++;
+            }
+            else
+            {
+                RdpNegotiation none = {0};
+                engine->done(engine->context, &target, FALSE, error, 0.0, &none);
+                if (target.error == 0)
+                {
+                    // Probably out of sockets or ports - let probes finish first
+                    startFailed = TRUE;
+                    break;
+                }
+                i--;    // The slot is still free
+            }
+        }
+
+        if (inFlight == 0 && (stopping || !moreTargets))
+            break;
+
+        // 2. Wait for completions, no longer than the nearest deadline or tick
+        ULONGLONG now = GetTickCount64();
+        ULONGLONG wakeAt = (engine->tick != NULL) ? nextTick : MAXULONGLONG;
+        if (engine->cancel != NULL && wakeAt > now + 100)
+            wakeAt = now + 100;     // A cancel flag is polled
+        if (startFailed && wakeAt > now + 50)
+            wakeAt = now + 50;      // Try starting again soon even if nothing completes
+        for (int i = 0; i < maxWindow; i++)
+        {
+            if (slots[i].busy && slots[i].abandonError == 0 && slots[i].deadline < wakeAt)
+                wakeAt = slots[i].deadline;
+        }
+        DWORD wait = (wakeAt == MAXULONGLONG) ? INFINITE : (wakeAt > now ? (DWORD)(wakeAt - now) : 0);
+
+        OVERLAPPED_ENTRY entries[PROBE_COMPLETION_BATCH];
+        ULONG removed = 0;
+        if (GetQueuedCompletionStatusEx(port, entries, PROBE_COMPLETION_BATCH, &removed, wait, FALSE))
+        {
+            LARGE_INTEGER doneTicks;
+            QueryPerformanceCounter(&doneTicks);
+
+            for (ULONG e = 0; e < removed; e++)
+            {
+                ProbeSlot* slot = (ProbeSlot*)entries[e].lpOverlapped;
+                BOOL reachable = FALSE;
+                DWORD error = 0;
+                double rttMs = 0.0;
+
+                if (!CompleteProbe(engine, slot, doneTicks, frequency, &reachable, &error, &rttMs))
+                    continue;   // Still negotiating
+
+                if (slot->abandonError == 0)
+                    CloseProbeSocket(slot->socket);
+                slot->socket = INVALID_SOCKET;
+                slot->busy = FALSE;
+                inFlight--;
+                engine->done(engine->context, &slot->target, reachable, error, rttMs, &slot->rdp);
+            }
+        }
+
+        // 3. Let the caller adjust the window (or stop) once per tick
+        now = GetTickCount64();
+        if (engine->tick != NULL && now >= nextTick && !stopping)
+        {
+            if (!engine->tick(engine->context, &window))
+                stopping = TRUE;
+            if (window < 1)
+                window = 1;
+            if (window > maxWindow)
+                window = maxWindow;
+            nextTick = now + PROBE_TICK_MS;
+        }
+
+        // 4. Abandon probes past their deadline (or all of them when stopping)
+        if (engine->cancel != NULL && *engine->cancel != 0)
+            stopping = TRUE;
+        for (int i = 0; i < maxWindow; i++)
+        {
+            if (!slots[i].busy || slots[i].abandonError != 0)
+                continue;
+            if (stopping || now >= slots[i].deadline)
+            {
+                CloseProbeSocket(slots[i].socket);
+                slots[i].abandonError = stopping ? WSA_OPERATION_ABORTED : WSAETIMEDOUT;
+            }
+        }
+    }
+
+    CloseHandle(port);
+    free(slots);
+    WSACleanup();
+    return TRUE;
+}
@@ -0,0 +1,627 @@
+/*
+ * Connection Profiles Module
+ *
+ * The built-in .rdp settings are a table of lines, each stored as the
+ * UTF-8 text that goes into the file ("desktopwidth:i:" and "1920"), so a
+ * host without changes is rendered with nothing but copies.
+ *
+ * profiles.ini is read into three parts:
+ *
+ *   - One array of changes for every section. A change is 8 bytes: the
+ *     line it replaces, and where its value is in a shared pool of UTF-8
+ *     text. A section's changes are next to each other in the array, so a
+ *     layer is just (first, count).
+ *   - The named profiles, each with its layer and the profile it inherits.
+ *   - A hash table of the [host] sections, keyed by a 64-bit hash of the
+ *     lowercase hostname: the host's own layer and its profile.
+ *
+ * Resolving copies the built-in lines and applies the layers from the most
+ * general to the most specific, so later layers win: [default], then the
+ * host's profile chain from the profile it inherits from down to its own
+ * profile, then the [host] section. Within one section a later line wins.
+ *
+ * The file's time and size are checked on every resolve, so edits apply
+ * to the next connection without restarting.
+ *
+ * Learning points:
+ *   - Layered configuration with sparse overrides
+ *   - Keeping variable-length values in one pool referenced by offset
+ *   - Parsing a simple INI-style format by hand
+ */
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "profiles.h"
+
+#define RDP_LINE(key, value) { key, sizeof(key) - 1, RDP_SETTING_PROFILE, value, sizeof(value) - 1 }
+
+/*
+ * Built-in settings, in file order
+ *
+ * Key settings explained:
+ *   screen mode id:i:2           - Full screen mode
+ *   desktopwidth/height          - Screen resolution
+ *   session bpp:i:32             - Color depth (32-bit)
+ *   full address:s:[hostname]    - Server to connect to
+ *   authentication level:i:0     - Don't require server auth (for older servers)
+ *   prompt for credentials:i:0   - Use saved credentials, don't prompt
+ *   redirectclipboard:i:1        - Enable clipboard sharing
+ *   redirectprinters:i:1         - Enable printer redirection
+ */
+static const RdpProfileLine g_builtinLines[RDP_SETTING_COUNT] = {
+    RDP_LINE("screen mode id:i:", "2"),
+    RDP_LINE("use multimon:i:", "0"),
+    RDP_LINE("desktopwidth:i:", "1920"),
+    RDP_LINE("desktopheight:i:", "1080"),
+    RDP_LINE("session bpp:i:", "32"),
+    { "full address:s:", sizeof("full address:s:") - 1, RDP_SETTING_HOSTNAME, "", 0 },
+    RDP_LINE("compression:i:", "1"),
+    RDP_LINE("keyboardhook:i:", "2"),
+    RDP_LINE("audiocapturemode:i:", "0"),
+    RDP_LINE("videoplaybackmode:i:", "1"),
+    RDP_LINE("connection type:i:", "7"),
+    RDP_LINE("networkautodetect:i:", "1"),
+    RDP_LINE("bandwidthautodetect:i:", "1"),
+    RDP_LINE("displayconnectionbar:i:", "1"),
+    RDP_LINE("enableworkspacereconnect:i:", "1"),
+    RDP_LINE("disable wallpaper:i:", "0"),
+    RDP_LINE("allow font smoothing:i:", "1"),
+    RDP_LINE("allow desktop composition:i:", "1"),
+    RDP_LINE("disable full window drag:i:", "0"),
+    RDP_LINE("disable menu anims:i:", "0"),
+    RDP_LINE("disable themes:i:", "0"),
+    RDP_LINE("disable cursor setting:i:", "0"),
+    RDP_LINE("bitmapcachepersistenable:i:", "1"),
+    RDP_LINE("audiomode:i:", "0"),
+    RDP_LINE("redirectprinters:i:", "1"),
+    RDP_LINE("redirectcomports:i:", "0"),
+    RDP_LINE("redirectsmartcards:i:", "1"),
+    RDP_LINE("redirectclipboard:i:", "1"),
+    RDP_LINE("redirectposdevices:i:", "0"),
+    RDP_LINE("autoreconnection enabled:i:", "1"),
+    RDP_LINE("authentication level:i:", "0"),
+    RDP_LINE("prompt for credentials:i:", "0"),
+    RDP_LINE("negotiate security layer:i:", "1"),
+    RDP_LINE("remoteapplicationmode:i:", "0"),
+    RDP_LINE("alternate shell:s:", ""),
+    RDP_LINE("shell working directory:s:", ""),
+    RDP_LINE("gatewayhostname:s:", ""),
+    RDP_LINE("gatewayusagemethod:i:", "4"),
+    RDP_LINE("gatewaycredentialssource:i:", "4"),
+    RDP_LINE("gatewayprofileusagemethod:i:", "0"),
+    RDP_LINE("promptcredentialonce:i:", "1"),
+    RDP_LINE("use redirection server name:i:", "0"),
+    { "username:s:", sizeof("username:s:") - 1, RDP_SETTING_USERNAME, "", 0 }
+};
+
+// One changed setting (8 bytes)
+typedef struct {
+    BYTE line;                  // Index into g_builtinLines
+    BYTE reserved;
+    WORD valueLength;
+    DWORD valueOffset;          // Into g_valuePool
+} ProfileChange;
+
+// A section's changes: g_changes[first .. first + count)
+typedef struct {
+    int first;
+    int count;
+} ProfileLayer;
+
+typedef struct {
+    wchar_t name[PROFILE_NAME_LEN];
+    int parent;                 // Profile it inherits, -1 for none
+    ProfileLayer layer;
+    BOOL defined;               // FALSE if only referred to
+} NamedProfile;
+
+// A [host] section (open addressing, nameHash 0 = empty)
+typedef struct {
+    ULONGLONG nameHash;
+    int profile;                // -1 for none
+    ProfileLayer layer;
+} HostProfile;
+
+static SRWLOCK g_profilesLock = SRWLOCK_INIT;
+static BOOL g_profilesLoaded = FALSE;
+static FILETIME g_loadedWriteTime;      // Of the file that was read (zero = no file)
+static DWORD g_loadedSize;
+
+static char* g_valuePool = NULL;
+static size_t g_valuePoolSize = 0;
+static size_t g_valuePoolCapacity = 0;
+static ProfileChange* g_changes = NULL;
+static int g_changeCount = 0;
+static int g_changeCapacity = 0;
+static NamedProfile* g_profiles = NULL;
+static int g_profileCount = 0;
+static int g_profileCapacity = 0;
+static HostProfile* g_hostProfiles = NULL;
+static int g_hostProfileCount = 0;
+static int g_hostProfileCapacity = 0;   // Power of two
+static ProfileLayer g_defaultLayer = {0, 0};
+static int g_problemCount = 0;          // Lines ignored, profiles used but not defined
+
+/*
+ * GetProfilesFilePath - Full path of profiles.ini (next to hosts.csv)
+ */
+static BOOL GetProfilesFilePath(wchar_t* path, size_t pathLen)
+{
+    wchar_t exePath[MAX_PATH];
+
+    if (GetModuleFileNameW(NULL, exePath, MAX_PATH) == 0)
+        return FALSE;
+
+    wchar_t* lastSlash = wcsrchr(exePath, L'\\');
+    if (lastSlash == NULL)
+        return FALSE;
+    *(lastSlash + 1) = L'\0';
+
+    return swprintf_s(path, pathLen, L"%s%s", exePath, PROFILES_FILE_NAME) >= 0;
+}
+
+/*
+ * ClearProfiles - Free everything read from the file
+ *
+ * Must be called with the lock held exclusively.
+ */
+static void ClearProfiles(void)
+{
+    free(g_valuePool);
+    free(g_changes);
+    free(g_profiles);
+    free(g_hostProfiles);
+    g_valuePool = NULL;
+    g_valuePoolSize = g_valuePoolCapacity = 0;
+    g_changes = NULL;
+    g_changeCount = g_changeCapacity = 0;
+    g_profiles = NULL;
+    g_profileCount = g_profileCapacity = 0;
+    g_hostProfiles = NULL;
+    g_hostProfileCount = g_hostProfileCapacity = 0;
+    g_defaultLayer.first = g_defaultLayer.count = 0;
+    g_problemCount = 0;
+}
+
+/*
+ * GrowArray - Make room for one more element (doubling)
+ */
+static BOOL GrowArray(void** array, int* capacity, int count, size_t elementSize)
+{
+    if (count < *capacity)
+        return TRUE;
+
+    int newCapacity = (*capacity > 0) ? *capacity * 2 : 64;
+    void* grown = realloc(*array, (size_t)newCapacity * elementSize);
+    if (grown == NULL)
+        return FALSE;
+
+    *array = grown;
+    *capacity = newCapacity;
+    return TRUE;
+}
+
+/*
+ * AddChange - Append a changed setting, its value copied into the pool
+ */
+static BOOL AddChange(int line, const char* value, size_t valueLength)
+{
+    if (!GrowArray((void**)&g_changes, &g_changeCapacity, g_changeCount, sizeof(ProfileChange)))
+        return FALSE;
+
+    if (g_valuePoolSize + valueLength > g_valuePoolCapacity)
+    {
+        size_t newCapacity = (g_valuePoolCapacity > 0) ? g_valuePoolCapacity : 4096;
+        while (newCapacity < g_valuePoolSize + valueLength)
+            newCapacity *= 2;
+        char* grown = (char*)realloc(g_valuePool, newCapacity);
+        if (grown == NULL)
+            return FALSE;
+        g_valuePool = grown;
+        g_valuePoolCapacity = newCapacity;
+    }
+
+    ProfileChange* change = &g_changes[g_changeCount++];
+    change->line = (BYTE)line;
+    change->reserved = 0;
+    change->valueLength = (WORD)valueLength;
+    change->valueOffset = (DWORD)g_valuePoolSize;
+    memcpy(g_valuePool + g_valuePoolSize, value, valueLength);
+    g_valuePoolSize += valueLength;
+    return TRUE;
+}
+
+/*
+ * FindOrAddProfile - Index of a named profile, added (undefined) if new
+ *
+ * Returns -1 if out of memory.
+ */
+static int FindOrAddProfile(const wchar_t* name)
+{
+    for (int i = 0; i < g_profileCount; i++)
+    {
+        if (_wcsicmp(g_profiles[i].name, name) == 0)
+            return i;
+    }
+
+    if (!GrowArray((void**)&g_profiles, &g_profileCapacity, g_profileCount, sizeof(NamedProfile)))
+        return -1;
+
+    NamedProfile* profile = &g_profiles[g_profileCount];
+    memset(profile, 0, sizeof(NamedProfile));
+    wcsncpy_s(profile->name, PROFILE_NAME_LEN, name, _TRUNCATE);
+    profile->parent = -1;
+    return g_profileCount++;
+}
+
+/*
+ * FindHostSlot - Slot holding nameHash, or the empty slot where it would go
+ *
+ * Must be called with the lock held and a non-empty table.
+ */
+static int FindHostSlot(ULONGLONG nameHash)
+{
+    int slot = (int)(nameHash & (g_hostProfileCapacity - 1));
+    while (g_hostProfiles[slot].nameHash != 0 && g_hostProfiles[slot].nameHash != nameHash)
+        slot = (slot + 1) & (g_hostProfileCapacity - 1);
+    return slot;
+}
+
+/*
+ * AddHostProfile - The entry of a [host] section, added if new
+ *
+ * Returns NULL if out of memory.
+ */
+static HostProfile* AddHostProfile(ULONGLONG nameHash)
+{
+    // Keep the table at most half full
+    if ((g_hostProfileCount + 1) * 2 > g_hostProfileCapacity)
+    {
+        int newCapacity = (g_hostProfileCapacity > 0) ? g_hostProfileCapacity * 2 : 256;
+        HostProfile* newTable = (HostProfile*)calloc(newCapacity, sizeof(HostProfile));
+        if (newTable == NULL)
+            return NULL;
+
+        HostProfile* oldTable = g_hostProfiles;
+        int oldCapacity = g_hostProfileCapacity;
+        g_hostProfiles = newTable;
+        g_hostProfileCapacity = newCapacity;
+        for (int i = 0; i < oldCapacity; i++)
+        {
+            if (oldTable[i].nameHash != 0)
+                g_hostProfiles[FindHostSlot(oldTable[i].nameHash)] = oldTable[i];
+        }
+        free(oldTable);
+    }
+
+    int slot = FindHostSlot(nameHash);
+    if (g_hostProfiles[slot].nameHash == 0)
+    {
+        g_hostProfiles[slot].nameHash = nameHash;
+        g_hostProfiles[slot].profile = -1;
+        g_hostProfileCount++;
+    }
+    return &g_hostProfiles[slot];
+}
+
+/*
+ * Utf8ToName - Convert a name from the file to UTF-16
+ */
+static BOOL Utf8ToName(const char* text, size_t length, wchar_t* name, int nameLen)
+{
+    if (length == 0 || length >= (size_t)nameLen)
+        return FALSE;
+
+    int written = MultiByteToWideChar(CP_UTF8, 0, text, (int)length, name, nameLen - 1);
+    if (written <= 0)
+        return FALSE;
+    name[written] = L'\0';
+    return TRUE;
+}
+
+/*
+ * FindSettingLine - Built-in line whose key starts the text (-1 if none)
+ *
+ * Keys are matched case-insensitively, as mstsc does. The hostname and
+ * username lines belong to the connection and cannot be changed here.
+ */
+static int FindSettingLine(const char* text, size_t length)
+{
+    for (int i = 0; i < RDP_SETTING_COUNT; i++)
+    {
+        const RdpProfileLine* line = &g_builtinLines[i];
+        if (line->source == RDP_SETTING_PROFILE && length >= line->keyLength &&
+            _strnicmp(text, line->key, line->keyLength) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * IsIntegerValue - TRUE for an optional '-' followed by digits
+ */
+static BOOL IsIntegerValue(const char* value, size_t length)
+{
+    size_t i = (length > 0 && value[0] == '-') ? 1 : 0;
+    if (i == length)
+        return FALSE;
+    for (; i < length; i++)
+    {
+        if (value[i] < '0' || value[i] > '9')
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * ParseProfiles - Read the sections of profiles.ini
+ *
+ * Must be called with the lock held exclusively and nothing loaded.
+ */
+static void ParseProfiles(const char* data, size_t size)
+{
+    enum { SECTION_NONE, SECTION_DEFAULT, SECTION_PROFILE, SECTION_HOST } section = SECTION_NONE;
+    ProfileLayer* layer = NULL;         // Layer of the current section
+    NamedProfile* profileSection = NULL;
+    int profileIndex = -1;
+    HostProfile* hostSection = NULL;
+
+    // Skip a UTF-8 byte order mark
+    size_t pos = (size >= 3 && (BYTE)data[0] == 0xEF && (BYTE)data[1] == 0xBB && (BYTE)data[2] == 0xBF) ? 3 : 0;
+
+    while (pos < size)
+    {
+        // Next line without its line end and surrounding blanks
+        size_t end = pos;
+        while (end < size && data[end] != '\n')
+            end++;
+        size_t next = end + 1;
+        while (end > pos && (data[end - 1] == '\r' || data[end - 1] == ' ' || data[end - 1] == '\t'))
+            end--;
+        while (pos < end && (data[pos] == ' ' || data[pos] == '\t'))
+            pos++;
+        const char* line = data + pos;
+        size_t length = end - pos;
+        pos = next;
+
+        if (length == 0 || line[0] == ';' || line[0] == '#')
+            continue;
+
+        if (line[0] == '[')
+        {
+            // Section header: [default], [profile NAME] or [host NAME]
+            wchar_t name[MAX_HOSTNAME_LEN];
+            section = SECTION_NONE;
+            layer = NULL;
+
+            if (line[length - 1] != ']')
+            {
+                g_problemCount++;   // Unclosed section header
+            }
+            else if (length == 9 && _strnicmp(line, "[default]", 9) == 0)
+            {
+                section = SECTION_DEFAULT;
+                layer = &g_defaultLayer;
+            }
+            else if (length > 10 && _strnicmp(line, "[profile ", 9) == 0 &&
+                     Utf8ToName(line + 9, length - 10, name, PROFILE_NAME_LEN) &&
+                     (profileIndex = FindOrAddProfile(name)) >= 0)
+            {
+                section = SECTION_PROFILE;
+                profileSection = &g_profiles[profileIndex];
+                profileSection->defined = TRUE;
+                layer = &profileSection->layer;
+            }
+            else if (length > 7 && _strnicmp(line, "[host ", 6) == 0 &&
+                     Utf8ToName(line + 6, length - 7, name, MAX_HOSTNAME_LEN) &&
+                     (hostSection = AddHostProfile(HashHostKey(name))) != NULL)
+            {
+                section = SECTION_HOST;
+                layer = &hostSection->layer;
+            }
+            else
+            {
+                g_problemCount++;   // Unknown section
+            }
+
+            // A section that appears again replaces the earlier one
+            if (layer != NULL)
+            {
+                layer->first = g_changeCount;
+                layer->count = 0;
+            }
+            continue;
+        }
+
+        if (section == SECTION_NONE)
+            continue;
+
+        // profile=NAME in a [host] section, inherit=NAME in a [profile] section
+        if ((section == SECTION_HOST && length > 8 && _strnicmp(line, "profile=", 8) == 0) ||
+            (section == SECTION_PROFILE && length > 8 && _strnicmp(line, "inherit=", 8) == 0))
+        {
+            wchar_t name[PROFILE_NAME_LEN];
+            int index;
+            if (!Utf8ToName(line + 8, length - 8, name, PROFILE_NAME_LEN) || (index = FindOrAddProfile(name)) < 0)
+            {
+                g_problemCount++;   // Bad profile name
+                continue;
+            }
+
+            // FindOrAddProfile may have moved the profiles
+            if (section == SECTION_HOST)
+            {
+                hostSection->profile = index;
+            }
+            else
+            {
+                profileSection = &g_profiles[profileIndex];
+                profileSection->parent = index;
+            }
+            continue;
+        }
+
+        // A setting, written as in an .rdp file
+        int settingLine = FindSettingLine(line, length);
+        if (settingLine < 0)
+        {
+            g_problemCount++;   // Unknown setting
+            continue;
+        }
+
+        const RdpProfileLine* builtin = &g_builtinLines[settingLine];
+        const char* value = line + builtin->keyLength;
+        size_t valueLength = length - builtin->keyLength;
+        BOOL isInteger = (builtin->key[builtin->keyLength - 2] == 'i');
+
+        if ((isInteger && !IsIntegerValue(value, valueLength)) || valueLength > 0xFFFF)
+        {
+            g_problemCount++;   // Bad value
+            continue;
+        }
+
+        // The layer pointer stays valid: profiles only move when a name is added
+        if (section == SECTION_PROFILE)
+            layer = &g_profiles[profileIndex].layer;
+        else if (section == SECTION_DEFAULT)
+            layer = &g_defaultLayer;
+
+        // Sections are read in order, so this section's changes stay next to each other
+        if (layer->first + layer->count == g_changeCount && AddChange(settingLine, value, valueLength))
+            layer->count++;
+    }
+
+    // A profile that is used but never defined applies nothing
+    for (int i = 0; i < g_profileCount; i++)
+    {
+        if (!g_profiles[i].defined)
+            g_problemCount++;
+    }
+}
+
+/*
+ * RefreshProfiles - Read profiles.ini if it changed since it was read
+ *
+ * Must be called with the lock held exclusively.
+ */
+static void RefreshProfiles(void)
+{
+    wchar_t path[MAX_PATH];
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    FILETIME writeTime = {0, 0};
+    DWORD fileSize = 0;
+
+    if (!GetProfilesFilePath(path, MAX_PATH))
+        return;
+
+    if (GetFileAttributesExW(path, GetFileExInfoStandard, &attributes))
+    {
+        writeTime = attributes.ftLastWriteTime;
+        fileSize = attributes.nFileSizeLow;
+    }
+
+    if (g_profilesLoaded && CompareFileTime(&writeTime, &g_loadedWriteTime) == 0 && fileSize == g_loadedSize)
+        return;
+
+    ClearProfiles();
+    g_profilesLoaded = TRUE;
+    g_loadedWriteTime = writeTime;
+    g_loadedSize = fileSize;
+    if (fileSize == 0)
+        return;
+
+    FILE* file = NULL;
+    if (_wfopen_s(&file, path, L"rb") != 0 || file == NULL)
+    {
+        g_problemCount++;
+        return;
+    }
+
+    char* data = (char*)malloc(fileSize);
+    if (data != NULL && fread(data, 1, fileSize, file) == fileSize)
+        ParseProfiles(data, fileSize);
+    else
+        g_problemCount++;
+    free(data);
+    fclose(file);
+}
+
+/*
+ * ApplyLayer - Replace lines of a resolved profile with a layer's changes
+ */
+static void ApplyLayer(RdpProfile* profile, const ProfileLayer* layer)
+{
+    if (layer->count > 0)
+        profile->layers++;
+
+    for (int i = layer->first; i < layer->first + layer->count; i++)
+    {
+        const ProfileChange* change = &g_changes[i];
+        RdpProfileLine* line = &profile->lines[change->line];
+
+        // No room left - the line keeps its earlier value
+        if (profile->storageUsed + change->valueLength > RDP_PROFILE_STORAGE)
+            continue;
+
+        char* value = profile->storage + profile->storageUsed;
+        memcpy(value, g_valuePool + change->valueOffset, change->valueLength);
+        profile->storageUsed += change->valueLength;
+        line->value = value;
+        line->valueLength = change->valueLength;
+    }
+}
+
+/*
+ * ResolveRdpProfile - Settings for one host
+ *
+ * Parameters:
+ *   hostname - Host as written in the host list
+ *   profile  - Receives the lines of its .rdp file
+ *
+ * Layers, from the most general to the most specific (later ones win):
+ * built-in, [default], the host's profile chain (the most inherited
+ * profile first), [host NAME]. A chain is followed for at most
+ * PROFILE_MAX_DEPTH profiles, which also ends loops.
+ *
+ * Returns:
+ *   TRUE if profiles.ini was read without problems (or there is none).
+ *   FALSE if it could not be read, has lines that were ignored or uses a
+ *   profile it does not define; the host is still resolved, without them.
+ */
+BOOL ResolveRdpProfile(const wchar_t* hostname, RdpProfile* profile)
+{
+    memcpy(profile->lines, g_builtinLines, sizeof(g_builtinLines));
+    profile->storageUsed = 0;
+    profile->layers = 0;
+
+    AcquireSRWLockExclusive(&g_profilesLock);
+    RefreshProfiles();
+
+    ApplyLayer(profile, &g_defaultLayer);
+
+    if (g_hostProfileCount > 0)
+    {
+        const HostProfile* host = &g_hostProfiles[FindHostSlot(HashHostKey(hostname))];
+        if (host->nameHash != 0)
+        {
+            int chain[PROFILE_MAX_DEPTH];
+            int depth = 0;
+            for (int p = host->profile; p >= 0 && depth < PROFILE_MAX_DEPTH; p = g_profiles[p].parent)
+                chain[depth++] = p;
+
+            while (depth > 0)
+                ApplyLayer(profile, &g_profiles[chain[--depth]].layer);
+            ApplyLayer(profile, &host->layer);
+        }
+    }
+
+    BOOL clean = (g_problemCount == 0);
+    ReleaseSRWLockExclusive(&g_profilesLock);
+    return clean;
+}
+
@@ -0,0 +1,78 @@
+/*
+ * Connection Profiles Header
+ *
+ * Settings of the generated .rdp files, in layers. Every host starts from
+ * the built-in defaults; profiles.ini (next to hosts.csv) can change them
+ * for everyone ([default]), for a named profile ([profile NAME], which may
+ * inherit another one) and for a single host ([host NAME]):
+ *
+ *   [default]
+ *   desktopwidth:i:2560
+ *   desktopheight:i:1440
+ *
+ *   [profile lab]
+ *   use multimon:i:1
+ *   redirectprinters:i:0
+ *
+ *   [profile dmz]
+ *   inherit=lab
+ *   gatewayhostname:s:rdgw.example.com
+ *   gatewayusagemethod:i:1
+ *
+ *   [host sql01.corp.example.com]
+ *   profile=dmz
+ *   desktopwidth:i:1280
+ *
+ * Settings are written as in an .rdp file. Only the changed settings are
+ * stored, so 20,000 hosts with a few changes each take little memory.
+ */
+
+#ifndef PROFILES_H
+#define PROFILES_H
+
+#include <windows.h>
+
+// Lines of a generated .rdp file
+#define RDP_SETTING_COUNT       43
+
+// Longest chain of inherited profiles (longer chains and loops are cut here)
+#define PROFILE_MAX_DEPTH       8
+
+// Longest profile name
+#define PROFILE_NAME_LEN        64
+
+// Room for the changed values of one resolved profile
+#define RDP_PROFILE_STORAGE     4096
+
+// Where the value of a line comes from
+typedef enum {
+    RDP_SETTING_PROFILE,        // Built-in default, changed by the profile layers
+    RDP_SETTING_HOSTNAME,       // "full address": the host being connected to
+    RDP_SETTING_USERNAME        // "username": left out when there is none
+} RdpSettingSource;
+
+// One line of the file
+typedef struct {
+    const char* key;            // "desktopwidth:i:" (UTF-8, as written in the file)
+    size_t keyLength;
+    RdpSettingSource source;
+    const char* value;          // Resolved value for RDP_SETTING_PROFILE lines (UTF-8)
+    size_t valueLength;
+} RdpProfileLine;
+
+// Settings for one host, in file order (values point into the struct - do not copy it)
+typedef struct {
+    RdpProfileLine lines[RDP_SETTING_COUNT];
+    char storage[RDP_PROFILE_STORAGE];
+    size_t storageUsed;
+    int layers;                 // Layers of profiles.ini that applied (0 = built-in defaults only)
+} RdpProfile;
+
+// Resolve the settings of a host: built-in, [default], its profile chain
+// (most general first), then its own section. Re-reads profiles.ini when
+// it has changed. Safe from any thread. FALSE if profiles.ini has
+// problems (unreadable, ignored lines, undefined profiles) - the host is
+// still resolved, with what could be used.
+BOOL ResolveRdpProfile(const wchar_t* hostname, RdpProfile* profile);
+
+#endif // PROFILES_H
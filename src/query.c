@@ -0,0 +1,992 @@
+/*
+ * Search Query Module
+ *
+ * Turns the text typed into a search box into a small program and runs it
+ * against hosts. See query.h for the syntax.
+ *
+ * Compiling:
+ *   A recursive descent parser reads the query and directly emits
+ *   instructions for a tiny machine with a single TRUE/FALSE register.
+ *   Each test (text, wildcard, date range) sets the register; AND and OR
+ *   become conditional jumps, so evaluation short-circuits exactly like
+ *   && and || in C:
+ *
+ *     host:web* -never          GLOB host "web*"
+ *                               JUMP_IF_FALSE end
+ *                               LAST_RANGE never..never
+ *                               NOT
+ *                         end:
+ *
+ *   Relative dates ("last:<30d") are converted to absolute timestamps at
+ *   compile time, so evaluating a host never looks at the clock.
+ *
+ * Evaluating:
+ *   EvaluateQuery walks the instructions for one host. There is no
+ *   recursion, no allocation and no string copying in that loop.
+ *
+ * Learning points:
+ *   - Tokenizing and recursive descent parsing
+ *   - Compiling expressions to jump-based code (short-circuit evaluation)
+ *   - Wildcard matching without recursion
+ *   - FILETIME arithmetic for "N days ago"
+ */
+
+#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wctype.h>
+#include "query.h"
+#include "hostsort.h"
+#include "regex.h"
+
+// Instruction set
+typedef enum {
+    OP_TEXT,            // Register = a field contains text
+    OP_GLOB,            // Register = a field matches a wildcard pattern
+    OP_REGEX,           // Register = a field matches a regular expression
+    OP_LAST_RANGE,      // Register = last connected key within [low, high]
+    OP_NOT,             // Register = !register
+    OP_JUMP_IF_FALSE,   // if (!register) goto target
+    OP_JUMP_IF_TRUE     // if (register) goto target
+} QueryOp;
+
+typedef struct {
+    BYTE op;                // QueryOp
+    BYTE fields;            // QUERY_FIELD_xxx for OP_TEXT / OP_GLOB / OP_REGEX
+    int arg;                // Text offset in the string pool, regex number or jump target
+    ULONGLONG low;          // OP_LAST_RANGE bounds (inclusive)
+    ULONGLONG high;
+} QueryInstr;
+
+struct Query {
+    QueryInstr* code;
+    int codeCount;
+    int codeCapacity;
+    wchar_t* pool;          // Lowercased strings used by the program
+    int poolLength;
+    int poolCapacity;
+    int highlightText;      // Pool offset of the text to highlight, -1 = none
+    int highlightFields;
+    int hostPrefix;         // Pool offset of the required hostname prefix, -1 = none
+    int hostPrefixLength;
+    Regex** regexes;        // Compiled re: terms (OP_REGEX arg indexes this)
+    int regexCount;
+    int regexCapacity;
+};
+
+// Token kinds
+typedef enum {
+    TOKEN_END,
+    TOKEN_LPAREN,
+    TOKEN_RPAREN,
+    TOKEN_OR,
+    TOKEN_NOT,
+    TOKEN_TERM
+} TokenKind;
+
+typedef struct {
+    TokenKind kind;
+    wchar_t field[16];      // Field name before ':' (empty if none)
+    wchar_t value[256];     // Term text (quotes removed)
+    BOOL quoted;
+} Token;
+
+// Parser state
+typedef struct {
+    const wchar_t* p;       // Next character to read
+    Token token;            // Current (lookahead) token
+    Query* query;
+    wchar_t* error;
+    int errorLen;
+    BOOL failed;
+    int negationDepth;      // > 0 while compiling inside a negation
+    int groupDepth;         // > 0 while compiling inside parentheses
+    BOOL topLevelOr;        // The whole query is an OR - no required prefix
+    ULONGLONG nowFileTime;  // Current local time as a FILETIME value
+    Query* previous;        // Earlier query whose compiled regexes may be reused
+} Parser;
+
+static void ParseOr(Parser* parser);
+
+/*
+ * FindTextNoCase - Case-insensitive substring search
+ *
+ * needleLower must already be lowercase. Lowercasing the needle once per
+ * query (instead of copying and lowercasing every haystack) keeps the inner
+ * loop free of buffer copies.
+ *
+ * Returns the offset of the first match in haystack, or -1.
+ * An empty needle matches at offset 0.
+ */
+int FindTextNoCase(const wchar_t* haystack, const wchar_t* needleLower)
+{
+    if (needleLower[0] == L'\0')
+        return 0;
+
+    wchar_t first = needleLower[0];
+    for (const wchar_t* h = haystack; *h != L'\0'; h++)
+    {
+        if ((wchar_t)towlower(*h) != first)
+            continue;
+
+        const wchar_t* a = h + 1;
+        const wchar_t* b = needleLower + 1;
+        while (*a != L'\0' && *b != L'\0' && (wchar_t)towlower(*a) == *b)
+        {
+            a++;
+            b++;
+        }
+        if (*b == L'\0')
+            return (int)(h - haystack);
+        if (*a == L'\0')
+            return -1;  // Haystack ran out - no later match can fit
+    }
+    return -1;
+}
+
+/*
+ * GlobMatchNoCase - Match a whole string against a lowercase wildcard pattern
+ *
+ * '*' matches any run of characters and '?' any single character. On a
+ * mismatch we only ever return to the most recent '*', which keeps the
+ * worst case at O(text * pattern) instead of exponential.
+ */
+static BOOL GlobMatchNoCase(const wchar_t* text, const wchar_t* patternLower)
+{
+    const wchar_t* star = NULL;     // Last '*' seen in the pattern
+    const wchar_t* retry = NULL;    // Where in text that '*' should resume
+
+    while (*text != L'\0')
+    {
+        wchar_t c = (wchar_t)towlower(*text);
+
+        if (*patternLower == L'*')
+        {
+            star = patternLower++;
+            retry = text;
+        }
+        else if (*patternLower == L'?' || *patternLower == c)
+        {
+            patternLower++;
+            text++;
+        }
+        else if (star != NULL)
+        {
+            // Let the last '*' swallow one more character and try again
+            patternLower = star + 1;
+            text = ++retry;
+        }
+        else
+        {
+            return FALSE;
+        }
+    }
+
+    while (*patternLower == L'*')
+        patternLower++;
+    return (*patternLower == L'\0');
+}
+
+/*
+ * SetError - Record the first syntax error
+ */
+static void SetError(Parser* parser, const wchar_t* message, const wchar_t* detail)
+{
+    if (parser->failed)
+        return;
+
+    parser->failed = TRUE;
+    if (parser->error == NULL)
+        return;
+    if (detail != NULL)
+        swprintf_s(parser->error, parser->errorLen, L"%s '%s'", message, detail);
+    else
+        wcsncpy_s(parser->error, parser->errorLen, message, _TRUNCATE);
+}
+
+/*
+ * Emit - Append an instruction; returns its position
+ */
+static int Emit(Parser* parser, QueryOp op, BYTE fields, int arg, ULONGLONG low, ULONGLONG high)
+{
+    Query* query = parser->query;
+
+    if (query->codeCount == query->codeCapacity)
+    {
+        int newCapacity = query->codeCapacity ? query->codeCapacity * 2 : 16;
+        QueryInstr* newCode = (QueryInstr*)realloc(query->code, newCapacity * sizeof(QueryInstr));
+        if (newCode == NULL)
+        {
+            SetError(parser, L"Out of memory", NULL);
+            return -1;
+        }
+        query->code = newCode;
+        query->codeCapacity = newCapacity;
+    }
+
+    QueryInstr* instr = &query->code[query->codeCount];
+    instr->op = (BYTE)op;
+    instr->fields = fields;
+    instr->arg = arg;
+    instr->low = low;
+    instr->high = high;
+    return query->codeCount++;
+}
+
+/*
+ * PatchJumps - Point the listed jump instructions at the current end of the program
+ */
+static void PatchJumps(Parser* parser, const int* jumps, int jumpCount)
+{
+    for (int i = 0; i < jumpCount; i++)
+    {
+        if (jumps[i] >= 0)
+            parser->query->code[jumps[i]].arg = parser->query->codeCount;
+    }
+}
+
+/*
+ * AddString - Copy a string (lowercased) into the pool; returns its offset
+ */
+static int AddString(Parser* parser, const wchar_t* text, int length)
+{
+    Query* query = parser->query;
+
+    if (query->poolLength + length + 1 > query->poolCapacity)
+    {
+        int newCapacity = (query->poolCapacity ? query->poolCapacity * 2 : 256) + length + 1;
+        wchar_t* newPool = (wchar_t*)realloc(query->pool, newCapacity * sizeof(wchar_t));
+        if (newPool == NULL)
+        {
+            SetError(parser, L"Out of memory", NULL);
+            return -1;
+        }
+        query->pool = newPool;
+        query->poolCapacity = newCapacity;
+    }
+
+    int offset = query->poolLength;
+    for (int i = 0; i < length; i++)
+        query->pool[offset + i] = (wchar_t)towlower(text[i]);
+    query->pool[offset + length] = L'\0';
+    query->poolLength += length + 1;
+    return offset;
+}
+
+/*
+ * NextToken - Read the next token into parser->token
+ */
+static void NextToken(Parser* parser)
+{
+    Token* token = &parser->token;
+    const wchar_t* p = parser->p;
+
+    token->field[0] = L'\0';
+    token->value[0] = L'\0';
+    token->quoted = FALSE;
+
+    while (iswspace(*p))
+        p++;
+
+    if (*p == L'\0')
+    {
+        token->kind = TOKEN_END;
+    }
+    else if (*p == L'(')
+    {
+        token->kind = TOKEN_LPAREN;
+        p++;
+    }
+    else if (*p == L')')
+    {
+        token->kind = TOKEN_RPAREN;
+        p++;
+    }
+    else if (*p == L'|')
+    {
+        token->kind = TOKEN_OR;
+        p++;
+    }
+    else if (*p == L'-' && p[1] != L'\0' && !iswspace(p[1]))
+    {
+        token->kind = TOKEN_NOT;
+        p++;
+    }
+    else
+    {
+        token->kind = TOKEN_TERM;
+
+        // Optional "field:" prefix
+        const wchar_t* colon = p;
+        while (iswalpha(*colon))
+            colon++;
+        if (*colon == L':' && colon > p)
+        {
+            int fieldLength = (int)(colon - p);
+            if (fieldLength >= (int)ARRAYSIZE(token->field))
+                fieldLength = (int)ARRAYSIZE(token->field) - 1;
+            wcsncpy_s(token->field, ARRAYSIZE(token->field), p, fieldLength);
+            p = colon + 1;
+        }
+
+        int length = 0;
+        if (*p == L'"')
+        {
+            // Quoted phrase - everything up to the closing quote
+            token->quoted = TRUE;
+            p++;
+            while (*p != L'\0' && *p != L'"')
+            {
+                if (length < (int)ARRAYSIZE(token->value) - 1)
+                    token->value[length++] = *p;
+                p++;
+            }
+            if (*p == L'"')
+                p++;
+            else
+                SetError(parser, L"Missing closing quote", NULL);
+        }
+        else if (_wcsicmp(token->field, L"re") == 0)
+        {
+            // Regular expressions use ( ) and | themselves: read up to a space
+            // or a ')' that closes a group of the query rather than the pattern
+            int depth = 0;
+            while (*p != L'\0' && !iswspace(*p) && (*p != L')' || depth > 0))
+            {
+                if (*p == L'\\' && p[1] != L'\0')
+                {
+                    if (length < (int)ARRAYSIZE(token->value) - 2)
+                        token->value[length++] = *p;
+                    p++;
+                }
+                else if (*p == L'(')
+                {
+                    depth++;
+                }
+                else if (*p == L')')
+                {
+                    depth--;
+                }
+                if (length < (int)ARRAYSIZE(token->value) - 1)
+                    token->value[length++] = *p;
+                p++;
+            }
+        }
+        else
+        {
+            while (*p != L'\0' && !iswspace(*p) && *p != L'(' && *p != L')' && *p != L'|')
+            {
+                if (length < (int)ARRAYSIZE(token->value) - 1)
+                    token->value[length++] = *p;
+                p++;
+            }
+        }
+        token->value[length] = L'\0';
+
+        // A bare, unquoted OR is the operator
+        if (!token->quoted && token->field[0] == L'\0' && wcscmp(token->value, L"OR") == 0)
+            token->kind = TOKEN_OR;
+    }
+
+    parser->p = p;
+}
+
+/*
+ * RelativeTimeKey - Timestamp key for "amount units ago"
+ */
+static ULONGLONG RelativeTimeKey(const Parser* parser, ULONGLONG amount, wchar_t unit)
+{
+    ULONGLONG seconds = (unit == L'h') ? 3600ULL : (unit == L'w') ? 7ULL * 86400ULL : 86400ULL;
+    ULONGLONG delta = amount * seconds * 10000000ULL;     // FILETIME ticks are 100ns
+    ULONGLONG ticks = (delta < parser->nowFileTime) ? parser->nowFileTime - delta : 0;
+
+    FILETIME ft;
+    SYSTEMTIME st;
+    ft.dwLowDateTime = (DWORD)(ticks & 0xFFFFFFFFULL);
+    ft.dwHighDateTime = (DWORD)(ticks >> 32);
+    if (!FileTimeToSystemTime(&ft, &st))
+        return 0;
+
+    return (ULONGLONG)st.wYear * 10000000000ULL + (ULONGLONG)st.wMonth * 100000000ULL +
+           (ULONGLONG)st.wDay * 1000000ULL + (ULONGLONG)st.wHour * 10000ULL +
+           (ULONGLONG)st.wMinute * 100ULL + (ULONGLONG)st.wSecond;
+}
+
+/*
+ * ParseDateValue - Read "YYYY-MM-DD": four, two and two digits, nothing more
+ */
+static BOOL ParseDateValue(const wchar_t* text, int* year, int* month, int* day)
+{
+    static const wchar_t shape[] = L"0000-00-00";
+    int fields[3] = {0, 0, 0};
+    int field = 0;
+
+    for (int i = 0; i < (int)ARRAYSIZE(shape) - 1; i++)
+    {
+        if (shape[i] == L'-')
+        {
+            if (text[i] != L'-')
+                return FALSE;
+            field++;
+        }
+        else
+        {
+            if (text[i] < L'0' || text[i] > L'9')
+                return FALSE;
+            fields[field] = fields[field] * 10 + (text[i] - L'0');
+        }
+    }
+    if (text[ARRAYSIZE(shape) - 1] != L'\0')
+        return FALSE;
+
+    *year = fields[0];
+    *month = fields[1];
+    *day = fields[2];
+    return TRUE;
+}
+
+/*
+ * CompileLastTerm - Compile a "last:" term into a timestamp range test
+ *
+ * Accepted values: never, [op]N(h|d|w), [op]YYYY-MM-DD with op one of
+ * < <= > >= =. Hosts that were never connected only match "never".
+ */
+static void CompileLastTerm(Parser* parser, const wchar_t* value)
+{
+    const ULONGLONG latest = TIMESTAMP_NEVER - 1;   // Any real timestamp
+
+    if (_wcsicmp(value, L"never") == 0)
+    {
+        Emit(parser, OP_LAST_RANGE, 0, 0, TIMESTAMP_NEVER, TIMESTAMP_NEVER);
+        return;
+    }
+
+    // Comparison operator
+    const wchar_t* p = value;
+    wchar_t op = L'=';
+    BOOL orEqual = FALSE;
+    if (*p == L'<' || *p == L'>' || *p == L'=')
+    {
+        op = *p++;
+        if (op != L'=' && *p == L'=')
+        {
+            orEqual = TRUE;
+            p++;
+        }
+    }
+
+    // Relative: digits followed by h, d or w
+    const wchar_t* digits = p;
+    ULONGLONG amount = 0;
+    while (*p >= L'0' && *p <= L'9' && amount < 1000000ULL)
+        amount = amount * 10 + (ULONGLONG)(*p++ - L'0');
+
+    if (p > digits && (*p == L'h' || *p == L'd' || *p == L'w') && p[1] == L'\0')
+    {
+        ULONGLONG threshold = RelativeTimeKey(parser, amount, *p);
+
+        if (op == L'<' || digits == value)
+        {
+            // "<30d" or "30d": within the last 30 days
+            Emit(parser, OP_LAST_RANGE, 0, 0, threshold, latest);
+        }
+        else if (op == L'>')
+        {
+            // ">30d": longer ago than 30 days
+            Emit(parser, OP_LAST_RANGE, 0, 0, 0, threshold);
+        }
+        else
+        {
+            SetError(parser, L"Use < or > with a relative time:", value);
+        }
+        return;
+    }
+
+    // Absolute date: exactly YYYY-MM-DD
+    int year = 0, month = 0, day = 0;
+    if (!ParseDateValue(digits, &year, &month, &day) ||
+        year < 1900 || month < 1 || month > 12 || day < 1 || day > 31)
+    {
+        SetError(parser, L"Invalid date in", value);
+        return;
+    }
+
+    ULONGLONG dayStart = ((ULONGLONG)year * 10000ULL + (ULONGLONG)month * 100ULL + (ULONGLONG)day) * 1000000ULL;
+    ULONGLONG dayEnd = dayStart + 235959ULL;
+
+    switch (op)
+    {
+        case L'<':
+            Emit(parser, OP_LAST_RANGE, 0, 0, 0, orEqual ? dayEnd : dayStart - 1);
+            break;
+        case L'>':
+            Emit(parser, OP_LAST_RANGE, 0, 0, orEqual ? dayStart : dayEnd + 1, latest);
+            break;
+        default:
+            Emit(parser, OP_LAST_RANGE, 0, 0, dayStart, dayEnd);
+            break;
+    }
+}
+
+/*
+ * CompileRegexTerm - Compile a "re:" term
+ *
+ * Matches the hostname or the description. A regex with the same pattern
+ * in the previous query is moved over instead of being recompiled, so the
+ * DFA states it already built survive the next keystroke.
+ */
+static void CompileRegexTerm(Parser* parser, const wchar_t* pattern)
+{
+    Query* query = parser->query;
+    Regex* regex = NULL;
+
+    if (parser->previous != NULL)
+    {
+        for (int i = 0; i < parser->previous->regexCount; i++)
+        {
+            Regex* candidate = parser->previous->regexes[i];
+            if (candidate != NULL && wcscmp(GetRegexPattern(candidate), pattern) == 0)
+            {
+                regex = candidate;
+                parser->previous->regexes[i] = NULL;
+                break;
+            }
+        }
+    }
+
+    if (regex == NULL)
+    {
+        wchar_t regexError[64];
+        regex = CompileRegex(pattern, regexError, ARRAYSIZE(regexError));
+        if (regex == NULL)
+        {
+            SetError(parser, L"Invalid regex:", regexError);
+            return;
+        }
+    }
+
+    if (query->regexCount == query->regexCapacity)
+    {
+        int newCapacity = query->regexCapacity ? query->regexCapacity * 2 : 4;
+        Regex** newRegexes = (Regex**)realloc(query->regexes, newCapacity * sizeof(Regex*));
+        if (newRegexes == NULL)
+        {
+            FreeRegex(regex);
+            SetError(parser, L"Out of memory", NULL);
+            return;
+        }
+        query->regexes = newRegexes;
+        query->regexCapacity = newCapacity;
+    }
+
+    int number = query->regexCount++;
+    query->regexes[number] = regex;
+    Emit(parser, OP_REGEX, QUERY_FIELD_HOSTNAME | QUERY_FIELD_DESCRIPTION, number, 0, 0);
+}
+
+/*
+ * CompileTerm - Compile one search term
+ */
+static void CompileTerm(Parser* parser)
+{
+    Token* token = &parser->token;
+    BYTE fields;
+
+    if (token->field[0] == L'\0')
+    {
+        fields = QUERY_FIELD_HOSTNAME | QUERY_FIELD_DESCRIPTION;
+
+        // Bare "never" is shorthand for last:never
+        if (!token->quoted && _wcsicmp(token->value, L"never") == 0)
+        {
+            CompileLastTerm(parser, token->value);
+            NextToken(parser);
+            return;
+        }
+    }
+    else if (_wcsicmp(token->field, L"host") == 0 || _wcsicmp(token->field, L"hostname") == 0)
+    {
+        fields = QUERY_FIELD_HOSTNAME;
+    }
+    else if (_wcsicmp(token->field, L"desc") == 0 || _wcsicmp(token->field, L"description") == 0)
+    {
+        fields = QUERY_FIELD_DESCRIPTION;
+    }
+    else if (_wcsicmp(token->field, L"re") == 0)
+    {
+        if (token->value[0] == L'\0')
+            SetError(parser, L"Missing value after", L"re:");
+        else
+            CompileRegexTerm(parser, token->value);
+        NextToken(parser);
+        return;
+    }
+    else if (_wcsicmp(token->field, L"last") == 0)
+    {
+        if (token->value[0] == L'\0')
+            SetError(parser, L"Missing value after", L"last:");
+        else
+            CompileLastTerm(parser, token->value);
+        NextToken(parser);
+        return;
+    }
+    else
+    {
+        SetError(parser, L"Unknown field", token->field);
+        return;
+    }
+
+    int length = (int)wcslen(token->value);
+    if (length == 0)
+    {
+        SetError(parser, L"Missing value after", token->field);
+        return;
+    }
+
+    int text = AddString(parser, token->value, length);
+    if (text < 0)
+        return;
+
+    const wchar_t* stored = parser->query->pool + text;
+    int literalLength = (int)wcscspn(stored, L"*?");
+    BOOL isGlob = (literalLength < length);
+    Emit(parser, isGlob ? OP_GLOB : OP_TEXT, fields, text, 0, 0);
+
+    Query* query = parser->query;
+
+    // The first plain term that is not negated is what gets highlighted
+    if (parser->negationDepth == 0 && query->highlightText < 0 && literalLength > 0)
+    {
+        if (isGlob)
+        {
+            int prefix = AddString(parser, token->value, literalLength);
+            query->highlightText = prefix;
+        }
+        else
+        {
+            query->highlightText = text;
+        }
+        query->highlightFields = fields;
+    }
+
+    // host:abc* at the top level means every match starts with "abc"
+    if (isGlob && fields == QUERY_FIELD_HOSTNAME && parser->negationDepth == 0 &&
+        parser->groupDepth == 0 && literalLength > query->hostPrefixLength)
+    {
+        query->hostPrefix = text;
+        query->hostPrefixLength = literalLength;
+    }
+
+    NextToken(parser);
+}
+
+/*
+ * ParseUnary - term | -unary | ( or-expression )
+ */
+static void ParseUnary(Parser* parser)
+{
+    switch (parser->token.kind)
+    {
+        case TOKEN_NOT:
+            NextToken(parser);
+            parser->negationDepth++;
+            ParseUnary(parser);
+            parser->negationDepth--;
+            Emit(parser, OP_NOT, 0, 0, 0, 0);
+            break;
+
+        case TOKEN_LPAREN:
+            NextToken(parser);
+            if (parser->token.kind == TOKEN_RPAREN)
+            {
+                SetError(parser, L"Empty parentheses", NULL);
+                return;
+            }
+            parser->groupDepth++;
+            ParseOr(parser);
+            parser->groupDepth--;
+            if (parser->token.kind != TOKEN_RPAREN)
+            {
+                SetError(parser, L"Missing )", NULL);
+                return;
+            }
+            NextToken(parser);
+            break;
+
+        case TOKEN_TERM:
+            CompileTerm(parser);
+            break;
+
+        case TOKEN_OR:
+            SetError(parser, L"Nothing before", L"OR");
+            break;
+
+        case TOKEN_RPAREN:
+            SetError(parser, L"Unexpected )", NULL);
+            break;
+
+        case TOKEN_END:
+            SetError(parser, L"Incomplete query", NULL);
+            break;
+    }
+}
+
+/*
+ * ParseAnd - unary unary ... (all must match)
+ */
+static void ParseAnd(Parser* parser)
+{
+    int jumps[64];
+    int jumpCount = 0;
+
+    ParseUnary(parser);
+
+    while (!parser->failed &&
+           (parser->token.kind == TOKEN_TERM || parser->token.kind == TOKEN_NOT ||
+            parser->token.kind == TOKEN_LPAREN))
+    {
+        if (jumpCount == (int)ARRAYSIZE(jumps))
+        {
+            SetError(parser, L"Query too long", NULL);
+            return;
+        }
+        // Stop at the first term that does not match
+        jumps[jumpCount++] = Emit(parser, OP_JUMP_IF_FALSE, 0, 0, 0, 0);
+        ParseUnary(parser);
+    }
+
+    PatchJumps(parser, jumps, jumpCount);
+}
+
+/*
+ * ParseOr - and-expression OR and-expression ...
+ */
+static void ParseOr(Parser* parser)
+{
+    int jumps[64];
+    int jumpCount = 0;
+
+    ParseAnd(parser);
+
+    while (!parser->failed && parser->token.kind == TOKEN_OR)
+    {
+        if (parser->groupDepth == 0 && parser->negationDepth == 0)
+            parser->topLevelOr = TRUE;
+
+        NextToken(parser);
+        if (parser->token.kind == TOKEN_END || parser->token.kind == TOKEN_RPAREN)
+        {
+            SetError(parser, L"Nothing after", L"OR");
+            return;
+        }
+        if (jumpCount == (int)ARRAYSIZE(jumps))
+        {
+            SetError(parser, L"Query too long", NULL);
+            return;
+        }
+        // Stop at the first alternative that matches
+        jumps[jumpCount++] = Emit(parser, OP_JUMP_IF_TRUE, 0, 0, 0, 0);
+        ParseAnd(parser);
+    }
+
+    PatchJumps(parser, jumps, jumpCount);
+}
+
+/*
+ * CompileQuery - Compile search box text into a query program
+ *
+ * Parameters:
+ *   text     - Query text (NULL or empty matches every host)
+ *   previous - Query compiled for earlier text (may be NULL); regexes it
+ *              shares with the new query are moved over, not recompiled
+ *   error    - Receives a short message if the query is invalid (may be NULL)
+ *   errorLen - Size of error in characters
+ *
+ * Returns the compiled query (free with FreeQuery), or NULL on error.
+ */
+Query* CompileQuery(const wchar_t* text, Query* previous, wchar_t* error, int errorLen)
+{
+    Query* query = (Query*)calloc(1, sizeof(Query));
+    if (query == NULL)
+    {
+        if (error != NULL)
+            wcsncpy_s(error, errorLen, L"Out of memory", _TRUNCATE);
+        return NULL;
+    }
+    query->highlightText = -1;
+    query->hostPrefix = -1;
+
+    Parser parser = {0};
+    parser.p = (text != NULL) ? text : L"";
+    parser.query = query;
+    parser.error = error;
+    parser.errorLen = errorLen;
+    parser.previous = previous;
+    if (error != NULL)
+        error[0] = L'\0';
+
+    SYSTEMTIME now;
+    FILETIME nowFileTime;
+    GetLocalTime(&now);
+    SystemTimeToFileTime(&now, &nowFileTime);
+    parser.nowFileTime = ((ULONGLONG)nowFileTime.dwHighDateTime << 32) | nowFileTime.dwLowDateTime;
+
+    NextToken(&parser);
+    if (parser.token.kind != TOKEN_END)
+    {
+        ParseOr(&parser);
+        if (!parser.failed && parser.token.kind == TOKEN_RPAREN)
+            SetError(&parser, L"Unexpected )", NULL);
+    }
+
+    if (parser.failed)
+    {
+        FreeQuery(query);
+        return NULL;
+    }
+
+    if (parser.topLevelOr)
+    {
+        query->hostPrefix = -1;
+        query->hostPrefixLength = 0;
+    }
+    return query;
+}
+
+/*
+ * FreeQuery - Free a compiled query
+ */
+void FreeQuery(Query* query)
+{
+    if (query == NULL)
+        return;
+
+    for (int i = 0; i < query->regexCount; i++)
+        FreeRegex(query->regexes[i]);
+    free(query->regexes);
+    free(query->code);
+    free(query->pool);
+    free(query);
+}
+
+/*
+ * FieldsMatch - Run a text, wildcard or regex test against the selected fields
+ */
+static BOOL FieldsMatch(const Query* query, const QueryInstr* instr, const Host* host)
+{
+    if (instr->op == OP_REGEX)
+    {
+        Regex* regex = query->regexes[instr->arg];
+        return ((instr->fields & QUERY_FIELD_HOSTNAME) && RegexSearch(regex, host->hostname)) ||
+               ((instr->fields & QUERY_FIELD_DESCRIPTION) && RegexSearch(regex, host->description));
+    }
+
+    const wchar_t* text = query->pool + instr->arg;
+    if (instr->op == OP_GLOB)
+    {
+        return ((instr->fields & QUERY_FIELD_HOSTNAME) && GlobMatchNoCase(host->hostname, text)) ||
+               ((instr->fields & QUERY_FIELD_DESCRIPTION) && GlobMatchNoCase(host->description, text));
+    }
+
+    return ((instr->fields & QUERY_FIELD_HOSTNAME) && FindTextNoCase(host->hostname, text) >= 0) ||
+           ((instr->fields & QUERY_FIELD_DESCRIPTION) && FindTextNoCase(host->description, text) >= 0);
+}
+
+/*
+ * EvaluateQuery - Run the compiled program against one host
+ *
+ * Returns TRUE if the host matches. An empty query matches every host.
+ */
+BOOL EvaluateQuery(const Query* query, const Host* host)
+{
+    BOOL result = TRUE;
+    ULONGLONG lastKey = 0;
+    BOOL haveLastKey = FALSE;
+    int pc = 0;
+
+    while (pc < query->codeCount)
+    {
+        const QueryInstr* instr = &query->code[pc];
+
+        switch (instr->op)
+        {
+            case OP_TEXT:
+            case OP_GLOB:
+            case OP_REGEX:
+                result = FieldsMatch(query, instr, host);
+                break;
+
+            case OP_LAST_RANGE:
+                // Parse the timestamp at most once per host
+                if (!haveLastKey)
+                {
+                    lastKey = TimestampSortKey(host->lastConnected);
+                    haveLastKey = TRUE;
+                }
+                result = (lastKey >= instr->low && lastKey <= instr->high);
+                break;
+
+            case OP_NOT:
+                result = !result;
+                break;
+
+            case OP_JUMP_IF_FALSE:
+                if (!result)
+                {
+                    pc = instr->arg;
+                    continue;
+                }
+                break;
+
+            case OP_JUMP_IF_TRUE:
+                if (result)
+                {
+                    pc = instr->arg;
+                    continue;
+                }
+                break;
+        }
+        pc++;
+    }
+
+    return result;
+}
+
+/*
+ * GetQueryHighlight - Text to highlight in matching rows
+ *
+ * Parameters:
+ *   query     - Compiled query
+ *   textLower - Receives the lowercase text
+ *   fields    - Receives the QUERY_FIELD_xxx columns it applies to
+ *
+ * Returns FALSE if the query has nothing worth highlighting.
+ */
+BOOL GetQueryHighlight(const Query* query, const wchar_t** textLower, int* fields)
+{
+    if (query == NULL || query->highlightText < 0)
+        return FALSE;
+
+    *textLower = query->pool + query->highlightText;
+    *fields = query->highlightFields;
+    return TRUE;
+}
+
+/*
+ * GetQueryHostPrefix - Hostname prefix every matching host must have
+ *
+ * Set when the query requires host:prefix* at the top level (not inside
+ * an OR, a group or a negation), which lets callers with a sorted
+ * hostname index skip every host outside the prefix range.
+ *
+ * Returns FALSE if there is no such prefix.
+ */
+BOOL GetQueryHostPrefix(const Query* query, const wchar_t** prefixLower, int* prefixLength)
+{
+    if (query == NULL || query->hostPrefix < 0)
+        return FALSE;
+
+    *prefixLower = query->pool + query->hostPrefix;
+    *prefixLength = query->hostPrefixLength;
+    return TRUE;
+}
@@ -0,0 +1,51 @@
+/*
+ * Search Query Header
+ *
+ * The search box accepts a small query language:
+ *
+ *   sql                 hostname or description contains "sql"
+ *   host:sql*           hostname matches a wildcard pattern (* and ?)
+ *   desc:"london dc"    description contains a phrase
+ *   last:<30d           connected within the last 30 days (also h, w)
+ *   last:>2025-01-31    connected after a date (<, <=, >, >=, =)
+ *   last:never  never   never connected
+ *   re:^(web|app)\d{2}  hostname or description matches a regular expression
+ *   -term               negation
+ *   a OR b   a | b      either term (terms next to each other must all match)
+ *   ( ... )             grouping
+ *
+ * A query is compiled once into a short predicate program that is then run
+ * for every host. Queries with re: terms cache DFA states while they run,
+ * so a compiled query must only be evaluated by one thread at a time.
+ */
+
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <windows.h>
+#include "hosts.h"
+
+// Fields a text term can look at
+#define QUERY_FIELD_HOSTNAME    0x01
+#define QUERY_FIELD_DESCRIPTION 0x02
+
+typedef struct Query Query;
+
+// Compile query text; returns NULL and fills error on a syntax error.
+// Regexes shared with previous (may be NULL) are moved over, not rebuilt.
+Query* CompileQuery(const wchar_t* text, Query* previous, wchar_t* error, int errorLen);
+void FreeQuery(Query* query);
+
+// Run the compiled program against one host
+BOOL EvaluateQuery(const Query* query, const Host* host);
+
+// Text (lowercase) and fields to highlight in matching rows; FALSE if none
+BOOL GetQueryHighlight(const Query* query, const wchar_t** textLower, int* fields);
+
+// Lowercase hostname prefix every match must start with; FALSE if none
+BOOL GetQueryHostPrefix(const Query* query, const wchar_t** prefixLower, int* prefixLength);
+
+// Case-insensitive substring search (needle already lowercase); -1 if absent
+int FindTextNoCase(const wchar_t* haystack, const wchar_t* needleLower);
+
+#endif // QUERY_H
@@ -8,8 +8,12 @@
  * the remote desktop connection. Windows reads these files to know
  * how to connect to a server.
  * 
+ * Each host keeps one file, rendered from its connection profile and only
+ * rewritten when its contents change.
+ * 
  * Learning points:
  *   - File I/O for creating temporary files
+ *   - Rendering text from settings kept in their final encoding
  *   - ShellExecuteW for launching applications
  *   - Working with temporary directories
  */
@@ -17,11 +21,13 @@
 #include <windows.h>
 #include <shellapi.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 #include <shlobj.h>
 #include "config.h"
 #include "credentials.h"
 #include "hosts.h"
+#include "profiles.h"
 #include "rdp.h"
 
 /*
@@ -100,6 +106,138 @@ static BOOL GetRDPStoragePath(wchar_t* path, size_t pathLen)
     return TRUE;
 }
 
+/*
+ * .rdp contents
+ * 
+ * The lines of the file come from the host's resolved profile (see
+ * profiles.c): the built-in settings with any changes from profiles.ini.
+ * Keys and values are kept exactly as they go into the file - UTF-8, with
+ * CRLF line ends added here as the earlier text-mode UTF-8 stream wrote
+ * them (so files written by older versions compare equal and are left
+ * alone). Rendering is a few memcpy calls plus converting the hostname
+ * and username to UTF-8.
+ */
+
+// Largest rendered file: the settings plus two values of up to 3 UTF-8 bytes per character
+#define RDP_FILE_MAX_BYTES      8192
+
+/*
+ * AppendUtf8 - Convert a value to UTF-8 at the end of the buffer
+ * 
+ * Returns FALSE if it does not fit.
+ */
+static BOOL AppendUtf8(char* buffer, size_t bufferLen, size_t* length, const wchar_t* value)
+{
+    if (value[0] == L'\0')
+        return TRUE;
+    
+    int written = WideCharToMultiByte(CP_UTF8, 0, value, -1, buffer + *length,
+                                      (int)(bufferLen - *length), NULL, NULL);
+    if (written <= 0)
+        return FALSE;
+    
+    *length += written - 1;  // Without the terminator
+    return TRUE;
+}
+
+/*
+ * RenderRDPFile - Write a host's resolved settings into a buffer
+ * 
+ * Parameters:
+ *   hostname  - Server to connect to
+ *   username  - Username line to add (can be NULL or empty)
+ *   buffer    - Receives the file contents (RDP_FILE_MAX_BYTES)
+ *   length    - Receives the number of bytes
+ * 
+ * Returns:
+ *   TRUE on success, FALSE if the values do not fit
+ */
+static BOOL RenderRDPFile(const wchar_t* hostname, const wchar_t* username,
+                          char* buffer, size_t* length)
+{
+    static const char byteOrderMark[] = "\xEF\xBB\xBF";
+    RdpProfile profile;
+    
+    // Problems in profiles.ini only leave out the lines concerned
+    ResolveRdpProfile(hostname, &profile);
+    
+    memcpy(buffer, byteOrderMark, sizeof(byteOrderMark) - 1);
+    *length = sizeof(byteOrderMark) - 1;
+    
+    for (int i = 0; i < RDP_SETTING_COUNT; i++)
+    {
+        const RdpProfileLine* line = &profile.lines[i];
+        
+        // No username - leave the line out so mstsc asks
+        if (line->source == RDP_SETTING_USERNAME && (username == NULL || username[0] == L'\0'))
+            continue;
+        
+        if (*length + line->keyLength >= RDP_FILE_MAX_BYTES)
+            return FALSE;
+        memcpy(buffer + *length, line->key, line->keyLength);
+        *length += line->keyLength;
+        
+        if (line->source == RDP_SETTING_HOSTNAME)
+        {
+            if (!AppendUtf8(buffer, RDP_FILE_MAX_BYTES, length, hostname))
+                return FALSE;
+        }
+        else if (line->source == RDP_SETTING_USERNAME)
+        {
+            if (!AppendUtf8(buffer, RDP_FILE_MAX_BYTES, length, username))
+                return FALSE;
+        }
+        else
+        {
+            if (*length + line->valueLength >= RDP_FILE_MAX_BYTES)
+                return FALSE;
+            memcpy(buffer + *length, line->value, line->valueLength);
+            *length += line->valueLength;
+        }
+        
+        if (*length + 2 >= RDP_FILE_MAX_BYTES)
+            return FALSE;
+        buffer[(*length)++] = '\r';
+        buffer[(*length)++] = '\n';
+    }
+    return TRUE;
+}
+
+/*
+ * HashBytes - 64-bit FNV-1a of a byte range
+ */
+static ULONGLONG HashBytes(const char* data, size_t length)
+{
+    ULONGLONG hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (BYTE)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/*
+ * RDPFileMatches - TRUE if the file on disk holds exactly these contents
+ * 
+ * The existing file is read (it is about a kilobyte) and compared by
+ * length and hash.
+ */
+static BOOL RDPFileMatches(const wchar_t* path, size_t length, ULONGLONG hash)
+{
+    char existing[RDP_FILE_MAX_BYTES + 1];
+    FILE* file = NULL;
+    
+    if (_wfopen_s(&file, path, L"rb") != 0 || file == NULL)
+        return FALSE;
+    
+    // One byte more than expected, so a longer file shows up as a different length
+    size_t read = fread(existing, 1, sizeof(existing), file);
+    fclose(file);
+    
+    return read == length && HashBytes(existing, read) == hash;
+}
+
 /*
  * CreateRDPFile - Generate an RDP configuration file
  * 
@@ -112,6 +250,12 @@ static BOOL GetRDPStoragePath(wchar_t* path, size_t pathLen)
  * Returns:
  *   TRUE on success, FALSE on failure
  * 
+ * The contents are rendered in memory first. If the host's file already
+ * holds them, it is not written again: connecting does no disk writes in
+ * the usual case, and mstsc keeps trusting the unchanged file. Otherwise
+ * the file is written next to the old one (under a name of the writing
+ * thread's own) and moved over it.
+ * 
  * The RDP file format is documented at:
  * https://docs.microsoft.com/en-us/windows-server/remote/remote-desktop-services/clients/rdp-files
  */
@@ -119,10 +263,17 @@ BOOL CreateRDPFile(const wchar_t* hostname, const wchar_t* username,
                    wchar_t* outputPath, size_t outputLen)
 {
     FILE* file = NULL;
-    errno_t err;
     wchar_t storagePath[MAX_PATH];
     wchar_t rdpPath[MAX_PATH];
+    wchar_t tempPath[MAX_PATH];
     wchar_t sanitizedHost[MAX_PATH];
+    char contents[RDP_FILE_MAX_BYTES];
+    size_t length;
+    
+    if (!RenderRDPFile(hostname, username, contents, &length))
+    {
+        return FALSE;
+    }
     
     // Get the persistent storage directory in AppData\Roaming
     if (!GetRDPStoragePath(storagePath, MAX_PATH))
@@ -139,77 +290,27 @@ BOOL CreateRDPFile(const wchar_t* hostname, const wchar_t* username,
     // which prevents Windows from showing the security warning repeatedly
     swprintf_s(rdpPath, MAX_PATH, L"%s\\%s.rdp", storagePath, sanitizedHost);
     
-    // Open the file for writing
-    err = _wfopen_s(&file, rdpPath, L"w, ccs=UTF-8");
-    if (err != 0 || file == NULL)
+    // Same contents as last time - nothing to write
+    if (!RDPFileMatches(rdpPath, length, HashBytes(contents, length)))
     {
-        return FALSE;
-    }
-    
-    /*
-     * Write RDP configuration
-     * 
-     * Key settings explained:
-     *   screen mode id:i:2           - Full screen mode
-     *   desktopwidth/height          - Screen resolution
-     *   session bpp:i:32             - Color depth (32-bit)
-     *   full address:s:[hostname]    - Server to connect to
-     *   authentication level:i:0     - Don't require server auth (for older servers)
-     *   prompt for credentials:i:0   - Use saved credentials, don't prompt
-     *   redirectclipboard:i:1        - Enable clipboard sharing
-     *   redirectprinters:i:1         - Enable printer redirection
-     */
-    fwprintf(file, L"screen mode id:i:2\n");
-    fwprintf(file, L"use multimon:i:0\n");
-    fwprintf(file, L"desktopwidth:i:1920\n");
-    fwprintf(file, L"desktopheight:i:1080\n");
-    fwprintf(file, L"session bpp:i:32\n");
-    fwprintf(file, L"full address:s:%ls\n", hostname);
-    fwprintf(file, L"compression:i:1\n");
-    fwprintf(file, L"keyboardhook:i:2\n");
-    fwprintf(file, L"audiocapturemode:i:0\n");
-    fwprintf(file, L"videoplaybackmode:i:1\n");
-    fwprintf(file, L"connection type:i:7\n");
-    fwprintf(file, L"networkautodetect:i:1\n");
-    fwprintf(file, L"bandwidthautodetect:i:1\n");
-    fwprintf(file, L"displayconnectionbar:i:1\n");
-    fwprintf(file, L"enableworkspacereconnect:i:1\n");
-    fwprintf(file, L"disable wallpaper:i:0\n");
-    fwprintf(file, L"allow font smoothing:i:1\n");
-    fwprintf(file, L"allow desktop composition:i:1\n");
-    fwprintf(file, L"disable full window drag:i:0\n");
-    fwprintf(file, L"disable menu anims:i:0\n");
-    fwprintf(file, L"disable themes:i:0\n");
-    fwprintf(file, L"disable cursor setting:i:0\n");
-    fwprintf(file, L"bitmapcachepersistenable:i:1\n");
-    fwprintf(file, L"audiomode:i:0\n");
-    fwprintf(file, L"redirectprinters:i:1\n");
-    fwprintf(file, L"redirectcomports:i:0\n");
-    fwprintf(file, L"redirectsmartcards:i:1\n");
-    fwprintf(file, L"redirectclipboard:i:1\n");
-    fwprintf(file, L"redirectposdevices:i:0\n");
-    fwprintf(file, L"autoreconnection enabled:i:1\n");
-    fwprintf(file, L"authentication level:i:0\n");
-    fwprintf(file, L"prompt for credentials:i:0\n");
-    fwprintf(file, L"negotiate security layer:i:1\n");
-    fwprintf(file, L"remoteapplicationmode:i:0\n");
-    fwprintf(file, L"alternate shell:s:\n");
-    fwprintf(file, L"shell working directory:s:\n");
-    fwprintf(file, L"gatewayhostname:s:\n");
-    fwprintf(file, L"gatewayusagemethod:i:4\n");
-    fwprintf(file, L"gatewaycredentialssource:i:4\n");
-    fwprintf(file, L"gatewayprofileusagemethod:i:0\n");
-    fwprintf(file, L"promptcredentialonce:i:1\n");
-    fwprintf(file, L"use redirection server name:i:0\n");
-    
-    // Add username if provided
-    if (username != NULL && wcslen(username) > 0)
-    {
-        fwprintf(file, L"username:s:%ls\n", username);
+        // The launcher thread and the UI thread can both write the same
+        // host's file, so each writes its own temp file
+        swprintf_s(tempPath, MAX_PATH, L"%s.%lu.tmp", rdpPath, GetCurrentThreadId());
+        if (_wfopen_s(&file, tempPath, L"wb") != 0 || file == NULL)
+        {
+            return FALSE;
+        }
+        
+        BOOL ok = (fwrite(contents, 1, length, file) == length);
+        ok = (fclose(file) == 0) && ok;
+        ok = ok && MoveFileExW(tempPath, rdpPath, MOVEFILE_REPLACE_EXISTING);
+        if (!ok)
+        {
+            DeleteFileW(tempPath);
+            return FALSE;
+        }
     }
     
-    fclose(file);
-    
     // Return the path to the caller
     wcsncpy_s(outputPath, outputLen, rdpPath, _TRUNCATE);
     
@@ -244,9 +345,42 @@ BOOL CreateRDPFile(const wchar_t* hostname, const wchar_t* username,
  *   1. Check for per-host credentials (WinRDP:TERMSRV/hostname)
  *   2. If not found, check for global credentials (WinRDP:DefaultCredentials)
  *   3. If neither found, show error and return FALSE
+ * 
+ * Errors are shown in a message box; StartRDPSession does the work and
+ * returns the message instead.
  */
 BOOL LaunchRDP(const wchar_t* hostname, const wchar_t* username, 
                const wchar_t* password)
+{
+    wchar_t errorMsg[256];
+    
+    if (!StartRDPSession(hostname, username, password, errorMsg, 256))
+    {
+        MessageBoxW(NULL, errorMsg, L"Error", MB_OK | MB_ICONERROR);
+        return FALSE;
+    }
+    
+    return TRUE;
+}
+
+/*
+ * StartRDPSession - LaunchRDP without any UI
+ * 
+ * For worker threads: instead of showing a message box, a failure is
+ * described in error, for the UI thread to show with the right owner.
+ * 
+ * Parameters:
+ *   hostname - The RDP server to connect to
+ *   username - Username (if NULL, uses credential lookup strategy)
+ *   password - Password (if NULL, uses credential lookup strategy)
+ *   error    - Receives the error message on failure
+ *   errorLen - Size of the error buffer
+ * 
+ * Returns:
+ *   TRUE if mstsc was started, FALSE on failure
+ */
+BOOL StartRDPSession(const wchar_t* hostname, const wchar_t* username, 
+                     const wchar_t* password, wchar_t* error, size_t errorLen)
 {
     wchar_t rdpPath[MAX_PATH];
     wchar_t actualUsername[MAX_USERNAME_LEN];
@@ -271,10 +405,9 @@ BOOL LaunchRDP(const wchar_t* hostname, const wchar_t* username,
         else
         {
             // No credentials available - neither per-host nor global
-            MessageBoxW(NULL, 
-                       L"No credentials provided and no credentials saved.\n"
-                       L"Please enter credentials first.",
-                       L"Error", MB_OK | MB_ICONERROR);
+            wcsncpy_s(error, errorLen,
+                      L"No credentials provided and no credentials saved.\n"
+                      L"Please enter credentials first.", _TRUNCATE);
             return FALSE;
         }
     }
@@ -287,18 +420,18 @@ BOOL LaunchRDP(const wchar_t* hostname, const wchar_t* username,
     
     // Save credentials for this specific RDP session
     // The format TERMSRV/hostname is what Windows RDP client expects
-    if (!SaveRDPCredentials(hostname, actualUsername, actualPassword))
+    if (!WriteRDPCredentials(hostname, actualUsername, actualPassword))
     {
-        MessageBoxW(NULL, L"Failed to save RDP credentials.", 
-                   L"Error", MB_OK | MB_ICONERROR);
+        swprintf_s(error, errorLen, 
+                  L"Failed to save RDP credentials.\nError code: %lu", 
+                  GetLastError());
         return FALSE;
     }
     
     // Create the RDP file
     if (!CreateRDPFile(hostname, actualUsername, rdpPath, MAX_PATH))
     {
-        MessageBoxW(NULL, L"Failed to create RDP file.", 
-                   L"Error", MB_OK | MB_ICONERROR);
+        wcsncpy_s(error, errorLen, L"Failed to create RDP file.", _TRUNCATE);
         return FALSE;
     }
     
@@ -334,11 +467,9 @@ BOOL LaunchRDP(const wchar_t* hostname, const wchar_t* username,
     // Check for errors
     if ((INT_PTR)result <= 32)
     {
-        wchar_t errorMsg[256];
-        swprintf_s(errorMsg, 256, 
+        swprintf_s(error, errorLen, 
                   L"Failed to launch RDP client.\nError code: %d", 
                   (int)(INT_PTR)result);
-        MessageBoxW(NULL, errorMsg, L"Error", MB_OK | MB_ICONERROR);
         return FALSE;
     }
     
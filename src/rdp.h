@@ -13,6 +13,9 @@ BOOL CreateRDPFile(const wchar_t* hostname, const wchar_t* username,
 BOOL LaunchRDP(const wchar_t* hostname, const wchar_t* username, 
                const wchar_t* password);
 
+BOOL StartRDPSession(const wchar_t* hostname, const wchar_t* username, 
+                     const wchar_t* password, wchar_t* error, size_t errorLen);
+
 BOOL LaunchRDPWithDefaults(const wchar_t* hostname);
 
 #endif // RDP_H
@@ -0,0 +1,1351 @@
+/*
+ * Regular Expression Module
+ *
+ * A small regular expression engine for searching hostnames and
+ * descriptions. It never backtracks, so a pattern like (a|aa)*b cannot
+ * hang the search worker on a long hostname.
+ *
+ * How it works:
+ *   1. The pattern is parsed into a syntax tree.
+ *   2. The tree is compiled to an NFA (Thompson's construction): a graph of
+ *      states where "character" states consume one character and "split"
+ *      states fork without consuming anything. {n,m} is expanded into
+ *      copies, so the NFA never needs counters.
+ *   3. Matching runs a DFA whose states are sets of NFA states. DFA states
+ *      and their transitions are created the first time the text needs
+ *      them and then reused for every later host, so after a few hosts the
+ *      search is one table lookup per character.
+ *
+ * Memory cap:
+ *   A DFA can have exponentially many states in the worst case. The cache
+ *   is capped at REGEX_DFA_MEMORY_CAP; when it fills up it is simply thrown
+ *   away and rebuilt on demand. Matching stays linear, it just gets slower.
+ *
+ * Alphabet:
+ *   Instead of 65536 transitions per DFA state, characters are grouped
+ *   into classes that the pattern cannot tell apart (for "[0-9]x" that is
+ *   digits, 'x' and everything else), and a DFA state has one transition
+ *   per class.
+ *
+ * Case-insensitivity:
+ *   The text is lowercased as it is read and pattern literals are
+ *   lowercased when compiled. Uppercase ASCII ranges in [] also get their
+ *   lowercase counterparts, so [A-Z] behaves like [a-z].
+ *
+ * Learning points:
+ *   - Recursive descent parsing of regular expressions
+ *   - Thompson NFA construction with patch lists
+ *   - Lazy subset construction (an on-demand DFA) with a bounded cache
+ *   - Character class partitioning to keep transition tables small
+ */
+
+#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wctype.h>
+#include "regex.h"
+
+#define REGEX_MAX_NODES         4096            // Syntax tree nodes
+#define REGEX_MAX_NFA_STATES    8192            // NFA states after {n,m} expansion
+#define REGEX_MAX_RANGES        1024            // Character ranges in all classes
+#define REGEX_MAX_REPEAT        100             // Largest n or m in {n,m}
+#define REGEX_DFA_MEMORY_CAP    (1024 * 1024)   // Bytes of cached DFA states
+#define REGEX_CHAR_MAX          0xFFFF
+
+typedef struct {
+    wchar_t low;
+    wchar_t high;
+} CharRange;
+
+// Syntax tree
+typedef enum {
+    NODE_EMPTY,
+    NODE_CLASS,         // One character from ranges
+    NODE_CONCAT,        // left then right
+    NODE_ALT,           // left or right
+    NODE_STAR,          // left*
+    NODE_PLUS,          // left+
+    NODE_QUEST,         // left?
+    NODE_REPEAT,        // left{min,max} (max = -1 for no limit)
+    NODE_BOL,           // ^
+    NODE_EOL            // $
+} NodeType;
+
+typedef struct {
+    BYTE type;
+    int left;
+    int right;
+    int min;
+    int max;
+    int rangeStart;
+    int rangeCount;
+} Node;
+
+// NFA
+typedef enum {
+    NFA_CHAR,           // Consume one character in ranges, go to out
+    NFA_SPLIT,          // Go to out and out1
+    NFA_EPSILON,        // Go to out
+    NFA_BOL,            // Go to out at the start of the text
+    NFA_EOL,            // Go to out at the end of the text
+    NFA_MATCH
+} NfaType;
+
+typedef struct {
+    BYTE type;
+    int out;
+    int out1;
+    int rangeStart;
+    int rangeCount;
+} NfaState;
+
+// Partially built NFA fragment: its entry state and its list of dangling exits
+typedef struct {
+    int start;
+    int out;
+} Fragment;
+
+// DFA state = a set of NFA states (CHAR and EOL states only)
+typedef struct {
+    int setStart;       // Offset in setPool
+    int setCount;
+    BOOL accept;        // MATCH reached - the text matches
+    BOOL acceptAtEnd;   // MATCH reachable if the text ends here
+} DfaState;
+
+struct Regex {
+    wchar_t* pattern;
+
+    CharRange* ranges;
+    int rangeCount;
+
+    NfaState* nfa;
+    int nfaCount;
+    int nfaStart;
+
+    // Alphabet partition
+    int* classStarts;           // First character of each class, ascending
+    int classCount;
+    WORD asciiClass[128];
+
+    // DFA cache
+    DfaState* dfa;
+    int dfaCount;
+    int dfaCapacity;
+    int dfaLimit;               // Most states the memory cap allows
+    int* transitions;           // dfaCapacity * classCount, -1 = not built
+    int* setPool;
+    int setPoolLength;
+    int setPoolCapacity;
+    int* hashSlots;             // Open addressing, -1 = empty
+    int hashSize;
+    int startState;             // -1 = not built
+
+    // Scratch space for building sets
+    int* marks;
+    int markGeneration;
+    int* stack;
+    int* scratchSet;
+    int* endSet;
+};
+
+// Parser state
+typedef struct {
+    const wchar_t* p;
+    Regex* regex;
+    Node* nodes;
+    int nodeCount;
+    wchar_t* error;
+    int errorLen;
+    BOOL failed;
+} RegexParser;
+
+static int ParseAlternation(RegexParser* parser);
+
+/*
+ * SetRegexError - Record the first syntax error
+ */
+static void SetRegexError(RegexParser* parser, const wchar_t* message)
+{
+    if (parser->failed)
+        return;
+
+    parser->failed = TRUE;
+    if (parser->error != NULL)
+        wcsncpy_s(parser->error, parser->errorLen, message, _TRUNCATE);
+}
+
+/*
+ * NewNode - Allocate a syntax tree node; returns -1 when full
+ */
+static int NewNode(RegexParser* parser, NodeType type, int left, int right)
+{
+    if (parser->nodeCount == REGEX_MAX_NODES)
+    {
+        SetRegexError(parser, L"Pattern too long");
+        return -1;
+    }
+
+    Node* node = &parser->nodes[parser->nodeCount];
+    memset(node, 0, sizeof(Node));
+    node->type = (BYTE)type;
+    node->left = left;
+    node->right = right;
+    return parser->nodeCount++;
+}
+
+/*
+ * AddRange - Append a character range to the regex's range table
+ */
+static BOOL AddRange(RegexParser* parser, int low, int high)
+{
+    Regex* regex = parser->regex;
+
+    if (regex->rangeCount == REGEX_MAX_RANGES)
+    {
+        SetRegexError(parser, L"Too many character classes");
+        return FALSE;
+    }
+
+    regex->ranges[regex->rangeCount].low = (wchar_t)low;
+    regex->ranges[regex->rangeCount].high = (wchar_t)high;
+    regex->rangeCount++;
+    return TRUE;
+}
+
+/*
+ * CompareRanges - qsort callback ordering ranges by their first character
+ */
+static int CompareRanges(const void* a, const void* b)
+{
+    return (int)((const CharRange*)a)->low - (int)((const CharRange*)b)->low;
+}
+
+/*
+ * NormalizeRanges - Sort ranges and merge any that overlap or touch
+ *
+ * Returns the new number of ranges.
+ */
+static int NormalizeRanges(CharRange* ranges, int count)
+{
+    if (count <= 1)
+        return count;
+
+    qsort(ranges, count, sizeof(CharRange), CompareRanges);
+
+    int merged = 0;
+    for (int i = 1; i < count; i++)
+    {
+        if ((int)ranges[i].low <= (int)ranges[merged].high + 1)
+        {
+            if (ranges[i].high > ranges[merged].high)
+                ranges[merged].high = ranges[i].high;
+        }
+        else
+        {
+            ranges[++merged] = ranges[i];
+        }
+    }
+    return merged + 1;
+}
+
+/*
+ * FinishClass - Fold case, normalize and optionally complement a class
+ *
+ * The class's ranges are the tail of the range table starting at
+ * rangeStart. Returns the new number of ranges in the class.
+ */
+static int FinishClass(RegexParser* parser, int rangeStart, BOOL negated)
+{
+    Regex* regex = parser->regex;
+    int count = regex->rangeCount - rangeStart;
+
+    // The text is lowercased while matching, so [A-Z] must also cover [a-z]
+    for (int i = 0; i < count; i++)
+    {
+        CharRange r = regex->ranges[rangeStart + i];
+        int low = (r.low > L'A') ? r.low : L'A';
+        int high = (r.high < L'Z') ? r.high : L'Z';
+        if (low <= high && !AddRange(parser, low - L'A' + L'a', high - L'A' + L'a'))
+            return 0;
+    }
+
+    count = NormalizeRanges(&regex->ranges[rangeStart], regex->rangeCount - rangeStart);
+    regex->rangeCount = rangeStart + count;
+
+    if (!negated)
+        return count;
+
+    // Complement over 1..REGEX_CHAR_MAX (text never contains character 0)
+    CharRange original[REGEX_MAX_RANGES];
+    memcpy(original, &regex->ranges[rangeStart], count * sizeof(CharRange));
+    regex->rangeCount = rangeStart;
+
+    int next = 1;
+    for (int i = 0; i < count; i++)
+    {
+        if (original[i].low > next && !AddRange(parser, next, original[i].low - 1))
+            return 0;
+        next = original[i].high + 1;
+    }
+    if (next <= REGEX_CHAR_MAX && !AddRange(parser, next, REGEX_CHAR_MAX))
+        return 0;
+
+    return regex->rangeCount - rangeStart;
+}
+
+/*
+ * AddNamedClass - Add the ranges of \d, \w, \s (or their complements)
+ */
+static BOOL AddNamedClass(RegexParser* parser, wchar_t letter)
+{
+    CharRange base[4];
+    int baseCount = 0;
+
+    switch (towlower(letter))
+    {
+        case L'd':
+            base[baseCount++] = (CharRange){L'0', L'9'};
+            break;
+        case L'w':
+            base[baseCount++] = (CharRange){L'0', L'9'};
+            base[baseCount++] = (CharRange){L'A', L'Z'};
+            base[baseCount++] = (CharRange){L'_', L'_'};
+            base[baseCount++] = (CharRange){L'a', L'z'};
+            break;
+        default:    // s
+            base[baseCount++] = (CharRange){L'\t', L'\r'};
+            base[baseCount++] = (CharRange){L' ', L' '};
+            break;
+    }
+
+    if (iswlower(letter))
+    {
+        for (int i = 0; i < baseCount; i++)
+        {
+            if (!AddRange(parser, base[i].low, base[i].high))
+                return FALSE;
+        }
+        return TRUE;
+    }
+
+    // \D, \W, \S - everything the lowercase class does not cover
+    int next = 1;
+    for (int i = 0; i < baseCount; i++)
+    {
+        if (base[i].low > next && !AddRange(parser, next, base[i].low - 1))
+            return FALSE;
+        next = base[i].high + 1;
+    }
+    return AddRange(parser, next, REGEX_CHAR_MAX);
+}
+
+/*
+ * IsNamedClass - TRUE for the letters of \d \w \s \D \W \S
+ */
+static BOOL IsNamedClass(wchar_t c)
+{
+    return wcschr(L"dwsDWS", c) != NULL && c != L'\0';
+}
+
+/*
+ * EscapedChar - Character an escape like \t or \. stands for
+ */
+static wchar_t EscapedChar(wchar_t c)
+{
+    switch (c)
+    {
+        case L't': return L'\t';
+        case L'n': return L'\n';
+        case L'r': return L'\r';
+        case L'f': return L'\f';
+        case L'v': return L'\v';
+        default:   return c;
+    }
+}
+
+/*
+ * ClassNode - Create a NODE_CLASS from the ranges added since rangeStart
+ */
+static int ClassNode(RegexParser* parser, int rangeStart, BOOL negated)
+{
+    int count = FinishClass(parser, rangeStart, negated);
+    if (parser->failed)
+        return -1;
+
+    int node = NewNode(parser, NODE_CLASS, -1, -1);
+    if (node >= 0)
+    {
+        parser->nodes[node].rangeStart = rangeStart;
+        parser->nodes[node].rangeCount = count;
+    }
+    return node;
+}
+
+/*
+ * ParseBracket - [abc], [a-z0-9], [^...]; p is just past '['
+ */
+static int ParseBracket(RegexParser* parser)
+{
+    int rangeStart = parser->regex->rangeCount;
+    BOOL negated = FALSE;
+
+    if (*parser->p == L'^')
+    {
+        negated = TRUE;
+        parser->p++;
+    }
+
+    BOOL first = TRUE;
+    while (*parser->p != L'\0' && (*parser->p != L']' || first))
+    {
+        first = FALSE;
+        wchar_t low = *parser->p++;
+
+        if (low == L'\\' && *parser->p != L'\0')
+        {
+            wchar_t escaped = *parser->p++;
+            if (IsNamedClass(escaped))
+            {
+                if (!AddNamedClass(parser, escaped))
+                    return -1;
+                continue;
+            }
+            low = EscapedChar(escaped);
+        }
+
+        wchar_t high = low;
+        if (parser->p[0] == L'-' && parser->p[1] != L']' && parser->p[1] != L'\0')
+        {
+            parser->p++;
+            high = *parser->p++;
+            if (high == L'\\' && *parser->p != L'\0')
+                high = EscapedChar(*parser->p++);
+            if (high < low)
+            {
+                SetRegexError(parser, L"Invalid range in []");
+                return -1;
+            }
+        }
+
+        // Single characters are lowercased like literals; ranges are folded in FinishClass
+        if (low == high)
+            low = high = (wchar_t)towlower(low);
+        if (!AddRange(parser, low, high))
+            return -1;
+    }
+
+    if (*parser->p != L']')
+    {
+        SetRegexError(parser, L"Missing ]");
+        return -1;
+    }
+    parser->p++;
+
+    return ClassNode(parser, rangeStart, negated);
+}
+
+/*
+ * ParseAtom - A single character, class, group or anchor
+ */
+static int ParseAtom(RegexParser* parser)
+{
+    wchar_t c = *parser->p;
+    int rangeStart = parser->regex->rangeCount;
+
+    switch (c)
+    {
+        case L'(':
+        {
+            parser->p++;
+            if (parser->p[0] == L'?' && parser->p[1] == L':')
+                parser->p += 2;     // Non-capturing group - same thing here
+
+            int inner = ParseAlternation(parser);
+            if (parser->failed)
+                return -1;
+            if (*parser->p != L')')
+            {
+                SetRegexError(parser, L"Missing )");
+                return -1;
+            }
+            parser->p++;
+            return inner;
+        }
+
+        case L'[':
+            parser->p++;
+            return ParseBracket(parser);
+
+        case L'.':
+            parser->p++;
+            if (!AddRange(parser, 1, REGEX_CHAR_MAX))
+                return -1;
+            return ClassNode(parser, rangeStart, FALSE);
+
+        case L'^':
+            parser->p++;
+            return NewNode(parser, NODE_BOL, -1, -1);
+
+        case L'$':
+            parser->p++;
+            return NewNode(parser, NODE_EOL, -1, -1);
+
+        case L'*':
+        case L'+':
+        case L'?':
+        case L'{':
+            SetRegexError(parser, L"Nothing to repeat");
+            return -1;
+
+        case L'\\':
+            parser->p++;
+            if (*parser->p == L'\0')
+            {
+                SetRegexError(parser, L"Pattern ends with \\");
+                return -1;
+            }
+            c = *parser->p++;
+            if (IsNamedClass(c))
+            {
+                if (!AddNamedClass(parser, c))
+                    return -1;
+                return ClassNode(parser, rangeStart, FALSE);
+            }
+            c = EscapedChar(c);
+            break;
+
+        default:
+            parser->p++;
+            break;
+    }
+
+    // Literal character
+    c = (wchar_t)towlower(c);
+    if (!AddRange(parser, c, c))
+        return -1;
+    return ClassNode(parser, rangeStart, FALSE);
+}
+
+/*
+ * ParseNumber - Read a decimal number (at most REGEX_MAX_REPEAT); -1 if none
+ */
+static int ParseNumber(RegexParser* parser)
+{
+    if (*parser->p < L'0' || *parser->p > L'9')
+        return -1;
+
+    int value = 0;
+    while (*parser->p >= L'0' && *parser->p <= L'9')
+    {
+        value = value * 10 + (*parser->p++ - L'0');
+        if (value > REGEX_MAX_REPEAT)
+        {
+            SetRegexError(parser, L"Repeat count too large");
+            return -1;
+        }
+    }
+    return value;
+}
+
+/*
+ * ParseRepeat - An atom followed by any number of *, +, ? or {n,m}
+ */
+static int ParseRepeat(RegexParser* parser)
+{
+    int node = ParseAtom(parser);
+
+    while (!parser->failed)
+    {
+        wchar_t c = *parser->p;
+
+        if (c == L'*' || c == L'+' || c == L'?')
+        {
+            parser->p++;
+            node = NewNode(parser, (c == L'*') ? NODE_STAR : (c == L'+') ? NODE_PLUS : NODE_QUEST, node, -1);
+        }
+        else if (c == L'{')
+        {
+            parser->p++;
+            int min = ParseNumber(parser);
+            int max = min;
+            if (*parser->p == L',')
+            {
+                parser->p++;
+                max = (*parser->p == L'}') ? -1 : ParseNumber(parser);
+            }
+            if (parser->failed || min < 0 || *parser->p != L'}' || (max >= 0 && max < min))
+            {
+                SetRegexError(parser, L"Invalid {n,m}");
+                return -1;
+            }
+            parser->p++;
+
+            node = NewNode(parser, NODE_REPEAT, node, -1);
+            if (node >= 0)
+            {
+                parser->nodes[node].min = min;
+                parser->nodes[node].max = max;
+            }
+        }
+        else
+        {
+            break;
+        }
+
+        // A lazy suffix (*?, +?, ...) changes which match is reported, not
+        // whether there is one, so it is accepted and ignored
+        if (*parser->p == L'?')
+            parser->p++;
+    }
+
+    return parser->failed ? -1 : node;
+}
+
+/*
+ * ParseConcatenation - A sequence of repeated atoms
+ */
+static int ParseConcatenation(RegexParser* parser)
+{
+    int node = -1;
+
+    while (!parser->failed && *parser->p != L'\0' && *parser->p != L'|' && *parser->p != L')')
+    {
+        int next = ParseRepeat(parser);
+        node = (node < 0) ? next : NewNode(parser, NODE_CONCAT, node, next);
+    }
+
+    if (node < 0 && !parser->failed)
+        node = NewNode(parser, NODE_EMPTY, -1, -1);
+    return parser->failed ? -1 : node;
+}
+
+/*
+ * ParseAlternation - concatenation | concatenation ...
+ */
+static int ParseAlternation(RegexParser* parser)
+{
+    int node = ParseConcatenation(parser);
+
+    while (!parser->failed && *parser->p == L'|')
+    {
+        parser->p++;
+        int next = ParseConcatenation(parser);
+        node = NewNode(parser, NODE_ALT, node, next);
+    }
+
+    return parser->failed ? -1 : node;
+}
+
+/*
+ * NewState - Append an NFA state; returns -1 when the NFA is too big
+ */
+static int NewState(RegexParser* parser, NfaType type, int out, int out1)
+{
+    Regex* regex = parser->regex;
+
+    if (regex->nfaCount == REGEX_MAX_NFA_STATES)
+    {
+        SetRegexError(parser, L"Pattern too complex");
+        return -1;
+    }
+
+    NfaState* state = &regex->nfa[regex->nfaCount];
+    state->type = (BYTE)type;
+    state->out = out;
+    state->out1 = out1;
+    state->rangeStart = 0;
+    state->rangeCount = 0;
+    return regex->nfaCount++;
+}
+
+/*
+ * Patch lists
+ *
+ * While a fragment is being built its exits are not connected yet. The
+ * unconnected out/out1 fields are chained into a list through their own
+ * storage (state * 2 + which field), so connecting them later needs no
+ * extra memory.
+ */
+static int* ExitField(Regex* regex, int exit)
+{
+    NfaState* state = &regex->nfa[exit >> 1];
+    return (exit & 1) ? &state->out1 : &state->out;
+}
+
+static void PatchExits(Regex* regex, int exits, int target)
+{
+    while (exits >= 0)
+    {
+        int* field = ExitField(regex, exits);
+        exits = *field;
+        *field = target;
+    }
+}
+
+static int AppendExits(Regex* regex, int first, int second)
+{
+    if (first < 0)
+        return second;
+
+    int exit = first;
+    for (;;)
+    {
+        int* field = ExitField(regex, exit);
+        if (*field < 0)
+        {
+            *field = second;
+            return first;
+        }
+        exit = *field;
+    }
+}
+
+/*
+ * SingleExitState - Create a state whose only exit is its out field
+ */
+static BOOL SingleExitState(RegexParser* parser, NfaType type, Fragment* frag)
+{
+    int s = NewState(parser, type, -1, -1);
+    if (s < 0)
+        return FALSE;
+
+    frag->start = s;
+    frag->out = s * 2;
+    return TRUE;
+}
+
+/*
+ * Fragment combinators for concatenation and the repetition operators
+ */
+static void ConcatFragments(Regex* regex, Fragment* first, const Fragment* second)
+{
+    PatchExits(regex, first->out, second->start);
+    first->out = second->out;
+}
+
+static BOOL StarFragment(RegexParser* parser, Fragment* frag)
+{
+    int s = NewState(parser, NFA_SPLIT, frag->start, -1);
+    if (s < 0)
+        return FALSE;
+
+    PatchExits(parser->regex, frag->out, s);
+    frag->start = s;
+    frag->out = s * 2 + 1;
+    return TRUE;
+}
+
+static BOOL PlusFragment(RegexParser* parser, Fragment* frag)
+{
+    int s = NewState(parser, NFA_SPLIT, frag->start, -1);
+    if (s < 0)
+        return FALSE;
+
+    PatchExits(parser->regex, frag->out, s);
+    frag->out = s * 2 + 1;
+    return TRUE;
+}
+
+static BOOL QuestFragment(RegexParser* parser, Fragment* frag)
+{
+    int s = NewState(parser, NFA_SPLIT, frag->start, -1);
+    if (s < 0)
+        return FALSE;
+
+    frag->start = s;
+    frag->out = AppendExits(parser->regex, frag->out, s * 2 + 1);
+    return TRUE;
+}
+
+/*
+ * CompileNode - Thompson construction for one syntax tree node
+ */
+static BOOL CompileNode(RegexParser* parser, int index, Fragment* frag)
+{
+    const Node* node = &parser->nodes[index];
+    Fragment left, right;
+
+    switch (node->type)
+    {
+        case NODE_EMPTY:
+            return SingleExitState(parser, NFA_EPSILON, frag);
+
+        case NODE_BOL:
+            return SingleExitState(parser, NFA_BOL, frag);
+
+        case NODE_EOL:
+            return SingleExitState(parser, NFA_EOL, frag);
+
+        case NODE_CLASS:
+            if (!SingleExitState(parser, NFA_CHAR, frag))
+                return FALSE;
+            parser->regex->nfa[frag->start].rangeStart = node->rangeStart;
+            parser->regex->nfa[frag->start].rangeCount = node->rangeCount;
+            return TRUE;
+
+        case NODE_CONCAT:
+            if (!CompileNode(parser, node->left, &left) || !CompileNode(parser, node->right, &right))
+                return FALSE;
+            ConcatFragments(parser->regex, &left, &right);
+            *frag = left;
+            return TRUE;
+
+        case NODE_ALT:
+        {
+            if (!CompileNode(parser, node->left, &left) || !CompileNode(parser, node->right, &right))
+                return FALSE;
+            int s = NewState(parser, NFA_SPLIT, left.start, right.start);
+            if (s < 0)
+                return FALSE;
+            frag->start = s;
+            frag->out = AppendExits(parser->regex, left.out, right.out);
+            return TRUE;
+        }
+
+        case NODE_STAR:
+            return CompileNode(parser, node->left, frag) && StarFragment(parser, frag);
+
+        case NODE_PLUS:
+            return CompileNode(parser, node->left, frag) && PlusFragment(parser, frag);
+
+        case NODE_QUEST:
+            return CompileNode(parser, node->left, frag) && QuestFragment(parser, frag);
+
+        case NODE_REPEAT:
+        {
+            // x{2,4} becomes x x x? x?  and  x{2,} becomes x x x*
+            BOOL haveAny = FALSE;
+            int copies = (node->max < 0) ? node->min + 1 : node->max;
+
+            for (int i = 0; i < copies; i++)
+            {
+                Fragment copy;
+                if (!CompileNode(parser, node->left, &copy))
+                    return FALSE;
+                if (i >= node->min)
+                {
+                    BOOL ok = (node->max < 0) ? StarFragment(parser, &copy) : QuestFragment(parser, &copy);
+                    if (!ok)
+                        return FALSE;
+                }
+
+                if (haveAny)
+                    ConcatFragments(parser->regex, frag, &copy);
+                else
+                    *frag = copy;
+                haveAny = TRUE;
+            }
+
+            // x{0} matches the empty string
+            return haveAny || SingleExitState(parser, NFA_EPSILON, frag);
+        }
+    }
+
+    return FALSE;
+}
+
+/*
+ * CompareInts - qsort callback for ascending ints
+ */
+static int CompareInts(const void* a, const void* b)
+{
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * BuildAlphabet - Split the character set into classes the pattern cannot tell apart
+ */
+static BOOL BuildAlphabet(Regex* regex)
+{
+    int* starts = (int*)malloc((regex->rangeCount * 2 + 1) * sizeof(int));
+    if (starts == NULL)
+        return FALSE;
+
+    int count = 0;
+    starts[count++] = 0;
+    for (int i = 0; i < regex->rangeCount; i++)
+    {
+        starts[count++] = regex->ranges[i].low;
+        if (regex->ranges[i].high < REGEX_CHAR_MAX)
+            starts[count++] = regex->ranges[i].high + 1;
+    }
+    qsort(starts, count, sizeof(int), CompareInts);
+
+    int unique = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (unique == 0 || starts[i] != starts[unique - 1])
+            starts[unique++] = starts[i];
+    }
+
+    regex->classStarts = starts;
+    regex->classCount = unique;
+
+    // ASCII lookups skip the binary search
+    int k = 0;
+    for (int c = 0; c < 128; c++)
+    {
+        while (k + 1 < unique && starts[k + 1] <= c)
+            k++;
+        regex->asciiClass[c] = (WORD)k;
+    }
+    return TRUE;
+}
+
+/*
+ * ClassOf - Alphabet class of a (lowercased) character
+ */
+static int ClassOf(const Regex* regex, wchar_t c)
+{
+    if (c < 128)
+        return regex->asciiClass[c];
+
+    int low = 0, high = regex->classCount - 1;
+    while (low < high)
+    {
+        int mid = (low + high + 1) / 2;
+        if (regex->classStarts[mid] <= (int)c)
+            low = mid;
+        else
+            high = mid - 1;
+    }
+    return low;
+}
+
+/*
+ * CompileRegex - Compile a pattern
+ *
+ * Parameters:
+ *   pattern  - Regular expression (see regex.h for the syntax)
+ *   error    - Receives a short message on a syntax error (may be NULL)
+ *   errorLen - Size of error in characters
+ *
+ * Returns the compiled regex (free with FreeRegex), or NULL on error.
+ */
+Regex* CompileRegex(const wchar_t* pattern, wchar_t* error, int errorLen)
+{
+    if (error != NULL)
+        error[0] = L'\0';
+
+    Regex* regex = (Regex*)calloc(1, sizeof(Regex));
+    RegexParser parser = {0};
+    parser.p = pattern;
+    parser.regex = regex;
+    parser.error = error;
+    parser.errorLen = errorLen;
+
+    if (regex == NULL ||
+        (regex->pattern = _wcsdup(pattern)) == NULL ||
+        (regex->ranges = (CharRange*)malloc(REGEX_MAX_RANGES * sizeof(CharRange))) == NULL ||
+        (regex->nfa = (NfaState*)malloc(REGEX_MAX_NFA_STATES * sizeof(NfaState))) == NULL ||
+        (parser.nodes = (Node*)malloc(REGEX_MAX_NODES * sizeof(Node))) == NULL)
+    {
+        SetRegexError(&parser, L"Out of memory");
+        free(parser.nodes);
+        FreeRegex(regex);
+        return NULL;
+    }
+
+    // Parse
+    int root = ParseAlternation(&parser);
+    if (!parser.failed && *parser.p == L')')
+        SetRegexError(&parser, L"Unexpected )");
+
+    // Build the NFA and end it with the match state
+    Fragment frag;
+    if (!parser.failed && CompileNode(&parser, root, &frag))
+    {
+        int match = NewState(&parser, NFA_MATCH, -1, -1);
+        if (match >= 0)
+        {
+            PatchExits(regex, frag.out, match);
+            regex->nfaStart = frag.start;
+        }
+    }
+    free(parser.nodes);
+
+    if (parser.failed || !BuildAlphabet(regex))
+    {
+        SetRegexError(&parser, L"Out of memory");
+        FreeRegex(regex);
+        return NULL;
+    }
+
+    // Scratch space sized for the final NFA
+    regex->marks = (int*)calloc(regex->nfaCount, sizeof(int));
+    regex->stack = (int*)malloc((regex->nfaCount * 2 + 2) * sizeof(int));
+    regex->scratchSet = (int*)malloc(regex->nfaCount * sizeof(int));
+    regex->endSet = (int*)malloc(regex->nfaCount * sizeof(int));
+    if (regex->marks == NULL || regex->stack == NULL || regex->scratchSet == NULL || regex->endSet == NULL)
+    {
+        SetRegexError(&parser, L"Out of memory");
+        FreeRegex(regex);
+        return NULL;
+    }
+
+    // How many DFA states fit in the memory cap
+    int bytesPerState = regex->classCount * (int)sizeof(int) + (int)sizeof(DfaState) + 2 * (int)sizeof(int);
+    regex->dfaLimit = REGEX_DFA_MEMORY_CAP / bytesPerState;
+    if (regex->dfaLimit < 8)
+        regex->dfaLimit = 8;
+    regex->startState = -1;
+
+    return regex;
+}
+
+/*
+ * FreeRegex - Free a compiled regex and its DFA cache
+ */
+void FreeRegex(Regex* regex)
+{
+    if (regex == NULL)
+        return;
+
+    free(regex->pattern);
+    free(regex->ranges);
+    free(regex->nfa);
+    free(regex->classStarts);
+    free(regex->dfa);
+    free(regex->transitions);
+    free(regex->setPool);
+    free(regex->hashSlots);
+    free(regex->marks);
+    free(regex->stack);
+    free(regex->scratchSet);
+    free(regex->endSet);
+    free(regex);
+}
+
+/*
+ * GetRegexPattern - Pattern the regex was compiled from
+ */
+const wchar_t* GetRegexPattern(const Regex* regex)
+{
+    return regex->pattern;
+}
+
+/*
+ * AddClosure - Add an NFA state and everything reachable without input
+ *
+ * Only CHAR and (when not at the end) EOL states are stored in the set;
+ * they are all a DFA state needs to remember. Reaching MATCH sets *matched.
+ * Call NewMarkGeneration before starting a new set.
+ */
+static void AddClosure(Regex* regex, int start, BOOL atStart, BOOL atEnd, int* set, int* count, BOOL* matched)
+{
+    int top = 0;
+    regex->stack[top++] = start;
+
+    while (top > 0)
+    {
+        int s = regex->stack[--top];
+        if (s < 0 || regex->marks[s] == regex->markGeneration)
+            continue;
+        regex->marks[s] = regex->markGeneration;
+
+        const NfaState* state = &regex->nfa[s];
+        switch (state->type)
+        {
+            case NFA_SPLIT:
+                regex->stack[top++] = state->out1;
+                regex->stack[top++] = state->out;
+                break;
+            case NFA_EPSILON:
+                regex->stack[top++] = state->out;
+                break;
+            case NFA_BOL:
+                if (atStart)
+                    regex->stack[top++] = state->out;
+                break;
+            case NFA_EOL:
+                if (atEnd)
+                    regex->stack[top++] = state->out;
+                else
+                    set[(*count)++] = s;    // Decided once we know whether the text ends
+                break;
+            case NFA_CHAR:
+                set[(*count)++] = s;
+                break;
+            case NFA_MATCH:
+                *matched = TRUE;
+                break;
+        }
+    }
+}
+
+static void NewMarkGeneration(Regex* regex)
+{
+    if (++regex->markGeneration == 0)
+    {
+        memset(regex->marks, 0, regex->nfaCount * sizeof(int));
+        regex->markGeneration = 1;
+    }
+}
+
+/*
+ * MatchesAtEnd - TRUE if a set reaches MATCH when the text ends here
+ */
+static BOOL MatchesAtEnd(Regex* regex, const int* set, int count)
+{
+    int endCount = 0;
+    BOOL matched = FALSE;
+
+    NewMarkGeneration(regex);
+    for (int i = 0; i < count && !matched; i++)
+    {
+        const NfaState* state = &regex->nfa[set[i]];
+        if (state->type == NFA_EOL)
+            AddClosure(regex, state->out, FALSE, TRUE, regex->endSet, &endCount, &matched);
+    }
+    return matched;
+}
+
+/*
+ * HashSet - FNV-1a over the members of a sorted state set
+ */
+static unsigned int HashSet(const int* set, int count, BOOL accept)
+{
+    unsigned int hash = 2166136261u ^ (unsigned int)accept;
+    for (int i = 0; i < count; i++)
+    {
+        hash ^= (unsigned int)set[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * FlushDfa - Throw away every cached DFA state
+ */
+static void FlushDfa(Regex* regex)
+{
+    regex->dfaCount = 0;
+    regex->setPoolLength = 0;
+    regex->startState = -1;
+    if (regex->hashSlots != NULL)
+        memset(regex->hashSlots, 0xFF, regex->hashSize * sizeof(int));
+}
+
+/*
+ * GrowDfa - Make room for more DFA states (up to dfaLimit)
+ */
+static BOOL GrowDfa(Regex* regex)
+{
+    int newCapacity = regex->dfaCapacity ? regex->dfaCapacity * 2 : 16;
+    if (newCapacity > regex->dfaLimit)
+        newCapacity = regex->dfaLimit;
+
+    DfaState* newDfa = (DfaState*)realloc(regex->dfa, newCapacity * sizeof(DfaState));
+    if (newDfa == NULL)
+        return FALSE;
+    regex->dfa = newDfa;
+
+    int* newTransitions = (int*)realloc(regex->transitions,
+                                        (size_t)newCapacity * regex->classCount * sizeof(int));
+    if (newTransitions == NULL)
+        return FALSE;
+    regex->transitions = newTransitions;
+
+    int newHashSize = 1;
+    while (newHashSize < newCapacity * 2)
+        newHashSize *= 2;
+    int* newSlots = (int*)malloc(newHashSize * sizeof(int));
+    if (newSlots == NULL)
+        return FALSE;
+
+    // Re-insert existing states into the bigger table
+    memset(newSlots, 0xFF, newHashSize * sizeof(int));
+    for (int i = 0; i < regex->dfaCount; i++)
+    {
+        const DfaState* state = &regex->dfa[i];
+        unsigned int slot = HashSet(regex->setPool + state->setStart, state->setCount, state->accept) & (newHashSize - 1);
+        while (newSlots[slot] >= 0)
+            slot = (slot + 1) & (newHashSize - 1);
+        newSlots[slot] = i;
+    }
+
+    free(regex->hashSlots);
+    regex->hashSlots = newSlots;
+    regex->hashSize = newHashSize;
+    regex->dfaCapacity = newCapacity;
+    return TRUE;
+}
+
+/*
+ * FindOrAddState - DFA state for a set of NFA states
+ *
+ * Returns the state index, -2 if the cache is full (flush and retry) or
+ * -1 if memory ran out.
+ */
+static int FindOrAddState(Regex* regex, int* set, int count, BOOL accept)
+{
+    qsort(set, count, sizeof(int), CompareInts);
+    unsigned int hash = HashSet(set, count, accept);
+
+    if (regex->hashSlots != NULL)
+    {
+        unsigned int slot = hash & (regex->hashSize - 1);
+        while (regex->hashSlots[slot] >= 0)
+        {
+            const DfaState* state = &regex->dfa[regex->hashSlots[slot]];
+            if (state->accept == accept && state->setCount == count &&
+                memcmp(regex->setPool + state->setStart, set, count * sizeof(int)) == 0)
+            {
+                return regex->hashSlots[slot];
+            }
+            slot = (slot + 1) & (regex->hashSize - 1);
+        }
+    }
+
+    // New state - enforce the memory cap
+    int poolLimit = REGEX_DFA_MEMORY_CAP / (int)sizeof(int) / 4;
+    if (regex->dfaCount == regex->dfaLimit ||
+        (regex->setPoolLength + count > poolLimit && regex->dfaCount > 0))
+    {
+        return -2;
+    }
+    if (regex->dfaCount == regex->dfaCapacity && !GrowDfa(regex))
+        return -1;
+    if (regex->setPoolLength + count > regex->setPoolCapacity)
+    {
+        int newCapacity = regex->setPoolCapacity * 2 + count + 64;
+        int* newPool = (int*)realloc(regex->setPool, newCapacity * sizeof(int));
+        if (newPool == NULL)
+            return -1;
+        regex->setPool = newPool;
+        regex->setPoolCapacity = newCapacity;
+    }
+
+    int index = regex->dfaCount++;
+    DfaState* state = &regex->dfa[index];
+    state->setStart = regex->setPoolLength;
+    state->setCount = count;
+    state->accept = accept;
+    memcpy(regex->setPool + state->setStart, set, count * sizeof(int));
+    regex->setPoolLength += count;
+    state->acceptAtEnd = accept || MatchesAtEnd(regex, regex->setPool + state->setStart, count);
+
+    int* row = regex->transitions + (size_t)index * regex->classCount;
+    for (int k = 0; k < regex->classCount; k++)
+        row[k] = -1;
+
+    unsigned int slot = hash & (regex->hashSize - 1);
+    while (regex->hashSlots[slot] >= 0)
+        slot = (slot + 1) & (regex->hashSize - 1);
+    regex->hashSlots[slot] = index;
+
+    return index;
+}
+
+/*
+ * AddStateWithFlush - FindOrAddState, flushing the cache once if it is full
+ */
+static int AddStateWithFlush(Regex* regex, int* set, int count, BOOL accept)
+{
+    int index = FindOrAddState(regex, set, count, accept);
+    if (index == -2)
+    {
+        FlushDfa(regex);
+        index = FindOrAddState(regex, set, count, accept);
+    }
+    return index;
+}
+
+/*
+ * BuildStartState - DFA state before the first character of the text
+ */
+static int BuildStartState(Regex* regex)
+{
+    int count = 0;
+    BOOL matched = FALSE;
+
+    NewMarkGeneration(regex);
+    AddClosure(regex, regex->nfaStart, TRUE, FALSE, regex->scratchSet, &count, &matched);
+    return AddStateWithFlush(regex, regex->scratchSet, count, matched);
+}
+
+/*
+ * BuildTransition - Compute (and cache) where a DFA state goes on a character class
+ */
+static int BuildTransition(Regex* regex, int from, int charClass)
+{
+    int count = 0;
+    BOOL matched = FALSE;
+    int representative = regex->classStarts[charClass];
+    const DfaState* state = &regex->dfa[from];
+
+    NewMarkGeneration(regex);
+    for (int i = 0; i < state->setCount; i++)
+    {
+        const NfaState* nfa = &regex->nfa[regex->setPool[state->setStart + i]];
+        if (nfa->type != NFA_CHAR)
+            continue;
+
+        // Every character of a class behaves alike, so testing one is enough
+        for (int r = 0; r < nfa->rangeCount; r++)
+        {
+            const CharRange* range = &regex->ranges[nfa->rangeStart + r];
+            if (representative >= range->low && representative <= range->high)
+            {
+                AddClosure(regex, nfa->out, FALSE, FALSE, regex->scratchSet, &count, &matched);
+                break;
+            }
+        }
+    }
+
+    // The search is unanchored: a match may also begin at the next character
+    AddClosure(regex, regex->nfaStart, FALSE, FALSE, regex->scratchSet, &count, &matched);
+
+    int to = FindOrAddState(regex, regex->scratchSet, count, matched);
+    if (to == -2)
+    {
+        // Cache full - start over; the old state index is gone
+        FlushDfa(regex);
+        return FindOrAddState(regex, regex->scratchSet, count, matched);
+    }
+
+    if (to >= 0)
+        regex->transitions[(size_t)from * regex->classCount + charClass] = to;
+    return to;
+}
+
+/*
+ * RegexSearch - TRUE if the pattern matches anywhere in text
+ *
+ * Walks the cached DFA one character at a time, building states and
+ * transitions the first time they are needed.
+ */
+BOOL RegexSearch(Regex* regex, const wchar_t* text)
+{
+    if (regex->startState < 0)
+    {
+        regex->startState = BuildStartState(regex);
+        if (regex->startState < 0)
+            return FALSE;
+    }
+
+    int state = regex->startState;
+    for (const wchar_t* p = text; ; p++)
+    {
+        const DfaState* current = &regex->dfa[state];
+        if (current->accept)
+            return TRUE;
+        if (*p == L'\0')
+            return current->acceptAtEnd;
+        if (current->setCount == 0)
+            return FALSE;   // Dead state - nothing can match any more
+
+        int charClass = ClassOf(regex, (wchar_t)towlower(*p));
+        int next = regex->transitions[(size_t)state * regex->classCount + charClass];
+        if (next < 0)
+        {
+            next = BuildTransition(regex, state, charClass);
+            if (next < 0)
+                return FALSE;
+        }
+        state = next;
+    }
+}
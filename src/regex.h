@@ -0,0 +1,36 @@
+/*
+ * Regular Expression Header
+ *
+ * Case-insensitive regular expression search used by the "re:" search
+ * term. Patterns are compiled to an NFA and matched through a DFA that is
+ * built lazily as text is scanned, so matching is linear in the length of
+ * the text and cannot blow up the way backtracking engines do.
+ *
+ * Supported syntax:
+ *   .  [abc]  [^a-z]  \d \w \s \D \W \S   character classes
+ *   *  +  ?  {n}  {n,}  {n,m}              repetition (up to 100)
+ *   a|b  ( )  (?: )                        alternation and grouping
+ *   ^  $                                   start and end of the text
+ *
+ * A compiled Regex caches DFA states as it is used, so it must not be
+ * matched from two threads at the same time.
+ */
+
+#ifndef REGEX_H
+#define REGEX_H
+
+#include <windows.h>
+
+typedef struct Regex Regex;
+
+// Compile a pattern; returns NULL and fills error on a syntax error
+Regex* CompileRegex(const wchar_t* pattern, wchar_t* error, int errorLen);
+void FreeRegex(Regex* regex);
+
+// TRUE if the pattern matches anywhere in text
+BOOL RegexSearch(Regex* regex, const wchar_t* text);
+
+// Pattern the regex was compiled from
+const wchar_t* GetRegexPattern(const Regex* regex);
+
+#endif // REGEX_H
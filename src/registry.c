@@ -196,3 +196,70 @@ BOOL ToggleAutostart(void)
     }
 }
 
+/*
+ * GetSettingDWORD - Read an optional DWORD setting
+ * 
+ * Settings live under HKEY_CURRENT_USER\Software\WinRDP. They are never
+ * written by the application - an administrator or power user can create
+ * them with regedit to tune behaviour (e.g. the search debounce delay).
+ * 
+ * Parameters:
+ *   valueName    - Name of the registry value
+ *   defaultValue - Returned when the key or value is missing or not a DWORD
+ */
+DWORD GetSettingDWORD(const wchar_t* valueName, DWORD defaultValue)
+{
+    HKEY hKey;
+    DWORD value = defaultValue;
+    DWORD type = 0;
+    DWORD dataSize = sizeof(DWORD);
+    
+    if (RegOpenKeyExW(HKEY_CURRENT_USER, REG_SETTINGS_KEY, 0, KEY_READ, &hKey) != ERROR_SUCCESS)
+    {
+        return defaultValue;
+    }
+    
+    if (RegQueryValueExW(hKey, valueName, NULL, &type, (LPBYTE)&value, &dataSize) != ERROR_SUCCESS ||
+        type != REG_DWORD)
+    {
+        value = defaultValue;
+    }
+    
+    RegCloseKey(hKey);
+    return value;
+}
+
+/*
+ * GetSettingString - Read an optional string setting
+ * 
+ * Parameters:
+ *   valueName - Name of the registry value (REG_SZ)
+ *   buffer    - Receives the text (empty when the setting is missing)
+ *   bufferLen - Size of buffer in characters
+ * 
+ * Returns:
+ *   TRUE if the setting exists and is not empty
+ */
+BOOL GetSettingString(const wchar_t* valueName, wchar_t* buffer, DWORD bufferLen)
+{
+    HKEY hKey;
+    DWORD type = 0;
+    DWORD dataSize = (bufferLen - 1) * sizeof(wchar_t);
+    
+    buffer[0] = L'\0';
+    if (RegOpenKeyExW(HKEY_CURRENT_USER, REG_SETTINGS_KEY, 0, KEY_READ, &hKey) != ERROR_SUCCESS)
+    {
+        return FALSE;
+    }
+    
+    // The stored string need not be terminated
+    if (RegQueryValueExW(hKey, valueName, NULL, &type, (LPBYTE)buffer, &dataSize) != ERROR_SUCCESS ||
+        type != REG_SZ)
+    {
+        dataSize = 0;
+    }
+    buffer[dataSize / sizeof(wchar_t)] = L'\0';
+    
+    RegCloseKey(hKey);
+    return (buffer[0] != L'\0');
+}
@@ -12,5 +12,9 @@ BOOL EnableAutostart(void);
 BOOL DisableAutostart(void);
 BOOL ToggleAutostart(void);
 
+// Optional user settings under HKCU\Software\WinRDP
+DWORD GetSettingDWORD(const wchar_t* valueName, DWORD defaultValue);
+BOOL GetSettingString(const wchar_t* valueName, wchar_t* buffer, DWORD bufferLen);
+
 #endif // REGISTRY_H
 
@@ -0,0 +1,848 @@
+/*
+ * Name Resolver Module
+ *
+ * Names are looked up with DnsQuery_W rather than getaddrinfo, because
+ * only DnsQuery reports each record's TTL - which is how long the answer
+ * may be cached here. One lookup asks for A and then AAAA records; names
+ * DNS does not know (single-label NetBIOS names, LLMNR, the hosts file)
+ * get a second chance through GetAddrInfoW, cached for
+ * RESOLVER_DEFAULT_TTL since nothing says how long they are valid.
+ *
+ * A batch of names is resolved like this:
+ *
+ *   1. Every name still valid in the cache is answered at once.
+ *   2. The rest are shared out over up to `concurrency` threads, each
+ *      taking the next name from a shared counter until none are left.
+ *      DnsQuery blocks, so threads are what bounds the lookups in flight;
+ *      a slow name holds up only its own thread.
+ *   3. Each answer goes into the cache as it arrives.
+ *
+ * The cache is a hash table keyed by lowercase name behind a slim
+ * reader/writer lock, like the probe results. An expired entry stays
+ * until the name is looked up again and the new answer replaces it.
+ *
+ * When the DnsServer setting names an IPv4 address ("ip" or "ip:port",
+ * port 53 by default), queries go to that server only, skipping the
+ * system cache, the hosts file and the GetAddrInfoW fallback - e.g. to
+ * try the resolver against a local stub server that replays canned
+ * answers. DnsQuery cannot be given a port, so these queries are built,
+ * sent over UDP and parsed here; each lookup thread uses a socket of its
+ * own, so the threads still bound the queries in flight.
+ *
+ * Learning points:
+ *   - DnsQuery_W and walking a DNS_RECORD list
+ *   - DNS queries and replies on the wire (RFC 1035), name compression
+ *   - Positive and negative caching with TTLs
+ *   - Bounding concurrent blocking calls with a small set of threads
+ *   - Handing out work with InterlockedIncrement
+ */
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <windns.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "registry.h"
+#include "resolver.h"
+
+#define DNS_PORT                53
+#define DNS_HEADER_SIZE         12
+#define DNS_MAX_MESSAGE         512         // Largest UDP message without EDNS
+#define DNS_CLASS_IN            1
+#define DNS_RCODE_NXDOMAIN      3
+
+// How to query (read once per batch)
+typedef struct {
+    BOOL useServer;             // Ask `server` directly instead of DnsQuery
+    SOCKADDR_IN server;         // DnsServer setting
+    DWORD negativeTtl;          // Seconds a "no such name" is cached
+} ResolverConfig;
+
+// A batch shared by its worker threads
+typedef struct {
+    const wchar_t* const* names;
+    ResolvedName* results;
+    int* pending;               // Indices of the names the cache could not answer
+    int pendingCount;
+    volatile LONG next;         // Next entry of pending to look up
+    volatile LONG* cancel;
+    const ResolverConfig* config;
+} ResolveBatch;
+
+// Cached answer
+typedef struct {
+    ResolvedName answer;        // Empty name = empty slot
+    ULONGLONG expires;          // GetTickCount64 when the answer goes stale
+} ResolverEntry;
+
+// Answers by name (open addressing, kept at most half full)
+static SRWLOCK g_cacheLock = SRWLOCK_INIT;
+static ResolverEntry* g_cache = NULL;
+static int g_cacheCount = 0;
+static int g_cacheCapacity = 0;     // Power of two
+
+// Set while a prefetch thread runs
+static volatile LONG g_prefetchRunning = 0;
+
+/*
+ * FindCacheSlot - Slot holding name, or the empty slot where it would go
+ *
+ * Must be called with the cache lock held and a non-empty table.
+ */
+static int FindCacheSlot(const wchar_t* name)
+{
+    int slot = (int)(HashHostKey(name) & (ULONGLONG)(g_cacheCapacity - 1));
+    while (g_cache[slot].answer.name[0] != L'\0' && _wcsicmp(g_cache[slot].answer.name, name) != 0)
+        slot = (slot + 1) & (g_cacheCapacity - 1);
+    return slot;
+}
+
+/*
+ * LookupCache - Cached answer for a name, if it has not expired
+ */
+static BOOL LookupCache(const wchar_t* name, ResolvedName* result)
+{
+    BOOL found = FALSE;
+
+    AcquireSRWLockShared(&g_cacheLock);
+    if (g_cacheCount > 0)
+    {
+        int slot = FindCacheSlot(name);
+        if (g_cache[slot].answer.name[0] != L'\0' && GetTickCount64() < g_cache[slot].expires)
+        {
+            *result = g_cache[slot].answer;
+            result->fromCache = TRUE;
+            found = TRUE;
+        }
+    }
+    ReleaseSRWLockShared(&g_cacheLock);
+
+    return found;
+}
+
+/*
+ * StoreCache - Remember an answer for its TTL (answers with ttl 0 are skipped)
+ */
+static void StoreCache(const ResolvedName* answer)
+{
+    if (answer->ttl == 0 || answer->name[0] == L'\0')
+        return;
+
+    AcquireSRWLockExclusive(&g_cacheLock);
+
+    if ((g_cacheCount + 1) * 2 > g_cacheCapacity)
+    {
+        int newCapacity = (g_cacheCapacity > 0) ? g_cacheCapacity * 2 : 64;
+        ResolverEntry* newCache = (ResolverEntry*)calloc(newCapacity, sizeof(ResolverEntry));
+        if (newCache == NULL)
+        {
+            ReleaseSRWLockExclusive(&g_cacheLock);
+            return;
+        }
+
+        ResolverEntry* oldCache = g_cache;
+        int oldCapacity = g_cacheCapacity;
+        g_cache = newCache;
+        g_cacheCapacity = newCapacity;
+        for (int i = 0; i < oldCapacity; i++)
+        {
+            if (oldCache[i].answer.name[0] != L'\0')
+                g_cache[FindCacheSlot(oldCache[i].answer.name)] = oldCache[i];
+        }
+        free(oldCache);
+    }
+
+    int slot = FindCacheSlot(answer->name);
+    if (g_cache[slot].answer.name[0] == L'\0')
+        g_cacheCount++;
+    g_cache[slot].answer = *answer;
+    g_cache[slot].answer.fromCache = FALSE;
+    g_cache[slot].expires = GetTickCount64() + (ULONGLONG)answer->ttl * 1000;
+
+    ReleaseSRWLockExclusive(&g_cacheLock);
+}
+
+/*
+ * ClearResolverCache - Forget every cached answer
+ */
+void ClearResolverCache(void)
+{
+    AcquireSRWLockExclusive(&g_cacheLock);
+    free(g_cache);
+    g_cache = NULL;
+    g_cacheCount = 0;
+    g_cacheCapacity = 0;
+    ReleaseSRWLockExclusive(&g_cacheLock);
+}
+
+/*
+ * SplitHostPort - Separate "host:port" the way mstsc reads it
+ *
+ * "[fe80::1]:3390" and "host:3390" carry a port; a bare IPv6 address
+ * (more than one ':') does not.
+ *
+ * Parameters:
+ *   hostname    - Entry from the host list
+ *   defaultPort - Port when the entry has none
+ *   host        - Receives the name or address to resolve
+ *   hostLen     - Size of host in characters
+ *
+ * Returns:
+ *   The port, or 0 if the port part is not a valid port number
+ */
+USHORT SplitHostPort(const wchar_t* hostname, USHORT defaultPort, wchar_t* host, size_t hostLen)
+{
+    const wchar_t* portText = NULL;
+
+    if (hostname[0] == L'[')
+    {
+        const wchar_t* close = wcschr(hostname, L']');
+        if (close == NULL)
+        {
+            wcsncpy_s(host, hostLen, hostname, _TRUNCATE);
+            return defaultPort;
+        }
+        wcsncpy_s(host, hostLen, hostname + 1, (size_t)(close - hostname - 1));
+        if (close[1] == L':')
+            portText = close + 2;
+    }
+    else
+    {
+        const wchar_t* colon = wcschr(hostname, L':');
+        if (colon != NULL && wcschr(colon + 1, L':') == NULL)
+        {
+            wcsncpy_s(host, hostLen, hostname, (size_t)(colon - hostname));
+            portText = colon + 1;
+        }
+        else
+        {
+            wcsncpy_s(host, hostLen, hostname, _TRUNCATE);
+        }
+    }
+
+    if (portText == NULL)
+        return defaultPort;
+
+    wchar_t* end = NULL;
+    unsigned long port = wcstoul(portText, &end, 10);
+    if (end == portText || *end != L'\0' || port == 0 || port > 65535)
+        return 0;
+    return (USHORT)port;
+}
+
+/*
+ * AddAddress - Append an address to an answer (ignored once it is full)
+ */
+static void AddAddress(ResolvedName* result, const void* address, int addressLength)
+{
+    if (result->addressCount >= RESOLVER_MAX_ADDRESSES || addressLength > (int)sizeof(result->addresses[0].address))
+        return;
+
+    ResolvedAddress* entry = &result->addresses[result->addressCount++];
+    memset(entry, 0, sizeof(ResolvedAddress));
+    memcpy(entry->address, address, addressLength);
+    entry->addressLength = addressLength;
+}
+
+/*
+ * CopyAddrInfo - Append GetAddrInfoW's addresses to an answer
+ */
+static void CopyAddrInfo(ResolvedName* result, const ADDRINFOW* addresses)
+{
+    for (const ADDRINFOW* a = addresses; a != NULL; a = a->ai_next)
+    {
+        if (a->ai_family == AF_INET || a->ai_family == AF_INET6)
+            AddAddress(result, a->ai_addr, (int)a->ai_addrlen);
+    }
+}
+
+/*
+ * PutWord / GetWord - Big-endian 16-bit values in a DNS message
+ */
+static void PutWord(BYTE* p, WORD value)
+{
+    p[0] = (BYTE)(value >> 8);
+    p[1] = (BYTE)value;
+}
+
+static WORD GetWord(const BYTE* p)
+{
+    return (WORD)((p[0] << 8) | p[1]);
+}
+
+/*
+ * BuildDnsQuery - Write a recursive query for one name and record type
+ *
+ * Returns:
+ *   The message length, or 0 if the name cannot be put in a query
+ */
+static int BuildDnsQuery(const wchar_t* name, WORD type, WORD id, BYTE* message, int size)
+{
+    char utf8[256];
+    if (WideCharToMultiByte(CP_UTF8, 0, name, -1, utf8, sizeof(utf8), NULL, NULL) == 0)
+        return 0;
+
+    memset(message, 0, DNS_HEADER_SIZE);
+    PutWord(message, id);
+    message[2] = 0x01;                          // RD
+    PutWord(message + 4, 1);                    // One question
+
+    int offset = DNS_HEADER_SIZE;
+    const char* label = utf8;
+    while (*label != '\0')
+    {
+        const char* dot = strchr(label, '.');
+        int labelLength = (dot != NULL) ? (int)(dot - label) : (int)strlen(label);
+        if (labelLength == 0 || labelLength > 63 || offset + 1 + labelLength + 5 > size)
+            return 0;
+        message[offset++] = (BYTE)labelLength;
+        memcpy(message + offset, label, labelLength);
+        offset += labelLength;
+        label += (dot != NULL) ? labelLength + 1 : labelLength;
+    }
+
+    message[offset++] = 0;
+    PutWord(message + offset, type);
+    PutWord(message + offset + 2, DNS_CLASS_IN);
+    return offset + 4;
+}
+
+/*
+ * SkipDnsName - Step over a name (labels, maybe ending in a pointer)
+ *
+ * Returns:
+ *   The offset after the name, or 0 if it runs past the message
+ */
+static int SkipDnsName(const BYTE* message, int length, int offset)
+{
+    while (offset < length)
+    {
+        BYTE labelLength = message[offset];
+        if (labelLength == 0)
+            return offset + 1;
+        if ((labelLength & 0xC0) == 0xC0)
+            return (offset + 2 <= length) ? offset + 2 : 0;
+        if ((labelLength & 0xC0) != 0)
+            return 0;
+        offset += 1 + labelLength;
+    }
+    return 0;
+}
+
+/*
+ * IsReplyTo - TRUE if a message answers the query (same ID and question)
+ */
+static BOOL IsReplyTo(const BYTE* reply, int length, const BYTE* query, int queryLength)
+{
+    return (length >= queryLength &&
+            GetWord(reply) == GetWord(query) &&
+            (reply[2] & 0x80) != 0 &&
+            GetWord(reply + 4) == 1 &&
+            memcmp(reply + DNS_HEADER_SIZE, query + DNS_HEADER_SIZE, queryLength - DNS_HEADER_SIZE) == 0);
+}
+
+/*
+ * ParseDnsReply - Append the addresses in a reply's answer section
+ *
+ * Parameters:
+ *   reply       - The reply (IsReplyTo the query)
+ *   length      - Its length
+ *   answerStart - Where the answer section starts (the query's length)
+ *   type        - DNS_TYPE_A or DNS_TYPE_AAAA
+ *   result      - Receives the addresses
+ *   ttl         - Lowered to the smallest TTL in the answer (CNAMEs included)
+ *
+ * Returns:
+ *   0 or the status DnsQuery would report for the same reply
+ */
+static DNS_STATUS ParseDnsReply(const BYTE* reply, int length, int answerStart, WORD type,
+                                ResolvedName* result, DWORD* ttl)
+{
+    int rcode = reply[3] & 0x0F;
+    if (rcode == DNS_RCODE_NXDOMAIN)
+        return DNS_ERROR_RCODE_NAME_ERROR;
+    if (rcode != 0)
+        return DNS_ERROR_RCODE_SERVER_FAILURE;
+
+    int found = 0;
+    int offset = answerStart;
+    int answers = GetWord(reply + 6);
+    for (int i = 0; i < answers; i++)
+    {
+        // Name, then TYPE, CLASS, TTL, RDLENGTH and the data
+        offset = SkipDnsName(reply, length, offset);
+        if (offset == 0 || offset + 10 > length)
+            return DNS_ERROR_BAD_PACKET;
+        WORD recordType = GetWord(reply + offset);
+        DWORD recordTtl = ((DWORD)GetWord(reply + offset + 4) << 16) | GetWord(reply + offset + 6);
+        int dataLength = GetWord(reply + offset + 8);
+        const BYTE* data = reply + offset + 10;
+        offset += 10 + dataLength;
+        if (offset > length)
+            return DNS_ERROR_BAD_PACKET;
+
+        if (recordTtl < *ttl)
+            *ttl = recordTtl;
+
+        if (recordType == DNS_TYPE_A && type == DNS_TYPE_A && dataLength == 4)
+        {
+            SOCKADDR_IN address = {0};
+            address.sin_family = AF_INET;
+            memcpy(&address.sin_addr, data, 4);
+            AddAddress(result, &address, sizeof(address));
+            found++;
+        }
+        else if (recordType == DNS_TYPE_AAAA && type == DNS_TYPE_AAAA && dataLength == 16)
+        {
+            SOCKADDR_IN6 address = {0};
+            address.sin6_family = AF_INET6;
+            memcpy(&address.sin6_addr, data, 16);
+            AddAddress(result, &address, sizeof(address));
+            found++;
+        }
+    }
+
+    return (found > 0) ? 0 : DNS_INFO_NO_RECORDS;
+}
+
+/*
+ * QueryServer - Ask one server over UDP, waiting up to RESOLVER_QUERY_TIMEOUT_MS
+ *
+ * The socket is connected, so only the server's datagrams arrive and a
+ * port nobody listens on fails the receive at once. Anything that is not
+ * the reply to this query (stale ID, other question) is skipped.
+ *
+ * Returns:
+ *   As ParseDnsReply, or a Winsock error / ERROR_TIMEOUT if no reply came
+ */
+static DNS_STATUS QueryServer(const wchar_t* name, WORD type, const SOCKADDR_IN* server,
+                              ResolvedName* result, DWORD* ttl)
+{
+    static volatile LONG nextId = 0;
+    BYTE query[DNS_MAX_MESSAGE];
+    BYTE reply[DNS_MAX_MESSAGE];
+
+    WORD id = (WORD)(InterlockedIncrement(&nextId) + GetTickCount());
+    int queryLength = BuildDnsQuery(name, type, id, query, sizeof(query));
+    if (queryLength == 0)
+        return ERROR_INVALID_NAME;
+
+    SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s == INVALID_SOCKET)
+        return WSAGetLastError();
+
+    DNS_STATUS status = ERROR_TIMEOUT;
+    if (connect(s, (const SOCKADDR*)server, sizeof(SOCKADDR_IN)) != 0 ||
+        send(s, (const char*)query, queryLength, 0) != queryLength)
+    {
+        status = WSAGetLastError();
+    }
+    else
+    {
+        DWORD start = GetTickCount();
+        for (;;)
+        {
+            DWORD elapsed = GetTickCount() - start;
+            if (elapsed >= RESOLVER_QUERY_TIMEOUT_MS)
+                break;
+
+            fd_set readable;
+            struct timeval timeout;
+            FD_ZERO(&readable);
+            FD_SET(s, &readable);
+            timeout.tv_sec = (long)((RESOLVER_QUERY_TIMEOUT_MS - elapsed) / 1000);
+            timeout.tv_usec = (long)((RESOLVER_QUERY_TIMEOUT_MS - elapsed) % 1000) * 1000;
+            int ready = select((int)s + 1, &readable, NULL, NULL, &timeout);
+            if (ready == 0)
+                break;
+            int length = (ready > 0) ? recv(s, (char*)reply, sizeof(reply), 0) : SOCKET_ERROR;
+            if (length == SOCKET_ERROR)
+            {
+                status = WSAGetLastError();
+                break;
+            }
+            if (IsReplyTo(reply, length, query, queryLength))
+            {
+                status = ParseDnsReply(reply, length, queryLength, type, result, ttl);
+                break;
+            }
+        }
+    }
+
+    closesocket(s);
+    return status;
+}
+
+/*
+ * QueryRecords - Ask DNS for one record type and append the addresses
+ *
+ * Parameters:
+ *   name   - Name to look up
+ *   type   - DNS_TYPE_A or DNS_TYPE_AAAA
+ *   config - Which server to ask
+ *   result - Receives the addresses
+ *   ttl    - Lowered to the smallest TTL in the answer (CNAMEs included)
+ *
+ * Returns:
+ *   The DnsQuery status (0 if the name has records of this type)
+ */
+static DNS_STATUS QueryRecords(const wchar_t* name, WORD type, const ResolverConfig* config,
+                               ResolvedName* result, DWORD* ttl)
+{
+    if (config->useServer)
+        return QueryServer(name, type, &config->server, result, ttl);
+
+    PDNS_RECORD records = NULL;
+    DNS_STATUS status = DnsQuery_W(name, type, DNS_QUERY_STANDARD, NULL, &records, NULL);
+    if (status != 0)
+        return status;
+
+    for (PDNS_RECORD r = records; r != NULL; r = r->pNext)
+    {
+        if (r->Flags.S.Section != DnsSectionAnswer)
+            continue;
+        if (r->dwTtl < *ttl)
+            *ttl = r->dwTtl;
+
+        if (r->wType == DNS_TYPE_A && type == DNS_TYPE_A)
+        {
+            SOCKADDR_IN address = {0};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = r->Data.A.IpAddress;     // Already in network byte order
+            AddAddress(result, &address, sizeof(address));
+        }
+        else if (r->wType == DNS_TYPE_AAAA && type == DNS_TYPE_AAAA)
+        {
+            SOCKADDR_IN6 address = {0};
+            address.sin6_family = AF_INET6;
+            memcpy(&address.sin6_addr, &r->Data.AAAA.Ip6Address, sizeof(address.sin6_addr));
+            AddAddress(result, &address, sizeof(address));
+        }
+    }
+
+    DnsRecordListFree(records, DnsFreeRecordList);
+    return status;
+}
+
+/*
+ * IsNoSuchName - TRUE for DnsQuery answers that say the name has no address
+ */
+static BOOL IsNoSuchName(DNS_STATUS status)
+{
+    return (status == DNS_ERROR_RCODE_NAME_ERROR || status == DNS_INFO_NO_RECORDS);
+}
+
+/*
+ * LookupName - Resolve one name, bypassing the cache
+ *
+ * Literal addresses are converted without a lookup and not cached
+ * (ttl 0). Everything else gets a TTL: the record TTL (at most
+ * RESOLVER_MAX_TTL), RESOLVER_DEFAULT_TTL for the fallback, or
+ * config->negativeTtl for a name that does not exist. Failed lookups get
+ * ttl 0 so they are tried again next time.
+ */
+static void LookupName(const wchar_t* name, const ResolverConfig* config, ResolvedName* result)
+{
+    ADDRINFOW hints = {0};
+    ADDRINFOW* addresses = NULL;
+
+    memset(result, 0, sizeof(ResolvedName));
+    wcsncpy_s(result->name, MAX_HOSTNAME_LEN, name, _TRUNCATE);
+
+    if (name[0] == L'\0')
+    {
+        result->error = WSAHOST_NOT_FOUND;
+        return;
+    }
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+
+    // 1. An address already
+    hints.ai_flags = AI_NUMERICHOST;
+    if (GetAddrInfoW(name, NULL, &hints, &addresses) == 0)
+    {
+        CopyAddrInfo(result, addresses);
+        FreeAddrInfoW(addresses);
+        return;
+    }
+
+    // 2. DNS, which says how long the answer is good for
+    DWORD ttl = RESOLVER_MAX_TTL;
+    DNS_STATUS statusA = QueryRecords(name, DNS_TYPE_A, config, result, &ttl);
+    DNS_STATUS statusAAAA = QueryRecords(name, DNS_TYPE_AAAA, config, result, &ttl);
+    if (result->addressCount > 0)
+    {
+        result->ttl = (ttl > 0) ? ttl : 1;
+        return;
+    }
+
+    // 3. Everything else Windows knows (NetBIOS, LLMNR, hosts file) - not with a test server
+    int status = 0;
+    if (!config->useServer)
+    {
+        hints.ai_flags = 0;
+        status = GetAddrInfoW(name, NULL, &hints, &addresses);
+        if (status == 0)
+        {
+            CopyAddrInfo(result, addresses);
+            FreeAddrInfoW(addresses);
+            if (result->addressCount > 0)
+            {
+                result->ttl = RESOLVER_DEFAULT_TTL;
+                return;
+            }
+        }
+    }
+
+    // Remember "no such name"; try anything else again next time
+    BOOL noSuchName = IsNoSuchName(statusA) && IsNoSuchName(statusAAAA) &&
+                      (status == 0 || status == WSAHOST_NOT_FOUND || status == WSANO_DATA);
+    result->error = noSuchName ? WSAHOST_NOT_FOUND : WSATRY_AGAIN;
+    result->ttl = noSuchName ? config->negativeTtl : 0;
+}
+
+/*
+ * LoadResolverConfig - Read the settings that shape a lookup
+ */
+static void LoadResolverConfig(ResolverConfig* config)
+{
+    wchar_t setting[64];
+    wchar_t host[64];
+
+    memset(config, 0, sizeof(ResolverConfig));
+    config->negativeTtl = GetSettingDWORD(REG_RESOLVER_NEGATIVE_TTL, RESOLVER_NEGATIVE_TTL);
+    if (config->negativeTtl > RESOLVER_MAX_TTL)
+        config->negativeTtl = RESOLVER_MAX_TTL;
+
+    // A server of our own: ask it directly, nothing else
+    if (GetSettingString(REG_DNS_SERVER, setting, ARRAYSIZE(setting)))
+    {
+        USHORT port = SplitHostPort(setting, DNS_PORT, host, ARRAYSIZE(host));
+        if (port != 0 && InetPtonW(AF_INET, host, &config->server.sin_addr) == 1)
+        {
+            config->useServer = TRUE;
+            config->server.sin_family = AF_INET;
+            config->server.sin_port = htons(port);
+        }
+    }
+}
+
+/*
+ * ResolveWorker - Look up pending names of a batch until none are left
+ */
+static DWORD WINAPI ResolveWorker(LPVOID param)
+{
+    ResolveBatch* batch = (ResolveBatch*)param;
+
+    for (;;)
+    {
+        LONG next = InterlockedIncrement(&batch->next) - 1;
+        if (next >= batch->pendingCount)
+            break;
+
+        int index = batch->pending[next];
+        ResolvedName* result = &batch->results[index];
+
+        if (batch->cancel != NULL && *batch->cancel != 0)
+        {
+            memset(result, 0, sizeof(ResolvedName));
+            wcsncpy_s(result->name, MAX_HOSTNAME_LEN, batch->names[index], _TRUNCATE);
+            result->error = WSATRY_AGAIN;
+            continue;
+        }
+
+        LookupName(batch->names[index], batch->config, result);
+        StoreCache(result);
+    }
+    return 0;
+}
+
+/*
+ * ResolveName - Resolve one name on the calling thread
+ *
+ * Parameters:
+ *   name   - Host name or address (no ":port")
+ *   result - Receives the answer
+ */
+void ResolveName(const wchar_t* name, ResolvedName* result)
+{
+    if (LookupCache(name, result))
+        return;
+
+    ResolverConfig config;
+    LoadResolverConfig(&config);
+    LookupName(name, &config, result);
+    StoreCache(result);
+}
+
+/*
+ * ResolveNames - Resolve a batch of names concurrently
+ *
+ * Parameters:
+ *   names       - Host names or addresses (no ":port")
+ *   count       - Number of names
+ *   concurrency - Lookups in flight at once (0 = ResolverConcurrency setting)
+ *   results     - Array of count answers, filled in the order of names
+ *   cancel      - Optional; when it becomes non-zero, names not yet looked
+ *                 up are answered with WSATRY_AGAIN
+ *
+ * Returns:
+ *   TRUE when every name has an answer
+ *   FALSE if out of memory (nothing was resolved)
+ *
+ * If no thread can be started, the lookups run on the calling thread.
+ */
+BOOL ResolveNames(const wchar_t* const* names, int count, int concurrency,
+                  ResolvedName* results, volatile LONG* cancel)
+{
+    if (count <= 0)
+        return TRUE;
+
+    if (concurrency <= 0)
+        concurrency = (int)GetSettingDWORD(REG_RESOLVER_CONCURRENCY, RESOLVER_CONCURRENCY);
+    if (concurrency < 1)
+        concurrency = 1;
+    if (concurrency > RESOLVER_MAX_CONCURRENCY)
+        concurrency = RESOLVER_MAX_CONCURRENCY;
+
+    ResolveBatch batch = {0};
+    batch.names = names;
+    batch.results = results;
+    batch.cancel = cancel;
+    batch.pending = (int*)malloc(sizeof(int) * count);
+    if (batch.pending == NULL)
+        return FALSE;
+
+    // 1. Whatever the cache still knows
+    for (int i = 0; i < count; i++)
+    {
+        if (!LookupCache(names[i], &results[i]))
+            batch.pending[batch.pendingCount++] = i;
+    }
+
+    // 2. The rest over a few threads (or this one, for a single name)
+    if (batch.pendingCount > 0)
+    {
+        ResolverConfig config;
+        LoadResolverConfig(&config);
+        batch.config = &config;
+
+        HANDLE threads[RESOLVER_MAX_CONCURRENCY];
+        int threadCount = 0;
+        int wanted = (batch.pendingCount < concurrency) ? batch.pendingCount : concurrency;
+
+        while (wanted > 1 && threadCount < wanted)
+        {
+            threads[threadCount] = CreateThread(NULL, 0, ResolveWorker, &batch, 0, NULL);
+            if (threads[threadCount] == NULL)
+                break;
+            threadCount++;
+        }
+
+        if (threadCount == 0)
+        {
+            ResolveWorker(&batch);
+        }
+        else
+        {
+            WaitForMultipleObjects(threadCount, threads, TRUE, INFINITE);
+            for (int i = 0; i < threadCount; i++)
+                CloseHandle(threads[i]);
+        }
+    }
+
+    free(batch.pending);
+    return TRUE;
+}
+
+// Names handed to a prefetch thread
+typedef struct {
+    wchar_t (*names)[MAX_HOSTNAME_LEN];
+    const wchar_t** pointers;
+    ResolvedName* results;
+    int count;
+} PrefetchJob;
+
+/*
+ * FreePrefetchJob - Free a prefetch job's copies
+ */
+static void FreePrefetchJob(PrefetchJob* job)
+{
+    free(job->results);
+    free(job->pointers);
+    free(job->names);
+    free(job);
+}
+
+/*
+ * PrefetchThread - Resolve a prefetch job's names, keeping only the cache entries
+ */
+static DWORD WINAPI PrefetchThread(LPVOID param)
+{
+    PrefetchJob* job = (PrefetchJob*)param;
+
+    ResolveNames(job->pointers, job->count, 0, job->results, NULL);
+
+    FreePrefetchJob(job);
+    InterlockedExchange(&g_prefetchRunning, 0);
+    return 0;
+}
+
+/*
+ * StartResolverPrefetch - Resolve names in the background to warm the cache
+ *
+ * Parameters:
+ *   names - Hosts as written in the host list (":port" is dropped; copied)
+ *   count - Number of hosts
+ *
+ * Returns:
+ *   TRUE if the prefetch started, FALSE if one is already running or it
+ *   could not start
+ *
+ * DnsQuery goes through the Windows DNS client service, so the answers
+ * also land in the system cache that mstsc resolves from.
+ */
+BOOL StartResolverPrefetch(const wchar_t* const* names, int count)
+{
+    if (count <= 0 || InterlockedCompareExchange(&g_prefetchRunning, 1, 0) != 0)
+        return FALSE;
+
+    PrefetchJob* job = (PrefetchJob*)calloc(1, sizeof(PrefetchJob));
+    if (job != NULL)
+    {
+        job->names = calloc(count, sizeof(*job->names));
+        job->pointers = (const wchar_t**)malloc(sizeof(wchar_t*) * count);
+        job->results = (ResolvedName*)malloc(sizeof(ResolvedName) * count);
+    }
+    if (job == NULL || job->names == NULL || job->pointers == NULL || job->results == NULL)
+    {
+        if (job != NULL)
+            FreePrefetchJob(job);
+        InterlockedExchange(&g_prefetchRunning, 0);
+        return FALSE;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        SplitHostPort(names[i], 1, job->names[i], MAX_HOSTNAME_LEN);
+        job->pointers[i] = job->names[i];
+    }
+    job->count = count;
+
+    HANDLE thread = CreateThread(NULL, 0, PrefetchThread, job, 0, NULL);
+    if (thread == NULL)
+    {
+        FreePrefetchJob(job);
+        InterlockedExchange(&g_prefetchRunning, 0);
+        return FALSE;
+    }
+
+    // Nobody waits for it
+    CloseHandle(thread);
+    return TRUE;
+}
@@ -0,0 +1,65 @@
+/*
+ * Name Resolver Header
+ *
+ * Turns host names into addresses many at a time, and remembers the
+ * answers for as long as DNS says they are valid. Reachability probes
+ * resolve through it, and the most recently used hosts are resolved ahead
+ * of time so the lookup is already done (here and in the Windows DNS
+ * client cache that mstsc reads) when they are connected to.
+ *
+ * "No such name" answers are remembered too, for RESOLVER_NEGATIVE_TTL
+ * seconds, so a list full of retired hosts is not looked up again on
+ * every check. Lookups that failed for other reasons (timeouts, server
+ * failures) are not remembered.
+ */
+
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include <windows.h>
+#include "config.h"
+
+// Addresses kept per name
+#define RESOLVER_MAX_ADDRESSES  8
+
+// Most lookups one batch keeps in flight (one thread each)
+#define RESOLVER_MAX_CONCURRENCY 64
+
+// One address of a name
+typedef struct {
+    BYTE address[28];           // A SOCKADDR_IN or SOCKADDR_IN6 with port 0 (bytes, so this header needs no Winsock)
+    int addressLength;
+} ResolvedAddress;
+
+// Answer for one name
+typedef struct {
+    wchar_t name[MAX_HOSTNAME_LEN];
+    DWORD error;                // 0, WSAHOST_NOT_FOUND (no such name) or WSATRY_AGAIN (lookup failed)
+    int addressCount;
+    ResolvedAddress addresses[RESOLVER_MAX_ADDRESSES];  // IPv4 first, then IPv6
+    DWORD ttl;                  // Seconds the answer stays cached (0 = not cached)
+    BOOL fromCache;             // Answered without a lookup
+} ResolvedName;
+
+// Separate "host:port" / "[v6]:port" the way mstsc reads it
+// Returns the port (defaultPort if none), or 0 if the port is not valid
+USHORT SplitHostPort(const wchar_t* hostname, USHORT defaultPort, wchar_t* host, size_t hostLen);
+
+// Resolve one name (blocking; answered from the cache when possible)
+void ResolveName(const wchar_t* name, ResolvedName* result);
+
+// Resolve names concurrently (blocking); results[i] is filled for names[i]
+// concurrency - Lookups in flight at once (0 = ResolverConcurrency setting)
+// cancel - Optional; non-zero stops starting new lookups (the rest get WSATRY_AGAIN)
+// Returns FALSE if out of memory or no thread could start (nothing resolved)
+BOOL ResolveNames(const wchar_t* const* names, int count, int concurrency,
+                  ResolvedName* results, volatile LONG* cancel);
+
+// Resolve names on a background thread, only to fill the cache
+// Names may carry ":port"; returns FALSE if a prefetch is already running
+BOOL StartResolverPrefetch(const wchar_t* const* names, int count);
+
+// Forget every cached answer
+void ClearResolverCache(void);
+
+#endif // RESOLVER_H
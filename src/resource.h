@@ -23,6 +23,8 @@
 #define IDD_SCAN_RESULTS        104
 #define IDD_SCAN_DOMAIN         105
 #define IDD_ABOUT               106
+#define IDD_PALETTE             107
+#define IDD_DIAGNOSTICS         108
 
 // Control IDs - Login Dialog
 #define IDC_EDIT_USERNAME       200
@@ -39,6 +41,8 @@
 #define IDC_BTN_MANAGE          213
 #define IDC_BTN_EDIT_CREDS      214
 #define IDC_STATIC_HOST_COUNT   215
+#define IDC_COMBO_GROUP_BY      216
+#define IDC_TREE_SERVERS        217
 
 // Control IDs - Host Management Dialog
 #define IDC_LIST_HOSTS          220
@@ -62,12 +66,28 @@
 #define IDC_LIST_SCAN_RESULTS   240
 #define IDC_BTN_ADD_SELECTED    241
 #define IDC_STATIC_SCAN_STATUS  242
+#define IDC_EDIT_SCAN_FILTER    243
+#define IDC_BTN_CHECK_ALL       244
+#define IDC_BTN_CHECK_NONE      245
+#define IDC_BTN_SCAN_STOP       246
 
 // Control IDs - Scan Domain Dialog
 #define IDC_EDIT_DOMAIN         250
 #define IDC_CHECK_WORKSTATIONS  254
 #define IDC_CHECK_SERVERS       255
 #define IDC_CHECK_DOMAIN_CTRL   256
+#define IDC_RADIO_SCAN_BROWSE   257
+#define IDC_RADIO_SCAN_LDAP     258
+#define IDC_RADIO_SCAN_SWEEP    259
+
+// Control IDs - Quick Connect Palette
+#define IDC_EDIT_PALETTE        260
+#define IDC_LIST_PALETTE        261
+
+// Control IDs - Diagnostics Dialog
+#define IDC_LIST_DIAGNOSTICS    270
+#define IDC_BTN_DIAG_RESET      271
+#define IDC_BTN_DIAG_SAVE       272
 
 // Menu IDs
 #define IDM_OPEN                300
@@ -76,6 +96,8 @@
 #define IDM_DELETE_ALL          303
 #define IDM_GLOBAL_HOTKEY       304
 #define IDM_ABOUT_DIALOG        305  // About dialog menu item
+#define IDM_PALETTE_HOTKEY      306  // Quick connect palette hotkey
+#define IDM_DIAGNOSTICS         307  // Diagnostics dialog menu item
 
 // Recent connections menu IDs (range for dynamic menu items)
 #define IDM_RECENT_START        310
@@ -85,11 +107,22 @@
 #define IDM_CONTEXT_DELETE      320
 #define IDM_CONTEXT_EDIT        321
 #define IDM_CONTEXT_CONNECT     322
+#define IDM_CONTEXT_PROBE       323
+#define IDM_CONTEXT_PROBE_ALL   324
 
 // System Tray
 #define ID_TRAYICON             400
 #define WM_TRAYICON             (WM_USER + 1)
 
+// Private messages posted from worker threads
+#define WM_SEARCH_COMPLETE      (WM_APP + 1)  // lParam = SearchResult*
+#define WM_HOSTS_CHANGED        (WM_APP + 2)  // Hosts file was saved
+#define WM_SCAN_PROGRESS        (WM_APP + 3)  // Scan job has new computers (TakeScanJobResults)
+#define WM_SCAN_COMPLETE        (WM_APP + 4)  // Scan job has ended
+#define WM_PROBE_COMPLETE       (WM_APP + 5)  // Probe job done (wParam = reachable, lParam = probed)
+#define WM_MONITOR_UPDATE       (WM_APP + 6)  // Host monitor changed a status (AcknowledgeMonitorUpdate)
+#define WM_LAUNCH_COMPLETE      (WM_APP + 7)  // lParam = LaunchResult* (FinishLaunch)
+
 // Icons
 #define IDI_MAINICON            500
 
@@ -0,0 +1,795 @@
+/*
+ * Scan Cache Module
+ *
+ * Domain membership hardly changes from one day to the next, yet every
+ * scan used to start from an empty list and took as long as the first.
+ * The last complete enumeration of each source is now kept in
+ * scancache.bin, so the results dialog can show it straight away and the
+ * scan only has to report what differs.
+ *
+ * File layout (little-endian, strings UTF-8 without terminator, each
+ * preceded by its length in bytes as one byte):
+ *
+ *   DWORD magic, DWORD version, DWORD source count
+ *   per source:
+ *     DWORD mode, name
+ *     FILETIME scanned, ULONGLONG content hash, ULONGLONG checksum
+ *     DWORD computer count, DWORD bytes of computers that follow
+ *     per computer: ULONGLONG name hash, ULONGLONG entry hash,
+ *                   ULONGLONG lastLogon, name, comment, operating system
+ *
+ * The byte count lets a reader step over the sources it does not want
+ * without parsing them, and lets the writer copy them unchanged. Each
+ * computer carries the hashes the scan compares (HashHostKey and
+ * HashComputerEntry), so loading a source only steps through its records
+ * instead of hashing every string again; the content hash is their sum.
+ * A checksum over the computer bytes is checked on load, so a damaged or
+ * half-written source is ignored rather than shown. The whole file is
+ * written to a temporary file and moved over the old one, so a crash
+ * leaves the previous cache intact.
+ *
+ * Learning points:
+ *   - Length-prefixed binary records that can be skipped without parsing
+ *   - Order-independent hashes of a set (sum of element hashes)
+ *   - Replacing a file atomically with MoveFileEx
+ *   - Slim reader/writer locks around a shared file
+ */
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "scancache.h"
+
+// Loads and saves both come from scan workers, possibly of two jobs at once
+static SRWLOCK g_cacheLock = SRWLOCK_INIT;
+
+// Bounds-checked cursor over a loaded file
+typedef struct {
+    const BYTE* p;
+    size_t left;
+} CacheReader;
+
+// Growable output buffer
+typedef struct {
+    BYTE* data;
+    size_t size;
+    size_t capacity;
+    BOOL failed;        // Out of memory (everything after is dropped)
+} CacheWriter;
+
+// A source block found in the file
+typedef struct {
+    DWORD mode;
+    wchar_t name[256];
+    FILETIME scanned;
+    ULONGLONG contentHash;
+    ULONGLONG checksum;         // ChecksumCacheBytes of the computers
+    DWORD count;
+    const BYTE* computers;      // count computers, computerBytes long
+    DWORD computerBytes;
+    const BYTE* block;          // Whole block (for copying)
+    size_t blockBytes;
+} CacheSource;
+
+/*
+ * GetScanCachePath - Full path of scancache.bin (next to the executable)
+ */
+static BOOL GetScanCachePath(wchar_t* path, size_t pathLen)
+{
+    wchar_t exePath[MAX_PATH];
+
+    if (GetModuleFileNameW(NULL, exePath, MAX_PATH) == 0)
+        return FALSE;
+
+    wchar_t* lastSlash = wcsrchr(exePath, L'\\');
+    if (lastSlash == NULL)
+        return FALSE;
+    *(lastSlash + 1) = L'\0';
+
+    return swprintf_s(path, pathLen, L"%s%s", exePath, SCAN_CACHE_FILE_NAME) >= 0;
+}
+
+/*
+ * ReadScanCacheFile - Load the whole file into memory
+ *
+ * Returns FALSE if there is no file or it could not be read (*data = NULL).
+ * Caller frees *data.
+ */
+static BOOL ReadScanCacheFile(BYTE** data, size_t* size)
+{
+    wchar_t path[MAX_PATH];
+    FILE* file = NULL;
+
+    *data = NULL;
+    *size = 0;
+    if (!GetScanCachePath(path, MAX_PATH) || _wfopen_s(&file, path, L"rb") != 0 || file == NULL)
+        return FALSE;
+
+    BOOL ok = FALSE;
+    if (fseek(file, 0, SEEK_END) == 0)
+    {
+        long length = ftell(file);
+        if (length > 0 && fseek(file, 0, SEEK_SET) == 0)
+        {
+            *data = (BYTE*)malloc((size_t)length);
+            if (*data != NULL && fread(*data, 1, (size_t)length, file) == (size_t)length)
+            {
+                *size = (size_t)length;
+                ok = TRUE;
+            }
+        }
+    }
+    fclose(file);
+
+    if (!ok)
+    {
+        free(*data);
+        *data = NULL;
+    }
+    return ok;
+}
+
+static BOOL ReadCacheBytes(CacheReader* reader, void* out, size_t size)
+{
+    if (reader->left < size)
+        return FALSE;
+    memcpy(out, reader->p, size);
+    reader->p += size;
+    reader->left -= size;
+    return TRUE;
+}
+
+/*
+ * ReadCacheString - Read a length-prefixed string into a buffer of outLen characters
+ */
+static BOOL ReadCacheString(CacheReader* reader, wchar_t* out, size_t outLen)
+{
+    BYTE length;
+    if (!ReadCacheBytes(reader, &length, 1) || reader->left < length)
+        return FALSE;
+
+    int written = 0;
+    if (length > 0)
+    {
+        written = MultiByteToWideChar(CP_UTF8, 0, (const char*)reader->p, length, out, (int)outLen - 1);
+        if (written == 0)
+            return FALSE;
+    }
+    out[written] = L'\0';
+    reader->p += length;
+    reader->left -= length;
+    return TRUE;
+}
+
+/*
+ * SkipCacheString - Step over a length-prefixed string
+ */
+static BOOL SkipCacheString(CacheReader* reader)
+{
+    BYTE length;
+    if (!ReadCacheBytes(reader, &length, 1) || reader->left < length)
+        return FALSE;
+    reader->p += length;
+    reader->left -= length;
+    return TRUE;
+}
+
+/*
+ * ChecksumCacheBytes - FNV-1a over 8-byte words in four lanes, then the lanes and the bytes left over
+ *
+ * Only there to notice damage, so it takes a word at a time rather than
+ * hashing the strings character by character, and four independent lanes
+ * keep the multiplier busy instead of waiting on one long chain.
+ */
+static ULONGLONG ChecksumCacheBytes(const BYTE* bytes, size_t size)
+{
+    ULONGLONG lanes[4] = { 14695981039346656037ULL, 1, 2, 3 };
+    size_t i = 0;
+
+    for (; i + sizeof(lanes) <= size; i += sizeof(lanes))
+    {
+        ULONGLONG words[4];
+        memcpy(words, bytes + i, sizeof(words));
+        for (int lane = 0; lane < 4; lane++)
+        {
+            lanes[lane] ^= words[lane];
+            lanes[lane] *= 1099511628211ULL;
+        }
+    }
+
+    ULONGLONG hash = 14695981039346656037ULL;
+    for (int lane = 0; lane < 4; lane++)
+    {
+        hash ^= lanes[lane];
+        hash *= 1099511628211ULL;
+    }
+    for (; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/*
+ * ReadCacheSourceHeader - Read a source block up to its computers
+ */
+static BOOL ReadCacheSourceHeader(CacheReader* reader, CacheSource* source)
+{
+    return ReadCacheBytes(reader, &source->mode, sizeof(DWORD)) &&
+           ReadCacheString(reader, source->name, 256) &&
+           ReadCacheBytes(reader, &source->scanned, sizeof(FILETIME)) &&
+           ReadCacheBytes(reader, &source->contentHash, sizeof(ULONGLONG)) &&
+           ReadCacheBytes(reader, &source->checksum, sizeof(ULONGLONG)) &&
+           ReadCacheBytes(reader, &source->count, sizeof(DWORD)) &&
+           ReadCacheBytes(reader, &source->computerBytes, sizeof(DWORD));
+}
+
+/*
+ * ReadCacheSource - Read the next source block (its computers are only located)
+ */
+static BOOL ReadCacheSource(CacheReader* reader, CacheSource* source)
+{
+    const BYTE* start = reader->p;
+
+    if (!ReadCacheSourceHeader(reader, source) || reader->left < source->computerBytes)
+        return FALSE;
+
+    source->computers = reader->p;
+    reader->p += source->computerBytes;
+    reader->left -= source->computerBytes;
+    source->block = start;
+    source->blockBytes = (size_t)(reader->p - start);
+    return TRUE;
+}
+
+/*
+ * ReadCacheSourceFrom - Read the next source block's header straight from the file
+ *
+ * The file is left at the block's computers.
+ */
+static BOOL ReadCacheSourceFrom(FILE* file, CacheSource* source)
+{
+    // Mode and name length, then the name and the fixed fields after it
+    BYTE header[sizeof(DWORD) + 1 + 255 + sizeof(FILETIME) +
+                2 * sizeof(ULONGLONG) + 2 * sizeof(DWORD)];
+    size_t start = sizeof(DWORD) + 1;
+
+    if (fread(header, 1, start, file) != start)
+        return FALSE;
+    size_t rest = header[sizeof(DWORD)] + sizeof(FILETIME) +
+                  2 * sizeof(ULONGLONG) + 2 * sizeof(DWORD);
+    if (fread(header + start, 1, rest, file) != rest)
+        return FALSE;
+
+    CacheReader reader = { header, start + rest };
+    return ReadCacheSourceHeader(&reader, source);
+}
+
+/*
+ * OpenCacheReader - Check the file header
+ *
+ * Returns the number of sources, or -1 if this is not a cache file of this version.
+ */
+static int OpenCacheReader(CacheReader* reader, const BYTE* data, size_t size)
+{
+    DWORD magic = 0, version = 0, sourceCount = 0;
+
+    reader->p = data;
+    reader->left = size;
+    if (!ReadCacheBytes(reader, &magic, sizeof(DWORD)) ||
+        !ReadCacheBytes(reader, &version, sizeof(DWORD)) ||
+        !ReadCacheBytes(reader, &sourceCount, sizeof(DWORD)) ||
+        magic != SCAN_CACHE_MAGIC || version != SCAN_CACHE_VERSION ||
+        sourceCount > SCAN_CACHE_MAX_SOURCES)
+    {
+        return -1;
+    }
+    return (int)sourceCount;
+}
+
+static void WriteCacheBytes(CacheWriter* writer, const void* bytes, size_t size)
+{
+    if (writer->failed)
+        return;
+
+    if (writer->size + size > writer->capacity)
+    {
+        size_t newCapacity = (writer->capacity > 0) ? writer->capacity * 2 : 64 * 1024;
+        while (newCapacity < writer->size + size)
+            newCapacity *= 2;
+        BYTE* newData = (BYTE*)realloc(writer->data, newCapacity);
+        if (newData == NULL)
+        {
+            writer->failed = TRUE;
+            return;
+        }
+        writer->data = newData;
+        writer->capacity = newCapacity;
+    }
+    memcpy(writer->data + writer->size, bytes, size);
+    writer->size += size;
+}
+
+/*
+ * WriteCacheString - Write a string as UTF-8 with its length (at most 255 bytes)
+ *
+ * Host names and comments are nearly always ASCII, so this keeps the
+ * file a half (a quarter where wchar_t is four bytes) of what the
+ * characters take in memory; loading it is mostly reading it.
+ */
+static void WriteCacheString(CacheWriter* writer, const wchar_t* text)
+{
+    char utf8[256 * 4];
+    int length = 0;
+    if (text[0] != L'\0')
+        length = WideCharToMultiByte(CP_UTF8, 0, text, (int)wcslen(text), utf8, sizeof(utf8), NULL, NULL);
+
+    // Too long for the length byte: cut at the start of a character
+    if (length > 255)
+    {
+        length = 255;
+        while (length > 0 && (utf8[length] & 0xC0) == 0x80)
+            length--;
+    }
+
+    BYTE lengthByte = (BYTE)length;
+    WriteCacheBytes(writer, &lengthByte, 1);
+    WriteCacheBytes(writer, utf8, length);
+}
+
+/*
+ * HashComputerEntry - 64-bit FNV-1a of a computer's name, comment, OS and last logon
+ *
+ * The name is hashed in lowercase, like the scan's dedupe set; the other
+ * fields as they are, so a changed comment makes a different hash.
+ */
+ULONGLONG HashComputerEntry(const ComputerInfo* computer)
+{
+    return HashComputerDetails(computer, HashHostKey(computer->name));
+}
+
+/*
+ * HashComputerDetails - HashComputerEntry carried on from the name's HashHostKey
+ *
+ * HashHostKey is the same FNV-1a over the lowercase name, so a caller that
+ * already has it (the scan's dedupe) only pays for the other fields.
+ */
+ULONGLONG HashComputerDetails(const ComputerInfo* computer, ULONGLONG nameHash)
+{
+    ULONGLONG hash = nameHash;
+
+    // 0 between the fields, so "ab"+"c" and "a"+"bc" differ
+    const wchar_t* fields[2] = { computer->comment, computer->operatingSystem };
+    for (int i = 0; i < 2; i++)
+    {
+        hash *= 1099511628211ULL;
+        for (const wchar_t* p = fields[i]; *p != L'\0'; p++)
+        {
+            hash ^= (ULONGLONG)*p;
+            hash *= 1099511628211ULL;
+        }
+    }
+
+    // The whole timestamp at once; it is a number, not text
+    hash ^= computer->lastLogon;
+    hash *= 1099511628211ULL;
+    return (hash != 0) ? hash : 1;
+}
+
+/*
+ * HashComputerList - Sum of the entry hashes
+ *
+ * Addition does not care about order, so the same computers delivered in
+ * a different page order hash the same.
+ */
+ULONGLONG HashComputerList(const ComputerInfo* computers, int count)
+{
+    ULONGLONG hash = 0;
+    for (int i = 0; i < count; i++)
+        hash += HashComputerEntry(&computers[i]);
+    return hash;
+}
+
+/*
+ * ReadCacheComputer - Read one computer record (checked by ReadCachedComputers)
+ */
+static BOOL ReadCacheComputer(CacheReader* reader, ComputerInfo* computer)
+{
+    reader->p += 2 * sizeof(ULONGLONG);     // The hashes
+    reader->left -= 2 * sizeof(ULONGLONG);
+    return ReadCacheBytes(reader, &computer->lastLogon, sizeof(ULONGLONG)) &&
+           ReadCacheString(reader, computer->name, ARRAYSIZE(computer->name)) &&
+           ReadCacheString(reader, computer->comment, ARRAYSIZE(computer->comment)) &&
+           ReadCacheString(reader, computer->operatingSystem, ARRAYSIZE(computer->operatingSystem));
+}
+
+/*
+ * ReadCachedComputers - Read a source block's computers from the file and index them
+ *
+ * The records are kept as they are, and only stepped through here to
+ * find where each starts and pick up its hashes. ReadCachedComputer
+ * unpacks one when it is wanted.
+ */
+static BOOL ReadCachedComputers(FILE* file, const CacheSource* entry, CachedScan* cached)
+{
+    if (entry->count == 0 || entry->count > entry->computerBytes)
+        return FALSE;
+
+    cached->records = (BYTE*)malloc(entry->computerBytes);
+    cached->offsets = (DWORD*)malloc(entry->count * sizeof(DWORD));
+    cached->nameHashes = (ULONGLONG*)malloc(entry->count * 2 * sizeof(ULONGLONG));
+    if (cached->records == NULL || cached->offsets == NULL || cached->nameHashes == NULL ||
+        fread(cached->records, 1, entry->computerBytes, file) != entry->computerBytes ||
+        ChecksumCacheBytes(cached->records, entry->computerBytes) != entry->checksum)
+    {
+        return FALSE;
+    }
+    cached->size = entry->computerBytes;
+    cached->entryHashes = cached->nameHashes + entry->count;
+    cached->count = (int)entry->count;
+
+    CacheReader reader = { cached->records, entry->computerBytes };
+    ULONGLONG contentHash = 0;
+    ULONGLONG lastLogon;
+    for (DWORD i = 0; i < entry->count; i++)
+    {
+        cached->offsets[i] = (DWORD)(reader.p - cached->records);
+        if (!ReadCacheBytes(&reader, &cached->nameHashes[i], sizeof(ULONGLONG)) ||
+            !ReadCacheBytes(&reader, &cached->entryHashes[i], sizeof(ULONGLONG)) ||
+            !ReadCacheBytes(&reader, &lastLogon, sizeof(ULONGLONG)) ||
+            !SkipCacheString(&reader) || !SkipCacheString(&reader) || !SkipCacheString(&reader))
+        {
+            return FALSE;
+        }
+        contentHash += cached->entryHashes[i];
+    }
+    if (contentHash != entry->contentHash)
+        return FALSE;
+
+    cached->scanned = entry->scanned;
+    cached->contentHash = entry->contentHash;
+    return TRUE;
+}
+
+/*
+ * ReadCachedComputer - Unpack computer index of a loaded enumeration
+ *
+ * The load checked every record against its checksum, so the strings are
+ * the ones that were written; should one still not decode, the
+ * computer's strings are left empty rather than half filled.
+ */
+void ReadCachedComputer(const CachedScan* cached, int index, ComputerInfo* computer)
+{
+    DWORD offset = cached->offsets[index];
+    CacheReader reader = { cached->records + offset, cached->size - offset };
+
+    if (!ReadCacheComputer(&reader, computer))
+    {
+        computer->name[0] = L'\0';
+        computer->comment[0] = L'\0';
+        computer->operatingSystem[0] = L'\0';
+    }
+}
+
+/*
+ * LoadScanCaches - Load the cached enumerations of several sources
+ *
+ * Parameters:
+ *   mode    - Scan mode the sources belong to
+ *   sources - Domains/workgroups, directories or ranges (empty = current domain)
+ *   count   - Number of sources
+ *   cached  - Receives each source's computers and their hashes (free with FreeCachedScan)
+ *   status  - Receives, per source:
+ *             SCAN_CACHE_LOADED if it was cached and its checksum and content hash matched,
+ *             SCAN_CACHE_DAMAGED if it was cached but did not match (nothing loaded),
+ *             SCAN_CACHE_MISSING otherwise
+ *
+ * The file is read once, front to back, however many sources are asked
+ * for: each wanted source's computers go straight into its own buffer and
+ * the other sources are skipped.
+ */
+void LoadScanCaches(ScanMode mode, const wchar_t* const* sources, int count,
+                    CachedScan* cached, ScanCacheStatus* status)
+{
+    wchar_t path[MAX_PATH];
+    FILE* file = NULL;
+
+    for (int i = 0; i < count; i++)
+    {
+        memset(&cached[i], 0, sizeof(CachedScan));
+        status[i] = SCAN_CACHE_MISSING;
+    }
+    if (!GetScanCachePath(path, MAX_PATH))
+        return;
+
+    AcquireSRWLockShared(&g_cacheLock);
+    if (_wfopen_s(&file, path, L"rb") != 0 || file == NULL)
+    {
+        ReleaseSRWLockShared(&g_cacheLock);
+        return;
+    }
+
+    BYTE header[3 * sizeof(DWORD)];
+    CacheReader reader;
+    int sourceCount = -1;
+    if (fread(header, 1, sizeof(header), file) == sizeof(header))
+        sourceCount = OpenCacheReader(&reader, header, sizeof(header));
+
+    for (int i = 0; i < sourceCount; i++)
+    {
+        CacheSource entry;
+        if (!ReadCacheSourceFrom(file, &entry))
+            break;
+
+        int wanted = -1;
+        for (int j = 0; j < count && wanted < 0 && entry.mode == (DWORD)mode; j++)
+        {
+            if (status[j] == SCAN_CACHE_MISSING && _wcsicmp(entry.name, sources[j]) == 0)
+                wanted = j;
+        }
+        if (wanted < 0)
+        {
+            if (fseek(file, (long)entry.computerBytes, SEEK_CUR) != 0)
+                break;
+            continue;
+        }
+
+        // Wherever a damaged block leaves the file, the next one starts here
+        long next = ftell(file) + (long)entry.computerBytes;
+        if (ReadCachedComputers(file, &entry, &cached[wanted]))
+        {
+            status[wanted] = SCAN_CACHE_LOADED;
+        }
+        else
+        {
+            FreeCachedScan(&cached[wanted]);
+            status[wanted] = SCAN_CACHE_DAMAGED;
+            if (fseek(file, next, SEEK_SET) != 0)
+                break;
+        }
+    }
+
+    fclose(file);
+    ReleaseSRWLockShared(&g_cacheLock);
+}
+
+/*
+ * LoadScanCache - Load the cached enumeration of one source (see LoadScanCaches)
+ */
+ScanCacheStatus LoadScanCache(ScanMode mode, const wchar_t* source, CachedScan* cached)
+{
+    ScanCacheStatus status;
+    LoadScanCaches(mode, &source, 1, cached, &status);
+    return status;
+}
+
+/*
+ * AddCacheListName - Record a name hash in a list's table
+ *
+ * Returns FALSE if the name was already there or the table could not grow
+ * (list->failed is then set).
+ */
+static BOOL AddCacheListName(ScanCacheList* list, ULONGLONG nameHash)
+{
+    // Keep the table at most half full
+    if ((list->count + 1) * 2 > list->namesCapacity)
+    {
+        int newCapacity = (list->namesCapacity > 0) ? list->namesCapacity * 2 : 1024;
+        while ((list->count + 1) * 2 > newCapacity)
+            newCapacity *= 2;
+        ULONGLONG* names = (ULONGLONG*)calloc(newCapacity, sizeof(ULONGLONG));
+        if (names == NULL)
+        {
+            list->failed = TRUE;
+            return FALSE;
+        }
+        for (int i = 0; i < list->namesCapacity; i++)
+        {
+            if (list->names[i] == 0)
+                continue;
+            int slot = (int)(list->names[i] & (ULONGLONG)(newCapacity - 1));
+            while (names[slot] != 0)
+                slot = (slot + 1) & (newCapacity - 1);
+            names[slot] = list->names[i];
+        }
+        free(list->names);
+        list->names = names;
+        list->namesCapacity = newCapacity;
+    }
+
+    int slot = (int)(nameHash & (ULONGLONG)(list->namesCapacity - 1));
+    while (list->names[slot] != 0 && list->names[slot] != nameHash)
+        slot = (slot + 1) & (list->namesCapacity - 1);
+    if (list->names[slot] == nameHash)
+        return FALSE;
+    list->names[slot] = nameHash;
+    return TRUE;
+}
+
+/*
+ * AddScanCacheComputer - Append a computer to a source's list in the file's layout
+ *
+ * Pages of a changing browse list can repeat a name; only the first is kept.
+ */
+void AddScanCacheComputer(ScanCacheList* list, const ComputerInfo* computer,
+                          ULONGLONG nameHash, ULONGLONG entryHash)
+{
+    if (list->failed || !AddCacheListName(list, nameHash))
+        return;
+
+    // The records are written with the file's own writer
+    CacheWriter writer = { list->records, list->size, list->capacity, FALSE };
+    WriteCacheBytes(&writer, &nameHash, sizeof(ULONGLONG));
+    WriteCacheBytes(&writer, &entryHash, sizeof(ULONGLONG));
+    WriteCacheBytes(&writer, &computer->lastLogon, sizeof(ULONGLONG));
+    WriteCacheString(&writer, computer->name);
+    WriteCacheString(&writer, computer->comment);
+    WriteCacheString(&writer, computer->operatingSystem);
+    list->records = writer.data;
+    list->size = writer.size;
+    list->capacity = writer.capacity;
+    list->failed = writer.failed;
+
+    list->count++;
+    list->contentHash += entryHash;
+}
+
+/*
+ * StartScanCacheList - Fill an empty list with the first count cached computers
+ *
+ * For a source that reported its cache in the same order up to some point:
+ * the records are copied as they are, without unpacking them.
+ */
+void StartScanCacheList(ScanCacheList* list, const CachedScan* cached, int count)
+{
+    if (count <= 0)
+        return;
+
+    for (int i = 0; i < count && !list->failed; i++)
+    {
+        AddCacheListName(list, cached->nameHashes[i]);
+        list->contentHash += cached->entryHashes[i];
+        list->count++;
+    }
+
+    size_t size = (count < cached->count) ? cached->offsets[count] : cached->size;
+    CacheWriter writer = { list->records, list->size, list->capacity, list->failed };
+    WriteCacheBytes(&writer, cached->records, size);
+    list->records = writer.data;
+    list->size = writer.size;
+    list->capacity = writer.capacity;
+    list->failed = writer.failed;
+}
+
+/*
+ * SaveScanCaches - Replace the cached enumerations of several sources
+ *
+ * Parameters:
+ *   mode    - Scan mode the sources belong to
+ *   sources - Domains/workgroups, directories or ranges (empty = current domain)
+ *   lists   - What each source reported (built with AddScanCacheComputer)
+ *   count   - Number of sources (at most SCAN_CACHE_MAX_SOURCES)
+ *
+ * The other sources are copied unchanged, and the file is read and
+ * written once for all of them. When there is not room for every source,
+ * the least recently scanned of the others go.
+ *
+ * Returns:
+ *   TRUE if the file was written
+ */
+BOOL SaveScanCaches(ScanMode mode, const wchar_t* const* sources, const ScanCacheList* const* lists, int count)
+{
+    wchar_t path[MAX_PATH];
+    wchar_t tempPath[MAX_PATH + 8];
+    BYTE* data = NULL;
+    size_t size = 0;
+    CacheSource kept[SCAN_CACHE_MAX_SOURCES];
+    int keptCount = 0;
+
+    if (count <= 0 || count > SCAN_CACHE_MAX_SOURCES || !GetScanCachePath(path, MAX_PATH))
+        return FALSE;
+    for (int i = 0; i < count; i++)
+    {
+        if (lists[i]->failed)
+            return FALSE;
+    }
+    swprintf_s(tempPath, ARRAYSIZE(tempPath), L"%s.tmp", path);
+
+    AcquireSRWLockExclusive(&g_cacheLock);
+
+    // Keep the other sources of the current file (a file we cannot read is replaced)
+    CacheReader reader;
+    int sourceCount = ReadScanCacheFile(&data, &size) ? OpenCacheReader(&reader, data, size) : 0;
+    for (int i = 0; i < sourceCount; i++)
+    {
+        CacheSource* entry = &kept[keptCount];
+        if (!ReadCacheSource(&reader, entry))
+            break;
+
+        BOOL replaced = FALSE;
+        for (int j = 0; j < count && !replaced; j++)
+            replaced = (entry->mode == (DWORD)mode && _wcsicmp(entry->name, sources[j]) == 0);
+        if (!replaced)
+            keptCount++;
+    }
+
+    // Make room for the new ones by dropping the oldest
+    while (keptCount + count > SCAN_CACHE_MAX_SOURCES)
+    {
+        int oldest = 0;
+        for (int i = 1; i < keptCount; i++)
+        {
+            if (CompareFileTime(&kept[i].scanned, &kept[oldest].scanned) < 0)
+                oldest = i;
+        }
+        kept[oldest] = kept[--keptCount];
+    }
+
+    CacheWriter writer = {0};
+    DWORD magic = SCAN_CACHE_MAGIC, version = SCAN_CACHE_VERSION, newCount = (DWORD)(keptCount + count);
+    WriteCacheBytes(&writer, &magic, sizeof(DWORD));
+    WriteCacheBytes(&writer, &version, sizeof(DWORD));
+    WriteCacheBytes(&writer, &newCount, sizeof(DWORD));
+    for (int i = 0; i < keptCount; i++)
+        WriteCacheBytes(&writer, kept[i].block, kept[i].blockBytes);
+
+    // The new sources, their records already in the file's layout
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    DWORD modeValue = (DWORD)mode;
+    for (int i = 0; i < count; i++)
+    {
+        DWORD computerCount = (DWORD)lists[i]->count;
+        DWORD computerBytes = (DWORD)lists[i]->size;
+        ULONGLONG checksum = ChecksumCacheBytes(lists[i]->records, lists[i]->size);
+        WriteCacheBytes(&writer, &modeValue, sizeof(DWORD));
+        WriteCacheString(&writer, sources[i]);
+        WriteCacheBytes(&writer, &now, sizeof(FILETIME));
+        WriteCacheBytes(&writer, &lists[i]->contentHash, sizeof(ULONGLONG));
+        WriteCacheBytes(&writer, &checksum, sizeof(ULONGLONG));
+        WriteCacheBytes(&writer, &computerCount, sizeof(DWORD));
+        WriteCacheBytes(&writer, &computerBytes, sizeof(DWORD));
+        WriteCacheBytes(&writer, lists[i]->records, lists[i]->size);
+    }
+    free(data);
+
+    // Write it all next to the old file, then swap
+    BOOL ok = FALSE;
+    FILE* file = NULL;
+    if (!writer.failed && _wfopen_s(&file, tempPath, L"wb") == 0 && file != NULL)
+    {
+        ok = (fwrite(writer.data, 1, writer.size, file) == writer.size);
+        ok = (fclose(file) == 0) && ok;
+        ok = ok && MoveFileExW(tempPath, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+        if (!ok)
+            DeleteFileW(tempPath);
+    }
+
+    ReleaseSRWLockExclusive(&g_cacheLock);
+    free(writer.data);
+    return ok;
+}
+
+/*
+ * FreeCachedScan - Free a loaded enumeration
+ */
+void FreeCachedScan(CachedScan* cached)
+{
+    free(cached->records);
+    free(cached->offsets);
+    free(cached->nameHashes);
+    memset(cached, 0, sizeof(CachedScan));
+}
+
+/*
+ * FreeScanCacheList - Free a list built with AddScanCacheComputer
+ */
+void FreeScanCacheList(ScanCacheList* list)
+{
+    free(list->records);
+    free(list->names);
+    memset(list, 0, sizeof(ScanCacheList));
+}
@@ -0,0 +1,95 @@
+/*
+ * Scan Cache Header
+ *
+ * Remembers the last complete enumeration of every scan source (a domain,
+ * a directory or an IP range) in one compact binary file next to the
+ * executable. The scan results dialog shows the cached computers at once
+ * and refreshes them in the background; only computers that are new or
+ * whose details changed are passed on again.
+ *
+ * The file holds nothing a domain member cannot enumerate for itself, so
+ * unlike hosts.csv it is not encrypted.
+ */
+
+#ifndef SCANCACHE_H
+#define SCANCACHE_H
+
+#include <windows.h>
+#include "adscan.h"
+#include "scanjob.h"
+
+// File identification ("WRSC") and layout version
+#define SCAN_CACHE_MAGIC        0x57525343
+#define SCAN_CACHE_VERSION      2
+
+// Most sources the file keeps (the least recently scanned is dropped)
+#define SCAN_CACHE_MAX_SOURCES  64
+
+// One cached enumeration, kept as the file stores it (free with FreeCachedScan)
+typedef struct {
+    BYTE* records;              // The computers in the file's layout (see ReadCachedComputer)
+    size_t size;                // Bytes of records
+    DWORD* offsets;             // Where each computer starts in records
+    ULONGLONG* nameHashes;      // HashHostKey of each computer's name
+    ULONGLONG* entryHashes;     // HashComputerEntry of each computer
+    int count;
+    FILETIME scanned;           // When the enumeration was saved (UTC)
+    ULONGLONG contentHash;      // HashComputerList of the computers
+} CachedScan;
+
+// A source's enumeration as it arrives, kept as the file stores it (a
+// few dozen bytes a computer rather than a whole ComputerInfo). Start
+// from all zeros; free with FreeScanCacheList.
+typedef struct {
+    BYTE* records;              // The computers in the file's layout
+    size_t size;
+    size_t capacity;
+    ULONGLONG* names;           // Name hashes added, to drop repeats (0 = empty slot)
+    int namesCapacity;          // Power of two
+    int count;
+    ULONGLONG contentHash;      // HashComputerList of the computers added
+    BOOL failed;                // Out of memory: incomplete, must not be saved
+} ScanCacheList;
+
+// What LoadScanCache found
+typedef enum {
+    SCAN_CACHE_MISSING,         // The source has not been cached (or the file cannot be read)
+    SCAN_CACHE_LOADED,
+    SCAN_CACHE_DAMAGED          // Cached, but the entry does not match its checksum - ignored
+} ScanCacheStatus;
+
+// 64-bit hash of everything shown about a computer (name case-insensitive)
+ULONGLONG HashComputerEntry(const ComputerInfo* computer);
+
+// The same, for a computer whose HashHostKey is already known
+ULONGLONG HashComputerDetails(const ComputerInfo* computer, ULONGLONG nameHash);
+
+// Hash of a list that does not depend on the order of the computers
+ULONGLONG HashComputerList(const ComputerInfo* computers, int count);
+
+// Load the cached enumeration of one source (empty name = current domain)
+ScanCacheStatus LoadScanCache(ScanMode mode, const wchar_t* source, CachedScan* cached);
+
+// Load several sources with one read of the file; status[i] tells what was found for sources[i]
+void LoadScanCaches(ScanMode mode, const wchar_t* const* sources, int count,
+                    CachedScan* cached, ScanCacheStatus* status);
+
+// Unpack one computer of a loaded enumeration
+void ReadCachedComputer(const CachedScan* cached, int index, ComputerInfo* computer);
+
+// Start an empty list with the first count computers of a loaded enumeration
+void StartScanCacheList(ScanCacheList* list, const CachedScan* cached, int count);
+
+// Add a computer to a list (nameHash = HashHostKey, entryHash = HashComputerEntry);
+// a name already in the list is skipped
+void AddScanCacheComputer(ScanCacheList* list, const ComputerInfo* computer,
+                          ULONGLONG nameHash, ULONGLONG entryHash);
+
+// Replace the cached enumerations of several sources with one write of the file
+// Returns FALSE if the file could not be written
+BOOL SaveScanCaches(ScanMode mode, const wchar_t* const* sources, const ScanCacheList* const* lists, int count);
+
+void FreeCachedScan(CachedScan* cached);
+void FreeScanCacheList(ScanCacheList* list);
+
+#endif // SCANCACHE_H
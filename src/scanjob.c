@@ -0,0 +1,1106 @@
+/*
+ * Scan Job Module
+ *
+ * A domain scan can take minutes on a large network, and NetServerEnumEx
+ * blocks for every page. Running it on the UI thread froze the Host
+ * Management dialog until the very end, so the scan runs on worker
+ * threads instead:
+ *
+ *   1. StartScanJob splits the domain list into sources and starts a
+ *      bounded pool of workers (never more workers than sources).
+ *   2. Each worker claims the next unclaimed source with
+ *      InterlockedIncrement and runs the ComputerSource on it, so a slow
+ *      domain only ever holds up one worker.
+ *   3. For every page a source delivers, the worker drops names any source
+ *      has already found, appends the rest to a pending array and posts
+ *      WM_SCAN_PROGRESS - at most one at a time, so fast sources cannot
+ *      flood the message queue.
+ *   4. The dialog calls TakeScanJobResults, which hands over the pending
+ *      array (swapping in the one it handed over last time) and allows
+ *      the next WM_SCAN_PROGRESS.
+ *   5. CancelScanJob, or a source running past its timeout, stops that
+ *      source after its current page. A page that is already being read
+ *      cannot be interrupted and is finished first.
+ *   6. The last worker to end adds up the per-source outcomes and posts
+ *      WM_SCAN_COMPLETE.
+ *
+ * Workers must not queue each other up while they merge. A page is hashed
+ * before any lock is taken, and the dedupe set is split into shards by
+ * the top bits of the name hash, each behind its own slim lock: a page
+ * locks every shard it touches once, and two workers only wait on each
+ * other when they reach the same shard at the same moment. The new
+ * computers are then appended to the pending array under its own lock,
+ * and the counts moved under the job lock - both held for one copy or a
+ * few additions, never for a whole page's hashing.
+ *
+ * Duplicates are found with a hash set of 64-bit FNV-1a hashes of the
+ * lowercase names. Two different names with the same 64-bit hash would
+ * hide one computer, which is unlikely enough to ignore for a browse list.
+ * Computers are identified by name only, like hosts.csv: the same NetBIOS
+ * name in two domains is listed once.
+ *
+ * With the scan cache on, a second table maps the name hash of every
+ * cached computer to the hash of its details. A computer whose details
+ * hash the same is already on screen and is only counted; the rest are
+ * queued as usual and replace the cached row. The first worker loads the
+ * cache before the others start, so opening the dialog never waits on the
+ * file, and posts WM_SCAN_PROGRESS for the cached rows as soon as they are
+ * there. Each source also keeps
+ * what it reported in the cache file's compact layout, appended by its
+ * own worker without a lock. When the last worker ends, every source that
+ * ran to the end and reported something other than its cache is saved,
+ * with one read and one write of the file.
+ *
+ * Learning points:
+ *   - Keeping the UI responsive with worker threads
+ *   - A bounded worker pool pulling from a shared work counter
+ *   - Cooperative cancellation and timeouts at natural boundaries
+ *   - Coalescing notifications with InterlockedExchange
+ *   - Open addressing hash sets
+ *   - Incremental refresh: compare hashes, pass on only what changed
+ */
+
+#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wctype.h>
+#include "config.h"
+#include "resource.h"
+#include "scanjob.h"
+#include "scancache.h"
+
+// A cached computer (nameHash 0 = empty slot)
+typedef struct {
+    ULONGLONG nameHash;
+    ULONGLONG entryHash;            // HashComputerEntry of the details on screen
+} CachedName;
+
+// Shards of the dedupe set (a power of two); the top bits of a hash pick one
+#define SEEN_SHARD_BITS 4
+#define SEEN_SHARDS     (1 << SEEN_SHARD_BITS)
+
+// One shard of the names found (open addressing, 0 = empty slot)
+typedef struct {
+    SRWLOCK lock;
+    ULONGLONG* names;
+    int count;
+    int capacity;                   // Power of two
+} SeenShard;
+
+// What the merge decided for one computer of a page
+#define PAGE_REPEATED   0           // Already found (by any source)
+#define PAGE_NEW        1           // Found for the first time - queue it
+#define PAGE_UNCHANGED  2           // Found for the first time, exactly as cached
+#define PAGE_CHANGED    3           // Found for the first time, cached with other details - queue it
+#define PAGE_NO_MEMORY  (-1)
+
+struct ScanJob {
+    ScanParams params;
+    ComputerSource source;
+    HWND hwndNotify;
+    HANDLE threads[SCAN_MAX_WORKERS];
+    int threadCount;
+
+    ScanSourceResult sources[SCAN_MAX_SOURCES];
+    int sourceCount;
+    volatile LONG nextSource;       // Next source a worker will claim
+    volatile LONG runningWorkers;   // The last worker to end reports completion
+
+    SeenShard seen[SEEN_SHARDS];    // Names found, each shard behind its own lock
+
+    SRWLOCK pendingLock;            // Protects the pending and taken arrays
+    ComputerInfo* pending;          // Found since the last TakeScanJobResults
+    int pendingCount;
+    int pendingCapacity;
+    ComputerInfo* taken;            // Handed out by the last TakeScanJobResults, pending again next time
+    int takenCapacity;
+
+    CRITICAL_SECTION lock;          // Protects everything below and the sources
+    ScanProgress progress;
+    ULONGLONG startTicks;           // GetTickCount64 when the scan started
+
+    // Only with params.useCache
+    CachedName* cache;              // Cached computers (read-only once workers run)
+    int cacheCapacity;              // Power of two
+    CachedScan cached[SCAN_MAX_SOURCES];        // Each source's cache (read-only once workers run)
+    ScanCacheList reported[SCAN_MAX_SOURCES];   // Each written only by the worker running the source
+    BOOL cacheCurrent[SCAN_MAX_SOURCES];        // The source ended complete, reporting its cache as it was
+
+    // Cached computers not handed out yet (only TakeScanJobResults uses these)
+    BYTE* cachedRepeated;           // Per cached computer, sources in order: 1 = cached for an earlier one
+    int cachedFirst[SCAN_MAX_SOURCES];  // Where each source's computers start in cachedRepeated
+    int cachedSource;               // Next to hand out: cached[cachedSource] ...
+    int cachedIndex;                // ... computer cachedIndex
+    int cachedTaken;                // Index into cachedRepeated
+    int cachedLeft;
+    ULONGLONG* gone;                // Name hashes of cached computers no longer reported
+    int goneCount;
+
+    volatile LONG cancelRequested;
+    volatile LONG notifyPending;    // A WM_SCAN_PROGRESS is in the queue
+    volatile LONG cacheReady;       // The cache fields above are filled in (set once, by the first worker)
+};
+
+// What a worker passes to the source's callback
+typedef struct {
+    ScanJob* job;
+    int source;                     // Index into job->sources
+    ULONGLONG deadline;             // GetTickCount64 after which the source stops (0 = none)
+    const ScanSummary* summary;     // The source's summary as it fills it in
+    ULONGLONG* hashes;              // Per page: name hashes ...
+    ULONGLONG* entryHashes;         // ... HashComputerEntry (only with params.useCache) ...
+    int* verdicts;                  // ... and PAGE_* of each computer
+    int pageCapacity;
+    int matched;                    // Computers reported in the cached order so far (-1 = they were not)
+    int pageMatched;                // Computers of this page that went on in that order
+} SourceContext;
+
+/*
+ * SeenShardOf - The dedupe shard a name hash belongs to
+ */
+static SeenShard* SeenShardOf(ScanJob* job, ULONGLONG hash)
+{
+    return &job->seen[hash >> (64 - SEEN_SHARD_BITS)];
+}
+
+/*
+ * AddSeenName - Insert a name hash into its shard
+ *
+ * Returns PAGE_NEW if the name is new, PAGE_REPEATED if it was already
+ * there, PAGE_NO_MEMORY if the shard could not grow.
+ * Must be called with the shard's lock held.
+ */
+static int AddSeenName(SeenShard* shard, ULONGLONG hash)
+{
+    // Keep the table at most half full
+    if ((shard->count + 1) * 2 > shard->capacity)
+    {
+        int newCapacity = (shard->capacity > 0) ? shard->capacity * 2 : 256;
+        ULONGLONG* newNames = (ULONGLONG*)calloc(newCapacity, sizeof(ULONGLONG));
+        if (newNames == NULL)
+            return PAGE_NO_MEMORY;
+
+        for (int i = 0; i < shard->capacity; i++)
+        {
+            if (shard->names[i] == 0)
+                continue;
+            int slot = (int)(shard->names[i] & (newCapacity - 1));
+            while (newNames[slot] != 0)
+                slot = (slot + 1) & (newCapacity - 1);
+            newNames[slot] = shard->names[i];
+        }
+        free(shard->names);
+        shard->names = newNames;
+        shard->capacity = newCapacity;
+    }
+
+    int slot = (int)(hash & (shard->capacity - 1));
+    while (shard->names[slot] != 0)
+    {
+        if (shard->names[slot] == hash)
+            return PAGE_REPEATED;
+        slot = (slot + 1) & (shard->capacity - 1);
+    }
+    shard->names[slot] = hash;
+    shard->count++;
+    return PAGE_NEW;
+}
+
+/*
+ * FindSeenName - TRUE if a name hash has been found
+ *
+ * Only called once every worker has ended, so the shard is not locked.
+ */
+static BOOL FindSeenName(ScanJob* job, ULONGLONG hash)
+{
+    const SeenShard* shard = SeenShardOf(job, hash);
+    if (shard->capacity == 0)
+        return FALSE;
+
+    int slot = (int)(hash & (shard->capacity - 1));
+    while (shard->names[slot] != 0)
+    {
+        if (shard->names[slot] == hash)
+            return TRUE;
+        slot = (slot + 1) & (shard->capacity - 1);
+    }
+    return FALSE;
+}
+
+/*
+ * FindCachedName - Look up a cached computer by name hash (NULL if not cached)
+ */
+static const CachedName* FindCachedName(const ScanJob* job, ULONGLONG hash)
+{
+    if (job->cache == NULL)
+        return NULL;
+
+    int slot = (int)(hash & (job->cacheCapacity - 1));
+    while (job->cache[slot].nameHash != 0)
+    {
+        if (job->cache[slot].nameHash == hash)
+            return &job->cache[slot];
+        slot = (slot + 1) & (job->cacheCapacity - 1);
+    }
+    return NULL;
+}
+
+/*
+ * UpdateScanRate - Refresh the elapsed time and rate (job lock held)
+ */
+static void UpdateScanRate(ScanJob* job)
+{
+    job->progress.elapsedMs = (double)(GetTickCount64() - job->startTicks);
+    job->progress.perSecond = (job->progress.elapsedMs > 0.0)
+        ? job->progress.found * 1000.0 / job->progress.elapsedMs
+        : 0.0;
+    job->progress.examinedPerSecond = (job->progress.elapsedMs > 0.0)
+        ? job->progress.examined * 1000.0 / job->progress.elapsedMs
+        : 0.0;
+}
+
+/*
+ * UpdateSourceSummary - Take a source's latest summary into the totals (job lock held)
+ */
+static void UpdateSourceSummary(ScanJob* job, ScanSourceResult* source, const ScanSummary* summary)
+{
+    job->progress.examined += summary->entriesReceived - source->summary.entriesReceived;
+    job->progress.toExamine += summary->totalEntries - source->summary.totalEntries;
+    source->summary = *summary;
+}
+
+/*
+ * NotifyScanProgress - Post WM_SCAN_PROGRESS unless one is already waiting
+ */
+static void NotifyScanProgress(ScanJob* job)
+{
+    if (job->hwndNotify != NULL && InterlockedExchange(&job->notifyPending, 1) == 0)
+    {
+        if (!PostMessageW(job->hwndNotify, WM_SCAN_PROGRESS, 0, 0))
+            InterlockedExchange(&job->notifyPending, 0);
+    }
+}
+
+/*
+ * GrowPageBuffers - Make room for a page of count computers in the worker's buffers
+ */
+static BOOL GrowPageBuffers(SourceContext* context, int count)
+{
+    if (count <= context->pageCapacity)
+        return TRUE;
+
+    ULONGLONG* hashes = (ULONGLONG*)realloc(context->hashes, sizeof(ULONGLONG) * count);
+    if (hashes == NULL)
+        return FALSE;
+    context->hashes = hashes;
+
+    ULONGLONG* entryHashes = (ULONGLONG*)realloc(context->entryHashes, sizeof(ULONGLONG) * count);
+    if (entryHashes == NULL)
+        return FALSE;
+    context->entryHashes = entryHashes;
+
+    int* verdicts = (int*)realloc(context->verdicts, sizeof(int) * count);
+    if (verdicts == NULL)
+        return FALSE;
+    context->verdicts = verdicts;
+
+    context->pageCapacity = count;
+    return TRUE;
+}
+
+/*
+ * SortPageIntoShards - Decide PAGE_* for every computer of a page
+ *
+ * Each shard the page touches is locked once, for the names that belong
+ * to it. Cached computers are compared without a lock, since the cache
+ * table does not change once the workers run.
+ */
+static void SortPageIntoShards(ScanJob* job, const ComputerInfo* batch, int count, SourceContext* context)
+{
+    unsigned int touched = 0;
+    for (int i = 0; i < count; i++)
+    {
+        context->hashes[i] = HashHostKey(batch[i].name);
+        touched |= 1u << (context->hashes[i] >> (64 - SEEN_SHARD_BITS));
+    }
+
+    for (int shardIndex = 0; shardIndex < SEEN_SHARDS; shardIndex++)
+    {
+        if ((touched & (1u << shardIndex)) == 0)
+            continue;
+
+        SeenShard* shard = &job->seen[shardIndex];
+        AcquireSRWLockExclusive(&shard->lock);
+        for (int i = 0; i < count; i++)
+        {
+            if ((int)(context->hashes[i] >> (64 - SEEN_SHARD_BITS)) == shardIndex)
+                context->verdicts[i] = AddSeenName(shard, context->hashes[i]);
+        }
+        ReleaseSRWLockExclusive(&shard->lock);
+    }
+
+    if (!job->params.useCache)
+        return;
+
+    // The name hash is the start of the entry hash
+    for (int i = 0; i < count; i++)
+        context->entryHashes[i] = HashComputerDetails(&batch[i], context->hashes[i]);
+
+    // A source reporting its own cache in the same order: those computers
+    // are on screen as they are, unless an earlier source cached them too
+    const CachedScan* own = &job->cached[context->source];
+    const BYTE* repeated = (job->cachedRepeated != NULL) ? job->cachedRepeated + job->cachedFirst[context->source] : NULL;
+    context->pageMatched = 0;
+    while (context->matched >= 0 && context->pageMatched < count &&
+           context->matched + context->pageMatched < own->count &&
+           own->entryHashes[context->matched + context->pageMatched] == context->entryHashes[context->pageMatched])
+    {
+        context->pageMatched++;
+    }
+
+    // A cached row that is still right needs no update
+    for (int i = 0; i < count && job->cache != NULL; i++)
+    {
+        if (context->verdicts[i] != PAGE_NEW)
+            continue;
+        if (i < context->pageMatched && !repeated[context->matched + i])
+        {
+            context->verdicts[i] = PAGE_UNCHANGED;
+            continue;
+        }
+        const CachedName* cached = FindCachedName(job, context->hashes[i]);
+        if (cached != NULL)
+            context->verdicts[i] = (cached->entryHash == context->entryHashes[i]) ? PAGE_UNCHANGED : PAGE_CHANGED;
+    }
+}
+
+/*
+ * QueueComputers - Append the computers of a page that are queued (PAGE_NEW, PAGE_CHANGED)
+ *
+ * Returns FALSE if the pending array could not grow.
+ */
+static BOOL QueueComputers(ScanJob* job, const ComputerInfo* batch, int count, const int* verdicts, int queued)
+{
+    BOOL ok = TRUE;
+
+    AcquireSRWLockExclusive(&job->pendingLock);
+    if (job->pendingCount + queued > job->pendingCapacity)
+    {
+        int newCapacity = (job->pendingCapacity > 0) ? job->pendingCapacity : 256;
+        while (newCapacity < job->pendingCount + queued)
+            newCapacity *= 2;
+        ComputerInfo* newPending = (ComputerInfo*)realloc(job->pending, sizeof(ComputerInfo) * newCapacity);
+        if (newPending != NULL)
+        {
+            job->pending = newPending;
+            job->pendingCapacity = newCapacity;
+        }
+        else
+            ok = FALSE;
+    }
+
+    for (int i = 0; i < count && ok; i++)
+    {
+        if (verdicts[i] == PAGE_NEW || verdicts[i] == PAGE_CHANGED)
+            job->pending[job->pendingCount++] = batch[i];
+    }
+    ReleaseSRWLockExclusive(&job->pendingLock);
+    return ok;
+}
+
+/*
+ * AddReportedPage - Keep a page for the source's cache (only its worker calls this)
+ *
+ * While the source reports its cached computers in the cached order,
+ * nothing is copied. The list is started from the cached records at the
+ * first computer that differs, and built as usual from there on.
+ */
+static void AddReportedPage(ScanJob* job, const ComputerInfo* batch, int count, SourceContext* context)
+{
+    const CachedScan* cached = &job->cached[context->source];
+    ScanCacheList* reported = &job->reported[context->source];
+    int i = 0;
+
+    // SortPageIntoShards has counted how far the page follows the cache
+    if (context->matched >= 0)
+    {
+        context->matched += context->pageMatched;
+        i = context->pageMatched;
+        if (i == count)
+            return;
+        StartScanCacheList(reported, cached, context->matched);
+        context->matched = -1;
+    }
+
+    for (; i < count; i++)
+        AddScanCacheComputer(reported, &batch[i], context->hashes[i], context->entryHashes[i]);
+}
+
+/*
+ * ScanJobBatch - ComputerBatchCallback that merges a page into the results
+ *
+ * Returns FALSE (stop the source) once the job has been cancelled, the
+ * source has run out of time or memory ran out.
+ */
+static BOOL ScanJobBatch(const ComputerInfo* batch, int count, void* context)
+{
+    SourceContext* sourceContext = (SourceContext*)context;
+    ScanJob* job = sourceContext->job;
+    ScanSourceResult* source = &job->sources[sourceContext->source];
+
+    // The dedupe needs no job lock (see the top of the file)
+    BOOL outOfMemory = !GrowPageBuffers(sourceContext, count);
+    int queued = 0, unchanged = 0, changed = 0;
+    if (!outOfMemory)
+    {
+        SortPageIntoShards(job, batch, count, sourceContext);
+        for (int i = 0; i < count; i++)
+        {
+            switch (sourceContext->verdicts[i])
+            {
+                case PAGE_NEW:
+                    queued++;
+                    break;
+                case PAGE_CHANGED:
+                    queued++;
+                    changed++;
+                    break;
+                case PAGE_UNCHANGED:
+                    unchanged++;
+                    break;
+                case PAGE_NO_MEMORY:
+                    outOfMemory = TRUE;
+                    break;
+            }
+        }
+    }
+
+    if (queued > 0 && !QueueComputers(job, batch, count, sourceContext->verdicts, queued))
+    {
+        outOfMemory = TRUE;
+        queued = 0;
+    }
+
+    // Only this worker touches the source's list; if it runs out of memory
+    // the scan goes on and the source is just not cached
+    if (job->params.useCache && !outOfMemory)
+        AddReportedPage(job, batch, count, sourceContext);
+
+    EnterCriticalSection(&job->lock);
+    job->progress.found += queued + unchanged;
+    job->progress.unchanged += unchanged;
+    job->progress.changed += changed;
+    source->found += queued + unchanged;
+    if (outOfMemory)
+        job->progress.outOfMemory = TRUE;
+
+    job->progress.pages++;
+    UpdateSourceSummary(job, source, sourceContext->summary);
+    UpdateScanRate(job);
+
+    BOOL keepGoing = !job->progress.outOfMemory && !job->cancelRequested;
+    if (keepGoing && sourceContext->deadline != 0 && GetTickCount64() >= sourceContext->deadline)
+    {
+        source->timedOut = TRUE;
+        keepGoing = FALSE;
+    }
+    LeaveCriticalSection(&job->lock);
+
+    // Also without new computers - the counts and rates have moved
+    NotifyScanProgress(job);
+    return keepGoing;
+}
+
+/*
+ * FinishScanJob - Add up the per-source outcomes (job lock held)
+ */
+static void FinishScanJob(ScanJob* job)
+{
+    ScanProgress* progress = &job->progress;
+
+    memset(&progress->summary, 0, sizeof(ScanSummary));
+    progress->summary.complete = TRUE;
+    progress->succeeded = FALSE;
+
+    for (int i = 0; i < job->sourceCount; i++)
+    {
+        const ScanSourceResult* source = &job->sources[i];
+        if (!source->finished)
+        {
+            // Never started (cancelled first)
+            progress->summary.complete = FALSE;
+            continue;
+        }
+
+        progress->summary.totalEntries += source->summary.totalEntries;
+        progress->summary.entriesReceived += source->summary.entriesReceived;
+        progress->summary.computersReported += source->summary.computersReported;
+        progress->summary.pages += source->summary.pages;
+        if (source->succeeded)
+            progress->succeeded = TRUE;
+        if (!source->summary.complete || source->timedOut)
+            progress->summary.complete = FALSE;
+
+        // Report the first error (a missing browser just means nothing there)
+        if (progress->summary.status == ERROR_SUCCESS &&
+            source->summary.status != ERROR_SUCCESS &&
+            source->summary.status != ERROR_NO_BROWSER_SERVERS_FOUND)
+        {
+            progress->summary.status = source->summary.status;
+        }
+    }
+
+    // Cached computers that a source which ran to the end did not report again
+    if (job->cache != NULL)
+    {
+        job->gone = (ULONGLONG*)malloc(sizeof(ULONGLONG) * job->progress.cached);
+        for (int i = 0; i < job->sourceCount && job->gone != NULL; i++)
+        {
+            const ScanSourceResult* source = &job->sources[i];
+            if (!source->finished || !source->succeeded || !source->summary.complete || source->timedOut)
+                continue;
+
+            // Each computer counts for the first source that cached it
+            const CachedScan* cached = &job->cached[i];
+            const BYTE* repeated = job->cachedRepeated + job->cachedFirst[i];
+            for (int j = 0; j < cached->count; j++)
+            {
+                if (!repeated[j] && !FindSeenName(job, cached->nameHashes[j]))
+                    job->gone[job->goneCount++] = cached->nameHashes[j];
+            }
+        }
+        progress->gone = job->goneCount;
+    }
+
+    progress->cancelled = (job->cancelRequested != 0);
+    progress->finished = TRUE;
+    UpdateScanRate(job);
+}
+
+/*
+ * SaveScanJobCache - Replace the cache of every source that ran to the end
+ *
+ * Called by the last worker, so the lists are no longer written. A source
+ * that reported exactly what was cached, in any order, is left as it is;
+ * the others go into the file together.
+ */
+static void SaveScanJobCache(ScanJob* job)
+{
+    const wchar_t* names[SCAN_MAX_SOURCES];
+    const ScanCacheList* lists[SCAN_MAX_SOURCES];
+    int indexes[SCAN_MAX_SOURCES];
+    BOOL saved[SCAN_MAX_SOURCES] = {0};
+    int count = 0;
+
+    for (int i = 0; i < job->sourceCount; i++)
+    {
+        const ScanCacheList* reported = &job->reported[i];
+        const CachedScan* cached = &job->cached[i];
+        if (job->cacheCurrent[i] ||
+            (reported->count == cached->count && reported->contentHash == cached->contentHash && cached->count > 0))
+        {
+            saved[i] = TRUE;
+            continue;
+        }
+        if (reported->records == NULL || reported->failed)
+            continue;
+
+        names[count] = job->sources[i].name;
+        lists[count] = reported;
+        indexes[count++] = i;
+    }
+
+    if (count > 0 && SaveScanCaches(job->params.mode, names, lists, count))
+    {
+        for (int i = 0; i < count; i++)
+            saved[indexes[i]] = TRUE;
+    }
+
+    EnterCriticalSection(&job->lock);
+    for (int i = 0; i < job->sourceCount; i++)
+    {
+        job->sources[i].cacheSaved = saved[i];
+        FreeScanCacheList(&job->reported[i]);
+    }
+    LeaveCriticalSection(&job->lock);
+}
+
+/*
+ * LoadScanJobCache - Load what every source found last time
+ *
+ * Runs on the first worker, before any other starts. The computers stay
+ * in the file's compact layout until TakeScanJobResults hands them out;
+ * one cached by several sources is handed out once, for the first of them.
+ */
+static void LoadScanJobCache(ScanJob* job)
+{
+    ScanCacheStatus status[SCAN_MAX_SOURCES];
+    const wchar_t* names[SCAN_MAX_SOURCES];
+    int total = 0;
+
+    for (int i = 0; i < job->sourceCount; i++)
+        names[i] = job->sources[i].name;
+    LoadScanCaches(job->params.mode, names, job->sourceCount, job->cached, status);
+
+    // The dialog may be reading the progress and sources meanwhile
+    EnterCriticalSection(&job->lock);
+    for (int i = 0; i < job->sourceCount; i++)
+    {
+        total += job->cached[i].count;
+        job->sources[i].cacheDamaged = (status[i] == SCAN_CACHE_DAMAGED);
+    }
+    LeaveCriticalSection(&job->lock);
+    if (total == 0)
+        return;
+
+    job->cacheCapacity = 1024;
+    while (job->cacheCapacity < total * 2)
+        job->cacheCapacity *= 2;
+    job->cache = (CachedName*)calloc(job->cacheCapacity, sizeof(CachedName));
+    job->cachedRepeated = (BYTE*)malloc(total);
+    if (job->cache == NULL || job->cachedRepeated == NULL)
+    {
+        // Scan from scratch
+        for (int i = 0; i < job->sourceCount; i++)
+            FreeCachedScan(&job->cached[i]);
+        free(job->cache);
+        free(job->cachedRepeated);
+        job->cache = NULL;
+        job->cachedRepeated = NULL;
+        job->cacheCapacity = 0;
+        return;
+    }
+
+    BYTE* repeated = job->cachedRepeated;
+    for (int i = 0; i < job->sourceCount; i++)
+    {
+        const CachedScan* cached = &job->cached[i];
+        job->cachedFirst[i] = (int)(repeated - job->cachedRepeated);
+        for (int j = 0; j < cached->count; j++, repeated++)
+        {
+            ULONGLONG nameHash = cached->nameHashes[j];
+            int slot = (int)(nameHash & (job->cacheCapacity - 1));
+            while (job->cache[slot].nameHash != 0 && job->cache[slot].nameHash != nameHash)
+                slot = (slot + 1) & (job->cacheCapacity - 1);
+            *repeated = (job->cache[slot].nameHash == nameHash);
+            if (*repeated)
+                continue;
+
+            job->cache[slot].nameHash = nameHash;
+            job->cache[slot].entryHash = cached->entryHashes[j];
+            job->cachedLeft++;
+        }
+    }
+
+    EnterCriticalSection(&job->lock);
+    BOOL haveTime = FALSE;
+    for (int i = 0; i < job->sourceCount; i++)
+    {
+        const CachedScan* cached = &job->cached[i];
+        if (cached->count > 0)
+        {
+            if (!haveTime || CompareFileTime(&cached->scanned, &job->progress.cachedAt) < 0)
+                job->progress.cachedAt = cached->scanned;
+            job->sources[i].cached = cached->count;
+            haveTime = TRUE;
+        }
+    }
+    job->progress.cached = job->cachedLeft;
+    LeaveCriticalSection(&job->lock);
+}
+
+/*
+ * ScanJobThread - Worker: scan sources until none are left
+ */
+static DWORD WINAPI ScanJobThread(LPVOID param)
+{
+    ScanJob* job = (ScanJob*)param;
+
+    // Only the first worker runs until the cache is loaded; it then lets
+    // the others go and the dialog show the cached rows
+    if (job->params.useCache && !job->cacheReady)
+    {
+        if (!job->cancelRequested)
+            LoadScanJobCache(job);
+        InterlockedExchange(&job->cacheReady, 1);
+        for (int i = 1; i < job->threadCount; i++)
+            ResumeThread(job->threads[i]);
+        if (job->cachedLeft > 0)
+            NotifyScanProgress(job);
+    }
+
+    for (;;)
+    {
+        int index = (int)InterlockedIncrement(&job->nextSource) - 1;
+        if (index >= job->sourceCount || job->cancelRequested)
+            break;
+
+        ScanSourceResult* source = &job->sources[index];
+        SourceContext context = {0};
+        ScanSummary summary = {0};
+        ULONGLONG startTicks = GetTickCount64();
+
+        context.job = job;
+        context.source = index;
+        context.summary = &summary;
+        if (job->params.sourceTimeoutMs > 0)
+            context.deadline = startTicks + job->params.sourceTimeoutMs;
+
+        EnterCriticalSection(&job->lock);
+        source->started = TRUE;
+        LeaveCriticalSection(&job->lock);
+
+        BOOL succeeded = job->source(source->name[0] != L'\0' ? source->name : NULL,
+                                     job->params.includeWorkstations, job->params.includeServers,
+                                     job->params.includeDomainControllers,
+                                     ScanJobBatch, &context, &summary);
+        free(context.hashes);
+        free(context.entryHashes);
+        free(context.verdicts);
+
+        // Only a full enumeration may replace the cache
+        if (!succeeded || !summary.complete || source->timedOut)
+            FreeScanCacheList(&job->reported[index]);
+        else if (context.matched == job->cached[index].count && context.matched > 0)
+            job->cacheCurrent[index] = TRUE;
+        else if (context.matched > 0)
+            StartScanCacheList(&job->reported[index], &job->cached[index], context.matched);
+
+        EnterCriticalSection(&job->lock);
+        UpdateSourceSummary(job, source, &summary);
+        source->succeeded = succeeded;
+        source->elapsedMs = (double)(GetTickCount64() - startTicks);
+        source->finished = TRUE;
+        job->progress.sourcesDone++;
+        if (!succeeded || source->timedOut ||
+            (!summary.complete && summary.status != ERROR_NO_BROWSER_SERVERS_FOUND))
+        {
+            job->progress.sourcesFailed++;
+        }
+        LeaveCriticalSection(&job->lock);
+
+        // Let the dialog update the source count
+        NotifyScanProgress(job);
+    }
+
+    if (InterlockedDecrement(&job->runningWorkers) == 0)
+    {
+        if (job->params.useCache)
+            SaveScanJobCache(job);
+
+        EnterCriticalSection(&job->lock);
+        FinishScanJob(job);
+        LeaveCriticalSection(&job->lock);
+
+        if (job->hwndNotify != NULL)
+            PostMessageW(job->hwndNotify, WM_SCAN_COMPLETE, 0, 0);
+    }
+    return 0;
+}
+
+/*
+ * SplitScanSources - Turn the domain list into sources
+ *
+ * Names are separated by ';', ',' or whitespace; repeats are dropped. An
+ * empty list scans the current domain/workgroup.
+ */
+static void SplitScanSources(ScanJob* job)
+{
+    const wchar_t* p = job->params.domains;
+
+    while (*p != L'\0' && job->sourceCount < SCAN_MAX_SOURCES)
+    {
+        while (*p == L';' || *p == L',' || iswspace(*p))
+            p++;
+
+        int length = 0;
+        while (p[length] != L'\0' && p[length] != L';' && p[length] != L',' && !iswspace(p[length]))
+            length++;
+        if (length == 0)
+            break;
+
+        wchar_t name[256];
+        wcsncpy_s(name, 256, p, (length < 255) ? length : 255);
+        p += length;
+
+        BOOL repeated = FALSE;
+        for (int i = 0; i < job->sourceCount && !repeated; i++)
+            repeated = (_wcsicmp(job->sources[i].name, name) == 0);
+        if (!repeated)
+            wcscpy_s(job->sources[job->sourceCount++].name, 256, name);
+    }
+
+    if (job->sourceCount == 0)
+        job->sourceCount = 1;   // sources[0].name is empty = current domain
+}
+
+/*
+ * StartScanJob - Start scanning on a pool of worker threads
+ *
+ * Parameters:
+ *   params     - What to scan for (copied)
+ *   source     - Enumeration to run for each domain (NULL = EnumerateComputers)
+ *   hwndNotify - Window that receives WM_SCAN_PROGRESS and WM_SCAN_COMPLETE (may be NULL)
+ *
+ * Returns the job (free with FreeScanJob), or NULL if no worker could start.
+ */
+ScanJob* StartScanJob(const ScanParams* params, ComputerSource source, HWND hwndNotify)
+{
+    ScanJob* job = (ScanJob*)calloc(1, sizeof(ScanJob));
+    if (job == NULL)
+        return NULL;
+
+    job->params = *params;
+    job->source = (source != NULL) ? source : EnumerateComputers;
+    job->hwndNotify = hwndNotify;
+    job->startTicks = GetTickCount64();
+    InitializeCriticalSection(&job->lock);
+    InitializeSRWLock(&job->pendingLock);
+    for (int i = 0; i < SEEN_SHARDS; i++)
+        InitializeSRWLock(&job->seen[i].lock);
+
+    SplitScanSources(job);
+    job->progress.sourceCount = job->sourceCount;
+
+    // No point in more workers than sources
+    int workers = params->workerCount;
+    if (workers < 1)
+        workers = 1;
+    if (workers > SCAN_MAX_WORKERS)
+        workers = SCAN_MAX_WORKERS;
+    if (workers > job->sourceCount)
+        workers = job->sourceCount;
+
+    // Create them suspended; fewer workers is fine, as long as there is one
+    for (int i = 0; i < workers; i++)
+    {
+        job->threads[job->threadCount] = CreateThread(NULL, 0, ScanJobThread, job, CREATE_SUSPENDED, NULL);
+        if (job->threads[job->threadCount] != NULL)
+            job->threadCount++;
+    }
+
+    if (job->threadCount == 0)
+    {
+        DeleteCriticalSection(&job->lock);
+        free(job);
+        return NULL;
+    }
+
+    // Count exactly the workers that exist before any of them runs, so the
+    // last one to end is the one that reports completion. With the cache,
+    // the first worker loads it and then starts the others.
+    job->runningWorkers = job->threadCount;
+    int started = params->useCache ? 1 : job->threadCount;
+    for (int i = 0; i < started; i++)
+        ResumeThread(job->threads[i]);
+    return job;
+}
+
+/*
+ * CancelScanJob - Stop every source at its next page boundary
+ */
+void CancelScanJob(ScanJob* job)
+{
+    if (job != NULL)
+        InterlockedExchange(&job->cancelRequested, 1);
+}
+
+/*
+ * TakeCachedComputers - Unpack the next SCAN_CACHE_SLICE cached computers into the taken array
+ */
+static int TakeCachedComputers(ScanJob* job, ComputerInfo** computers)
+{
+    int count = (job->cachedLeft < SCAN_CACHE_SLICE) ? job->cachedLeft : SCAN_CACHE_SLICE;
+
+    // The workers never touch the taken array, only the swap below does
+    if (count > job->takenCapacity)
+    {
+        ComputerInfo* taken = (ComputerInfo*)realloc(job->taken, sizeof(ComputerInfo) * SCAN_CACHE_SLICE);
+        if (taken == NULL)
+        {
+            EnterCriticalSection(&job->lock);
+            job->progress.outOfMemory = TRUE;
+            LeaveCriticalSection(&job->lock);
+            count = 0;
+            job->cachedLeft = 0;
+        }
+        else
+        {
+            job->taken = taken;
+            job->takenCapacity = SCAN_CACHE_SLICE;
+        }
+    }
+
+    int taken = 0;
+    while (taken < count)
+    {
+        const CachedScan* cached = &job->cached[job->cachedSource];
+        if (job->cachedIndex == cached->count)
+        {
+            job->cachedSource++;
+            job->cachedIndex = 0;
+            continue;
+        }
+        if (!job->cachedRepeated[job->cachedTaken++])
+            ReadCachedComputer(cached, job->cachedIndex, &job->taken[taken++]);
+        job->cachedIndex++;
+    }
+    job->cachedLeft -= taken;
+
+    *computers = (taken > 0) ? job->taken : NULL;
+    return taken;
+}
+
+/*
+ * TakeScanJobResults - Hand over the computers found since the last call
+ *
+ * Parameters:
+ *   job       - Scan job
+ *   computers - Receives the new computers (NULL if none)
+ *
+ * Returns the number of new computers.
+ *
+ * The job keeps two arrays and swaps them on every call: the one handed
+ * out is the caller's to read until the next call, then it is filled
+ * again. Reusing them spares the workers a fresh allocation, and the page
+ * faults that come with it, for every batch.
+ *
+ * Cached computers are handed out first, once the first worker has
+ * loaded them: SCAN_CACHE_SLICE at a time and unpacked into the same
+ * array, with a new WM_SCAN_PROGRESS after each slice until they are all
+ * out. So once the job has ended, call this until it returns 0.
+ */
+int TakeScanJobResults(ScanJob* job, ComputerInfo** computers)
+{
+    *computers = NULL;
+    if (job == NULL)
+        return 0;
+
+    // Clear first: a page arriving after this point posts a new nudge
+    InterlockedExchange(&job->notifyPending, 0);
+
+    // The cache comes first, so a changed computer found meanwhile replaces
+    // its row (no page is found before the cache is ready)
+    if (InterlockedCompareExchange(&job->cacheReady, 1, 1) == 1 && job->cachedLeft > 0)
+    {
+        int count = TakeCachedComputers(job, computers);
+        if (job->cachedLeft > 0)
+            NotifyScanProgress(job);
+        return count;
+    }
+
+    AcquireSRWLockExclusive(&job->pendingLock);
+    int count = job->pendingCount;
+    if (count > 0)
+    {
+        // Swap the arrays: the one handed out last time is done with
+        ComputerInfo* taken = job->pending;
+        int takenCapacity = job->pendingCapacity;
+        job->pending = job->taken;
+        job->pendingCapacity = job->takenCapacity;
+        job->taken = taken;
+        job->takenCapacity = takenCapacity;
+        *computers = taken;
+    }
+    job->pendingCount = 0;
+    ReleaseSRWLockExclusive(&job->pendingLock);
+
+    return count;
+}
+
+/*
+ * TakeScanJobGone - Hand over the cached computers that are gone
+ *
+ * Parameters:
+ *   job        - Finished scan job
+ *   nameHashes - Receives their HashHostKey values (NULL if none; free with free)
+ *
+ * Returns the number of computers.
+ */
+int TakeScanJobGone(ScanJob* job, ULONGLONG** nameHashes)
+{
+    *nameHashes = NULL;
+    if (job == NULL)
+        return 0;
+
+    EnterCriticalSection(&job->lock);
+    int count = job->goneCount;
+    if (count > 0)
+        *nameHashes = job->gone;
+    else
+        free(job->gone);
+    job->gone = NULL;
+    job->goneCount = 0;
+    LeaveCriticalSection(&job->lock);
+
+    return count;
+}
+
+/*
+ * GetScanJobProgress - Copy the current progress of a scan
+ */
+void GetScanJobProgress(ScanJob* job, ScanProgress* progress)
+{
+    EnterCriticalSection(&job->lock);
+    if (!job->progress.finished)
+        UpdateScanRate(job);
+    *progress = job->progress;
+    LeaveCriticalSection(&job->lock);
+}
+
+/*
+ * GetScanJobSources - Copy the per-source outcomes
+ *
+ * Returns the number of sources copied (at most maxSources).
+ */
+int GetScanJobSources(ScanJob* job, ScanSourceResult* sources, int maxSources)
+{
+    EnterCriticalSection(&job->lock);
+    int count = (job->sourceCount < maxSources) ? job->sourceCount : maxSources;
+    memcpy(sources, job->sources, sizeof(ScanSourceResult) * count);
+    LeaveCriticalSection(&job->lock);
+    return count;
+}
+
+/*
+ * WaitForScanJob - Wait for every worker to end
+ *
+ * Returns TRUE if they have ended within timeoutMs (INFINITE to wait for good).
+ */
+BOOL WaitForScanJob(ScanJob* job, DWORD timeoutMs)
+{
+    return WaitForMultipleObjects(job->threadCount, job->threads, TRUE, timeoutMs) < WAIT_OBJECT_0 + (DWORD)job->threadCount;
+}
+
+/*
+ * FreeScanJob - Cancel the scan, wait for the workers and free everything
+ *
+ * Waits for the pages being read to arrive, which can take a moment on a
+ * slow network. Progress messages that are still queued carry no data and
+ * can be ignored once the job is gone.
+ */
+void FreeScanJob(ScanJob* job)
+{
+    if (job == NULL)
+        return;
+
+    CancelScanJob(job);
+    WaitForMultipleObjects(job->threadCount, job->threads, TRUE, INFINITE);
+    for (int i = 0; i < job->threadCount; i++)
+        CloseHandle(job->threads[i]);
+
+    DeleteCriticalSection(&job->lock);
+    free(job->pending);
+    free(job->taken);
+    for (int i = 0; i < SEEN_SHARDS; i++)
+        free(job->seen[i].names);
+    free(job->cache);
+    free(job->cachedRepeated);
+    free(job->gone);
+    for (int i = 0; i < job->sourceCount; i++)
+    {
+        FreeCachedScan(&job->cached[i]);
+        FreeScanCacheList(&job->reported[i]);
+    }
+    free(job);
+}
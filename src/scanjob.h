@@ -0,0 +1,131 @@
+/*
+ * Scan Job Header
+ *
+ * Runs a network scan on worker threads so the dialog stays responsive.
+ * A scan can cover several domains/workgroups ("sources"); a small pool
+ * of workers takes them one at a time, so a few are scanned at once.
+ * Pages from every source go through one shared dedupe set and are queued
+ * as they arrive; the notify window gets WM_SCAN_PROGRESS and drains the
+ * queue with TakeScanJobResults, and WM_SCAN_COMPLETE once every source
+ * has ended.
+ *
+ * The enumeration itself is a ComputerSource - EnumerateComputers in the
+ * application, or a fake with the same signature to drive the job without
+ * a network. With a NULL notify window nothing is posted: wait for the
+ * job with WaitForScanJob and then take the results.
+ *
+ * With useCache set, the job first hands out what each source found last
+ * time (see scancache.h), so the dialog can show it before any page has
+ * arrived. The first worker reads the cache file, so StartScanJob does
+ * not wait for it; the cached rows come with a WM_SCAN_PROGRESS. Pages are then compared against it: computers that have not
+ * changed are counted but not queued again, and each source that ends
+ * complete replaces its cached list. The cached computers a complete
+ * source no longer reports are listed by TakeScanJobGone.
+ */
+
+#ifndef SCANJOB_H
+#define SCANJOB_H
+
+#include <windows.h>
+#include "adscan.h"
+
+// Most domains/workgroups one scan accepts, and most workers it starts
+#define SCAN_MAX_SOURCES        64
+#define SCAN_MAX_WORKERS        16
+
+// Most cached computers one TakeScanJobResults hands out
+#define SCAN_CACHE_SLICE        4096
+
+// Where the computers come from
+typedef enum {
+    SCAN_MODE_BROWSE,           // Browse list (EnumerateComputers)
+    SCAN_MODE_DIRECTORY,        // Active Directory over LDAP (EnumerateDirectoryComputers)
+    SCAN_MODE_SWEEP             // Open RDP ports in IPv4 ranges (EnumerateSubnetComputers)
+} ScanMode;
+
+// What to scan for (filled in by the Scan Domain dialog)
+typedef struct {
+    wchar_t domains[1024];      // Domains/workgroups or IP ranges separated by ';' or ',' (empty = current domain)
+    BOOL includeWorkstations;
+    BOOL includeServers;
+    BOOL includeDomainControllers;
+    int workerCount;            // Sources scanned at the same time (0 = 1)
+    DWORD sourceTimeoutMs;      // Time one source may take (0 = no limit)
+    ScanMode mode;
+    BOOL useCache;              // Start from each source's cached results and save the new ones
+} ScanParams;
+
+// An enumeration function with the signature of EnumerateComputers
+typedef BOOL (*ComputerSource)(const wchar_t* domain, BOOL includeWorkstations,
+                               BOOL includeServers, BOOL includeDomainControllers,
+                               ComputerBatchCallback callback, void* context,
+                               ScanSummary* summary);
+
+// Outcome of one domain/workgroup
+typedef struct {
+    wchar_t name[256];          // Domain/workgroup (empty = current)
+    BOOL started;
+    BOOL finished;
+    BOOL succeeded;             // Source's return value (valid once finished)
+    BOOL timedOut;              // Stopped because it took longer than sourceTimeoutMs
+    int found;                  // Computers this source added (not already found elsewhere)
+    int cached;                 // Computers in this source's cache when the scan started
+    BOOL cacheDamaged;          // Its cache entry was damaged and ignored
+    BOOL cacheSaved;            // The source ended complete and its cache holds this scan (replaced, or already the same)
+    double elapsedMs;
+    ScanSummary summary;        // Source's summary (as of its last page; final once finished)
+} ScanSourceResult;
+
+// Snapshot of a running or finished scan
+typedef struct {
+    int found;                  // Unique computers so far
+    int pages;                  // Pages received so far (all sources)
+    int sourceCount;            // Domains/workgroups in the scan
+    int sourcesDone;            // ... of which have ended
+    int sourcesFailed;          // ... of which failed, timed out or ended incomplete
+    double elapsedMs;           // Time since the scan started (until it ended)
+    double perSecond;           // found / elapsed time
+    DWORD examined;             // Entries the sources have looked at (addresses, for a sweep)
+    DWORD toExamine;            // Entries the sources expect in all (0 = not known yet)
+    double examinedPerSecond;   // examined / elapsed time
+    int cached;                 // Computers queued from the cache before scanning
+    int unchanged;              // ... found again exactly as cached (counted in found, not queued)
+    int changed;                // ... found again with other details (queued again)
+    int gone;                   // ... that a complete source no longer reports (valid once finished)
+    FILETIME cachedAt;          // When the oldest cached source was scanned (UTC)
+    BOOL finished;              // Every worker has ended
+    BOOL cancelled;             // CancelScanJob was called before it ended
+    BOOL succeeded;             // At least one source succeeded (valid once finished)
+    BOOL outOfMemory;           // Results were dropped for lack of memory
+    ScanSummary summary;        // All sources added up; status is the first error (valid once finished)
+} ScanProgress;
+
+typedef struct ScanJob ScanJob;
+
+// Start scanning (source NULL = EnumerateComputers); NULL if no thread could start
+ScanJob* StartScanJob(const ScanParams* params, ComputerSource source, HWND hwndNotify);
+
+// Ask the scan to stop after the pages being read
+void CancelScanJob(ScanJob* job);
+
+// Computers found since the last call, the cached ones first and at most
+// SCAN_CACHE_SLICE of those per call; returns the count (0 = none left).
+// The array is the job's and stays valid until the next call or FreeScanJob.
+int TakeScanJobResults(ScanJob* job, ComputerInfo** computers);
+
+// Name hashes of the cached computers that are gone (free with free); returns the count
+// Only filled in once the scan has finished
+int TakeScanJobGone(ScanJob* job, ULONGLONG** nameHashes);
+
+void GetScanJobProgress(ScanJob* job, ScanProgress* progress);
+
+// Per-source outcomes; returns the number of sources copied
+int GetScanJobSources(ScanJob* job, ScanSourceResult* sources, int maxSources);
+
+// TRUE once every worker has ended
+BOOL WaitForScanJob(ScanJob* job, DWORD timeoutMs);
+
+// Cancel, wait for the workers and free the job (and any results not taken)
+void FreeScanJob(ScanJob* job);
+
+#endif // SCANJOB_H
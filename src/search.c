@@ -0,0 +1,602 @@
+/*
+ * Host Search Module
+ *
+ * This module filters the host list against the text typed into a search
+ * box. The text is a query (see query.h): plain words match hostnames and
+ * descriptions case-insensitively, and field prefixes, wildcards, dates,
+ * OR, negation and grouping narrow things down further. Each pass compiles
+ * the query once and then runs the compiled program for every host.
+ *
+ * Evaluating a query over thousands of hosts inside the EN_CHANGE handler
+ * freezes typing, so the main dialog hands queries to a background worker:
+ *
+ *   1. Each keystroke calls CancelSearch(), bumping the generation counter.
+ *      Any pass still running with an older generation notices and stops.
+ *   2. After the debounce interval the dialog calls SubmitSearch().
+ *      Only the newest pending query is kept - older ones are overwritten.
+ *   3. The worker evaluates the query and posts a SearchResult to the
+ *      dialog as WM_SEARCH_COMPLETE. The dialog drops any result whose
+ *      generation is no longer current (IsCurrentSearch).
+ *
+ * Learning points:
+ *   - CreateThread and a worker loop driven by a condition variable
+ *   - Generation tokens for cheap, lock-free cancellation
+ *   - Handing heap-allocated results across threads with PostMessage
+ *   - QueryPerformanceCounter for high-resolution timing
+ *   - A sorted index plus binary search to skip most hosts for prefix queries
+ */
+
+#include <windows.h>
+#include <stdlib.h>
+#include <wctype.h>
+#include "config.h"
+#include "resource.h"
+#include "search.h"
+#include "query.h"
+
+// How many hosts to evaluate between cancellation checks
+#define SEARCH_CANCEL_CHECK_INTERVAL 256
+
+// Worker thread state
+static HANDLE g_hWorkerThread = NULL;
+static HWND g_hwndNotify = NULL;
+static CRITICAL_SECTION g_queueLock;        // Protects the pending query
+static CONDITION_VARIABLE g_queueReady;     // Signalled when a query is queued
+static CRITICAL_SECTION g_dataLock;         // Held while a pass reads the host array
+static BOOL g_stopRequested = FALSE;
+
+// Pending query (newest wins)
+static BOOL g_hasPending = FALSE;
+static wchar_t g_pendingText[256];
+static LONG g_pendingGeneration = 0;
+static LONGLONG g_pendingSubmitTicks = 0;
+
+// Current generation - bumped on every keystroke and host list change
+static volatile LONG g_generation = 0;
+
+// Host array being searched (owned by the dialog, read-only here)
+static const Host* g_searchHosts = NULL;
+static int g_searchHostCount = 0;
+
+// Hostnames sorted case-insensitively, for host:prefix* queries.
+// Built by the worker on first use and dropped whenever the array changes.
+typedef struct {
+    const wchar_t* hostname;
+    int index;
+} HostnameEntry;
+
+static HostnameEntry* g_hostnameIndex = NULL;
+
+// QueryPerformanceFrequency result, cached on first use
+static LONGLONG g_ticksPerSecond = 0;
+
+/*
+ * SetSpan - Record one column's match (or lack of one) for highlighting
+ */
+static void SetSpan(SearchSpan* span, int start, int length)
+{
+    span->start = (length > 0) ? start : -1;
+    span->length = (start >= 0) ? length : 0;
+    span->beforeCx = -1;
+    span->matchCx = -1;
+    span->totalCx = -1;
+}
+
+/*
+ * SetHighlightSpans - Record where a matching host shows the highlight text
+ *
+ * The query decides which plain text term (if any) is worth highlighting;
+ * this only locates it in the columns that term applies to.
+ */
+static void SetHighlightSpans(const Host* host, const wchar_t* highlightLower, int highlightLen,
+                              int highlightFields, SearchSpan* spans)
+{
+    int hostnamePos = -1;
+    int descriptionPos = -1;
+
+    if (highlightLen > 0)
+    {
+        if (highlightFields & QUERY_FIELD_HOSTNAME)
+            hostnamePos = FindTextNoCase(host->hostname, highlightLower);
+        if (highlightFields & QUERY_FIELD_DESCRIPTION)
+            descriptionPos = FindTextNoCase(host->description, highlightLower);
+    }
+
+    SetSpan(&spans[SEARCH_SPAN_HOSTNAME], hostnamePos, highlightLen);
+    SetSpan(&spans[SEARCH_SPAN_DESCRIPTION], descriptionPos, highlightLen);
+}
+
+/*
+ * HostMatchesSearch - Check one host against a lowercase search string
+ *
+ * Plain substring test on the hostname and the description, without the
+ * query syntax.
+ */
+BOOL HostMatchesSearch(const Host* host, const wchar_t* searchLower)
+{
+    return FindTextNoCase(host->hostname, searchLower) >= 0 ||
+           FindTextNoCase(host->description, searchLower) >= 0;
+}
+
+/*
+ * FilterHostsInternal - Shared filter loop
+ *
+ * Runs the compiled query against every host, or only against candidates
+ * (ascending host indices) when a narrower set is already known.
+ * If generation is non-zero the loop periodically compares it against the
+ * current generation and gives up (returning -1) once it is stale.
+ * If spans is non-NULL the highlight offsets of every match are recorded too.
+ */
+static int FilterHostsInternal(const Host* hosts, int hostCount, const Query* query,
+                               const int* candidates, int candidateCount,
+                               int* indices, SearchSpan* spans, LONG generation)
+{
+    const wchar_t* highlightLower = L"";
+    int highlightFields = 0;
+    GetQueryHighlight(query, &highlightLower, &highlightFields);
+    int highlightLen = (int)wcslen(highlightLower);
+
+    int visitCount = (candidates != NULL) ? candidateCount : hostCount;
+    int matched = 0;
+    for (int n = 0; n < visitCount; n++)
+    {
+        if (generation != 0 && (n % SEARCH_CANCEL_CHECK_INTERVAL) == 0 &&
+            generation != g_generation)
+        {
+            return -1;  // Superseded by a newer keystroke
+        }
+
+        int i = (candidates != NULL) ? candidates[n] : n;
+        if (EvaluateQuery(query, &hosts[i]))
+        {
+            indices[matched++] = i;
+            if (spans != NULL)
+            {
+                SetHighlightSpans(&hosts[i], highlightLower, highlightLen, highlightFields,
+                                  &spans[i * SEARCH_SPAN_COLUMNS]);
+            }
+        }
+    }
+    return matched;
+}
+
+/*
+ * FilterHosts - Filter a host array synchronously
+ *
+ * Parameters:
+ *   hosts      - Host array to search
+ *   hostCount  - Number of hosts
+ *   searchText - Query to filter by (NULL or empty matches everything)
+ *   indices    - Receives matching host indices (must hold hostCount ints)
+ *   spans      - Optional; receives match spans (hostCount * SEARCH_SPAN_COLUMNS)
+ *   error      - Receives a message if the query has a syntax error
+ *   errorLen   - Size of error in characters
+ *
+ * Returns the number of matching hosts, or -1 if the query is invalid.
+ */
+int FilterHosts(const Host* hosts, int hostCount, const wchar_t* searchText,
+                int* indices, SearchSpan* spans, wchar_t* error, int errorLen)
+{
+    Query* query = CompileQuery(searchText, NULL, error, errorLen);
+    if (query == NULL)
+        return -1;
+
+    int matched = 0;
+    if (hosts != NULL && hostCount > 0)
+        matched = FilterHostsInternal(hosts, hostCount, query, NULL, 0, indices, spans, 0);
+
+    FreeQuery(query);
+    return matched;
+}
+
+/*
+ * CompareHostnameEntries - qsort callback ordering the prefix index
+ *
+ * Compares character by character after towlower, the same folding the
+ * prefix lookup uses, so every hostname sharing a prefix is contiguous.
+ */
+static int CompareHostnameEntries(const void* a, const void* b)
+{
+    const wchar_t* x = ((const HostnameEntry*)a)->hostname;
+    const wchar_t* y = ((const HostnameEntry*)b)->hostname;
+
+    for (;; x++, y++)
+    {
+        wchar_t cx = (wchar_t)towlower(*x);
+        wchar_t cy = (wchar_t)towlower(*y);
+        if (cx != cy)
+            return (cx < cy) ? -1 : 1;
+        if (cx == L'\0')
+            return 0;
+    }
+}
+
+/*
+ * ComparePrefix - Compare the start of a hostname with a lowercase prefix
+ *
+ * Returns <0, 0 or >0 like strcmp, looking at no more than prefixLength characters.
+ */
+static int ComparePrefix(const wchar_t* hostname, const wchar_t* prefixLower, int prefixLength)
+{
+    for (int i = 0; i < prefixLength; i++)
+    {
+        wchar_t c = (wchar_t)towlower(hostname[i]);
+        if (c != prefixLower[i])
+            return (c < prefixLower[i]) ? -1 : 1;
+    }
+    return 0;
+}
+
+/*
+ * CompareInts - qsort callback for ascending host indices
+ */
+static int CompareInts(const void* a, const void* b)
+{
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * FindPrefixCandidates - Host indices whose hostname starts with a prefix
+ *
+ * Builds the sorted hostname index on first use (caller holds g_dataLock),
+ * binary searches the range of entries sharing the prefix and returns their
+ * host indices in ascending order, ready for FilterHostsInternal.
+ *
+ * Returns the number of candidates, or -1 if the index is unavailable.
+ */
+static int FindPrefixCandidates(const wchar_t* prefixLower, int prefixLength, int* candidates)
+{
+    if (g_hostnameIndex == NULL)
+    {
+        g_hostnameIndex = (HostnameEntry*)malloc((size_t)g_searchHostCount * sizeof(HostnameEntry));
+        if (g_hostnameIndex == NULL)
+            return -1;
+
+        for (int i = 0; i < g_searchHostCount; i++)
+        {
+            g_hostnameIndex[i].hostname = g_searchHosts[i].hostname;
+            g_hostnameIndex[i].index = i;
+        }
+        qsort(g_hostnameIndex, g_searchHostCount, sizeof(HostnameEntry), CompareHostnameEntries);
+    }
+
+    // First entry not below the prefix
+    int low = 0, high = g_searchHostCount;
+    while (low < high)
+    {
+        int mid = low + (high - low) / 2;
+        if (ComparePrefix(g_hostnameIndex[mid].hostname, prefixLower, prefixLength) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    int first = low;
+
+    // First entry past the prefix
+    high = g_searchHostCount;
+    while (low < high)
+    {
+        int mid = low + (high - low) / 2;
+        if (ComparePrefix(g_hostnameIndex[mid].hostname, prefixLower, prefixLength) <= 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    int count = low - first;
+    for (int i = 0; i < count; i++)
+        candidates[i] = g_hostnameIndex[first + i].index;
+
+    // Back to host order so results stay in the same order as a full scan
+    qsort(candidates, count, sizeof(int), CompareInts);
+    return count;
+}
+
+/*
+ * FreeHostnameIndex - Drop the prefix index (caller holds g_dataLock)
+ */
+static void FreeHostnameIndex(void)
+{
+    free(g_hostnameIndex);
+    g_hostnameIndex = NULL;
+}
+
+/*
+ * AllocSearchSpans - Allocate a span table for hostCount hosts
+ *
+ * Returns NULL on failure (or when hostCount is 0). Free with free().
+ */
+SearchSpan* AllocSearchSpans(int hostCount)
+{
+    if (hostCount <= 0)
+        return NULL;
+    return (SearchSpan*)malloc((size_t)hostCount * SEARCH_SPAN_COLUMNS * sizeof(SearchSpan));
+}
+
+/*
+ * SearchWorkerThread - Background thread that evaluates queued searches
+ */
+static DWORD WINAPI SearchWorkerThread(LPVOID param)
+{
+    UNREFERENCED_PARAMETER(param);
+
+    // Last compiled query - consecutive results for the same text (e.g. after
+    // the host list is reloaded) reuse it instead of parsing again. It is
+    // only ever evaluated on this thread.
+    Query* cachedQuery = NULL;
+    wchar_t cachedText[256] = {0};
+
+    for (;;)
+    {
+        wchar_t searchText[256];
+        LONG generation;
+        LONGLONG submitTicks;
+
+        // Wait for work
+        EnterCriticalSection(&g_queueLock);
+        while (!g_hasPending && !g_stopRequested)
+        {
+            SleepConditionVariableCS(&g_queueReady, &g_queueLock, INFINITE);
+        }
+        if (g_stopRequested)
+        {
+            LeaveCriticalSection(&g_queueLock);
+            break;
+        }
+        wcscpy_s(searchText, 256, g_pendingText);
+        generation = g_pendingGeneration;
+        submitTicks = g_pendingSubmitTicks;
+        g_hasPending = FALSE;
+        LeaveCriticalSection(&g_queueLock);
+
+        // Skip immediately if another keystroke arrived while we waited
+        if (generation != g_generation)
+            continue;
+
+        SearchResult* result = (SearchResult*)calloc(1, sizeof(SearchResult));
+        if (result == NULL)
+            continue;
+        result->generation = generation;
+        wcscpy_s(result->searchText, 256, searchText);
+        result->submitTicks = submitTicks;
+        result->startTicks = GetSearchTicks();
+
+        if (cachedQuery == NULL || wcscmp(cachedText, searchText) != 0)
+        {
+            // Regexes the new text still contains keep their warmed-up DFA
+            Query* query = CompileQuery(searchText, cachedQuery, result->error, ARRAYSIZE(result->error));
+            FreeQuery(cachedQuery);
+            cachedQuery = query;
+            wcscpy_s(cachedText, 256, cachedQuery != NULL ? searchText : L"");
+        }
+
+        // Hold the data lock so the dialog cannot free the array underneath us
+        EnterCriticalSection(&g_dataLock);
+        int hostCount = g_searchHostCount;
+        result->indices = (int*)malloc((hostCount > 0 ? hostCount : 1) * sizeof(int));
+        if (cachedQuery != NULL && result->indices != NULL && g_searchHosts != NULL && hostCount > 0)
+        {
+            result->spans = AllocSearchSpans(hostCount);
+            result->spanHostCount = (result->spans != NULL) ? hostCount : 0;
+
+            // host:prefix* narrows the pass to one slice of the sorted hostnames
+            const wchar_t* prefixLower;
+            int prefixLength;
+            int* candidates = NULL;
+            int candidateCount = -1;
+            if (GetQueryHostPrefix(cachedQuery, &prefixLower, &prefixLength))
+            {
+                candidates = (int*)malloc((size_t)hostCount * sizeof(int));
+                if (candidates != NULL)
+                    candidateCount = FindPrefixCandidates(prefixLower, prefixLength, candidates);
+            }
+
+            if (candidateCount >= 0)
+            {
+                // Hosts outside the slice are never visited; give them empty spans
+                for (int i = 0; result->spans != NULL && i < hostCount * SEARCH_SPAN_COLUMNS; i++)
+                    SetSpan(&result->spans[i], -1, 0);
+                result->count = FilterHostsInternal(g_searchHosts, hostCount, cachedQuery,
+                                                    candidates, candidateCount, result->indices,
+                                                    result->spans, generation);
+            }
+            else
+            {
+                result->count = FilterHostsInternal(g_searchHosts, hostCount, cachedQuery,
+                                                    NULL, 0, result->indices, result->spans,
+                                                    generation);
+            }
+            free(candidates);
+        }
+        LeaveCriticalSection(&g_dataLock);
+
+        result->endTicks = GetSearchTicks();
+
+        // Drop cancelled or failed passes; otherwise hand the result (or the
+        // syntax error) to the dialog
+        if (result->indices == NULL || result->count < 0 || generation != g_generation ||
+            !PostMessageW(g_hwndNotify, WM_SEARCH_COMPLETE, 0, (LPARAM)result))
+        {
+            FreeSearchResult(result);
+        }
+    }
+
+    FreeQuery(cachedQuery);
+    return 0;
+}
+
+/*
+ * StartSearchWorker - Create the background search thread
+ *
+ * Parameters:
+ *   hwndNotify - Window that receives WM_SEARCH_COMPLETE messages
+ *
+ * Returns TRUE if the worker is running.
+ */
+BOOL StartSearchWorker(HWND hwndNotify)
+{
+    if (g_hWorkerThread != NULL)
+        return TRUE;
+
+    InitializeCriticalSection(&g_queueLock);
+    InitializeCriticalSection(&g_dataLock);
+    InitializeConditionVariable(&g_queueReady);
+
+    g_hwndNotify = hwndNotify;
+    g_stopRequested = FALSE;
+    g_hasPending = FALSE;
+    g_searchHosts = NULL;
+    g_searchHostCount = 0;
+
+    g_hWorkerThread = CreateThread(NULL, 0, SearchWorkerThread, NULL, 0, NULL);
+    if (g_hWorkerThread == NULL)
+    {
+        DeleteCriticalSection(&g_queueLock);
+        DeleteCriticalSection(&g_dataLock);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * StopSearchWorker - Stop the worker and discard undelivered results
+ *
+ * Must be called from the thread that owns hwndNotify, so that results
+ * already sitting in the message queue can be freed.
+ */
+void StopSearchWorker(void)
+{
+    if (g_hWorkerThread == NULL)
+        return;
+
+    InterlockedIncrement(&g_generation);
+
+    EnterCriticalSection(&g_queueLock);
+    g_stopRequested = TRUE;
+    WakeConditionVariable(&g_queueReady);
+    LeaveCriticalSection(&g_queueLock);
+
+    WaitForSingleObject(g_hWorkerThread, INFINITE);
+    CloseHandle(g_hWorkerThread);
+    g_hWorkerThread = NULL;
+
+    // Free any results that were posted but never processed
+    MSG msg;
+    while (PeekMessageW(&msg, g_hwndNotify, WM_SEARCH_COMPLETE, WM_SEARCH_COMPLETE, PM_REMOVE))
+    {
+        FreeSearchResult((SearchResult*)msg.lParam);
+    }
+
+    FreeHostnameIndex();
+    DeleteCriticalSection(&g_queueLock);
+    DeleteCriticalSection(&g_dataLock);
+    g_hwndNotify = NULL;
+    g_searchHosts = NULL;
+    g_searchHostCount = 0;
+}
+
+/*
+ * SetSearchHosts - Point the worker at a (new) host array
+ *
+ * Cancels any pass in flight and waits for it to release the old array,
+ * so the caller may free the previous array as soon as this returns.
+ * Pass NULL/0 before freeing the array the worker is currently using.
+ */
+void SetSearchHosts(const Host* hosts, int hostCount)
+{
+    if (g_hWorkerThread == NULL)
+        return;
+
+    InterlockedIncrement(&g_generation);
+
+    EnterCriticalSection(&g_dataLock);
+    g_searchHosts = hosts;
+    g_searchHostCount = (hosts != NULL) ? hostCount : 0;
+    FreeHostnameIndex();
+    LeaveCriticalSection(&g_dataLock);
+}
+
+/*
+ * CancelSearch - Invalidate any queued or running search
+ *
+ * Returns the new generation number.
+ */
+LONG CancelSearch(void)
+{
+    return InterlockedIncrement(&g_generation);
+}
+
+/*
+ * SubmitSearch - Queue a query for the worker
+ *
+ * Parameters:
+ *   searchText  - Text to filter by
+ *   submitTicks - GetSearchTicks() at the keystroke that produced this query
+ *                 (used to report queue time including the debounce delay)
+ *
+ * Returns the generation assigned to this query.
+ */
+LONG SubmitSearch(const wchar_t* searchText, LONGLONG submitTicks)
+{
+    LONG generation = InterlockedIncrement(&g_generation);
+
+    if (g_hWorkerThread == NULL)
+        return generation;
+
+    EnterCriticalSection(&g_queueLock);
+    wcsncpy_s(g_pendingText, 256, (searchText != NULL) ? searchText : L"", _TRUNCATE);
+    g_pendingGeneration = generation;
+    g_pendingSubmitTicks = submitTicks;
+    g_hasPending = TRUE;
+    WakeConditionVariable(&g_queueReady);
+    LeaveCriticalSection(&g_queueLock);
+
+    return generation;
+}
+
+/*
+ * IsCurrentSearch - TRUE if a posted result is still the newest query
+ */
+BOOL IsCurrentSearch(const SearchResult* result)
+{
+    return (result != NULL && result->generation == g_generation);
+}
+
+/*
+ * FreeSearchResult - Release a result received via WM_SEARCH_COMPLETE
+ */
+void FreeSearchResult(SearchResult* result)
+{
+    if (result != NULL)
+    {
+        free(result->indices);
+        free(result->spans);
+        free(result);
+    }
+}
+
+/*
+ * GetSearchTicks - Current high-resolution timestamp
+ */
+LONGLONG GetSearchTicks(void)
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart;
+}
+
+/*
+ * SearchTicksToMs - Convert a tick delta to milliseconds
+ */
+double SearchTicksToMs(LONGLONG ticks)
+{
+    if (g_ticksPerSecond == 0)
+    {
+        LARGE_INTEGER freq;
+        QueryPerformanceFrequency(&freq);
+        g_ticksPerSecond = freq.QuadPart;
+    }
+    return (double)ticks * 1000.0 / (double)g_ticksPerSecond;
+}
@@ -0,0 +1,69 @@
+/*
+ * Host Search Header
+ *
+ * Filtering of the host list against the search box text, which is parsed
+ * as a query (see query.h).
+ *
+ * Query evaluation runs on a background worker thread so that a slow
+ * query never blocks typing. Every keystroke bumps a generation counter;
+ * the worker abandons any pass whose generation is no longer current and
+ * only the newest result is posted back to the dialog as WM_SEARCH_COMPLETE.
+ *
+ * Each pass also records where every host matched (SearchSpan), so the
+ * highlight drawing code can look the match up instead of searching again.
+ */
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <windows.h>
+#include "hosts.h"
+
+// Columns a span table holds per host
+#define SEARCH_SPAN_HOSTNAME    0
+#define SEARCH_SPAN_DESCRIPTION 1
+#define SEARCH_SPAN_COLUMNS     2
+
+// Where the query matched inside one column of one host
+typedef struct {
+    int start;                  // Offset of the match, -1 if this column did not match
+    int length;                 // Match length in characters
+    int beforeCx;               // Cached pixel widths for highlighting (-1 = not measured yet)
+    int matchCx;                //   text before the match, the match itself,
+    int totalCx;                //   and the whole string
+} SearchSpan;
+
+// Result of one search pass (posted to the dialog in LPARAM of WM_SEARCH_COMPLETE)
+typedef struct {
+    LONG generation;            // Generation the query was submitted with
+    wchar_t searchText[256];    // Query text this result was computed for
+    int* indices;               // Matching indices into the host array, in host order
+    int count;                  // Number of matching hosts
+    SearchSpan* spans;          // Match spans indexed by host index (may be NULL)
+    int spanHostCount;          // Hosts covered by spans
+    LONGLONG submitTicks;       // QueryPerformanceCounter when the keystroke arrived
+    LONGLONG startTicks;        // When the worker picked the query up
+    LONGLONG endTicks;          // When evaluation finished
+    wchar_t error[128];         // Query syntax error (empty if the query was valid)
+} SearchResult;
+
+// Filter engine - usable directly on the UI thread for small lists
+BOOL HostMatchesSearch(const Host* host, const wchar_t* searchLower);
+int FilterHosts(const Host* hosts, int hostCount, const wchar_t* searchText,
+                int* indices, SearchSpan* spans, wchar_t* error, int errorLen);
+SearchSpan* AllocSearchSpans(int hostCount);
+
+// Background search worker (one per process, owned by the main dialog)
+BOOL StartSearchWorker(HWND hwndNotify);
+void StopSearchWorker(void);
+void SetSearchHosts(const Host* hosts, int hostCount);
+LONG CancelSearch(void);
+LONG SubmitSearch(const wchar_t* searchText, LONGLONG submitTicks);
+BOOL IsCurrentSearch(const SearchResult* result);
+void FreeSearchResult(SearchResult* result);
+
+// Timing helpers for search instrumentation
+LONGLONG GetSearchTicks(void);
+double SearchTicksToMs(LONGLONG ticks);
+
+#endif // SEARCH_H
@@ -0,0 +1,424 @@
+/*
+ * Subnet Sweep Module
+ *
+ * Tries the RDP port on every address of an IPv4 range with the probe
+ * engine (RunProbeEngine in probeengine.c). An address whose connect
+ * completes is an RDP endpoint; refused, unreachable and silent
+ * addresses are not.
+ *
+ * Addresses are generated on the fly rather than listed up front, so a
+ * /12 costs no more memory than a /24. Open endpoints are collected into
+ * a batch that is handed to the scan's callback at every engine tick
+ * (every PROBE_TICK_MS) - also when it is empty, which lets the scan job
+ * update its progress and stop the sweep on cancel or timeout.
+ *
+ * Rate control is AIMD (additive increase, multiplicative decrease), the
+ * scheme TCP uses for its congestion window. The window is the number of
+ * connects in flight. Every tick it grows by SWEEP_WINDOW_STEP, unless
+ * the last tick showed congestion, in which case it is halved:
+ *
+ *   - Local errors: the machine ran out of sockets, buffers or ephemeral
+ *     ports (the address is retried, not counted as closed)
+ *   - Queueing: addresses that answered (open or refused) took on average
+ *     more than four times the fastest answer seen, i.e. the connects are
+ *     waiting behind each other somewhere
+ *
+ * Timeouts are not a congestion signal - most addresses of a sparse range
+ * never answer at all.
+ *
+ * Learning points:
+ *   - CIDR notation and IPv4 address arithmetic
+ *   - AIMD rate control
+ *   - Generating work lazily instead of materializing it
+ */
+
+#include <winsock2.h>
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "registry.h"
+#include "probe.h"
+#include "sweep.h"
+
+// Open endpoints collected between callbacks before an early flush
+#define SWEEP_BATCH_SIZE        256
+
+// Addresses waiting to be retried after a local error, and retries per sweep
+#define SWEEP_RETRY_SLOTS       PROBE_MAX_CONCURRENCY
+#define SWEEP_MAX_RETRIES       10000
+
+// Answers a tick needs before its average round trip is trusted
+#define SWEEP_MIN_ANSWERS       4
+
+typedef struct {
+    SweepRange range;
+    DWORD nextOffset;               // Next address of the range to hand out
+    DWORD retry[SWEEP_RETRY_SLOTS]; // Offsets to probe again
+    int retryCount;
+    int retriesLeft;
+
+    ComputerInfo* batch;            // Open endpoints not yet passed to the callback
+    int batchCount;
+    ComputerBatchCallback callback;
+    void* callbackContext;
+    ScanSummary* summary;
+    BOOL stopped;                   // The callback asked to stop
+
+    // Congestion signals since the last tick
+    int localErrors;
+    int answers;
+    double answerRttSum;
+    double minRttMs;                // Fastest answer of the whole sweep (0 = none yet)
+    int window;                     // Window after the last tick (for the debug log)
+    int maxWindow;                  // Largest window the engine was given
+} SweepContext;
+
+/*
+ * ParseIPv4 - Parse dotted decimal ("10.1.2.3") into host byte order
+ */
+static BOOL ParseIPv4(const wchar_t* text, DWORD* address)
+{
+    DWORD value = 0;
+    const wchar_t* p = text;
+
+    for (int part = 0; part < 4; part++)
+    {
+        wchar_t* end = NULL;
+        if (*p < L'0' || *p > L'9')
+            return FALSE;
+        unsigned long octet = wcstoul(p, &end, 10);
+        if (octet > 255 || end - p > 3)
+            return FALSE;
+
+        value = (value << 8) | octet;
+        p = end;
+        if (part < 3)
+        {
+            if (*p != L'.')
+                return FALSE;
+            p++;
+        }
+    }
+
+    *address = value;
+    return (*p == L'\0');
+}
+
+/*
+ * ParseSweepRange - Parse a CIDR range, a single address, and an optional port
+ *
+ * Parameters:
+ *   text        - "10.0.0.0/24", "10.0.0.5", "10.0.0.0/24:3390", ...
+ *   defaultPort - Port when the text has none
+ *   range       - Receives the range (first address is aligned to the prefix)
+ *
+ * Returns:
+ *   TRUE if valid, FALSE if malformed or larger than SWEEP_MAX_ADDRESSES
+ */
+BOOL ParseSweepRange(const wchar_t* text, USHORT defaultPort, SweepRange* range)
+{
+    wchar_t buffer[64];
+    unsigned long prefix = 32;
+    unsigned long port = defaultPort;
+
+    if (text == NULL || wcsncpy_s(buffer, ARRAYSIZE(buffer), text, _TRUNCATE) != 0)
+        return FALSE;
+
+    // Optional ":port" at the end
+    wchar_t* colon = wcschr(buffer, L':');
+    if (colon != NULL)
+    {
+        wchar_t* end = NULL;
+        *colon = L'\0';
+        port = wcstoul(colon + 1, &end, 10);
+        if (end == colon + 1 || *end != L'\0' || port == 0 || port > 65535)
+            return FALSE;
+    }
+
+    // Optional "/prefix"
+    wchar_t* slash = wcschr(buffer, L'/');
+    if (slash != NULL)
+    {
+        wchar_t* end = NULL;
+        *slash = L'\0';
+        prefix = wcstoul(slash + 1, &end, 10);
+        if (end == slash + 1 || *end != L'\0' || prefix > 32)
+            return FALSE;
+    }
+
+    DWORD address;
+    if (!ParseIPv4(buffer, &address))
+        return FALSE;
+
+    ULONGLONG count = 1ULL << (32 - prefix);
+    if (count > SWEEP_MAX_ADDRESSES)
+        return FALSE;
+
+    DWORD mask = (prefix == 0) ? 0 : (DWORD)(0xFFFFFFFFu << (32 - prefix));
+    range->first = address & mask;
+    range->count = (DWORD)count;
+    range->port = (USHORT)port;
+    return TRUE;
+}
+
+/*
+ * IsLocalSocketError - TRUE for errors that mean this machine is overloaded
+ */
+static BOOL IsLocalSocketError(DWORD error)
+{
+    return error == WSAENOBUFS || error == WSAEMFILE ||
+           error == WSAEADDRINUSE || error == WSAEADDRNOTAVAIL;
+}
+
+/*
+ * FlushSweepBatch - Hand the collected endpoints to the scan's callback
+ */
+static void FlushSweepBatch(SweepContext* sweep)
+{
+    sweep->summary->computersReported += sweep->batchCount;
+    sweep->summary->pages++;
+    if (!sweep->callback(sweep->batch, sweep->batchCount, sweep->callbackContext))
+        sweep->stopped = TRUE;
+    sweep->batchCount = 0;
+}
+
+/*
+ * NextSweepTarget - Engine callback: retries first, then the next address
+ */
+static BOOL NextSweepTarget(void* context, ProbeTarget* target)
+{
+    SweepContext* sweep = (SweepContext*)context;
+    DWORD offset;
+
+    if (sweep->stopped)
+        return FALSE;
+
+    if (sweep->retryCount > 0)
+        offset = sweep->retry[--sweep->retryCount];
+    else if (sweep->nextOffset < sweep->range.count)
+        offset = sweep->nextOffset++;
+    else
+        return FALSE;
+
+    SOCKADDR_IN address = {0};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(sweep->range.port);
+    address.sin_addr.s_addr = htonl(sweep->range.first + offset);
+
+    memset(target, 0, sizeof(ProbeTarget));
+    memcpy(target->address, &address, sizeof(address));
+    target->addressLength = sizeof(address);
+    target->port = sweep->range.port;
+    target->index = (int)offset;
+    return TRUE;
+}
+
+/*
+ * SweepProbeDone - Engine callback: count the address, keep it if open
+ */
+static void SweepProbeDone(void* context, const ProbeTarget* target, BOOL reachable, DWORD error, double rttMs,
+                           const RdpNegotiation* rdp)
+{
+    SweepContext* sweep = (SweepContext*)context;
+    UNREFERENCED_PARAMETER(rdp);    // Sweeps only connect
+
+    // Not probed at all - try the address again once the window has shrunk
+    if (IsLocalSocketError(error))
+    {
+        sweep->localErrors++;
+        if (sweep->retriesLeft > 0 && sweep->retryCount < SWEEP_RETRY_SLOTS)
+        {
+            sweep->retriesLeft--;
+            sweep->retry[sweep->retryCount++] = (DWORD)target->index;
+            return;
+        }
+    }
+
+    // Cancelled probes were not finished
+    if (error == WSA_OPERATION_ABORTED)
+        return;
+
+    sweep->summary->entriesReceived++;
+
+    if (reachable || error == WSAECONNREFUSED)
+    {
+        sweep->answers++;
+        sweep->answerRttSum += rttMs;
+        if (sweep->minRttMs == 0.0 || rttMs < sweep->minRttMs)
+            sweep->minRttMs = (rttMs > 0.0) ? rttMs : 0.001;
+    }
+
+    if (reachable)
+    {
+        DWORD address = sweep->range.first + (DWORD)target->index;
+        ComputerInfo* computer = &sweep->batch[sweep->batchCount++];
+
+        memset(computer, 0, sizeof(ComputerInfo));
+        if (sweep->range.port == RDP_DEFAULT_PORT)
+            swprintf_s(computer->name, 256, L"%lu.%lu.%lu.%lu",
+                       (address >> 24) & 0xFF, (address >> 16) & 0xFF, (address >> 8) & 0xFF, address & 0xFF);
+        else
+            swprintf_s(computer->name, 256, L"%lu.%lu.%lu.%lu:%u",
+                       (address >> 24) & 0xFF, (address >> 16) & 0xFF, (address >> 8) & 0xFF, address & 0xFF,
+                       sweep->range.port);
+        wcscpy_s(computer->comment, 256, L"Found by subnet sweep");
+
+        if (sweep->batchCount == SWEEP_BATCH_SIZE)
+            FlushSweepBatch(sweep);
+    }
+}
+
+/*
+ * IsSweepQueueing - TRUE when a tick's answers took on average more than
+ * four times the fastest answer (plus 5 ms for timer noise)
+ *
+ * Fewer than SWEEP_MIN_ANSWERS answers, or no fastest answer yet, say
+ * nothing.
+ */
+BOOL IsSweepQueueing(int answers, double answerRttSum, double minRttMs)
+{
+    return answers >= SWEEP_MIN_ANSWERS && minRttMs > 0.0 &&
+           answerRttSum / answers > 4.0 * minRttMs + 5.0;
+}
+
+/*
+ * NextSweepWindow - The window for the next tick (AIMD)
+ *
+ * Halved when congested (not below SWEEP_MIN_WINDOW), otherwise grown by
+ * SWEEP_WINDOW_STEP (not above maxWindow).
+ */
+int NextSweepWindow(int window, int maxWindow, BOOL congested)
+{
+    if (congested)
+        return (window / 2 > SWEEP_MIN_WINDOW) ? window / 2 : SWEEP_MIN_WINDOW;
+    if (window + SWEEP_WINDOW_STEP <= maxWindow)
+        return window + SWEEP_WINDOW_STEP;
+    return maxWindow;
+}
+
+/*
+ * SweepTick - Engine callback: report progress and adjust the window (AIMD)
+ */
+static BOOL SweepTick(void* context, int* window)
+{
+    SweepContext* sweep = (SweepContext*)context;
+
+    FlushSweepBatch(sweep);
+
+    BOOL congested = (sweep->localErrors > 0) ||
+                     IsSweepQueueing(sweep->answers, sweep->answerRttSum, sweep->minRttMs);
+    *window = NextSweepWindow(*window, sweep->maxWindow, congested);
+
+    sweep->window = *window;
+    sweep->localErrors = 0;
+    sweep->answers = 0;
+    sweep->answerRttSum = 0.0;
+    return !sweep->stopped;
+}
+
+/*
+ * EnumerateSubnetComputers - Sweep one IPv4 range for open RDP ports
+ *
+ * Parameters:
+ *   range     - Range text (see ParseSweepRange); NULL or empty is invalid
+ *   includeWorkstations, includeServers, includeDomainControllers - Ignored
+ *   callback  - Called about every PROBE_TICK_MS with the endpoints found
+ *   context   - Passed to callback
+ *   summary   - Progress and completeness (may be NULL)
+ *
+ * Returns:
+ *   TRUE if the sweep ran (also when stopped by the callback - check
+ *        summary->complete)
+ *   FALSE if the range is invalid (ERROR_INVALID_PARAMETER) or the probe
+ *         engine could not start
+ *
+ * Per-probe timeout and the largest window come from the registry
+ * (SweepTimeoutMs, SweepConcurrency).
+ */
+BOOL EnumerateSubnetComputers(const wchar_t* range, BOOL includeWorkstations,
+                              BOOL includeServers, BOOL includeDomainControllers,
+                              ComputerBatchCallback callback, void* context,
+                              ScanSummary* summary)
+{
+    ScanSummary localSummary;
+    SweepContext* sweep;
+
+    UNREFERENCED_PARAMETER(includeWorkstations);
+    UNREFERENCED_PARAMETER(includeServers);
+    UNREFERENCED_PARAMETER(includeDomainControllers);
+
+    if (summary == NULL)
+        summary = &localSummary;
+    memset(summary, 0, sizeof(ScanSummary));
+
+    // The retry list makes this too large for a worker's stack
+    sweep = (SweepContext*)calloc(1, sizeof(SweepContext));
+    if (sweep == NULL)
+    {
+        summary->status = ERROR_NOT_ENOUGH_MEMORY;
+        return FALSE;
+    }
+
+    if (!ParseSweepRange(range, RDP_DEFAULT_PORT, &sweep->range))
+    {
+        summary->status = ERROR_INVALID_PARAMETER;
+        free(sweep);
+        return FALSE;
+    }
+
+    sweep->batch = (ComputerInfo*)malloc(sizeof(ComputerInfo) * SWEEP_BATCH_SIZE);
+    if (sweep->batch == NULL)
+    {
+        summary->status = ERROR_NOT_ENOUGH_MEMORY;
+        free(sweep);
+        return FALSE;
+    }
+
+    sweep->callback = callback;
+    sweep->callbackContext = context;
+    sweep->summary = summary;
+    sweep->retriesLeft = SWEEP_MAX_RETRIES;
+    sweep->window = SWEEP_INITIAL_WINDOW;
+    summary->totalEntries = sweep->range.count;
+
+    ProbeEngine engine = {0};
+    engine.next = NextSweepTarget;
+    engine.done = SweepProbeDone;
+    engine.tick = SweepTick;
+    engine.context = sweep;
+    engine.maxWindow = (int)GetSettingDWORD(REG_SWEEP_CONCURRENCY, SWEEP_CONCURRENCY);
+    engine.window = SWEEP_INITIAL_WINDOW;
+    engine.timeoutMs = GetSettingDWORD(REG_SWEEP_TIMEOUT, SWEEP_TIMEOUT_MS);
+    if (engine.maxWindow < SWEEP_MIN_WINDOW)
+        engine.maxWindow = SWEEP_MIN_WINDOW;
+    if (engine.maxWindow > PROBE_MAX_CONCURRENCY)
+        engine.maxWindow = PROBE_MAX_CONCURRENCY;
+    if ((DWORD)engine.maxWindow > sweep->range.count)
+        engine.maxWindow = (int)sweep->range.count;
+    if (engine.window > engine.maxWindow)
+        engine.window = engine.maxWindow;
+    sweep->maxWindow = engine.maxWindow;
+
+    BOOL result = RunProbeEngine(&engine);
+    if (result)
+    {
+        // Endpoints found since the last tick
+        if (sweep->batchCount > 0 && !sweep->stopped)
+            FlushSweepBatch(sweep);
+
+        summary->status = ERROR_SUCCESS;
+        summary->complete = (summary->entriesReceived == sweep->range.count);
+    }
+    else
+    {
+        summary->status = WSAGetLastError();
+        if (summary->status == ERROR_SUCCESS)
+            summary->status = ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    free(sweep->batch);
+    free(sweep);
+    return result;
+}
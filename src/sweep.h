@@ -0,0 +1,58 @@
+/*
+ * Subnet Sweep Header
+ *
+ * Finds RDP endpoints by trying the RDP port on every address of an IPv4
+ * range. Unlike the browse list and the directory, this also finds
+ * workgroup machines, DMZ hosts and anything else nobody registered.
+ *
+ * EnumerateSubnetComputers has the signature of EnumerateComputers, so it
+ * plugs into ScanJob as a ComputerSource; each "domain" is a range.
+ */
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <windows.h>
+#include "adscan.h"
+
+// Largest range one source may sweep (a /12)
+#define SWEEP_MAX_ADDRESSES     (1u << 20)
+
+// Connect window: start small, grow additively, halve on congestion
+#define SWEEP_INITIAL_WINDOW    32
+#define SWEEP_MIN_WINDOW        8
+#define SWEEP_WINDOW_STEP       8
+
+// An IPv4 range to sweep
+typedef struct {
+    DWORD first;                // First address (host byte order)
+    DWORD count;                // Number of addresses
+    USHORT port;                // Port to try
+} SweepRange;
+
+// Parse "10.0.0.0/24", "10.0.0.5" or either with ":port"
+// Returns FALSE if the text is not a range or is larger than SWEEP_MAX_ADDRESSES
+BOOL ParseSweepRange(const wchar_t* text, USHORT defaultPort, SweepRange* range);
+
+// Whether a tick's answers show connects queueing (average well above the fastest)
+BOOL IsSweepQueueing(int answers, double answerRttSum, double minRttMs);
+
+// Window for the next tick: halved when congested, else SWEEP_WINDOW_STEP larger (up to maxWindow)
+int NextSweepWindow(int window, int maxWindow, BOOL congested);
+
+// Sweep one range, reporting open endpoints about every PROBE_TICK_MS
+// Parameters:
+//   range - Range text for ParseSweepRange (the "domain")
+//   includeWorkstations/includeServers/includeDomainControllers - Ignored
+//            (an open port says nothing about the computer type)
+//   callback - Receives the endpoints found since the last call (may be 0)
+//   context - Passed to callback
+//   summary - totalEntries = addresses in the range, entriesReceived =
+//             addresses probed so far, computersReported = open endpoints
+// Returns FALSE if the range is invalid or Winsock could not be set up
+BOOL EnumerateSubnetComputers(const wchar_t* range, BOOL includeWorkstations,
+                              BOOL includeServers, BOOL includeDomainControllers,
+                              ComputerBatchCallback callback, void* context,
+                              ScanSummary* summary);
+
+#endif // SWEEP_H
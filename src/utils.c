@@ -5,6 +5,7 @@
  */
 
 #include <windows.h>
+#include <wctype.h>
 #include "config.h"
 
 /*
@@ -48,3 +49,21 @@ void ShowInfoMessage(HWND hwnd, const wchar_t* message)
     MessageBoxW(hwnd, message, APP_NAME, MB_OK | MB_ICONINFORMATION);
 }
 
+/*
+ * HashHostKey - 64-bit FNV-1a of the lowercase hostname
+ * 
+ * Hostnames are compared case-insensitively everywhere, so "SRV1" and
+ * "srv1" get the same key. The result is never 0, so tables can use 0 to
+ * mark an empty slot.
+ */
+ULONGLONG HashHostKey(const wchar_t* hostname)
+{
+    ULONGLONG hash = 14695981039346656037ULL;
+    for (const wchar_t* p = hostname; *p != L'\0'; p++)
+    {
+        hash ^= (ULONGLONG)towlower(*p);
+        hash *= 1099511628211ULL;
+    }
+    return (hash != 0) ? hash : 1;
+}
+
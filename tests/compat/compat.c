@@ -0,0 +1,1229 @@
+/*
+ * Win32 Compatibility Layer (tests only)
+ *
+ * POSIX implementations of the calls declared in compat/windows.h and the
+ * other stand-in headers, good enough for the modules under test:
+ *
+ *   - Threads, events and waits use one process-wide mutex and condition
+ *     variable, so waiting on several handles at once stays simple
+ *   - Paths are converted to UTF-8 with '\' turned into '/'; the
+ *     executable's directory is $WINRDP_TEST_DIR (or the current one)
+ *   - LCMapStringW(LCMAP_SORTKEY) produces a key that orders by lowercase
+ *     code point, not by the Windows collation tables
+ *   - There is no window system: PostMessageW only counts, MessageBoxW
+ *     prints the text and answers IDOK
+ *   - Sockets are BSD sockets with Winsock error codes; there is no DNS
+ *     client, so DnsQuery_W fails and names go through getaddrinfo
+ */
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <windns.h>
+#include <shlobj.h>
+#include <shellapi.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Errors
+ */
+
+static _Thread_local DWORD t_lastError;
+
+DWORD GetLastError(void)
+{
+    return t_lastError;
+}
+
+void SetLastError(DWORD error)
+{
+    t_lastError = error;
+}
+
+/*
+ * SetErrorFromErrno - Map errno onto the nearest Win32 error code
+ */
+static void SetErrorFromErrno(void)
+{
+    switch (errno)
+    {
+    case ENOENT:    SetLastError(ERROR_FILE_NOT_FOUND); break;
+    case ENOTDIR:   SetLastError(ERROR_PATH_NOT_FOUND); break;
+    case EACCES:
+    case EPERM:     SetLastError(ERROR_ACCESS_DENIED); break;
+    case EEXIST:    SetLastError(ERROR_ALREADY_EXISTS); break;
+    case ENOMEM:    SetLastError(ERROR_NOT_ENOUGH_MEMORY); break;
+    default:        SetLastError(ERROR_INVALID_PARAMETER); break;
+    }
+}
+
+/*
+ * Locks and atomics
+ */
+
+void InitializeCriticalSection(CRITICAL_SECTION* cs)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(cs, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+void DeleteCriticalSection(CRITICAL_SECTION* cs)
+{
+    pthread_mutex_destroy(cs);
+}
+
+void EnterCriticalSection(CRITICAL_SECTION* cs)
+{
+    pthread_mutex_lock(cs);
+}
+
+void LeaveCriticalSection(CRITICAL_SECTION* cs)
+{
+    pthread_mutex_unlock(cs);
+}
+
+void InitializeSRWLock(SRWLOCK* lock)
+{
+    pthread_rwlock_init(lock, NULL);
+}
+
+void AcquireSRWLockExclusive(SRWLOCK* lock)
+{
+    pthread_rwlock_wrlock(lock);
+}
+
+void ReleaseSRWLockExclusive(SRWLOCK* lock)
+{
+    pthread_rwlock_unlock(lock);
+}
+
+void AcquireSRWLockShared(SRWLOCK* lock)
+{
+    pthread_rwlock_rdlock(lock);
+}
+
+void ReleaseSRWLockShared(SRWLOCK* lock)
+{
+    pthread_rwlock_unlock(lock);
+}
+
+LONG InterlockedIncrement(volatile LONG* target)
+{
+    return __atomic_add_fetch(target, 1, __ATOMIC_SEQ_CST);
+}
+
+LONG InterlockedDecrement(volatile LONG* target)
+{
+    return __atomic_sub_fetch(target, 1, __ATOMIC_SEQ_CST);
+}
+
+LONG InterlockedExchange(volatile LONG* target, LONG value)
+{
+    return __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST);
+}
+
+LONG InterlockedExchangeAdd(volatile LONG* target, LONG value)
+{
+    return __atomic_fetch_add(target, value, __ATOMIC_SEQ_CST);
+}
+
+LONG InterlockedCompareExchange(volatile LONG* target, LONG exchange, LONG comparand)
+{
+    __atomic_compare_exchange_n(target, &comparand, exchange, FALSE, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return comparand;
+}
+
+/*
+ * Threads and events
+ *
+ * A handle is signaled when its thread has finished or its event is set.
+ * It is freed once it has been closed and (for a thread) the thread has
+ * finished with it.
+ */
+
+typedef struct {
+    BOOL isThread;
+    BOOL signaled;
+    BOOL manualReset;               // Events: stays signaled after a wait
+    BOOL resumed;                   // Threads: CREATE_SUSPENDED gate is open
+    int references;
+    LPTHREAD_START_ROUTINE start;
+    LPVOID param;
+} CompatHandle;
+
+static pthread_mutex_t g_handleLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_handleSignal = PTHREAD_COND_INITIALIZER;
+
+static void ReleaseHandleLocked(CompatHandle* handle)
+{
+    if (--handle->references == 0)
+        free(handle);
+}
+
+static void* ThreadTrampoline(void* param)
+{
+    CompatHandle* handle = (CompatHandle*)param;
+
+    pthread_mutex_lock(&g_handleLock);
+    while (!handle->resumed)
+        pthread_cond_wait(&g_handleSignal, &g_handleLock);
+    pthread_mutex_unlock(&g_handleLock);
+
+    handle->start(handle->param);
+
+    pthread_mutex_lock(&g_handleLock);
+    handle->signaled = TRUE;
+    ReleaseHandleLocked(handle);
+    pthread_cond_broadcast(&g_handleSignal);
+    pthread_mutex_unlock(&g_handleLock);
+    return NULL;
+}
+
+HANDLE CreateThread(void* security, size_t stackSize, LPTHREAD_START_ROUTINE start,
+                    LPVOID param, DWORD flags, DWORD* threadId)
+{
+    (void)security;
+    (void)stackSize;
+
+    CompatHandle* handle = (CompatHandle*)calloc(1, sizeof(CompatHandle));
+    if (handle == NULL)
+    {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return NULL;
+    }
+    handle->isThread = TRUE;
+    handle->resumed = !(flags & CREATE_SUSPENDED);
+    handle->references = 2;
+    handle->start = start;
+    handle->param = param;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, ThreadTrampoline, handle) != 0)
+    {
+        free(handle);
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return NULL;
+    }
+    pthread_detach(thread);
+
+    if (threadId != NULL)
+        *threadId = 0;
+    return handle;
+}
+
+DWORD ResumeThread(HANDLE thread)
+{
+    CompatHandle* handle = (CompatHandle*)thread;
+
+    pthread_mutex_lock(&g_handleLock);
+    DWORD previous = handle->resumed ? 0 : 1;
+    handle->resumed = TRUE;
+    pthread_cond_broadcast(&g_handleSignal);
+    pthread_mutex_unlock(&g_handleLock);
+    return previous;
+}
+
+DWORD GetCurrentThreadId(void)
+{
+    return (DWORD)gettid();
+}
+
+HANDLE CreateEventW(void* security, BOOL manualReset, BOOL initialState, LPCWSTR name)
+{
+    (void)security;
+    (void)name;
+
+    CompatHandle* handle = (CompatHandle*)calloc(1, sizeof(CompatHandle));
+    if (handle == NULL)
+    {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return NULL;
+    }
+    handle->manualReset = manualReset;
+    handle->signaled = initialState;
+    handle->references = 1;
+    return handle;
+}
+
+BOOL SetEvent(HANDLE event)
+{
+    pthread_mutex_lock(&g_handleLock);
+    ((CompatHandle*)event)->signaled = TRUE;
+    pthread_cond_broadcast(&g_handleSignal);
+    pthread_mutex_unlock(&g_handleLock);
+    return TRUE;
+}
+
+BOOL ResetEvent(HANDLE event)
+{
+    pthread_mutex_lock(&g_handleLock);
+    ((CompatHandle*)event)->signaled = FALSE;
+    pthread_mutex_unlock(&g_handleLock);
+    return TRUE;
+}
+
+/*
+ * ConsumeSignal - An auto-reset event lets only one wait through
+ */
+static void ConsumeSignal(CompatHandle* handle)
+{
+    if (!handle->isThread && !handle->manualReset)
+        handle->signaled = FALSE;
+}
+
+DWORD WaitForMultipleObjects(DWORD count, const HANDLE* handles, BOOL waitAll, DWORD timeoutMs)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeoutMs / 1000;
+    deadline.tv_nsec += (long)(timeoutMs % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    DWORD result = WAIT_TIMEOUT;
+    pthread_mutex_lock(&g_handleLock);
+    for (;;)
+    {
+        DWORD signaled = 0;
+        DWORD first = count;
+        for (DWORD i = 0; i < count; i++)
+        {
+            if (((CompatHandle*)handles[i])->signaled)
+            {
+                signaled++;
+                if (first == count)
+                    first = i;
+            }
+        }
+
+        if (waitAll ? (signaled == count) : (signaled > 0))
+        {
+            if (waitAll)
+            {
+                for (DWORD i = 0; i < count; i++)
+                    ConsumeSignal((CompatHandle*)handles[i]);
+            }
+            else
+            {
+                ConsumeSignal((CompatHandle*)handles[first]);
+            }
+            result = WAIT_OBJECT_0 + (waitAll ? 0 : first);
+            break;
+        }
+
+        if (timeoutMs == 0)
+            break;
+        if (timeoutMs == INFINITE)
+            pthread_cond_wait(&g_handleSignal, &g_handleLock);
+        else if (pthread_cond_timedwait(&g_handleSignal, &g_handleLock, &deadline) == ETIMEDOUT)
+            timeoutMs = 0;  // One last look, then give up
+    }
+    pthread_mutex_unlock(&g_handleLock);
+    return result;
+}
+
+DWORD WaitForSingleObject(HANDLE handle, DWORD timeoutMs)
+{
+    return WaitForMultipleObjects(1, &handle, TRUE, timeoutMs);
+}
+
+BOOL CloseHandle(HANDLE handle)
+{
+    pthread_mutex_lock(&g_handleLock);
+    ReleaseHandleLocked((CompatHandle*)handle);
+    pthread_mutex_unlock(&g_handleLock);
+    return TRUE;
+}
+
+void Sleep(DWORD ms)
+{
+    struct timespec delay = { (time_t)(ms / 1000), (long)(ms % 1000) * 1000000L };
+    nanosleep(&delay, NULL);
+}
+
+/*
+ * Time
+ */
+
+static ULONGLONG MonotonicNanoseconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (ULONGLONG)now.tv_sec * 1000000000ULL + (ULONGLONG)now.tv_nsec;
+}
+
+DWORD GetTickCount(void)
+{
+    return (DWORD)GetTickCount64();
+}
+
+ULONGLONG GetTickCount64(void)
+{
+    return MonotonicNanoseconds() / 1000000ULL;
+}
+
+BOOL QueryPerformanceCounter(LARGE_INTEGER* counter)
+{
+    counter->QuadPart = (LONGLONG)MonotonicNanoseconds();
+    return TRUE;
+}
+
+BOOL QueryPerformanceFrequency(LARGE_INTEGER* frequency)
+{
+    frequency->QuadPart = 1000000000LL;
+    return TRUE;
+}
+
+/*
+ * UnixToFileTime - Seconds and nanoseconds since 1970 as 100 ns units since 1601
+ */
+static void UnixToFileTime(time_t seconds, long nanoseconds, FILETIME* fileTime)
+{
+    ULONGLONG ticks = ((ULONGLONG)seconds + 11644473600ULL) * 10000000ULL + (ULONGLONG)nanoseconds / 100;
+    fileTime->dwLowDateTime = (DWORD)ticks;
+    fileTime->dwHighDateTime = (DWORD)(ticks >> 32);
+}
+
+void GetSystemTimeAsFileTime(FILETIME* fileTime)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    UnixToFileTime(now.tv_sec, now.tv_nsec, fileTime);
+}
+
+static void FillSystemTime(const struct tm* tm, long nanoseconds, SYSTEMTIME* st)
+{
+    st->wYear = (WORD)(tm->tm_year + 1900);
+    st->wMonth = (WORD)(tm->tm_mon + 1);
+    st->wDayOfWeek = (WORD)tm->tm_wday;
+    st->wDay = (WORD)tm->tm_mday;
+    st->wHour = (WORD)tm->tm_hour;
+    st->wMinute = (WORD)tm->tm_min;
+    st->wSecond = (WORD)tm->tm_sec;
+    st->wMilliseconds = (WORD)(nanoseconds / 1000000L);
+}
+
+void GetLocalTime(SYSTEMTIME* st)
+{
+    struct timespec now;
+    struct tm tm;
+    clock_gettime(CLOCK_REALTIME, &now);
+    localtime_r(&now.tv_sec, &tm);
+    FillSystemTime(&tm, now.tv_nsec, st);
+}
+
+void GetSystemTime(SYSTEMTIME* st)
+{
+    struct timespec now;
+    struct tm tm;
+    clock_gettime(CLOCK_REALTIME, &now);
+    gmtime_r(&now.tv_sec, &tm);
+    FillSystemTime(&tm, now.tv_nsec, st);
+}
+
+LONG CompareFileTime(const FILETIME* a, const FILETIME* b)
+{
+    ULONGLONG ticksA = ((ULONGLONG)a->dwHighDateTime << 32) | a->dwLowDateTime;
+    ULONGLONG ticksB = ((ULONGLONG)b->dwHighDateTime << 32) | b->dwLowDateTime;
+    return (ticksA < ticksB) ? -1 : (ticksA > ticksB) ? 1 : 0;
+}
+
+BOOL FileTimeToSystemTime(const FILETIME* fileTime, SYSTEMTIME* st)
+{
+    ULONGLONG ticks = ((ULONGLONG)fileTime->dwHighDateTime << 32) | fileTime->dwLowDateTime;
+    time_t seconds = (time_t)(ticks / 10000000ULL) - (time_t)11644473600LL;
+    struct tm tm;
+    if (!gmtime_r(&seconds, &tm))
+        return FALSE;
+    FillSystemTime(&tm, (long)(ticks % 10000000ULL) * 100L, st);
+    return TRUE;
+}
+
+BOOL SystemTimeToFileTime(const SYSTEMTIME* st, FILETIME* fileTime)
+{
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    tm.tm_year = st->wYear - 1900;
+    tm.tm_mon = st->wMonth - 1;
+    tm.tm_mday = st->wDay;
+    tm.tm_hour = st->wHour;
+    tm.tm_min = st->wMinute;
+    tm.tm_sec = st->wSecond;
+    UnixToFileTime(timegm(&tm), (long)st->wMilliseconds * 1000000L, fileTime);
+    return TRUE;
+}
+
+void GetSystemInfo(SYSTEM_INFO* info)
+{
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    info->dwNumberOfProcessors = (DWORD)((processors > 0) ? processors : 1);
+}
+
+/*
+ * Strings
+ */
+
+/*
+ * EncodeUtf8 - Write one code point as UTF-8; returns the number of bytes
+ */
+static int EncodeUtf8(DWORD cp, char* out)
+{
+    if (cp < 0x80)
+    {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800)
+    {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000)
+    {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+/*
+ * DecodeUtf8 - Read one code point; returns the number of bytes used
+ *
+ * Malformed input reads as U+FFFD, one byte at a time.
+ */
+static int DecodeUtf8(const unsigned char* in, int available, DWORD* cp)
+{
+    int length = (in[0] < 0x80) ? 1 : (in[0] >= 0xF0) ? 4 : (in[0] >= 0xE0) ? 3 : (in[0] >= 0xC0) ? 2 : 0;
+    if (length == 0 || length > available)
+    {
+        *cp = 0xFFFD;
+        return 1;
+    }
+
+    DWORD value = (length == 1) ? in[0] : (DWORD)(in[0] & (0x7F >> length));
+    for (int i = 1; i < length; i++)
+    {
+        if ((in[i] & 0xC0) != 0x80)
+        {
+            *cp = 0xFFFD;
+            return 1;
+        }
+        value = (value << 6) | (in[i] & 0x3F);
+    }
+    *cp = value;
+    return length;
+}
+
+int MultiByteToWideChar(UINT codePage, DWORD flags, const char* src, int srcLen, wchar_t* dest, int destLen)
+{
+    (void)codePage;
+    (void)flags;
+
+    if (srcLen < 0)
+        srcLen = (int)strlen(src) + 1;
+
+    int written = 0;
+    for (int i = 0; i < srcLen; )
+    {
+        DWORD cp;
+        i += DecodeUtf8((const unsigned char*)src + i, srcLen - i, &cp);
+        if (destLen > 0)
+        {
+            if (written >= destLen)
+            {
+                SetLastError(ERROR_INVALID_PARAMETER);
+                return 0;
+            }
+            dest[written] = (wchar_t)cp;
+        }
+        written++;
+    }
+    return written;
+}
+
+int WideCharToMultiByte(UINT codePage, DWORD flags, const wchar_t* src, int srcLen,
+                        char* dest, int destLen, const char* defaultChar, BOOL* usedDefault)
+{
+    (void)codePage;
+    (void)flags;
+    (void)defaultChar;
+
+    if (usedDefault != NULL)
+        *usedDefault = FALSE;
+    if (srcLen < 0)
+        srcLen = (int)wcslen(src) + 1;
+
+    int written = 0;
+    for (int i = 0; i < srcLen; i++)
+    {
+        char bytes[4];
+        int length = EncodeUtf8((DWORD)src[i], bytes);
+        if (destLen > 0)
+        {
+            if (written + length > destLen)
+            {
+                SetLastError(ERROR_INVALID_PARAMETER);
+                return 0;
+            }
+            memcpy(dest + written, bytes, length);
+        }
+        written += length;
+    }
+    return written;
+}
+
+/*
+ * LCMapStringW - Only LCMAP_SORTKEY is supported
+ *
+ * Every character becomes three bytes of seven bits plus one (never zero,
+ * and in code point order), followed by a zero byte; so comparing keys as
+ * byte strings orders the text by (lowercased with NORM_IGNORECASE) code
+ * point, shorter prefixes first. The size is in bytes.
+ */
+int LCMapStringW(LCID locale, DWORD flags, LPCWSTR src, int srcLen, LPWSTR dest, int destLen)
+{
+    (void)locale;
+
+    if (!(flags & LCMAP_SORTKEY))
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return 0;
+    }
+    if (srcLen < 0)
+        srcLen = (int)wcslen(src);
+
+    int size = srcLen * 3 + 1;
+    if (destLen == 0)
+        return size;
+    if (destLen < size)
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return 0;
+    }
+
+    BYTE* key = (BYTE*)dest;
+    for (int i = 0; i < srcLen; i++)
+    {
+        DWORD cp = (DWORD)((flags & NORM_IGNORECASE) ? towlower((wint_t)src[i]) : (wint_t)src[i]);
+        *key++ = (BYTE)(1 + ((cp >> 14) & 0x7F));
+        *key++ = (BYTE)(1 + ((cp >> 7) & 0x7F));
+        *key++ = (BYTE)(1 + (cp & 0x7F));
+    }
+    *key = 0;
+    return size;
+}
+
+wchar_t* _wcsdup(const wchar_t* s)
+{
+    size_t size = (wcslen(s) + 1) * sizeof(wchar_t);
+    wchar_t* copy = (wchar_t*)malloc(size);
+    if (copy != NULL)
+        memcpy(copy, s, size);
+    return copy;
+}
+
+int _wcsicmp(const wchar_t* a, const wchar_t* b)
+{
+    for (;; a++, b++)
+    {
+        wint_t ca = towlower(*a);
+        wint_t cb = towlower(*b);
+        if (ca != cb || ca == L'\0')
+            return (ca < cb) ? -1 : (ca > cb) ? 1 : 0;
+    }
+}
+
+int _strnicmp(const char* a, const char* b, size_t count)
+{
+    return strncasecmp(a, b, count);
+}
+
+unsigned long long _wcstoui64(const wchar_t* s, wchar_t** end, int base)
+{
+    return wcstoull(s, end, base);
+}
+
+errno_t wcscpy_s(wchar_t* dest, size_t size, const wchar_t* src)
+{
+    size_t length = wcslen(src);
+    if (size == 0 || length >= size)
+    {
+        if (size > 0)
+            dest[0] = L'\0';
+        return ERANGE;
+    }
+    memcpy(dest, src, (length + 1) * sizeof(wchar_t));
+    return 0;
+}
+
+errno_t wcsncpy_s(wchar_t* dest, size_t size, const wchar_t* src, size_t count)
+{
+    if (size == 0)
+        return EINVAL;
+
+    size_t length = wcsnlen(src, (count == _TRUNCATE) ? (size_t)-1 : count);
+    errno_t result = 0;
+    if (length >= size)
+    {
+        if (count != _TRUNCATE)
+        {
+            dest[0] = L'\0';
+            return ERANGE;
+        }
+        length = size - 1;
+        result = 80;    // STRUNCATE
+    }
+    memcpy(dest, src, length * sizeof(wchar_t));
+    dest[length] = L'\0';
+    return result;
+}
+
+errno_t wcscat_s(wchar_t* dest, size_t size, const wchar_t* src)
+{
+    size_t used = wcsnlen(dest, size);
+    if (used == size)
+        return EINVAL;
+    return wcscpy_s(dest + used, size - used, src);
+}
+
+/*
+ * TranslateFormat - Rewrite a Microsoft CRT format for glibc
+ *
+ * "%lu" and friends lose the "l" (long is 32-bit on Windows, like DWORD),
+ * "I64" becomes "ll", and in wide formats "%s"/"%c" become "%ls"/"%lc"
+ * while "%S"/"%hs" (narrow in a wide format) become "%s".
+ */
+static void TranslateFormat(const wchar_t* format, wchar_t* out, size_t outLen, BOOL wide)
+{
+    size_t o = 0;
+    const wchar_t* p = format;
+
+    while (*p != L'\0' && o + 4 < outLen)
+    {
+        if (*p != L'%')
+        {
+            out[o++] = *p++;
+            continue;
+        }
+        out[o++] = *p++;
+        if (*p == L'%')
+        {
+            out[o++] = *p++;
+            continue;
+        }
+
+        while (*p != L'\0' && wcschr(L"-+ #0123456789.*", *p) != NULL && o + 4 < outLen)
+            out[o++] = *p++;
+
+        wchar_t length[4] = {0};
+        int lengthChars = 0;
+        if (p[0] == L'I' && p[1] == L'6' && p[2] == L'4')
+        {
+            wcscpy(length, L"ll");
+            lengthChars = 2;
+            p += 3;
+        }
+        else
+        {
+            while (*p != L'\0' && wcschr(L"hlLjzt", *p) != NULL && lengthChars < 3)
+                length[lengthChars++] = *p++;
+        }
+
+        wchar_t conversion = *p;
+        if (conversion == L'\0')
+            break;
+        p++;
+
+        if (wcschr(L"diouxX", conversion) != NULL && wcscmp(length, L"l") == 0)
+            length[0] = L'\0';
+        else if (conversion == L's' || conversion == L'c')
+        {
+            if (wide && length[0] == L'\0')
+                wcscpy(length, L"l");
+            else if (wide && wcscmp(length, L"h") == 0)
+                length[0] = L'\0';
+        }
+        else if (conversion == L'S' || conversion == L'C')
+        {
+            conversion = (conversion == L'S') ? L's' : L'c';
+            wcscpy(length, wide ? L"" : L"l");
+        }
+
+        for (int i = 0; length[i] != L'\0'; i++)
+            out[o++] = length[i];
+        out[o++] = conversion;
+    }
+    out[o] = L'\0';
+}
+
+int swprintf_s(wchar_t* dest, size_t size, const wchar_t* format, ...)
+{
+    wchar_t translated[512];
+    TranslateFormat(format, translated, ARRAYSIZE(translated), TRUE);
+
+    va_list args;
+    va_start(args, format);
+    int result = vswprintf(dest, size, translated, args);
+    va_end(args);
+
+    if (result < 0 && size > 0)
+        dest[0] = L'\0';
+    return result;
+}
+
+int sprintf_s(char* dest, size_t size, const char* format, ...)
+{
+    wchar_t wideFormat[512];
+    wchar_t translated[512];
+    char narrowFormat[1024];
+
+    MultiByteToWideChar(CP_UTF8, 0, format, -1, wideFormat, ARRAYSIZE(wideFormat));
+    TranslateFormat(wideFormat, translated, ARRAYSIZE(translated), FALSE);
+    WideCharToMultiByte(CP_UTF8, 0, translated, -1, narrowFormat, sizeof(narrowFormat), NULL, NULL);
+
+    va_list args;
+    va_start(args, format);
+    int result = vsnprintf(dest, size, narrowFormat, args);
+    va_end(args);
+
+    if (result < 0 || (size_t)result >= size)
+    {
+        if (size > 0)
+            dest[0] = '\0';
+        return -1;
+    }
+    return result;
+}
+
+/*
+ * Files
+ */
+
+/*
+ * NativePath - Convert a Windows-style path to a UTF-8 POSIX path
+ */
+static const char* NativePath(const wchar_t* path, char* out, size_t outLen)
+{
+    if (WideCharToMultiByte(CP_UTF8, 0, path, -1, out, (int)outLen, NULL, NULL) == 0)
+        return NULL;
+    for (char* c = out; *c != '\0'; c++)
+    {
+        if (*c == '\\')
+            *c = '/';
+    }
+    return out;
+}
+
+/*
+ * GetTestDirectory - $WINRDP_TEST_DIR, or the current directory
+ */
+static BOOL GetTestDirectory(wchar_t* path, size_t pathLen)
+{
+    char cwd[1024];
+    const char* dir = getenv("WINRDP_TEST_DIR");
+    if (dir == NULL || dir[0] == '\0')
+    {
+        dir = getcwd(cwd, sizeof(cwd));
+        if (dir == NULL)
+            return FALSE;
+    }
+    return MultiByteToWideChar(CP_UTF8, 0, dir, -1, path, (int)pathLen) != 0;
+}
+
+DWORD GetModuleFileNameW(HMODULE module, LPWSTR fileName, DWORD size)
+{
+    wchar_t dir[MAX_PATH];
+    (void)module;
+
+    if (!GetTestDirectory(dir, MAX_PATH))
+        return 0;
+    int length = swprintf_s(fileName, size, L"%s\\WinRDP.exe", dir);
+    return (length < 0) ? 0 : (DWORD)length;
+}
+
+HRESULT SHGetFolderPathW(HWND hwnd, int folder, HANDLE token, DWORD flags, LPWSTR path)
+{
+    wchar_t dir[MAX_PATH];
+    char native[MAX_PATH * 4];
+    (void)hwnd;
+    (void)token;
+    (void)flags;
+
+    if (folder != CSIDL_APPDATA || !GetTestDirectory(dir, MAX_PATH))
+        return E_FAIL;
+    swprintf_s(path, MAX_PATH, L"%s\\AppData", dir);
+    mkdir(NativePath(path, native, sizeof(native)), 0777);
+    return S_OK;
+}
+
+BOOL GetFileAttributesExW(LPCWSTR path, GET_FILEEX_INFO_LEVELS level, void* info)
+{
+    char native[MAX_PATH * 4];
+    struct stat st;
+    (void)level;
+
+    if (NativePath(path, native, sizeof(native)) == NULL || stat(native, &st) != 0)
+    {
+        SetErrorFromErrno();
+        return FALSE;
+    }
+
+    WIN32_FILE_ATTRIBUTE_DATA* data = (WIN32_FILE_ATTRIBUTE_DATA*)info;
+    memset(data, 0, sizeof(*data));
+    data->dwFileAttributes = S_ISDIR(st.st_mode) ? FILE_ATTRIBUTE_DIRECTORY : 0x80;
+    UnixToFileTime(st.st_mtim.tv_sec, st.st_mtim.tv_nsec, &data->ftLastWriteTime);
+    data->ftCreationTime = data->ftLastWriteTime;
+    data->ftLastAccessTime = data->ftLastWriteTime;
+    data->nFileSizeHigh = (DWORD)((ULONGLONG)st.st_size >> 32);
+    data->nFileSizeLow = (DWORD)st.st_size;
+    return TRUE;
+}
+
+BOOL CreateDirectoryW(LPCWSTR path, void* security)
+{
+    char native[MAX_PATH * 4];
+    (void)security;
+
+    if (NativePath(path, native, sizeof(native)) == NULL || mkdir(native, 0777) != 0)
+    {
+        SetErrorFromErrno();
+        return FALSE;
+    }
+    return TRUE;
+}
+
+BOOL DeleteFileW(LPCWSTR path)
+{
+    char native[MAX_PATH * 4];
+
+    if (NativePath(path, native, sizeof(native)) == NULL || unlink(native) != 0)
+    {
+        SetErrorFromErrno();
+        return FALSE;
+    }
+    return TRUE;
+}
+
+BOOL MoveFileExW(LPCWSTR existing, LPCWSTR replacement, DWORD flags)
+{
+    char from[MAX_PATH * 4];
+    char to[MAX_PATH * 4];
+    struct stat st;
+
+    if (NativePath(existing, from, sizeof(from)) == NULL || NativePath(replacement, to, sizeof(to)) == NULL)
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return FALSE;
+    }
+    if (!(flags & MOVEFILE_REPLACE_EXISTING) && stat(to, &st) == 0)
+    {
+        SetLastError(ERROR_ALREADY_EXISTS);
+        return FALSE;
+    }
+    if (rename(from, to) != 0)
+    {
+        SetErrorFromErrno();
+        return FALSE;
+    }
+    return TRUE;
+}
+
+errno_t _wfopen_s(FILE** file, const wchar_t* path, const wchar_t* mode)
+{
+    char native[MAX_PATH * 4];
+    char nativeMode[16];
+    size_t m = 0;
+
+    // Keep the mode letters; drop ", ccs=..." (files are bytes here)
+    for (const wchar_t* c = mode; *c != L'\0' && *c != L',' && m + 1 < sizeof(nativeMode); c++)
+    {
+        if (*c != L' ')
+            nativeMode[m++] = (char)*c;
+    }
+    nativeMode[m] = '\0';
+
+    *file = NULL;
+    if (NativePath(path, native, sizeof(native)) == NULL)
+        return EINVAL;
+    *file = fopen(native, nativeMode);
+    return (*file == NULL) ? errno : 0;
+}
+
+/*
+ * Messages and UI
+ */
+
+static volatile LONG g_postedMessages;
+
+BOOL PostMessageW(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    (void)hwnd;
+    (void)msg;
+    (void)wParam;
+    (void)lParam;
+    InterlockedIncrement(&g_postedMessages);
+    return TRUE;
+}
+
+LONG CompatPostedMessageCount(void)
+{
+    return InterlockedExchangeAdd(&g_postedMessages, 0);
+}
+
+int MessageBoxW(HWND hwnd, LPCWSTR text, LPCWSTR caption, UINT type)
+{
+    (void)hwnd;
+    (void)type;
+    fprintf(stderr, "[MessageBox] %ls: %ls\n", caption, text);
+    return IDOK;
+}
+
+HWND GetDesktopWindow(void)
+{
+    return NULL;
+}
+
+BOOL GetWindowRect(HWND hwnd, RECT* rect)
+{
+    (void)hwnd;
+    rect->left = 0;
+    rect->top = 0;
+    rect->right = 1920;
+    rect->bottom = 1080;
+    return TRUE;
+}
+
+BOOL SetWindowPos(HWND hwnd, HWND after, int x, int y, int cx, int cy, UINT flags)
+{
+    (void)hwnd;
+    (void)after;
+    (void)x;
+    (void)y;
+    (void)cx;
+    (void)cy;
+    (void)flags;
+    return TRUE;
+}
+
+void OutputDebugStringW(LPCWSTR text)
+{
+    (void)text;
+}
+
+HLOCAL LocalAlloc(UINT flags, size_t bytes)
+{
+    return (flags & LMEM_ZEROINIT) ? calloc(1, bytes) : malloc(bytes);
+}
+
+HLOCAL LocalFree(HLOCAL mem)
+{
+    free(mem);
+    return NULL;
+}
+
+HINSTANCE ShellExecuteW(HWND hwnd, LPCWSTR operation, LPCWSTR file, LPCWSTR parameters,
+                        LPCWSTR directory, INT showCommand)
+{
+    (void)hwnd;
+    (void)operation;
+    (void)file;
+    (void)parameters;
+    (void)directory;
+    (void)showCommand;
+    return (HINSTANCE)(INT_PTR)42;  // Above 32: started
+}
+
+/*
+ * Sockets
+ */
+
+int WSAStartup(WORD version, WSADATA* data)
+{
+    data->wVersion = version;
+    data->wHighVersion = MAKEWORD(2, 2);
+
+    // Winsock reports a closed peer as an error, never as a signal
+    signal(SIGPIPE, SIG_IGN);
+    return 0;
+}
+
+int WSACleanup(void)
+{
+    return 0;
+}
+
+int CompatSocketError(int error)
+{
+    switch (error)
+    {
+    case 0:             return 0;
+    case EINTR:         return WSAEINTR;
+    case EACCES:
+    case EPERM:         return WSAEACCES;
+    case EMFILE:
+    case ENFILE:        return WSAEMFILE;
+    case EAGAIN:        return WSAEWOULDBLOCK;
+    case EINPROGRESS:   return WSAEINPROGRESS;
+    case EBADF:
+    case ENOTSOCK:      return WSAENOTSOCK;
+    case EAFNOSUPPORT:  return WSAEAFNOSUPPORT;
+    case EADDRINUSE:    return WSAEADDRINUSE;
+    case EADDRNOTAVAIL: return WSAEADDRNOTAVAIL;
+    case ENETDOWN:      return WSAENETDOWN;
+    case ENETUNREACH:   return WSAENETUNREACH;
+    case ECONNABORTED:  return WSAECONNABORTED;
+    case EPIPE:
+    case ECONNRESET:    return WSAECONNRESET;
+    case ENOMEM:
+    case ENOBUFS:       return WSAENOBUFS;
+    case ENOTCONN:      return WSAENOTCONN;
+    case ETIMEDOUT:     return WSAETIMEDOUT;
+    case ECONNREFUSED:  return WSAECONNREFUSED;
+    case EHOSTDOWN:
+    case EHOSTUNREACH:  return WSAEHOSTUNREACH;
+    default:            return WSAEINVAL;
+    }
+}
+
+int WSAGetLastError(void)
+{
+    return CompatSocketError(errno);
+}
+
+/*
+ * closesocket - Close, first waking any thread blocked on the socket
+ *
+ * Winsock fails a pending accept() or recv() when the socket is closed;
+ * Linux only does that after shutdown(). Shutting down the receive side
+ * sends nothing, so a connection still ends as the caller's linger
+ * setting says.
+ */
+int closesocket(SOCKET s)
+{
+    shutdown(s, SHUT_RD);
+    return close(s);
+}
+
+/*
+ * AddressError - Map a getaddrinfo error onto the Winsock code
+ */
+static int AddressError(int error)
+{
+    switch (error)
+    {
+    case EAI_NONAME:    return WSAHOST_NOT_FOUND;
+    case EAI_NODATA:    return WSANO_DATA;
+    case EAI_AGAIN:     return WSATRY_AGAIN;
+    case EAI_FAMILY:    return WSAEAFNOSUPPORT;
+    case EAI_MEMORY:    return WSAENOBUFS;
+    default:            return WSANO_RECOVERY;
+    }
+}
+
+int GetAddrInfoW(LPCWSTR node, LPCWSTR service, const ADDRINFOW* hints, ADDRINFOW** result)
+{
+    char nodeUtf8[1024], serviceUtf8[32];
+    struct addrinfo nativeHints = {0};
+    struct addrinfo* native = NULL;
+
+    *result = NULL;
+    if ((node != NULL && WideCharToMultiByte(CP_UTF8, 0, node, -1, nodeUtf8, sizeof(nodeUtf8), NULL, NULL) == 0) ||
+        (service != NULL && WideCharToMultiByte(CP_UTF8, 0, service, -1, serviceUtf8, sizeof(serviceUtf8), NULL, NULL) == 0))
+        return WSAEINVAL;
+
+    if (hints != NULL)
+    {
+        nativeHints.ai_flags = hints->ai_flags;
+        nativeHints.ai_family = hints->ai_family;
+        nativeHints.ai_socktype = hints->ai_socktype;
+        nativeHints.ai_protocol = hints->ai_protocol;
+    }
+    int error = getaddrinfo((node != NULL) ? nodeUtf8 : NULL, (service != NULL) ? serviceUtf8 : NULL,
+                            (hints != NULL) ? &nativeHints : NULL, &native);
+    if (error != 0)
+        return AddressError(error);
+
+    // One allocation per entry: the entry, then its address
+    ADDRINFOW** tail = result;
+    for (const struct addrinfo* a = native; a != NULL; a = a->ai_next)
+    {
+        ADDRINFOW* entry = (ADDRINFOW*)calloc(1, sizeof(ADDRINFOW) + a->ai_addrlen);
+        if (entry == NULL)
+        {
+            freeaddrinfo(native);
+            FreeAddrInfoW(*result);
+            *result = NULL;
+            return WSAENOBUFS;
+        }
+        entry->ai_flags = a->ai_flags;
+        entry->ai_family = a->ai_family;
+        entry->ai_socktype = a->ai_socktype;
+        entry->ai_protocol = a->ai_protocol;
+        entry->ai_addrlen = a->ai_addrlen;
+        entry->ai_addr = (SOCKADDR*)(entry + 1);
+        memcpy(entry->ai_addr, a->ai_addr, a->ai_addrlen);
+        *tail = entry;
+        tail = &entry->ai_next;
+    }
+    freeaddrinfo(native);
+    return 0;
+}
+
+void FreeAddrInfoW(ADDRINFOW* addresses)
+{
+    while (addresses != NULL)
+    {
+        ADDRINFOW* next = addresses->ai_next;
+        free(addresses);
+        addresses = next;
+    }
+}
+
+int InetPtonW(int family, LPCWSTR text, void* address)
+{
+    char utf8[64];
+    if (WideCharToMultiByte(CP_UTF8, 0, text, -1, utf8, sizeof(utf8), NULL, NULL) == 0)
+        return 0;
+    return inet_pton(family, utf8, address);
+}
+
+DNS_STATUS DnsQuery_W(LPCWSTR name, WORD type, DWORD options, void* extra, PDNS_RECORD* results, void* reserved)
+{
+    (void)name;
+    (void)type;
+    (void)options;
+    (void)extra;
+    (void)reserved;
+    *results = NULL;
+    return DNS_ERROR_RCODE_SERVER_FAILURE;
+}
+
+void DnsRecordListFree(PDNS_RECORD records, DNS_FREE_TYPE freeType)
+{
+    (void)freeType;
+    while (records != NULL)
+    {
+        PDNS_RECORD next = records->pNext;
+        free(records);
+        records = next;
+    }
+}
@@ -0,0 +1,396 @@
+/*
+ * Probe Engine Stand-in (tests only)
+ *
+ * RunProbeEngine with the contract of src/probeengine.c (see ProbeEngine
+ * in probe.h) on non-blocking sockets and poll(), so the probe and the
+ * subnet sweep - the window, the deadlines, the negotiation, the tick -
+ * are tested on Linux too:
+ *
+ *   1. A slot is taken for each probe: a non-blocking socket and
+ *      connect(). A connect that fails at once (loopback refuses before
+ *      connect() returns) keeps its error in the slot and is reported in
+ *      the next pass, as ConnectEx queues even an immediate completion.
+ *   2. poll() waits for connects to finish (writable) and for reply bytes
+ *      (readable), no longer than the nearest deadline or tick.
+ *   3. Probes past their deadline, or all of them when stopping, are
+ *      closed and reported at once: unlike an overlapped ConnectEx,
+ *      nothing is left in flight that still has to complete.
+ *
+ * Out of ports or buffers is a start failure, as with ConnectEx, so the
+ * sweep sees the same local congestion signal.
+ */
+
+#include <winsock2.h>
+#include <windows.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "probe.h"
+#include "negotiation.h"
+
+// One connect in flight
+typedef struct {
+    SOCKET socket;
+    BOOL busy;                  // A connect is in flight (the slot is not free)
+    ProbeTarget target;
+    LARGE_INTEGER startTicks;   // QueryPerformanceCounter when the connect started
+    ULONGLONG deadline;         // GetTickCount64 after which the probe is abandoned
+    DWORD startError;           // connect() failed at once; reported in the next pass (0 = not)
+    BOOL connected;             // Connect done; waiting for the negotiation reply
+    double connectMs;           // Connect time (valid once connected)
+    LARGE_INTEGER sentTicks;    // When the negotiation request was sent
+    RdpNegotiation rdp;
+    BYTE reply[RDP_REPLY_MAX];
+    int replyLength;            // Reply bytes received so far
+} ProbeSlot;
+
+/*
+ * CloseProbeSocket - Close without lingering (sends a reset, no TIME_WAIT)
+ */
+static void CloseProbeSocket(SOCKET s)
+{
+    struct linger noLinger = { 1, 0 };
+    setsockopt(s, SOL_SOCKET, SO_LINGER, (const char*)&noLinger, sizeof(noLinger));
+    closesocket(s);
+}
+
+/*
+ * StartProbe - Open a non-blocking socket for a slot and start its connect
+ *
+ * Returns 0 if the connect is in flight (or already failed, see
+ * startError), otherwise the Winsock error (the slot is left free).
+ */
+static DWORD StartProbe(ProbeSlot* slot, const ProbeTarget* target, DWORD timeoutMs)
+{
+    int family = ((const SOCKADDR*)target->address)->sa_family;
+
+    SOCKET s = socket(family, SOCK_STREAM | SOCK_NONBLOCK, IPPROTO_TCP);
+    if (s == INVALID_SOCKET)
+        return WSAGetLastError();
+
+    memset(&slot->rdp, 0, sizeof(RdpNegotiation));
+    slot->socket = s;
+    slot->target = *target;
+    slot->startError = 0;
+    slot->connected = FALSE;
+    slot->replyLength = 0;
+    slot->deadline = GetTickCount64() + timeoutMs;
+    QueryPerformanceCounter(&slot->startTicks);
+
+    if (connect(s, (const SOCKADDR*)target->address, (socklen_t)target->addressLength) != 0 &&
+        errno != EINPROGRESS)
+    {
+        // Linux says EAGAIN when it has no ephemeral port left
+        if (errno == EAGAIN || errno == EADDRNOTAVAIL || errno == ENOBUFS || errno == ENOMEM)
+        {
+            DWORD error = (errno == EAGAIN) ? WSAEADDRNOTAVAIL : (DWORD)WSAGetLastError();
+            closesocket(s);
+            slot->socket = INVALID_SOCKET;
+            return error;
+        }
+        slot->startError = WSAGetLastError();
+    }
+    return 0;
+}
+
+/*
+ * StartNegotiation - Send the negotiation request on a connected slot
+ *
+ * Returns 0 if the reply is awaited, otherwise the Winsock error.
+ */
+static DWORD StartNegotiation(ProbeSlot* slot, DWORD timeoutMs)
+{
+    // 19 bytes into a new connection's empty send buffer do not block
+    int requestLength;
+    const BYTE* request = GetRdpNegotiationRequest(&requestLength);
+    if (send(slot->socket, (const char*)request, requestLength, MSG_NOSIGNAL) != requestLength)
+        return WSAGetLastError();
+
+    QueryPerformanceCounter(&slot->sentTicks);
+    slot->connected = TRUE;
+    slot->rdp.attempted = TRUE;
+    slot->deadline = GetTickCount64() + timeoutMs;
+    return 0;
+}
+
+/*
+ * CompleteProbe - Handle a slot whose connect finished or whose socket is readable
+ *
+ * Returns TRUE when the probe is finished (reachable, error and rttMs
+ * are set), FALSE while the negotiation continues.
+ */
+static BOOL CompleteProbe(const ProbeEngine* engine, ProbeSlot* slot, LARGE_INTEGER doneTicks,
+                          LARGE_INTEGER frequency, BOOL* reachable, DWORD* error, double* rttMs)
+{
+    // The connect finished
+    if (!slot->connected)
+    {
+        DWORD status = slot->startError;
+        if (status == 0)
+        {
+            int socketError = 0;
+            socklen_t length = sizeof(socketError);
+            if (getsockopt(slot->socket, SOL_SOCKET, SO_ERROR, &socketError, &length) != 0)
+                socketError = errno;
+
+            // A reset before poll() looked means the handshake completed (a
+            // refused SYN is ECONNREFUSED); ConnectEx reports that as success
+            status = (socketError == ECONNRESET) ? 0 : (DWORD)CompatSocketError(socketError);
+        }
+
+        *reachable = (status == 0);
+        *error = status;
+        *rttMs = (double)(doneTicks.QuadPart - slot->startTicks.QuadPart) * 1000.0 / frequency.QuadPart;
+
+        if (*reachable && engine->negotiate)
+        {
+            slot->connectMs = *rttMs;
+            DWORD sendError = StartNegotiation(slot, engine->timeoutMs);
+            if (sendError == 0)
+                return FALSE;
+            slot->rdp.attempted = TRUE;
+            slot->rdp.error = sendError;
+        }
+        return TRUE;
+    }
+
+    // Part of the negotiation reply arrived, or the connection ended
+    *reachable = TRUE;
+    *error = 0;
+    *rttMs = slot->connectMs;
+
+    int received = (int)recv(slot->socket, (char*)slot->reply + slot->replyLength,
+                             sizeof(slot->reply) - slot->replyLength, 0);
+    if (received > 0)
+    {
+        slot->replyLength += received;
+        if (ReadRdpNegotiationReply(slot->reply, slot->replyLength, &slot->rdp))
+        {
+            if (slot->rdp.answered)
+                slot->rdp.handshakeMs = (double)(doneTicks.QuadPart - slot->sentTicks.QuadPart) * 1000.0 / frequency.QuadPart;
+            return TRUE;
+        }
+
+        // Incomplete: wait for the rest (a full buffer without a confirm is not RDP)
+        if (slot->replyLength < RDP_REPLY_MAX)
+            return FALSE;
+        slot->rdp.error = ERROR_INVALID_DATA;
+        return TRUE;
+    }
+    if (received < 0 && (errno == EAGAIN || errno == EINTR))
+        return FALSE;
+
+    slot->rdp.error = (received == 0) ? WSAECONNRESET : (DWORD)WSAGetLastError();     // 0: closed without a word
+    return TRUE;
+}
+
+/*
+ * FinishProbe - Close a finished probe's socket, free its slot and report it
+ */
+static void FinishProbe(const ProbeEngine* engine, ProbeSlot* slot, BOOL reachable, DWORD error, double rttMs)
+{
+    CloseProbeSocket(slot->socket);
+    slot->socket = INVALID_SOCKET;
+    slot->busy = FALSE;
+    engine->done(engine->context, &slot->target, reachable, error, rttMs, &slot->rdp);
+}
+
+/*
+ * RunProbeEngine - Connect to targets until there are none left
+ *
+ * Same contract as the completion port engine: targets with an error set
+ * are passed straight to done(), and probes still in flight when the run
+ * is cancelled or tick() returns FALSE are reported with
+ * WSA_OPERATION_ABORTED - except those negotiating, which are reachable
+ * with rdp.error set instead.
+ */
+BOOL RunProbeEngine(const ProbeEngine* engine)
+{
+    WSADATA wsaData;
+    int maxWindow = engine->maxWindow;
+    int window = engine->window;
+
+    if (maxWindow > PROBE_MAX_CONCURRENCY)
+        maxWindow = PROBE_MAX_CONCURRENCY;
+    if (maxWindow < 1)
+        maxWindow = 1;
+    if (window < 1 || window > maxWindow)
+        window = maxWindow;
+
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+        return FALSE;
+
+    ProbeSlot* slots = (ProbeSlot*)calloc(maxWindow, sizeof(ProbeSlot));
+    struct pollfd* polls = (struct pollfd*)calloc(maxWindow, sizeof(struct pollfd));
+    int* polled = (int*)calloc(maxWindow, sizeof(int));     // Slot of each pollfd
+    if (slots == NULL || polls == NULL || polled == NULL)
+    {
+        free(slots);
+        free(polls);
+        free(polled);
+        WSACleanup();
+        return FALSE;
+    }
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+
+    ULONGLONG nextTick = GetTickCount64() + PROBE_TICK_MS;
+    int inFlight = 0;
+    BOOL moreTargets = TRUE;
+    BOOL stopping = FALSE;          // Cancelled, or tick() asked to stop
+
+    for (;;)
+    {
+        BOOL startFailed = FALSE;
+
+        if (engine->cancel != NULL && *engine->cancel != 0)
+            stopping = TRUE;
+
+        // 1. Start probes while the window has room
+        for (int i = 0; i < maxWindow && inFlight < window && moreTargets && !stopping; i++)
+        {
+            if (slots[i].busy)
+                continue;
+
+            ProbeTarget target;
+            if (!engine->next(engine->context, &target))
+            {
+                moreTargets = FALSE;
+                break;
+            }
+
+            DWORD error = target.error;
+            if (error == 0)
+                error = StartProbe(&slots[i], &target, engine->timeoutMs);
+
+            if (error == 0)
+            {
+                slots[i].busy = TRUE;
+                inFlight++;
+            }
+            else
+            {
+                RdpNegotiation none = {0};
+                engine->done(engine->context, &target, FALSE, error, 0.0, &none);
+                if (target.error == 0)
+                {
+                    // Probably out of sockets or ports - let probes finish first
+                    startFailed = TRUE;
+                    break;
+                }
+                i--;    // The slot is still free
+            }
+        }
+
+        if (inFlight == 0 && (stopping || !moreTargets))
+            break;
+
+        // 2. Wait for sockets, no longer than the nearest deadline or tick
+        ULONGLONG now = GetTickCount64();
+        ULONGLONG wakeAt = (engine->tick != NULL) ? nextTick : MAXULONGLONG;
+        if (engine->cancel != NULL && wakeAt > now + 100)
+            wakeAt = now + 100;     // A cancel flag is polled
+        if (startFailed && wakeAt > now + 50)
+            wakeAt = now + 50;      // Try starting again soon even if nothing completes
+
+        int pollCount = 0;
+        for (int i = 0; i < maxWindow; i++)
+        {
+            if (!slots[i].busy)
+                continue;
+            if (slots[i].startError != 0)
+            {
+                wakeAt = now;       // Already finished
+                continue;
+            }
+            polls[pollCount].fd = slots[i].socket;
+            polls[pollCount].events = slots[i].connected ? POLLIN : POLLOUT;
+            polls[pollCount].revents = 0;
+            polled[pollCount++] = i;
+            if (slots[i].deadline < wakeAt)
+                wakeAt = slots[i].deadline;
+        }
+        int wait = (wakeAt == MAXULONGLONG) ? -1 : (wakeAt > now ? (int)(wakeAt - now) : 0);
+
+        if (poll(polls, (nfds_t)pollCount, wait) >= 0)
+        {
+            LARGE_INTEGER doneTicks;
+            QueryPerformanceCounter(&doneTicks);
+
+            for (int p = 0; p < pollCount; p++)
+            {
+                ProbeSlot* slot = &slots[polled[p]];
+                BOOL reachable = FALSE;
+                DWORD error = 0;
+                double rttMs = 0.0;
+
+                if (polls[p].revents == 0 ||
+                    !CompleteProbe(engine, slot, doneTicks, frequency, &reachable, &error, &rttMs))
+                    continue;   // Not ready, or still negotiating
+
+                FinishProbe(engine, slot, reachable, error, rttMs);
+                inFlight--;
+            }
+            for (int i = 0; i < maxWindow; i++)
+            {
+                BOOL reachable = FALSE;
+                DWORD error = 0;
+                double rttMs = 0.0;
+
+                if (!slots[i].busy || slots[i].startError == 0)
+                    continue;
+                CompleteProbe(engine, &slots[i], doneTicks, frequency, &reachable, &error, &rttMs);
+                FinishProbe(engine, &slots[i], reachable, error, rttMs);
+                inFlight--;
+            }
+        }
+
+        // 3. Let the caller adjust the window (or stop) once per tick
+        now = GetTickCount64();
+        if (engine->tick != NULL && now >= nextTick && !stopping)
+        {
+            if (!engine->tick(engine->context, &window))
+                stopping = TRUE;
+            if (window < 1)
+                window = 1;
+            if (window > maxWindow)
+                window = maxWindow;
+            nextTick = now + PROBE_TICK_MS;
+        }
+
+        // 4. Report probes past their deadline (or all of them when stopping)
+        if (engine->cancel != NULL && *engine->cancel != 0)
+            stopping = TRUE;
+
+        LARGE_INTEGER abandonTicks;
+        QueryPerformanceCounter(&abandonTicks);
+        for (int i = 0; i < maxWindow; i++)
+        {
+            ProbeSlot* slot = &slots[i];
+            if (!slot->busy || (!stopping && now < slot->deadline))
+                continue;
+
+            DWORD abandonError = stopping ? WSA_OPERATION_ABORTED : WSAETIMEDOUT;
+            if (slot->connected)
+            {
+                slot->rdp.error = abandonError;
+                FinishProbe(engine, slot, TRUE, 0, slot->connectMs);
+            }
+            else
+            {
+                double rttMs = (double)(abandonTicks.QuadPart - slot->startTicks.QuadPart) * 1000.0 / frequency.QuadPart;
+                FinishProbe(engine, slot, FALSE, abandonError, rttMs);
+            }
+            inFlight--;
+        }
+    }
+
+    free(slots);
+    free(polls);
+    free(polled);
+    WSACleanup();
+    return TRUE;
+}
@@ -0,0 +1,17 @@
+/*
+ * Shell Execute Stand-in (tests only)
+ *
+ * ShellExecuteW starts nothing and reports success.
+ */
+
+#ifndef WINRDP_TESTS_COMPAT_SHELLAPI_H
+#define WINRDP_TESTS_COMPAT_SHELLAPI_H
+
+#include <windows.h>
+
+#define SW_SHOWNORMAL 1
+
+HINSTANCE ShellExecuteW(HWND hwnd, LPCWSTR operation, LPCWSTR file, LPCWSTR parameters,
+                        LPCWSTR directory, INT showCommand);
+
+#endif // WINRDP_TESTS_COMPAT_SHELLAPI_H
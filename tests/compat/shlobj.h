@@ -0,0 +1,16 @@
+/*
+ * Shell Folder Stand-in (tests only)
+ *
+ * CSIDL_APPDATA is "AppData" under the test directory (see compat.c).
+ */
+
+#ifndef WINRDP_TESTS_COMPAT_SHLOBJ_H
+#define WINRDP_TESTS_COMPAT_SHLOBJ_H
+
+#include <windows.h>
+
+#define CSIDL_APPDATA 0x001a
+
+HRESULT SHGetFolderPathW(HWND hwnd, int folder, HANDLE token, DWORD flags, LPWSTR path);
+
+#endif // WINRDP_TESTS_COMPAT_SHLOBJ_H
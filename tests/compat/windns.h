@@ -0,0 +1,66 @@
+/*
+ * DNS Client Stand-in (tests only)
+ *
+ * The DNS_RECORD layout the resolver walks, but no DNS client behind it:
+ * DnsQuery_W always fails with DNS_ERROR_RCODE_SERVER_FAILURE, so names
+ * are answered by the GetAddrInfoW fallback (getaddrinfo) instead.
+ */
+
+#ifndef WINRDP_TESTS_COMPAT_WINDNS_H
+#define WINRDP_TESTS_COMPAT_WINDNS_H
+
+#include <windows.h>
+
+typedef LONG DNS_STATUS;
+
+typedef enum {
+    DnsSectionQuestion,
+    DnsSectionAnswer,
+    DnsSectionAuthority,
+    DnsSectionAddtional
+} DNS_SECTION;
+
+typedef enum {
+    DnsFreeFlat,
+    DnsFreeRecordList,
+    DnsFreeParsedMessageFields
+} DNS_FREE_TYPE;
+
+typedef struct DnsRecordW {
+    struct DnsRecordW* pNext;
+    wchar_t* pName;
+    WORD wType;
+    WORD wDataLength;
+    union {
+        DWORD DW;
+        struct {
+            DWORD Section : 2;
+            DWORD Delete : 1;
+            DWORD CharSet : 2;
+            DWORD Unused : 3;
+            DWORD Reserved : 24;
+        } S;
+    } Flags;
+    DWORD dwTtl;
+    DWORD dwReserved;
+    union {
+        struct { DWORD IpAddress; } A;
+        struct { BYTE Ip6Address[16]; } AAAA;
+    } Data;
+} DNS_RECORD, *PDNS_RECORD;
+
+#define DNS_TYPE_A              0x0001
+#define DNS_TYPE_CNAME          0x0005
+#define DNS_TYPE_AAAA           0x001C
+
+#define DNS_QUERY_STANDARD      0x00000000
+
+#define DNS_ERROR_RCODE_SERVER_FAILURE  9002
+#define DNS_ERROR_RCODE_NAME_ERROR      9003
+#define DNS_INFO_NO_RECORDS             9501
+#define DNS_ERROR_BAD_PACKET            9502
+
+DNS_STATUS DnsQuery_W(LPCWSTR name, WORD type, DWORD options, void* extra, PDNS_RECORD* results, void* reserved);
+void DnsRecordListFree(PDNS_RECORD records, DNS_FREE_TYPE freeType);
+
+#endif // WINRDP_TESTS_COMPAT_WINDNS_H
@@ -0,0 +1,250 @@
+/*
+ * Win32 Compatibility Header (tests only)
+ *
+ * The parts of <windows.h> that the non-UI modules use, implemented on
+ * POSIX in compat.c, so that the tests in this directory build and run on
+ * Linux as well as on Windows. Only what the modules under test call is
+ * here; anything else should fail to compile rather than silently differ.
+ *
+ * Types keep their Windows sizes (LONG and DWORD are 32-bit), and the
+ * printf wrappers read format strings the way the Microsoft CRT
+ * does ("%s" is a wide string in a wide format, "%lu" is a DWORD).
+ * wchar_t stays 32-bit, which the modules do not depend on.
+ */
+
+#ifndef WINRDP_TESTS_COMPAT_WINDOWS_H
+#define WINRDP_TESTS_COMPAT_WINDOWS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <wctype.h>
+#include <pthread.h>
+
+// Basic types (Windows sizes)
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef unsigned char UCHAR;
+typedef unsigned short WORD;
+typedef unsigned short USHORT;
+typedef short SHORT;
+typedef int INT;
+typedef unsigned int UINT;
+typedef int32_t LONG;
+typedef uint32_t ULONG;
+typedef uint32_t DWORD;
+typedef int64_t LONGLONG;
+typedef uint64_t ULONGLONG;
+typedef intptr_t INT_PTR;
+typedef uintptr_t UINT_PTR;
+typedef uintptr_t ULONG_PTR;
+typedef uintptr_t DWORD_PTR;
+typedef intptr_t LPARAM;
+typedef uintptr_t WPARAM;
+typedef intptr_t LRESULT;
+typedef DWORD LCID;
+typedef int errno_t;
+typedef LONG HRESULT;
+typedef wchar_t WCHAR;
+typedef wchar_t* LPWSTR;
+typedef wchar_t* PWSTR;
+typedef wchar_t* PWCHAR;
+typedef const wchar_t* LPCWSTR;
+typedef void* PVOID;
+typedef void* LPVOID;
+typedef void* HANDLE;
+typedef void* HWND;
+typedef void* HINSTANCE;
+typedef void* HMODULE;
+typedef void* HLOCAL;
+
+typedef union {
+    struct { DWORD LowPart; LONG HighPart; };
+    LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+typedef struct { DWORD dwLowDateTime; DWORD dwHighDateTime; } FILETIME;
+
+typedef struct {
+    WORD wYear, wMonth, wDayOfWeek, wDay, wHour, wMinute, wSecond, wMilliseconds;
+} SYSTEMTIME;
+
+typedef struct { DWORD dwNumberOfProcessors; } SYSTEM_INFO;
+
+typedef struct { LONG left, top, right, bottom; } RECT;
+
+typedef struct {
+    DWORD dwFileAttributes;
+    FILETIME ftCreationTime, ftLastAccessTime, ftLastWriteTime;
+    DWORD nFileSizeHigh, nFileSizeLow;
+} WIN32_FILE_ATTRIBUTE_DATA;
+
+typedef enum { GetFileExInfoStandard } GET_FILEEX_INFO_LEVELS;
+
+// Locks map onto pthreads
+typedef pthread_mutex_t CRITICAL_SECTION;
+typedef pthread_rwlock_t SRWLOCK;
+#define SRWLOCK_INIT PTHREAD_RWLOCK_INITIALIZER
+
+typedef DWORD (*LPTHREAD_START_ROUTINE)(LPVOID);
+
+#define WINAPI
+#define CALLBACK
+#define TRUE    1
+#define FALSE   0
+#define MAX_PATH 260
+#define INFINITE 0xFFFFFFFF
+#define WAIT_OBJECT_0 0
+#define WAIT_TIMEOUT 258
+#define WAIT_FAILED 0xFFFFFFFF
+#define WM_USER 0x0400
+#define WM_APP  0x8000
+#define CREATE_SUSPENDED 0x00000004
+#define _TRUNCATE ((size_t)-1)
+#define ARRAYSIZE(a) (sizeof(a) / sizeof((a)[0]))
+#define UNREFERENCED_PARAMETER(p) (void)(p)
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+#define FILE_ATTRIBUTE_DIRECTORY 0x10
+#define MAXULONGLONG (~(ULONGLONG)0)
+#define MAXDWORD 0xFFFFFFFF
+#define MAKEWORD(low, high) ((WORD)(((BYTE)(low)) | ((WORD)((BYTE)(high)) << 8)))
+
+#define S_OK    ((HRESULT)0)
+#define E_FAIL  ((HRESULT)0x80004005)
+#define SUCCEEDED(hr) ((HRESULT)(hr) >= 0)
+#define FAILED(hr)    ((HRESULT)(hr) < 0)
+
+#define ERROR_SUCCESS           0
+#define ERROR_FILE_NOT_FOUND    2
+#define ERROR_PATH_NOT_FOUND    3
+#define ERROR_ACCESS_DENIED     5
+#define ERROR_NOT_ENOUGH_MEMORY 8
+#define ERROR_INVALID_DATA      13
+#define ERROR_BAD_NETPATH       53
+#define ERROR_INVALID_PARAMETER 87
+#define ERROR_INVALID_NAME      123
+#define ERROR_ALREADY_EXISTS    183
+#define ERROR_MORE_DATA         234
+#define ERROR_LOGON_FAILURE     1326
+#define ERROR_TIMEOUT           1460
+#define ERROR_NO_BROWSER_SERVERS_FOUND 6118
+
+#define MOVEFILE_REPLACE_EXISTING 0x1
+#define MOVEFILE_WRITE_THROUGH    0x8
+
+#define CP_ACP  0
+#define CP_UTF8 65001
+
+#define LOCALE_USER_DEFAULT 0x0400
+#define LCMAP_SORTKEY       0x00000400
+#define NORM_IGNORECASE     0x00000001
+#define SORT_STRINGSORT     0x00001000
+
+#define LMEM_FIXED          0x0000
+#define LMEM_ZEROINIT       0x0040
+
+#define MB_OK               0x00000000
+#define MB_OKCANCEL         0x00000001
+#define MB_YESNOCANCEL      0x00000003
+#define MB_YESNO            0x00000004
+#define MB_ICONERROR        0x00000010
+#define MB_ICONQUESTION     0x00000020
+#define MB_ICONWARNING      0x00000030
+#define MB_ICONINFORMATION  0x00000040
+#define IDOK     1
+#define IDCANCEL 2
+#define IDYES    6
+#define IDNO     7
+
+#define SWP_NOSIZE   0x0001
+#define SWP_NOZORDER 0x0004
+
+// Errors
+DWORD GetLastError(void);
+void SetLastError(DWORD error);
+
+// Locks and atomics
+void InitializeCriticalSection(CRITICAL_SECTION* cs);
+void DeleteCriticalSection(CRITICAL_SECTION* cs);
+void EnterCriticalSection(CRITICAL_SECTION* cs);
+void LeaveCriticalSection(CRITICAL_SECTION* cs);
+void InitializeSRWLock(SRWLOCK* lock);
+void AcquireSRWLockExclusive(SRWLOCK* lock);
+void ReleaseSRWLockExclusive(SRWLOCK* lock);
+void AcquireSRWLockShared(SRWLOCK* lock);
+void ReleaseSRWLockShared(SRWLOCK* lock);
+LONG InterlockedIncrement(volatile LONG* target);
+LONG InterlockedDecrement(volatile LONG* target);
+LONG InterlockedExchange(volatile LONG* target, LONG value);
+LONG InterlockedExchangeAdd(volatile LONG* target, LONG value);
+LONG InterlockedCompareExchange(volatile LONG* target, LONG exchange, LONG comparand);
+
+// Threads and events (handles are waitable until CloseHandle)
+HANDLE CreateThread(void* security, size_t stackSize, LPTHREAD_START_ROUTINE start,
+                    LPVOID param, DWORD flags, DWORD* threadId);
+DWORD ResumeThread(HANDLE thread);
+DWORD GetCurrentThreadId(void);
+HANDLE CreateEventW(void* security, BOOL manualReset, BOOL initialState, LPCWSTR name);
+BOOL SetEvent(HANDLE event);
+BOOL ResetEvent(HANDLE event);
+DWORD WaitForSingleObject(HANDLE handle, DWORD timeoutMs);
+DWORD WaitForMultipleObjects(DWORD count, const HANDLE* handles, BOOL waitAll, DWORD timeoutMs);
+BOOL CloseHandle(HANDLE handle);
+void Sleep(DWORD ms);
+
+// Time
+DWORD GetTickCount(void);
+ULONGLONG GetTickCount64(void);
+BOOL QueryPerformanceCounter(LARGE_INTEGER* counter);
+BOOL QueryPerformanceFrequency(LARGE_INTEGER* frequency);
+void GetSystemTimeAsFileTime(FILETIME* fileTime);
+void GetLocalTime(SYSTEMTIME* st);
+void GetSystemTime(SYSTEMTIME* st);
+LONG CompareFileTime(const FILETIME* a, const FILETIME* b);
+BOOL FileTimeToSystemTime(const FILETIME* fileTime, SYSTEMTIME* st);
+BOOL SystemTimeToFileTime(const SYSTEMTIME* st, FILETIME* fileTime);
+void GetSystemInfo(SYSTEM_INFO* info);
+
+// Files (paths may use either slash; "C:"-style roots are not supported)
+DWORD GetModuleFileNameW(HMODULE module, LPWSTR fileName, DWORD size);
+BOOL GetFileAttributesExW(LPCWSTR path, GET_FILEEX_INFO_LEVELS level, void* info);
+BOOL CreateDirectoryW(LPCWSTR path, void* security);
+BOOL DeleteFileW(LPCWSTR path);
+BOOL MoveFileExW(LPCWSTR existing, LPCWSTR replacement, DWORD flags);
+errno_t _wfopen_s(FILE** file, const wchar_t* path, const wchar_t* mode);
+
+// Windows messages and UI (no window system: posts are counted, boxes printed)
+BOOL PostMessageW(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+int MessageBoxW(HWND hwnd, LPCWSTR text, LPCWSTR caption, UINT type);
+HWND GetDesktopWindow(void);
+BOOL GetWindowRect(HWND hwnd, RECT* rect);
+BOOL SetWindowPos(HWND hwnd, HWND after, int x, int y, int cx, int cy, UINT flags);
+void OutputDebugStringW(LPCWSTR text);
+HLOCAL LocalAlloc(UINT flags, size_t bytes);
+HLOCAL LocalFree(HLOCAL mem);
+#define PostMessage PostMessageW
+#define MessageBox MessageBoxW
+#define OutputDebugString OutputDebugStringW
+
+// Number of PostMessageW calls so far (tests only)
+LONG CompatPostedMessageCount(void);
+
+// Strings
+int LCMapStringW(LCID locale, DWORD flags, LPCWSTR src, int srcLen, LPWSTR dest, int destLen);
+int MultiByteToWideChar(UINT codePage, DWORD flags, const char* src, int srcLen, wchar_t* dest, int destLen);
+int WideCharToMultiByte(UINT codePage, DWORD flags, const wchar_t* src, int srcLen,
+                        char* dest, int destLen, const char* defaultChar, BOOL* usedDefault);
+wchar_t* _wcsdup(const wchar_t* s);
+int _wcsicmp(const wchar_t* a, const wchar_t* b);
+int _strnicmp(const char* a, const char* b, size_t count);
+unsigned long long _wcstoui64(const wchar_t* s, wchar_t** end, int base);
+errno_t wcscpy_s(wchar_t* dest, size_t size, const wchar_t* src);
+errno_t wcsncpy_s(wchar_t* dest, size_t size, const wchar_t* src, size_t count);
+errno_t wcscat_s(wchar_t* dest, size_t size, const wchar_t* src);
+int swprintf_s(wchar_t* dest, size_t size, const wchar_t* format, ...);
+int sprintf_s(char* dest, size_t size, const char* format, ...);
+
+#endif // WINRDP_TESTS_COMPAT_WINDOWS_H
@@ -0,0 +1,104 @@
+/*
+ * Winsock Stand-in (tests only)
+ *
+ * The Winsock names the probe, sweep and resolver modules and their tests
+ * use, mapped onto BSD sockets. SOCKET is a file descriptor, and
+ * WSAGetLastError turns errno into the WSAE* code Winsock would report,
+ * so the modules' error handling and descriptions work unchanged.
+ *
+ * Two differences are papered over: closesocket() wakes a thread blocked
+ * in accept() or recv() on the socket, as on Windows, and no socket call
+ * raises SIGPIPE (WSAStartup ignores it).
+ */
+
+#ifndef WINRDP_TESTS_COMPAT_WINSOCK2_H
+#define WINRDP_TESTS_COMPAT_WINSOCK2_H
+
+#include <windows.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+typedef int SOCKET;
+typedef struct sockaddr SOCKADDR;
+typedef struct sockaddr_in SOCKADDR_IN;
+typedef struct sockaddr_in6 SOCKADDR_IN6;
+typedef struct sockaddr_storage SOCKADDR_STORAGE;
+typedef sa_family_t ADDRESS_FAMILY;
+
+typedef struct {
+    WORD wVersion;
+    WORD wHighVersion;
+} WSADATA;
+
+#define INVALID_SOCKET  (-1)
+#define SOCKET_ERROR    (-1)
+
+// Winsock error codes (the Windows values)
+#define WSA_OPERATION_ABORTED   995
+#define WSAEINTR                10004
+#define WSAEACCES               10013
+#define WSAEINVAL               10022
+#define WSAEMFILE               10024
+#define WSAEWOULDBLOCK          10035
+#define WSAEINPROGRESS          10036
+#define WSAENOTSOCK             10038
+#define WSAEAFNOSUPPORT         10047
+#define WSAEADDRINUSE           10048
+#define WSAEADDRNOTAVAIL        10049
+#define WSAENETDOWN             10050
+#define WSAENETUNREACH          10051
+#define WSAECONNABORTED         10053
+#define WSAECONNRESET           10054
+#define WSAENOBUFS              10055
+#define WSAENOTCONN             10057
+#define WSAETIMEDOUT            10060
+#define WSAECONNREFUSED         10061
+#define WSAEHOSTUNREACH         10065
+#define WSAHOST_NOT_FOUND       11001
+#define WSATRY_AGAIN            11002
+#define WSANO_RECOVERY          11003
+#define WSANO_DATA              11004
+
+int WSAStartup(WORD version, WSADATA* data);
+int WSACleanup(void);
+int WSAGetLastError(void);
+int closesocket(SOCKET s);
+
+// The WSAE* code for an errno value (e.g. from SO_ERROR) (tests only)
+int CompatSocketError(int error);
+
+// Winsock takes int lengths where BSD sockets take socklen_t
+static inline SOCKET CompatAccept(SOCKET s, SOCKADDR* address, int* addressLength)
+{
+    socklen_t length = (addressLength != NULL) ? (socklen_t)*addressLength : 0;
+    SOCKET client = accept(s, address, (addressLength != NULL) ? &length : NULL);
+    if (addressLength != NULL)
+        *addressLength = (int)length;
+    return client;
+}
+
+static inline int CompatGetSockName(SOCKET s, SOCKADDR* address, int* addressLength)
+{
+    socklen_t length = (socklen_t)*addressLength;
+    int result = getsockname(s, address, &length);
+    *addressLength = (int)length;
+    return result;
+}
+
+static inline int CompatRecvFrom(SOCKET s, char* buffer, int length, int flags, SOCKADDR* from, int* fromLength)
+{
+    socklen_t size = (fromLength != NULL) ? (socklen_t)*fromLength : 0;
+    int result = (int)recvfrom(s, buffer, (size_t)length, flags, from, (fromLength != NULL) ? &size : NULL);
+    if (fromLength != NULL)
+        *fromLength = (int)size;
+    return result;
+}
+
+#define accept CompatAccept
+#define getsockname CompatGetSockName
+#define recvfrom CompatRecvFrom
+
+#endif // WINRDP_TESTS_COMPAT_WINSOCK2_H
@@ -0,0 +1,30 @@
+/*
+ * Winsock TCP/IP Stand-in (tests only)
+ *
+ * GetAddrInfoW and InetPtonW over getaddrinfo and inet_pton, with names
+ * converted to UTF-8 and errors reported as Winsock codes
+ * (WSAHOST_NOT_FOUND, WSATRY_AGAIN, ...). ai_canonname is always NULL.
+ */
+
+#ifndef WINRDP_TESTS_COMPAT_WS2TCPIP_H
+#define WINRDP_TESTS_COMPAT_WS2TCPIP_H
+
+#include <winsock2.h>
+#include <netdb.h>
+
+typedef struct addrinfoW {
+    int ai_flags;
+    int ai_family;
+    int ai_socktype;
+    int ai_protocol;
+    size_t ai_addrlen;
+    wchar_t* ai_canonname;
+    SOCKADDR* ai_addr;
+    struct addrinfoW* ai_next;
+} ADDRINFOW;
+
+int GetAddrInfoW(LPCWSTR node, LPCWSTR service, const ADDRINFOW* hints, ADDRINFOW** result);
+void FreeAddrInfoW(ADDRINFOW* addresses);
+int InetPtonW(int family, LPCWSTR text, void* address);
+
+#endif // WINRDP_TESTS_COMPAT_WS2TCPIP_H
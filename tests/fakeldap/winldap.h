@@ -0,0 +1,65 @@
+/*
+ * LDAP Client Stand-in (tests only)
+ *
+ * Declares the part of <winldap.h> that ldapscan.c calls. ldapscan_test.c
+ * implements it over an in-memory directory, so ldapscan.c is tested
+ * against filters, attribute selection and paging without a server. It is
+ * used on Windows too, in place of wldap32.
+ */
+
+#ifndef WINRDP_TESTS_FAKELDAP_WINLDAP_H
+#define WINRDP_TESTS_FAKELDAP_WINLDAP_H
+
+#include <windows.h>
+
+typedef struct ldap LDAP;
+typedef struct ldapmsg LDAPMessage;
+typedef struct ldapsearch* PLDAPSearch;
+
+struct l_timeval {
+    LONG tv_sec;
+    LONG tv_usec;
+};
+
+#define LDAP_PORT                   389
+#define LDAP_VERSION3               3
+#define LDAP_OPT_PROTOCOL_VERSION   0x11
+#define LDAP_AUTH_NEGOTIATE         0x0486
+
+#define LDAP_SCOPE_BASE             0x00
+#define LDAP_SCOPE_SUBTREE          0x02
+
+#define LDAP_SUCCESS                0x00
+#define LDAP_NO_SUCH_ATTRIBUTE      0x10
+#define LDAP_INVALID_CREDENTIALS    0x31
+#define LDAP_SERVER_DOWN            0x51
+#define LDAP_TIMEOUT                0x55
+#define LDAP_FILTER_ERROR           0x57
+#define LDAP_NO_MEMORY              0x5a
+#define LDAP_NO_RESULTS_RETURNED    0x5e
+
+LDAP* ldap_initW(PWSTR hostName, ULONG portNumber);
+ULONG ldap_set_option(LDAP* ld, int option, const void* value);
+ULONG ldap_bind_sW(LDAP* ld, PWSTR dn, PWCHAR credential, ULONG method);
+ULONG ldap_unbind(LDAP* ld);
+
+ULONG ldap_search_sW(LDAP* ld, PWSTR base, ULONG scope, PWSTR filter, PWCHAR* attrs,
+                     ULONG attrsOnly, LDAPMessage** res);
+LDAPMessage* ldap_first_entry(LDAP* ld, LDAPMessage* res);
+LDAPMessage* ldap_next_entry(LDAP* ld, LDAPMessage* entry);
+PWCHAR* ldap_get_valuesW(LDAP* ld, LDAPMessage* entry, PWSTR attr);
+ULONG ldap_value_freeW(PWCHAR* vals);
+ULONG ldap_msgfree(LDAPMessage* res);
+
+PLDAPSearch ldap_search_init_pageW(LDAP* ld, PWSTR distinguishedName, ULONG scopeOfSearch,
+                                   PWSTR searchFilter, PWCHAR* attributeList, ULONG attributesOnly,
+                                   void* serverControls, void* clientControls,
+                                   ULONG pageTimeLimit, ULONG totalSizeLimit, void* sortKeys);
+ULONG ldap_get_next_page_s(LDAP* ld, PLDAPSearch searchHandle, struct l_timeval* timeout,
+                           ULONG pageSize, ULONG* totalCount, LDAPMessage** results);
+ULONG ldap_search_abandon_page(LDAP* ld, PLDAPSearch searchBlock);
+
+ULONG LdapGetLastError(void);
+ULONG LdapMapErrorToWin32(ULONG ldapError);
+
+#endif // WINRDP_TESTS_FAKELDAP_WINLDAP_H
@@ -0,0 +1,272 @@
+/*
+ * Host Grouping Tests
+ *
+ * Checks the group keys, the order of groups and members, and that every
+ * host lands in exactly one group. The benchmark groups 500k generated
+ * hosts both ways and compares against computing every key and sorting
+ * the list by it with qsort.
+ */
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "test.h"
+#include "grouping.h"
+
+static void CheckKey(const wchar_t* hostname, GroupMode mode, const wchar_t* expected)
+{
+    Host host = {0};
+    wchar_t key[MAX_HOSTNAME_LEN];
+
+    wcscpy_s(host.hostname, MAX_HOSTNAME_LEN, hostname);
+    GetHostGroupKey(&host, mode, key, MAX_HOSTNAME_LEN);
+    CHECK_WSTR(key, expected);
+}
+
+static void TestGroupKeys(void)
+{
+    CheckKey(L"web01.Corp.Example.com", GROUP_BY_DOMAIN, L"corp.example.com");
+    CheckKey(L"web01", GROUP_BY_DOMAIN, L"(no domain)");
+    CheckKey(L"web01.", GROUP_BY_DOMAIN, L"(no domain)");
+    CheckKey(L"10.0.0.1", GROUP_BY_DOMAIN, L"(IP addresses)");
+    CheckKey(L"10.0.0.1", GROUP_BY_NAME_PREFIX, L"(IP addresses)");
+
+    CheckKey(L"sql-prod-01", GROUP_BY_NAME_PREFIX, L"sql-prod");
+    CheckKey(L"web01-eu", GROUP_BY_NAME_PREFIX, L"web");
+    CheckKey(L"DC_01.corp.example", GROUP_BY_NAME_PREFIX, L"dc");
+    CheckKey(L"fileserver.corp", GROUP_BY_NAME_PREFIX, L"fileserver");
+    CheckKey(L"01host", GROUP_BY_NAME_PREFIX, L"(other)");
+    CheckKey(L"-7", GROUP_BY_NAME_PREFIX, L"(other)");
+
+    // A short key buffer truncates instead of overflowing
+    Host host = { L"averyveryverylongname.example", L"", L"Never" };
+    wchar_t key[8];
+    GetHostGroupKey(&host, GROUP_BY_NAME_PREFIX, key, ARRAYSIZE(key));
+    CHECK_WSTR(key, L"averyve");
+}
+
+static void TestBuildGroups(void)
+{
+    Host hosts[7] = {
+        { L"web01.corp.example", L"", L"Never" },
+        { L"sql01", L"", L"Never" },
+        { L"web02.CORP.example", L"", L"Never" },
+        { L"10.1.2.3", L"", L"Never" },
+        { L"app01.lab.example", L"", L"Never" },
+        { L"web03.corp.example", L"", L"Never" },
+        { L"db01.lab.example", L"", L"Never" },
+    };
+
+    // Display order 5, 0, 2, ... - members keep it, host 6 is filtered out
+    int indices[6] = { 5, 0, 2, 1, 4, 3 };
+    HostGroups* groups = BuildHostGroups(hosts, indices, 6, GROUP_BY_DOMAIN);
+    CHECK(groups != NULL);
+    if (groups == NULL)
+        return;
+
+    CHECK_INT(GetHostGroupCount(groups), 4);
+    CHECK_WSTR(GetHostGroupName(groups, 0), L"(IP addresses)");
+    CHECK_WSTR(GetHostGroupName(groups, 1), L"(no domain)");
+    CHECK_WSTR(GetHostGroupName(groups, 2), L"corp.example");
+    CHECK_WSTR(GetHostGroupName(groups, 3), L"lab.example");
+
+    const int* members;
+    CHECK_INT(GetHostGroupMembers(groups, 2, &members), 3);
+    CHECK(members[0] == 5 && members[1] == 0 && members[2] == 2);
+    CHECK_INT(GetHostGroupMembers(groups, 3, &members), 1);
+    CHECK_INT(members[0], 4);
+    FreeHostGroups(groups);
+
+    // No hosts: no groups
+    groups = BuildHostGroups(hosts, indices, 0, GROUP_BY_NAME_PREFIX);
+    CHECK(groups != NULL);
+    CHECK_INT(GetHostGroupCount(groups), 0);
+    FreeHostGroups(groups);
+}
+
+/*
+ * GenerateHosts - Names like "web-042.eu3.corp.example", a share of IP
+ * addresses and short names, in random order
+ */
+static Host* GenerateHosts(int count, ULONG seed)
+{
+    static const wchar_t* const roles[] = { L"web", L"sql-prod", L"dc", L"app_", L"file", L"jump", L"" };
+    Host* hosts = (Host*)calloc(count, sizeof(Host));
+    if (hosts == NULL)
+        return NULL;
+
+    for (int i = 0; i < count; i++)
+    {
+        ULONG kind = TestRandom(&seed) % 20;
+        if (kind == 0)
+            swprintf_s(hosts[i].hostname, MAX_HOSTNAME_LEN, L"10.%u.%u.%u",
+                       (unsigned int)(TestRandom(&seed) % 256), (unsigned int)(TestRandom(&seed) % 256),
+                       (unsigned int)(TestRandom(&seed) % 256));
+        else if (kind == 1)
+            swprintf_s(hosts[i].hostname, MAX_HOSTNAME_LEN, L"%s%u",
+                       roles[TestRandom(&seed) % ARRAYSIZE(roles)], (unsigned int)(TestRandom(&seed) % 1000));
+        else
+            swprintf_s(hosts[i].hostname, MAX_HOSTNAME_LEN, L"%s%03u.%s%u.corp.example",
+                       roles[TestRandom(&seed) % ARRAYSIZE(roles)], (unsigned int)(TestRandom(&seed) % 1000),
+                       (TestRandom(&seed) & 1) ? L"eu" : L"US", (unsigned int)(TestRandom(&seed) % 50));
+        wcscpy_s(hosts[i].lastConnected, 64, L"Never");
+    }
+    return hosts;
+}
+
+static int* ShuffledIndices(int count, ULONG seed)
+{
+    int* indices = (int*)malloc(count * sizeof(int));
+    if (indices == NULL)
+        return NULL;
+
+    for (int i = 0; i < count; i++)
+        indices[i] = i;
+    for (int i = count - 1; i > 0; i--)
+    {
+        int j = (int)(TestRandom(&seed) % (ULONG)(i + 1));
+        int t = indices[i];
+        indices[i] = indices[j];
+        indices[j] = t;
+    }
+    return indices;
+}
+
+/*
+ * TestGeneratedHosts - Every listed host is in the group its key names,
+ * once, in list order; groups are sorted and distinct
+ */
+static void TestGeneratedHosts(GroupMode mode)
+{
+    const int count = 20000;
+    Host* hosts = GenerateHosts(count, 3);
+    int* indices = ShuffledIndices(count, 4);
+    int* position = (int*)calloc(count, sizeof(int));
+    int* seen = (int*)calloc(count, sizeof(int));
+    if (hosts == NULL || indices == NULL || position == NULL || seen == NULL)
+    {
+        CHECK(!"out of memory");
+        return;
+    }
+
+    // Group only the first three quarters of the list
+    int listed = count * 3 / 4;
+    for (int i = 0; i < listed; i++)
+        position[indices[i]] = i;
+
+    HostGroups* groups = BuildHostGroups(hosts, indices, listed, mode);
+    CHECK(groups != NULL);
+
+    int total = 0;
+    BOOL sorted = TRUE, keysMatch = TRUE, inOrder = TRUE;
+    for (int g = 0; groups != NULL && g < GetHostGroupCount(groups); g++)
+    {
+        const wchar_t* name = GetHostGroupName(groups, g);
+        if (g > 0 && wcscmp(GetHostGroupName(groups, g - 1), name) >= 0)
+            sorted = FALSE;
+
+        const int* members;
+        int memberCount = GetHostGroupMembers(groups, g, &members);
+        for (int m = 0; m < memberCount; m++)
+        {
+            wchar_t key[MAX_HOSTNAME_LEN];
+            GetHostGroupKey(&hosts[members[m]], mode, key, MAX_HOSTNAME_LEN);
+            if (wcscmp(key, name) != 0)
+                keysMatch = FALSE;
+            if (m > 0 && position[members[m - 1]] >= position[members[m]])
+                inOrder = FALSE;
+            seen[members[m]]++;
+        }
+        total += memberCount;
+    }
+
+    BOOL listedOnce = TRUE;
+    for (int i = 0; i < count; i++)
+    {
+        BOOL isListed = position[i] < listed && indices[position[i]] == i;
+        if (seen[i] != (isListed ? 1 : 0))
+            listedOnce = FALSE;
+    }
+
+    CHECK_INT(total, listed);
+    CHECK(sorted);
+    CHECK(keysMatch);
+    CHECK(inOrder);
+    CHECK(listedOnce);
+
+    FreeHostGroups(groups);
+    free(seen);
+    free(position);
+    free(indices);
+    free(hosts);
+}
+
+/*
+ * Benchmark
+ */
+
+typedef struct {
+    wchar_t key[MAX_HOSTNAME_LEN];
+    int position;
+} KeyedHost;
+
+static int CompareKeyedHosts(const void* a, const void* b)
+{
+    const KeyedHost* x = (const KeyedHost*)a;
+    const KeyedHost* y = (const KeyedHost*)b;
+    int result = wcscmp(x->key, y->key);
+    return (result != 0) ? result : x->position - y->position;
+}
+
+static void BenchGrouping(int count)
+{
+    char label[96];
+    Host* hosts = GenerateHosts(count, 11);
+    int* indices = ShuffledIndices(count, 12);
+    KeyedHost* keyed = (KeyedHost*)malloc(count * sizeof(KeyedHost));
+    if (hosts == NULL || indices == NULL || keyed == NULL)
+        return;
+
+    printf("%d hosts\n", count);
+    for (GroupMode mode = GROUP_BY_DOMAIN; mode <= GROUP_BY_NAME_PREFIX; mode++)
+    {
+        const char* name = (mode == GROUP_BY_DOMAIN) ? "domain" : "name prefix";
+
+        double start = TestNowMs();
+        HostGroups* groups = BuildHostGroups(hosts, indices, count, mode);
+        double ms = TestNowMs() - start;
+        snprintf(label, sizeof(label), "group by %s (%d groups)", name, GetHostGroupCount(groups));
+        TestBenchResult(label, ms);
+        FreeHostGroups(groups);
+
+        start = TestNowMs();
+        for (int i = 0; i < count; i++)
+        {
+            GetHostGroupKey(&hosts[indices[i]], mode, keyed[i].key, MAX_HOSTNAME_LEN);
+            keyed[i].position = i;
+        }
+        qsort(keyed, count, sizeof(KeyedHost), CompareKeyedHosts);
+        snprintf(label, sizeof(label), "group by %s with qsort (baseline)", name);
+        TestBenchResult(label, TestNowMs() - start);
+    }
+
+    free(keyed);
+    free(indices);
+    free(hosts);
+}
+
+int main(int argc, char** argv)
+{
+    TestGroupKeys();
+    TestBuildGroups();
+    TestGeneratedHosts(GROUP_BY_DOMAIN);
+    TestGeneratedHosts(GROUP_BY_NAME_PREFIX);
+
+    if (TestBenchRequested(argc, argv))
+    {
+        BenchGrouping(100000);
+        BenchGrouping(500000);
+    }
+
+    return TestSummary("grouping");
+}
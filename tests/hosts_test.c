@@ -0,0 +1,351 @@
+/*
+ * Host List Diff Tests
+ *
+ * DiffHosts against hand-made lists (added, updated, missing, unchanged,
+ * case and repeats in the scan), then ApplyHostDiff and AddHosts through
+ * the hosts file: only the chosen entries applied, missing hosts kept, no
+ * write when nothing changed, and a list far bigger than SaveHosts'
+ * first buffer. The benchmark diffs a scan against 10k and 100k saved
+ * hosts and applies the 100k diff in one save.
+ */
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "test.h"
+#include "hosts.h"
+#include "encryption.h"
+
+/*
+ * Encryption
+ */
+
+// Stands in for DPAPI: reversible, and the file is not plain CSV
+BOOL EncryptData(const BYTE* plaintext, DWORD plaintextSize, BYTE** ciphertext, DWORD* ciphertextSize)
+{
+    *ciphertext = (BYTE*)LocalAlloc(LMEM_FIXED, plaintextSize + 1);
+    if (*ciphertext == NULL)
+        return FALSE;
+    for (DWORD i = 0; i < plaintextSize; i++)
+        (*ciphertext)[i] = plaintext[i] ^ 0x5A;
+    *ciphertextSize = plaintextSize;
+    return TRUE;
+}
+
+BOOL DecryptData(const BYTE* ciphertext, DWORD ciphertextSize, BYTE** plaintext, DWORD* plaintextSize)
+{
+    return EncryptData(ciphertext, ciphertextSize, plaintext, plaintextSize);
+}
+
+/*
+ * Helpers
+ */
+
+static void SetHost(Host* host, const wchar_t* hostname, const wchar_t* description)
+{
+    wcscpy_s(host->hostname, MAX_HOSTNAME_LEN, hostname);
+    wcscpy_s(host->description, MAX_DESCRIPTION_LEN, description);
+    wcscpy_s(host->lastConnected, 64, L"Never");
+}
+
+static BOOL SaveList(const wchar_t* const* hostnames, const wchar_t* const* descriptions, int count)
+{
+    Host* hosts = (Host*)calloc(count + 1, sizeof(Host));
+    if (hosts == NULL)
+        return FALSE;
+    for (int i = 0; i < count; i++)
+        SetHost(&hosts[i], hostnames[i], descriptions[i]);
+    BOOL saved = SaveHosts(hosts, count);
+    free(hosts);
+    return saved;
+}
+
+// The saved description of hostname, or NULL
+static const wchar_t* FindDescription(const Host* hosts, int count, const wchar_t* hostname)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (_wcsicmp(hosts[i].hostname, hostname) == 0)
+            return hosts[i].description;
+    }
+    return NULL;
+}
+
+/*
+ * Tests
+ */
+
+static void TestDiff(void)
+{
+    Host hosts[4];
+    SetHost(&hosts[0], L"alpha", L"Web");
+    SetHost(&hosts[1], L"Bravo", L"Database");
+    SetHost(&hosts[2], L"charlie", L"");
+    SetHost(&hosts[3], L"delta", L"Old");
+
+    const wchar_t* names[] = { L"ALPHA", L"bravo", L"echo", L"Echo", L"foxtrot", L"alpha", L"bravo" };
+    const wchar_t* descriptions[] = { L"Web", L"Database (SQL)", L"New", L"Other", L"", L"Changed", L"Again" };
+    HostDiff diff;
+
+    CHECK(DiffHosts(hosts, 4, names, descriptions, (int)ARRAYSIZE(names), &diff));
+
+    // A name listed twice counts once, as first listed
+    CHECK_INT(diff.addedCount, 2);
+    CHECK_INT(diff.added[0], 2);
+    CHECK_INT(diff.added[1], 4);
+    CHECK_INT(diff.updatedCount, 1);
+    CHECK_INT(diff.updated[0], 1);
+    CHECK_INT(diff.updatedHosts[0], 1);
+    CHECK_INT(diff.unchangedCount, 1);
+    CHECK_INT(diff.missingCount, 2);
+    CHECK_INT(diff.missing[0], 2);
+    CHECK_INT(diff.missing[1], 3);
+    FreeHostDiff(&diff);
+    CHECK(diff.added == NULL);
+
+    // Nothing saved yet: everything is new
+    CHECK(DiffHosts(NULL, 0, names, descriptions, 4, &diff));
+    CHECK_INT(diff.addedCount, 3);
+    CHECK_INT(diff.missingCount, 0);
+    FreeHostDiff(&diff);
+
+    // An empty scan: everything is missing
+    CHECK(DiffHosts(hosts, 4, NULL, NULL, 0, &diff));
+    CHECK_INT(diff.addedCount, 0);
+    CHECK_INT(diff.updatedCount, 0);
+    CHECK_INT(diff.missingCount, 4);
+    FreeHostDiff(&diff);
+
+    // Descriptions compare as saved (cut to MAX_DESCRIPTION_LEN - 1)
+    static wchar_t longDescription[MAX_DESCRIPTION_LEN + 20];
+    for (int i = 0; i < (int)ARRAYSIZE(longDescription) - 1; i++)
+        longDescription[i] = L'x';
+    longDescription[ARRAYSIZE(longDescription) - 1] = L'\0';
+    wcsncpy_s(hosts[0].description, MAX_DESCRIPTION_LEN, longDescription, _TRUNCATE);
+    const wchar_t* longNames[] = { L"alpha" };
+    const wchar_t* longDescriptions[] = { longDescription };
+    CHECK(DiffHosts(hosts, 1, longNames, longDescriptions, 1, &diff));
+    CHECK_INT(diff.unchangedCount, 1);
+    CHECK_INT(diff.updatedCount, 0);
+    FreeHostDiff(&diff);
+}
+
+static void TestApply(void)
+{
+    const wchar_t* savedNames[] = { L"alpha", L"bravo", L"charlie" };
+    const wchar_t* savedDescriptions[] = { L"Web", L"Database", L"Files" };
+    CHECK(SaveList(savedNames, savedDescriptions, 3));
+
+    Host* hosts = NULL;
+    int count = 0;
+    CHECK(LoadHosts(&hosts, &count));
+    CHECK_INT(count, 3);
+
+    const wchar_t* names[] = { L"alpha", L"bravo", L"delta", L"echo" };
+    const wchar_t* descriptions[] = { L"Web", L"Database (SQL)", L"Mail", L"Print" };
+    HostDiff diff;
+    CHECK(DiffHosts(hosts, count, names, descriptions, 4, &diff));
+
+    // Only the ticked entries, and descriptions left alone
+    BYTE include[] = { 1, 1, 0, 1 };
+    int added = -1;
+    int updated = -1;
+    CHECK(ApplyHostDiff(hosts, count, names, descriptions, &diff, include, FALSE, &added, &updated));
+    CHECK_INT(added, 1);
+    CHECK_INT(updated, 0);
+
+    Host* after = NULL;
+    int afterCount = 0;
+    CHECK(LoadHosts(&after, &afterCount));
+    CHECK_INT(afterCount, 4);
+    CHECK_WSTR(FindDescription(after, afterCount, L"bravo"), L"Database");
+    CHECK_WSTR(FindDescription(after, afterCount, L"echo"), L"Print");
+    CHECK_WSTR(FindDescription(after, afterCount, L"charlie"), L"Files");   // Missing hosts are kept
+    CHECK(FindDescription(after, afterCount, L"delta") == NULL);
+    CHECK_WSTR(after[3].lastConnected, L"Never");
+    FreeHosts(after, afterCount);
+
+    // Everything, descriptions too
+    CHECK(ApplyHostDiff(hosts, count, names, descriptions, &diff, NULL, TRUE, &added, &updated));
+    CHECK_INT(added, 2);
+    CHECK_INT(updated, 1);
+    CHECK(LoadHosts(&after, &afterCount));
+    CHECK_INT(afterCount, 5);
+    CHECK_WSTR(FindDescription(after, afterCount, L"bravo"), L"Database (SQL)");
+    CHECK_WSTR(FindDescription(after, afterCount, L"delta"), L"Mail");
+    FreeHosts(after, afterCount);
+
+    // Nothing ticked: the file is not written (it still holds something else)
+    const wchar_t* otherNames[] = { L"zulu" };
+    const wchar_t* otherDescriptions[] = { L"" };
+    CHECK(SaveList(otherNames, otherDescriptions, 1));
+    BYTE none[] = { 0, 0, 0, 0 };
+    CHECK(ApplyHostDiff(hosts, count, names, descriptions, &diff, none, TRUE, &added, &updated));
+    CHECK_INT(added, 0);
+    CHECK_INT(updated, 0);
+    CHECK(LoadHosts(&after, &afterCount));
+    CHECK_INT(afterCount, 1);
+    FreeHosts(after, afterCount);
+
+    FreeHostDiff(&diff);
+    FreeHosts(hosts, count);
+}
+
+static void TestAddHosts(void)
+{
+    const wchar_t* savedNames[] = { L"alpha", L"bravo" };
+    const wchar_t* savedDescriptions[] = { L"Web", L"Database" };
+    CHECK(SaveList(savedNames, savedDescriptions, 2));
+
+    // Existing names get the new description, repeats are added once
+    const wchar_t* names[] = { L"BRAVO", L"charlie", L"Charlie" };
+    const wchar_t* descriptions[] = { L"SQL", L"Files", L"Other" };
+    CHECK(AddHosts(names, descriptions, 3));
+
+    Host* hosts = NULL;
+    int count = 0;
+    CHECK(LoadHosts(&hosts, &count));
+    CHECK_INT(count, 3);
+    CHECK_WSTR(FindDescription(hosts, count, L"bravo"), L"SQL");
+    CHECK_WSTR(FindDescription(hosts, count, L"charlie"), L"Files");
+    CHECK_WSTR(FindDescription(hosts, count, L"alpha"), L"Web");
+    FreeHosts(hosts, count);
+
+    CHECK(AddHosts(names, descriptions, 0));
+}
+
+// Well past the 128KB SaveHosts starts with
+static void TestLargeList(void)
+{
+    const int count = 20000;
+    Host* hosts = (Host*)calloc(count, sizeof(Host));
+    if (hosts == NULL)
+        return;
+
+    for (int i = 0; i < count; i++)
+    {
+        swprintf_s(hosts[i].hostname, MAX_HOSTNAME_LEN, L"server%05d.corp.example.com", i);
+        swprintf_s(hosts[i].description, MAX_DESCRIPTION_LEN, L"Rack %d row %d", i / 40, i % 40);
+        wcscpy_s(hosts[i].lastConnected, 64, L"Never");
+    }
+    CHECK(SaveHosts(hosts, count));
+
+    Host* loaded = NULL;
+    int loadedCount = 0;
+    CHECK(LoadHosts(&loaded, &loadedCount));
+    CHECK_INT(loadedCount, count);
+    if (loadedCount == count)
+    {
+        CHECK_WSTR(loaded[0].hostname, L"server00000.corp.example.com");
+        CHECK_WSTR(loaded[count - 1].hostname, L"server19999.corp.example.com");
+        CHECK_WSTR(loaded[count - 1].description, L"Rack 499 row 39");
+    }
+    FreeHosts(loaded, loadedCount);
+    free(hosts);
+}
+
+/*
+ * Benchmark
+ */
+
+// count saved hosts; a scan of 90% of them (every tenth description changed) plus 10% new
+static void BenchDiff(int count, BOOL apply)
+{
+    char label[96];
+    int scanCount = count;
+    Host* hosts = (Host*)calloc(count, sizeof(Host));
+    wchar_t (*names)[40] = calloc(scanCount, sizeof(*names));
+    wchar_t (*descriptions)[40] = calloc(scanCount, sizeof(*descriptions));
+    const wchar_t** namePointers = (const wchar_t**)malloc(sizeof(wchar_t*) * scanCount);
+    const wchar_t** descriptionPointers = (const wchar_t**)malloc(sizeof(wchar_t*) * scanCount);
+    if (hosts == NULL || names == NULL || descriptions == NULL || namePointers == NULL || descriptionPointers == NULL)
+    {
+        free(descriptionPointers);
+        free(namePointers);
+        free(descriptions);
+        free(names);
+        free(hosts);
+        return;
+    }
+
+    ULONG seed = 44;
+    for (int i = 0; i < count; i++)
+    {
+        swprintf_s(hosts[i].hostname, MAX_HOSTNAME_LEN, L"host%07d.corp.example.com", i);
+        swprintf_s(hosts[i].description, MAX_DESCRIPTION_LEN, L"Site %d", i % 97);
+        wcscpy_s(hosts[i].lastConnected, 64, L"Never");
+    }
+
+    // Listed in scan order, not saved order
+    for (int n = 0; n < scanCount; n++)
+    {
+        int host = (n < count * 9 / 10) ? n : count + n;
+        swprintf_s(names[n], 40, (n % 3 == 0) ? L"HOST%07d.CORP.EXAMPLE.COM" : L"host%07d.corp.example.com", host);
+        swprintf_s(descriptions[n], 40, (n % 10 == 0) ? L"Site %d (moved)" : L"Site %d", host % 97);
+    }
+    for (int n = scanCount - 1; n > 0; n--)
+    {
+        int other = (int)(TestRandom(&seed) % (ULONG)(n + 1));
+        wchar_t swap[40];
+        wcscpy_s(swap, 40, names[n]);
+        wcscpy_s(names[n], 40, names[other]);
+        wcscpy_s(names[other], 40, swap);
+        wcscpy_s(swap, 40, descriptions[n]);
+        wcscpy_s(descriptions[n], 40, descriptions[other]);
+        wcscpy_s(descriptions[other], 40, swap);
+    }
+    for (int n = 0; n < scanCount; n++)
+    {
+        namePointers[n] = names[n];
+        descriptionPointers[n] = descriptions[n];
+    }
+
+    HostDiff diff;
+    double start = TestNowMs();
+    BOOL ok = DiffHosts(hosts, count, namePointers, descriptionPointers, scanCount, &diff);
+    double ms = TestNowMs() - start;
+    CHECK(ok);
+
+    CHECK_INT(diff.addedCount, scanCount - count * 9 / 10);
+    CHECK_INT(diff.missingCount, count - count * 9 / 10);
+    CHECK_INT(diff.updatedCount + diff.unchangedCount, count * 9 / 10);
+    snprintf(label, sizeof(label), "DiffHosts, %dk saved, %dk scanned", count / 1000, scanCount / 1000);
+    TestBenchResult(label, ms);
+
+    if (ok && apply)
+    {
+        int added = 0;
+        int updated = 0;
+        start = TestNowMs();
+        CHECK(ApplyHostDiff(hosts, count, namePointers, descriptionPointers, &diff, NULL, TRUE, &added, &updated));
+        snprintf(label, sizeof(label), "ApplyHostDiff, %dk saved (one save)", count / 1000);
+        TestBenchResult(label, TestNowMs() - start);
+        CHECK_INT(added, diff.addedCount);
+        CHECK_INT(updated, diff.updatedCount);
+    }
+    FreeHostDiff(&diff);
+
+    free(descriptionPointers);
+    free(namePointers);
+    free(descriptions);
+    free(names);
+    free(hosts);
+}
+
+int main(int argc, char** argv)
+{
+    TestDiff();
+    TestApply();
+    TestAddHosts();
+    TestLargeList();
+
+    if (TestBenchRequested(argc, argv))
+    {
+        printf("Diffing a scan against the saved hosts\n");
+        BenchDiff(10000, FALSE);
+        BenchDiff(100000, TRUE);
+    }
+
+    DeleteAllHosts();
+    return TestSummary("hosts");
+}
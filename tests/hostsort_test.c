@@ -0,0 +1,311 @@
+/*
+ * Host Sorting Tests
+ *
+ * Checks the column comparisons, stability and the parallel path of
+ * SortHostIndices. The benchmark sorts 100k and 500k generated hosts and
+ * compares against qsort with _wcsicmp on every comparison (what the list
+ * did before the sort keys).
+ */
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "test.h"
+#include "hostsort.h"
+#include "latency.h"
+
+static const wchar_t* const g_descriptions[] = {
+    L"Domain controller", L"File server", L"SQL server", L"Web server", L"Jump host", L""
+};
+
+/*
+ * GenerateHosts - Hosts with random names, a few shared descriptions
+ * (plenty of ties) and a mix of timestamps and "Never"
+ */
+static Host* GenerateHosts(int count, ULONG seed)
+{
+    Host* hosts = (Host*)calloc(count, sizeof(Host));
+    if (hosts == NULL)
+        return NULL;
+
+    for (int i = 0; i < count; i++)
+    {
+        ULONG r = TestRandom(&seed);
+        swprintf_s(hosts[i].hostname, MAX_HOSTNAME_LEN, L"%s%05u.corp.example",
+                   (r & 1) ? L"SRV-" : L"srv-", (unsigned int)(TestRandom(&seed) % 100000));
+        wcscpy_s(hosts[i].description, MAX_DESCRIPTION_LEN,
+                 g_descriptions[TestRandom(&seed) % ARRAYSIZE(g_descriptions)]);
+        if (TestRandom(&seed) % 4 == 0)
+            wcscpy_s(hosts[i].lastConnected, 64, L"Never");
+        else
+            swprintf_s(hosts[i].lastConnected, 64, L"2024-%02u-%02u %02u:%02u:00",
+                       (unsigned int)(1 + TestRandom(&seed) % 12), (unsigned int)(1 + TestRandom(&seed) % 28),
+                       (unsigned int)(TestRandom(&seed) % 24), (unsigned int)(TestRandom(&seed) % 60));
+    }
+    return hosts;
+}
+
+static int* IdentityIndices(int count)
+{
+    int* indices = (int*)malloc(count * sizeof(int));
+    if (indices != NULL)
+    {
+        for (int i = 0; i < count; i++)
+            indices[i] = i;
+    }
+    return indices;
+}
+
+/*
+ * IsStablySorted - Every neighbouring pair is in order, and equal pairs
+ * keep the order they had in the input (indices start out as 0..n-1)
+ */
+static BOOL IsStablySorted(const HostSortKeys* keys, const HostSortSpec* spec, const int* indices, int count)
+{
+    for (int i = 1; i < count; i++)
+    {
+        int result = CompareHostsByKeys(keys, spec, indices[i - 1], indices[i]);
+        if (result > 0 || (result == 0 && indices[i - 1] > indices[i]))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static void TestTimestampKeys(void)
+{
+    CHECK(TimestampSortKey(L"2024-05-06 07:08:09") == 20240506070809ULL);
+    CHECK(TimestampSortKey(L"Never") == TIMESTAMP_NEVER);
+    CHECK(TimestampSortKey(L"2024-05-06") == TIMESTAMP_NEVER);
+    CHECK(TimestampSortKey(L"2024/05/06 07:08:09") == TIMESTAMP_NEVER);
+    CHECK(TimestampSortKey(L"2023-12-31 23:59:59") < TimestampSortKey(L"2024-01-01 00:00:00"));
+}
+
+static void TestHostnameOrder(void)
+{
+    Host hosts[4] = {
+        { L"beta", L"", L"Never" },
+        { L"Alpha", L"", L"Never" },
+        { L"gamma", L"", L"Never" },
+        { L"ALPHA2", L"", L"Never" },
+    };
+    HostSortSpec spec = { SORT_COLUMN_HOSTNAME, TRUE, SORT_COLUMN_NONE, TRUE };
+    HostSortKeys* keys = BuildHostSortKeys(hosts, 4);
+    int indices[4] = { 0, 1, 2, 3 };
+
+    CHECK(keys != NULL);
+    CHECK(SortHostIndices(keys, &spec, indices, 4));
+    CHECK_INT(indices[0], 1);
+    CHECK_INT(indices[1], 3);
+    CHECK_INT(indices[2], 0);
+    CHECK_INT(indices[3], 2);
+
+    // Case does not matter, and a prefix sorts first
+    CHECK(CompareHostsByKeys(keys, &spec, 1, 3) < 0);
+
+    spec.primaryAscending = FALSE;
+    CHECK(SortHostIndices(keys, &spec, indices, 4));
+    CHECK_INT(indices[0], 2);
+    CHECK_INT(indices[3], 1);
+
+    FreeHostSortKeys(keys);
+}
+
+static void TestStableAndSecondary(void)
+{
+    Host hosts[6] = {
+        { L"e", L"web", L"2024-01-01 10:00:00" },
+        { L"a", L"db", L"Never" },
+        { L"d", L"web", L"2024-03-01 10:00:00" },
+        { L"b", L"db", L"2024-02-01 10:00:00" },
+        { L"f", L"web", L"Never" },
+        { L"c", L"db", L"2024-01-01 10:00:00" },
+    };
+    HostSortKeys* keys = BuildHostSortKeys(hosts, 6);
+    CHECK(keys != NULL);
+
+    // Equal descriptions keep their previous order
+    HostSortSpec spec = { SORT_COLUMN_DESCRIPTION, TRUE, SORT_COLUMN_NONE, TRUE };
+    int indices[6] = { 0, 1, 2, 3, 4, 5 };
+    CHECK(SortHostIndices(keys, &spec, indices, 6));
+    int expectStable[6] = { 1, 3, 5, 0, 2, 4 };
+    CHECK(memcmp(indices, expectStable, sizeof(indices)) == 0);
+
+    // Description ascending, then hostname descending
+    spec.secondaryColumn = SORT_COLUMN_HOSTNAME;
+    spec.secondaryAscending = FALSE;
+    CHECK(SortHostIndices(keys, &spec, indices, 6));
+    int expectSecondary[6] = { 5, 3, 1, 4, 0, 2 };
+    CHECK(memcmp(indices, expectSecondary, sizeof(indices)) == 0);
+
+    // "Never" sorts after every timestamp ascending, and first descending
+    HostSortSpec byDate = { SORT_COLUMN_LAST_CONNECTED, TRUE, SORT_COLUMN_HOSTNAME, TRUE };
+    for (int i = 0; i < 6; i++)
+        indices[i] = i;
+    CHECK(SortHostIndices(keys, &byDate, indices, 6));
+    int expectDate[6] = { 5, 0, 3, 2, 1, 4 };
+    CHECK(memcmp(indices, expectDate, sizeof(indices)) == 0);
+
+    byDate.primaryAscending = FALSE;
+    CHECK(SortHostIndices(keys, &byDate, indices, 6));
+    CHECK_INT(indices[0], 1);
+    CHECK_INT(indices[1], 4);
+
+    FreeHostSortKeys(keys);
+}
+
+static void TestLatencyOrder(void)
+{
+    Host hosts[4] = {
+        { L"never-probed-1", L"", L"Never" },
+        { L"slow.example", L"", L"Never" },
+        { L"never-probed-2", L"", L"Never" },
+        { L"fast.example", L"", L"Never" },
+    };
+    RecordHostLatency(L"slow.example", 80.0);
+    RecordHostLatency(L"fast.example", 2.0);
+
+    HostSortKeys* keys = BuildHostSortKeys(hosts, 4);
+    CHECK(keys != NULL);
+
+    // Unprobed hosts go last in both directions (and keep their order)
+    HostSortSpec spec = { SORT_COLUMN_LATENCY_P50, TRUE, SORT_COLUMN_NONE, TRUE };
+    int indices[4] = { 0, 1, 2, 3 };
+    CHECK(SortHostIndices(keys, &spec, indices, 4));
+    int expectAscending[4] = { 3, 1, 0, 2 };
+    CHECK(memcmp(indices, expectAscending, sizeof(indices)) == 0);
+
+    spec.primaryAscending = FALSE;
+    CHECK(SortHostIndices(keys, &spec, indices, 4));
+    int expectDescending[4] = { 1, 3, 0, 2 };
+    CHECK(memcmp(indices, expectDescending, sizeof(indices)) == 0);
+
+    FreeHostSortKeys(keys);
+}
+
+static void TestSetSortColumn(void)
+{
+    HostSortSpec spec = { SORT_COLUMN_HOSTNAME, TRUE, SORT_COLUMN_NONE, TRUE };
+
+    SetSortColumn(&spec, SORT_COLUMN_HOSTNAME);
+    CHECK(spec.primaryColumn == SORT_COLUMN_HOSTNAME && !spec.primaryAscending);
+
+    SetSortColumn(&spec, SORT_COLUMN_LAST_CONNECTED);
+    CHECK(spec.primaryColumn == SORT_COLUMN_LAST_CONNECTED && spec.primaryAscending);
+    CHECK(spec.secondaryColumn == SORT_COLUMN_HOSTNAME && !spec.secondaryAscending);
+}
+
+static void TestParallelSort(void)
+{
+    // Above the threshold, so the chunks are sorted on several threads
+    int count = HOST_SORT_PARALLEL_THRESHOLD * 3 + 7;
+    Host* hosts = GenerateHosts(count, 1);
+    HostSortKeys* keys = BuildHostSortKeys(hosts, count);
+    int* indices = IdentityIndices(count);
+
+    CHECK(hosts != NULL && keys != NULL && indices != NULL);
+    if (hosts == NULL || keys == NULL || indices == NULL)
+        return;
+
+    HostSortSpec spec = { SORT_COLUMN_DESCRIPTION, TRUE, SORT_COLUMN_LAST_CONNECTED, FALSE };
+    CHECK(SortHostIndices(keys, &spec, indices, count));
+    CHECK(IsStablySorted(keys, &spec, indices, count));
+
+    // Sorting the result by hostname only must keep the previous order on ties
+    HostSortSpec byName = { SORT_COLUMN_HOSTNAME, TRUE, SORT_COLUMN_NONE, TRUE };
+    int* position = (int*)malloc(count * sizeof(int));
+    CHECK(position != NULL);
+    if (position != NULL)
+    {
+        for (int i = 0; i < count; i++)
+            position[indices[i]] = i;
+        CHECK(SortHostIndices(keys, &byName, indices, count));
+
+        BOOL ordered = TRUE;
+        for (int i = 1; i < count; i++)
+        {
+            int result = CompareHostsByKeys(keys, &byName, indices[i - 1], indices[i]);
+            if (result > 0 || (result == 0 && position[indices[i - 1]] > position[indices[i]]))
+                ordered = FALSE;
+        }
+        CHECK(ordered);
+    }
+
+    free(position);
+    free(indices);
+    FreeHostSortKeys(keys);
+    free(hosts);
+}
+
+/*
+ * Benchmark
+ */
+
+static const Host* g_qsortHosts;
+
+static int CompareHostnamesDirect(const void* a, const void* b)
+{
+    int result = _wcsicmp(g_qsortHosts[*(const int*)a].hostname, g_qsortHosts[*(const int*)b].hostname);
+    return (result != 0) ? result : *(const int*)a - *(const int*)b;
+}
+
+static void BenchSort(int count)
+{
+    Host* hosts = GenerateHosts(count, 7);
+    int* indices = IdentityIndices(count);
+    if (hosts == NULL || indices == NULL)
+        return;
+
+    printf("%d hosts\n", count);
+
+    double start = TestNowMs();
+    HostSortKeys* keys = BuildHostSortKeys(hosts, count);
+    TestBenchResult("build sort keys", TestNowMs() - start);
+
+    HostSortSpec byName = { SORT_COLUMN_HOSTNAME, TRUE, SORT_COLUMN_NONE, TRUE };
+    start = TestNowMs();
+    SortHostIndices(keys, &byName, indices, count);
+    TestBenchResult("sort by hostname", TestNowMs() - start);
+
+    start = TestNowMs();
+    SortHostIndices(keys, &byName, indices, count);
+    TestBenchResult("sort by hostname again (already sorted)", TestNowMs() - start);
+
+    byName.primaryAscending = FALSE;
+    start = TestNowMs();
+    SortHostIndices(keys, &byName, indices, count);
+    TestBenchResult("sort by hostname descending", TestNowMs() - start);
+
+    HostSortSpec byDate = { SORT_COLUMN_LAST_CONNECTED, FALSE, SORT_COLUMN_HOSTNAME, TRUE };
+    start = TestNowMs();
+    SortHostIndices(keys, &byDate, indices, count);
+    TestBenchResult("sort by last connected, then hostname", TestNowMs() - start);
+
+    for (int i = 0; i < count; i++)
+        indices[i] = i;
+    g_qsortHosts = hosts;
+    start = TestNowMs();
+    qsort(indices, count, sizeof(int), CompareHostnamesDirect);
+    TestBenchResult("qsort with _wcsicmp (baseline)", TestNowMs() - start);
+
+    FreeHostSortKeys(keys);
+    free(indices);
+    free(hosts);
+}
+
+int main(int argc, char** argv)
+{
+    TestTimestampKeys();
+    TestHostnameOrder();
+    TestStableAndSecondary();
+    TestLatencyOrder();
+    TestSetSortColumn();
+    TestParallelSort();
+
+    if (TestBenchRequested(argc, argv))
+    {
+        BenchSort(100000);
+        BenchSort(500000);
+    }
+
+    return TestSummary("hostsort");
+}
@@ -0,0 +1,890 @@
+/*
+ * LDAP Directory Scanning Tests
+ *
+ * Runs EnumerateDirectoryComputers against an in-memory directory that
+ * stands in for a server (OpenLDAP or Active Directory): the LDAP client
+ * calls declared in fakeldap/winldap.h are implemented here, evaluating
+ * the real filter strings, returning only the requested attributes and
+ * handing out results a page at a time. Checks the type filters, the
+ * attribute conversion, paging, stopping early and the error paths, and
+ * that every connection, search, message and value is freed. The
+ * benchmark enumerates 100k-object directories.
+ */
+
+#include <windows.h>
+#include <winldap.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "test.h"
+#include "ldapscan.h"
+
+/*
+ * Fake directory
+ */
+
+// One directory object (empty = attribute not set)
+typedef struct {
+    wchar_t objectCategory[16];     // "computer" or "person"
+    wchar_t name[64];
+    wchar_t dNSHostName[128];
+    wchar_t description[256];
+    wchar_t operatingSystem[128];
+    wchar_t lastLogonTimestamp[24];
+    wchar_t userAccountControl[16];
+} FakeObject;
+
+#define FAKE_NAMING_CONTEXT     L"DC=corp,DC=example"
+#define FAKE_ROOT_DSE           (-1)
+
+static FakeObject* g_objects;
+static int g_objectCount;
+
+// How the server behaves
+static const wchar_t* g_knownHost = L"corp.example";   // Host ldap_initW accepts besides NULL
+static ULONG g_bindStatus;
+static BOOL g_noNamingContext;
+static BOOL g_reportEstimate;           // Give the total with each page (OpenLDAP does, AD does not)
+static int g_failPage;                  // 1-based page that fails (0 = none)
+static ULONG g_failStatus;
+
+// What the client asked for
+static wchar_t g_lastHost[256];
+static BOOL g_lastHostNull;
+static ULONG g_lastPort;
+static ULONG g_lastVersion;
+static ULONG g_lastMethod;
+static wchar_t g_lastBaseDn[256];
+static wchar_t g_lastFilter[512];
+static wchar_t g_lastAttributes[256];
+static ULONG g_lastPageSize;
+static int g_pagesServed;
+static ULONG g_lastError;
+
+// Handles and allocations not yet freed
+static int g_openConnections;
+static int g_openSearches;
+static int g_openMessages;
+static int g_openValues;
+
+struct ldap {
+    BOOL bound;
+};
+
+struct ldapsearch {
+    int* matches;               // Indices into g_objects
+    int count;
+    int position;
+    int pages;
+    wchar_t requested[256];     // ",attr,attr," lowercase
+};
+
+struct ldapmsg {
+    struct ldapmsg* owner;      // The result this entry belongs to (itself for a result)
+    struct ldapmsg* entries;    // Result only
+    int count;                  // Result only
+    int index;                  // Entry only
+    int object;                 // Entry only: index into g_objects or FAKE_ROOT_DSE
+    wchar_t requested[256];     // Result only
+};
+
+static void ResetDirectory(void)
+{
+    free(g_objects);
+    g_objects = NULL;
+    g_objectCount = 0;
+    g_bindStatus = LDAP_SUCCESS;
+    g_noNamingContext = FALSE;
+    g_reportEstimate = FALSE;
+    g_failPage = 0;
+    g_failStatus = LDAP_SUCCESS;
+    g_lastFilter[0] = L'\0';
+    g_lastAttributes[0] = L'\0';
+    g_pagesServed = 0;
+}
+
+static FakeObject* AddObject(const wchar_t* category, const wchar_t* name, const wchar_t* dnsName,
+                             const wchar_t* description, const wchar_t* os,
+                             const wchar_t* lastLogon, const wchar_t* userAccountControl)
+{
+    FakeObject* grown = (FakeObject*)realloc(g_objects, sizeof(FakeObject) * (g_objectCount + 1));
+    if (grown == NULL)
+        return NULL;
+    g_objects = grown;
+
+    FakeObject* object = &g_objects[g_objectCount++];
+    memset(object, 0, sizeof(FakeObject));
+    wcscpy_s(object->objectCategory, ARRAYSIZE(object->objectCategory), category);
+    wcscpy_s(object->name, ARRAYSIZE(object->name), name);
+    wcscpy_s(object->dNSHostName, ARRAYSIZE(object->dNSHostName), dnsName);
+    wcscpy_s(object->description, ARRAYSIZE(object->description), description);
+    wcscpy_s(object->operatingSystem, ARRAYSIZE(object->operatingSystem), os);
+    wcscpy_s(object->lastLogonTimestamp, ARRAYSIZE(object->lastLogonTimestamp), lastLogon);
+    wcscpy_s(object->userAccountControl, ARRAYSIZE(object->userAccountControl), userAccountControl);
+    return object;
+}
+
+/*
+ * GenerateDirectory - count objects: 60% workstations, 20% servers, 10%
+ * domain controllers and 10% user accounts
+ */
+static BOOL GenerateDirectory(int count)
+{
+    ResetDirectory();
+    g_objects = (FakeObject*)calloc(count, sizeof(FakeObject));
+    if (g_objects == NULL)
+        return FALSE;
+
+    for (int i = 0; i < count; i++)
+    {
+        FakeObject* object = &g_objects[i];
+        int kind = i % 10;
+
+        if (kind == 9)
+        {
+            wcscpy_s(object->objectCategory, ARRAYSIZE(object->objectCategory), L"person");
+            swprintf_s(object->name, ARRAYSIZE(object->name), L"user%06d", i);
+            wcscpy_s(object->userAccountControl, ARRAYSIZE(object->userAccountControl), L"512");
+            continue;
+        }
+
+        wcscpy_s(object->objectCategory, ARRAYSIZE(object->objectCategory), L"computer");
+        swprintf_s(object->name, ARRAYSIZE(object->name), L"PC%06d", i);
+        swprintf_s(object->dNSHostName, ARRAYSIZE(object->dNSHostName), L"pc%06d.corp.example", i);
+        if (i % 2 == 0)
+            swprintf_s(object->description, ARRAYSIZE(object->description), L"Desk %d, floor %d", i, i % 7);
+        wcscpy_s(object->operatingSystem, ARRAYSIZE(object->operatingSystem),
+                 (kind < 6) ? L"Windows 11 Enterprise" : L"Windows Server 2022 Datacenter");
+        if (i % 4 != 3)
+            swprintf_s(object->lastLogonTimestamp, ARRAYSIZE(object->lastLogonTimestamp), L"%lld", 133500000000000000LL + i);
+        wcscpy_s(object->userAccountControl, ARRAYSIZE(object->userAccountControl), (kind == 8) ? L"532480" : L"4096");
+    }
+    g_objectCount = count;
+    return TRUE;
+}
+
+// Value of an attribute of an object (NULL = not set)
+static const wchar_t* GetAttribute(int object, const wchar_t* attribute)
+{
+    if (object == FAKE_ROOT_DSE)
+    {
+        if (_wcsicmp(attribute, L"defaultNamingContext") == 0 && !g_noNamingContext)
+            return FAKE_NAMING_CONTEXT;
+        return NULL;
+    }
+
+    const FakeObject* o = &g_objects[object];
+    const wchar_t* value = NULL;
+    if (_wcsicmp(attribute, L"objectCategory") == 0)           value = o->objectCategory;
+    else if (_wcsicmp(attribute, L"name") == 0)                value = o->name;
+    else if (_wcsicmp(attribute, L"dNSHostName") == 0)         value = o->dNSHostName;
+    else if (_wcsicmp(attribute, L"description") == 0)         value = o->description;
+    else if (_wcsicmp(attribute, L"operatingSystem") == 0)     value = o->operatingSystem;
+    else if (_wcsicmp(attribute, L"lastLogonTimestamp") == 0)  value = o->lastLogonTimestamp;
+    else if (_wcsicmp(attribute, L"userAccountControl") == 0)  value = o->userAccountControl;
+    else if (_wcsicmp(attribute, L"objectClass") == 0)         value = L"top";
+    return (value != NULL && value[0] != L'\0') ? value : NULL;
+}
+
+// "*" in pattern matches any run of characters, ignoring case
+static BOOL WildcardMatch(const wchar_t* pattern, const wchar_t* text)
+{
+    if (*pattern == L'\0')
+        return *text == L'\0';
+    if (*pattern == L'*')
+    {
+        for (const wchar_t* t = text; ; t++)
+        {
+            if (WildcardMatch(pattern + 1, t))
+                return TRUE;
+            if (*t == L'\0')
+                return FALSE;
+        }
+    }
+    return *text != L'\0' && towlower(*pattern) == towlower(*text) && WildcardMatch(pattern + 1, text + 1);
+}
+
+/*
+ * EvaluateFilter - Parse one filter at *p and test it against an object
+ *
+ * Supports what a directory server needs for ldapscan.c: &, |, !,
+ * equality, presence, substrings and the bitwise AND matching rule.
+ * Returns FALSE if the filter is malformed.
+ */
+static BOOL EvaluateFilter(const wchar_t** p, int object, BOOL* match)
+{
+    if (**p != L'(')
+        return FALSE;
+    (*p)++;
+
+    if (**p == L'&' || **p == L'|')
+    {
+        BOOL isAnd = (**p == L'&');
+        int parts = 0;
+        *match = isAnd;
+        (*p)++;
+        while (**p == L'(')
+        {
+            BOOL partMatch;
+            if (!EvaluateFilter(p, object, &partMatch))
+                return FALSE;
+            *match = isAnd ? (*match && partMatch) : (*match || partMatch);
+            parts++;
+        }
+        if (parts == 0)
+            return FALSE;
+    }
+    else if (**p == L'!')
+    {
+        (*p)++;
+        if (!EvaluateFilter(p, object, match))
+            return FALSE;
+        *match = !*match;
+    }
+    else
+    {
+        wchar_t attribute[64], rule[64] = L"", value[256];
+        size_t n = 0;
+        while (**p != L'\0' && wcschr(L":=()", **p) == NULL && n < ARRAYSIZE(attribute) - 1)
+            attribute[n++] = *(*p)++;
+        attribute[n] = L'\0';
+
+        if (**p == L':')
+        {
+            (*p)++;
+            n = 0;
+            while (**p != L'\0' && **p != L':' && n < ARRAYSIZE(rule) - 1)
+                rule[n++] = *(*p)++;
+            rule[n] = L'\0';
+            if (**p != L':')
+                return FALSE;
+            (*p)++;
+        }
+        if (attribute[0] == L'\0' || **p != L'=')
+            return FALSE;
+        (*p)++;
+
+        n = 0;
+        while (**p != L'\0' && **p != L')' && **p != L'(' && n < ARRAYSIZE(value) - 1)
+            value[n++] = *(*p)++;
+        value[n] = L'\0';
+
+        const wchar_t* actual = GetAttribute(object, attribute);
+        if (rule[0] != L'\0')
+        {
+            if (wcscmp(rule, L"1.2.840.113556.1.4.803") != 0)
+                return FALSE;
+            unsigned long bits = wcstoul(value, NULL, 10);
+            *match = actual != NULL && (wcstoul(actual, NULL, 10) & bits) == bits;
+        }
+        else if (wcscmp(value, L"*") == 0)
+            *match = (actual != NULL);
+        else
+            *match = actual != NULL && WildcardMatch(value, actual);
+    }
+
+    if (**p != L')')
+        return FALSE;
+    (*p)++;
+    return TRUE;
+}
+
+// ",a,b," lowercase from a NULL-terminated attribute list; also recorded in g_lastAttributes
+static void RecordAttributes(PWCHAR* attributes, wchar_t* requested, size_t requestedLen)
+{
+    wcscpy_s(requested, requestedLen, L",");
+    g_lastAttributes[0] = L'\0';
+    for (int i = 0; attributes != NULL && attributes[i] != NULL; i++)
+    {
+        if (i > 0)
+            wcscat_s(g_lastAttributes, ARRAYSIZE(g_lastAttributes), L",");
+        wcscat_s(g_lastAttributes, ARRAYSIZE(g_lastAttributes), attributes[i]);
+        wcscat_s(requested, requestedLen, attributes[i]);
+        wcscat_s(requested, requestedLen, L",");
+    }
+    for (wchar_t* c = requested; *c != L'\0'; c++)
+        *c = (wchar_t)towlower(*c);
+}
+
+static LDAPMessage* NewResult(const int* objects, int count, const wchar_t* requested)
+{
+    LDAPMessage* result = (LDAPMessage*)calloc(1, sizeof(LDAPMessage));
+    if (result == NULL)
+        return NULL;
+
+    result->owner = result;
+    result->count = count;
+    wcscpy_s(result->requested, ARRAYSIZE(result->requested), requested);
+    if (count > 0)
+    {
+        result->entries = (LDAPMessage*)calloc(count, sizeof(LDAPMessage));
+        if (result->entries == NULL)
+        {
+            free(result);
+            return NULL;
+        }
+        for (int i = 0; i < count; i++)
+        {
+            result->entries[i].owner = result;
+            result->entries[i].index = i;
+            result->entries[i].object = objects[i];
+        }
+    }
+    g_openMessages++;
+    return result;
+}
+
+/*
+ * The LDAP client calls (see fakeldap/winldap.h)
+ */
+
+LDAP* ldap_initW(PWSTR hostName, ULONG portNumber)
+{
+    g_lastHostNull = (hostName == NULL);
+    wcscpy_s(g_lastHost, ARRAYSIZE(g_lastHost), (hostName != NULL) ? hostName : L"");
+    g_lastPort = portNumber;
+
+    if (hostName != NULL && _wcsicmp(hostName, g_knownHost) != 0)
+    {
+        g_lastError = LDAP_SERVER_DOWN;
+        return NULL;
+    }
+
+    LDAP* ld = (LDAP*)calloc(1, sizeof(LDAP));
+    if (ld == NULL)
+    {
+        g_lastError = LDAP_NO_MEMORY;
+        return NULL;
+    }
+    g_openConnections++;
+    return ld;
+}
+
+ULONG ldap_set_option(LDAP* ld, int option, const void* value)
+{
+    (void)ld;
+    if (option == LDAP_OPT_PROTOCOL_VERSION)
+        g_lastVersion = *(const ULONG*)value;
+    return LDAP_SUCCESS;
+}
+
+ULONG ldap_bind_sW(LDAP* ld, PWSTR dn, PWCHAR credential, ULONG method)
+{
+    (void)dn;
+    (void)credential;
+    g_lastMethod = method;
+    ld->bound = (g_bindStatus == LDAP_SUCCESS);
+    return g_bindStatus;
+}
+
+ULONG ldap_unbind(LDAP* ld)
+{
+    free(ld);
+    g_openConnections--;
+    return LDAP_SUCCESS;
+}
+
+// Only RootDSE reads are expected outside paged searches
+ULONG ldap_search_sW(LDAP* ld, PWSTR base, ULONG scope, PWSTR filter, PWCHAR* attrs,
+                     ULONG attrsOnly, LDAPMessage** res)
+{
+    (void)filter;
+    (void)attrsOnly;
+    *res = NULL;
+    if (!ld->bound)
+        return LDAP_INVALID_CREDENTIALS;
+    if (base != NULL || scope != LDAP_SCOPE_BASE)
+        return LDAP_FILTER_ERROR;
+
+    wchar_t requested[256];
+    RecordAttributes(attrs, requested, ARRAYSIZE(requested));
+    int rootDse = FAKE_ROOT_DSE;
+    *res = NewResult(&rootDse, 1, requested);
+    return (*res != NULL) ? LDAP_SUCCESS : LDAP_NO_MEMORY;
+}
+
+LDAPMessage* ldap_first_entry(LDAP* ld, LDAPMessage* res)
+{
+    (void)ld;
+    return (res != NULL && res->count > 0) ? &res->entries[0] : NULL;
+}
+
+LDAPMessage* ldap_next_entry(LDAP* ld, LDAPMessage* entry)
+{
+    (void)ld;
+    LDAPMessage* owner = entry->owner;
+    return (entry->index + 1 < owner->count) ? &owner->entries[entry->index + 1] : NULL;
+}
+
+PWCHAR* ldap_get_valuesW(LDAP* ld, LDAPMessage* entry, PWSTR attr)
+{
+    (void)ld;
+
+    // Attributes that were not asked for are not sent
+    wchar_t key[80];
+    swprintf_s(key, ARRAYSIZE(key), L",%s,", attr);
+    for (wchar_t* c = key; *c != L'\0'; c++)
+        *c = (wchar_t)towlower(*c);
+    if (wcsstr(entry->owner->requested, key) == NULL)
+        return NULL;
+
+    const wchar_t* value = GetAttribute(entry->object, attr);
+    if (value == NULL)
+        return NULL;
+
+    PWCHAR* values = (PWCHAR*)calloc(2, sizeof(PWCHAR));
+    if (values == NULL)
+        return NULL;
+    size_t length = wcslen(value) + 1;
+    values[0] = (PWCHAR)malloc(length * sizeof(wchar_t));
+    if (values[0] == NULL)
+    {
+        free(values);
+        return NULL;
+    }
+    wcscpy_s(values[0], length, value);
+    g_openValues++;
+    return values;
+}
+
+ULONG ldap_value_freeW(PWCHAR* vals)
+{
+    if (vals != NULL)
+    {
+        for (int i = 0; vals[i] != NULL; i++)
+            free(vals[i]);
+        free(vals);
+        g_openValues--;
+    }
+    return LDAP_SUCCESS;
+}
+
+ULONG ldap_msgfree(LDAPMessage* res)
+{
+    if (res != NULL)
+    {
+        free(res->entries);
+        free(res);
+        g_openMessages--;
+    }
+    return LDAP_SUCCESS;
+}
+
+PLDAPSearch ldap_search_init_pageW(LDAP* ld, PWSTR distinguishedName, ULONG scopeOfSearch,
+                                   PWSTR searchFilter, PWCHAR* attributeList, ULONG attributesOnly,
+                                   void* serverControls, void* clientControls,
+                                   ULONG pageTimeLimit, ULONG totalSizeLimit, void* sortKeys)
+{
+    (void)attributesOnly;
+    (void)serverControls;
+    (void)clientControls;
+    (void)pageTimeLimit;
+    (void)totalSizeLimit;
+    (void)sortKeys;
+
+    wcscpy_s(g_lastBaseDn, ARRAYSIZE(g_lastBaseDn), (distinguishedName != NULL) ? distinguishedName : L"");
+    wcscpy_s(g_lastFilter, ARRAYSIZE(g_lastFilter), searchFilter);
+    if (!ld->bound || scopeOfSearch != LDAP_SCOPE_SUBTREE)
+    {
+        g_lastError = LDAP_INVALID_CREDENTIALS;
+        return NULL;
+    }
+
+    PLDAPSearch search = (PLDAPSearch)calloc(1, sizeof(struct ldapsearch));
+    if (search == NULL || (g_objectCount > 0 && (search->matches = (int*)malloc(sizeof(int) * g_objectCount)) == NULL))
+    {
+        free(search);
+        g_lastError = LDAP_NO_MEMORY;
+        return NULL;
+    }
+    RecordAttributes(attributeList, search->requested, ARRAYSIZE(search->requested));
+
+    // The server evaluates the filter, so only matching objects are sent
+    for (int i = 0; i < g_objectCount; i++)
+    {
+        const wchar_t* p = searchFilter;
+        BOOL match = FALSE;
+        if (!EvaluateFilter(&p, i, &match) || *p != L'\0')
+        {
+            free(search->matches);
+            free(search);
+            g_lastError = LDAP_FILTER_ERROR;
+            return NULL;
+        }
+        if (match)
+            search->matches[search->count++] = i;
+    }
+    g_openSearches++;
+    return search;
+}
+
+ULONG ldap_get_next_page_s(LDAP* ld, PLDAPSearch searchHandle, struct l_timeval* timeout,
+                           ULONG pageSize, ULONG* totalCount, LDAPMessage** results)
+{
+    (void)ld;
+    (void)timeout;
+    *results = NULL;
+    g_lastPageSize = pageSize;
+
+    if (++searchHandle->pages == g_failPage)
+        return g_failStatus;
+    if (searchHandle->position >= searchHandle->count)
+        return LDAP_NO_RESULTS_RETURNED;
+
+    int count = searchHandle->count - searchHandle->position;
+    if (count > (int)pageSize)
+        count = (int)pageSize;
+
+    *results = NewResult(searchHandle->matches + searchHandle->position, count, searchHandle->requested);
+    if (*results == NULL)
+        return LDAP_NO_MEMORY;
+    searchHandle->position += count;
+    *totalCount = g_reportEstimate ? (ULONG)searchHandle->count : 0;
+    g_pagesServed++;
+    return LDAP_SUCCESS;
+}
+
+ULONG ldap_search_abandon_page(LDAP* ld, PLDAPSearch searchBlock)
+{
+    (void)ld;
+    free(searchBlock->matches);
+    free(searchBlock);
+    g_openSearches--;
+    return LDAP_SUCCESS;
+}
+
+ULONG LdapGetLastError(void)
+{
+    return g_lastError;
+}
+
+ULONG LdapMapErrorToWin32(ULONG ldapError)
+{
+    switch (ldapError)
+    {
+        case LDAP_SUCCESS:              return ERROR_SUCCESS;
+        case LDAP_INVALID_CREDENTIALS:  return ERROR_LOGON_FAILURE;
+        case LDAP_SERVER_DOWN:          return ERROR_BAD_NETPATH;
+        case LDAP_TIMEOUT:              return ERROR_TIMEOUT;
+        case LDAP_NO_MEMORY:            return ERROR_NOT_ENOUGH_MEMORY;
+        default:                        return ERROR_INVALID_PARAMETER;
+    }
+}
+
+/*
+ * Helpers
+ */
+
+// Collects every page, as the scan job's merge would
+typedef struct {
+    ComputerInfo* computers;
+    int count;
+    int capacity;
+    int pages;
+    int stopAfterPages;         // Return FALSE after this many pages (0 = never)
+} Collected;
+
+static BOOL CollectPage(const ComputerInfo* batch, int count, void* context)
+{
+    Collected* collected = (Collected*)context;
+    if (collected->count + count > collected->capacity)
+    {
+        int newCapacity = (collected->capacity > 0) ? collected->capacity * 2 : 1024;
+        while (newCapacity < collected->count + count)
+            newCapacity *= 2;
+        ComputerInfo* grown = (ComputerInfo*)realloc(collected->computers, sizeof(ComputerInfo) * newCapacity);
+        if (grown == NULL)
+            return FALSE;
+        collected->computers = grown;
+        collected->capacity = newCapacity;
+    }
+    memcpy(collected->computers + collected->count, batch, sizeof(ComputerInfo) * count);
+    collected->count += count;
+    collected->pages++;
+    return collected->stopAfterPages == 0 || collected->pages < collected->stopAfterPages;
+}
+
+static BOOL Enumerate(const wchar_t* domain, BOOL workstations, BOOL servers, BOOL domainControllers,
+                      Collected* collected, ScanSummary* summary)
+{
+    int stopAfterPages = collected->stopAfterPages;
+    memset(collected, 0, sizeof(Collected));
+    collected->stopAfterPages = stopAfterPages;
+    return EnumerateDirectoryComputers(domain, workstations, servers, domainControllers,
+                                       CollectPage, collected, summary);
+}
+
+// Everything the fake handed out has been given back
+static void CheckNothingOpen(void)
+{
+    CHECK_INT(g_openConnections, 0);
+    CHECK_INT(g_openSearches, 0);
+    CHECK_INT(g_openMessages, 0);
+    CHECK_INT(g_openValues, 0);
+}
+
+static const ComputerInfo* FindComputer(const Collected* collected, const wchar_t* name)
+{
+    for (int i = 0; i < collected->count; i++)
+    {
+        if (_wcsicmp(collected->computers[i].name, name) == 0)
+            return &collected->computers[i];
+    }
+    return NULL;
+}
+
+/*
+ * Tests
+ */
+
+static void TestAttributes(void)
+{
+    ResetDirectory();
+    AddObject(L"computer", L"WS01", L"ws01.corp.example", L"Reception", L"Windows 11 Pro", L"133480000000000000", L"4096");
+    AddObject(L"computer", L"SRV02", L"", L"", L"Windows Server 2019 Standard", L"", L"4096");
+    AddObject(L"computer", L"", L"", L"Nameless", L"Windows 10 Pro", L"", L"4096");
+    AddObject(L"computer", L"DC01", L"dc01.corp.example", L"", L"Windows Server 2022 Datacenter", L"", L"532480");
+    AddObject(L"computer", L"LAB03", L"lab03.corp.example", L"", L"", L"", L"4096");
+    AddObject(L"person", L"alice", L"", L"Not a computer", L"", L"", L"512");
+    AddObject(L"computer", L"OLD04", L"old04.corp.example", L"",
+              L"Windows Server 2008 R2 Enterprise with a very long edition name that does not fit", L"", L"4096");
+
+    Collected collected = {0};
+    ScanSummary summary;
+    CHECK(Enumerate(L"corp.example", TRUE, TRUE, TRUE, &collected, &summary));
+    CHECK(summary.complete);
+    CHECK_INT(summary.status, ERROR_SUCCESS);
+    CHECK_INT(summary.pages, 1);
+    CHECK_INT(summary.entriesReceived, 6);
+    CHECK_INT(summary.totalEntries, 6);
+    CHECK_INT(summary.computersReported, 5);
+    CHECK_INT(collected.count, 5);
+
+    // What was asked of the server
+    CHECK_WSTR(g_lastHost, L"corp.example");
+    CHECK_INT(g_lastPort, LDAP_PORT);
+    CHECK_INT(g_lastVersion, LDAP_VERSION3);
+    CHECK_INT(g_lastMethod, LDAP_AUTH_NEGOTIATE);
+    CHECK_WSTR(g_lastBaseDn, FAKE_NAMING_CONTEXT);
+    CHECK_WSTR(g_lastFilter, L"(objectCategory=computer)");
+    CHECK_WSTR(g_lastAttributes, L"dNSHostName,name,description,operatingSystem,lastLogonTimestamp");
+    CHECK_INT(g_lastPageSize, LDAP_SCAN_PAGE_SIZE);
+
+    const ComputerInfo* computer = FindComputer(&collected, L"ws01.corp.example");
+    CHECK(computer != NULL);
+    if (computer != NULL)
+    {
+        CHECK_WSTR(computer->comment, L"Reception");
+        CHECK_WSTR(computer->operatingSystem, L"Windows 11 Pro");
+        CHECK(computer->lastLogon == 133480000000000000ULL);
+    }
+
+    // No DNS name: the short name; no description: the operating system
+    computer = FindComputer(&collected, L"SRV02");
+    CHECK(computer != NULL);
+    if (computer != NULL)
+    {
+        CHECK_WSTR(computer->comment, L"Windows Server 2019 Standard");
+        CHECK(computer->lastLogon == 0);
+    }
+
+    computer = FindComputer(&collected, L"lab03.corp.example");
+    CHECK(computer != NULL);
+    if (computer != NULL)
+    {
+        CHECK_WSTR(computer->comment, L"Computer");
+        CHECK_WSTR(computer->operatingSystem, L"");
+    }
+
+    computer = FindComputer(&collected, L"old04.corp.example");
+    CHECK(computer != NULL);
+    if (computer != NULL)
+        CHECK_INT(wcslen(computer->operatingSystem), 63);
+
+    CHECK(FindComputer(&collected, L"alice") == NULL);
+    CheckNothingOpen();
+    free(collected.computers);
+}
+
+static void TestTypeFilters(void)
+{
+    // 60 workstations, 20 servers, 10 DCs and 10 users per 100
+    CHECK(GenerateDirectory(1000));
+
+    for (int mask = 1; mask < 8; mask++)
+    {
+        BOOL workstations = (mask & 1) != 0, servers = (mask & 2) != 0, dcs = (mask & 4) != 0;
+        int expected = (workstations ? 600 : 0) + (servers ? 200 : 0) + (dcs ? 100 : 0);
+
+        Collected collected = {0};
+        ScanSummary summary;
+        CHECK(Enumerate(NULL, workstations, servers, dcs, &collected, &summary));
+        CHECK_INT(collected.count, expected);
+        CHECK_INT(summary.entriesReceived, expected);
+        CHECK(summary.complete);
+
+        BOOL typesRight = TRUE;
+        for (int i = 0; i < collected.count; i++)
+        {
+            int n = (int)wcstol(collected.computers[i].name + 2, NULL, 10);
+            int kind = n % 10;
+            BOOL wanted = (kind < 6) ? workstations : (kind < 8) ? servers : (kind == 8) ? dcs : FALSE;
+            if (!wanted)
+                typesRight = FALSE;
+        }
+        CHECK(typesRight);
+        free(collected.computers);
+    }
+
+    // The current domain is found by the client (NULL host)
+    CHECK(g_lastHostNull);
+
+    // Server OS names are matched as substrings, ignoring case
+    ResetDirectory();
+    AddObject(L"computer", L"HV01", L"", L"", L"Hyper-V server 2019", L"", L"4096");
+    AddObject(L"computer", L"WS02", L"", L"", L"Windows 10 Enterprise", L"", L"4096");
+    Collected collected = {0};
+    CHECK(Enumerate(NULL, FALSE, TRUE, FALSE, &collected, NULL));
+    CHECK_INT(collected.count, 1);
+    CHECK(FindComputer(&collected, L"HV01") != NULL);
+    free(collected.computers);
+    CheckNothingOpen();
+}
+
+static void TestPaging(void)
+{
+    // 1111 computers in three pages of up to LDAP_SCAN_PAGE_SIZE
+    CHECK(GenerateDirectory(1234));
+    Collected collected = {0};
+    ScanSummary summary;
+    CHECK(Enumerate(NULL, TRUE, TRUE, TRUE, &collected, &summary));
+    CHECK_INT(summary.pages, 3);
+    CHECK_INT(collected.pages, 3);
+    CHECK_INT(collected.count, 1111);
+    CHECK_INT(summary.totalEntries, 1111);
+    CHECK(summary.complete);
+
+    // Pages arrive in directory order
+    CHECK_WSTR(collected.computers[0].name, L"pc000000.corp.example");
+    CHECK_WSTR(collected.computers[1110].name, L"pc001233.corp.example");
+    free(collected.computers);
+
+    // A server that reports the size up front
+    g_reportEstimate = TRUE;
+    CHECK(Enumerate(NULL, TRUE, FALSE, FALSE, &collected, &summary));
+    CHECK_INT(summary.totalEntries, 742);
+    CHECK_INT(summary.entriesReceived, 742);
+    CHECK(summary.complete);
+    free(collected.computers);
+
+    // Stopping after the first page abandons the search
+    g_reportEstimate = FALSE;
+    g_pagesServed = 0;
+    collected.stopAfterPages = 1;
+    CHECK(Enumerate(NULL, TRUE, TRUE, TRUE, &collected, &summary));
+    CHECK_INT(summary.pages, 1);
+    CHECK_INT(g_pagesServed, 1);
+    CHECK_INT(collected.count, LDAP_SCAN_PAGE_SIZE);
+    CHECK(!summary.complete);
+    CHECK_INT(summary.status, ERROR_SUCCESS);
+    free(collected.computers);
+
+    // An empty directory is a complete, empty result
+    ResetDirectory();
+    collected.stopAfterPages = 0;
+    CHECK(Enumerate(NULL, TRUE, TRUE, TRUE, &collected, &summary));
+    CHECK_INT(collected.count, 0);
+    CHECK_INT(summary.pages, 0);
+    CHECK(summary.complete);
+    CheckNothingOpen();
+}
+
+static void TestErrors(void)
+{
+    Collected collected = {0};
+    ScanSummary summary;
+
+    // No server for the domain
+    CHECK(GenerateDirectory(100));
+    CHECK(!Enumerate(L"elsewhere.example", TRUE, TRUE, TRUE, &collected, &summary));
+    CHECK_INT(summary.status, ERROR_BAD_NETPATH);
+    CHECK_INT(collected.count, 0);
+    CheckNothingOpen();
+
+    // Bind refused
+    g_bindStatus = LDAP_INVALID_CREDENTIALS;
+    CHECK(!Enumerate(NULL, TRUE, TRUE, TRUE, &collected, &summary));
+    CHECK_INT(summary.status, ERROR_LOGON_FAILURE);
+    CheckNothingOpen();
+    g_bindStatus = LDAP_SUCCESS;
+
+    // RootDSE without a naming context
+    g_noNamingContext = TRUE;
+    CHECK(!Enumerate(NULL, TRUE, TRUE, TRUE, &collected, &summary));
+    CHECK(summary.status != ERROR_SUCCESS);
+    CheckNothingOpen();
+    g_noNamingContext = FALSE;
+
+    // First page fails: nothing found
+    g_failPage = 1;
+    g_failStatus = LDAP_TIMEOUT;
+    CHECK(!Enumerate(NULL, TRUE, TRUE, TRUE, &collected, &summary));
+    CHECK_INT(summary.status, ERROR_TIMEOUT);
+    CHECK_INT(collected.count, 0);
+    CheckNothingOpen();
+
+    // A later page fails: a partial result
+    CHECK(GenerateDirectory(1500));
+    g_failPage = 3;
+    g_failStatus = LDAP_SERVER_DOWN;
+    CHECK(Enumerate(NULL, TRUE, TRUE, TRUE, &collected, &summary));
+    CHECK_INT(summary.status, ERROR_BAD_NETPATH);
+    CHECK(!summary.complete);
+    CHECK_INT(summary.pages, 2);
+    CHECK_INT(collected.count, 2 * LDAP_SCAN_PAGE_SIZE);
+    free(collected.computers);
+    CheckNothingOpen();
+    ResetDirectory();
+}
+
+/*
+ * Benchmark
+ */
+
+static void BenchEnumerate(int count)
+{
+    char label[96];
+    if (!GenerateDirectory(count))
+        return;
+
+    printf("%d directory objects\n", count);
+    for (int run = 0; run < 3; run++)
+    {
+        BOOL workstations = (run != 1), servers = (run != 2), dcs = (run != 2);
+        static const char* const names[] = { "all computers", "servers and DCs", "workstations" };
+
+        Collected collected = {0};
+        ScanSummary summary;
+        double start = TestNowMs();
+        Enumerate(NULL, workstations, servers, dcs, &collected, &summary);
+        double ms = TestNowMs() - start;
+
+        snprintf(label, sizeof(label), "%s, %d found, %.0f/s", names[run], collected.count,
+                 (ms > 0.0) ? collected.count * 1000.0 / ms : 0.0);
+        TestBenchResult(label, ms);
+        free(collected.computers);
+    }
+    ResetDirectory();
+}
+
+int main(int argc, char** argv)
+{
+    TestAttributes();
+    TestTypeFilters();
+    TestPaging();
+    TestErrors();
+
+    if (TestBenchRequested(argc, argv))
+        BenchEnumerate(100000);
+
+    return TestSummary("ldapscan");
+}
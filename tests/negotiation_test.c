@@ -0,0 +1,172 @@
+/*
+ * RDP Negotiation Tests
+ *
+ * Feeds the reply parser the canned Connection Confirms the probe test's
+ * stub responders send (NLA, TLS, standard security, a negotiation
+ * failure), the other protocols a server can select, and replies that
+ * are not RDP. Every reply is also fed one byte short and byte by byte,
+ * as it may arrive from the network.
+ */
+
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#include "test.h"
+#include "negotiation.h"
+
+// Canned X.224 Connection Confirms ([MS-RDPBCGR] 2.2.1.2), as in probe_test.c
+static const BYTE g_replyNla[] = {
+    0x03, 0x00, 0x00, 0x13, 0x0E, 0xD0, 0x00, 0x00, 0x12, 0x34, 0x00,
+    0x02, 0x1F, 0x08, 0x00, 0x02, 0x00, 0x00, 0x00
+};
+static const BYTE g_replyTls[] = {
+    0x03, 0x00, 0x00, 0x13, 0x0E, 0xD0, 0x00, 0x00, 0x12, 0x34, 0x00,
+    0x02, 0x00, 0x08, 0x00, 0x01, 0x00, 0x00, 0x00
+};
+static const BYTE g_replyLegacy[] = {
+    0x03, 0x00, 0x00, 0x0B, 0x06, 0xD0, 0x00, 0x00, 0x12, 0x34, 0x00
+};
+static const BYTE g_replyFailure[] = {
+    0x03, 0x00, 0x00, 0x13, 0x0E, 0xD0, 0x00, 0x00, 0x12, 0x34, 0x00,
+    0x03, 0x00, 0x08, 0x00, 0x05, 0x00, 0x00, 0x00
+};
+static const BYTE g_replyHttp[] = "HTTP/1.1 400 Bad Request\r\n\r\n";
+
+// The other protocols, and values that use all four bytes
+static const BYTE g_replyHybridEx[] = {
+    0x03, 0x00, 0x00, 0x13, 0x0E, 0xD0, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x02, 0x00, 0x08, 0x00, 0x08, 0x00, 0x00, 0x00
+};
+static const BYTE g_replyRdstls[] = {
+    0x03, 0x00, 0x00, 0x13, 0x0E, 0xD0, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x02, 0x00, 0x08, 0x00, 0x04, 0x00, 0x00, 0x00
+};
+static const BYTE g_replyWideValue[] = {
+    0x03, 0x00, 0x00, 0x13, 0x0E, 0xD0, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x02, 0x00, 0x08, 0x00, 0x01, 0x02, 0x03, 0x84
+};
+
+// Not a Connection Confirm
+static const BYTE g_replyRequest[] = {     // The request echoed back (X.224 CR, not CC)
+    0x03, 0x00, 0x00, 0x13, 0x0E, 0xE0, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x01, 0x00, 0x08, 0x00, 0x0B, 0x00, 0x00, 0x00
+};
+static const BYTE g_replyBadIndicator[] = {    // X.224 length does not fit the TPKT length
+    0x03, 0x00, 0x00, 0x13, 0x06, 0xD0, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x02, 0x00, 0x08, 0x00, 0x02, 0x00, 0x00, 0x00
+};
+static const BYTE g_replyTooShort[] = {     // TPKT length below a bare confirm
+    0x03, 0x00, 0x00, 0x0A, 0x05, 0xD0, 0x00, 0x00, 0x00, 0x00
+};
+static const BYTE g_replyTooLong[] = {      // TPKT length past RDP_REPLY_MAX
+    0x03, 0x00, 0x01, 0x00
+};
+static const BYTE g_replyVersion[] = {      // TPKT version 2
+    0x02, 0x00, 0x00, 0x0B, 0x06, 0xD0, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+// One reply and what the parser must make of it
+typedef struct {
+    const char* name;
+    const BYTE* reply;
+    int length;
+    RdpReplyStatus status;
+    DWORD value;
+    BOOL byHeader;              // Not RDP, as the first four bytes (the TPKT header) show
+} ReplyCase;
+
+static const ReplyCase g_cases[] = {
+    { "NLA", g_replyNla, sizeof(g_replyNla), RDP_REPLY_SELECTED, RDP_PROTOCOL_HYBRID, FALSE },
+    { "TLS", g_replyTls, sizeof(g_replyTls), RDP_REPLY_SELECTED, RDP_PROTOCOL_SSL, FALSE },
+    { "standard security", g_replyLegacy, sizeof(g_replyLegacy), RDP_REPLY_SELECTED, RDP_PROTOCOL_RDP, FALSE },
+    { "failure", g_replyFailure, sizeof(g_replyFailure), RDP_REPLY_FAILED, 5, FALSE },
+    { "early auth", g_replyHybridEx, sizeof(g_replyHybridEx), RDP_REPLY_SELECTED, RDP_PROTOCOL_HYBRID_EX, FALSE },
+    { "RDSTLS", g_replyRdstls, sizeof(g_replyRdstls), RDP_REPLY_SELECTED, RDP_PROTOCOL_RDSTLS, FALSE },
+    { "four-byte value", g_replyWideValue, sizeof(g_replyWideValue), RDP_REPLY_SELECTED, 0x84030201, FALSE },
+    { "HTTP", g_replyHttp, sizeof(g_replyHttp) - 1, RDP_REPLY_NOT_RDP, 0, TRUE },
+    { "request echoed", g_replyRequest, sizeof(g_replyRequest), RDP_REPLY_NOT_RDP, 0, FALSE },
+    { "bad indicator", g_replyBadIndicator, sizeof(g_replyBadIndicator), RDP_REPLY_NOT_RDP, 0, FALSE },
+    { "too short", g_replyTooShort, sizeof(g_replyTooShort), RDP_REPLY_NOT_RDP, 0, TRUE },
+    { "too long", g_replyTooLong, sizeof(g_replyTooLong), RDP_REPLY_NOT_RDP, 0, TRUE },
+    { "TPKT version", g_replyVersion, sizeof(g_replyVersion), RDP_REPLY_NOT_RDP, 0, TRUE },
+};
+
+/*
+ * ReportCase - Name the case a check failed on
+ */
+static void ReportCase(BOOL ok, const ReplyCase* test, int length)
+{
+    if (!ok)
+        printf("    %s, %d of %d bytes\n", test->name, length, test->length);
+}
+
+static void TestReplies(void)
+{
+    for (int i = 0; i < (int)ARRAYSIZE(g_cases); i++)
+    {
+        const ReplyCase* test = &g_cases[i];
+        DWORD value = 0xFFFFFFFF;
+
+        RdpReplyStatus status = ParseRdpNegotiationReply(test->reply, test->length, &value);
+        ReportCase(CHECK_INT(status, test->status), test, test->length);
+        ReportCase(CHECK_INT(value, test->value), test, test->length);
+    }
+}
+
+/*
+ * TestPieces - Until the whole packet is in, a reply is incomplete; one
+ * that is not RDP is known as soon as its TPKT header is
+ */
+static void TestPieces(void)
+{
+    for (int i = 0; i < (int)ARRAYSIZE(g_cases); i++)
+    {
+        const ReplyCase* test = &g_cases[i];
+        BYTE buffer[64];
+
+        // Fed one more byte at a time into a buffer like the probe's
+        for (int length = 0; length < test->length; length++)
+        {
+            DWORD value = 0xFFFFFFFF;
+            memcpy(buffer, test->reply, length);
+            RdpReplyStatus status = ParseRdpNegotiationReply(buffer, length, &value);
+
+            RdpReplyStatus expected = (test->byHeader && length >= 4) ? RDP_REPLY_NOT_RDP : RDP_REPLY_INCOMPLETE;
+            ReportCase(CHECK_INT(status, expected), test, length);
+            ReportCase(CHECK_INT(value, 0), test, length);
+        }
+    }
+}
+
+/*
+ * TestRequest - The request is what mstsc sends: a Connection Request
+ * offering TLS, CredSSP and CredSSP with early user authorization
+ */
+static void TestRequest(void)
+{
+    static const BYTE expected[] = {
+        0x03, 0x00, 0x00, 0x13, 0x0E, 0xE0, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x01, 0x00, 0x08, 0x00, 0x0B, 0x00, 0x00, 0x00
+    };
+    int length = 0;
+    const BYTE* request = GetRdpNegotiationRequest(&length);
+
+    CHECK_INT(length, sizeof(expected));
+    CHECK(length == (int)sizeof(expected) && memcmp(request, expected, sizeof(expected)) == 0);
+
+    // A request is not a confirm, so a peer echoing it is not taken for a server
+    DWORD value;
+    CHECK_INT(ParseRdpNegotiationReply(request, length, &value), RDP_REPLY_NOT_RDP);
+}
+
+int main(int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+
+    TestReplies();
+    TestPieces();
+    TestRequest();
+
+    return TestSummary("negotiation");
+}
@@ -0,0 +1,690 @@
+/*
+ * Reachability Probe Tests
+ *
+ * Probes listeners this test opens on 127.0.0.1: reachable hosts, a
+ * closed port, probes that time out, the concurrency window, cancelling
+ * and the stored results. Stub responders replay canned replies to the
+ * RDP Negotiation Request - NLA, TLS, standard security, a negotiation
+ * failure, a split reply, something that is not RDP, silence and a
+ * closed connection. The benchmark probes 10k connects to loopback
+ * listeners at several concurrency levels, with and without negotiation.
+ *
+ * Off Windows the probes run on the poll() engine in compat/.
+ */
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "probe.h"
+
+// The resolver reads these; the probes here use its defaults
+DWORD GetSettingDWORD(const wchar_t* valueName, DWORD defaultValue)
+{
+    (void)valueName;
+    return defaultValue;
+}
+
+BOOL GetSettingString(const wchar_t* valueName, wchar_t* buffer, DWORD bufferLen)
+{
+    (void)valueName;
+    (void)buffer;
+    (void)bufferLen;
+    return FALSE;
+}
+
+/*
+ * Loopback listeners
+ */
+
+// What a listener does with a connection
+typedef enum {
+    LISTEN_DROP,                // Close it at once
+    LISTEN_REPLY,               // Read the request, send the canned reply
+    LISTEN_SILENT,              // Read the request, say nothing until the probe gives up
+    LISTEN_CLOSE                // Read the request, close without a reply
+} ListenMode;
+
+// A listening socket on 127.0.0.1 with a thread that accepts connections one at a time
+typedef struct {
+    SOCKET socket;
+    USHORT port;
+    HANDLE thread;
+    volatile LONG accepted;
+    ListenMode mode;
+    const BYTE* reply;
+    int replyLength;
+    int splitAt;                // Send the reply in two parts split here (0 = in one)
+    DWORD splitDelayMs;         // Pause between the parts
+    volatile LONG requestsRight;    // Requests that matched the expected X.224 request
+} Listener;
+
+// What mstsc (and the probe) sends first: X.224 CR with RDP_NEG_REQ for TLS and CredSSP
+static const BYTE g_expectedRequest[] = {
+    0x03, 0x00, 0x00, 0x13, 0x0E, 0xE0, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x01, 0x00, 0x08, 0x00, 0x0B, 0x00, 0x00, 0x00
+};
+
+// Read until the peer closes (the probe resets the connection when done)
+static void DrainUntilClosed(SOCKET client)
+{
+    char buffer[64];
+    while (recv(client, buffer, sizeof(buffer), 0) > 0)
+        ;
+}
+
+static void ServeConnection(Listener* listener, SOCKET client)
+{
+    BYTE request[sizeof(g_expectedRequest)];
+    int received = 0;
+
+    while (received < (int)sizeof(request))
+    {
+        int n = recv(client, (char*)request + received, (int)sizeof(request) - received, 0);
+        if (n <= 0)
+            return;
+        received += n;
+    }
+    if (memcmp(request, g_expectedRequest, sizeof(request)) == 0)
+        InterlockedIncrement(&listener->requestsRight);
+
+    if (listener->mode == LISTEN_REPLY)
+    {
+        int first = (listener->splitAt > 0) ? listener->splitAt : listener->replyLength;
+        send(client, (const char*)listener->reply, first, 0);
+        if (first < listener->replyLength)
+        {
+            Sleep(listener->splitDelayMs);
+            send(client, (const char*)listener->reply + first, listener->replyLength - first, 0);
+        }
+    }
+    if (listener->mode != LISTEN_CLOSE)
+        DrainUntilClosed(client);
+}
+
+static DWORD WINAPI ListenerThread(LPVOID param)
+{
+    Listener* listener = (Listener*)param;
+
+    // Ends when StopListener closes the socket
+    for (;;)
+    {
+        SOCKET client = accept(listener->socket, NULL, NULL);
+        if (client == INVALID_SOCKET)
+            break;
+
+        InterlockedIncrement(&listener->accepted);
+        if (listener->mode == LISTEN_DROP)
+        {
+            struct linger noLinger = { 1, 0 };
+            setsockopt(client, SOL_SOCKET, SO_LINGER, (const char*)&noLinger, sizeof(noLinger));
+        }
+        else
+            ServeConnection(listener, client);
+        closesocket(client);
+    }
+    return 0;
+}
+
+// Bind a socket to 127.0.0.1 on a port the system picks; returns the port (0 on failure)
+static USHORT BindLoopback(SOCKET s)
+{
+    SOCKADDR_IN address = {0};
+    int addressLength = sizeof(address);
+
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(s, (const SOCKADDR*)&address, sizeof(address)) != 0 ||
+        getsockname(s, (SOCKADDR*)&address, &addressLength) != 0)
+        return 0;
+    return ntohs(address.sin_port);
+}
+
+static BOOL StartListener(Listener* listener, ListenMode mode, const BYTE* reply, int replyLength)
+{
+    memset(listener, 0, sizeof(Listener));
+    listener->mode = mode;
+    listener->reply = reply;
+    listener->replyLength = replyLength;
+    listener->socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener->socket == INVALID_SOCKET)
+        return FALSE;
+
+    listener->port = BindLoopback(listener->socket);
+    if (listener->port == 0 || listen(listener->socket, SOMAXCONN) != 0)
+    {
+        closesocket(listener->socket);
+        return FALSE;
+    }
+
+    listener->thread = CreateThread(NULL, 0, ListenerThread, listener, 0, NULL);
+    if (listener->thread == NULL)
+    {
+        closesocket(listener->socket);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void StopListener(Listener* listener)
+{
+    closesocket(listener->socket);
+    WaitForSingleObject(listener->thread, INFINITE);
+    CloseHandle(listener->thread);
+}
+
+// A loopback port nothing listens on (bound, then released)
+static USHORT ClosedPort(void)
+{
+    SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    USHORT port = (s != INVALID_SOCKET) ? BindLoopback(s) : 0;
+    if (s != INVALID_SOCKET)
+        closesocket(s);
+    return port;
+}
+
+/*
+ * Helpers
+ */
+
+#define LISTENER_COUNT 4
+
+static Listener g_listeners[LISTENER_COUNT];
+
+// count hostnames "127.0.0.1:<port>" spread over the listeners (free with FreeHostnames)
+static wchar_t** MakeHostnames(int count)
+{
+    wchar_t** hostnames = (wchar_t**)calloc(count, sizeof(wchar_t*));
+    for (int i = 0; hostnames != NULL && i < count; i++)
+    {
+        hostnames[i] = (wchar_t*)malloc(sizeof(wchar_t) * 32);
+        if (hostnames[i] != NULL)
+            swprintf_s(hostnames[i], 32, L"127.0.0.1:%u", (unsigned int)g_listeners[i % LISTENER_COUNT].port);
+    }
+    return hostnames;
+}
+
+static void FreeHostnames(wchar_t** hostnames, int count)
+{
+    for (int i = 0; hostnames != NULL && i < count; i++)
+        free(hostnames[i]);
+    free(hostnames);
+}
+
+static LONG TotalAccepted(void)
+{
+    LONG total = 0;
+    for (int i = 0; i < LISTENER_COUNT; i++)
+        total += g_listeners[i].accepted;
+    return total;
+}
+
+// Wait until the listeners have accepted every connection still queued
+// for them (probes abandoned by an earlier run may be in their backlog)
+static LONG SettledAccepted(void)
+{
+    LONG before, after = TotalAccepted();
+    do
+    {
+        before = after;
+        Sleep(50);
+        after = TotalAccepted();
+    } while (after != before);
+    return after;
+}
+
+/*
+ * Tests
+ */
+
+static void TestReachable(void)
+{
+    const int count = 200;
+    wchar_t** hostnames = MakeHostnames(count);
+    ProbeResult* results = (ProbeResult*)calloc(count, sizeof(ProbeResult));
+    if (hostnames == NULL || results == NULL)
+    {
+        CHECK(!"out of memory");
+        return;
+    }
+
+    ClearProbeResults();
+    ProbeOptions options = { 0, 16, 2000, FALSE };
+    CHECK(ProbeHosts((const wchar_t* const*)hostnames, count, &options, results, NULL));
+
+    int reachable = 0;
+    BOOL timesRight = TRUE;
+    for (int i = 0; i < count; i++)
+    {
+        if (results[i].reachable && results[i].error == 0)
+            reachable++;
+        if (results[i].rttMs < 0.0 || results[i].rttMs > 2000.0 ||
+            (results[i].checkedAt.dwLowDateTime == 0 && results[i].checkedAt.dwHighDateTime == 0))
+            timesRight = FALSE;
+    }
+    CHECK_INT(reachable, count);
+    CHECK(timesRight);
+    CHECK_WSTR(results[5].hostname, hostnames[5]);
+    CHECK_INT(results[5].port, g_listeners[5 % LISTENER_COUNT].port);
+    CHECK(!results[5].rdp.attempted);
+
+    // Stored by hostname, as given
+    ProbeResult stored;
+    CHECK(GetProbeResult(hostnames[1], &stored));
+    CHECK(stored.reachable);
+    CHECK_INT(stored.port, g_listeners[1].port);
+
+    ClearProbeResults();
+    CHECK(!GetProbeResult(hostnames[1], &stored));
+
+    free(results);
+    FreeHostnames(hostnames, count);
+}
+
+static void TestUnreachable(void)
+{
+    USHORT closed = ClosedPort();
+    wchar_t refusedHost[32], badPort[] = L"127.0.0.1:99999";
+    swprintf_s(refusedHost, ARRAYSIZE(refusedHost), L"127.0.0.1:%u", (unsigned int)closed);
+    CHECK(closed != 0);
+
+    // Refused (Windows retries a loopback connect for about a second first)
+    const wchar_t* hostnames[] = { refusedHost, badPort };
+    ProbeResult results[2];
+    ProbeOptions options = { 0, 4, 5000, FALSE };
+    CHECK(ProbeHosts(hostnames, 2, &options, results, NULL));
+    CHECK(!results[0].reachable);
+    CHECK_INT(results[0].error, WSAECONNREFUSED);
+    CHECK(!results[1].reachable);
+    CHECK_INT(results[1].error, WSAHOST_NOT_FOUND);
+
+    // The same connect with a short timeout is abandoned at its deadline
+    options.timeoutMs = 200;
+    double start = TestNowMs();
+    CHECK(ProbeHosts(hostnames, 1, &options, results, NULL));
+    double ms = TestNowMs() - start;
+    CHECK(!results[0].reachable);
+    CHECK(results[0].error == WSAETIMEDOUT || results[0].error == WSAECONNREFUSED);
+    CHECK(ms < 1000.0);
+
+    ProbeResult stored;
+    CHECK(GetProbeResult(refusedHost, &stored));
+    CHECK(!stored.reachable);
+}
+
+/*
+ * Concurrency window, through the engine
+ */
+
+typedef struct {
+    int targets;                // Targets to hand out
+    int started;
+    int finished;
+    int reachable;
+    int maxInFlight;            // Most probes started and not finished when next() was called
+    int ticks;
+    int stopAfterTicks;         // tick() returns FALSE on this tick (0 = never)
+} WindowContext;
+
+static BOOL WindowNext(void* context, ProbeTarget* target)
+{
+    WindowContext* window = (WindowContext*)context;
+    if (window->started >= window->targets)
+        return FALSE;
+
+    int inFlight = window->started - window->finished;
+    if (inFlight > window->maxInFlight)
+        window->maxInFlight = inFlight;
+
+    SOCKADDR_IN address = {0};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(g_listeners[window->started % LISTENER_COUNT].port);
+
+    memset(target, 0, sizeof(ProbeTarget));
+    memcpy(target->address, &address, sizeof(address));
+    target->addressLength = sizeof(address);
+    target->port = ntohs(address.sin_port);
+    target->index = window->started++;
+    return TRUE;
+}
+
+static void WindowDone(void* context, const ProbeTarget* target, BOOL reachable, DWORD error, double rttMs,
+                       const RdpNegotiation* rdp)
+{
+    WindowContext* window = (WindowContext*)context;
+    (void)target;
+    (void)error;
+    (void)rttMs;
+    (void)rdp;
+    window->finished++;
+    if (reachable)
+        window->reachable++;
+}
+
+static BOOL WindowTick(void* context, int* windowSize)
+{
+    WindowContext* window = (WindowContext*)context;
+    (void)windowSize;
+    window->ticks++;
+    return window->stopAfterTicks == 0 || window->ticks < window->stopAfterTicks;
+}
+
+static void TestWindow(void)
+{
+    // Never more than the window in flight, whatever maxWindow allows
+    WindowContext context = { .targets = 2000 };
+    ProbeEngine engine = {0};
+    engine.next = WindowNext;
+    engine.done = WindowDone;
+    engine.context = &context;
+    engine.maxWindow = 64;
+    engine.window = 8;
+    engine.timeoutMs = 2000;
+    CHECK(RunProbeEngine(&engine));
+    CHECK_INT(context.started, 2000);
+    CHECK_INT(context.finished, 2000);
+    CHECK_INT(context.reachable, 2000);
+    CHECK(context.maxInFlight < 8);
+
+    // tick() stopping the run: every target taken is still reported
+    memset(&context, 0, sizeof(context));
+    context.targets = 1000000;
+    context.stopAfterTicks = 2;
+    engine.tick = WindowTick;
+    engine.window = 0;
+    double start = TestNowMs();
+    CHECK(RunProbeEngine(&engine));
+    CHECK(TestNowMs() - start < 2000.0);
+    CHECK_INT(context.ticks, 2);
+    CHECK(context.started < context.targets);
+    CHECK_INT(context.finished, context.started);
+}
+
+static void TestCancel(void)
+{
+    const int count = 50;
+    wchar_t** hostnames = MakeHostnames(count);
+    ProbeResult* results = (ProbeResult*)calloc(count, sizeof(ProbeResult));
+    if (hostnames == NULL || results == NULL)
+    {
+        CHECK(!"out of memory");
+        return;
+    }
+
+    // Cancelled before it starts: every host reads as cancelled and nothing is stored
+    ClearProbeResults();
+    volatile LONG cancel = 1;
+    LONG acceptedBefore = SettledAccepted();
+    CHECK(ProbeHosts((const wchar_t* const*)hostnames, count, NULL, results, &cancel));
+
+    int cancelled = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (!results[i].reachable && results[i].error == WSA_OPERATION_ABORTED)
+            cancelled++;
+    }
+    CHECK_INT(cancelled, count);
+    ProbeResult stored;
+    CHECK(!GetProbeResult(hostnames[0], &stored));
+    Sleep(100);
+    CHECK_INT(TotalAccepted(), acceptedBefore);
+
+    // Freeing a background job that is still probing cancels it and waits
+    ProbeJob* job = StartProbeJob((const wchar_t* const*)hostnames, count, NULL, NULL);
+    CHECK(job != NULL);
+    if (job != NULL)
+        FreeProbeJob(job);
+
+    free(results);
+    FreeHostnames(hostnames, count);
+}
+
+/*
+ * RDP negotiation against stub responders
+ */
+
+// Canned X.224 Connection Confirms ([MS-RDPBCGR] 2.2.1.2)
+static const BYTE g_replyNla[] = {
+    0x03, 0x00, 0x00, 0x13, 0x0E, 0xD0, 0x00, 0x00, 0x12, 0x34, 0x00,
+    0x02, 0x1F, 0x08, 0x00, 0x02, 0x00, 0x00, 0x00
+};
+static const BYTE g_replyTls[] = {
+    0x03, 0x00, 0x00, 0x13, 0x0E, 0xD0, 0x00, 0x00, 0x12, 0x34, 0x00,
+    0x02, 0x00, 0x08, 0x00, 0x01, 0x00, 0x00, 0x00
+};
+static const BYTE g_replyLegacy[] = {
+    0x03, 0x00, 0x00, 0x0B, 0x06, 0xD0, 0x00, 0x00, 0x12, 0x34, 0x00
+};
+static const BYTE g_replyFailure[] = {
+    0x03, 0x00, 0x00, 0x13, 0x0E, 0xD0, 0x00, 0x00, 0x12, 0x34, 0x00,
+    0x03, 0x00, 0x08, 0x00, 0x05, 0x00, 0x00, 0x00
+};
+static const BYTE g_replyHttp[] = "HTTP/1.1 400 Bad Request\r\n\r\n";
+
+// One stub responder and what the probe should make of it
+typedef struct {
+    ListenMode mode;
+    const BYTE* reply;
+    int replyLength;
+    int splitAt;
+    DWORD splitDelayMs;
+    BOOL answered;
+    BOOL refused;
+    DWORD protocol;
+    DWORD error;
+    const wchar_t* description;
+} StubCase;
+
+static const StubCase g_stubCases[] = {
+    { LISTEN_REPLY, g_replyNla, sizeof(g_replyNla), 0, 0, TRUE, FALSE, RDP_PROTOCOL_HYBRID, 0, L"NLA (CredSSP)" },
+    { LISTEN_REPLY, g_replyTls, sizeof(g_replyTls), 0, 0, TRUE, FALSE, RDP_PROTOCOL_SSL, 0, L"TLS" },
+    { LISTEN_REPLY, g_replyLegacy, sizeof(g_replyLegacy), 0, 0, TRUE, FALSE, RDP_PROTOCOL_RDP, 0,
+      L"standard RDP security (no TLS)" },
+    { LISTEN_REPLY, g_replyFailure, sizeof(g_replyFailure), 0, 0, TRUE, TRUE, 5, 0, L"refused: server requires NLA" },
+    { LISTEN_REPLY, g_replyTls, sizeof(g_replyTls), 6, 150, TRUE, FALSE, RDP_PROTOCOL_SSL, 0, L"TLS" },
+    { LISTEN_REPLY, g_replyHttp, sizeof(g_replyHttp) - 1, 0, 0, FALSE, FALSE, 0, ERROR_INVALID_DATA, L"not an RDP server" },
+    { LISTEN_SILENT, NULL, 0, 0, 0, FALSE, FALSE, 0, WSAETIMEDOUT, L"no RDP reply" },
+    { LISTEN_CLOSE, NULL, 0, 0, 0, FALSE, FALSE, 0, WSAECONNRESET, L"closed without an RDP reply" },
+};
+
+#define STUB_COUNT ((int)ARRAYSIZE(g_stubCases))
+
+static Listener g_stubs[STUB_COUNT];
+
+static BOOL StartStubs(void)
+{
+    for (int i = 0; i < STUB_COUNT; i++)
+    {
+        const StubCase* stub = &g_stubCases[i];
+        if (!StartListener(&g_stubs[i], stub->mode, stub->reply, stub->replyLength))
+        {
+            while (--i >= 0)
+                StopListener(&g_stubs[i]);
+            return FALSE;
+        }
+        g_stubs[i].splitAt = stub->splitAt;
+        g_stubs[i].splitDelayMs = stub->splitDelayMs;
+    }
+    return TRUE;
+}
+
+static void TestNegotiation(void)
+{
+    wchar_t names[STUB_COUNT][32];
+    const wchar_t* hostnames[STUB_COUNT];
+    ProbeResult results[STUB_COUNT];
+
+    for (int i = 0; i < STUB_COUNT; i++)
+    {
+        swprintf_s(names[i], 32, L"127.0.0.1:%u", (unsigned int)g_stubs[i].port);
+        hostnames[i] = names[i];
+    }
+
+    ProbeOptions options = { 0, STUB_COUNT, 1000, TRUE };
+    CHECK(ProbeHosts(hostnames, STUB_COUNT, &options, results, NULL));
+
+    for (int i = 0; i < STUB_COUNT; i++)
+    {
+        const StubCase* stub = &g_stubCases[i];
+        const RdpNegotiation* rdp = &results[i].rdp;
+
+        // The connect itself worked everywhere; the request was the one mstsc sends
+        CHECK(results[i].reachable);
+        CHECK(rdp->attempted);
+        CHECK_INT(g_stubs[i].requestsRight, 1);
+
+        CHECK_INT(rdp->answered, stub->answered);
+        CHECK_INT(rdp->refused, stub->refused);
+        if (stub->answered)
+        {
+            CHECK_INT(rdp->protocol, stub->protocol);
+            CHECK(rdp->handshakeMs >= 0.0 && rdp->handshakeMs < 1000.0);
+        }
+        else
+            CHECK_INT(rdp->error, stub->error);
+        CHECK_WSTR(DescribeRdpNegotiation(rdp), stub->description);
+    }
+
+    // The split reply was put together, and its time includes the pause
+    CHECK(results[4].rdp.handshakeMs >= 100.0);
+
+    // Stored with the host
+    ProbeResult stored;
+    CHECK(GetProbeResult(hostnames[0], &stored));
+    CHECK(stored.rdp.answered);
+    CHECK_INT(stored.rdp.protocol, RDP_PROTOCOL_HYBRID);
+
+    // Without negotiation nothing is sent
+    options.negotiate = FALSE;
+    CHECK(ProbeHosts(hostnames, 1, &options, results, NULL));
+    CHECK(results[0].reachable);
+    CHECK(!results[0].rdp.attempted);
+    CHECK_WSTR(DescribeRdpNegotiation(&results[0].rdp), L"not checked");
+    Sleep(100);
+    CHECK_INT(g_stubs[0].requestsRight, 1);
+}
+
+/*
+ * Benchmark
+ */
+
+static void BenchProbe(int count)
+{
+    char label[96];
+    wchar_t** hostnames = MakeHostnames(count);
+    ProbeResult* results = (ProbeResult*)calloc(count, sizeof(ProbeResult));
+    if (hostnames == NULL || results == NULL)
+        return;
+
+    printf("%d loopback probes\n", count);
+    int concurrency[] = { 16, 64, 256, 1024 };
+    for (int c = 0; c < (int)ARRAYSIZE(concurrency); c++)
+    {
+        ProbeOptions options = { 0, concurrency[c], 5000, FALSE };
+        double start = TestNowMs();
+        ProbeHosts((const wchar_t* const*)hostnames, count, &options, results, NULL);
+        double ms = TestNowMs() - start;
+
+        int reachable = 0;
+        double rttTotal = 0.0;
+        for (int i = 0; i < count; i++)
+        {
+            if (results[i].reachable)
+            {
+                reachable++;
+                rttTotal += results[i].rttMs;
+            }
+        }
+        snprintf(label, sizeof(label), "concurrency %d: %d reachable, mean RTT %.2f ms",
+                 concurrency[c], reachable, (reachable > 0) ? rttTotal / reachable : 0.0);
+        TestBenchResult(label, ms);
+    }
+
+    free(results);
+    FreeHostnames(hostnames, count);
+}
+
+// Connect and negotiate with one responder (it serves connections one at a time)
+static void BenchNegotiation(int count)
+{
+    char label[96];
+    wchar_t name[32];
+    const wchar_t** hostnames = (const wchar_t**)malloc(sizeof(wchar_t*) * count);
+    ProbeResult* results = (ProbeResult*)calloc(count, sizeof(ProbeResult));
+    if (hostnames == NULL || results == NULL)
+        return;
+
+    swprintf_s(name, ARRAYSIZE(name), L"127.0.0.1:%u", (unsigned int)g_stubs[0].port);
+    for (int i = 0; i < count; i++)
+        hostnames[i] = name;
+
+    printf("%d negotiating probes\n", count);
+    int concurrency[] = { 1, 16 };
+    for (int c = 0; c < (int)ARRAYSIZE(concurrency); c++)
+    {
+        ProbeOptions options = { 0, concurrency[c], 5000, TRUE };
+        double start = TestNowMs();
+        ProbeHosts(hostnames, count, &options, results, NULL);
+        double ms = TestNowMs() - start;
+
+        int answered = 0;
+        double handshakeTotal = 0.0;
+        for (int i = 0; i < count; i++)
+        {
+            if (results[i].rdp.answered)
+            {
+                answered++;
+                handshakeTotal += results[i].rdp.handshakeMs;
+            }
+        }
+        snprintf(label, sizeof(label), "concurrency %d: %d answered, mean handshake %.2f ms",
+                 concurrency[c], answered, (answered > 0) ? handshakeTotal / answered : 0.0);
+        TestBenchResult(label, ms);
+    }
+
+    free(results);
+    free(hostnames);
+}
+
+int main(int argc, char** argv)
+{
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+    {
+        printf("probe: Winsock did not start\n");
+        return 1;
+    }
+
+    int started = 0;
+    while (started < LISTENER_COUNT && StartListener(&g_listeners[started], LISTEN_DROP, NULL, 0))
+        started++;
+    CHECK_INT(started, LISTENER_COUNT);
+    BOOL stubs = StartStubs();
+    CHECK(stubs);
+
+    if (started == LISTENER_COUNT && stubs)
+    {
+        TestReachable();
+        TestUnreachable();
+        TestWindow();
+        TestCancel();
+        TestNegotiation();
+
+        if (TestBenchRequested(argc, argv))
+        {
+            BenchProbe(10000);
+            BenchNegotiation(2000);
+        }
+    }
+
+    for (int i = 0; i < started; i++)
+        StopListener(&g_listeners[i]);
+    for (int i = 0; stubs && i < STUB_COUNT; i++)
+        StopListener(&g_stubs[i]);
+    WSACleanup();
+    return TestSummary("probe");
+}
@@ -0,0 +1,477 @@
+/*
+ * Connection Profile Tests
+ *
+ * Writes profiles.ini next to the test and resolves hosts through it:
+ * built-in values without a file, the order of the layers ([default],
+ * the inherited profiles, the host's profile, its own section, later
+ * lines within a section), hostnames in any case, repeated sections,
+ * inheritance loops and PROFILE_MAX_DEPTH, problems that are reported but
+ * still resolve, and re-reading the file when it changes. Then checks the
+ * .rdp files CreateRDPFile renders from a profile. The benchmark renders
+ * 10k hosts with their own profiles, first written, then unchanged.
+ */
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "config.h"
+#include "profiles.h"
+#include "rdp.h"
+
+/*
+ * Credentials and the host list (rdp.c links them for connecting)
+ */
+
+BOOL LoadCredentials(const wchar_t* targetName, wchar_t* username, wchar_t* password)
+{
+    (void)targetName;
+    (void)username;
+    (void)password;
+    return FALSE;
+}
+
+BOOL LoadRDPCredentials(const wchar_t* hostname, wchar_t* username, wchar_t* password)
+{
+    (void)hostname;
+    (void)username;
+    (void)password;
+    return FALSE;
+}
+
+BOOL WriteRDPCredentials(const wchar_t* hostname, const wchar_t* username, const wchar_t* password)
+{
+    (void)hostname;
+    (void)username;
+    (void)password;
+    return FALSE;
+}
+
+BOOL UpdateLastConnected(const wchar_t* hostname)
+{
+    (void)hostname;
+    return TRUE;
+}
+
+/*
+ * Helpers
+ */
+
+static BOOL GetTestFilePath(const wchar_t* name, wchar_t* path, size_t pathLen)
+{
+    wchar_t exePath[MAX_PATH];
+    if (GetModuleFileNameW(NULL, exePath, MAX_PATH) == 0)
+        return FALSE;
+    wchar_t* lastSlash = wcsrchr(exePath, L'\\');
+    if (lastSlash == NULL)
+        return FALSE;
+    *(lastSlash + 1) = L'\0';
+    return swprintf_s(path, pathLen, L"%s%s", exePath, name) >= 0;
+}
+
+// Replace profiles.ini (NULL deletes it). Every version has another size,
+// so the change is seen even where file times are coarse.
+static void WriteProfiles(const char* text)
+{
+    static int revision = 0;
+    wchar_t path[MAX_PATH];
+    FILE* file = NULL;
+
+    if (!GetTestFilePath(PROFILES_FILE_NAME, path, MAX_PATH))
+        return;
+    if (text == NULL)
+    {
+        DeleteFileW(path);
+        return;
+    }
+    CHECK(_wfopen_s(&file, path, L"wb") == 0 && file != NULL);
+    if (file == NULL)
+        return;
+    fputs(text, file);
+    revision++;
+    fputs("\r\n;", file);
+    for (int i = 0; i < revision; i++)
+        fputc(' ', file);
+    fclose(file);
+}
+
+// Resolved value of the line with this key ("" if there is none)
+static const char* Value(const RdpProfile* profile, const char* key)
+{
+    static char value[256];
+    for (int i = 0; i < RDP_SETTING_COUNT; i++)
+    {
+        const RdpProfileLine* line = &profile->lines[i];
+        if (strcmp(line->key, key) == 0 && line->valueLength < sizeof(value))
+        {
+            memcpy(value, line->value, line->valueLength);
+            value[line->valueLength] = '\0';
+            return value;
+        }
+    }
+    return "";
+}
+
+#define CHECK_VALUE(profile, key, expected) \
+    CheckValue((profile), (key), (expected), __FILE__, __LINE__)
+
+static void CheckValue(const RdpProfile* profile, const char* key, const char* expected,
+                       const char* file, int line)
+{
+    const char* actual = Value(profile, key);
+    if (!TestCheck(strcmp(actual, expected) == 0, key, file, line))
+        printf("    \"%s\" is \"%s\", expected \"%s\"\n", key, actual, expected);
+}
+
+/*
+ * Tests
+ */
+
+static void TestBuiltin(void)
+{
+    RdpProfile profile;
+    WriteProfiles(NULL);
+
+    CHECK(ResolveRdpProfile(L"anyhost", &profile));
+    CHECK_INT(profile.layers, 0);
+    CHECK_VALUE(&profile, "desktopwidth:i:", "1920");
+    CHECK_VALUE(&profile, "desktopheight:i:", "1080");
+    CHECK_VALUE(&profile, "use multimon:i:", "0");
+    CHECK_VALUE(&profile, "redirectprinters:i:", "1");
+    CHECK_VALUE(&profile, "redirectsmartcards:i:", "1");
+    CHECK_VALUE(&profile, "gatewayhostname:s:", "");
+    CHECK_INT(profile.lines[5].source, RDP_SETTING_HOSTNAME);
+    CHECK_INT(profile.lines[RDP_SETTING_COUNT - 1].source, RDP_SETTING_USERNAME);
+}
+
+static void TestOrder(void)
+{
+    RdpProfile profile;
+    WriteProfiles(
+        "; Layers from the most general to the most specific\r\n"
+        "[default]\r\n"
+        "desktopwidth:i:2560\r\n"
+        "desktopheight:i:1440\r\n"
+        "\r\n"
+        "[profile base]\r\n"
+        "use multimon:i:1\r\n"
+        "desktopwidth:i:1600\r\n"
+        "\r\n"
+        "[profile lab]\r\n"
+        "inherit=base\r\n"
+        "redirectprinters:i:0\r\n"
+        "desktopwidth:i:1680\r\n"
+        "\r\n"
+        "[profile dmz]\r\n"
+        "inherit=LAB\r\n"
+        "gatewayhostname:s:rdgw.example.com\r\n"
+        "gatewayusagemethod:i:1\r\n"
+        "\r\n"
+        "[host sql01.corp.example.com]\r\n"
+        "profile=dmz\r\n"
+        "desktopwidth:i:1280\r\n"
+        "\r\n"
+        "[host web01]\r\n"
+        "profile=base\r\n"
+        "\r\n"
+        "[host kiosk]\r\n"
+        "  redirectsmartcards:i:0  \r\n"
+        "redirectsmartcards:i:1\r\n"
+        "redirectsmartcards:i:0\r\n");
+
+    // Not listed: built-in and [default]
+    CHECK(ResolveRdpProfile(L"other", &profile));
+    CHECK_INT(profile.layers, 1);
+    CHECK_VALUE(&profile, "desktopwidth:i:", "2560");
+    CHECK_VALUE(&profile, "desktopheight:i:", "1440");
+    CHECK_VALUE(&profile, "use multimon:i:", "0");
+
+    // A profile wins over [default]
+    CHECK(ResolveRdpProfile(L"web01", &profile));
+    CHECK_INT(profile.layers, 2);
+    CHECK_VALUE(&profile, "desktopwidth:i:", "1600");
+    CHECK_VALUE(&profile, "desktopheight:i:", "1440");
+    CHECK_VALUE(&profile, "use multimon:i:", "1");
+
+    // The chain from the most inherited profile down, then the host's own section
+    CHECK(ResolveRdpProfile(L"sql01.corp.example.com", &profile));
+    CHECK_INT(profile.layers, 5);
+    CHECK_VALUE(&profile, "desktopwidth:i:", "1280");
+    CHECK_VALUE(&profile, "desktopheight:i:", "1440");
+    CHECK_VALUE(&profile, "use multimon:i:", "1");
+    CHECK_VALUE(&profile, "redirectprinters:i:", "0");
+    CHECK_VALUE(&profile, "gatewayhostname:s:", "rdgw.example.com");
+    CHECK_VALUE(&profile, "gatewayusagemethod:i:", "1");
+    CHECK_VALUE(&profile, "redirectsmartcards:i:", "1");
+
+    // Hostnames in any case
+    CHECK(ResolveRdpProfile(L"SQL01.Corp.Example.com", &profile));
+    CHECK_VALUE(&profile, "desktopwidth:i:", "1280");
+
+    // Within a section the last line wins (blanks around a line do not matter)
+    CHECK(ResolveRdpProfile(L"kiosk", &profile));
+    CHECK_INT(profile.layers, 2);
+    CHECK_VALUE(&profile, "redirectsmartcards:i:", "0");
+
+    // Only changes are stored, not whole copies of the settings
+    CHECK(profile.storageUsed < 16);
+}
+
+static void TestSections(void)
+{
+    RdpProfile profile;
+    WriteProfiles(
+        "[host app01]\r\n"
+        "desktopwidth:i:800\r\n"
+        "use multimon:i:1\r\n"
+        "[default]\r\n"
+        "DesktopHeight:i:900\r\n"
+        "[HOST app01]\r\n"
+        "desktopwidth:i:1024\r\n");
+
+    // A section that appears again replaces the earlier one; keys in any case
+    CHECK(ResolveRdpProfile(L"app01", &profile));
+    CHECK_VALUE(&profile, "desktopwidth:i:", "1024");
+    CHECK_VALUE(&profile, "use multimon:i:", "0");
+    CHECK_VALUE(&profile, "desktopheight:i:", "900");
+}
+
+static void TestInheritance(void)
+{
+    RdpProfile profile;
+
+    // A loop ends
+    WriteProfiles(
+        "[profile a]\r\n"
+        "inherit=b\r\n"
+        "desktopwidth:i:1000\r\n"
+        "[profile b]\r\n"
+        "inherit=a\r\n"
+        "desktopheight:i:700\r\n"
+        "[host looped]\r\n"
+        "profile=a\r\n");
+    ResolveRdpProfile(L"looped", &profile);
+    CHECK_VALUE(&profile, "desktopwidth:i:", "1000");
+    CHECK_VALUE(&profile, "desktopheight:i:", "700");
+    CHECK(profile.layers <= PROFILE_MAX_DEPTH + 1);
+
+    // A chain longer than PROFILE_MAX_DEPTH: the most general profiles are cut
+    char text[2048];
+    int length = 0;
+    for (int p = 0; p < PROFILE_MAX_DEPTH + 2; p++)
+    {
+        length += snprintf(text + length, sizeof(text) - length, "[profile p%d]\r\n", p);
+        if (p + 1 < PROFILE_MAX_DEPTH + 2)
+            length += snprintf(text + length, sizeof(text) - length, "inherit=p%d\r\n", p + 1);
+        length += snprintf(text + length, sizeof(text) - length, "desktopwidth:i:%d\r\n", 1000 + p);
+    }
+    length += snprintf(text + length, sizeof(text) - length,
+                       "[profile p%d]\r\nuse multimon:i:1\r\n[host deep]\r\nprofile=p0\r\n",
+                       PROFILE_MAX_DEPTH + 1);
+    WriteProfiles(text);
+    CHECK(ResolveRdpProfile(L"deep", &profile));
+    CHECK_INT(profile.layers, PROFILE_MAX_DEPTH);
+    CHECK_VALUE(&profile, "desktopwidth:i:", "1000");
+    CHECK_VALUE(&profile, "use multimon:i:", "0");
+}
+
+static void TestProblems(void)
+{
+    RdpProfile profile;
+    WriteProfiles(
+        "[default]\r\n"
+        "desktopwidth:i:wide\r\n"
+        "desktopheight:i:1200\r\n"
+        "no such setting:i:1\r\n"
+        "full address:s:elsewhere\r\n"
+        "username:s:admin\r\n"
+        "[profile ops\r\n"
+        "[something else]\r\n"
+        "desktopheight:i:1\r\n"
+        "[host jump]\r\n"
+        "profile=missing\r\n"
+        "use multimon:i:1\r\n");
+
+    // Reported, and the host still gets what could be used
+    CHECK(!ResolveRdpProfile(L"jump", &profile));
+    CHECK_VALUE(&profile, "desktopwidth:i:", "1920");
+    CHECK_VALUE(&profile, "desktopheight:i:", "1200");
+    CHECK_VALUE(&profile, "use multimon:i:", "1");
+    CHECK_INT(profile.lines[5].source, RDP_SETTING_HOSTNAME);
+    CHECK_INT(profile.lines[RDP_SETTING_COUNT - 1].source, RDP_SETTING_USERNAME);
+    CHECK_INT(profile.layers, 2);
+
+    // Fixed: clean again
+    WriteProfiles("[default]\r\ndesktopheight:i:1200\r\n");
+    CHECK(ResolveRdpProfile(L"jump", &profile));
+    CHECK_VALUE(&profile, "desktopheight:i:", "1200");
+}
+
+static void TestReload(void)
+{
+    RdpProfile profile;
+    WriteProfiles("[host tv]\r\ndesktopwidth:i:3840\r\n");
+    CHECK(ResolveRdpProfile(L"tv", &profile));
+    CHECK_VALUE(&profile, "desktopwidth:i:", "3840");
+
+    WriteProfiles("[host tv]\r\ndesktopwidth:i:1366\r\n");
+    CHECK(ResolveRdpProfile(L"tv", &profile));
+    CHECK_VALUE(&profile, "desktopwidth:i:", "1366");
+
+    WriteProfiles(NULL);
+    CHECK(ResolveRdpProfile(L"tv", &profile));
+    CHECK_VALUE(&profile, "desktopwidth:i:", "1920");
+    CHECK_INT(profile.layers, 0);
+}
+
+// Contents of a rendered .rdp file (NUL-terminated; 0 bytes if unreadable)
+static size_t ReadRdpFile(const wchar_t* path, char* buffer, size_t bufferLen)
+{
+    FILE* file = NULL;
+    if (_wfopen_s(&file, path, L"rb") != 0 || file == NULL)
+    {
+        buffer[0] = '\0';
+        return 0;
+    }
+    size_t length = fread(buffer, 1, bufferLen - 1, file);
+    buffer[length] = '\0';
+    fclose(file);
+    return length;
+}
+
+static void TestRender(void)
+{
+    wchar_t path[MAX_PATH];
+    char contents[8192];
+    WriteProfiles(
+        "[profile lab]\r\n"
+        "use multimon:i:1\r\n"
+        "redirectprinters:i:0\r\n"
+        "[host lab01]\r\n"
+        "profile=lab\r\n"
+        "desktopwidth:i:1280\r\n");
+
+    CHECK(CreateRDPFile(L"lab01", L"CORP\\admin", path, MAX_PATH));
+    size_t length = ReadRdpFile(path, contents, sizeof(contents));
+    CHECK(length > 3 && memcmp(contents, "\xEF\xBB\xBF" "screen mode id:i:2\r\n", 23) == 0);
+    CHECK(strstr(contents, "\r\nuse multimon:i:1\r\n") != NULL);
+    CHECK(strstr(contents, "\r\ndesktopwidth:i:1280\r\n") != NULL);
+    CHECK(strstr(contents, "\r\ndesktopheight:i:1080\r\n") != NULL);
+    CHECK(strstr(contents, "\r\nfull address:s:lab01\r\n") != NULL);
+    CHECK(strstr(contents, "\r\nredirectprinters:i:0\r\n") != NULL);
+    CHECK(strstr(contents, "\r\nredirectsmartcards:i:1\r\n") != NULL);
+    const char* usernameLine = "\r\nusername:s:CORP\\admin\r\n";
+    CHECK(length > strlen(usernameLine) && strcmp(contents + length - strlen(usernameLine), usernameLine) == 0);
+
+    // Every line once, in file order
+    int lines = 0;
+    for (size_t i = 0; i < length; i++)
+        lines += (contents[i] == '\n');
+    CHECK_INT(lines, RDP_SETTING_COUNT);
+
+    // Without a username the line is left out
+    CHECK(CreateRDPFile(L"lab01", NULL, path, MAX_PATH));
+    length = ReadRdpFile(path, contents, sizeof(contents));
+    CHECK(strstr(contents, "username:s:") == NULL);
+    lines = 0;
+    for (size_t i = 0; i < length; i++)
+        lines += (contents[i] == '\n');
+    CHECK_INT(lines, RDP_SETTING_COUNT - 1);
+
+    // Another host gets the built-in settings
+    CHECK(CreateRDPFile(L"other:3390", NULL, path, MAX_PATH));
+    ReadRdpFile(path, contents, sizeof(contents));
+    CHECK(strstr(contents, "\r\nuse multimon:i:0\r\n") != NULL);
+    CHECK(strstr(contents, "\r\nfull address:s:other:3390\r\n") != NULL);
+}
+
+/*
+ * Benchmark
+ */
+
+// count hosts, each with its own section on top of one of four profiles
+static void BenchRender(int count)
+{
+    char label[96];
+    wchar_t path[MAX_PATH];
+    size_t capacity = (size_t)count * 96 + 1024;
+    char* text = (char*)malloc(capacity);
+    wchar_t (*names)[32] = calloc(count, sizeof(*names));
+    if (text == NULL || names == NULL)
+    {
+        free(names);
+        free(text);
+        return;
+    }
+
+    size_t length = 0;
+    length += snprintf(text + length, capacity - length,
+                       "[default]\r\ndesktopwidth:i:2560\r\ndesktopheight:i:1440\r\n"
+                       "[profile base]\r\nredirectprinters:i:0\r\n"
+                       "[profile multi]\r\ninherit=base\r\nuse multimon:i:1\r\n"
+                       "[profile gateway]\r\ninherit=base\r\ngatewayhostname:s:rdgw.example.com\r\ngatewayusagemethod:i:1\r\n"
+                       "[profile kiosk]\r\ninherit=multi\r\nredirectsmartcards:i:0\r\n");
+    static const char* profileNames[] = { "base", "multi", "gateway", "kiosk" };
+    for (int i = 0; i < count; i++)
+    {
+        swprintf_s(names[i], 32, L"host%05d.corp.example.com", i);
+        length += snprintf(text + length, capacity - length,
+                           "[host host%05d.corp.example.com]\r\nprofile=%s\r\ndesktopwidth:i:%d\r\n",
+                           i, profileNames[i % 4], 1024 + (i % 8) * 128);
+    }
+    WriteProfiles(text);
+
+    printf("Rendering %d hosts with their own profiles\n", count);
+
+    RdpProfile profile;
+    double start = TestNowMs();
+    CHECK(ResolveRdpProfile(names[0], &profile));     // Reads profiles.ini
+    TestBenchResult("reading profiles.ini", TestNowMs() - start);
+
+    start = TestNowMs();
+    for (int i = 0; i < count; i++)
+        ResolveRdpProfile(names[i], &profile);
+    snprintf(label, sizeof(label), "ResolveRdpProfile x %d", count);
+    TestBenchResult(label, TestNowMs() - start);
+    char expected[16];
+    snprintf(expected, sizeof(expected), "%d", 1024 + ((count - 1) % 8) * 128);
+    CHECK_VALUE(&profile, "desktopwidth:i:", expected);
+
+    int rendered = 0;
+    start = TestNowMs();
+    for (int i = 0; i < count; i++)
+        rendered += CreateRDPFile(names[i], L"CORP\\admin", path, MAX_PATH) ? 1 : 0;
+    snprintf(label, sizeof(label), "CreateRDPFile x %d, files written", count);
+    TestBenchResult(label, TestNowMs() - start);
+    CHECK_INT(rendered, count);
+
+    rendered = 0;
+    start = TestNowMs();
+    for (int i = 0; i < count; i++)
+        rendered += CreateRDPFile(names[i], L"CORP\\admin", path, MAX_PATH) ? 1 : 0;
+    snprintf(label, sizeof(label), "CreateRDPFile x %d, files unchanged", count);
+    TestBenchResult(label, TestNowMs() - start);
+    CHECK_INT(rendered, count);
+
+    WriteProfiles(NULL);
+    free(names);
+    free(text);
+}
+
+int main(int argc, char** argv)
+{
+    TestBuiltin();
+    TestOrder();
+    TestSections();
+    TestInheritance();
+    TestProblems();
+    TestReload();
+    TestRender();
+
+    if (TestBenchRequested(argc, argv))
+        BenchRender(10000);
+
+    WriteProfiles(NULL);
+    return TestSummary("profiles");
+}
@@ -0,0 +1,112 @@
+/*
+ * Search Query Tests
+ *
+ * Compiles queries and runs them against a handful of hosts, with most of
+ * the cases on last: terms: absolute dates must be exactly YYYY-MM-DD and
+ * anything else is reported as an invalid date.
+ */
+
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#include "test.h"
+#include "query.h"
+
+static const Host g_hosts[] = {
+    { L"web01.corp.example", L"Web server", L"2024-01-01 09:30:00" },
+    { L"web02.corp.example", L"Web server", L"2024-01-05 23:59:59" },
+    { L"sql01.corp.example", L"SQL server", L"2023-12-31 18:00:00" },
+    { L"dc01.corp.example", L"Domain controller", L"Never" },
+};
+
+/*
+ * MatchMask - Bit i set when g_hosts[i] matches text; -1 if it does not compile
+ */
+static int MatchMask(const wchar_t* text)
+{
+    wchar_t error[256] = L"";
+    Query* query = CompileQuery(text, NULL, error, ARRAYSIZE(error));
+    if (query == NULL)
+        return -1;
+
+    int mask = 0;
+    for (int i = 0; i < (int)ARRAYSIZE(g_hosts); i++)
+    {
+        if (EvaluateQuery(query, &g_hosts[i]))
+            mask |= 1 << i;
+    }
+    FreeQuery(query);
+    return mask;
+}
+
+static void TestTextTerms(void)
+{
+    CHECK_INT(MatchMask(L"web"), 0x3);
+    CHECK_INT(MatchMask(L"host:sql*"), 0x4);
+    CHECK_INT(MatchMask(L"desc:\"domain controller\""), 0x8);
+    CHECK_INT(MatchMask(L"-server"), 0x8);
+    CHECK_INT(MatchMask(L"sql OR dc"), 0xC);
+}
+
+static void TestLastDates(void)
+{
+    CHECK_INT(MatchMask(L"last:2024-01-01"), 0x1);
+    CHECK_INT(MatchMask(L"last:=2024-01-05"), 0x2);
+    CHECK_INT(MatchMask(L"last:<2024-01-01"), 0x4);
+    CHECK_INT(MatchMask(L"last:<=2024-01-01"), 0x5);
+    CHECK_INT(MatchMask(L"last:>2024-01-01"), 0x2);
+    CHECK_INT(MatchMask(L"last:>=2024-01-01"), 0x3);
+    CHECK_INT(MatchMask(L"last:never"), 0x8);
+    CHECK_INT(MatchMask(L"last:<30d"), 0x0);
+    CHECK_INT(MatchMask(L"last:>1d"), 0x7);
+}
+
+/*
+ * TestRejectedDates - Trailing text, short fields and other near misses
+ * must fail with "Invalid date" instead of compiling to some other day
+ */
+static void TestRejectedDates(void)
+{
+    static const wchar_t* const rejected[] = {
+        L"last:<2024-01-01xyz",
+        L"last:<2024-1-5",
+        L"last:2024-01-5",
+        L"last:2024-1-05",
+        L"last:24-01-05",
+        L"last:2024-01-011",
+        L"last:2024/01/01",
+        L"last:2024-01-",
+        L"last:2024-13-01",
+        L"last:2024-00-10",
+        L"last:2024-01-32",
+        L"last:1899-12-31",
+        L"last:+2024-01-01",
+        L"last:2024-+1-01",
+    };
+
+    for (int i = 0; i < (int)ARRAYSIZE(rejected); i++)
+    {
+        wchar_t error[256] = L"";
+        Query* query = CompileQuery(rejected[i], NULL, error, ARRAYSIZE(error));
+        if (!CHECK(query == NULL))
+        {
+            printf("    accepted: %ls\n", rejected[i]);
+            FreeQuery(query);
+            continue;
+        }
+        if (!CHECK(wcsstr(error, L"Invalid date") != NULL))
+            printf("    %ls: %ls\n", rejected[i], error);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+
+    TestTextTerms();
+    TestLastDates();
+    TestRejectedDates();
+
+    return TestSummary("query");
+}
@@ -0,0 +1,612 @@
+/*
+ * Regular Expression Tests
+ *
+ * The lazy-DFA engine is checked against a small backtracking matcher
+ * written here (the classic recursive approach), first on hand-picked
+ * cases and then on generated hostnames for a set of patterns. The
+ * benchmark runs both over 100k hostnames, including a pattern that makes
+ * the backtracking matcher blow up.
+ */
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <wctype.h>
+#include "test.h"
+#include "regex.h"
+
+/*
+ * Backtracking reference matcher
+ *
+ * Same syntax and case-insensitivity as regex.c. Matching tries every way
+ * through the pattern with a continuation list, and gives up after a step
+ * budget so pathological patterns cannot hang the test.
+ */
+
+typedef enum { BT_EMPTY, BT_CHAR, BT_ANY, BT_CLASS, BT_CAT, BT_ALT, BT_REPEAT, BT_BOL, BT_EOL } BtType;
+
+#define BT_MAX_RANGES 32
+
+typedef struct BtNode {
+    BtType type;
+    wchar_t ch;                     // BT_CHAR (lowercase)
+    wchar_t low[BT_MAX_RANGES];     // BT_CLASS
+    wchar_t high[BT_MAX_RANGES];
+    int rangeCount;
+    BOOL negated;
+    int min, max;                   // BT_REPEAT (max -1 = no limit)
+    struct BtNode* a;
+    struct BtNode* b;
+} BtNode;
+
+typedef struct BtCont {
+    const BtNode* node;
+    int count;                      // Repeat continuation: iterations done
+    int start;                      // ... and where the last one started
+    const struct BtCont* next;
+} BtCont;
+
+typedef struct {
+    const wchar_t* text;
+    int length;
+    long long steps;
+    long long budget;
+    BOOL gaveUp;
+} BtMatcher;
+
+static const wchar_t* g_btPattern;
+
+static BtNode* BtNew(BtType type)
+{
+    BtNode* node = (BtNode*)calloc(1, sizeof(BtNode));
+    if (node != NULL)
+        node->type = type;
+    return node;
+}
+
+static void BtFree(BtNode* node)
+{
+    if (node == NULL)
+        return;
+    BtFree(node->a);
+    BtFree(node->b);
+    free(node);
+}
+
+static void BtAddRange(BtNode* node, wchar_t low, wchar_t high)
+{
+    if (node->rangeCount < BT_MAX_RANGES)
+    {
+        node->low[node->rangeCount] = low;
+        node->high[node->rangeCount] = high;
+        node->rangeCount++;
+    }
+}
+
+// \d \w \s as ranges; returns FALSE for the uppercase (negated) forms
+static BOOL BtAddNamed(BtNode* node, wchar_t letter)
+{
+    switch (towlower(letter))
+    {
+        case L'd':
+            BtAddRange(node, L'0', L'9');
+            break;
+        case L'w':
+            BtAddRange(node, L'0', L'9');
+            BtAddRange(node, L'A', L'Z');
+            BtAddRange(node, L'_', L'_');
+            BtAddRange(node, L'a', L'z');
+            break;
+        default:
+            BtAddRange(node, L'\t', L'\r');
+            BtAddRange(node, L' ', L' ');
+            break;
+    }
+    return iswlower(letter) != 0;
+}
+
+static wchar_t BtEscaped(wchar_t c)
+{
+    switch (c)
+    {
+        case L't': return L'\t';
+        case L'n': return L'\n';
+        case L'r': return L'\r';
+        case L'f': return L'\f';
+        case L'v': return L'\v';
+        default:   return c;
+    }
+}
+
+static BtNode* BtParseAlternation(void);
+
+static BtNode* BtParseAtom(void)
+{
+    wchar_t c = *g_btPattern++;
+    BtNode* node = NULL;
+
+    if (c == L'(')
+    {
+        if (g_btPattern[0] == L'?' && g_btPattern[1] == L':')
+            g_btPattern += 2;
+        node = BtParseAlternation();
+        if (node == NULL || *g_btPattern != L')')
+        {
+            BtFree(node);
+            return NULL;
+        }
+        g_btPattern++;
+    }
+    else if (c == L'[')
+    {
+        node = BtNew(BT_CLASS);
+        if (*g_btPattern == L'^')
+        {
+            node->negated = TRUE;
+            g_btPattern++;
+        }
+        BOOL first = TRUE;
+        while (*g_btPattern != L'\0' && (*g_btPattern != L']' || first))
+        {
+            first = FALSE;
+            wchar_t low = *g_btPattern++;
+            if (low == L'\\' && *g_btPattern != L'\0')
+            {
+                wchar_t escaped = *g_btPattern++;
+                if (wcschr(L"dwsDWS", escaped) != NULL)
+                {
+                    BtAddNamed(node, escaped);  // Only lowercase forms are used inside [] here
+                    continue;
+                }
+                low = BtEscaped(escaped);
+            }
+            wchar_t high = low;
+            if (g_btPattern[0] == L'-' && g_btPattern[1] != L']' && g_btPattern[1] != L'\0')
+            {
+                high = g_btPattern[1];
+                g_btPattern += 2;
+            }
+            BtAddRange(node, low, high);
+        }
+        if (*g_btPattern != L']')
+        {
+            BtFree(node);
+            return NULL;
+        }
+        g_btPattern++;
+    }
+    else if (c == L'\\' && *g_btPattern != L'\0')
+    {
+        wchar_t escaped = *g_btPattern++;
+        if (wcschr(L"dwsDWS", escaped) != NULL)
+        {
+            node = BtNew(BT_CLASS);
+            node->negated = !BtAddNamed(node, escaped);
+        }
+        else
+        {
+            node = BtNew(BT_CHAR);
+            node->ch = (wchar_t)towlower(BtEscaped(escaped));
+        }
+    }
+    else if (c == L'.')
+        node = BtNew(BT_ANY);
+    else if (c == L'^')
+        node = BtNew(BT_BOL);
+    else if (c == L'$')
+        node = BtNew(BT_EOL);
+    else
+    {
+        node = BtNew(BT_CHAR);
+        node->ch = (wchar_t)towlower(c);
+    }
+    return node;
+}
+
+static BtNode* BtParseRepeat(void)
+{
+    BtNode* atom = BtParseAtom();
+
+    while (atom != NULL && wcschr(L"*+?{", *g_btPattern) != NULL && *g_btPattern != L'\0')
+    {
+        int min = 0, max = -1;
+        wchar_t c = *g_btPattern++;
+        if (c == L'+')
+            min = 1;
+        else if (c == L'?')
+            max = 1;
+        else if (c == L'{')
+        {
+            min = (int)wcstol(g_btPattern, (wchar_t**)&g_btPattern, 10);
+            max = min;
+            if (*g_btPattern == L',')
+            {
+                g_btPattern++;
+                max = (*g_btPattern == L'}') ? -1 : (int)wcstol(g_btPattern, (wchar_t**)&g_btPattern, 10);
+            }
+            if (*g_btPattern++ != L'}')
+            {
+                BtFree(atom);
+                return NULL;
+            }
+        }
+
+        BtNode* repeat = BtNew(BT_REPEAT);
+        repeat->a = atom;
+        repeat->min = min;
+        repeat->max = max;
+        atom = repeat;
+    }
+    return atom;
+}
+
+static BtNode* BtParseConcat(void)
+{
+    BtNode* result = BtNew(BT_EMPTY);
+
+    while (result != NULL && *g_btPattern != L'\0' && *g_btPattern != L'|' && *g_btPattern != L')')
+    {
+        BtNode* next = BtParseRepeat();
+        if (next == NULL)
+        {
+            BtFree(result);
+            return NULL;
+        }
+        BtNode* cat = BtNew(BT_CAT);
+        cat->a = result;
+        cat->b = next;
+        result = cat;
+    }
+    return result;
+}
+
+static BtNode* BtParseAlternation(void)
+{
+    BtNode* result = BtParseConcat();
+
+    while (result != NULL && *g_btPattern == L'|')
+    {
+        g_btPattern++;
+        BtNode* right = BtParseConcat();
+        if (right == NULL)
+        {
+            BtFree(result);
+            return NULL;
+        }
+        BtNode* alt = BtNew(BT_ALT);
+        alt->a = result;
+        alt->b = right;
+        result = alt;
+    }
+    return result;
+}
+
+static BtNode* BtCompile(const wchar_t* pattern)
+{
+    g_btPattern = pattern;
+    BtNode* root = BtParseAlternation();
+    if (root != NULL && *g_btPattern != L'\0')
+    {
+        BtFree(root);
+        return NULL;
+    }
+    return root;
+}
+
+static BOOL BtInClass(const BtNode* node, wchar_t c)
+{
+    for (int i = 0; i < node->rangeCount; i++)
+    {
+        if (c >= node->low[i] && c <= node->high[i])
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static BOOL BtMatch(BtMatcher* m, const BtNode* node, int pos, const BtCont* k);
+static BOOL BtContinue(BtMatcher* m, const BtCont* k, int pos);
+
+static BOOL BtRepeat(BtMatcher* m, const BtNode* node, int count, int lastStart, int pos, const BtCont* k)
+{
+    // An empty iteration past the minimum cannot lead anywhere new
+    if (count > node->min && pos == lastStart)
+        return FALSE;
+
+    if (node->max < 0 || count < node->max)
+    {
+        BtCont again = { node, count + 1, pos, k };
+        if (BtMatch(m, node->a, pos, &again))
+            return TRUE;
+    }
+    if (count < node->min)
+        return FALSE;
+    return BtContinue(m, k, pos);
+}
+
+static BOOL BtContinue(BtMatcher* m, const BtCont* k, int pos)
+{
+    if (k == NULL)
+        return TRUE;
+    if (k->count > 0)
+        return BtRepeat(m, k->node, k->count, k->start, pos, k->next);
+    return BtMatch(m, k->node, pos, k->next);
+}
+
+static BOOL BtMatch(BtMatcher* m, const BtNode* node, int pos, const BtCont* k)
+{
+    if (m->gaveUp || ++m->steps > m->budget)
+    {
+        m->gaveUp = TRUE;
+        return FALSE;
+    }
+
+    wchar_t c = (pos < m->length) ? (wchar_t)towlower(m->text[pos]) : L'\0';
+
+    switch (node->type)
+    {
+        case BT_EMPTY:
+            return BtContinue(m, k, pos);
+        case BT_CHAR:
+            return pos < m->length && c == node->ch && BtContinue(m, k, pos + 1);
+        case BT_ANY:
+            return pos < m->length && BtContinue(m, k, pos + 1);
+        case BT_CLASS:
+        {
+            if (pos >= m->length)
+                return FALSE;
+            BOOL in = BtInClass(node, c) || BtInClass(node, (wchar_t)towupper(c));
+            return in != node->negated && BtContinue(m, k, pos + 1);
+        }
+        case BT_CAT:
+        {
+            BtCont then = { node->b, 0, 0, k };
+            return BtMatch(m, node->a, pos, &then);
+        }
+        case BT_ALT:
+            return BtMatch(m, node->a, pos, k) || BtMatch(m, node->b, pos, k);
+        case BT_REPEAT:
+            return BtRepeat(m, node, 0, -1, pos, k);
+        case BT_BOL:
+            return pos == 0 && BtContinue(m, k, pos);
+        case BT_EOL:
+            return pos == m->length && BtContinue(m, k, pos);
+    }
+    return FALSE;
+}
+
+/*
+ * BtSearch - TRUE if the pattern matches anywhere; *gaveUp if the budget ran out
+ */
+static BOOL BtSearch(const BtNode* root, const wchar_t* text, long long budget, BOOL* gaveUp)
+{
+    BtMatcher m = { text, (int)wcslen(text), 0, budget, FALSE };
+
+    for (int start = 0; start <= m.length; start++)
+    {
+        if (BtMatch(&m, root, start, NULL))
+            return TRUE;
+        if (m.gaveUp)
+            break;
+    }
+    if (gaveUp != NULL)
+        *gaveUp = m.gaveUp;
+    return FALSE;
+}
+
+/*
+ * Tests
+ */
+
+static BOOL Matches(const wchar_t* pattern, const wchar_t* text)
+{
+    wchar_t error[128];
+    Regex* regex = CompileRegex(pattern, error, ARRAYSIZE(error));
+    if (regex == NULL)
+        return FALSE;
+    BOOL result = RegexSearch(regex, text);
+    FreeRegex(regex);
+    return result;
+}
+
+static void TestBasics(void)
+{
+    CHECK(Matches(L"srv", L"web-SRV-01"));
+    CHECK(Matches(L"SRV-\\d+", L"srv-42.corp"));
+    CHECK(!Matches(L"^srv", L"web-srv"));
+    CHECK(Matches(L"corp$", L"srv.corp"));
+    CHECK(!Matches(L"corp$", L"srv.corp.example"));
+    CHECK(Matches(L"[A-Z]{3}-\\d{2}$", L"sql-07"));
+    CHECK(!Matches(L"[^a-z]", L"onlyletters"));
+    CHECK(Matches(L"(db|sql)\\d{2}", L"prod-sql12"));
+    CHECK(Matches(L"(?:ab)+c", L"xxababc"));
+    CHECK(Matches(L"a.c", L"abc"));
+    CHECK(!Matches(L"a\\.c", L"abc"));
+    CHECK(Matches(L"", L"anything"));
+    CHECK(Matches(L"x?y*z?", L""));
+    CHECK(Matches(L"\\w+\\s\\w+", L"file server"));
+    CHECK(!Matches(L"\\W", L"under_score9"));
+
+    Regex* regex = CompileRegex(L"a|b", NULL, 0);
+    CHECK(regex != NULL);
+    CHECK_WSTR(GetRegexPattern(regex), L"a|b");
+    FreeRegex(regex);
+
+    // A pattern that backtracking engines take exponential time on
+    wchar_t text[4096];
+    for (int i = 0; i < 4095; i++)
+        text[i] = L'a';
+    text[4095] = L'\0';
+    double start = TestNowMs();
+    CHECK(!Matches(L"(a|aa)*b", text));
+    CHECK(Matches(L"(a|aa)*$", text));
+    CHECK(TestNowMs() - start < 1000.0);
+
+    // Syntax errors are reported
+    wchar_t error[128] = L"";
+    CHECK(CompileRegex(L"(abc", error, ARRAYSIZE(error)) == NULL);
+    CHECK(error[0] != L'\0');
+    CHECK(CompileRegex(L"[abc", error, ARRAYSIZE(error)) == NULL);
+}
+
+static const wchar_t* const g_patterns[] = {
+    L"srv-\\d+",
+    L"^web",
+    L"corp$",
+    L"(db|sql)\\d{2}",
+    L"[a-f]{3}",
+    L"^[^.]+\\.lab",
+    L"x?y+z*",
+    L"a.c",
+    L"(ab|a)(bc|c)",
+    L"\\w+-\\w+\\.example$",
+    L"s[rv]{2}-0+1",
+    L"^(\\d|[a-c])*$",
+    L"[A-Z]\\d[^0-9]",
+    L"(a|b)*abb",
+    L"^.{5,8}$",
+    L"[a-q][^u-z]{13}x",         // Many DFA states: exercises the cache cap
+    L"\\W\\w\\W",
+    L"(x|y|z){2,}[.-]",
+};
+
+/*
+ * RandomHostname - Short names over a small alphabet, so the patterns
+ * above match some and miss others
+ */
+static void RandomHostname(ULONG* seed, wchar_t* out, int outLen)
+{
+    static const wchar_t alphabet[] = L"abcdefsrvxyzwelbqABCSRV0123456789-._";
+    int length = 1 + (int)(TestRandom(seed) % 30);
+    if (length >= outLen)
+        length = outLen - 1;
+
+    for (int i = 0; i < length; i++)
+        out[i] = alphabet[TestRandom(seed) % (ARRAYSIZE(alphabet) - 1)];
+    out[length] = L'\0';
+}
+
+static void TestAgainstBacktracking(void)
+{
+    ULONG seed = 12345;
+    int compared = 0;
+    int mismatches = 0;
+
+    for (size_t p = 0; p < ARRAYSIZE(g_patterns); p++)
+    {
+        Regex* regex = CompileRegex(g_patterns[p], NULL, 0);
+        BtNode* reference = BtCompile(g_patterns[p]);
+        CHECK(regex != NULL && reference != NULL);
+        if (regex == NULL || reference == NULL)
+            continue;
+
+        for (int i = 0; i < 5000; i++)
+        {
+            wchar_t text[64];
+            BOOL gaveUp = FALSE;
+            RandomHostname(&seed, text, ARRAYSIZE(text));
+
+            BOOL expected = BtSearch(reference, text, 10000000, &gaveUp);
+            if (gaveUp)
+                continue;
+            compared++;
+            if (RegexSearch(regex, text) != expected)
+            {
+                if (mismatches++ < 5)
+                    printf("  mismatch: /%ls/ on \"%ls\" (expected %d)\n", g_patterns[p], text, expected);
+            }
+        }
+
+        BtFree(reference);
+        FreeRegex(regex);
+    }
+
+    CHECK(compared > 80000);
+    CHECK_INT(mismatches, 0);
+}
+
+/*
+ * Benchmark
+ */
+
+static wchar_t (*GenerateHostnames(int count))[64]
+{
+    static const wchar_t* const roles[] = { L"srv", L"web", L"db", L"sql", L"dc", L"app", L"file", L"jump" };
+    static const wchar_t* const sites[] = { L"corp.example", L"lab.example", L"dmz.example", L"eu.corp.example" };
+    wchar_t (*names)[64] = malloc(count * sizeof(*names));
+    ULONG seed = 99;
+    if (names == NULL)
+        return NULL;
+
+    for (int i = 0; i < count; i++)
+    {
+        swprintf_s(names[i], 64, L"%s-%03u.%s", roles[TestRandom(&seed) % ARRAYSIZE(roles)],
+                   (unsigned int)(TestRandom(&seed) % 1000), sites[TestRandom(&seed) % ARRAYSIZE(sites)]);
+    }
+    return names;
+}
+
+static void BenchPattern(const wchar_t* pattern, wchar_t (*names)[64], int count, int backtrackCount)
+{
+    char label[128];
+    int dfaMatches = 0, btMatches = 0, gaveUp = 0;
+
+    double start = TestNowMs();
+    Regex* regex = CompileRegex(pattern, NULL, 0);
+    for (int i = 0; i < count; i++)
+        dfaMatches += RegexSearch(regex, names[i]);
+    double dfaMs = TestNowMs() - start;
+    FreeRegex(regex);
+
+    BtNode* reference = BtCompile(pattern);
+    start = TestNowMs();
+    for (int i = 0; i < backtrackCount; i++)
+    {
+        BOOL budgetSpent = FALSE;
+        btMatches += BtSearch(reference, names[i], 1000000, &budgetSpent);
+        gaveUp += budgetSpent;
+    }
+    double btMs = TestNowMs() - start;
+    BtFree(reference);
+
+    printf("/%ls/ (%d matches)\n", pattern, dfaMatches);
+    snprintf(label, sizeof(label), "lazy DFA, %d hostnames", count);
+    TestBenchResult(label, dfaMs);
+    if (gaveUp > 0)
+        snprintf(label, sizeof(label), "backtracking, %d hostnames (%d gave up)", backtrackCount, gaveUp);
+    else
+        snprintf(label, sizeof(label), "backtracking, %d hostnames", backtrackCount);
+    TestBenchResult(label, btMs);
+
+    if (backtrackCount == count && gaveUp == 0)
+        CHECK_INT(btMatches, dfaMatches);
+}
+
+static void BenchRegex(void)
+{
+    const int count = 100000;
+    wchar_t (*names)[64] = GenerateHostnames(count);
+    if (names == NULL)
+        return;
+
+    BenchPattern(L"sql-\\d+", names, count, count);
+    BenchPattern(L"^(web|app)-\\d{3}\\.(lab|dmz)", names, count, count);
+    BenchPattern(L"\\w+\\.corp\\.example$", names, count, count);
+    BenchPattern(L".*-9.*9.*\\.eu", names, count, count);
+
+    // Nested repetition: every hostname fails after trying every split of
+    // its letters, so the backtracking matcher only gets 200 of them
+    BenchPattern(L"^([\\w.-]|[\\w.-]{2})*!", names, count, 200);
+
+    free(names);
+}
+
+int main(int argc, char** argv)
+{
+    TestBasics();
+    TestAgainstBacktracking();
+
+    if (TestBenchRequested(argc, argv))
+        BenchRegex();
+
+    return TestSummary("regex");
+}
@@ -0,0 +1,689 @@
+/*
+ * Name Resolver Tests
+ *
+ * Points the resolver at a stub DNS server this test runs on an
+ * ephemeral UDP port of 127.0.0.1 (the DnsServer setting, "ip:port", so
+ * the resolver asks it directly and skips the system cache). The stub
+ * answers from the shape of the name:
+ * A records with chosen TTLs, an A+AAAA name, "no such name", a server
+ * failure, and slow answers on a thread each so the lookups in flight can
+ * be counted. Covers SplitHostPort, literal addresses, positive and
+ * negative caching and their expiry, the TTL cap, the concurrency bound,
+ * cancelling, the prefetch and a DnsServer nobody answers on. The
+ * benchmark resolves 5k names cold at several concurrency levels, then
+ * again from the cache.
+ */
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <windns.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "config.h"
+#include "resolver.h"
+
+/*
+ * Settings
+ */
+
+static DWORD g_negativeTtl = 2;
+static wchar_t g_dnsServer[32];             // "127.0.0.1:<stub port>"
+
+DWORD GetSettingDWORD(const wchar_t* valueName, DWORD defaultValue)
+{
+    if (wcscmp(valueName, REG_RESOLVER_NEGATIVE_TTL) == 0)
+        return g_negativeTtl;
+    return defaultValue;
+}
+
+// Every lookup goes to the stub
+BOOL GetSettingString(const wchar_t* valueName, wchar_t* buffer, DWORD bufferLen)
+{
+    if (wcscmp(valueName, REG_DNS_SERVER) != 0)
+        return FALSE;
+    wcsncpy_s(buffer, bufferLen, g_dnsServer, _TRUNCATE);
+    return TRUE;
+}
+
+/*
+ * Stub DNS server
+ *
+ * Answers by name:
+ *   host<N>.test   A 10.0.<N/256>.<N%256>, TTL 300
+ *   dual.test      A 192.0.2.1 (TTL 600) and AAAA 2001:db8::1 (TTL 120)
+ *   short.test     A 192.0.2.2, TTL 1
+ *   long.test      A 192.0.2.3, TTL 86400
+ *   slow<N>.test   As host<N>.test, after g_slowDelayMs
+ *   fail.test      Server failure
+ *   anything else  No such name
+ */
+
+#define DNS_HEADER_SIZE     12
+#define DNS_RCODE_SERVFAIL  2
+#define DNS_RCODE_NXDOMAIN  3
+
+static SOCKET g_dnsSocket = INVALID_SOCKET;
+static HANDLE g_dnsThread = NULL;
+static volatile LONG g_queries = 0;         // Every query received
+static volatile LONG g_slowInFlight = 0;    // Slow queries being answered now
+static volatile LONG g_slowMaxInFlight = 0;
+static DWORD g_slowDelayMs = 100;
+
+// A query held back on its own thread
+typedef struct {
+    BYTE packet[512];
+    int length;
+    SOCKADDR_IN from;
+} SlowQuery;
+
+static void PutWord(BYTE* p, WORD value)
+{
+    p[0] = (BYTE)(value >> 8);
+    p[1] = (BYTE)value;
+}
+
+static void PutDword(BYTE* p, DWORD value)
+{
+    PutWord(p, (WORD)(value >> 16));
+    PutWord(p + 2, (WORD)value);
+}
+
+// Read the question's name as "a.b.c" (lowercase); returns the offset after QTYPE/QCLASS, or 0
+static int ParseQuestion(const BYTE* packet, int length, char* name, int nameSize, WORD* type)
+{
+    int offset = DNS_HEADER_SIZE;
+    int written = 0;
+
+    while (offset < length && packet[offset] != 0)
+    {
+        int labelLength = packet[offset++];
+        if (labelLength > 63 || offset + labelLength > length || written + labelLength + 2 > nameSize)
+            return 0;
+        if (written > 0)
+            name[written++] = '.';
+        for (int i = 0; i < labelLength; i++)
+        {
+            char c = (char)packet[offset + i];
+            name[written++] = (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+        }
+        offset += labelLength;
+    }
+    name[written] = '\0';
+
+    offset++;
+    if (offset + 4 > length)
+        return 0;
+    *type = (WORD)((packet[offset] << 8) | packet[offset + 1]);
+    return offset + 4;
+}
+
+// Append an answer record (the name points back at the question)
+static int PutAnswer(BYTE* reply, int offset, WORD type, DWORD ttl, const BYTE* data, WORD dataLength)
+{
+    PutWord(reply + offset, 0xC000 | DNS_HEADER_SIZE);
+    PutWord(reply + offset + 2, type);
+    PutWord(reply + offset + 4, 1);             // IN
+    PutDword(reply + offset + 6, ttl);
+    PutWord(reply + offset + 10, dataLength);
+    memcpy(reply + offset + 12, data, dataLength);
+    return offset + 12 + dataLength;
+}
+
+static void AnswerQuery(const BYTE* packet, int length, const SOCKADDR_IN* from)
+{
+    char name[256];
+    WORD type = 0;
+    BYTE reply[512];
+
+    int questionEnd = ParseQuestion(packet, length, name, sizeof(name), &type);
+    if (questionEnd == 0)
+        return;
+
+    // Header and question copied from the query, no authority or additional records
+    memcpy(reply, packet, questionEnd);
+    reply[2] = (BYTE)(0x80 | (packet[2] & 0x01));      // QR, RD as asked
+    reply[3] = 0x80;                                     // RA, NOERROR
+    PutWord(reply + 4, 1);
+    PutWord(reply + 6, 0);
+    PutWord(reply + 8, 0);
+    PutWord(reply + 10, 0);
+
+    int answers = 0;
+    int offset = questionEnd;
+    unsigned int n = 0;
+    BYTE a[4] = { 192, 0, 2, 0 };
+
+    if (sscanf(name, "host%u.test", &n) == 1 || sscanf(name, "slow%u.test", &n) == 1)
+    {
+        if (type == DNS_TYPE_A)
+        {
+            a[0] = 10;
+            a[1] = 0;
+            a[2] = (BYTE)(n >> 8);
+            a[3] = (BYTE)n;
+            offset = PutAnswer(reply, offset, DNS_TYPE_A, 300, a, 4);
+            answers++;
+        }
+    }
+    else if (strcmp(name, "dual.test") == 0)
+    {
+        static const BYTE aaaa[16] = { 0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1 };
+        a[3] = 1;
+        if (type == DNS_TYPE_A)
+        {
+            offset = PutAnswer(reply, offset, DNS_TYPE_A, 600, a, 4);
+            answers++;
+        }
+        else if (type == DNS_TYPE_AAAA)
+        {
+            offset = PutAnswer(reply, offset, DNS_TYPE_AAAA, 120, aaaa, 16);
+            answers++;
+        }
+    }
+    else if (strcmp(name, "short.test") == 0 || strcmp(name, "long.test") == 0)
+    {
+        BOOL isShort = (name[0] == 's');
+        a[3] = isShort ? 2 : 3;
+        if (type == DNS_TYPE_A)
+        {
+            offset = PutAnswer(reply, offset, DNS_TYPE_A, isShort ? 1 : 86400, a, 4);
+            answers++;
+        }
+    }
+    else if (strcmp(name, "fail.test") == 0)
+    {
+        reply[3] |= DNS_RCODE_SERVFAIL;
+    }
+    else
+    {
+        reply[3] |= DNS_RCODE_NXDOMAIN;
+    }
+
+    PutWord(reply + 6, (WORD)answers);
+    sendto(g_dnsSocket, (const char*)reply, offset, 0, (const SOCKADDR*)from, sizeof(SOCKADDR_IN));
+}
+
+static DWORD WINAPI SlowQueryThread(LPVOID param)
+{
+    SlowQuery* query = (SlowQuery*)param;
+
+    LONG inFlight = InterlockedIncrement(&g_slowInFlight);
+    LONG max = g_slowMaxInFlight;
+    while (inFlight > max && InterlockedCompareExchange(&g_slowMaxInFlight, inFlight, max) != max)
+        max = g_slowMaxInFlight;
+
+    Sleep(g_slowDelayMs);
+    InterlockedDecrement(&g_slowInFlight);
+    AnswerQuery(query->packet, query->length, &query->from);
+    free(query);
+    return 0;
+}
+
+static DWORD WINAPI DnsServerThread(LPVOID param)
+{
+    (void)param;
+
+    // Ends when StopDnsServer closes the socket
+    for (;;)
+    {
+        SlowQuery query;
+        int fromLength = sizeof(query.from);
+        query.length = recvfrom(g_dnsSocket, (char*)query.packet, sizeof(query.packet), 0,
+                                (SOCKADDR*)&query.from, &fromLength);
+        if (query.length == SOCKET_ERROR)
+        {
+            if (WSAGetLastError() == WSAECONNRESET)     // ICMP unreachable from an earlier reply
+                continue;
+            break;
+        }
+        if (query.length < DNS_HEADER_SIZE)
+            continue;
+        InterlockedIncrement(&g_queries);
+
+        // "slow" names are answered later on a thread of their own
+        if (query.length > DNS_HEADER_SIZE + 5 && memcmp(query.packet + DNS_HEADER_SIZE + 1, "slow", 4) == 0)
+        {
+            SlowQuery* copy = (SlowQuery*)malloc(sizeof(SlowQuery));
+            HANDLE thread = NULL;
+            if (copy != NULL)
+            {
+                *copy = query;
+                thread = CreateThread(NULL, 0, SlowQueryThread, copy, 0, NULL);
+            }
+            if (thread != NULL)
+                CloseHandle(thread);
+            else
+                free(copy);
+            continue;
+        }
+        AnswerQuery(query.packet, query.length, &query.from);
+    }
+    return 0;
+}
+
+// Bind a UDP socket to a port of 127.0.0.1 the system picks; returns the port, or 0
+static USHORT BindEphemeral(SOCKET s)
+{
+    SOCKADDR_IN address = {0};
+    int addressLength = sizeof(address);
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(s, (const SOCKADDR*)&address, sizeof(address)) != 0 ||
+        getsockname(s, (SOCKADDR*)&address, &addressLength) != 0)
+        return 0;
+    return ntohs(address.sin_port);
+}
+
+static BOOL StartDnsServer(void)
+{
+    g_dnsSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (g_dnsSocket == INVALID_SOCKET)
+        return FALSE;
+    USHORT port = BindEphemeral(g_dnsSocket);
+    if (port == 0)
+    {
+        printf("resolver: cannot listen on 127.0.0.1 (error %d)\n", WSAGetLastError());
+        closesocket(g_dnsSocket);
+        return FALSE;
+    }
+    swprintf_s(g_dnsServer, ARRAYSIZE(g_dnsServer), L"127.0.0.1:%u", port);
+
+    g_dnsThread = CreateThread(NULL, 0, DnsServerThread, NULL, 0, NULL);
+    if (g_dnsThread == NULL)
+    {
+        closesocket(g_dnsSocket);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void StopDnsServer(void)
+{
+    closesocket(g_dnsSocket);
+    WaitForSingleObject(g_dnsThread, INFINITE);
+    CloseHandle(g_dnsThread);
+}
+
+/*
+ * Tests
+ */
+
+static DWORD Ipv4Of(const ResolvedName* result, int index)
+{
+    const SOCKADDR_IN* address = (const SOCKADDR_IN*)result->addresses[index].address;
+    return ntohl(address->sin_addr.s_addr);
+}
+
+static void TestSplitHostPort(void)
+{
+    wchar_t host[MAX_HOSTNAME_LEN];
+
+    CHECK_INT(SplitHostPort(L"server1", 3389, host, ARRAYSIZE(host)), 3389);
+    CHECK_WSTR(host, L"server1");
+    CHECK_INT(SplitHostPort(L"server1:3390", 3389, host, ARRAYSIZE(host)), 3390);
+    CHECK_WSTR(host, L"server1");
+    CHECK_INT(SplitHostPort(L"[fe80::1]:3391", 3389, host, ARRAYSIZE(host)), 3391);
+    CHECK_WSTR(host, L"fe80::1");
+    CHECK_INT(SplitHostPort(L"[fe80::1]", 3389, host, ARRAYSIZE(host)), 3389);
+    CHECK_WSTR(host, L"fe80::1");
+    CHECK_INT(SplitHostPort(L"fe80::1", 3389, host, ARRAYSIZE(host)), 3389);
+    CHECK_WSTR(host, L"fe80::1");
+    CHECK_INT(SplitHostPort(L"server1:99999", 3389, host, ARRAYSIZE(host)), 0);
+    CHECK_INT(SplitHostPort(L"server1:", 3389, host, ARRAYSIZE(host)), 0);
+    CHECK_INT(SplitHostPort(L"server1:33a", 3389, host, ARRAYSIZE(host)), 0);
+}
+
+static void TestLiteral(void)
+{
+    ResolvedName result;
+    LONG queries = g_queries;
+
+    ResolveName(L"10.1.2.3", &result);
+    CHECK_INT(result.error, 0);
+    CHECK_INT(result.addressCount, 1);
+    CHECK_INT(Ipv4Of(&result, 0), 0x0A010203);
+    CHECK_INT(result.ttl, 0);
+
+    ResolveName(L"::1", &result);
+    CHECK_INT(result.error, 0);
+    CHECK_INT(result.addressCount, 1);
+    CHECK_INT(((const SOCKADDR*)result.addresses[0].address)->sa_family, AF_INET6);
+
+    // Converted, not looked up (and not cached)
+    ResolveName(L"10.1.2.3", &result);
+    CHECK(!result.fromCache);
+    CHECK_INT(g_queries, queries);
+
+    ResolveName(L"", &result);
+    CHECK_INT(result.error, WSAHOST_NOT_FOUND);
+}
+
+static void TestPositiveCache(void)
+{
+    ResolvedName result;
+    ClearResolverCache();
+
+    // A and AAAA are both asked for
+    LONG queries = g_queries;
+    ResolveName(L"host258.test", &result);
+    CHECK_INT(result.error, 0);
+    CHECK_INT(result.addressCount, 1);
+    CHECK_INT(Ipv4Of(&result, 0), 0x0A000102);
+    CHECK_INT(result.ttl, 300);
+    CHECK(!result.fromCache);
+    CHECK_INT(g_queries - queries, 2);
+
+    // Then answered from the cache, whatever the case
+    queries = g_queries;
+    ResolveName(L"HOST258.Test", &result);
+    CHECK(result.fromCache);
+    CHECK_INT(Ipv4Of(&result, 0), 0x0A000102);
+    CHECK_INT(g_queries, queries);
+
+    // IPv4 first, the shortest TTL wins
+    ResolveName(L"dual.test", &result);
+    CHECK_INT(result.addressCount, 2);
+    CHECK_INT(((const SOCKADDR*)result.addresses[0].address)->sa_family, AF_INET);
+    CHECK_INT(((const SOCKADDR*)result.addresses[1].address)->sa_family, AF_INET6);
+    CHECK_INT(result.ttl, 120);
+
+    // Capped at RESOLVER_MAX_TTL
+    ResolveName(L"long.test", &result);
+    CHECK_INT(result.ttl, RESOLVER_MAX_TTL);
+
+    // Expires with its TTL
+    ResolveName(L"short.test", &result);
+    CHECK_INT(result.ttl, 1);
+    ResolveName(L"short.test", &result);
+    CHECK(result.fromCache);
+    Sleep(1100);
+    queries = g_queries;
+    ResolveName(L"short.test", &result);
+    CHECK(!result.fromCache);
+    CHECK_INT(result.error, 0);
+    CHECK_INT(g_queries - queries, 2);
+
+    // Forgotten on request
+    ClearResolverCache();
+    ResolveName(L"host258.test", &result);
+    CHECK(!result.fromCache);
+}
+
+static void TestNegativeCache(void)
+{
+    ResolvedName result;
+    ClearResolverCache();
+
+    // "No such name" is remembered for the ResolverNegativeTtl setting
+    ResolveName(L"gone.test", &result);
+    CHECK_INT(result.error, WSAHOST_NOT_FOUND);
+    CHECK_INT(result.addressCount, 0);
+    CHECK_INT(result.ttl, g_negativeTtl);
+    CHECK(!result.fromCache);
+
+    LONG queries = g_queries;
+    ResolveName(L"gone.test", &result);
+    CHECK(result.fromCache);
+    CHECK_INT(result.error, WSAHOST_NOT_FOUND);
+    CHECK_INT(g_queries, queries);
+
+    Sleep(g_negativeTtl * 1000 + 100);
+    ResolveName(L"gone.test", &result);
+    CHECK(!result.fromCache);
+    CHECK(g_queries > queries);
+
+    // A server failure is not remembered
+    ResolveName(L"fail.test", &result);
+    CHECK_INT(result.error, WSATRY_AGAIN);
+    CHECK_INT(result.ttl, 0);
+    queries = g_queries;
+    ResolveName(L"fail.test", &result);
+    CHECK(!result.fromCache);
+    CHECK(g_queries > queries);
+
+    // Capped like any answer
+    g_negativeTtl = 100000;
+    ResolveName(L"gone2.test", &result);
+    CHECK_INT(result.ttl, RESOLVER_MAX_TTL);
+    g_negativeTtl = 2;
+}
+
+static void TestBatch(void)
+{
+    const wchar_t* names[] = { L"host1.test", L"gone.test", L"10.9.8.7", L"host2.test", L"fail.test", L"host1.test" };
+    ResolvedName results[ARRAYSIZE(names)];
+    ClearResolverCache();
+
+    CHECK(ResolveNames(names, (int)ARRAYSIZE(names), 4, results, NULL));
+    CHECK_WSTR(results[0].name, L"host1.test");
+    CHECK_INT(Ipv4Of(&results[0], 0), 0x0A000001);
+    CHECK_INT(results[1].error, WSAHOST_NOT_FOUND);
+    CHECK_INT(Ipv4Of(&results[2], 0), 0x0A090807);
+    CHECK_INT(Ipv4Of(&results[3], 0), 0x0A000002);
+    CHECK_INT(results[4].error, WSATRY_AGAIN);
+    CHECK_INT(Ipv4Of(&results[5], 0), 0x0A000001);
+
+    // A second batch takes what it can from the cache
+    LONG queries = g_queries;
+    CHECK(ResolveNames(names, 4, 4, results, NULL));
+    CHECK(results[0].fromCache);
+    CHECK(results[1].fromCache);
+    CHECK(!results[2].fromCache);
+    CHECK(results[3].fromCache);
+    CHECK_INT(g_queries, queries);
+
+    CHECK(ResolveNames(names, 0, 4, results, NULL));
+}
+
+// Resolve count slow names at the given concurrency; returns the milliseconds taken
+static double ResolveSlow(int first, int count, int concurrency, volatile LONG* cancel, ResolvedName* results)
+{
+    wchar_t (*names)[32] = calloc(count, sizeof(*names));
+    const wchar_t** pointers = (const wchar_t**)malloc(sizeof(wchar_t*) * count);
+    double ms = -1.0;
+
+    if (names != NULL && pointers != NULL)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            swprintf_s(names[i], 32, L"slow%d.test", first + i);
+            pointers[i] = names[i];
+        }
+        double start = TestNowMs();
+        CHECK(ResolveNames(pointers, count, concurrency, results, cancel));
+        ms = TestNowMs() - start;
+    }
+
+    free(pointers);
+    free(names);
+    return ms;
+}
+
+static void TestConcurrency(void)
+{
+    ResolvedName results[32];
+    ClearResolverCache();
+
+    // Each worker has one query out at a time (A, then AAAA)
+    g_slowMaxInFlight = 0;
+    double ms = ResolveSlow(0, 32, 4, NULL, results);
+    CHECK(g_slowMaxInFlight <= 4);
+    CHECK(g_slowMaxInFlight >= 2);
+    CHECK(ms >= 2.0 * 8 * g_slowDelayMs * 0.9);
+    for (int i = 0; i < 32; i++)
+        CHECK_INT(Ipv4Of(&results[i], 0), 0x0A000000 + i);
+
+    // More threads, less waiting
+    g_slowMaxInFlight = 0;
+    ms = ResolveSlow(100, 32, 32, NULL, results);
+    CHECK(g_slowMaxInFlight <= 32);
+    CHECK(g_slowMaxInFlight > 4);
+    CHECK(ms < 2.0 * 8 * g_slowDelayMs);
+
+    // Beyond RESOLVER_MAX_CONCURRENCY is clamped
+    g_slowMaxInFlight = 0;
+    ResolvedName* many = (ResolvedName*)malloc(sizeof(ResolvedName) * 200);
+    if (many != NULL)
+    {
+        ResolveSlow(200, 200, 1000, NULL, many);
+        CHECK(g_slowMaxInFlight <= RESOLVER_MAX_CONCURRENCY);
+        free(many);
+    }
+
+    // Cancelled: names not yet looked up fail, and are not cached
+    volatile LONG cancel = 1;
+    ResolveSlow(500, 8, 2, &cancel, results);
+    for (int i = 0; i < 8; i++)
+    {
+        CHECK_INT(results[i].error, WSATRY_AGAIN);
+        CHECK(!results[i].fromCache);
+    }
+    ResolveName(L"slow500.test", &results[0]);
+    CHECK_INT(results[0].error, 0);
+    CHECK(!results[0].fromCache);
+}
+
+static void TestPrefetch(void)
+{
+    const wchar_t* names[] = { L"slow600.test:3390", L"slow601.test", L"[slow602.test]:3389", L"host603.test" };
+    ClearResolverCache();
+
+    LONG queries = g_queries;
+    CHECK(StartResolverPrefetch(names, (int)ARRAYSIZE(names)));
+    CHECK(!StartResolverPrefetch(names, (int)ARRAYSIZE(names)));    // One at a time
+    CHECK(!StartResolverPrefetch(names, 0));
+
+    // Wait for its queries (A and AAAA each), then let it store the last answer
+    for (int waited = 0; g_queries - queries < 8 && waited < 5000; waited += 10)
+        Sleep(10);
+    CHECK_INT(g_queries - queries, 8);
+    Sleep(g_slowDelayMs + 200);
+
+    // Connecting now needs no lookup, and the port was dropped from the name
+    ResolvedName result;
+    queries = g_queries;
+    ResolveName(L"slow600.test", &result);
+    CHECK(result.fromCache);
+    CHECK_INT(Ipv4Of(&result, 0), 0x0A000258);
+    ResolveName(L"slow602.test", &result);
+    CHECK(result.fromCache);
+    ResolveName(L"host603.test", &result);
+    CHECK(result.fromCache);
+    CHECK_INT(g_queries, queries);
+
+    // Finished, so another may start
+    CHECK(StartResolverPrefetch(names, 1));
+    Sleep(g_slowDelayMs * 2 + 200);
+}
+
+static void TestServerDown(void)
+{
+    wchar_t stub[32];
+    ResolvedName result;
+    ClearResolverCache();
+
+    // A port that was free a moment ago: the lookup fails at once and is not cached
+    SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    USHORT port = BindEphemeral(s);
+    closesocket(s);
+    CHECK(port != 0);
+
+    wcscpy_s(stub, ARRAYSIZE(stub), g_dnsServer);
+    swprintf_s(g_dnsServer, ARRAYSIZE(g_dnsServer), L"127.0.0.1:%u", port);
+    double start = TestNowMs();
+    ResolveName(L"host1.test", &result);
+    CHECK(TestNowMs() - start < RESOLVER_QUERY_TIMEOUT_MS);
+    CHECK_INT(result.error, WSATRY_AGAIN);
+    CHECK_INT(result.ttl, 0);
+    CHECK_INT(result.addressCount, 0);
+
+    // Back to the stub, which is asked again
+    wcscpy_s(g_dnsServer, ARRAYSIZE(g_dnsServer), stub);
+    LONG queries = g_queries;
+    ResolveName(L"host1.test", &result);
+    CHECK(!result.fromCache);
+    CHECK_INT(Ipv4Of(&result, 0), 0x0A000001);
+    CHECK_INT(g_queries - queries, 2);
+}
+
+/*
+ * Benchmark
+ */
+
+static void BenchResolve(int count)
+{
+    char label[96];
+    wchar_t (*names)[32] = calloc(count, sizeof(*names));
+    const wchar_t** pointers = (const wchar_t**)malloc(sizeof(wchar_t*) * count);
+    ResolvedName* results = (ResolvedName*)malloc(sizeof(ResolvedName) * count);
+    if (names == NULL || pointers == NULL || results == NULL)
+    {
+        free(results);
+        free(pointers);
+        free(names);
+        return;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        swprintf_s(names[i], 32, L"host%d.test", i);
+        pointers[i] = names[i];
+    }
+
+    printf("Resolving %d names through the stub server\n", count);
+    int concurrency[] = { 1, 8, 16, 64 };
+    for (int c = 0; c < (int)ARRAYSIZE(concurrency); c++)
+    {
+        ClearResolverCache();
+        double start = TestNowMs();
+        ResolveNames(pointers, count, concurrency[c], results, NULL);
+        snprintf(label, sizeof(label), "cold, concurrency %d", concurrency[c]);
+        TestBenchResult(label, TestNowMs() - start);
+    }
+
+    double start = TestNowMs();
+    ResolveNames(pointers, count, 16, results, NULL);
+    TestBenchResult("warm (every name cached)", TestNowMs() - start);
+
+    free(results);
+    free(pointers);
+    free(names);
+}
+
+int main(int argc, char** argv)
+{
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+    {
+        printf("resolver: Winsock did not start\n");
+        return 1;
+    }
+
+    TestSplitHostPort();
+
+    BOOL server = StartDnsServer();
+    CHECK(server);
+    if (server)
+    {
+        TestLiteral();
+        TestPositiveCache();
+        TestNegativeCache();
+        TestBatch();
+        TestConcurrency();
+        TestPrefetch();
+        TestServerDown();
+
+        if (TestBenchRequested(argc, argv))
+            BenchResolve(5000);
+
+        StopDnsServer();
+    }
+
+    ClearResolverCache();
+    WSACleanup();
+    return TestSummary("resolver");
+}
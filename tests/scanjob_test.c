@@ -0,0 +1,900 @@
+/*
+ * Scan Job Tests
+ *
+ * Drives StartScanJob with a fake ComputerSource instead of the network:
+ * each fake domain lists numbered computers page by page, and can be made
+ * slow, fail, or end incomplete. Checks the per-source outcomes, the
+ * totals, timeouts and cancelling, the merge of overlapping sources and
+ * the refresh against the scan cache. The benchmark merges 8 overlapping
+ * sources of 100k computers, from scratch and against the cache.
+ */
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "test.h"
+#include "config.h"
+#include "scanjob.h"
+#include "scancache.h"
+
+/*
+ * Fake enumeration
+ */
+
+// One fake domain/workgroup
+typedef struct {
+    const wchar_t* name;        // As listed in ScanParams.domains (NULL = the current domain)
+    const wchar_t* prefix;      // Computers are <prefix>-00000, <prefix>-00001, ...
+    int first;                  // Number of the first computer
+    int count;
+    int distinct;               // Numbers repeat after this many (0 = count, no repeats)
+    int pageSize;               // Entries per page, before the type filter
+    DWORD pageDelayMs;          // Wait before each page
+    DWORD failStatus;           // The first page fails with this status (0 = it works)
+    BOOL incomplete;            // The list stops halfway with ERROR_MORE_DATA
+    const wchar_t* comment;     // Comment of every computer (NULL = "Fake computer")
+} FakeDomain;
+
+#define MAX_FAKE_DOMAINS 16
+
+static FakeDomain g_fakeDomains[MAX_FAKE_DOMAINS];
+static int g_fakeDomainCount;
+static volatile LONG g_fakeCalls;
+
+static void AddFakeDomain(const FakeDomain* domain)
+{
+    g_fakeDomains[g_fakeDomainCount++] = *domain;
+}
+
+// Computer n is a workstation, a server or a domain controller in turn
+static BOOL FakeComputerWanted(int n, BOOL includeWorkstations, BOOL includeServers, BOOL includeDomainControllers)
+{
+    switch (n % 3)
+    {
+        case 0:  return includeWorkstations;
+        case 1:  return includeServers;
+        default: return includeDomainControllers;
+    }
+}
+
+/*
+ * FakeEnumerate - ComputerSource over g_fakeDomains
+ *
+ * Like EnumerateComputers it fills in the summary before each page, so
+ * the job sees the counts of the page it is given.
+ */
+static BOOL FakeEnumerate(const wchar_t* domain, BOOL includeWorkstations,
+                          BOOL includeServers, BOOL includeDomainControllers,
+                          ComputerBatchCallback callback, void* context,
+                          ScanSummary* summary)
+{
+    const FakeDomain* fake = NULL;
+    ScanSummary local = {0};
+    if (summary == NULL)
+        summary = &local;
+    memset(summary, 0, sizeof(ScanSummary));
+    InterlockedIncrement(&g_fakeCalls);
+
+    for (int i = 0; i < g_fakeDomainCount && fake == NULL; i++)
+    {
+        if ((domain == NULL && g_fakeDomains[i].name == NULL) ||
+            (domain != NULL && g_fakeDomains[i].name != NULL && _wcsicmp(domain, g_fakeDomains[i].name) == 0))
+        {
+            fake = &g_fakeDomains[i];
+        }
+    }
+    if (fake == NULL || fake->failStatus != 0)
+    {
+        summary->status = (fake != NULL) ? fake->failStatus : ERROR_BAD_NETPATH;
+        return FALSE;
+    }
+
+    int pageSize = (fake->pageSize > 0) ? fake->pageSize : 100;
+    int end = fake->incomplete ? fake->count / 2 : fake->count;
+    ComputerInfo* batch = (ComputerInfo*)calloc(pageSize, sizeof(ComputerInfo));
+    if (batch == NULL)
+        return FALSE;
+
+    summary->totalEntries = (DWORD)fake->count;
+    BOOL stopped = FALSE;
+    for (int start = 0; start < end && !stopped; start += pageSize)
+    {
+        if (fake->pageDelayMs > 0)
+            Sleep(fake->pageDelayMs);
+
+        int batchCount = 0;
+        int pageEnd = (start + pageSize < end) ? start + pageSize : end;
+        for (int i = start; i < pageEnd; i++)
+        {
+            int n = fake->first + ((fake->distinct > 0) ? i % fake->distinct : i);
+            if (!FakeComputerWanted(n, includeWorkstations, includeServers, includeDomainControllers))
+                continue;
+
+            ComputerInfo* computer = &batch[batchCount++];
+            memset(computer, 0, sizeof(ComputerInfo));
+            swprintf_s(computer->name, 256, L"%s-%05d", fake->prefix, n);
+            wcscpy_s(computer->comment, 256, (fake->comment != NULL) ? fake->comment : L"Fake computer");
+        }
+
+        summary->entriesReceived += (DWORD)(pageEnd - start);
+        summary->computersReported += batchCount;
+        summary->pages++;
+        stopped = !callback(batch, batchCount, context);
+    }
+    free(batch);
+
+    summary->status = fake->incomplete ? ERROR_MORE_DATA : ERROR_SUCCESS;
+    summary->complete = !stopped && !fake->incomplete && summary->entriesReceived >= summary->totalEntries;
+    return TRUE;
+}
+
+// The job calls these from adscan.c; the fake stands in for the network
+BOOL EnumerateComputers(const wchar_t* domain, BOOL includeWorkstations,
+                        BOOL includeServers, BOOL includeDomainControllers,
+                        ComputerBatchCallback callback, void* context,
+                        ScanSummary* summary)
+{
+    return FakeEnumerate(domain, includeWorkstations, includeServers, includeDomainControllers,
+                         callback, context, summary);
+}
+
+void FreeComputerList(ComputerInfo* computers)
+{
+    free(computers);
+}
+
+/*
+ * Helpers
+ */
+
+static void ResetFakes(void)
+{
+    g_fakeDomainCount = 0;
+    g_fakeCalls = 0;
+}
+
+static ScanParams DefaultParams(const wchar_t* domains, int workers)
+{
+    ScanParams params = {0};
+    wcscpy_s(params.domains, ARRAYSIZE(params.domains), domains);
+    params.includeWorkstations = TRUE;
+    params.includeServers = TRUE;
+    params.includeDomainControllers = TRUE;
+    params.workerCount = workers;
+    params.mode = SCAN_MODE_BROWSE;
+    return params;
+}
+
+// Results taken while the job runs, as the dialog does
+typedef struct {
+    ComputerInfo* computers;    // NULL when only counting
+    int count;
+    int takes;
+    BOOL countOnly;
+} TakenResults;
+
+/*
+ * TakeResults - Take what the job has queued; returns how many computers that was
+ */
+static int TakeResults(ScanJob* job, TakenResults* taken)
+{
+    ComputerInfo* batch;
+    int count = TakeScanJobResults(job, &batch);
+    if (count == 0)
+        return 0;
+    if (taken->countOnly)
+    {
+        taken->count += count;
+        taken->takes++;
+        return count;
+    }
+
+    ComputerInfo* grown = (ComputerInfo*)realloc(taken->computers, sizeof(ComputerInfo) * (taken->count + count));
+    if (grown != NULL)
+    {
+        memcpy(grown + taken->count, batch, sizeof(ComputerInfo) * count);
+        taken->computers = grown;
+        taken->count += count;
+        taken->takes++;
+    }
+    return count;
+}
+
+/*
+ * RunScan - Start a job, take its results until it ends
+ *
+ * Returns the finished job (free with FreeScanJob), or NULL. With
+ * countOnly the results are counted and dropped.
+ */
+static ScanJob* RunScanCounting(const ScanParams* params, TakenResults* taken, BOOL countOnly)
+{
+    memset(taken, 0, sizeof(TakenResults));
+    taken->countOnly = countOnly;
+
+    ScanJob* job = StartScanJob(params, FakeEnumerate, NULL);
+    if (job == NULL)
+        return NULL;
+
+    while (!WaitForScanJob(job, 5))
+        TakeResults(job, taken);
+    while (TakeResults(job, taken) > 0)
+        ;
+    return job;
+}
+
+static ScanJob* RunScan(const ScanParams* params, TakenResults* taken)
+{
+    return RunScanCounting(params, taken, FALSE);
+}
+
+/*
+ * Tests
+ */
+
+static void TestCurrentDomain(void)
+{
+    ResetFakes();
+    AddFakeDomain(&(FakeDomain){ .name = NULL, .prefix = L"ws", .count = 1000, .pageSize = 64 });
+
+    ScanParams params = DefaultParams(L"", 4);
+    TakenResults taken;
+    ScanJob* job = RunScan(&params, &taken);
+    CHECK(job != NULL);
+    if (job == NULL)
+        return;
+
+    ScanProgress progress;
+    GetScanJobProgress(job, &progress);
+    CHECK(progress.finished);
+    CHECK(progress.succeeded);
+    CHECK(!progress.cancelled);
+    CHECK(progress.summary.complete);
+    CHECK_INT(progress.summary.status, ERROR_SUCCESS);
+    CHECK_INT(progress.sourceCount, 1);
+    CHECK_INT(progress.sourcesDone, 1);
+    CHECK_INT(progress.sourcesFailed, 0);
+    CHECK_INT(progress.found, 1000);
+    CHECK_INT(progress.pages, 16);
+    CHECK_INT(progress.examined, 1000);
+    CHECK_INT(progress.toExamine, 1000);
+    CHECK_INT(taken.count, 1000);
+    CHECK_WSTR(taken.computers[0].name, L"ws-00000");
+    CHECK_WSTR(taken.computers[999].name, L"ws-00999");
+
+    // One worker for the one source, however many were asked for
+    CHECK_INT(g_fakeCalls, 1);
+
+    free(taken.computers);
+    FreeScanJob(job);
+}
+
+static void TestSeveralSources(void)
+{
+    ResetFakes();
+    AddFakeDomain(&(FakeDomain){ .name = L"alpha", .prefix = L"a", .count = 300, .pageSize = 50 });
+    AddFakeDomain(&(FakeDomain){ .name = L"beta", .prefix = L"b", .count = 10, .pageSize = 50 });
+    AddFakeDomain(&(FakeDomain){ .name = L"gamma", .prefix = L"g", .count = 0, .pageSize = 50 });
+    AddFakeDomain(&(FakeDomain){ .name = L"delta", .prefix = L"d", .count = 1234, .pageSize = 100 });
+
+    // Separators mix, and "ALPHA" repeats "alpha"
+    ScanParams params = DefaultParams(L"alpha; beta,gamma  delta;ALPHA", 3);
+    TakenResults taken;
+    ScanJob* job = RunScan(&params, &taken);
+    CHECK(job != NULL);
+    if (job == NULL)
+        return;
+
+    ScanSourceResult sources[SCAN_MAX_SOURCES];
+    int sourceCount = GetScanJobSources(job, sources, SCAN_MAX_SOURCES);
+    CHECK_INT(sourceCount, 4);
+    CHECK_WSTR(sources[0].name, L"alpha");
+    CHECK_WSTR(sources[3].name, L"delta");
+    CHECK_INT(sources[0].found, 300);
+    CHECK_INT(sources[1].found, 10);
+    CHECK_INT(sources[2].found, 0);
+    CHECK_INT(sources[3].found, 1234);
+    for (int i = 0; i < sourceCount; i++)
+    {
+        CHECK(sources[i].started && sources[i].finished && sources[i].succeeded);
+        CHECK(sources[i].summary.complete);
+    }
+
+    ScanProgress progress;
+    GetScanJobProgress(job, &progress);
+    CHECK_INT(progress.found, 1544);
+    CHECK_INT(taken.count, 1544);
+    CHECK_INT(progress.sourcesDone, 4);
+    CHECK_INT(progress.summary.computersReported, 1544);
+    CHECK(progress.summary.complete);
+    CHECK_INT(g_fakeCalls, 4);
+
+    free(taken.computers);
+    FreeScanJob(job);
+}
+
+static void TestTypeFilter(void)
+{
+    ResetFakes();
+    AddFakeDomain(&(FakeDomain){ .name = NULL, .prefix = L"h", .count = 300, .pageSize = 40 });
+
+    ScanParams params = DefaultParams(L"", 1);
+    params.includeWorkstations = FALSE;
+    params.includeDomainControllers = FALSE;
+    TakenResults taken;
+    ScanJob* job = RunScan(&params, &taken);
+    CHECK(job != NULL);
+    if (job == NULL)
+        return;
+
+    // Only every third computer is a server; the others still count as examined
+    ScanProgress progress;
+    GetScanJobProgress(job, &progress);
+    CHECK_INT(progress.found, 100);
+    CHECK_INT(progress.examined, 300);
+    CHECK_WSTR(taken.computers[0].name, L"h-00001");
+
+    free(taken.computers);
+    FreeScanJob(job);
+}
+
+static void TestFailures(void)
+{
+    ResetFakes();
+    AddFakeDomain(&(FakeDomain){ .name = L"good", .prefix = L"g", .count = 50 });
+    AddFakeDomain(&(FakeDomain){ .name = L"nobrowser", .failStatus = ERROR_NO_BROWSER_SERVERS_FOUND });
+    AddFakeDomain(&(FakeDomain){ .name = L"partial", .prefix = L"p", .count = 80, .pageSize = 10, .incomplete = TRUE });
+
+    // "missing" is not a fake domain at all
+    ScanParams params = DefaultParams(L"good;nobrowser;partial;missing", 2);
+    TakenResults taken;
+    ScanJob* job = RunScan(&params, &taken);
+    CHECK(job != NULL);
+    if (job == NULL)
+        return;
+
+    ScanSourceResult sources[SCAN_MAX_SOURCES];
+    GetScanJobSources(job, sources, SCAN_MAX_SOURCES);
+    CHECK(sources[0].succeeded && sources[0].summary.complete);
+    CHECK(!sources[1].succeeded);
+    CHECK(sources[2].succeeded && !sources[2].summary.complete);
+    CHECK_INT(sources[2].found, 40);
+    CHECK(!sources[3].succeeded);
+    CHECK_INT(sources[3].summary.status, ERROR_BAD_NETPATH);
+
+    // Every source but the good one failed; the first real error is reported
+    ScanProgress progress;
+    GetScanJobProgress(job, &progress);
+    CHECK(progress.succeeded);
+    CHECK(!progress.summary.complete);
+    CHECK_INT(progress.sourcesFailed, 3);
+    CHECK_INT(progress.summary.status, ERROR_MORE_DATA);
+    CHECK_INT(progress.found, 90);
+
+    free(taken.computers);
+    FreeScanJob(job);
+
+    // Nothing succeeds
+    ResetFakes();
+    params = DefaultParams(L"missing1;missing2", 2);
+    job = RunScan(&params, &taken);
+    CHECK(job != NULL);
+    if (job == NULL)
+        return;
+    GetScanJobProgress(job, &progress);
+    CHECK(progress.finished);
+    CHECK(!progress.succeeded);
+    CHECK_INT(progress.summary.status, ERROR_BAD_NETPATH);
+    CHECK_INT(taken.count, 0);
+    FreeScanJob(job);
+}
+
+static void TestTimeout(void)
+{
+    ResetFakes();
+    AddFakeDomain(&(FakeDomain){ .name = L"slow", .prefix = L"s", .count = 1000, .pageSize = 10, .pageDelayMs = 20 });
+    AddFakeDomain(&(FakeDomain){ .name = L"quick", .prefix = L"q", .count = 20 });
+
+    ScanParams params = DefaultParams(L"slow;quick", 2);
+    params.sourceTimeoutMs = 100;
+    TakenResults taken;
+    double start = TestNowMs();
+    ScanJob* job = RunScan(&params, &taken);
+    CHECK(job != NULL);
+    if (job == NULL)
+        return;
+
+    // The slow source stops at its first page after the deadline, not after 2 s
+    CHECK(TestNowMs() - start < 1500.0);
+
+    ScanSourceResult sources[SCAN_MAX_SOURCES];
+    GetScanJobSources(job, sources, SCAN_MAX_SOURCES);
+    CHECK(sources[0].timedOut);
+    CHECK(!sources[0].summary.complete);
+    CHECK(sources[0].found > 0 && sources[0].found < 1000);
+    CHECK(!sources[1].timedOut);
+    CHECK_INT(sources[1].found, 20);
+
+    ScanProgress progress;
+    GetScanJobProgress(job, &progress);
+    CHECK_INT(progress.sourcesFailed, 1);
+    CHECK(!progress.summary.complete);
+
+    free(taken.computers);
+    FreeScanJob(job);
+}
+
+static void TestCancel(void)
+{
+    ResetFakes();
+    AddFakeDomain(&(FakeDomain){ .name = L"one", .prefix = L"o", .count = 1000, .pageSize = 10, .pageDelayMs = 10 });
+    AddFakeDomain(&(FakeDomain){ .name = L"two", .prefix = L"t", .count = 1000, .pageSize = 10, .pageDelayMs = 10 });
+    AddFakeDomain(&(FakeDomain){ .name = L"three", .prefix = L"h", .count = 1000, .pageSize = 10, .pageDelayMs = 10 });
+
+    // One worker: the later sources are never started
+    ScanParams params = DefaultParams(L"one;two;three", 1);
+    ScanJob* job = StartScanJob(&params, FakeEnumerate, NULL);
+    CHECK(job != NULL);
+    if (job == NULL)
+        return;
+
+    Sleep(50);
+    double start = TestNowMs();
+    CancelScanJob(job);
+    CHECK(WaitForScanJob(job, 2000));
+    CHECK(TestNowMs() - start < 500.0);
+
+    ScanProgress progress;
+    GetScanJobProgress(job, &progress);
+    CHECK(progress.finished);
+    CHECK(progress.cancelled);
+    CHECK(!progress.summary.complete);
+    CHECK(progress.found > 0 && progress.found < 1000);
+    CHECK_INT(g_fakeCalls, 1);
+
+    ScanSourceResult sources[SCAN_MAX_SOURCES];
+    GetScanJobSources(job, sources, SCAN_MAX_SOURCES);
+    CHECK(sources[0].finished);
+    CHECK(!sources[1].started && !sources[2].started);
+
+    // Freeing a job with results nobody took
+    FreeScanJob(job);
+
+    // Freeing a running job cancels it
+    job = StartScanJob(&params, FakeEnumerate, NULL);
+    CHECK(job != NULL);
+    FreeScanJob(job);
+}
+
+static int CompareNames(const void* a, const void* b)
+{
+    return _wcsicmp(((const ComputerInfo*)a)->name, ((const ComputerInfo*)b)->name);
+}
+
+// TRUE if no two computers have the same name (ignoring case); sorts the list
+static BOOL NamesUnique(ComputerInfo* computers, int count)
+{
+    qsort(computers, count, sizeof(ComputerInfo), CompareNames);
+    for (int i = 1; i < count; i++)
+    {
+        if (_wcsicmp(computers[i - 1].name, computers[i].name) == 0)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static void TestMerge(void)
+{
+    ResetFakes();
+
+    // srv-00000..00499 twice over within one source, then the upper half
+    // again in capitals from a second source
+    AddFakeDomain(&(FakeDomain){ .name = L"lower", .prefix = L"srv", .count = 1000, .distinct = 500, .pageSize = 64 });
+    AddFakeDomain(&(FakeDomain){ .name = L"upper", .prefix = L"SRV", .first = 250, .count = 500, .pageSize = 50 });
+    AddFakeDomain(&(FakeDomain){ .name = L"other", .prefix = L"web", .count = 100, .pageSize = 30 });
+
+    // One worker: the sources run in order, so who found what is known
+    ScanParams params = DefaultParams(L"lower;upper;other", 1);
+    TakenResults taken;
+    ScanJob* job = RunScan(&params, &taken);
+    CHECK(job != NULL);
+    if (job == NULL)
+        return;
+
+    ScanSourceResult sources[SCAN_MAX_SOURCES];
+    GetScanJobSources(job, sources, SCAN_MAX_SOURCES);
+    CHECK_INT(sources[0].found, 500);
+    CHECK_INT(sources[1].found, 250);
+    CHECK_INT(sources[2].found, 100);
+    CHECK_INT(sources[0].summary.computersReported, 1000);
+
+    ScanProgress progress;
+    GetScanJobProgress(job, &progress);
+    CHECK_INT(progress.found, 850);
+    CHECK_INT(progress.summary.computersReported, 1600);
+    CHECK_INT(taken.count, 850);
+    CHECK(NamesUnique(taken.computers, taken.count));
+
+    // The first spelling of a name is the one kept
+    CHECK_WSTR(taken.computers[499].name, L"srv-00499");
+    CHECK_WSTR(taken.computers[500].name, L"SRV-00500");
+
+    free(taken.computers);
+    FreeScanJob(job);
+
+    // Many workers over heavily overlapping sources: still each name once
+    ResetFakes();
+    static const wchar_t* const names[] = { L"m0", L"m1", L"m2", L"m3", L"m4", L"m5", L"m6", L"m7" };
+    for (int i = 0; i < 8; i++)
+        AddFakeDomain(&(FakeDomain){ .name = names[i], .prefix = (i & 1) ? L"HOST" : L"host",
+                                     .first = i * 1000, .count = 4000, .pageSize = 37 });
+
+    params = DefaultParams(L"m0;m1;m2;m3;m4;m5;m6;m7", 8);
+    job = RunScan(&params, &taken);
+    CHECK(job != NULL);
+    if (job == NULL)
+        return;
+
+    GetScanJobSources(job, sources, SCAN_MAX_SOURCES);
+    int sourceTotal = 0;
+    for (int i = 0; i < 8; i++)
+        sourceTotal += sources[i].found;
+
+    GetScanJobProgress(job, &progress);
+    CHECK_INT(progress.found, 11000);
+    CHECK_INT(sourceTotal, 11000);
+    CHECK_INT(taken.count, 11000);
+    CHECK(NamesUnique(taken.computers, taken.count));
+    CHECK(!progress.outOfMemory);
+
+    free(taken.computers);
+    FreeScanJob(job);
+}
+
+// Start from no scan cache
+static void DeleteScanCache(void)
+{
+    wchar_t path[MAX_PATH];
+    GetModuleFileNameW(NULL, path, MAX_PATH);
+    wchar_t* slash = wcsrchr(path, L'\\');
+    if (slash != NULL)
+    {
+        wcscpy_s(slash + 1, MAX_PATH - (slash + 1 - path), SCAN_CACHE_FILE_NAME);
+        DeleteFileW(path);
+    }
+}
+
+static BOOL ContainsHash(const ULONGLONG* hashes, int count, ULONGLONG hash)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (hashes[i] == hash)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static void TestCache(void)
+{
+    DeleteScanCache();
+    ResetFakes();
+    AddFakeDomain(&(FakeDomain){ .name = L"cache-a", .prefix = L"a", .count = 100, .pageSize = 16 });
+    AddFakeDomain(&(FakeDomain){ .name = L"cache-b", .prefix = L"b", .count = 100, .pageSize = 16 });
+
+    // First scan: nothing cached, both sources saved
+    ScanParams params = DefaultParams(L"cache-a;cache-b", 2);
+    params.useCache = TRUE;
+    TakenResults taken;
+    ScanJob* job = RunScan(&params, &taken);
+    CHECK(job != NULL);
+    if (job == NULL)
+        return;
+
+    ScanProgress progress;
+    GetScanJobProgress(job, &progress);
+    ScanSourceResult sources[SCAN_MAX_SOURCES];
+    GetScanJobSources(job, sources, SCAN_MAX_SOURCES);
+    CHECK_INT(progress.cached, 0);
+    CHECK_INT(progress.found, 200);
+    CHECK_INT(progress.gone, 0);
+    CHECK(sources[0].cacheSaved && sources[1].cacheSaved);
+    CHECK_INT(taken.count, 200);
+    free(taken.computers);
+    FreeScanJob(job);
+
+    CachedScan cached;
+    CHECK_INT(LoadScanCache(SCAN_MODE_BROWSE, L"CACHE-A", &cached), SCAN_CACHE_LOADED);
+    CHECK_INT(cached.count, 100);
+    FreeCachedScan(&cached);
+
+    // Second scan: every "a" computer has a new comment and 10 more have
+    // joined; "b" lost its last 20
+    g_fakeDomains[0].comment = L"Rebuilt";
+    g_fakeDomains[0].count = 110;
+    g_fakeDomains[1].count = 80;
+    job = RunScan(&params, &taken);
+    CHECK(job != NULL);
+    if (job == NULL)
+        return;
+
+    GetScanJobProgress(job, &progress);
+    CHECK_INT(progress.cached, 200);
+    CHECK_INT(progress.unchanged, 80);
+    CHECK_INT(progress.changed, 100);
+    CHECK_INT(progress.found, 190);
+    CHECK_INT(progress.gone, 20);
+    GetScanJobSources(job, sources, SCAN_MAX_SOURCES);
+    CHECK_INT(sources[0].cached, 100);
+    CHECK_INT(sources[1].cached, 100);
+
+    // The cache is queued first, then only what changed or is new
+    CHECK_INT(taken.count, 200 + 100 + 10);
+    CHECK_WSTR(taken.computers[200].comment, L"Rebuilt");
+
+    ULONGLONG* gone = NULL;
+    int goneCount = TakeScanJobGone(job, &gone);
+    CHECK_INT(goneCount, 20);
+    BOOL goneRight = TRUE;
+    for (int n = 0; n < 100; n++)
+    {
+        wchar_t name[32];
+        swprintf_s(name, ARRAYSIZE(name), L"B-%05d", n);
+        if (ContainsHash(gone, goneCount, HashHostKey(name)) != (n >= 80))
+            goneRight = FALSE;
+    }
+    CHECK(goneRight);
+    CHECK_INT(TakeScanJobGone(job, &gone), 0);
+    free(gone);
+    free(taken.computers);
+    FreeScanJob(job);
+
+    CHECK_INT(LoadScanCache(SCAN_MODE_BROWSE, L"cache-a", &cached), SCAN_CACHE_LOADED);
+    FILETIME savedA = cached.scanned;
+    FreeCachedScan(&cached);
+
+    // Third scan: "b" ends incomplete, so it keeps its cache and nothing
+    // of it counts as gone; "a" reports what it did last time, so its
+    // cache is up to date without being written again
+    g_fakeDomains[1].incomplete = TRUE;
+    job = RunScan(&params, &taken);
+    CHECK(job != NULL);
+    if (job == NULL)
+        return;
+
+    GetScanJobProgress(job, &progress);
+    GetScanJobSources(job, sources, SCAN_MAX_SOURCES);
+    CHECK(sources[0].cacheSaved);
+    CHECK(!sources[1].cacheSaved);
+    CHECK_INT(progress.cached, 190);
+    CHECK_INT(progress.unchanged, 150);
+    CHECK_INT(progress.changed, 0);
+    CHECK_INT(progress.gone, 0);
+    free(taken.computers);
+    FreeScanJob(job);
+
+    CHECK_INT(LoadScanCache(SCAN_MODE_BROWSE, L"cache-b", &cached), SCAN_CACHE_LOADED);
+    CHECK_INT(cached.count, 80);
+    FreeCachedScan(&cached);
+    CHECK_INT(LoadScanCache(SCAN_MODE_BROWSE, L"cache-a", &cached), SCAN_CACHE_LOADED);
+    CHECK(CompareFileTime(&cached.scanned, &savedA) == 0);
+    FreeCachedScan(&cached);
+
+    // Without useCache the cache is neither read nor written
+    params.useCache = FALSE;
+    g_fakeDomains[1].incomplete = FALSE;
+    g_fakeDomains[1].count = 5;
+    job = RunScan(&params, &taken);
+    CHECK(job != NULL);
+    if (job == NULL)
+        return;
+    GetScanJobProgress(job, &progress);
+    GetScanJobSources(job, sources, SCAN_MAX_SOURCES);
+    CHECK_INT(progress.cached, 0);
+    CHECK(!sources[1].cacheSaved);
+    free(taken.computers);
+    FreeScanJob(job);
+
+    CHECK_INT(LoadScanCache(SCAN_MODE_BROWSE, L"cache-b", &cached), SCAN_CACHE_LOADED);
+    CHECK_INT(cached.count, 80);
+    FreeCachedScan(&cached);
+}
+
+/*
+ * TestCacheSlices - A large cache is handed out a slice at a time, all of
+ * it before anything the refresh finds
+ */
+static void TestCacheSlices(void)
+{
+    DeleteScanCache();
+    ResetFakes();
+    AddFakeDomain(&(FakeDomain){ .name = L"slices", .prefix = L"s", .count = SCAN_CACHE_SLICE * 2 + 10, .pageSize = 500 });
+
+    ScanParams params = DefaultParams(L"slices", 1);
+    params.useCache = TRUE;
+    TakenResults taken;
+    ScanJob* job = RunScan(&params, &taken);
+    CHECK(job != NULL);
+    if (job == NULL)
+        return;
+    free(taken.computers);
+    FreeScanJob(job);
+
+    g_fakeDomains[0].count += 5;
+    job = RunScan(&params, &taken);
+    CHECK(job != NULL);
+    if (job == NULL)
+        return;
+
+    ScanProgress progress;
+    GetScanJobProgress(job, &progress);
+    CHECK_INT(progress.cached, SCAN_CACHE_SLICE * 2 + 10);
+    CHECK_INT(progress.found, SCAN_CACHE_SLICE * 2 + 15);
+    CHECK_INT(taken.count, SCAN_CACHE_SLICE * 2 + 15);
+    CHECK(taken.takes >= 4);
+    if (taken.count == SCAN_CACHE_SLICE * 2 + 15)
+    {
+        CHECK_WSTR(taken.computers[SCAN_CACHE_SLICE * 2 + 9].name, L"s-08201");
+        CHECK_WSTR(taken.computers[SCAN_CACHE_SLICE * 2 + 10].name, L"s-08202");
+    }
+    free(taken.computers);
+    FreeScanJob(job);
+}
+
+/*
+ * TestCacheFirst - The job's first worker loads the cache, and the cached
+ * rows can be taken while the first page is still on its way
+ */
+static void TestCacheFirst(void)
+{
+    DeleteScanCache();
+    ResetFakes();
+    AddFakeDomain(&(FakeDomain){ .name = L"first", .prefix = L"f", .count = 300, .pageSize = 100 });
+
+    ScanParams params = DefaultParams(L"first", 1);
+    params.useCache = TRUE;
+    TakenResults taken;
+    ScanJob* job = RunScan(&params, &taken);
+    CHECK(job != NULL);
+    if (job == NULL)
+        return;
+    free(taken.computers);
+    FreeScanJob(job);
+
+    g_fakeDomains[0].pageDelayMs = 300;
+    job = StartScanJob(&params, FakeEnumerate, NULL);
+    CHECK(job != NULL);
+    if (job == NULL)
+        return;
+
+    ComputerInfo* computers = NULL;
+    int count = 0;
+    double start = TestNowMs();
+    while (count == 0 && TestNowMs() - start < 250.0)
+    {
+        count = TakeScanJobResults(job, &computers);
+        if (count == 0)
+            Sleep(1);
+    }
+    CHECK_INT(count, 300);
+
+    ScanProgress progress;
+    GetScanJobProgress(job, &progress);
+    CHECK_INT(progress.cached, 300);
+    CHECK_INT(progress.pages, 0);
+    CHECK_INT(TakeScanJobResults(job, &computers), 0);
+
+    CHECK(WaitForScanJob(job, 5000));
+    GetScanJobProgress(job, &progress);
+    CHECK_INT(progress.unchanged, 300);
+    CHECK_INT(TakeScanJobResults(job, &computers), 0);
+    FreeScanJob(job);
+}
+
+/*
+ * Benchmark
+ */
+
+/*
+ * BenchMerge - 8 sources of 100k computers, each overlapping the next by
+ * half, through 1 and 8 workers, and again against the cache
+ */
+static void BenchMerge(void)
+{
+    static const wchar_t* const names[] = { L"bench0", L"bench1", L"bench2", L"bench3",
+                                            L"bench4", L"bench5", L"bench6", L"bench7" };
+    char label[96];
+
+    ResetFakes();
+    for (int i = 0; i < 8; i++)
+        AddFakeDomain(&(FakeDomain){ .name = names[i], .prefix = L"bench-host",
+                                     .first = i * 50000, .count = 100000, .pageSize = 1000 });
+
+    printf("8 sources of 100000 computers, 450000 unique\n");
+    int workers[] = { 1, 8 };
+    double best[2] = { 0.0, 0.0 };
+
+    // Three rounds, taking turns, and the best of each - a slow moment of
+    // the machine then hits both and cannot decide the check below alone
+    for (int round = 0; round < 3; round++)
+    {
+        for (int w = 0; w < 2; w++)
+        {
+            ScanParams params = DefaultParams(L"bench0;bench1;bench2;bench3;bench4;bench5;bench6;bench7", workers[w]);
+            TakenResults taken;
+            double start = TestNowMs();
+            ScanJob* job = RunScanCounting(&params, &taken, TRUE);
+            double ms = TestNowMs() - start;
+            if (job == NULL)
+                return;
+
+            ScanProgress progress;
+            GetScanJobProgress(job, &progress);
+            snprintf(label, sizeof(label), "merge, %d worker%s (%d found)", workers[w], (workers[w] > 1) ? "s" : "", progress.found);
+            TestBenchResult(label, ms);
+            if (round == 0 || ms < best[w])
+                best[w] = ms;
+            FreeScanJob(job);
+        }
+    }
+
+    // Merging must not make the workers wait for each other, so 8 are no
+    // slower than 1. With fewer processors than workers the fake sources
+    // (which need no network) take turns on them, and the switching alone
+    // costs about a fifth on one processor, so there half as much again is
+    // allowed.
+    SYSTEM_INFO system;
+    GetSystemInfo(&system);
+    double allowed = (system.dwNumberOfProcessors >= 8) ? 1.0 : 1.5;
+    printf("8 workers / 1 worker: %.2f (at most %.2f on %u processors)\n",
+           best[1] / best[0], allowed, (unsigned int)system.dwNumberOfProcessors);
+    CHECK(best[1] <= best[0] * allowed);
+
+    // One run to save the cache, then three refreshes from it (the cache
+    // does not change, so each is a refresh), again taking the best
+    DeleteScanCache();
+    ScanParams params = DefaultParams(L"bench0;bench1;bench2;bench3;bench4;bench5;bench6;bench7", 8);
+    params.useCache = TRUE;
+    double cachedBest = 0.0;
+    for (int run = 0; run < 4; run++)
+    {
+        TakenResults taken;
+        double start = TestNowMs();
+        ScanJob* job = RunScanCounting(&params, &taken, TRUE);
+        double ms = TestNowMs() - start;
+        if (job == NULL)
+            return;
+
+        ScanProgress progress;
+        GetScanJobProgress(job, &progress);
+        if (run == 0)
+            snprintf(label, sizeof(label), "merge, 8 workers, saving the cache");
+        else
+            snprintf(label, sizeof(label), "merge, 8 workers, cached (%d unchanged)", progress.unchanged);
+        TestBenchResult(label, ms);
+        FreeScanJob(job);
+        if (run == 1 || (run > 1 && ms < cachedBest))
+            cachedBest = ms;
+    }
+
+    // Refreshing from the cache must not cost more than scanning afresh
+    printf("cached / fresh: %.2f (at most 1.00)\n", cachedBest / best[1]);
+    CHECK(cachedBest <= best[1]);
+}
+
+int main(int argc, char** argv)
+{
+    TestCurrentDomain();
+    TestSeveralSources();
+    TestTypeFilter();
+    TestFailures();
+    TestTimeout();
+    TestCancel();
+    TestMerge();
+    TestCache();
+    TestCacheSlices();
+    TestCacheFirst();
+
+    if (TestBenchRequested(argc, argv))
+        BenchMerge();
+
+    return TestSummary("scanjob");
+}
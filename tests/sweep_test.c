@@ -0,0 +1,447 @@
+/*
+ * Subnet Sweep Tests
+ *
+ * Parses ranges and steps the AIMD window, then sweeps loopback ranges
+ * for listeners this test opens on scattered 127.0.x.y addresses (the
+ * whole of 127.0.0.0/8 is loopback on Windows and Linux): a /24, all of
+ * 127.0.0.0/16, a sweep stopped by its callback, and a sweep run as a
+ * scan job source, whose progress (what the status bar turns into a hit
+ * rate and time left) is checked while it runs. The benchmark sweeps
+ * 127.0.0.0/16 with different connect windows.
+ *
+ * Off Windows the sweep runs on the poll() engine in compat/.
+ */
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "test.h"
+#include "config.h"
+#include "sweep.h"
+#include "scanjob.h"
+
+/*
+ * Settings and the browse list
+ */
+
+static DWORD g_sweepConcurrency = 1024;
+static DWORD g_sweepTimeoutMs = 250;
+
+DWORD GetSettingDWORD(const wchar_t* valueName, DWORD defaultValue)
+{
+    if (wcscmp(valueName, REG_SWEEP_CONCURRENCY) == 0)
+        return g_sweepConcurrency;
+    if (wcscmp(valueName, REG_SWEEP_TIMEOUT) == 0)
+        return g_sweepTimeoutMs;
+    return defaultValue;
+}
+
+BOOL GetSettingString(const wchar_t* valueName, wchar_t* buffer, DWORD bufferLen)
+{
+    (void)valueName;
+    (void)buffer;
+    (void)bufferLen;
+    return FALSE;
+}
+
+// The scan job's default source; every scan here names the sweep instead
+BOOL EnumerateComputers(const wchar_t* domain, BOOL includeWorkstations,
+                        BOOL includeServers, BOOL includeDomainControllers,
+                        ComputerBatchCallback callback, void* context,
+                        ScanSummary* summary)
+{
+    (void)domain;
+    (void)includeWorkstations;
+    (void)includeServers;
+    (void)includeDomainControllers;
+    (void)callback;
+    (void)context;
+    if (summary != NULL)
+        summary->status = ERROR_NO_BROWSER_SERVERS_FOUND;
+    return FALSE;
+}
+
+void FreeComputerList(ComputerInfo* computers)
+{
+    free(computers);
+}
+
+/*
+ * Loopback listeners
+ */
+
+#define MAX_LISTENERS 8
+
+// A listening socket on one loopback address, accepting and dropping connections
+typedef struct {
+    SOCKET socket;
+    DWORD address;              // Host byte order
+    HANDLE thread;
+} Listener;
+
+static Listener g_listeners[MAX_LISTENERS];
+static int g_listenerCount;
+static USHORT g_port;           // Every listener uses the same port
+
+static DWORD WINAPI ListenerThread(LPVOID param)
+{
+    Listener* listener = (Listener*)param;
+
+    // Ends when StopListeners closes the socket
+    for (;;)
+    {
+        SOCKET client = accept(listener->socket, NULL, NULL);
+        if (client == INVALID_SOCKET)
+            break;
+
+        struct linger noLinger = { 1, 0 };
+        setsockopt(client, SOL_SOCKET, SO_LINGER, (const char*)&noLinger, sizeof(noLinger));
+        closesocket(client);
+    }
+    return 0;
+}
+
+/*
+ * AddListener - Listen on address:g_port (the first listener picks g_port)
+ */
+static BOOL AddListener(DWORD address)
+{
+    Listener* listener = &g_listeners[g_listenerCount];
+    SOCKADDR_IN local = {0};
+    int localLength = sizeof(local);
+
+    listener->address = address;
+    listener->socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener->socket == INVALID_SOCKET)
+        return FALSE;
+
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(address);
+    local.sin_port = htons(g_port);
+    if (bind(listener->socket, (const SOCKADDR*)&local, sizeof(local)) != 0 ||
+        getsockname(listener->socket, (SOCKADDR*)&local, &localLength) != 0 ||
+        listen(listener->socket, SOMAXCONN) != 0)
+    {
+        closesocket(listener->socket);
+        return FALSE;
+    }
+    g_port = ntohs(local.sin_port);
+
+    listener->thread = CreateThread(NULL, 0, ListenerThread, listener, 0, NULL);
+    if (listener->thread == NULL)
+    {
+        closesocket(listener->socket);
+        return FALSE;
+    }
+    g_listenerCount++;
+    return TRUE;
+}
+
+static void StopListeners(void)
+{
+    for (int i = 0; i < g_listenerCount; i++)
+    {
+        closesocket(g_listeners[i].socket);
+        WaitForSingleObject(g_listeners[i].thread, INFINITE);
+        CloseHandle(g_listeners[i].thread);
+    }
+    g_listenerCount = 0;
+}
+
+#define IPV4(a, b, c, d) (((DWORD)(a) << 24) | ((DWORD)(b) << 16) | ((DWORD)(c) << 8) | (DWORD)(d))
+
+// The endpoint name a sweep reports for a listener
+static void ListenerName(const Listener* listener, wchar_t* name, size_t nameLen)
+{
+    DWORD a = listener->address;
+    swprintf_s(name, nameLen, L"%u.%u.%u.%u:%u", (unsigned int)(a >> 24), (unsigned int)((a >> 16) & 0xFF),
+               (unsigned int)((a >> 8) & 0xFF), (unsigned int)(a & 0xFF), (unsigned int)g_port);
+}
+
+/*
+ * Helpers
+ */
+
+// Every page of a sweep, with the progress seen at each callback
+typedef struct {
+    ComputerInfo found[64];
+    int foundCount;
+    int calls;
+    int stopAfterCalls;         // Return FALSE on this call (0 = never)
+} SweepPages;
+
+static BOOL CollectSweepPage(const ComputerInfo* batch, int count, void* context)
+{
+    SweepPages* pages = (SweepPages*)context;
+    for (int i = 0; i < count && pages->foundCount < (int)ARRAYSIZE(pages->found); i++)
+        pages->found[pages->foundCount++] = batch[i];
+    pages->calls++;
+    return pages->stopAfterCalls == 0 || pages->calls < pages->stopAfterCalls;
+}
+
+// Listeners in [first, first + count) were all found, and nothing else
+static BOOL FoundExactly(const SweepPages* pages, DWORD first, DWORD count)
+{
+    int expected = 0;
+    for (int i = 0; i < g_listenerCount; i++)
+    {
+        if (g_listeners[i].address - first >= count)
+            continue;
+        expected++;
+
+        wchar_t name[32];
+        BOOL seen = FALSE;
+        ListenerName(&g_listeners[i], name, ARRAYSIZE(name));
+        for (int j = 0; j < pages->foundCount && !seen; j++)
+            seen = (wcscmp(pages->found[j].name, name) == 0);
+        if (!seen)
+            return FALSE;
+    }
+    return pages->foundCount == expected;
+}
+
+/*
+ * Tests
+ */
+
+static void CheckRange(const wchar_t* text, BOOL valid, DWORD first, DWORD count, USHORT port)
+{
+    SweepRange range = {0};
+    BOOL parsed = ParseSweepRange(text, RDP_DEFAULT_PORT, &range);
+    CHECK_INT(parsed, valid);
+    if (parsed && valid)
+    {
+        CHECK_INT(range.first, first);
+        CHECK_INT(range.count, count);
+        CHECK_INT(range.port, port);
+    }
+}
+
+static void TestParseRange(void)
+{
+    CheckRange(L"10.0.0.0/24", TRUE, IPV4(10, 0, 0, 0), 256, RDP_DEFAULT_PORT);
+    CheckRange(L"10.0.0.77/24", TRUE, IPV4(10, 0, 0, 0), 256, RDP_DEFAULT_PORT);
+    CheckRange(L"192.168.7.9", TRUE, IPV4(192, 168, 7, 9), 1, RDP_DEFAULT_PORT);
+    CheckRange(L"172.16.0.0/12", TRUE, IPV4(172, 16, 0, 0), 1u << 20, RDP_DEFAULT_PORT);
+    CheckRange(L"10.0.0.0/24:3390", TRUE, IPV4(10, 0, 0, 0), 256, 3390);
+    CheckRange(L"10.0.0.5:65535", TRUE, IPV4(10, 0, 0, 5), 1, 65535);
+    CheckRange(L"127.0.0.0/16", TRUE, IPV4(127, 0, 0, 0), 65536, RDP_DEFAULT_PORT);
+
+    CheckRange(L"10.0.0.0/11", FALSE, 0, 0, 0);         // Larger than SWEEP_MAX_ADDRESSES
+    CheckRange(L"0.0.0.0/0", FALSE, 0, 0, 0);
+    CheckRange(L"10.0.0.0/33", FALSE, 0, 0, 0);
+    CheckRange(L"10.0.0.0/", FALSE, 0, 0, 0);
+    CheckRange(L"10.0.0.1:0", FALSE, 0, 0, 0);
+    CheckRange(L"10.0.0.1:65536", FALSE, 0, 0, 0);
+    CheckRange(L"256.0.0.1", FALSE, 0, 0, 0);
+    CheckRange(L"10.0.0", FALSE, 0, 0, 0);
+    CheckRange(L"10.0.0.1.2", FALSE, 0, 0, 0);
+    CheckRange(L"host.example", FALSE, 0, 0, 0);
+    CheckRange(L"", FALSE, 0, 0, 0);
+}
+
+static void TestWindow(void)
+{
+    // Additive increase from the start up to the largest window
+    int window = SWEEP_INITIAL_WINDOW;
+    int ticks = 0;
+    while (window < 1000 && ticks < 1000)
+    {
+        int next = NextSweepWindow(window, 1000, FALSE);
+        if (!CHECK(next == window + SWEEP_WINDOW_STEP || next == 1000))
+            break;
+        window = next;
+        ticks++;
+    }
+    CHECK_INT(window, 1000);
+    CHECK_INT(ticks, (1000 - SWEEP_INITIAL_WINDOW + SWEEP_WINDOW_STEP - 1) / SWEEP_WINDOW_STEP);
+    CHECK_INT(NextSweepWindow(1000, 1000, FALSE), 1000);
+
+    // Multiplicative decrease, down to the floor
+    CHECK_INT(NextSweepWindow(1000, 1000, TRUE), 500);
+    CHECK_INT(NextSweepWindow(33, 1000, TRUE), 16);
+    CHECK_INT(NextSweepWindow(SWEEP_MIN_WINDOW * 2 - 1, 1000, TRUE), SWEEP_MIN_WINDOW);
+    CHECK_INT(NextSweepWindow(SWEEP_MIN_WINDOW, 1000, TRUE), SWEEP_MIN_WINDOW);
+
+    // A small range caps the window
+    CHECK_INT(NextSweepWindow(SWEEP_MIN_WINDOW, SWEEP_MIN_WINDOW, FALSE), SWEEP_MIN_WINDOW);
+
+    // Queueing: the average answer is over four times the fastest plus 5 ms
+    CHECK(!IsSweepQueueing(4, 4 * 9.0, 1.0));
+    CHECK(IsSweepQueueing(4, 4 * 9.5, 1.0));
+    CHECK(IsSweepQueueing(10, 10 * 50.0, 10.0));
+    CHECK(!IsSweepQueueing(10, 10 * 44.0, 10.0));
+    CHECK(!IsSweepQueueing(3, 3 * 100.0, 1.0));      // Too few answers to trust
+    CHECK(!IsSweepQueueing(10, 10 * 100.0, 0.0));    // No fastest answer yet
+    CHECK(!IsSweepQueueing(0, 0.0, 0.0));
+}
+
+static void TestSweep24(void)
+{
+    wchar_t range[32];
+    swprintf_s(range, ARRAYSIZE(range), L"127.0.0.0/24:%u", (unsigned int)g_port);
+
+    SweepPages pages = {0};
+    ScanSummary summary;
+    CHECK(EnumerateSubnetComputers(range, TRUE, TRUE, TRUE, CollectSweepPage, &pages, &summary));
+    CHECK(summary.complete);
+    CHECK_INT(summary.status, ERROR_SUCCESS);
+    CHECK_INT(summary.totalEntries, 256);
+    CHECK_INT(summary.entriesReceived, 256);
+    CHECK_INT(summary.computersReported, pages.foundCount);
+    CHECK_INT(summary.pages, pages.calls);
+    CHECK(FoundExactly(&pages, IPV4(127, 0, 0, 0), 256));
+    CHECK_WSTR(pages.found[0].comment, L"Found by subnet sweep");
+
+    // Not a range
+    CHECK(!EnumerateSubnetComputers(L"127.0.0.0/40", TRUE, TRUE, TRUE, CollectSweepPage, &pages, &summary));
+    CHECK_INT(summary.status, ERROR_INVALID_PARAMETER);
+}
+
+static void TestSweep16(void)
+{
+    wchar_t range[32];
+    swprintf_s(range, ARRAYSIZE(range), L"127.0.0.0/16:%u", (unsigned int)g_port);
+
+    SweepPages pages = {0};
+    ScanSummary summary;
+    CHECK(EnumerateSubnetComputers(range, TRUE, TRUE, TRUE, CollectSweepPage, &pages, &summary));
+    CHECK(summary.complete);
+    CHECK_INT(summary.entriesReceived, 65536);
+    CHECK(FoundExactly(&pages, IPV4(127, 0, 0, 0), 65536));
+
+    // Progress is reported every tick, not only at the end
+    CHECK(pages.calls > 2);
+
+    // A callback that says stop ends the sweep early
+    memset(&pages, 0, sizeof(pages));
+    pages.stopAfterCalls = 2;
+    double start = TestNowMs();
+    CHECK(EnumerateSubnetComputers(range, TRUE, TRUE, TRUE, CollectSweepPage, &pages, &summary));
+    CHECK(TestNowMs() - start < 5000.0);
+    CHECK(!summary.complete);
+    CHECK(summary.entriesReceived < 65536);
+    CHECK_INT(pages.calls, 2);
+}
+
+static void TestScanJobSource(void)
+{
+    ScanParams params = {0};
+    swprintf_s(params.domains, ARRAYSIZE(params.domains), L"127.0.0.0/24:%u; 127.0.128.0/24:%u",
+               (unsigned int)g_port, (unsigned int)g_port);
+    params.mode = SCAN_MODE_SWEEP;
+    params.workerCount = 2;
+
+    ScanJob* job = StartScanJob(&params, EnumerateSubnetComputers, NULL);
+    CHECK(job != NULL);
+    if (job == NULL)
+        return;
+
+    // While it runs: addresses only ever add up, and never past the total
+    // or below the endpoints found (the hit rate stays within 0-100%)
+    ScanProgress progress;
+    DWORD lastExamined = 0;
+    BOOL ordered = TRUE;
+    double start = TestNowMs();
+    while (!WaitForScanJob(job, 20) && TestNowMs() - start < 60000.0)
+    {
+        GetScanJobProgress(job, &progress);
+        ordered = ordered && progress.examined >= lastExamined &&
+                  (progress.toExamine == 0 || progress.examined <= progress.toExamine) &&
+                  (DWORD)progress.found <= progress.examined && progress.examinedPerSecond >= 0.0;
+        lastExamined = progress.examined;
+    }
+    CHECK(ordered);
+    CHECK(WaitForScanJob(job, 0));
+
+    GetScanJobProgress(job, &progress);
+    CHECK(progress.succeeded);
+    CHECK(progress.summary.complete);
+    CHECK_INT(progress.examined, 512);
+    CHECK_INT(progress.toExamine, 512);
+    CHECK(progress.examinedPerSecond > 0.0);
+    CHECK(progress.examined >= lastExamined);
+
+    // Nothing left: the time left the status bar shows is zero
+    CHECK_INT(progress.toExamine - progress.examined, 0);
+
+    ComputerInfo* computers = NULL;
+    int count = TakeScanJobResults(job, &computers);
+    int expected = 0;
+    for (int i = 0; i < g_listenerCount; i++)
+    {
+        DWORD address = g_listeners[i].address;
+        if (address - IPV4(127, 0, 0, 0) < 256 || address - IPV4(127, 0, 128, 0) < 256)
+            expected++;
+    }
+    CHECK_INT(count, expected);
+    CHECK_INT(progress.found, expected);
+    FreeScanJob(job);
+}
+
+/*
+ * Benchmark
+ */
+
+static void BenchSweep(void)
+{
+    char label[96];
+    wchar_t range[32];
+    swprintf_s(range, ARRAYSIZE(range), L"127.0.0.0/16:%u", (unsigned int)g_port);
+
+    printf("127.0.0.0/16, %d listeners, %u ms timeout\n", g_listenerCount, (unsigned int)g_sweepTimeoutMs);
+    DWORD windows[] = { 128, 512, 1024 };
+    for (int w = 0; w < (int)ARRAYSIZE(windows); w++)
+    {
+        g_sweepConcurrency = windows[w];
+
+        SweepPages pages = {0};
+        ScanSummary summary;
+        double start = TestNowMs();
+        EnumerateSubnetComputers(range, TRUE, TRUE, TRUE, CollectSweepPage, &pages, &summary);
+        double ms = TestNowMs() - start;
+
+        snprintf(label, sizeof(label), "window up to %u: %u addresses/s, %d found",
+                 (unsigned int)windows[w], (unsigned int)(summary.entriesReceived * 1000.0 / ms), pages.foundCount);
+        TestBenchResult(label, ms);
+    }
+    g_sweepConcurrency = 1024;
+}
+
+int main(int argc, char** argv)
+{
+    static const DWORD addresses[] = {
+        IPV4(127, 0, 0, 10), IPV4(127, 0, 0, 200), IPV4(127, 0, 3, 77),
+        IPV4(127, 0, 128, 1), IPV4(127, 0, 200, 254), IPV4(127, 0, 255, 254)
+    };
+    WSADATA wsaData;
+
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+    {
+        printf("sweep: Winsock did not start\n");
+        return 1;
+    }
+
+    BOOL listening = TRUE;
+    for (int i = 0; i < (int)ARRAYSIZE(addresses) && listening; i++)
+        listening = AddListener(addresses[i]);
+    CHECK(listening);
+
+    TestParseRange();
+    TestWindow();
+    if (listening)
+    {
+        TestSweep24();
+        TestSweep16();
+        TestScanJobSource();
+
+        if (TestBenchRequested(argc, argv))
+            BenchSweep();
+    }
+
+    StopListeners();
+    WSACleanup();
+    return TestSummary("sweep");
+}
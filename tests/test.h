@@ -0,0 +1,101 @@
+/*
+ * Test Helpers
+ *
+ * Every test is one program, <module>_test, that runs its checks and
+ * exits non-zero if any failed. Run as "<module>_test bench" it also runs
+ * its benchmarks and prints one line per measurement.
+ *
+ * Checks report and carry on, so one run lists every failure.
+ */
+
+#ifndef WINRDP_TESTS_TEST_H
+#define WINRDP_TESTS_TEST_H
+
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+
+static int g_testChecks;
+static int g_testFailures;
+
+#define CHECK(cond) \
+    TestCheck((cond) ? TRUE : FALSE, #cond, __FILE__, __LINE__)
+#define CHECK_INT(actual, expected) \
+    TestCheckInt((long long)(actual), (long long)(expected), #actual, __FILE__, __LINE__)
+#define CHECK_WSTR(actual, expected) \
+    TestCheckWstr((actual), (expected), #actual, __FILE__, __LINE__)
+
+static inline BOOL TestCheck(BOOL ok, const char* expression, const char* file, int line)
+{
+    g_testChecks++;
+    if (!ok)
+    {
+        g_testFailures++;
+        printf("%s:%d: check failed: %s\n", file, line, expression);
+    }
+    return ok;
+}
+
+static inline BOOL TestCheckInt(long long actual, long long expected, const char* expression,
+                                const char* file, int line)
+{
+    g_testChecks++;
+    if (actual != expected)
+    {
+        g_testFailures++;
+        printf("%s:%d: %s is %lld, expected %lld\n", file, line, expression, actual, expected);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static inline BOOL TestCheckWstr(const wchar_t* actual, const wchar_t* expected, const char* expression,
+                                 const char* file, int line)
+{
+    g_testChecks++;
+    if (actual == NULL || wcscmp(actual, expected) != 0)
+    {
+        g_testFailures++;
+        printf("%s:%d: %s is \"%ls\", expected \"%ls\"\n", file, line, expression,
+               (actual != NULL) ? actual : L"(null)", expected);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+// Print the totals; the return value is the exit code
+static inline int TestSummary(const char* name)
+{
+    printf("%s: %d checks, %d failed\n", name, g_testChecks, g_testFailures);
+    return (g_testFailures == 0) ? 0 : 1;
+}
+
+// TRUE if the program was started with "bench"
+static inline BOOL TestBenchRequested(int argc, char** argv)
+{
+    return argc > 1 && strcmp(argv[1], "bench") == 0;
+}
+
+// Milliseconds from an arbitrary starting point
+static inline double TestNowMs(void)
+{
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (double)counter.QuadPart * 1000.0 / (double)frequency.QuadPart;
+}
+
+static inline void TestBenchResult(const char* label, double ms)
+{
+    printf("  %-52s %10.2f ms\n", label, ms);
+}
+
+// Deterministic pseudo-random numbers (the same data on every run)
+static inline ULONG TestRandom(ULONG* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+#endif // WINRDP_TESTS_TEST_H